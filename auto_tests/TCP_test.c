@@ -430,6 +430,114 @@ static void test_some(void)
     mono_time_free(mem, mono_time);
 }
 
+#define NUM_SHARD_THREADS 4
+#define NUM_SHARD_PAIRS 8
+
+static void test_threaded(void)
+{
+    const Random *rng = os_random();
+    ck_assert(rng != nullptr);
+    const Network *ns = os_network();
+    ck_assert(ns != nullptr);
+    const Memory *mem = os_memory();
+    ck_assert(mem != nullptr);
+
+    Mono_Time *mono_time = mono_time_new(mem, nullptr, nullptr);
+    Logger *logger = logger_new(mem);
+
+    uint8_t self_public_key[CRYPTO_PUBLIC_KEY_SIZE];
+    uint8_t self_secret_key[CRYPTO_SECRET_KEY_SIZE];
+    crypto_new_keypair(rng, self_public_key, self_secret_key);
+    TCP_Server *tcp_s = new_tcp_server_threaded(logger, mem, rng, ns, USE_IPV6, NUM_PORTS, ports, self_secret_key,
+                        nullptr, nullptr, NUM_SHARD_THREADS);
+    ck_assert_msg(tcp_s != nullptr, "Failed to create threaded TCP relay server");
+    ck_assert_msg(tcp_server_listen_count(tcp_s) == NUM_PORTS, "Failed to bind to all ports.");
+
+    // With several workers, most pairs end up on different shards.
+    struct sec_TCP_con *cons[NUM_SHARD_PAIRS * 2];
+
+    for (uint32_t i = 0; i < NUM_SHARD_PAIRS * 2; ++i) {
+        cons[i] = new_tcp_con(logger, mem, rng, ns, tcp_s, mono_time);
+    }
+
+    uint8_t requ_p[1 + CRYPTO_PUBLIC_KEY_SIZE];
+    requ_p[0] = TCP_PACKET_ROUTING_REQUEST;
+
+    for (uint32_t i = 0; i < NUM_SHARD_PAIRS * 2; ++i) {
+        memcpy(requ_p + 1, cons[i ^ 1]->public_key, CRYPTO_PUBLIC_KEY_SIZE);
+        write_packet_tcp_test_connection(logger, mem, cons[i], requ_p, sizeof(requ_p));
+    }
+
+    do_tcp_server_delay(tcp_s, mono_time, 50);
+
+    uint8_t data[2048];
+
+    for (uint32_t i = 0; i < NUM_SHARD_PAIRS * 2; ++i) {
+        int len = read_packet_sec_tcp(logger, cons[i], data, 2 + 1 + 1 + CRYPTO_PUBLIC_KEY_SIZE + CRYPTO_MAC_SIZE);
+        ck_assert_msg(len == 1 + 1 + CRYPTO_PUBLIC_KEY_SIZE, "Wrong response packet length of %d.", len);
+        ck_assert_msg(data[0] == TCP_PACKET_ROUTING_RESPONSE, "Wrong response packet id of %d.", data[0]);
+        ck_assert_msg(data[1] == 16, "Server refused the connection.");
+        ck_assert_msg(pk_equal(data + 2, cons[i ^ 1]->public_key), "Key in response packet wrong.");
+
+        len = read_packet_sec_tcp(logger, cons[i], data, 2 + 2 + CRYPTO_MAC_SIZE);
+        ck_assert_msg(len == 2, "wrong len %d", len);
+        ck_assert_msg(data[0] == TCP_PACKET_CONNECTION_NOTIFICATION, "wrong packet id %u", data[0]);
+        ck_assert_msg(data[1] == 16, "wrong peer id %u", data[1]);
+    }
+
+    uint8_t test_packet[512] = {16};
+
+    for (uint32_t i = 0; i < NUM_SHARD_PAIRS * 2; ++i) {
+        test_packet[1] = i;
+        write_packet_tcp_test_connection(logger, mem, cons[i], test_packet, sizeof(test_packet));
+    }
+
+    do_tcp_server_delay(tcp_s, mono_time, 50);
+
+    for (uint32_t i = 0; i < NUM_SHARD_PAIRS * 2; ++i) {
+        const int len = read_packet_sec_tcp(logger, cons[i], data, 2 + sizeof(test_packet) + CRYPTO_MAC_SIZE);
+        ck_assert_msg(len == sizeof(test_packet), "wrong len %d", len);
+        ck_assert_msg(data[0] == 16, "wrong connection id %u", data[0]);
+        ck_assert_msg(data[1] == (i ^ 1), "packet for %u came from %u", i, data[1]);
+    }
+
+    // OOB packets are delivered by public key, wherever the receiver is.
+    uint8_t oob_p[1 + CRYPTO_PUBLIC_KEY_SIZE + 4] = {TCP_PACKET_OOB_SEND};
+    memcpy(oob_p + 1, cons[1]->public_key, CRYPTO_PUBLIC_KEY_SIZE);
+    memcpy(oob_p + 1 + CRYPTO_PUBLIC_KEY_SIZE, "oob!", 4);
+    write_packet_tcp_test_connection(logger, mem, cons[0], oob_p, sizeof(oob_p));
+
+    do_tcp_server_delay(tcp_s, mono_time, 50);
+
+    int len = read_packet_sec_tcp(logger, cons[1], data, 2 + 1 + CRYPTO_PUBLIC_KEY_SIZE + 4 + CRYPTO_MAC_SIZE);
+    ck_assert_msg(len == 1 + CRYPTO_PUBLIC_KEY_SIZE + 4, "wrong len %d", len);
+    ck_assert_msg(data[0] == TCP_PACKET_OOB_RECV, "wrong packet id %u", data[0]);
+    ck_assert_msg(pk_equal(data + 1, cons[0]->public_key), "OOB packet has the wrong sender.");
+    ck_assert_msg(memcmp(data + 1 + CRYPTO_PUBLIC_KEY_SIZE, "oob!", 4) == 0, "OOB packet has the wrong data.");
+
+    // Closing one side of a link tells the other side.
+    kill_tcp_con(cons[2]);
+    cons[2] = nullptr;
+
+    do_tcp_server_delay(tcp_s, mono_time, 50);
+
+    len = read_packet_sec_tcp(logger, cons[3], data, 2 + 2 + CRYPTO_MAC_SIZE);
+    ck_assert_msg(len == 2, "wrong len %d", len);
+    ck_assert_msg(data[0] == TCP_PACKET_DISCONNECT_NOTIFICATION, "wrong packet id %u", data[0]);
+    ck_assert_msg(data[1] == 16, "wrong peer id %u", data[1]);
+
+    kill_tcp_server(tcp_s);
+
+    for (uint32_t i = 0; i < NUM_SHARD_PAIRS * 2; ++i) {
+        if (cons[i] != nullptr) {
+            kill_tcp_con(cons[i]);
+        }
+    }
+
+    logger_kill(logger);
+    mono_time_free(mem, mono_time);
+}
+
 static int response_callback_good;
 static uint8_t response_callback_connection_id;
 static uint8_t response_callback_public_key[CRYPTO_PUBLIC_KEY_SIZE];
@@ -946,6 +1054,7 @@ static void tcp_suite(void)
 {
     test_basic();
     test_some();
+    test_threaded();
     test_client();
     test_client_invalid();
     test_tcp_connection();
@@ -28,6 +28,18 @@ static void alice_script(ToxNode *self, void *ctx)
 
     ck_assert(udp_sent >= 256);
     ck_assert(udp_recv >= 1);
+
+    // Bob's DHT packets all use the same key, so all but the first are hits.
+    const uint64_t key_hits = tox_key_cache_get_counter(tox, TOX_KEY_CACHE_TYPE_DHT_RECV, TOX_KEY_CACHE_COUNTER_HITS);
+    const uint64_t key_misses = tox_key_cache_get_counter(tox, TOX_KEY_CACHE_TYPE_DHT_RECV, TOX_KEY_CACHE_COUNTER_MISSES);
+    const uint64_t key_evictions = tox_key_cache_get_counter(tox, TOX_KEY_CACHE_TYPE_DHT_RECV, TOX_KEY_CACHE_COUNTER_EVICTIONS);
+
+    tox_node_log(self, "DHT key cache hits: %" PRIu64 ", misses: %" PRIu64 ", evictions: %" PRIu64,
+                 key_hits, key_misses, key_evictions);
+
+    ck_assert(key_misses >= 1);
+    ck_assert(key_hits > key_misses);
+    ck_assert(key_evictions == 0);
 }
 
 static void bob_script(ToxNode *self, void *ctx)
@@ -163,7 +163,7 @@ int main(int argc, char *argv[])
     DHT *dht = new_dht(logger, mem, rng, ns, mono_time, net, true, true);
     Onion *onion = new_onion(logger, mem, mono_time, rng, dht, net);
     Forwarding *forwarding = new_forwarding(logger, mem, rng, mono_time, dht, net);
-    GC_Announces_List *gc_announces_list = new_gca_list(mem);
+    GC_Announces_List *gc_announces_list = new_gca_list(mem, rng);
     Onion_Announce *onion_a = new_onion_announce(logger, mem, rng, mono_time, dht, net);
 
 #ifdef DHT_NODE_EXTRA_PACKETS
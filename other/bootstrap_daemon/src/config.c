@@ -151,7 +151,7 @@ static int tox_config_lookup_bool(const config_t *config, const char *path, bool
 
 bool get_general_config(const char *cfg_file_path, char **pid_file_path, char **keys_file_path, int *port,
                         bool *enable_ipv6, bool *enable_ipv4_fallback, bool *enable_lan_discovery, bool *enable_tcp_relay,
-                        uint16_t **tcp_relay_ports, int *tcp_relay_port_count, bool *enable_motd, char **motd)
+                        uint16_t **tcp_relay_ports, int *tcp_relay_port_count, int *tcp_relay_threads, bool *enable_motd, char **motd)
 {
     config_t cfg;
 
@@ -162,6 +162,7 @@ bool get_general_config(const char *cfg_file_path, char **pid_file_path, char **
     const char *const NAME_ENABLE_IPV4_FALLBACK = "enable_ipv4_fallback";
     const char *const NAME_ENABLE_LAN_DISCOVERY = "enable_lan_discovery";
     const char *const NAME_ENABLE_TCP_RELAY     = "enable_tcp_relay";
+    const char *const NAME_TCP_RELAY_THREADS    = "tcp_relay_threads";
     const char *const NAME_ENABLE_MOTD          = "enable_motd";
     const char *const NAME_MOTD                 = "motd";
 
@@ -254,6 +255,20 @@ bool get_general_config(const char *cfg_file_path, char **pid_file_path, char **
         *tcp_relay_port_count = 0;
     }
 
+    // Get TCP relay thread count
+    if (config_lookup_int(&cfg, NAME_TCP_RELAY_THREADS, tcp_relay_threads) == CONFIG_FALSE) {
+        LOG_WRITE(LOG_LEVEL_WARNING, "No '%s' setting in configuration file.\n", NAME_TCP_RELAY_THREADS);
+        LOG_WRITE(LOG_LEVEL_WARNING, "Using default '%s': %d\n", NAME_TCP_RELAY_THREADS, DEFAULT_TCP_RELAY_THREADS);
+        *tcp_relay_threads = DEFAULT_TCP_RELAY_THREADS;
+    }
+
+    if (*tcp_relay_threads < 0 || *tcp_relay_threads > MAX_TCP_RELAY_THREADS) {
+        LOG_WRITE(LOG_LEVEL_WARNING, "'%s' should be in [0, %d], but is %d.\n", NAME_TCP_RELAY_THREADS,
+                  MAX_TCP_RELAY_THREADS, *tcp_relay_threads);
+        LOG_WRITE(LOG_LEVEL_WARNING, "Using default '%s': %d\n", NAME_TCP_RELAY_THREADS, DEFAULT_TCP_RELAY_THREADS);
+        *tcp_relay_threads = DEFAULT_TCP_RELAY_THREADS;
+    }
+
     // Get MOTD option
     if (tox_config_lookup_bool(&cfg, NAME_ENABLE_MOTD, enable_motd) == CONFIG_FALSE) {
         LOG_WRITE(LOG_LEVEL_WARNING, "No '%s' setting in configuration file.\n", NAME_ENABLE_MOTD);
@@ -301,6 +316,8 @@ bool get_general_config(const char *cfg_file_path, char **pid_file_path, char **
                 LOG_WRITE(LOG_LEVEL_INFO, "Port #%d: %u\n", i, (*tcp_relay_ports)[i]);
             }
         }
+
+        LOG_WRITE(LOG_LEVEL_INFO, "'%s': %d\n", NAME_TCP_RELAY_THREADS, *tcp_relay_threads);
     }
 
     LOG_WRITE(LOG_LEVEL_INFO, "'%s': %s\n", NAME_ENABLE_MOTD,          *enable_motd          ? "true" : "false");
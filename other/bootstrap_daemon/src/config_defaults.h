@@ -22,6 +22,8 @@
 #define DEFAULT_ENABLE_LAN_DISCOVERY  true
 #define DEFAULT_ENABLE_TCP_RELAY      true
 #define DEFAULT_TCP_RELAY_PORTS       443, 3389, 33445 // comma-separated list of ports
+#define DEFAULT_TCP_RELAY_THREADS     0 // run the TCP relay on the main thread
+#define MAX_TCP_RELAY_THREADS         64
 #define DEFAULT_ENABLE_MOTD           true
 #define DEFAULT_MOTD                  DAEMON_NAME
 
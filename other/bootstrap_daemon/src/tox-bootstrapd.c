@@ -253,11 +253,13 @@ int main(int argc, char *argv[])
     bool enable_tcp_relay = false;
     uint16_t *tcp_relay_ports = nullptr;
     int tcp_relay_port_count = 0;
+    int tcp_relay_threads = 0;
     bool enable_motd = false;
     char *motd = nullptr;
 
     if (get_general_config(cfg_file_path, &pid_file_path, &keys_file_path, &start_port, &enable_ipv6, &enable_ipv4_fallback,
-                           &enable_lan_discovery, &enable_tcp_relay, &tcp_relay_ports, &tcp_relay_port_count, &enable_motd, &motd)) {
+                           &enable_lan_discovery, &enable_tcp_relay, &tcp_relay_ports, &tcp_relay_port_count, &tcp_relay_threads,
+                           &enable_motd, &motd)) {
         LOG_WRITE(LOG_LEVEL_INFO, "General config read successfully\n");
     } else {
         LOG_WRITE(LOG_LEVEL_ERROR, "Couldn't read config file: %s. Exiting.\n", cfg_file_path);
@@ -382,7 +384,7 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    GC_Announces_List *group_announce = new_gca_list(mem);
+    GC_Announces_List *group_announce = new_gca_list(mem, rng);
 
     if (group_announce == nullptr) {
         LOG_WRITE(LOG_LEVEL_ERROR, "Couldn't initialize group announces. Exiting.\n");
@@ -494,9 +496,9 @@ int main(int argc, char *argv[])
             return 1;
         }
 
-        tcp_server = new_tcp_server(logger, mem, rng, ns, enable_ipv6,
-                                    tcp_relay_port_count, tcp_relay_ports,
-                                    dht_get_self_secret_key(dht), onion, forwarding);
+        tcp_server = new_tcp_server_threaded(logger, mem, rng, ns, enable_ipv6,
+                                             tcp_relay_port_count, tcp_relay_ports,
+                                             dht_get_self_secret_key(dht), onion, forwarding, tcp_relay_threads);
 
         free(tcp_relay_ports);
 
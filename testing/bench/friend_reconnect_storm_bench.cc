@@ -0,0 +1,128 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "../../testing/support/public/simulated_environment.hh"
+#include "../../toxcore/DHT_test_util.hh"
+#include "../../toxcore/crypto_core.h"
+#include "../../toxcore/friend_connection.h"
+#include "../../toxcore/logger.h"
+#include "../../toxcore/net_crypto.h"
+#include "../../toxcore/net_profile.h"
+#include "../../toxcore/onion_client.h"
+
+namespace {
+
+using tox::test::SimulatedEnvironment;
+using PublicKey = std::array<std::uint8_t, CRYPTO_PUBLIC_KEY_SIZE>;
+
+/** @brief A node with the connection layers below Messenger and many friends. */
+class StormNode {
+public:
+    StormNode(SimulatedEnvironment &env, std::uint16_t port)
+        : dht_(env, port)
+        , net_profile_(netprof_new(dht_.logger(), &dht_.node().c_memory),
+              [mem = &dht_.node().c_memory](Net_Profile *p) { netprof_kill(mem, p); })
+        , net_crypto_(nullptr, [](Net_Crypto *c) { kill_net_crypto(c); })
+        , onion_client_(nullptr, [](Onion_Client *c) { kill_onion_client(c); })
+        , friend_connections_(nullptr, [](Friend_Connections *c) { kill_friend_connections(c); })
+    {
+        TCP_Proxy_Info proxy_info = {{0}, TCP_PROXY_NONE};
+        net_crypto_.reset(new_net_crypto(dht_.logger(), &dht_.node().c_memory,
+            &dht_.node().c_random, &dht_.node().c_network, dht_.mono_time(), dht_.networking(),
+            dht_.get_dht(), &WrappedDHT::funcs, &proxy_info, net_profile_.get()));
+        onion_client_.reset(new_onion_client(dht_.logger(), &dht_.node().c_memory,
+            &dht_.node().c_random, dht_.mono_time(), net_crypto_.get(), dht_.get_dht(),
+            dht_.networking()));
+        friend_connections_.reset(new_friend_connections(dht_.logger(), &dht_.node().c_memory,
+            &dht_.node().c_random, dht_.mono_time(), &dht_.node().c_network, onion_client_.get(),
+            dht_.get_dht(), net_crypto_.get(), dht_.networking(), false));
+    }
+
+    bool ok() const { return friend_connections_ != nullptr; }
+    Net_Crypto *get_net_crypto() { return net_crypto_.get(); }
+    Friend_Connections *get_friend_connections() { return friend_connections_.get(); }
+
+private:
+    WrappedDHT dht_;
+    std::unique_ptr<Net_Profile, std::function<void(Net_Profile *)>> net_profile_;
+    std::unique_ptr<Net_Crypto, void (*)(Net_Crypto *)> net_crypto_;
+    std::unique_ptr<Onion_Client, void (*)(Onion_Client *)> onion_client_;
+    std::unique_ptr<Friend_Connections, void (*)(Friend_Connections *)> friend_connections_;
+};
+
+/**
+ * @brief All friends reconnect at once, e.g. after we come back from a restart
+ * or a network outage.
+ *
+ * For every friend, this does what an incoming handshake does: find the
+ * friend connection by the peer's real public key, then create the crypto
+ * connection, which first checks for an existing one with the same key. The
+ * connections are torn down again afterwards, outside the timed region. With
+ * linear lookups the time per friend grows with the friend count.
+ */
+void BM_ReconnectStorm(benchmark::State &state)
+{
+    const int num_friends = state.range(0);
+
+    SimulatedEnvironment env{12345};
+    StormNode node(env, 33445);
+
+    if (!node.ok()) {
+        state.SkipWithError("failed to create node");
+        return;
+    }
+
+    std::vector<PublicKey> real_pks(num_friends);
+    std::vector<PublicKey> dht_pks(num_friends);
+
+    for (int i = 0; i < num_friends; ++i) {
+        env.fake_random().bytes(real_pks[i].data(), real_pks[i].size());
+        env.fake_random().bytes(dht_pks[i].data(), dht_pks[i].size());
+
+        if (new_friend_connection(node.get_friend_connections(), real_pks[i].data()) == -1) {
+            state.SkipWithError("failed to add friend");
+            return;
+        }
+    }
+
+    std::vector<int> crypt_ids(num_friends);
+
+    for (auto _ : state) {
+        for (int i = 0; i < num_friends; ++i) {
+            const int friendcon_id
+                = getfriend_conn_id_pk(node.get_friend_connections(), real_pks[i].data());
+            benchmark::DoNotOptimize(friendcon_id);
+            crypt_ids[i]
+                = new_crypto_connection(node.get_net_crypto(), real_pks[i].data(), dht_pks[i].data());
+        }
+
+        state.PauseTiming();
+
+        for (const int id : crypt_ids) {
+            crypto_kill(node.get_net_crypto(), id);
+        }
+
+        state.ResumeTiming();
+    }
+
+    state.SetItemsProcessed(state.iterations() * num_friends);
+}
+BENCHMARK(BM_ReconnectStorm)
+    ->Arg(100)
+    ->Arg(1000)
+    ->Arg(5000)
+    ->Arg(10000)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
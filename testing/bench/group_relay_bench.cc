@@ -0,0 +1,432 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "../../testing/support/public/simulation.hh"
+#include "../../testing/support/public/tox_network.hh"
+#include "../../toxcore/crypto_core.h"
+#include "../../toxcore/group_chats.h"
+#include "../../toxcore/group_relay.h"
+#include "../../toxcore/logger.h"
+#include "../../toxcore/network.h"
+#include "../../toxcore/tox.h"
+#include "../../toxcore/tox_events.h"
+#include "../../toxcore/tox_private.h"
+
+namespace {
+
+using tox::test::ConnectedFriend;
+using tox::test::SimulatedNode;
+using tox::test::Simulation;
+
+using PublicKey = std::array<uint8_t, ENC_PUBLIC_KEY_SIZE>;
+
+/** @brief Length of the message text in each broadcast. */
+constexpr uint16_t kMessageLength = 100;
+/** @brief Broadcast type, message id and text of a group message. */
+constexpr uint16_t kBroadcastLength = 1 + sizeof(uint32_t) + kMessageLength;
+/** @brief What relaying adds to a broadcast: range end, sender key, message id, fanout and signature. */
+constexpr uint16_t kRelayOverhead
+    = ENC_PUBLIC_KEY_SIZE + ENC_PUBLIC_KEY_SIZE + sizeof(uint64_t) + 1 + CRYPTO_SIGNATURE_SIZE;
+
+/** @brief One-way latency of every link in the model, in ms. */
+constexpr double kLinkLatency = 50.0;
+/** @brief Upload speed of every peer in the model: 1 Mbit/s, in bytes per ms. */
+constexpr double kUplinkBytesPerMs = 125.0;
+
+/** @brief How one broadcast spread through the group in the model. */
+struct Delivery {
+    double mean_latency = 0;
+    double max_latency = 0;
+    uint32_t max_hops = 0;
+    uint32_t max_relay_packets = 0;
+    uint32_t missed = 0;
+};
+
+/**
+ * @brief Spreads a broadcast from peer 0 over the relay tree, or to everyone
+ * directly with a fanout of 0.
+ *
+ * Every peer knows every other peer. A peer sends to its children one after the
+ * other over its uplink, as soon as it has the broadcast itself.
+ */
+Delivery deliver(const std::vector<PublicKey> &keys, uint8_t fanout, uint16_t wire_size)
+{
+    const uint32_t n = static_cast<uint32_t>(keys.size());
+    const double send_time = wire_size / kUplinkBytesPerMs;
+
+    std::vector<double> arrival(n, -1.0);
+    std::vector<uint32_t> hops(n);
+    arrival[0] = 0;
+
+    Delivery delivery;
+
+    if (fanout == 0) {
+        for (uint32_t i = 1; i < n; ++i) {
+            arrival[i] = i * send_time + kLinkLatency;
+            hops[i] = 1;
+        }
+
+        delivery.max_relay_packets = n - 1;
+    } else {
+        struct Hop {
+            uint32_t peer;
+            const uint8_t *range_end;
+        };
+
+        std::vector<Hop> pending{{0, keys[0].data()}};
+        std::vector<GC_Relay_Target> targets;
+
+        while (!pending.empty()) {
+            const Hop hop = pending.back();
+            pending.pop_back();
+
+            targets.clear();
+
+            for (uint32_t i = 1; i < n; ++i) {
+                if (i != hop.peer) {
+                    targets.push_back({keys[i].data(), i, 0});
+                }
+            }
+
+            GC_Relay_Child children[GC_RELAY_MAX_FANOUT];
+            const uint16_t num_children = gc_relay_plan(keys[hop.peer].data(), hop.range_end,
+                targets.data(), static_cast<uint32_t>(targets.size()), fanout, children);
+
+            delivery.max_relay_packets = std::max<uint32_t>(delivery.max_relay_packets, num_children);
+
+            for (uint16_t i = 0; i < num_children; ++i) {
+                const uint32_t child = children[i].peer_number;
+                arrival[child] = arrival[hop.peer] + (i + 1) * send_time + kLinkLatency;
+                hops[child] = hops[hop.peer] + 1;
+                pending.push_back({child, children[i].range_end});
+            }
+        }
+    }
+
+    double total = 0;
+
+    for (uint32_t i = 1; i < n; ++i) {
+        if (arrival[i] < 0) {
+            ++delivery.missed;
+            continue;
+        }
+
+        total += arrival[i];
+        delivery.max_latency = std::max(delivery.max_latency, arrival[i]);
+        delivery.max_hops = std::max(delivery.max_hops, hops[i]);
+    }
+
+    delivery.mean_latency = total / (n - 1);
+    return delivery;
+}
+
+/**
+ * @brief What one group message costs its sender, and how long it takes to
+ * reach everyone, with and without a relay tree.
+ *
+ * Each iteration does the sender's work for one message: encrypting it for
+ * every peer with a fanout of 0, or signing it once, planning the tree and
+ * encrypting it for each child otherwise. The time per iteration is the
+ * sender's CPU cost.
+ *
+ * The delivery latency comes from a model of the group, since thousands of
+ * Tox instances don't fit in one simulation: every link has 50 ms latency and
+ * every peer a 1 Mbit/s uplink.
+ *
+ * Counters:
+ * - sent_packets, sent_bytes: what the sender puts on the wire per message.
+ * - mean_latency_ms, max_latency_ms: when the peers get the message.
+ * - max_hops: the depth of the tree.
+ * - max_relay_packets: the most packets any peer sends for one message.
+ *
+ * Args:
+ * - number of peers, including the sender,
+ * - fanout (0 = send to every peer).
+ */
+void BM_SendBroadcast(benchmark::State &state)
+{
+    const uint32_t num_peers = static_cast<uint32_t>(state.range(0));
+    const uint8_t fanout = static_cast<uint8_t>(state.range(1));
+
+    Simulation sim{12345};
+    auto node = sim.create_node();
+    const Memory *mem = &node->c_memory;
+    const Random *rng = &node->c_random;
+    std::unique_ptr<Logger, decltype(&logger_kill)> log(logger_new(mem), logger_kill);
+
+    Extended_Public_Key self_pk;
+    Extended_Secret_Key self_sk;
+
+    if (log == nullptr || !create_extended_keypair(&self_pk, &self_sk, rng)) {
+        state.SkipWithError("failed to set up the sender");
+        return;
+    }
+
+    // Peer 0 is the sender, the others get random keys and shared keys.
+    std::mt19937 gen(num_peers);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::vector<PublicKey> keys(num_peers);
+    std::vector<std::array<uint8_t, CRYPTO_SHARED_KEY_SIZE>> shared_keys(num_peers);
+    std::memcpy(keys[0].data(), get_enc_key(&self_pk), ENC_PUBLIC_KEY_SIZE);
+
+    for (uint32_t i = 1; i < num_peers; ++i) {
+        for (uint8_t &b : keys[i]) {
+            b = static_cast<uint8_t>(byte(gen));
+        }
+
+        for (uint8_t &b : shared_keys[i]) {
+            b = static_cast<uint8_t>(byte(gen));
+        }
+    }
+
+    std::array<uint8_t, kBroadcastLength> broadcast{};
+    broadcast[0] = GM_PLAIN_MESSAGE;
+
+    const uint16_t payload_length = fanout == 0 ? kBroadcastLength : kBroadcastLength + kRelayOverhead;
+    const uint16_t wire_size = gc_get_wrapped_packet_size(payload_length, NET_PACKET_GC_LOSSLESS);
+    std::vector<uint8_t> relayed(kBroadcastLength + kRelayOverhead);
+    std::vector<uint8_t> packet(wire_size);
+    std::vector<GC_Relay_Target> targets(num_peers);
+
+    uint64_t sent_packets = 0;
+    uint64_t message_id = 0;
+
+    for (auto _ : state) {
+        sent_packets = 0;
+        ++message_id;
+
+        if (fanout == 0) {
+            for (uint32_t i = 1; i < num_peers; ++i) {
+                if (group_packet_wrap(log.get(), mem, rng, keys[0].data(), shared_keys[i].data(),
+                        packet.data(), wire_size, broadcast.data(), kBroadcastLength, message_id,
+                        GP_BROADCAST, NET_PACKET_GC_LOSSLESS)
+                    > 0) {
+                    ++sent_packets;
+                }
+            }
+
+            continue;
+        }
+
+        uint8_t *header = relayed.data();
+        std::memcpy(header, keys[0].data(), ENC_PUBLIC_KEY_SIZE);
+        std::memcpy(header + ENC_PUBLIC_KEY_SIZE, keys[0].data(), ENC_PUBLIC_KEY_SIZE);
+        std::memcpy(header + 2 * ENC_PUBLIC_KEY_SIZE, &message_id, sizeof(message_id));
+        header[2 * ENC_PUBLIC_KEY_SIZE + sizeof(uint64_t)] = fanout;
+        std::memcpy(header + kRelayOverhead - CRYPTO_SIGNATURE_SIZE, broadcast.data(), kBroadcastLength);
+        crypto_signature_create(relayed.data() + relayed.size() - CRYPTO_SIGNATURE_SIZE,
+            relayed.data() + ENC_PUBLIC_KEY_SIZE,
+            relayed.size() - ENC_PUBLIC_KEY_SIZE - CRYPTO_SIGNATURE_SIZE, get_sig_sk(&self_sk));
+
+        for (uint32_t i = 1; i < num_peers; ++i) {
+            targets[i - 1] = {keys[i].data(), i, 0};
+        }
+
+        GC_Relay_Child children[GC_RELAY_MAX_FANOUT];
+        const uint16_t num_children = gc_relay_plan(
+            keys[0].data(), keys[0].data(), targets.data(), num_peers - 1, fanout, children);
+
+        for (uint16_t i = 0; i < num_children; ++i) {
+            std::memcpy(relayed.data(), children[i].range_end, ENC_PUBLIC_KEY_SIZE);
+
+            if (group_packet_wrap(log.get(), mem, rng, keys[0].data(),
+                    shared_keys[children[i].peer_number].data(), packet.data(), wire_size,
+                    relayed.data(), static_cast<uint16_t>(relayed.size()), message_id,
+                    GP_RELAYED_BROADCAST, NET_PACKET_GC_LOSSLESS)
+                > 0) {
+                ++sent_packets;
+            }
+        }
+    }
+
+    const Delivery delivery = deliver(keys, fanout, wire_size);
+
+    if (delivery.missed != 0) {
+        state.SkipWithError("the broadcast didn't reach every peer");
+        return;
+    }
+
+    state.counters["sent_packets"] = static_cast<double>(sent_packets);
+    state.counters["sent_bytes"] = benchmark::Counter(static_cast<double>(sent_packets * wire_size),
+        benchmark::Counter::kDefaults, benchmark::Counter::OneK::kIs1024);
+    state.counters["mean_latency_ms"] = delivery.mean_latency;
+    state.counters["max_latency_ms"] = delivery.max_latency;
+    state.counters["max_hops"] = delivery.max_hops;
+    state.counters["max_relay_packets"] = delivery.max_relay_packets;
+}
+
+BENCHMARK(BM_SendBroadcast)
+    ->ArgNames({"peers", "fanout"})
+    ->ArgsProduct({{50, 500, 5000}, {0, 4, 8}})
+    ->Unit(benchmark::kMicrosecond);
+
+/**
+ * @brief Sends group messages through real Tox instances in the simulation, with
+ * and without a relay tree.
+ *
+ * Checks that every peer gets each message exactly once, and measures what the
+ * sender puts on the wire while the message spreads.
+ *
+ * Counters:
+ * - sender_bytes: bytes the sender sends until everyone has the message.
+ * - latency_ms: simulated time until the last peer has the message.
+ *
+ * Args:
+ * - number of peers, including the sender,
+ * - fanout (0 = send to every peer).
+ */
+void BM_GroupMessage(benchmark::State &state)
+{
+    const int num_friends = static_cast<int>(state.range(0)) - 1;
+    const uint8_t fanout = static_cast<uint8_t>(state.range(1));
+
+    Simulation sim{12345};
+    sim.net().set_latency(5);
+    auto main_node = sim.create_node();
+
+    auto opts = std::unique_ptr<Tox_Options, decltype(&tox_options_free)>(
+        tox_options_new(nullptr), tox_options_free);
+    tox_options_set_ipv6_enabled(opts.get(), false);
+    tox_options_set_local_discovery_enabled(opts.get(), false);
+
+    auto main_tox = main_node->create_tox(opts.get());
+    std::vector<ConnectedFriend> friends
+        = setup_connected_friends(sim, main_tox.get(), *main_node, num_friends, opts.get());
+    const uint32_t group_number = setup_connected_group(sim, main_tox.get(), friends);
+
+    if (friends.size() != static_cast<std::size_t>(num_friends) || group_number == UINT32_MAX
+        || !tox_group_set_relay_fanout(main_tox.get(), group_number, fanout, nullptr)) {
+        state.SkipWithError("failed to set up the group");
+        return;
+    }
+
+    // Give the friends time to connect to each other, not just to the sender.
+    sim.run_until(
+        [&]() {
+            tox_iterate(main_tox.get(), nullptr);
+
+            for (ConnectedFriend &f : friends) {
+                f.runner->poll_events();
+            }
+
+            return false;
+        },
+        20000);
+
+    std::atomic<uint64_t> sender_bytes{0};
+    const IP main_ip = main_node->ip;
+    sim.net().add_filter([&](tox::test::Packet &p) {
+        if (ip_equal(&p.from.ip, &main_ip)) {
+            sender_bytes += p.data.size();
+        }
+        return true;
+    });
+
+    const uint8_t message[kMessageLength] = {0};
+    uint64_t total_bytes = 0;
+    uint64_t total_latency = 0;
+    uint64_t duplicates = 0;
+    uint64_t messages = 0;
+
+    for (auto _ : state) {
+        sender_bytes = 0;
+        const uint64_t start = sim.clock().current_time_ms();
+        std::vector<uint32_t> received(friends.size());
+
+        tox_group_send_message(main_tox.get(), group_number, TOX_MESSAGE_TYPE_NORMAL, message,
+            sizeof(message), nullptr);
+
+        bool everyone = false;
+        sim.run_until(
+            [&]() {
+                tox_iterate(main_tox.get(), nullptr);
+                everyone = true;
+
+                for (std::size_t i = 0; i < friends.size(); ++i) {
+                    for (const auto &batch : friends[i].runner->poll_events()) {
+                        const uint32_t size = tox_events_get_size(batch.get());
+
+                        for (uint32_t k = 0; k < size; ++k) {
+                            if (tox_event_get_type(tox_events_get(batch.get(), k))
+                                == TOX_EVENT_GROUP_MESSAGE) {
+                                ++received[i];
+                            }
+                        }
+                    }
+
+                    everyone = everyone && received[i] > 0;
+                }
+
+                return everyone;
+            },
+            10000);
+
+        if (!everyone) {
+            state.SkipWithError("the message didn't reach every peer");
+            return;
+        }
+
+        total_latency += sim.clock().current_time_ms() - start;
+        total_bytes += sender_bytes;
+
+        // Let acks and stray duplicates arrive before the next message.
+        sim.run_until(
+            [&]() {
+                tox_iterate(main_tox.get(), nullptr);
+
+                for (std::size_t i = 0; i < friends.size(); ++i) {
+                    for (const auto &batch : friends[i].runner->poll_events()) {
+                        const uint32_t size = tox_events_get_size(batch.get());
+
+                        for (uint32_t k = 0; k < size; ++k) {
+                            if (tox_event_get_type(tox_events_get(batch.get(), k))
+                                == TOX_EVENT_GROUP_MESSAGE) {
+                                ++received[i];
+                            }
+                        }
+                    }
+                }
+
+                return false;
+            },
+            500);
+
+        for (const uint32_t count : received) {
+            duplicates += count - 1;
+        }
+
+        ++messages;
+    }
+
+    if (duplicates != 0) {
+        state.SkipWithError("some peers got a message more than once");
+        return;
+    }
+
+    state.counters["sender_bytes"] = benchmark::Counter(static_cast<double>(total_bytes) / messages,
+        benchmark::Counter::kDefaults, benchmark::Counter::OneK::kIs1024);
+    state.counters["latency_ms"] = static_cast<double>(total_latency) / messages;
+}
+
+BENCHMARK(BM_GroupMessage)
+    ->ArgNames({"peers", "fanout"})
+    ->ArgsProduct({{16}, {0, 2}})
+    ->Iterations(5)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
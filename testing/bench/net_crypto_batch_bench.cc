@@ -0,0 +1,202 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "../../testing/support/public/simulated_environment.hh"
+#include "../../toxcore/DHT_test_util.hh"
+#include "../../toxcore/crypto_core.h"
+#include "../../toxcore/logger.h"
+#include "../../toxcore/net_crypto.h"
+#include "../../toxcore/net_profile.h"
+#include "../../toxcore/network.h"
+
+namespace {
+
+using tox::test::SimulatedEnvironment;
+
+/** @brief Packets each sender queues per iteration. */
+constexpr int kPacketsPerConnection = 32;
+/** @brief Size of each lossless packet, including the packet id. */
+constexpr std::size_t kPacketSize = 1000;
+
+/** @brief A net_crypto node that counts the lossless packets it receives. */
+class BatchNode {
+public:
+    BatchNode(SimulatedEnvironment &env, std::uint16_t port)
+        : dht_(env, port)
+        , net_profile_(netprof_new(dht_.logger(), &dht_.node().c_memory),
+              [mem = &dht_.node().c_memory](Net_Profile *p) { netprof_kill(mem, p); })
+        , net_crypto_(nullptr, [](Net_Crypto *c) { kill_net_crypto(c); })
+    {
+        TCP_Proxy_Info proxy_info = {{0}, TCP_PROXY_NONE};
+        net_crypto_.reset(new_net_crypto(dht_.logger(), &dht_.node().c_memory,
+            &dht_.node().c_random, &dht_.node().c_network, dht_.mono_time(), dht_.networking(),
+            dht_.get_dht(), &WrappedMockDHT::funcs, &proxy_info, net_profile_.get()));
+        new_connection_handler(net_crypto_.get(), &BatchNode::accept_cb, this);
+    }
+
+    Net_Crypto *get_net_crypto() { return net_crypto_.get(); }
+    const std::uint8_t *dht_public_key() const { return dht_.dht_public_key(); }
+    const std::uint8_t *real_public_key() const { return nc_get_self_public_key(net_crypto_.get()); }
+    IP_Port get_ip_port() const { return dht_.get_ip_port(); }
+
+    void poll()
+    {
+        dht_.poll();
+        do_net_crypto(net_crypto_.get(), nullptr);
+    }
+
+    int connect_to(BatchNode &other)
+    {
+        const int id = new_crypto_connection(
+            net_crypto_.get(), other.real_public_key(), other.dht_public_key());
+        if (id != -1) {
+            IP_Port addr = other.get_ip_port();
+            set_direct_ip_port(net_crypto_.get(), id, &addr, true);
+            watch(id);
+        }
+        return id;
+    }
+
+    std::size_t num_established() const
+    {
+        std::size_t count = 0;
+        for (const bool e : established_) {
+            count += e ? 1 : 0;
+        }
+        return count;
+    }
+    std::uint64_t received() const { return received_; }
+
+private:
+    void watch(int id)
+    {
+        if (static_cast<std::size_t>(id) >= established_.size()) {
+            established_.resize(id + 1);
+        }
+        connection_status_handler(net_crypto_.get(), id, &BatchNode::status_cb, this, id);
+        connection_data_handler(net_crypto_.get(), id, &BatchNode::data_cb, this, id);
+    }
+
+    static int status_cb(void *object, int id, bool status, void *userdata)
+    {
+        static_cast<BatchNode *>(object)->established_[id] = status;
+        return 0;
+    }
+
+    static int data_cb(void *object, int id, const std::uint8_t *data, std::uint16_t length, void *userdata)
+    {
+        ++static_cast<BatchNode *>(object)->received_;
+        return 0;
+    }
+
+    static int accept_cb(void *object, const New_Connection *n_c)
+    {
+        auto *self = static_cast<BatchNode *>(object);
+        const int id = accept_crypto_connection(self->net_crypto_.get(), n_c);
+        if (id != -1) {
+            self->watch(id);
+        }
+        return id;
+    }
+
+    WrappedMockDHT dht_;
+    std::unique_ptr<Net_Profile, std::function<void(Net_Profile *)>> net_profile_;
+    std::unique_ptr<Net_Crypto, void (*)(Net_Crypto *)> net_crypto_;
+    std::vector<bool> established_;
+    std::uint64_t received_ = 0;
+};
+
+/**
+ * @brief Receive throughput of one node with data coming in on many
+ * connections at once.
+ *
+ * Each sender has one connection to the receiver and queues
+ * kPacketsPerConnection lossless packets per iteration. Only the receiver's
+ * poll is timed: reading the packets from the socket, decrypting them and
+ * handling them, plus sending its acknowledgements.
+ *
+ * range(0): connections (one sender node each).
+ * range(1): decryption mode. -1 decrypts each packet as it is read (the
+ *   default); 0 decrypts each poll's packets as a batch on the polling thread;
+ *   N > 0 spreads each batch over N worker threads.
+ */
+void BM_ReceiveThroughput(benchmark::State &state)
+{
+    const auto num_connections = static_cast<std::size_t>(state.range(0));
+    const int mode = static_cast<int>(state.range(1));
+
+    SimulatedEnvironment env{12345};
+    BatchNode receiver(env, 33445);
+
+    if (mode >= 0
+        && !net_crypto_set_batch_decrypt(receiver.get_net_crypto(), true, static_cast<std::uint16_t>(mode))) {
+        state.SkipWithError("failed to enable batched decryption");
+        return;
+    }
+
+    std::vector<std::unique_ptr<BatchNode>> senders;
+    std::vector<int> conn_ids;
+
+    for (std::size_t i = 0; i < num_connections; ++i) {
+        senders.push_back(std::make_unique<BatchNode>(env, static_cast<std::uint16_t>(33446 + i)));
+        conn_ids.push_back(senders.back()->connect_to(receiver));
+    }
+
+    for (int i = 0; i < 500 && receiver.num_established() < num_connections; ++i) {
+        for (auto &sender : senders) {
+            sender->poll();
+        }
+        receiver.poll();
+        env.advance_time(10);
+    }
+
+    if (receiver.num_established() < num_connections) {
+        state.SkipWithError("failed to establish connections");
+        return;
+    }
+
+    std::vector<std::uint8_t> data(kPacketSize, 'A');
+    data[0] = PACKET_ID_RANGE_LOSSLESS_CUSTOM_START;
+
+    const std::uint64_t received_before = receiver.received();
+
+    for (auto _ : state) {
+        state.PauseTiming();
+
+        for (std::size_t i = 0; i < num_connections; ++i) {
+            for (int p = 0; p < kPacketsPerConnection; ++p) {
+                write_cryptpacket(senders[i]->get_net_crypto(), conn_ids[i], data.data(), data.size(), false);
+            }
+            senders[i]->poll();
+        }
+
+        env.advance_time(10);
+        state.ResumeTiming();
+
+        receiver.poll();
+    }
+
+    const std::uint64_t received = receiver.received() - received_before;
+    state.SetItemsProcessed(static_cast<std::int64_t>(received));
+    state.SetBytesProcessed(static_cast<std::int64_t>(received * kPacketSize));
+    state.counters["delivered%"] = 100.0 * static_cast<double>(received)
+        / static_cast<double>(state.iterations() * num_connections * kPacketsPerConnection);
+}
+
+BENCHMARK(BM_ReceiveThroughput)
+    ->ArgNames({"conns", "workers"})
+    ->ArgsProduct({{1, 8, 32}, {-1, 0, 2, 4}})
+    ->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
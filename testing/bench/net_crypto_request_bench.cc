@@ -0,0 +1,214 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "../../testing/support/public/simulated_environment.hh"
+#include "../../toxcore/DHT_test_util.hh"
+#include "../../toxcore/crypto_core.h"
+#include "../../toxcore/logger.h"
+#include "../../toxcore/net_crypto.h"
+#include "../../toxcore/net_profile.h"
+#include "../../toxcore/network.h"
+
+namespace {
+
+using tox::test::SimulatedEnvironment;
+
+/** @brief Size of each lossless packet, including the packet id. */
+constexpr std::size_t kPacketSize = 1000;
+/** @brief Rounds run before timing starts, so SACK negotiation is done. */
+constexpr int kWarmupRounds = 20;
+/** @brief Packets sent between two receiver polls while filling the window. */
+constexpr int kFillChunk = 256;
+
+/** @brief A net_crypto node with a single connection. */
+class RequestNode {
+public:
+    RequestNode(SimulatedEnvironment &env, std::uint16_t port)
+        : dht_(env, port)
+        , net_profile_(netprof_new(dht_.logger(), &dht_.node().c_memory),
+              [mem = &dht_.node().c_memory](Net_Profile *p) { netprof_kill(mem, p); })
+        , net_crypto_(nullptr, [](Net_Crypto *c) { kill_net_crypto(c); })
+    {
+        TCP_Proxy_Info proxy_info = {{0}, TCP_PROXY_NONE};
+        net_crypto_.reset(new_net_crypto(dht_.logger(), &dht_.node().c_memory,
+            &dht_.node().c_random, &dht_.node().c_network, dht_.mono_time(), dht_.networking(),
+            dht_.get_dht(), &WrappedMockDHT::funcs, &proxy_info, net_profile_.get()));
+        new_connection_handler(net_crypto_.get(), &RequestNode::accept_cb, this);
+    }
+
+    Net_Crypto *get_net_crypto() { return net_crypto_.get(); }
+    const std::uint8_t *dht_public_key() const { return dht_.dht_public_key(); }
+    const std::uint8_t *real_public_key() const { return nc_get_self_public_key(net_crypto_.get()); }
+    IP_Port get_ip_port() const { return dht_.get_ip_port(); }
+
+    void poll()
+    {
+        dht_.poll();
+        do_net_crypto(net_crypto_.get(), nullptr);
+    }
+
+    int connect_to(RequestNode &other)
+    {
+        const int id = new_crypto_connection(
+            net_crypto_.get(), other.real_public_key(), other.dht_public_key());
+        if (id != -1) {
+            IP_Port addr = other.get_ip_port();
+            set_direct_ip_port(net_crypto_.get(), id, &addr, true);
+            watch(id);
+        }
+        return id;
+    }
+
+    bool established() const { return established_; }
+    int conn_id() const { return conn_id_; }
+
+private:
+    void watch(int id)
+    {
+        conn_id_ = id;
+        connection_status_handler(net_crypto_.get(), id, &RequestNode::status_cb, this, id);
+    }
+
+    static int status_cb(void *object, int id, bool status, void *userdata)
+    {
+        static_cast<RequestNode *>(object)->established_ = status;
+        return 0;
+    }
+
+    static int accept_cb(void *object, const New_Connection *n_c)
+    {
+        auto *self = static_cast<RequestNode *>(object);
+        const int id = accept_crypto_connection(self->net_crypto_.get(), n_c);
+        if (id != -1) {
+            self->watch(id);
+        }
+        return id;
+    }
+
+    WrappedMockDHT dht_;
+    std::unique_ptr<Net_Profile, std::function<void(Net_Profile *)>> net_profile_;
+    std::unique_ptr<Net_Crypto, void (*)(Net_Crypto *)> net_crypto_;
+    bool established_ = false;
+    int conn_id_ = -1;
+};
+
+/**
+ * @brief Cost of asking for and handling lost packets.
+ *
+ * The sender fills its send window with lossless packets, a fraction of which
+ * never arrive. After that, no data packet gets through anymore, so both
+ * windows stay as they are and every round does the same work: the receiver
+ * builds a request for the missing packets, and the sender frees what was
+ * acknowledged and marks the rest for resending. Each iteration times one
+ * such round: both nodes' polls after the request interval has passed.
+ *
+ * range(0): packets in the window.
+ * range(1): loss in per mille.
+ * range(2): 1 to use selective (range) requests, 0 for classic ones.
+ */
+void BM_RequestProcessing(benchmark::State &state)
+{
+    const auto window = static_cast<int>(state.range(0));
+    const double loss = static_cast<double>(state.range(1)) / 1000.0;
+    const bool sack = state.range(2) != 0;
+
+    SimulatedEnvironment env{12345};
+    RequestNode sender(env, 33445);
+    RequestNode receiver(env, 33446);
+    const std::uint16_t receiver_port = receiver.get_ip_port().port;
+    const std::uint16_t sender_port = sender.get_ip_port().port;
+
+    net_crypto_set_sack_requests(sender.get_net_crypto(), sack);
+    net_crypto_set_sack_requests(receiver.get_net_crypto(), sack);
+
+    const int conn_id = sender.connect_to(receiver);
+
+    for (int i = 0; i < 500 && !(sender.established() && receiver.established()); ++i) {
+        sender.poll();
+        receiver.poll();
+        env.advance_time(10);
+    }
+
+    if (!sender.established() || !receiver.established()) {
+        state.SkipWithError("failed to establish connection");
+        return;
+    }
+
+    std::minstd_rand rng(1);
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    bool block_data = false;
+    std::uint64_t request_bytes = 0;
+
+    env.simulation().net().add_filter([&](tox::test::Packet &p) {
+        if (p.data.empty() || p.data[0] != NET_PACKET_CRYPTO_DATA) {
+            return true;
+        }
+        if (p.to.port == receiver_port && p.data.size() > kPacketSize / 2) {
+            return !block_data && dist(rng) >= loss;
+        }
+        if (p.to.port == sender_port) {
+            request_bytes += p.data.size();
+        }
+        return true;
+    });
+
+    std::vector<std::uint8_t> data(kPacketSize, 'A');
+    data[0] = PACKET_ID_RANGE_LOSSLESS_CUSTOM_START;
+
+    for (int i = 0; i < window; ++i) {
+        if (write_cryptpacket(sender.get_net_crypto(), conn_id, data.data(), data.size(), false) == -1) {
+            state.SkipWithError("failed to fill the send window");
+            return;
+        }
+
+        // Deliver and drain before the receiver's socket queue overflows.
+        if (i % kFillChunk == kFillChunk - 1 || i == window - 1) {
+            env.advance_time(1);
+            receiver.poll();
+        }
+    }
+
+    block_data = true;
+
+    const auto round = [&]() {
+        env.advance_time(CRYPTO_SEND_PACKET_INTERVAL);
+        receiver.poll();
+        sender.poll();
+    };
+
+    for (int i = 0; i < kWarmupRounds; ++i) {
+        round();
+    }
+
+    if (sack && !nc_testonly_peer_sack(sender.get_net_crypto(), conn_id)) {
+        state.SkipWithError("selective requests were not negotiated");
+        return;
+    }
+
+    request_bytes = 0;
+
+    for (auto _ : state) {
+        round();
+    }
+
+    state.counters["request_bytes_per_round"]
+        = static_cast<double>(request_bytes) / static_cast<double>(state.iterations());
+}
+
+BENCHMARK(BM_RequestProcessing)
+    ->ArgNames({"window", "loss_permille", "sack"})
+    ->ArgsProduct({{1024, 8192, 30000}, {0, 10, 100}, {0, 1}});
+
+}  // namespace
+
+BENCHMARK_MAIN();
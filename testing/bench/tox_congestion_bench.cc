@@ -0,0 +1,207 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "../../testing/support/public/simulation.hh"
+#include "../../toxcore/network.h"
+#include "../../toxcore/tox.h"
+
+namespace {
+
+using tox::test::Simulation;
+
+struct SenderContext {
+    const std::vector<uint8_t> *data = nullptr;
+};
+
+struct ReceiverContext {
+    uint64_t received = 0;
+    bool done = false;
+};
+
+/**
+ * @brief Send a file over a simulated link and measure the goodput.
+ *
+ * Args:
+ * - congestion control algorithm (a Tox_Congestion_Control value),
+ * - one-way latency in ms,
+ * - UDP packet loss in per mille,
+ * - uplink bandwidth in KiB/s, with a 200ms drop-tail queue.
+ *
+ * The link conditions apply once the friends are connected, so only the
+ * transfer itself is measured.
+ */
+void BM_CongestionControlGoodput(benchmark::State &state)
+{
+    const auto algorithm = static_cast<Tox_Congestion_Control>(state.range(0));
+    const uint64_t latency_ms = static_cast<uint64_t>(state.range(1));
+    const double loss = static_cast<double>(state.range(2)) / 1000.0;
+    const uint64_t bandwidth = static_cast<uint64_t>(state.range(3)) * 1024;
+    constexpr std::size_t kFileSize = 1024 * 1024;
+
+    Simulation sim{12345};
+    auto node1 = sim.create_node();
+    auto node2 = sim.create_node();
+
+    auto opts1 = std::unique_ptr<Tox_Options, decltype(&tox_options_free)>(
+        tox_options_new(nullptr), tox_options_free);
+    tox_options_set_log_user_data(opts1.get(), const_cast<char *>("Tox1"));
+    tox_options_set_ipv6_enabled(opts1.get(), false);
+    tox_options_set_local_discovery_enabled(opts1.get(), false);
+    tox_options_set_experimental_congestion_control(opts1.get(), algorithm);
+
+    auto opts2 = std::unique_ptr<Tox_Options, decltype(&tox_options_free)>(
+        tox_options_new(nullptr), tox_options_free);
+    tox_options_set_log_user_data(opts2.get(), const_cast<char *>("Tox2"));
+    tox_options_set_ipv6_enabled(opts2.get(), false);
+    tox_options_set_local_discovery_enabled(opts2.get(), false);
+    tox_options_set_experimental_congestion_control(opts2.get(), algorithm);
+
+    auto tox1 = node1->create_tox(opts1.get());
+    auto tox2 = node2->create_tox(opts2.get());
+
+    if (!tox1 || !tox2) {
+        state.SkipWithError("Failed to create Tox instances");
+        return;
+    }
+
+    uint8_t tox1_pk[TOX_PUBLIC_KEY_SIZE];
+    tox_self_get_public_key(tox1.get(), tox1_pk);
+    uint8_t tox2_pk[TOX_PUBLIC_KEY_SIZE];
+    tox_self_get_public_key(tox2.get(), tox2_pk);
+
+    uint8_t tox1_dht_id[TOX_PUBLIC_KEY_SIZE];
+    tox_self_get_dht_id(tox1.get(), tox1_dht_id);
+    uint8_t tox2_dht_id[TOX_PUBLIC_KEY_SIZE];
+    tox_self_get_dht_id(tox2.get(), tox2_dht_id);
+
+    Tox_Err_Friend_Add friend_add_err;
+    uint32_t f1 = tox_friend_add_norequest(tox1.get(), tox2_pk, &friend_add_err);
+    uint32_t f2 = tox_friend_add_norequest(tox2.get(), tox1_pk, &friend_add_err);
+
+    uint16_t port1 = node1->get_primary_socket()->local_port();
+    uint16_t port2 = node2->get_primary_socket()->local_port();
+
+    char ip1[TOX_INET6_ADDRSTRLEN];
+    ip_parse_addr(&node1->ip, ip1, sizeof(ip1));
+    char ip2[TOX_INET6_ADDRSTRLEN];
+    ip_parse_addr(&node2->ip, ip2, sizeof(ip2));
+
+    tox_bootstrap(tox2.get(), ip1, port1, tox1_dht_id, nullptr);
+    tox_bootstrap(tox1.get(), ip2, port2, tox2_dht_id, nullptr);
+
+    bool connected = false;
+    sim.run_until(
+        [&]() {
+            tox_iterate(tox1.get(), nullptr);
+            tox_iterate(tox2.get(), nullptr);
+            sim.advance_time(90);  // +10ms from run_until = 100ms
+            connected
+                = (tox_friend_get_connection_status(tox1.get(), f1, nullptr) == TOX_CONNECTION_UDP
+                    && tox_friend_get_connection_status(tox2.get(), f2, nullptr)
+                        == TOX_CONNECTION_UDP);
+            return connected;
+        },
+        60000);
+
+    if (!connected) {
+        state.SkipWithError("Failed to connect toxes over UDP within 60s");
+        return;
+    }
+
+    sim.net().set_latency(latency_ms);
+    sim.net().set_packet_loss(loss);
+    sim.net().set_bandwidth(bandwidth, 200);
+
+    const std::vector<uint8_t> file_data(kFileSize, 0x5a);
+    SenderContext sender;
+    sender.data = &file_data;
+    ReceiverContext receiver;
+
+    tox_callback_file_chunk_request(tox1.get(),
+        [](Tox *tox, uint32_t friend_number, uint32_t file_number, uint64_t position,
+            std::size_t length, void *user_data) {
+            if (length == 0) {
+                return;
+            }
+            const auto *ctx = static_cast<SenderContext *>(user_data);
+            tox_file_send_chunk(tox, friend_number, file_number, position,
+                ctx->data->data() + position, length, nullptr);
+        });
+    tox_callback_file_recv(tox2.get(),
+        [](Tox *tox, uint32_t friend_number, uint32_t file_number, uint32_t, uint64_t,
+            const uint8_t *, std::size_t, void *) {
+            tox_file_control(tox, friend_number, file_number, TOX_FILE_CONTROL_RESUME, nullptr);
+        });
+    tox_callback_file_recv_chunk(tox2.get(),
+        [](Tox *, uint32_t, uint32_t, uint64_t, const uint8_t *, std::size_t length,
+            void *user_data) {
+            auto *ctx = static_cast<ReceiverContext *>(user_data);
+            ctx->received += length;
+            if (length == 0) {
+                ctx->done = true;
+            }
+        });
+
+    uint64_t sim_ms = 0;
+    uint64_t files = 0;
+
+    for (auto _ : state) {
+        receiver = ReceiverContext();
+        const uint32_t file_number = tox_file_send(tox1.get(), f1, TOX_FILE_KIND_DATA, kFileSize,
+            nullptr, reinterpret_cast<const uint8_t *>("bench"), 5, nullptr);
+
+        if (file_number == UINT32_MAX) {
+            state.SkipWithError("tox_file_send failed");
+            return;
+        }
+
+        const uint64_t start = sim.clock().current_time_ms();
+
+        while (!receiver.done && sim.clock().current_time_ms() - start < 600000) {
+            sim.advance_time(1);
+            tox_iterate(tox1.get(), &sender);
+            tox_iterate(tox2.get(), &receiver);
+        }
+
+        if (receiver.received != kFileSize) {
+            state.SkipWithError("file transfer did not complete");
+            return;
+        }
+
+        sim_ms += sim.clock().current_time_ms() - start;
+        ++files;
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(files * kFileSize));
+    state.counters["sim_ms_per_file"]
+        = benchmark::Counter(static_cast<double>(sim_ms) / static_cast<double>(files));
+    state.counters["goodput_bytes_per_second"] = benchmark::Counter(
+        static_cast<double>(files * kFileSize) * 1000.0 / static_cast<double>(sim_ms),
+        benchmark::Counter::kDefaults, benchmark::Counter::OneK::kIs1024);
+    state.counters["link_utilisation"] = benchmark::Counter(
+        static_cast<double>(files * kFileSize) * 1000.0 / static_cast<double>(sim_ms)
+        / static_cast<double>(bandwidth));
+}
+
+BENCHMARK(BM_CongestionControlGoodput)
+    ->ArgNames({"cc", "latency_ms", "loss_permille", "kib_per_s"})
+    ->ArgsProduct({
+        {TOX_CONGESTION_CONTROL_QUEUE, TOX_CONGESTION_CONTROL_DELAY},
+        {10, 100},
+        {0, 20},
+        {512},
+    })
+    ->Iterations(3)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
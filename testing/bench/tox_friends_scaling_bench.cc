@@ -22,6 +22,17 @@ using tox::test::Simulation;
 
 // --- Helper Contexts ---
 
+/** @brief Bytes allocated by the node between `before` and now, divided by `num_friends`. */
+double memory_per_friend(SimulatedNode &node, std::size_t before, int num_friends)
+{
+    if (num_friends == 0) {
+        return 0;
+    }
+
+    const std::size_t after = node.fake_memory().current_allocation();
+    return after > before ? static_cast<double>(after - before) / num_friends : 0;
+}
+
 struct GroupContext {
     uint32_t peer_count = 0;
     uint32_t group_number = UINT32_MAX;
@@ -46,6 +57,8 @@ public:
         main_node = sim->create_node();
         main_tox = main_node->create_tox();
 
+        const std::size_t mem_before = main_node->fake_memory().current_allocation();
+
         for (int i = 0; i < num_friends; ++i) {
             auto node = sim->create_node();
             auto tox = node->create_tox();
@@ -59,6 +72,8 @@ public:
             friend_nodes.push_back(std::move(node));
             friend_toxes.push_back(std::move(tox));
         }
+
+        mem_per_friend = memory_per_friend(*main_node, mem_before, num_friends);
     }
 
 protected:
@@ -67,6 +82,7 @@ protected:
     SimulatedNode::ToxPtr main_tox;
     std::vector<std::unique_ptr<SimulatedNode>> friend_nodes;
     std::vector<SimulatedNode::ToxPtr> friend_toxes;
+    double mem_per_friend = 0;
 };
 
 // --- Contexts for Shared State Benchmarks ---
@@ -149,6 +165,8 @@ public:
             std::abort();
         }
 
+        const std::size_t mem_before = main_node->fake_memory().current_allocation();
+
         for (int i = 0; i < num_friends; ++i) {
             // Add friend but don't create a node for them -> they are offline
             uint8_t friend_pk[TOX_PUBLIC_KEY_SIZE];
@@ -158,6 +176,8 @@ public:
             Tox_Err_Friend_Add err;
             tox_friend_add_norequest(main_tox.get(), friend_pk, &err);
         }
+
+        mem_per_friend = memory_per_friend(*main_node, mem_before, num_friends);
     }
 
 protected:
@@ -166,6 +186,7 @@ protected:
     SimulatedNode::ToxPtr main_tox;
     std::unique_ptr<SimulatedNode> bootstrap_node;
     SimulatedNode::ToxPtr bootstrap_tox;
+    double mem_per_friend = 0;
 };
 
 BENCHMARK_DEFINE_F(ToxOnlineDisconnectedScalingFixture, Iterate)(benchmark::State &state)
@@ -186,6 +207,8 @@ BENCHMARK_DEFINE_F(ToxOnlineDisconnectedScalingFixture, Iterate)(benchmark::Stat
     state.counters["mem_current"]
         = benchmark::Counter(static_cast<double>(main_node->fake_memory().current_allocation()),
             benchmark::Counter::kDefaults, benchmark::Counter::OneK::kIs1024);
+    state.counters["mem_per_friend"] = benchmark::Counter(
+        mem_per_friend, benchmark::Counter::kDefaults, benchmark::Counter::OneK::kIs1024);
 }
 BENCHMARK_REGISTER_F(ToxOnlineDisconnectedScalingFixture, Iterate)
     ->Arg(0)
@@ -376,6 +399,8 @@ BENCHMARK_DEFINE_F(ToxIterateScalingFixture, Iterate)(benchmark::State &state)
     state.counters["mem_max"]
         = benchmark::Counter(static_cast<double>(main_node->fake_memory().max_allocation()),
             benchmark::Counter::kDefaults, benchmark::Counter::OneK::kIs1024);
+    state.counters["mem_per_friend"] = benchmark::Counter(
+        mem_per_friend, benchmark::Counter::kDefaults, benchmark::Counter::OneK::kIs1024);
 }
 BENCHMARK_REGISTER_F(ToxIterateScalingFixture, Iterate)
     ->Arg(0)
@@ -418,6 +443,44 @@ void RunGroupScaling(benchmark::State &state, GroupScalingContext &ctx)
         static_cast<double>(ctx.main_ctx.peer_count + 1), benchmark::Counter::kDefaults);
 }
 
+/**
+ * @brief Report the memory each added (offline) friend costs.
+ *
+ * Measures the time to add the friends and the growth of the allocation on
+ * the adding node, i.e. the friend list, friend connections and onion
+ * friend entries, without any file transfers or connections.
+ */
+static void BM_FriendMemory(benchmark::State &state)
+{
+    const int num_friends = state.range(0);
+    double mem_per_friend = 0;
+
+    for (auto _ : state) {
+        Simulation sim{12345};
+        auto node = sim.create_node();
+        auto tox = node->create_tox();
+
+        const std::size_t mem_before = node->fake_memory().current_allocation();
+
+        for (int i = 0; i < num_friends; ++i) {
+            uint8_t friend_pk[TOX_PUBLIC_KEY_SIZE];
+            node->fake_random().bytes(friend_pk, TOX_PUBLIC_KEY_SIZE);
+            tox_friend_add_norequest(tox.get(), friend_pk, nullptr);
+        }
+
+        mem_per_friend = memory_per_friend(*node, mem_before, num_friends);
+    }
+
+    state.counters["mem_per_friend"] = benchmark::Counter(
+        mem_per_friend, benchmark::Counter::kDefaults, benchmark::Counter::OneK::kIs1024);
+}
+BENCHMARK(BM_FriendMemory)
+    ->Arg(100)
+    ->Arg(1000)
+    ->Arg(20000)
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(1);
+
 /**
  * @brief Benchmark the time and CPU required to discover and connect to many friends.
  *
@@ -0,0 +1,485 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "../../testing/support/public/simulation.hh"
+#include "../../testing/support/public/tox_network.hh"
+#include "../../toxcore/network.h"
+#include "../../toxcore/tox.h"
+#include "../../toxcore/tox_events.h"
+
+namespace {
+
+using tox::test::ConnectedFriend;
+using tox::test::setup_connected_friends;
+using tox::test::setup_connected_group;
+using tox::test::SimulatedNode;
+using tox::test::Simulation;
+
+/** @brief A group of real Tox instances, created by the main node. */
+struct Group {
+    Simulation sim{12345};
+    std::unique_ptr<SimulatedNode> main_node;
+    SimulatedNode::ToxPtr main_tox;
+    std::vector<ConnectedFriend> friends;
+    /** Friends of the creator that are left out of the group until invited. */
+    std::vector<ConnectedFriend> late;
+    uint32_t group_number = UINT32_MAX;
+    std::size_t mem_before_group = 0;
+
+    /** @brief Returns false if not every peer got into the group. */
+    bool setup(int num_peers, int num_late = 0)
+    {
+        sim.net().set_latency(5);
+        main_node = sim.create_node();
+
+        auto opts = std::unique_ptr<Tox_Options, decltype(&tox_options_free)>(
+            tox_options_new(nullptr), tox_options_free);
+        tox_options_set_ipv6_enabled(opts.get(), false);
+        tox_options_set_local_discovery_enabled(opts.get(), false);
+
+        main_tox = main_node->create_tox(opts.get());
+        friends = setup_connected_friends(
+            sim, main_tox.get(), *main_node, num_peers - 1 + num_late, opts.get());
+
+        if (friends.size() != static_cast<std::size_t>(num_peers - 1 + num_late)) {
+            return false;
+        }
+
+        // Kept apart from the others, so that run() doesn't swallow their invites.
+        for (int i = 0; i < num_late; ++i) {
+            late.push_back(std::move(friends.back()));
+            friends.pop_back();
+        }
+
+        mem_before_group = main_node->fake_memory().current_allocation();
+        group_number = setup_connected_group(sim, main_tox.get(), friends);
+
+        if (group_number == UINT32_MAX) {
+            return false;
+        }
+
+        const int limit = tox_group_get_peer_limit(main_tox.get(), group_number, nullptr);
+
+        if (num_peers + num_late > limit
+            && !tox_group_set_peer_limit(main_tox.get(), group_number,
+                static_cast<uint16_t>(num_peers + num_late), nullptr)) {
+            return false;
+        }
+
+        // The callback set up by setup_connected_group expects its own user data.
+        tox_callback_group_peer_join(main_tox.get(), nullptr);
+
+        // Let the peers finish syncing and connect to each other.
+        run(10000, [] { return false; });
+        return true;
+    }
+
+    /** @brief Returns the peer IDs the creator has for the other peers. */
+    std::vector<uint32_t> peer_ids() const
+    {
+        std::vector<uint32_t> ids;
+        const uint32_t self_id = tox_group_self_get_peer_id(main_tox.get(), group_number, nullptr);
+
+        // Peer IDs are handed out from 0 up, with gaps left by peers that went away.
+        for (uint32_t id = 0; ids.size() < friends.size() && id < 4 * (friends.size() + 1); ++id) {
+            Tox_Err_Group_Peer_Query err;
+            tox_group_peer_get_role(main_tox.get(), group_number, id, &err);
+
+            if (id != self_id && err == TOX_ERR_GROUP_PEER_QUERY_OK) {
+                ids.push_back(id);
+            }
+        }
+
+        return ids;
+    }
+
+    /** @brief Invites a friend from `late`, returning true once it joined the group. */
+    bool invite(ConnectedFriend &f, uint64_t timeout_ms)
+    {
+        if (!tox_group_invite_friend(main_tox.get(), group_number, f.friend_number, nullptr)) {
+            return false;
+        }
+
+        bool joined = false;
+        run(timeout_ms, [&]() {
+            for (const auto &batch : f.runner->poll_events()) {
+                const uint32_t size = tox_events_get_size(batch.get());
+
+                for (uint32_t k = 0; k < size; ++k) {
+                    const Tox_Event *e = tox_events_get(batch.get(), k);
+
+                    if (tox_event_get_type(e) == TOX_EVENT_GROUP_SELF_JOIN) {
+                        joined = true;
+                    } else if (tox_event_get_type(e) == TOX_EVENT_GROUP_INVITE) {
+                        const Tox_Event_Group_Invite *ev = tox_event_get_group_invite(e);
+                        const uint32_t friend_number = tox_event_group_invite_get_friend_number(ev);
+                        const uint8_t *data = tox_event_group_invite_get_invite_data(ev);
+                        // The event is freed before the runner gets to it.
+                        std::vector<uint8_t> invite_data(
+                            data, data + tox_event_group_invite_get_invite_data_length(ev));
+
+                        f.runner->execute([=](Tox *_Nonnull tox) {
+                            tox_group_invite_accept(tox, friend_number, invite_data.data(),
+                                invite_data.size(), reinterpret_cast<const uint8_t *>("late"), 4,
+                                nullptr, 0, nullptr);
+                        });
+                    }
+                }
+            }
+
+            return joined;
+        });
+
+        return joined;
+    }
+
+    /** @brief Runs the simulation until `done` returns true, counting events of `type` per friend. */
+    template <typename Done>
+    void run(uint64_t timeout_ms, Done done, std::vector<uint32_t> *received = nullptr,
+        Tox_Event_Type type = TOX_EVENT_GROUP_MESSAGE)
+    {
+        sim.run_until(
+            [&]() {
+                tox_iterate(main_tox.get(), nullptr);
+
+                for (std::size_t i = 0; i < friends.size(); ++i) {
+                    for (const auto &batch : friends[i].runner->poll_events()) {
+                        const uint32_t size = tox_events_get_size(batch.get());
+
+                        for (uint32_t k = 0; k < size; ++k) {
+                            if (received != nullptr
+                                && tox_event_get_type(tox_events_get(batch.get(), k)) == type) {
+                                ++(*received)[i];
+                            }
+                        }
+                    }
+                }
+
+                return done();
+            },
+            timeout_ms);
+    }
+};
+
+/**
+ * @brief Memory the group creator spends on each peer of an idle group.
+ *
+ * Counters:
+ * - mem_per_peer: growth of the creator's allocation from before the group
+ *   was created to after every peer joined and the group went quiet, divided
+ *   by the number of other peers.
+ * - mem_max: the creator's peak allocation.
+ */
+void BM_GroupPeerMemory(benchmark::State &state)
+{
+    const int num_peers = static_cast<int>(state.range(0));
+    double mem_per_peer = 0;
+    double mem_max = 0;
+
+    for (auto _ : state) {
+        Group group;
+
+        if (!group.setup(num_peers)) {
+            state.SkipWithError("failed to set up the group");
+            return;
+        }
+
+        const std::size_t after = group.main_node->fake_memory().current_allocation();
+        mem_per_peer = after > group.mem_before_group
+            ? static_cast<double>(after - group.mem_before_group) / (num_peers - 1)
+            : 0;
+        mem_max = static_cast<double>(group.main_node->fake_memory().max_allocation());
+    }
+
+    state.counters["mem_per_peer"] = benchmark::Counter(
+        mem_per_peer, benchmark::Counter::kDefaults, benchmark::Counter::OneK::kIs1024);
+    state.counters["mem_max"] = benchmark::Counter(
+        mem_max, benchmark::Counter::kDefaults, benchmark::Counter::OneK::kIs1024);
+}
+BENCHMARK(BM_GroupPeerMemory)
+    ->Arg(16)
+    ->Arg(64)
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(1);
+
+/**
+ * @brief Throughput of a burst of group messages, and the memory it takes.
+ *
+ * The creator sends a burst of messages at once, so every peer's send array
+ * has to hold the whole burst until it is acknowledged. The CPU time is mostly
+ * the creator's work to send the burst and handle the acks.
+ *
+ * Counters:
+ * - delivery_ms: simulated time until every peer has every message.
+ * - mem_burst: how much the creator's allocation peaked above its idle level.
+ * - mem_after: how much the creator's allocation stayed above its idle level
+ *   once the burst was delivered and acknowledged.
+ *
+ * Args:
+ * - number of peers, including the sender,
+ * - number of messages in the burst.
+ */
+void BM_GroupBurst(benchmark::State &state)
+{
+    const int num_peers = static_cast<int>(state.range(0));
+    const uint32_t burst = static_cast<uint32_t>(state.range(1));
+
+    Group group;
+
+    if (!group.setup(num_peers)) {
+        state.SkipWithError("failed to set up the group");
+        return;
+    }
+
+    const uint8_t message[100] = {0};
+    uint64_t total_delivery = 0;
+    std::size_t mem_burst = 0;
+    std::size_t mem_after = 0;
+
+    for (auto _ : state) {
+        const std::size_t idle = group.main_node->fake_memory().current_allocation();
+        std::size_t peak = idle;
+        std::vector<uint32_t> received(group.friends.size());
+        const uint64_t start = group.sim.clock().current_time_ms();
+
+        for (uint32_t i = 0; i < burst; ++i) {
+            tox_group_send_message(group.main_tox.get(), group.group_number,
+                TOX_MESSAGE_TYPE_NORMAL, message, sizeof(message), nullptr);
+        }
+
+        bool everyone = false;
+        group.run(
+            30000,
+            [&]() {
+                peak = std::max(peak, group.main_node->fake_memory().current_allocation());
+                everyone = true;
+
+                for (const uint32_t count : received) {
+                    everyone = everyone && count >= burst;
+                }
+
+                return everyone;
+            },
+            &received);
+
+        if (!everyone) {
+            state.SkipWithError("the burst didn't reach every peer");
+            return;
+        }
+
+        total_delivery += group.sim.clock().current_time_ms() - start;
+
+        // Let the acks come back so the send arrays drain.
+        group.run(10000, [] { return false; });
+
+        const std::size_t after = group.main_node->fake_memory().current_allocation();
+        mem_burst = std::max(mem_burst, peak - idle);
+        mem_after = after > idle ? after - idle : 0;
+    }
+
+    state.counters["delivery_ms"] = static_cast<double>(total_delivery) / state.iterations();
+    state.counters["mem_burst"] = benchmark::Counter(static_cast<double>(mem_burst),
+        benchmark::Counter::kDefaults, benchmark::Counter::OneK::kIs1024);
+    state.counters["mem_after"] = benchmark::Counter(static_cast<double>(mem_after),
+        benchmark::Counter::kDefaults, benchmark::Counter::OneK::kIs1024);
+}
+BENCHMARK(BM_GroupBurst)
+    ->ArgNames({"peers", "burst"})
+    ->ArgsProduct({{16, 64}, {10, 100}})
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(3);
+
+/**
+ * @brief Cost of syncing moderation changes in a group with many sanctions.
+ *
+ * The creator first makes observers of up to 30 peers (the most sanctions a
+ * group allows). Each iteration promotes one more peer to moderator and
+ * demotes it again. Every change makes the creator re-sign and broadcast the
+ * moderator and sanctions lists, and every peer validate them, resolve the
+ * signature keys in them to peers and update the roles of all its peers. The
+ * other peers run on their own threads, so the real time counts, not the CPU time.
+ *
+ * Counters:
+ * - sync_ms: simulated time until every peer has seen both changes.
+ *
+ * Args:
+ * - number of peers, including the creator.
+ */
+void BM_GroupModerationSync(benchmark::State &state)
+{
+    const int num_peers = static_cast<int>(state.range(0));
+
+    Group group;
+
+    if (!group.setup(num_peers)) {
+        state.SkipWithError("failed to set up the group");
+        return;
+    }
+
+    const std::vector<uint32_t> ids = group.peer_ids();
+
+    if (ids.size() < 2) {
+        state.SkipWithError("the creator doesn't know enough peers");
+        return;
+    }
+
+    const std::size_t num_observers = std::min<std::size_t>(ids.size() - 1, 30);
+    std::vector<uint32_t> received(group.friends.size());
+
+    for (std::size_t i = 0; i < num_observers; ++i) {
+        tox_group_set_role(
+            group.main_tox.get(), group.group_number, ids[i], TOX_GROUP_ROLE_OBSERVER, nullptr);
+        // One change at a time, so that no peer misses one in a newer sync.
+        group.run(
+            10000,
+            [&]() {
+                return std::all_of(received.begin(), received.end(),
+                    [&](uint32_t count) { return count > i; });
+            },
+            &received, TOX_EVENT_GROUP_MODERATION);
+    }
+
+    const uint32_t target = ids[num_observers];
+    uint64_t total_sync = 0;
+
+    for (auto _ : state) {
+        std::fill(received.begin(), received.end(), 0);
+        const uint64_t start = group.sim.clock().current_time_ms();
+
+        bool everyone = false;
+
+        for (const Tox_Group_Role role : {TOX_GROUP_ROLE_MODERATOR, TOX_GROUP_ROLE_USER}) {
+            const uint32_t expected = role == TOX_GROUP_ROLE_MODERATOR ? 1 : 2;
+            tox_group_set_role(group.main_tox.get(), group.group_number, target, role, nullptr);
+            group.run(
+                10000,
+                [&]() {
+                    everyone = std::all_of(received.begin(), received.end(),
+                        [&](uint32_t count) { return count >= expected; });
+                    return everyone;
+                },
+                &received, TOX_EVENT_GROUP_MODERATION);
+        }
+
+        if (!everyone) {
+            state.SkipWithError("a moderation change didn't reach every peer");
+            return;
+        }
+
+        total_sync += group.sim.clock().current_time_ms() - start;
+    }
+
+    state.counters["sync_ms"] = static_cast<double>(total_sync) / state.iterations();
+}
+BENCHMARK(BM_GroupModerationSync)
+    ->Arg(16)
+    ->Arg(64)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime()
+    ->Iterations(20);
+
+/**
+ * @brief Bandwidth a peer costs when it comes back from a short outage.
+ *
+ * One peer loses its network for 20 seconds, too short for the others to time
+ * it out. Meanwhile a new peer joins, the creator makes it an observer and
+ * changes the topic. Once the network is back, the peer finds out from the
+ * others' pings that it is behind and asks one of them to sync.
+ *
+ * Counters:
+ * - reconnect_bytes: bytes sent to and from the peer in the 30 seconds after
+ *   its network came back, pings and everything else included.
+ *
+ * Args:
+ * - number of peers, including the creator and the new peer.
+ */
+void BM_GroupReconnectSync(benchmark::State &state)
+{
+    const int num_peers = static_cast<int>(state.range(0));
+    double reconnect_bytes = 0;
+
+    for (auto _ : state) {
+        Group group;
+
+        if (!group.setup(num_peers - 1, 1)) {
+            state.SkipWithError("failed to set up the group");
+            return;
+        }
+
+        ConnectedFriend &dropped = group.friends.front();
+        const IP dropped_ip = dropped.node->ip;
+        std::atomic<bool> offline{true};
+        std::atomic<uint64_t> bytes{0};
+
+        group.sim.net().add_filter([&](tox::test::Packet &p) {
+            if (!ip_equal(&p.from.ip, &dropped_ip) && !ip_equal(&p.to.ip, &dropped_ip)) {
+                return true;
+            }
+
+            bytes += p.data.size();
+            return !offline.load();
+        });
+
+        const uint64_t outage_end = group.sim.clock().current_time_ms() + 20000;
+        const std::vector<uint32_t> ids_before = group.peer_ids();
+
+        if (!group.invite(group.late.front(), 15000)) {
+            state.SkipWithError("the new peer didn't join");
+            return;
+        }
+
+        for (const uint32_t id : group.peer_ids()) {
+            if (std::find(ids_before.begin(), ids_before.end(), id) == ids_before.end()) {
+                tox_group_set_role(
+                    group.main_tox.get(), group.group_number, id, TOX_GROUP_ROLE_OBSERVER, nullptr);
+            }
+        }
+
+        const uint8_t topic[] = "back soon";
+        tox_group_set_topic(
+            group.main_tox.get(), group.group_number, topic, sizeof(topic) - 1, nullptr);
+
+        group.run(20000, [&]() { return group.sim.clock().current_time_ms() >= outage_end; });
+
+        offline = false;
+        bytes = 0;
+        group.run(30000, [] { return false; });
+        reconnect_bytes = static_cast<double>(bytes.load());
+
+        const bool synced = dropped.runner->invoke([&](Tox *_Nonnull tox) {
+            uint8_t got[sizeof(topic)] = {0};
+            return tox_group_get_topic_size(tox, 0, nullptr) == sizeof(topic) - 1
+                && tox_group_get_topic(tox, 0, got, nullptr)
+                && std::equal(got, got + sizeof(topic) - 1, topic);
+        });
+
+        if (!synced) {
+            state.SkipWithError("the peer didn't catch up after its outage");
+            return;
+        }
+    }
+
+    state.counters["reconnect_bytes"] = benchmark::Counter(
+        reconnect_bytes, benchmark::Counter::kDefaults, benchmark::Counter::OneK::kIs1024);
+}
+BENCHMARK(BM_GroupReconnectSync)
+    ->Arg(16)
+    ->Arg(64)
+    ->Arg(128)
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(1);
+
+}  // namespace
+
+BENCHMARK_MAIN();
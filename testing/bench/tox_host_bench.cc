@@ -0,0 +1,218 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "../../testing/support/public/simulation.hh"
+#include "../../toxcore/network.h"
+#include "../../toxcore/tox.h"
+#include "../../toxcore/tox_private.h"
+
+namespace {
+
+using tox::test::FakeClock;
+using tox::test::SimulatedNode;
+using tox::test::Simulation;
+
+/**
+ * @brief Number of standalone nodes the identities bootstrap off.
+ *
+ * More than an onion client announces itself to, so the hosted identities,
+ * which don't count as DHT nodes themselves, can fill their announce lists.
+ */
+constexpr int kBootstrapNodes = 24;
+/** @brief Simulated time in ms the network gets to settle before measuring. */
+constexpr uint64_t kSettleTime = 60000;
+/** @brief Simulated time in ms covered by one benchmark iteration. */
+constexpr uint64_t kIterationTime = 1000;
+
+struct Tox_Host_Deleter {
+    void operator()(Tox_Host *host) { tox_host_kill(host); }
+};
+
+struct Tox_Deleter {
+    void operator()(Tox *tox) { tox_kill(tox); }
+};
+
+/**
+ * @brief What it costs a machine to run many identities, with and without a
+ * host.
+ *
+ * One node runs `identities` Tox instances, either on one Tox_Host or each
+ * with its own socket and DHT. All of them bootstrap off a few other nodes.
+ * After the network settled, each iteration runs one simulated second. The
+ * counters show the memory the node uses and the UDP traffic it sends per
+ * identity. The time per iteration is the CPU cost of running them, plus the
+ * same cost for the bootstrap nodes in both modes.
+ *
+ * Args:
+ * - hosted (0 or 1),
+ * - number of identities.
+ */
+void BM_IdentitiesIdle(benchmark::State &state)
+{
+    const bool hosted = state.range(0) != 0;
+    const int identities = static_cast<int>(state.range(1));
+
+    Simulation sim{12345};
+
+    std::vector<std::unique_ptr<SimulatedNode>> bootstrap_nodes;
+    std::vector<SimulatedNode::ToxPtr> bootstrap_toxes;
+
+    for (int i = 0; i < kBootstrapNodes; ++i) {
+        bootstrap_nodes.push_back(sim.create_node());
+        bootstrap_toxes.push_back(bootstrap_nodes.back()->create_tox());
+
+        if (bootstrap_toxes.back() == nullptr) {
+            state.SkipWithError("failed to create bootstrap nodes");
+            return;
+        }
+    }
+
+    auto node = sim.create_node();
+    const std::size_t mem_before = node->fake_memory().current_allocation();
+
+    Tox_System system;
+    system.ns = &node->c_network;
+    system.rng = &node->c_random;
+    system.mem = &node->c_memory;
+    system.mono_time_callback = [](void *user_data) -> uint64_t {
+        return static_cast<FakeClock *>(user_data)->current_time_ms();
+    };
+    system.mono_time_user_data = &sim.clock();
+
+    std::unique_ptr<Tox_Options, decltype(&tox_options_free)> opts(
+        tox_options_new(nullptr), tox_options_free);
+    tox_options_set_ipv6_enabled(opts.get(), false);
+    tox_options_set_local_discovery_enabled(opts.get(), false);
+
+    std::unique_ptr<Tox_Host, Tox_Host_Deleter> host;
+
+    if (hosted) {
+        host.reset(tox_host_new(opts.get(), &system, nullptr));
+
+        if (host == nullptr) {
+            state.SkipWithError("failed to create the host");
+            return;
+        }
+    }
+
+    // Declared after the host, so they are killed before it.
+    std::vector<std::unique_ptr<Tox, Tox_Deleter>> toxes;
+
+    for (int i = 0; i < identities; ++i) {
+        if (hosted) {
+            toxes.emplace_back(tox_new_hosted(host.get(), opts.get(), nullptr));
+        } else {
+            toxes.emplace_back(node->create_tox(opts.get()).release());
+        }
+
+        if (toxes.back() == nullptr) {
+            state.SkipWithError("failed to create identities");
+            return;
+        }
+    }
+
+    std::vector<Tox *> all;
+
+    for (const auto &tox : bootstrap_toxes) {
+        all.push_back(tox.get());
+    }
+
+    if (!hosted) {
+        for (const auto &tox : toxes) {
+            all.push_back(tox.get());
+        }
+    }
+
+    // Everyone bootstraps off the first node, and the first node off the second.
+    uint8_t dht_id[TOX_PUBLIC_KEY_SIZE];
+    char ip[TOX_INET6_ADDRSTRLEN];
+
+    for (int i = 0; i < 2; ++i) {
+        tox_self_get_dht_id(bootstrap_toxes[i].get(), dht_id);
+        ip_parse_addr(&bootstrap_nodes[i]->ip, ip, sizeof(ip));
+        const uint16_t port = bootstrap_nodes[i]->get_primary_socket()->local_port();
+
+        for (Tox *tox : all) {
+            if (tox != bootstrap_toxes[i].get()) {
+                tox_bootstrap(tox, ip, port, dht_id, nullptr);
+            }
+        }
+
+        if (hosted) {
+            tox_bootstrap(toxes[0].get(), ip, port, dht_id, nullptr);
+        }
+    }
+
+    uint64_t sent_bytes = 0;
+    uint64_t sent_packets = 0;
+    const IP node_ip = node->ip;
+    sim.net().add_filter([&](tox::test::Packet &p) {
+        if (ip_equal(&p.from.ip, &node_ip)) {
+            sent_bytes += p.data.size();
+            ++sent_packets;
+        }
+        return true;
+    });
+
+    const auto run = [&](uint64_t duration) {
+        const uint64_t end = sim.clock().current_time_ms() + duration;
+
+        while (sim.clock().current_time_ms() < end) {
+            uint32_t interval = 50;
+
+            for (Tox *tox : all) {
+                tox_iterate(tox, nullptr);
+                interval = std::min(interval, tox_iteration_interval(tox));
+            }
+
+            if (hosted) {
+                tox_host_iterate(host.get(), nullptr);
+                interval = std::min(interval, tox_host_iteration_interval(host.get()));
+            }
+
+            sim.advance_time(std::max<uint32_t>(interval, 1));
+        }
+    };
+
+    run(kSettleTime);
+
+    sent_bytes = 0;
+    sent_packets = 0;
+    uint64_t sim_ms = 0;
+
+    for (auto _ : state) {
+        run(kIterationTime);
+        sim_ms += kIterationTime;
+    }
+
+    const std::size_t mem_after = node->fake_memory().current_allocation();
+    const double seconds = static_cast<double>(sim_ms) / 1000.0;
+
+    state.counters["memory_per_identity"] = benchmark::Counter(
+        static_cast<double>(mem_after - mem_before) / identities, benchmark::Counter::kDefaults,
+        benchmark::Counter::OneK::kIs1024);
+    state.counters["sent_bytes_per_s_per_identity"] = benchmark::Counter(
+        static_cast<double>(sent_bytes) / seconds / identities, benchmark::Counter::kDefaults,
+        benchmark::Counter::OneK::kIs1024);
+    state.counters["sent_packets_per_s_per_identity"]
+        = benchmark::Counter(static_cast<double>(sent_packets) / seconds / identities);
+}
+
+BENCHMARK(BM_IdentitiesIdle)
+    ->ArgNames({"hosted", "identities"})
+    ->ArgsProduct({{0, 1}, {1, 8, 32}})
+    ->Iterations(20)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
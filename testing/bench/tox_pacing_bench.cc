@@ -0,0 +1,261 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "../../testing/support/public/simulation.hh"
+#include "../../toxcore/network.h"
+#include "../../toxcore/tox.h"
+
+namespace {
+
+using tox::test::FakeClock;
+using tox::test::Simulation;
+
+/** @brief Lossy packet id of the latency probes. */
+constexpr std::uint8_t kProbePacketId = 200;
+/** @brief Interval between two latency probes in ms. */
+constexpr std::uint64_t kProbeInterval = 20;
+
+struct SenderContext {
+    const std::vector<uint8_t> *data = nullptr;
+};
+
+struct ReceiverContext {
+    const FakeClock *clock = nullptr;
+    uint64_t received = 0;
+    bool done = false;
+    std::vector<uint64_t> delays;
+};
+
+/**
+ * @brief Send a file over a bandwidth limited link, with or without pacing,
+ * and measure goodput and how much it delays other traffic.
+ *
+ * While the file is sent, the sender also sends a small lossy packet every
+ * kProbeInterval ms. Those share the uplink queue with the file data, so
+ * their one-way delay shows how bursty the file data is. Both nodes are
+ * iterated as often as tox_iteration_interval asks for.
+ *
+ * Args:
+ * - pacing (0 or 1),
+ * - one-way latency in ms,
+ * - uplink bandwidth in KiB/s, with a 200ms drop-tail queue.
+ */
+void BM_PacingJitterAndGoodput(benchmark::State &state)
+{
+    const bool pacing = state.range(0) != 0;
+    const uint64_t latency_ms = static_cast<uint64_t>(state.range(1));
+    const uint64_t bandwidth = static_cast<uint64_t>(state.range(2)) * 1024;
+    constexpr std::size_t kFileSize = 1024 * 1024;
+
+    Simulation sim{12345};
+    auto node1 = sim.create_node();
+    auto node2 = sim.create_node();
+
+    auto opts1 = std::unique_ptr<Tox_Options, decltype(&tox_options_free)>(
+        tox_options_new(nullptr), tox_options_free);
+    tox_options_set_log_user_data(opts1.get(), const_cast<char *>("Tox1"));
+    tox_options_set_ipv6_enabled(opts1.get(), false);
+    tox_options_set_local_discovery_enabled(opts1.get(), false);
+    tox_options_set_experimental_pacing(opts1.get(), pacing);
+
+    auto opts2 = std::unique_ptr<Tox_Options, decltype(&tox_options_free)>(
+        tox_options_new(nullptr), tox_options_free);
+    tox_options_set_log_user_data(opts2.get(), const_cast<char *>("Tox2"));
+    tox_options_set_ipv6_enabled(opts2.get(), false);
+    tox_options_set_local_discovery_enabled(opts2.get(), false);
+    tox_options_set_experimental_pacing(opts2.get(), pacing);
+
+    auto tox1 = node1->create_tox(opts1.get());
+    auto tox2 = node2->create_tox(opts2.get());
+
+    if (!tox1 || !tox2) {
+        state.SkipWithError("Failed to create Tox instances");
+        return;
+    }
+
+    uint8_t tox1_pk[TOX_PUBLIC_KEY_SIZE];
+    tox_self_get_public_key(tox1.get(), tox1_pk);
+    uint8_t tox2_pk[TOX_PUBLIC_KEY_SIZE];
+    tox_self_get_public_key(tox2.get(), tox2_pk);
+
+    uint8_t tox1_dht_id[TOX_PUBLIC_KEY_SIZE];
+    tox_self_get_dht_id(tox1.get(), tox1_dht_id);
+    uint8_t tox2_dht_id[TOX_PUBLIC_KEY_SIZE];
+    tox_self_get_dht_id(tox2.get(), tox2_dht_id);
+
+    Tox_Err_Friend_Add friend_add_err;
+    uint32_t f1 = tox_friend_add_norequest(tox1.get(), tox2_pk, &friend_add_err);
+    uint32_t f2 = tox_friend_add_norequest(tox2.get(), tox1_pk, &friend_add_err);
+
+    uint16_t port1 = node1->get_primary_socket()->local_port();
+    uint16_t port2 = node2->get_primary_socket()->local_port();
+
+    char ip1[TOX_INET6_ADDRSTRLEN];
+    ip_parse_addr(&node1->ip, ip1, sizeof(ip1));
+    char ip2[TOX_INET6_ADDRSTRLEN];
+    ip_parse_addr(&node2->ip, ip2, sizeof(ip2));
+
+    tox_bootstrap(tox2.get(), ip1, port1, tox1_dht_id, nullptr);
+    tox_bootstrap(tox1.get(), ip2, port2, tox2_dht_id, nullptr);
+
+    bool connected = false;
+    sim.run_until(
+        [&]() {
+            tox_iterate(tox1.get(), nullptr);
+            tox_iterate(tox2.get(), nullptr);
+            sim.advance_time(90);  // +10ms from run_until = 100ms
+            connected
+                = (tox_friend_get_connection_status(tox1.get(), f1, nullptr) == TOX_CONNECTION_UDP
+                    && tox_friend_get_connection_status(tox2.get(), f2, nullptr)
+                        == TOX_CONNECTION_UDP);
+            return connected;
+        },
+        60000);
+
+    if (!connected) {
+        state.SkipWithError("Failed to connect toxes over UDP within 60s");
+        return;
+    }
+
+    sim.net().set_latency(latency_ms);
+    sim.net().set_bandwidth(bandwidth, 200);
+
+    const std::vector<uint8_t> file_data(kFileSize, 0x5a);
+    SenderContext sender;
+    sender.data = &file_data;
+    ReceiverContext receiver;
+
+    tox_callback_file_chunk_request(tox1.get(),
+        [](Tox *tox, uint32_t friend_number, uint32_t file_number, uint64_t position,
+            std::size_t length, void *user_data) {
+            if (length == 0) {
+                return;
+            }
+            const auto *ctx = static_cast<SenderContext *>(user_data);
+            tox_file_send_chunk(tox, friend_number, file_number, position,
+                ctx->data->data() + position, length, nullptr);
+        });
+    tox_callback_file_recv(tox2.get(),
+        [](Tox *tox, uint32_t friend_number, uint32_t file_number, uint32_t, uint64_t,
+            const uint8_t *, std::size_t, void *) {
+            tox_file_control(tox, friend_number, file_number, TOX_FILE_CONTROL_RESUME, nullptr);
+        });
+    tox_callback_file_recv_chunk(tox2.get(),
+        [](Tox *, uint32_t, uint32_t, uint64_t, const uint8_t *, std::size_t length,
+            void *user_data) {
+            auto *ctx = static_cast<ReceiverContext *>(user_data);
+            ctx->received += length;
+            if (length == 0) {
+                ctx->done = true;
+            }
+        });
+    tox_callback_friend_lossy_packet(tox2.get(),
+        [](Tox *, uint32_t, const uint8_t *data, std::size_t length, void *user_data) {
+            auto *ctx = static_cast<ReceiverContext *>(user_data);
+            uint64_t sent;
+            if (length != 1 + sizeof(sent) || data[0] != kProbePacketId) {
+                return;
+            }
+            std::memcpy(&sent, data + 1, sizeof(sent));
+            ctx->delays.push_back(ctx->clock->current_time_ms() - sent);
+        });
+
+    uint64_t sim_ms = 0;
+    uint64_t files = 0;
+    std::vector<uint64_t> delays;
+
+    for (auto _ : state) {
+        receiver = ReceiverContext();
+        receiver.clock = &sim.clock();
+        const uint32_t file_number = tox_file_send(tox1.get(), f1, TOX_FILE_KIND_DATA, kFileSize,
+            nullptr, reinterpret_cast<const uint8_t *>("bench"), 5, nullptr);
+
+        if (file_number == UINT32_MAX) {
+            state.SkipWithError("tox_file_send failed");
+            return;
+        }
+
+        const uint64_t start = sim.clock().current_time_ms();
+        uint64_t next_probe = start;
+
+        while (!receiver.done && sim.clock().current_time_ms() - start < 600000) {
+            tox_iterate(tox1.get(), &sender);
+            tox_iterate(tox2.get(), &receiver);
+
+            const uint64_t now = sim.clock().current_time_ms();
+
+            if (now >= next_probe) {
+                uint8_t probe[1 + sizeof(now)] = {kProbePacketId};
+                std::memcpy(probe + 1, &now, sizeof(now));
+                tox_friend_send_lossy_packet(tox1.get(), f1, probe, sizeof(probe), nullptr);
+                next_probe = now + kProbeInterval;
+            }
+
+            const uint64_t interval = std::min({static_cast<uint64_t>(tox_iteration_interval(tox1.get())),
+                static_cast<uint64_t>(tox_iteration_interval(tox2.get())), next_probe - now});
+            sim.advance_time(std::max<uint64_t>(interval, 1));
+        }
+
+        if (receiver.received != kFileSize) {
+            state.SkipWithError("file transfer did not complete");
+            return;
+        }
+
+        sim_ms += sim.clock().current_time_ms() - start;
+        ++files;
+        delays.insert(delays.end(), receiver.delays.begin(), receiver.delays.end());
+    }
+
+    if (delays.empty()) {
+        state.SkipWithError("no latency probe arrived");
+        return;
+    }
+
+    double mean = 0;
+    for (const uint64_t d : delays) {
+        mean += static_cast<double>(d);
+    }
+    mean /= static_cast<double>(delays.size());
+
+    double variance = 0;
+    for (const uint64_t d : delays) {
+        variance += (static_cast<double>(d) - mean) * (static_cast<double>(d) - mean);
+    }
+    variance /= static_cast<double>(delays.size());
+
+    std::sort(delays.begin(), delays.end());
+
+    state.SetBytesProcessed(static_cast<int64_t>(files * kFileSize));
+    state.counters["goodput_bytes_per_second"] = benchmark::Counter(
+        static_cast<double>(files * kFileSize) * 1000.0 / static_cast<double>(sim_ms),
+        benchmark::Counter::kDefaults, benchmark::Counter::OneK::kIs1024);
+    state.counters["probe_delay_ms"] = benchmark::Counter(mean);
+    state.counters["probe_jitter_ms"] = benchmark::Counter(std::sqrt(variance));
+    state.counters["probe_delay_p99_ms"]
+        = benchmark::Counter(static_cast<double>(delays[delays.size() * 99 / 100]));
+}
+
+BENCHMARK(BM_PacingJitterAndGoodput)
+    ->ArgNames({"pacing", "latency_ms", "kib_per_s"})
+    ->ArgsProduct({
+        {0, 1},
+        {20},
+        {256, 1024},
+    })
+    ->Iterations(3)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
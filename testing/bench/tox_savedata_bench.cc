@@ -0,0 +1,324 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "../../testing/support/public/simulation.hh"
+#include "../../toxcore/mem.h"
+#include "../../toxcore/tox.h"
+#include "../../toxcore/tox_options.h"
+#include "../../toxcore/tox_private.h"
+
+namespace {
+
+using tox::test::FakeClock;
+using tox::test::SimulatedNode;
+using tox::test::Simulation;
+
+/**
+ * @brief Memory that tracks the peak allocation since the last reset.
+ *
+ * The simulation's memory only tracks the peak since it was created, which is
+ * dominated by setting up the friends.
+ */
+class PeakMemory {
+public:
+    PeakMemory()
+        : mem_{&kFuncs, this}
+    {
+    }
+
+    const Memory *get() const { return &mem_; }
+
+    std::size_t current() const { return current_; }
+    std::size_t peak() const { return peak_; }
+    void reset_peak() { peak_ = current_; }
+
+private:
+    struct Header {
+        std::size_t size;
+        std::max_align_t align;
+    };
+
+    static void *allocate(void *self, void *ptr, uint32_t size)
+    {
+        auto *memory = static_cast<PeakMemory *>(self);
+        Header *old = ptr != nullptr ? static_cast<Header *>(ptr) - 1 : nullptr;
+
+        if (old != nullptr) {
+            memory->current_ -= old->size;
+        }
+
+        auto *header = static_cast<Header *>(std::realloc(old, sizeof(Header) + size));
+
+        if (header == nullptr) {
+            if (old != nullptr) {
+                memory->current_ += old->size;
+            }
+            return nullptr;
+        }
+
+        header->size = size;
+        memory->current_ += size;
+        memory->peak_ = std::max(memory->peak_, memory->current_);
+        return header + 1;
+    }
+
+    static void *malloc_cb(void *self, uint32_t size) { return allocate(self, nullptr, size); }
+    static void *realloc_cb(void *self, void *ptr, uint32_t size) { return allocate(self, ptr, size); }
+
+    static void dealloc_cb(void *self, void *ptr)
+    {
+        if (ptr == nullptr) {
+            return;
+        }
+
+        Header *header = static_cast<Header *>(ptr) - 1;
+        static_cast<PeakMemory *>(self)->current_ -= header->size;
+        std::free(header);
+    }
+
+    static constexpr Memory_Funcs kFuncs = {malloc_cb, realloc_cb, dealloc_cb};
+
+    Memory mem_;
+    std::size_t current_ = 0;
+    std::size_t peak_ = 0;
+};
+
+enum class Mode {
+    kBuffer,
+    kStream,
+    kChangedOnly,
+};
+
+/** @brief Sink that drops the data, like a write to a file would. */
+bool count_bytes(const uint8_t *, std::size_t length, void *user_data)
+{
+    *static_cast<std::size_t *>(user_data) += length;
+    return true;
+}
+
+struct Source {
+    const std::vector<uint8_t> *data;
+    std::size_t position = 0;
+};
+
+std::size_t read_source(uint8_t *data, std::size_t length, void *user_data)
+{
+    auto *source = static_cast<Source *>(user_data);
+    const std::size_t n = std::min(length, source->data->size() - source->position);
+    std::memcpy(data, source->data->data() + source->position, n);
+    source->position += n;
+    return n;
+}
+
+class SavedataFixture {
+public:
+    explicit SavedataFixture(int64_t friends)
+        : node_(sim_.create_node())
+    {
+        system_.ns = &node_->c_network;
+        system_.rng = &node_->c_random;
+        system_.mem = memory_.get();
+        system_.mono_time_callback = [](void *user_data) -> uint64_t {
+            return static_cast<FakeClock *>(user_data)->current_time_ms();
+        };
+        system_.mono_time_user_data = &sim_.clock();
+
+        tox_options_set_ipv6_enabled(opts_.get(), false);
+        tox_options_set_local_discovery_enabled(opts_.get(), false);
+
+        tox_ = new_tox(opts_.get());
+
+        if (tox_ == nullptr) {
+            return;
+        }
+
+        for (int64_t i = 0; i < friends; ++i) {
+            uint8_t pk[TOX_PUBLIC_KEY_SIZE] = {0};
+            std::memcpy(pk, &i, sizeof(i));
+            pk[TOX_PUBLIC_KEY_SIZE - 1] = 0x42;
+            tox_friend_add_norequest(tox_.get(), pk, nullptr);
+        }
+    }
+
+    SimulatedNode::ToxPtr new_tox(const Tox_Options *opts)
+    {
+        Tox_Options_Testing testing_opts;
+        testing_opts.operating_system = &system_;
+        return SimulatedNode::ToxPtr(tox_new_testing(opts, nullptr, &testing_opts, nullptr));
+    }
+
+    Tox *tox() const { return tox_.get(); }
+    const Tox_Options *opts() const { return opts_.get(); }
+    PeakMemory &memory() { return memory_; }
+
+private:
+    Simulation sim_{12345};
+    std::unique_ptr<SimulatedNode> node_;
+    PeakMemory memory_;
+    Tox_System system_;
+    std::unique_ptr<Tox_Options, decltype(&tox_options_free)> opts_{
+        tox_options_new(nullptr), tox_options_free};
+    SimulatedNode::ToxPtr tox_;
+};
+
+/**
+ * @brief Save an account with many friends: into one buffer with
+ * tox_get_savedata, streamed with tox_savedata_write, and streamed with only
+ * the changed sections after the name changed.
+ *
+ * Counters:
+ * - save_bytes: the size of one save.
+ * - peak_memory: the most memory the save needed on top of what the Tox
+ *   already used, including the buffer the client allocates for
+ *   tox_get_savedata.
+ *
+ * Args:
+ * - mode (0 = buffer, 1 = stream, 2 = changed only),
+ * - number of friends.
+ */
+void BM_Save(benchmark::State &state)
+{
+    const Mode mode = static_cast<Mode>(state.range(0));
+    SavedataFixture fixture(state.range(1));
+
+    if (fixture.tox() == nullptr) {
+        state.SkipWithError("failed to create the Tox instance");
+        return;
+    }
+
+    std::size_t save_bytes = 0;
+    std::size_t peak_memory = 0;
+    const uint8_t names[2][4] = {"foo", "bar"};
+    uint32_t iteration = 0;
+
+    for (auto _ : state) {
+        fixture.memory().reset_peak();
+        const std::size_t before = fixture.memory().current();
+        std::size_t client_buffer = 0;
+        save_bytes = 0;
+
+        switch (mode) {
+            case Mode::kBuffer: {
+                std::vector<uint8_t> data(tox_get_savedata_size(fixture.tox()));
+                tox_get_savedata(fixture.tox(), data.data());
+                benchmark::DoNotOptimize(data.data());
+                save_bytes = data.size();
+                client_buffer = data.size();
+                break;
+            }
+
+            case Mode::kStream: {
+                tox_savedata_write(fixture.tox(), false, count_bytes, &save_bytes);
+                break;
+            }
+
+            case Mode::kChangedOnly: {
+                tox_self_set_name(fixture.tox(), names[iteration % 2], sizeof(names[0]), nullptr);
+                tox_savedata_write(fixture.tox(), true, count_bytes, &save_bytes);
+                break;
+            }
+        }
+
+        peak_memory = std::max(peak_memory, fixture.memory().peak() - before + client_buffer);
+        ++iteration;
+    }
+
+    state.counters["save_bytes"] = benchmark::Counter(static_cast<double>(save_bytes),
+        benchmark::Counter::kDefaults, benchmark::Counter::OneK::kIs1024);
+    state.counters["peak_memory"] = benchmark::Counter(static_cast<double>(peak_memory),
+        benchmark::Counter::kDefaults, benchmark::Counter::OneK::kIs1024);
+}
+
+BENCHMARK(BM_Save)
+    ->ArgNames({"mode", "friends"})
+    ->ArgsProduct({{0, 1, 2}, {1000, 5000}})
+    ->Unit(benchmark::kMicrosecond);
+
+/**
+ * @brief Create a Tox from a save with many friends, passed as one buffer or
+ * read through experimental_savedata_reader.
+ *
+ * In both cases the save comes from memory; the reader stands in for a file.
+ *
+ * Counters:
+ * - peak_memory: the most memory creating the Tox needed, including the save
+ *   buffer the client passes in the options.
+ *
+ * Args:
+ * - mode (0 = buffer, 1 = stream),
+ * - number of friends.
+ */
+void BM_Load(benchmark::State &state)
+{
+    const Mode mode = static_cast<Mode>(state.range(0));
+    SavedataFixture fixture(state.range(1));
+
+    if (fixture.tox() == nullptr) {
+        state.SkipWithError("failed to create the Tox instance");
+        return;
+    }
+
+    std::vector<uint8_t> save;
+    tox_savedata_write(fixture.tox(), false,
+        [](const uint8_t *data, std::size_t length, void *user_data) {
+            auto *out = static_cast<std::vector<uint8_t> *>(user_data);
+            out->insert(out->end(), data, data + length);
+            return true;
+        },
+        &save);
+
+    std::unique_ptr<Tox_Options, decltype(&tox_options_free)> opts(
+        tox_options_new(nullptr), tox_options_free);
+    tox_options_copy(opts.get(), fixture.opts());
+    tox_options_set_savedata_type(opts.get(), TOX_SAVEDATA_TYPE_TOX_SAVE);
+
+    std::size_t peak_memory = 0;
+
+    for (auto _ : state) {
+        Source source{&save};
+        std::size_t client_buffer = 0;
+
+        if (mode == Mode::kBuffer) {
+            tox_options_set_savedata_data(opts.get(), save.data(), save.size());
+            client_buffer = save.size();
+        } else {
+            tox_options_set_experimental_savedata_reader(opts.get(), read_source);
+            tox_options_set_experimental_savedata_reader_user_data(opts.get(), &source);
+        }
+
+        fixture.memory().reset_peak();
+        const std::size_t before = fixture.memory().current();
+
+        auto tox = fixture.new_tox(opts.get());
+
+        if (tox == nullptr || tox_self_get_friend_list_size(tox.get()) != static_cast<std::size_t>(state.range(1))) {
+            state.SkipWithError("failed to load the save");
+            return;
+        }
+
+        peak_memory = std::max(peak_memory, fixture.memory().peak() - before + client_buffer);
+    }
+
+    state.counters["peak_memory"] = benchmark::Counter(static_cast<double>(peak_memory),
+        benchmark::Counter::kDefaults, benchmark::Counter::OneK::kIs1024);
+}
+
+BENCHMARK(BM_Load)
+    ->ArgNames({"mode", "friends"})
+    ->ArgsProduct({{0, 1}, {1000, 5000}})
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
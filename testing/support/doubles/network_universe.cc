@@ -1,5 +1,6 @@
 #include "network_universe.hh"
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 
@@ -98,6 +99,26 @@ void NetworkUniverse::send_packet(Packet p)
         observer(p);
     }
 
+    p.delivery_time = std::max(p.delivery_time, now_ms_);
+
+    if (!p.is_tcp && packet_loss_ > 0.0
+        && std::uniform_real_distribution<double>(0.0, 1.0)(loss_rng_) < packet_loss_) {
+        return;
+    }
+
+    if (!p.is_tcp && bandwidth_ != 0) {
+        uint64_t &free_us = uplink_free_us_[{p.from.ip, 0}];
+        const uint64_t now_us = p.delivery_time * 1000;
+        const uint64_t start_us = std::max(free_us, now_us);
+
+        if (start_us - now_us > max_queue_ms_ * 1000) {
+            return;
+        }
+
+        free_us = start_us + p.data.size() * 1000000 / bandwidth_;
+        p.delivery_time = (free_us + 999) / 1000;
+    }
+
     p.delivery_time += global_latency_ms_;
 
     p.sequence_number = next_packet_id_++;
@@ -159,6 +180,11 @@ bool is_loopback(const IP &ip)
 
 void NetworkUniverse::process_events(uint64_t current_time_ms)
 {
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        now_ms_ = std::max(now_ms_, current_time_ms);
+    }
+
     while (true) {
         Packet p;
         std::vector<FakeTcpSocket *> tcp_targets;
@@ -287,6 +313,21 @@ void NetworkUniverse::process_events(uint64_t current_time_ms)
 
 void NetworkUniverse::set_latency(uint64_t ms) { global_latency_ms_ = ms; }
 
+void NetworkUniverse::set_packet_loss(double loss, uint32_t seed)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    packet_loss_ = loss;
+    loss_rng_.seed(seed);
+}
+
+void NetworkUniverse::set_bandwidth(uint64_t bytes_per_second, uint64_t max_queue_ms)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    bandwidth_ = bytes_per_second;
+    max_queue_ms_ = max_queue_ms;
+    uplink_free_us_.clear();
+}
+
 void NetworkUniverse::set_verbose(bool verbose) { verbose_ = verbose; }
 
 bool NetworkUniverse::is_verbose() const { return verbose_; }
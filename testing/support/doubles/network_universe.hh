@@ -7,6 +7,7 @@
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <random>
 #include <vector>
 
 #include "../../../toxcore/attributes.h"
@@ -72,6 +73,12 @@ public:
     // Simulation
     void process_events(uint64_t current_time_ms);
     void set_latency(uint64_t ms);
+    // Drops this fraction (0.0 to 1.0) of UDP packets at random.
+    void set_packet_loss(double loss, uint32_t seed = 1);
+    // Limits the UDP uplink of each IP to this many bytes per second. Packets
+    // that would wait longer than max_queue_ms in the uplink queue are dropped.
+    // 0 means unlimited.
+    void set_bandwidth(uint64_t bytes_per_second, uint64_t max_queue_ms);
     void set_verbose(bool verbose);
     bool is_verbose() const;
     void add_filter(PacketFilter filter);
@@ -96,6 +103,13 @@ private:
     std::vector<PacketSink> observers_;
 
     uint64_t global_latency_ms_ = 0;
+    uint64_t now_ms_ = 0;
+    double packet_loss_ = 0.0;
+    std::minstd_rand loss_rng_;
+    uint64_t bandwidth_ = 0;
+    uint64_t max_queue_ms_ = 0;
+    // Time in microseconds at which each IP's uplink is free again.
+    std::map<IP_Port_Key, uint64_t> uplink_free_us_;
     uint64_t next_packet_id_ = 0;
     bool verbose_ = false;
     std::recursive_mutex mutex_;
@@ -3,6 +3,7 @@
 #include <gtest/gtest.h>
 
 #include <cstddef>
+#include <vector>
 
 #include "fake_sockets.hh"
 
@@ -49,6 +50,91 @@ namespace {
         ASSERT_EQ(s2.recvfrom(buf, 10, &from), 4);
     }
 
+    TEST_F(NetworkUniverseTest, LatencyIsAddedToSendTime)
+    {
+        universe.set_latency(100);
+        universe.process_events(1000);
+
+        IP_Port s2_addr;
+        ip_init(&s2_addr.ip, false);
+        s2_addr.ip.ip.v4.uint32 = net_htonl(0x7F000001);
+        s2_addr.port = net_htons(9004);
+        s2.bind(&s2_addr);
+
+        uint8_t data[] = "Ping";
+        s1.sendto(data, 4, &s2_addr);
+
+        IP_Port from;
+        uint8_t buf[10];
+        universe.process_events(1099);
+        ASSERT_EQ(s2.recvfrom(buf, 10, &from), -1);
+
+        universe.process_events(1100);
+        ASSERT_EQ(s2.recvfrom(buf, 10, &from), 4);
+    }
+
+    TEST_F(NetworkUniverseTest, PacketLossDropsAFractionOfPackets)
+    {
+        universe.set_packet_loss(0.25);
+
+        IP_Port s2_addr;
+        ip_init(&s2_addr.ip, false);
+        s2_addr.ip.ip.v4.uint32 = net_htonl(0x7F000001);
+        s2_addr.port = net_htons(9004);
+        s2.bind(&s2_addr);
+
+        uint8_t data[] = "Ping";
+        for (int i = 0; i < 1000; ++i) {
+            s1.sendto(data, 4, &s2_addr);
+        }
+        universe.process_events(0);
+
+        IP_Port from;
+        uint8_t buf[10];
+        int received = 0;
+        while (s2.recvfrom(buf, 10, &from) == 4) {
+            ++received;
+        }
+
+        EXPECT_GT(received, 700);
+        EXPECT_LT(received, 800);
+    }
+
+    TEST_F(NetworkUniverseTest, BandwidthLimitQueuesAndDropsPackets)
+    {
+        // 1000 bytes per second: a 100 byte packet takes 100ms to send, and at
+        // most 300ms worth of packets wait in the queue.
+        universe.set_bandwidth(1000, 300);
+
+        IP_Port s2_addr;
+        ip_init(&s2_addr.ip, false);
+        s2_addr.ip.ip.v4.uint32 = net_htonl(0x7F000001);
+        s2_addr.port = net_htons(9004);
+        s2.bind(&s2_addr);
+
+        const std::vector<uint8_t> data(100, 0x42);
+        for (int i = 0; i < 10; ++i) {
+            s1.sendto(data.data(), data.size(), &s2_addr);
+        }
+
+        IP_Port from;
+        uint8_t buf[200];
+        universe.process_events(99);
+        ASSERT_EQ(s2.recvfrom(buf, sizeof(buf), &from), -1);
+
+        universe.process_events(100);
+        ASSERT_EQ(s2.recvfrom(buf, sizeof(buf), &from), 100);
+
+        universe.process_events(10000);
+        int received = 1;
+        while (s2.recvfrom(buf, sizeof(buf), &from) == 100) {
+            ++received;
+        }
+
+        // Packets starting at 0, 100, 200 and 300ms fit, the rest are dropped.
+        EXPECT_EQ(received, 4);
+    }
+
     TEST_F(NetworkUniverseTest, RoutesBasedOnIpAndPort)
     {
         IP ip1{}, ip2{};
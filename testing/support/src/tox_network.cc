@@ -233,6 +233,13 @@ uint32_t setup_connected_group(
         return UINT32_MAX;
     }
 
+    // Make room for everyone in groups bigger than the default limit.
+    if (friends.size() >= tox_group_get_peer_limit(main_tox, main_state.group_number, nullptr)
+        && !tox_group_set_peer_limit(main_tox, main_state.group_number,
+            static_cast<uint16_t>(friends.size() + 1), nullptr)) {
+        return UINT32_MAX;
+    }
+
     // Friend states tracked via events
     std::vector<NodeGroupState> friend_states(friends.size());
 
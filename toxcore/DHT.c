@@ -52,7 +52,7 @@
 #define DHT_FRIEND_MAX_LOCKS 32
 
 /* Settings for the shared key cache */
-#define MAX_KEYS_PER_SLOT 4
+#define KEYS_CACHE_CAPACITY 512
 #define KEYS_TIMEOUT 600
 
 typedef struct NAT {
@@ -116,6 +116,12 @@ struct DHT {
     bool lan_discovery_enabled;
 
     Client_data    close_clientlist[LCLIENT_LIST];
+    /* Close list slots holding a key that belongs in another bucket. A node
+     * can change its key while keeping its slot (see
+     * `client_or_ip_port_in_list`), so `get_close_nodes` checks these
+     * separately before it walks the buckets. */
+    bool           close_misplaced[LCLIENT_LIST];
+    uint16_t       num_close_misplaced;
     uint64_t       close_last_nodes_request;
     uint32_t       close_bootstrap_times;
 
@@ -145,6 +151,30 @@ struct DHT {
     dht_nodes_response_cb *_Nullable nodes_response_callback;
 };
 
+/** @brief Close list bucket for public_key: the number of leading bits it shares with ours. */
+static unsigned int close_bucket(const uint8_t *_Nonnull self_public_key, const uint8_t *_Nonnull public_key)
+{
+    const unsigned int index = bit_by_bit_cmp(public_key, self_public_key);
+    return index < LCLIENT_LENGTH ? index : LCLIENT_LENGTH - 1;
+}
+
+/** @brief Record whether the key in close list slot `index` is in the right bucket. */
+static void update_close_placement(DHT *_Nonnull dht, uint32_t index)
+{
+    const bool misplaced = close_bucket(dht->self_public_key, dht->close_clientlist[index].public_key)
+                           != index / LCLIENT_NODES;
+
+    if (misplaced != dht->close_misplaced[index]) {
+        dht->close_misplaced[index] = misplaced;
+
+        if (misplaced) {
+            ++dht->num_close_misplaced;
+        } else {
+            --dht->num_close_misplaced;
+        }
+    }
+}
+
 const uint8_t *dht_friend_public_key(const DHT_Friend *dht_friend)
 {
     return dht_friend->public_key;
@@ -167,6 +197,12 @@ const uint8_t *dht_get_self_secret_key(const DHT *dht)
 void dht_set_self_public_key(DHT *dht, const uint8_t *key)
 {
     memcpy(dht->self_public_key, key, CRYPTO_PUBLIC_KEY_SIZE);
+
+    for (uint32_t i = 0; i < LCLIENT_LIST; ++i) {
+        if (dht->close_clientlist[i].assoc4.timestamp != 0 || dht->close_clientlist[i].assoc6.timestamp != 0) {
+            update_close_placement(dht, i);
+        }
+    }
 }
 void dht_set_self_secret_key(DHT *dht, const uint8_t *key)
 {
@@ -284,6 +320,16 @@ const uint8_t *dht_get_shared_key_sent(DHT *dht, const uint8_t *public_key)
     return shared_key_cache_lookup(dht->shared_keys_sent, public_key);
 }
 
+const Shared_Key_Cache *dht_get_shared_keys_recv(const DHT *dht)
+{
+    return dht->shared_keys_recv;
+}
+
+const Shared_Key_Cache *dht_get_shared_keys_sent(const DHT *dht)
+{
+    return dht->shared_keys_sent;
+}
+
 #define CRYPTO_SIZE (1 + CRYPTO_PUBLIC_KEY_SIZE * 2 + CRYPTO_NONCE_SIZE)
 
 int create_request(const Memory *mem, const Random *rng, const uint8_t *send_public_key, const uint8_t *send_secret_key,
@@ -563,9 +609,11 @@ static void update_client(const Logger *_Nonnull log, const Mono_Time *_Nonnull
  * If it is then set its corresponding timestamp to current time.
  * If the id is already in the list with a different ip_port, update it.
  * TODO(irungentoo): Maybe optimize this.
+ *
+ * @return the index of the client, or UINT32_MAX if it isn't in the list.
  */
-static bool client_or_ip_port_in_list(const Logger *_Nonnull log, const Mono_Time *_Nonnull mono_time, Client_data *_Nonnull list, uint16_t length, const uint8_t *_Nonnull public_key,
-                                      const IP_Port *_Nonnull ip_port)
+static uint32_t client_or_ip_port_in_list(const Logger *_Nonnull log, const Mono_Time *_Nonnull mono_time, Client_data *_Nonnull list, uint16_t length, const uint8_t *_Nonnull public_key,
+        const IP_Port *_Nonnull ip_port)
 {
     const uint64_t temp_time = mono_time_get(mono_time);
     uint32_t index = index_of_client_pk(list, length, public_key);
@@ -573,7 +621,7 @@ static bool client_or_ip_port_in_list(const Logger *_Nonnull log, const Mono_Tim
     /* if public_key is in list, find it and maybe overwrite ip_port */
     if (index != UINT32_MAX) {
         update_client(log, mono_time, index, &list[index], ip_port);
-        return true;
+        return index;
     }
 
     /* public_key not in list yet: see if we can find an identical ip_port, in
@@ -584,7 +632,7 @@ static bool client_or_ip_port_in_list(const Logger *_Nonnull log, const Mono_Tim
     index = index_of_client_ip_port(list, length, ip_port);
 
     if (index == UINT32_MAX) {
-        return false;
+        return UINT32_MAX;
     }
 
     IPPTsPng *assoc;
@@ -616,7 +664,7 @@ static bool client_or_ip_port_in_list(const Logger *_Nonnull log, const Mono_Tim
         list[index].assoc4 = empty_ipptspng;
     }
 
-    return true;
+    return index;
 }
 
 bool add_to_list(
@@ -649,25 +697,58 @@ bool add_to_list(
     return inserted;
 }
 
+/** @brief Insert a node into nodes_list, which is sorted by distance to cmp_pk.
+ *
+ * If the list already holds max_nodes nodes, the farthest one drops out.
+ *
+ * @return true iff the node was added to the list.
+ */
+static bool add_to_sorted_list(Node_format *_Nonnull nodes_list, uint32_t *_Nonnull num_nodes, uint32_t max_nodes,
+                               const uint8_t *_Nonnull pk, const IP_Port *_Nonnull ip_port, const uint8_t *_Nonnull cmp_pk)
+{
+    /* First position holding a node farther from cmp_pk than pk. */
+    uint32_t low = 0;
+    uint32_t high = *num_nodes;
+
+    while (low < high) {
+        const uint32_t mid = low + (high - low) / 2;
+
+        if (id_closest(cmp_pk, nodes_list[mid].public_key, pk) == 2) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+
+    if (low >= max_nodes) {
+        return false;
+    }
+
+    const uint32_t count = *num_nodes < max_nodes ? *num_nodes + 1 : max_nodes;
+    memmove(&nodes_list[low + 1], &nodes_list[low], (count - 1 - low) * sizeof(Node_format));
+    memcpy(nodes_list[low].public_key, pk, CRYPTO_PUBLIC_KEY_SIZE);
+    nodes_list[low].ip_port = *ip_port;
+    *num_nodes = count;
+    return true;
+}
+
 /**
  * helper for `get_close_nodes()`. argument list is a monster :D
  */
 static void get_close_nodes_inner(uint64_t cur_time, const uint8_t *_Nonnull public_key, Node_format *_Nonnull nodes_list, uint32_t *_Nonnull num_nodes_ptr, Family sa_family,
                                   const Client_data *_Nonnull client_list, uint32_t client_list_length, bool is_lan, bool want_announce)
 {
-    if (!net_family_is_ipv4(sa_family) && !net_family_is_ipv6(sa_family) && !net_family_is_unspec(sa_family)) {
-        return;
-    }
-
     uint32_t num_nodes = *num_nodes_ptr;
+    const bool want_ipv4 = net_family_is_ipv4(sa_family);
+    const bool want_ipv6 = net_family_is_ipv6(sa_family);
 
     for (uint32_t i = 0; i < client_list_length; ++i) {
         const Client_data *const client = &client_list[i];
         const IPPTsPng *ipptp;
 
-        if (net_family_is_ipv4(sa_family)) {
+        if (want_ipv4) {
             ipptp = &client->assoc4;
-        } else if (net_family_is_ipv6(sa_family)) {
+        } else if (want_ipv6) {
             ipptp = &client->assoc6;
         } else if (client->assoc4.timestamp >= client->assoc6.timestamp) {
             ipptp = &client->assoc4;
@@ -698,45 +779,113 @@ static void get_close_nodes_inner(uint64_t cur_time, const uint8_t *_Nonnull pub
             continue;
         }
 
-        if (num_nodes < MAX_SENT_NODES) {
-            memcpy(nodes_list[num_nodes].public_key, client->public_key, CRYPTO_PUBLIC_KEY_SIZE);
-            nodes_list[num_nodes].ip_port = ipptp->ip_port;
-            ++num_nodes;
-        } else {
-            // TODO(zugz): this could be made significantly more efficient by
-            // using a version of add_to_list which works with a sorted list.
-            add_to_list(nodes_list, MAX_SENT_NODES, client->public_key, &ipptp->ip_port, public_key);
-        }
+        add_to_sorted_list(nodes_list, &num_nodes, MAX_SENT_NODES, client->public_key, &ipptp->ip_port, public_key);
     }
 
     *num_nodes_ptr = num_nodes;
 }
 
-/**
- * Find MAX_SENT_NODES nodes closest to the public_key for the nodes request:
- * put them in the nodes_list and return how many were found.
+/** @brief Rank of close list bucket `bucket` by distance from a key in bucket `target`.
+ *
+ * Every key in a bucket of lower rank is closer to that key than every key in
+ * a bucket of higher rank. Keys in buckets of the same rank need a full
+ * comparison.
  *
- * want_announce: return only nodes which implement the dht announcements protocol.
+ * Keys in the target's own bucket share at least one more bit with it than
+ * anything else, so they come first. Keys in all buckets above it share
+ * exactly `target` bits with it, and keys in bucket `n` below it share `n`.
  */
-static int get_somewhat_close_nodes(uint64_t cur_time, const uint8_t *_Nonnull public_key, Node_format nodes_list[_Nonnull MAX_SENT_NODES], Family sa_family,
-                                    const Client_data *_Nonnull close_clientlist, const DHT_Friend *_Nonnull friends_list, uint16_t friends_list_size, bool is_lan, bool want_announce)
+static unsigned int close_bucket_rank(unsigned int target, unsigned int bucket)
+{
+    if (bucket == target) {
+        return 0;
+    }
+
+    if (bucket > target) {
+        return 1;
+    }
+
+    return 1 + target - bucket;
+}
+
+/** @brief Whether buckets of rank higher than `rank` can't improve nodes_list. */
+static bool close_nodes_complete(const DHT *_Nonnull dht, const Node_format *_Nonnull nodes_list, uint32_t num_nodes,
+                                 unsigned int target, unsigned int rank)
+{
+    if (num_nodes < MAX_SENT_NODES) {
+        return false;
+    }
+
+    /* The farthest node may have come from a misplaced slot, so rank it by its key. */
+    const unsigned int farthest = close_bucket(dht->self_public_key, nodes_list[num_nodes - 1].public_key);
+    return close_bucket_rank(target, farthest) <= rank;
+}
+
+/** @brief Find the nodes closest to public_key in the close list.
+ *
+ * Walks the buckets in order of rank and stops as soon as the rest of the
+ * buckets are all farther than the nodes found so far. For most keys, this
+ * only looks at the bucket the key falls into.
+ */
+static void get_close_nodes_from_close_list(const DHT *_Nonnull dht, const uint8_t *_Nonnull public_key,
+        Node_format *_Nonnull nodes_list, uint32_t *_Nonnull num_nodes, Family sa_family, bool is_lan, bool want_announce)
+{
+    const Client_data *const list = dht->close_clientlist;
+
+    if (dht->num_close_misplaced > 0) {
+        for (uint32_t i = 0; i < LCLIENT_LIST; ++i) {
+            if (dht->close_misplaced[i]) {
+                get_close_nodes_inner(dht->cur_time, public_key, nodes_list, num_nodes, sa_family,
+                                      &list[i], 1, is_lan, want_announce);
+            }
+        }
+    }
+
+    const unsigned int target = close_bucket(dht->self_public_key, public_key);
+
+    get_close_nodes_inner(dht->cur_time, public_key, nodes_list, num_nodes, sa_family,
+                          &list[target * LCLIENT_NODES], LCLIENT_NODES, is_lan, want_announce);
+
+    if (close_nodes_complete(dht, nodes_list, *num_nodes, target, 0)) {
+        return;
+    }
+
+    get_close_nodes_inner(dht->cur_time, public_key, nodes_list, num_nodes, sa_family,
+                          &list[(target + 1) * LCLIENT_NODES], (LCLIENT_LENGTH - 1 - target) * LCLIENT_NODES,
+                          is_lan, want_announce);
+
+    /* Each pass first checks the rank just walked: rank 1, then bucket `bucket`. */
+    for (unsigned int bucket = target; bucket > 0; --bucket) {
+        if (close_nodes_complete(dht, nodes_list, *num_nodes, target, 1 + target - bucket)) {
+            return;
+        }
+
+        get_close_nodes_inner(dht->cur_time, public_key, nodes_list, num_nodes, sa_family,
+                              &list[(bucket - 1) * LCLIENT_NODES], LCLIENT_NODES, is_lan, want_announce);
+    }
+}
+
+int get_close_nodes(
+    const DHT *dht, const uint8_t *public_key,
+    Node_format nodes_list[MAX_SENT_NODES], Family sa_family,
+    bool is_lan, bool want_announce)
 {
     for (uint16_t i = 0; i < MAX_SENT_NODES; ++i) {
         nodes_list[i] = empty_node_format;
     }
 
+    if (!net_family_is_ipv4(sa_family) && !net_family_is_ipv6(sa_family) && !net_family_is_unspec(sa_family)) {
+        return 0;
+    }
+
     uint32_t num_nodes = 0;
-    get_close_nodes_inner(
-        cur_time, public_key,
-        nodes_list, &num_nodes,
-        sa_family, close_clientlist, LCLIENT_LIST,
-        is_lan, want_announce);
+    get_close_nodes_from_close_list(dht, public_key, nodes_list, &num_nodes, sa_family, is_lan, want_announce);
 
-    for (uint16_t i = 0; i < friends_list_size; ++i) {
-        const DHT_Friend *dht_friend = &friends_list[i];
+    for (uint16_t i = 0; i < dht->num_friends; ++i) {
+        const DHT_Friend *dht_friend = &dht->friends_list[i];
 
         get_close_nodes_inner(
-            cur_time, public_key,
+            dht->cur_time, public_key,
             nodes_list, &num_nodes,
             sa_family, dht_friend->client_list, MAX_FRIEND_CLIENTS,
             is_lan, want_announce);
@@ -745,18 +894,6 @@ static int get_somewhat_close_nodes(uint64_t cur_time, const uint8_t *_Nonnull p
     return num_nodes;
 }
 
-int get_close_nodes(
-    const DHT *dht, const uint8_t *public_key,
-    Node_format nodes_list[MAX_SENT_NODES], Family sa_family,
-    bool is_lan, bool want_announce)
-{
-    return get_somewhat_close_nodes(
-               dht->cur_time, public_key, nodes_list,
-               sa_family, dht->close_clientlist,
-               dht->friends_list, dht->num_friends,
-               is_lan, want_announce);
-}
-
 #ifdef CHECK_ANNOUNCE_NODE
 static void set_announce_node_in_list(Client_data *_Nonnull list, uint32_t list_len, const uint8_t *_Nonnull public_key)
 {
@@ -769,11 +906,7 @@ static void set_announce_node_in_list(Client_data *_Nonnull list, uint32_t list_
 
 void set_announce_node(DHT *dht, const uint8_t *public_key)
 {
-    unsigned int index = bit_by_bit_cmp(public_key, dht->self_public_key);
-
-    if (index >= LCLIENT_LENGTH) {
-        index = LCLIENT_LENGTH - 1;
-    }
+    const unsigned int index = close_bucket(dht->self_public_key, public_key);
 
     set_announce_node_in_list(dht->close_clientlist + index * LCLIENT_NODES, LCLIENT_NODES, public_key);
 
@@ -1042,15 +1175,9 @@ static bool replace_all(const DHT *_Nonnull dht, Client_data *_Nonnull list, uin
  */
 static bool add_to_close(DHT *_Nonnull dht, const uint8_t *_Nonnull public_key, const IP_Port *_Nonnull ip_port, bool simulate)
 {
-    unsigned int index = bit_by_bit_cmp(public_key, dht->self_public_key);
-
-    if (index >= LCLIENT_LENGTH) {
-        index = LCLIENT_LENGTH - 1;
-    }
+    const unsigned int index = close_bucket(dht->self_public_key, public_key);
 
     for (uint32_t i = 0; i < LCLIENT_NODES; ++i) {
-        /* TODO(iphydf): write bounds checking test to catch the case that
-         * index is left as >= LCLIENT_LENGTH */
         Client_data *const client = &dht->close_clientlist[(index * LCLIENT_NODES) + i];
 
         if (!assoc_timeout(dht->cur_time, &client->assoc4) ||
@@ -1064,6 +1191,7 @@ static bool add_to_close(DHT *_Nonnull dht, const uint8_t *_Nonnull public_key,
 
         pk_copy(client->public_key, public_key);
         update_client_with_reset(dht->mono_time, client, ip_port);
+        update_close_placement(dht, (index * LCLIENT_NODES) + i);
 #ifdef CHECK_ANNOUNCE_NODE
         client->announce_node = false;
         send_announce_ping(dht, public_key, ip_port);
@@ -1097,11 +1225,7 @@ static bool is_pk_in_client_list(const Client_data *_Nonnull list, unsigned int
 
 static bool is_pk_in_close_list(const DHT *_Nonnull dht, const uint8_t *_Nonnull public_key, const IP_Port *_Nonnull ip_port)
 {
-    unsigned int index = bit_by_bit_cmp(public_key, dht->self_public_key);
-
-    if (index >= LCLIENT_LENGTH) {
-        index = LCLIENT_LENGTH - 1;
-    }
+    const unsigned int index = close_bucket(dht->self_public_key, public_key);
 
     return is_pk_in_client_list(dht->close_clientlist + index * LCLIENT_NODES, LCLIENT_NODES, dht->cur_time, public_key,
                                 ip_port);
@@ -1188,8 +1312,13 @@ uint32_t addto_lists(DHT *dht, const IP_Port *ip_port, const uint8_t *public_key
     /* NOTE: Current behavior if there are two clients with the same id is
      * to replace the first ip by the second.
      */
-    const bool in_close_list = client_or_ip_port_in_list(dht->log, dht->mono_time, dht->close_clientlist, LCLIENT_LIST,
-                               public_key, &ipp_copy);
+    const uint32_t close_index = client_or_ip_port_in_list(dht->log, dht->mono_time, dht->close_clientlist, LCLIENT_LIST,
+                                 public_key, &ipp_copy);
+    const bool in_close_list = close_index != UINT32_MAX;
+
+    if (in_close_list) {
+        update_close_placement(dht, close_index);
+    }
 
     /* add_to_close should be called only if !in_list (don't extract to variable) */
     if (in_close_list || !add_to_close(dht, public_key, &ipp_copy, false)) {
@@ -1200,7 +1329,7 @@ uint32_t addto_lists(DHT *dht, const IP_Port *ip_port, const uint8_t *public_key
 
     for (uint32_t i = 0; i < dht->num_friends; ++i) {
         const bool in_list = client_or_ip_port_in_list(dht->log, dht->mono_time, dht->friends_list[i].client_list,
-                             MAX_FRIEND_CLIENTS, public_key, &ipp_copy);
+                             MAX_FRIEND_CLIENTS, public_key, &ipp_copy) != UINT32_MAX;
 
         /* replace_all should be called only if !in_list (don't extract to variable) */
         if (in_list
@@ -2438,6 +2567,12 @@ void cryptopacket_registerhandler(DHT *dht, uint8_t byte, cryptopacket_handler_c
     dht->cryptopackethandlers[byte].object = object;
 }
 
+cryptopacket_handler_cb *cryptopacket_get_handler(const DHT *dht, uint8_t byte, void **object)
+{
+    *object = dht->cryptopackethandlers[byte].object;
+    return dht->cryptopackethandlers[byte].function;
+}
+
 static int cryptopacket_handle(void *_Nonnull object, const IP_Port *_Nonnull source, const uint8_t *_Nonnull packet, uint16_t length, void *_Nonnull userdata)
 {
     DHT *const dht = (DHT *)object;
@@ -2555,7 +2690,7 @@ DHT *new_dht(const Logger *log, const Memory *mem, const Random *rng, const Netw
 
     crypto_new_keypair(rng, dht->self_public_key, dht->self_secret_key);
 
-    Shared_Key_Cache *const temp_shared_keys_recv = shared_key_cache_new(log, mono_time, mem, dht->self_secret_key, KEYS_TIMEOUT, MAX_KEYS_PER_SLOT);
+    Shared_Key_Cache *const temp_shared_keys_recv = shared_key_cache_new(log, mono_time, mem, rng, dht->self_secret_key, KEYS_TIMEOUT, KEYS_CACHE_CAPACITY);
 
     if (temp_shared_keys_recv == nullptr) {
         LOGGER_ERROR(log, "failed to initialise shared key cache");
@@ -2565,7 +2700,7 @@ DHT *new_dht(const Logger *log, const Memory *mem, const Random *rng, const Netw
 
     dht->shared_keys_recv = temp_shared_keys_recv;
 
-    Shared_Key_Cache *const temp_shared_keys_sent = shared_key_cache_new(log, mono_time, mem, dht->self_secret_key, KEYS_TIMEOUT, MAX_KEYS_PER_SLOT);
+    Shared_Key_Cache *const temp_shared_keys_sent = shared_key_cache_new(log, mono_time, mem, rng, dht->self_secret_key, KEYS_TIMEOUT, KEYS_CACHE_CAPACITY);
 
     if (temp_shared_keys_sent == nullptr) {
         LOGGER_ERROR(log, "failed to initialise shared key cache");
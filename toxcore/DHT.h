@@ -21,6 +21,7 @@
 #include "network.h"
 #include "ping_array.h"
 #include "rng.h"
+#include "shared_key_cache.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -234,6 +235,10 @@ const uint8_t *_Nullable dht_get_shared_key_recv(DHT *_Nonnull dht, const uint8_
  */
 const uint8_t *_Nullable dht_get_shared_key_sent(DHT *_Nonnull dht, const uint8_t *_Nonnull public_key);
 
+/** @brief The shared key caches behind `dht_get_shared_key_recv` and `dht_get_shared_key_sent`. */
+const Shared_Key_Cache *_Nonnull dht_get_shared_keys_recv(const DHT *_Nonnull dht);
+const Shared_Key_Cache *_Nonnull dht_get_shared_keys_sent(const DHT *_Nonnull dht);
+
 /**
  * Sends a nodes request to `ip_port` with the public key `public_key` for nodes
  * that are close to `client_id`.
@@ -314,7 +319,7 @@ void set_announce_node(DHT *_Nonnull dht, const uint8_t *_Nonnull public_key);
 
 /**
  * @brief Get the (maximum MAX_SENT_NODES) closest nodes to public_key we know
- * and put them in nodes_list (must be MAX_SENT_NODES big).
+ * and put them in nodes_list (must be MAX_SENT_NODES big), closest first.
  *
  * @param sa_family family (IPv4 or IPv6) (0 if we don't care)?
  * @param is_lan return some LAN ips (true or false).
@@ -392,6 +397,10 @@ uint32_t route_to_friend(const DHT *_Nonnull dht, const uint8_t *_Nonnull friend
 
 /** Function to handle crypto packets. */
 void cryptopacket_registerhandler(DHT *_Nonnull dht, uint8_t byte, cryptopacket_handler_cb *_Nullable cb, void *_Nullable object);
+
+/** @brief Get the function and object registered for crypto packets of type byte. */
+cryptopacket_handler_cb *_Nullable cryptopacket_get_handler(const DHT *_Nonnull dht, uint8_t byte, void *_Nullable *_Nonnull object);
+
 /* SAVE/LOAD functions */
 
 /** Get the size of the DHT (for saving). */
@@ -0,0 +1,171 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "../testing/support/public/simulated_environment.hh"
+#include "DHT.h"
+#include "DHT_test_util.hh"
+#include "LAN_discovery.h"
+#include "crypto_core.h"
+#include "mono_time.h"
+#include "network.h"
+
+namespace {
+
+using tox::test::SimulatedEnvironment;
+using PublicKey = std::array<std::uint8_t, CRYPTO_PUBLIC_KEY_SIZE>;
+
+/** @brief Number of pre-generated request targets, replayed in a loop. */
+constexpr std::size_t kNumTargets = 1024;
+
+/** @brief A key that shares exactly `bucket` leading bits with `base`. */
+PublicKey key_in_bucket(const Random *rng, const std::uint8_t *base, unsigned int bucket)
+{
+    PublicKey key;
+    random_bytes(rng, key.data(), key.size());
+
+    for (unsigned int bit = 0; bit <= bucket; ++bit) {
+        const std::uint8_t mask = 1 << (7 - bit % 8);
+        const bool base_bit = (base[bit / 8] & mask) != 0;
+        if (base_bit != (bit == bucket)) {
+            key[bit / 8] |= mask;
+        } else {
+            key[bit / 8] &= ~mask;
+        }
+    }
+
+    return key;
+}
+
+/**
+ * @brief The nodes request lookup before the close list was searched by
+ * bucket: look at every node and keep the closest with add_to_list.
+ *
+ * Kept here as the baseline, with the same checks per node as it had.
+ */
+int scan_close_nodes(DHT *dht, const Mono_Time *mono_time, const std::uint8_t *public_key,
+    Node_format nodes_list[MAX_SENT_NODES], Family sa_family, bool is_lan)
+{
+    const std::uint64_t cur_time = mono_time_get(mono_time);
+    std::uint32_t num_nodes = 0;
+
+    const auto scan = [&](const Client_data *list, std::size_t length) {
+        for (std::size_t i = 0; i < length; ++i) {
+            const Client_data *client = &list[i];
+            const IPPTsPng *ipptp;
+
+            if (net_family_is_ipv4(sa_family)) {
+                ipptp = &client->assoc4;
+            } else if (net_family_is_ipv6(sa_family)) {
+                ipptp = &client->assoc6;
+            } else if (client->assoc4.timestamp >= client->assoc6.timestamp) {
+                ipptp = &client->assoc4;
+            } else {
+                ipptp = &client->assoc6;
+            }
+
+            if (ipptp->timestamp + BAD_NODE_TIMEOUT <= cur_time) {
+                continue;
+            }
+
+            if (ip_is_lan(&ipptp->ip_port.ip) && !is_lan) {
+                continue;
+            }
+
+            bool known = false;
+            for (std::uint32_t j = 0; j < num_nodes && !known; ++j) {
+                known = pk_equal(nodes_list[j].public_key, client->public_key);
+            }
+            if (known) {
+                continue;
+            }
+
+            if (num_nodes < MAX_SENT_NODES) {
+                std::memcpy(nodes_list[num_nodes].public_key, client->public_key, CRYPTO_PUBLIC_KEY_SIZE);
+                nodes_list[num_nodes].ip_port = ipptp->ip_port;
+                ++num_nodes;
+            } else {
+                add_to_list(nodes_list, MAX_SENT_NODES, client->public_key, &ipptp->ip_port, public_key);
+            }
+        }
+    };
+
+    scan(dht_get_close_clientlist(dht), LCLIENT_LIST);
+
+    for (std::uint16_t f = 0; f < dht_get_num_friends(dht); ++f) {
+        scan(dht_friend_client(dht_get_friend(dht, f), 0), MAX_FRIEND_CLIENTS);
+    }
+
+    return static_cast<int>(num_nodes);
+}
+
+/**
+ * @brief Answer nodes requests for random keys, as a bootstrap node does.
+ *
+ * range(0): nodes offered to the close list. Half are random keys, which only
+ *   fill the first few buckets, the rest are spread over all buckets, so the
+ *   table fills up as this grows.
+ * range(1): 0 for get_close_nodes, 1 for the old scan of the whole close list.
+ */
+void BM_GetCloseNodes(benchmark::State &state)
+{
+    const auto num_offered = static_cast<std::uint32_t>(state.range(0));
+    const bool scan = state.range(1) != 0;
+
+    SimulatedEnvironment env{12345};
+    WrappedDHT node(env, 33445);
+    DHT *dht = node.get_dht();
+    const Random *rng = &node.node().c_random;
+    const std::uint8_t *self_pk = dht_get_self_public_key(dht);
+
+    for (std::uint32_t n = 0; n < num_offered; ++n) {
+        const PublicKey pk = n % 2 == 0 ? key_in_bucket(rng, self_pk, random_u32(rng) % 8)
+                                        : key_in_bucket(rng, self_pk, random_u32(rng) % LCLIENT_LENGTH);
+        IP_Port ip_port = {0};
+        ip_port.ip.family = net_family_ipv4();
+        ip_port.ip.ip.v4.uint32 = net_htonl(0x01000000 + n);
+        ip_port.port = net_htons(33445);
+        addto_lists(dht, &ip_port, pk.data());
+    }
+
+    std::size_t in_table = 0;
+    const Client_data *list = dht_get_close_clientlist(dht);
+    for (std::size_t i = 0; i < LCLIENT_LIST; ++i) {
+        in_table += list[i].assoc4.timestamp != 0 ? 1 : 0;
+    }
+
+    std::vector<PublicKey> targets(kNumTargets);
+    for (PublicKey &target : targets) {
+        random_bytes(rng, target.data(), target.size());
+    }
+
+    Node_format nodes[MAX_SENT_NODES];
+    std::size_t i = 0;
+
+    for (auto _ : state) {
+        const std::uint8_t *target = targets[i++ % kNumTargets].data();
+        const int num = scan ? scan_close_nodes(dht, node.mono_time(), target, nodes, net_family_unspec(), false)
+                             : get_close_nodes(dht, target, nodes, net_family_unspec(), false, false);
+        benchmark::DoNotOptimize(num);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.counters["in_table"] = static_cast<double>(in_table);
+}
+
+BENCHMARK(BM_GetCloseNodes)
+    ->ArgNames({"offered", "scan"})
+    ->ArgsProduct({{16, 64, 256, 1024, 4096}, {0, 1}});
+
+}  // namespace
+
+BENCHMARK_MAIN();
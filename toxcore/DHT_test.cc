@@ -7,6 +7,7 @@
 #include <array>
 #include <cstring>
 #include <random>
+#include <vector>
 
 #include "../testing/support/public/simulated_environment.hh"
 #include "DHT_test_util.hh"
@@ -401,4 +402,163 @@ TEST(AnnounceNodes, SetAndTest)
     logger_kill(log);
 }
 
+/** @brief A key that shares exactly `bucket` leading bits with `base`. */
+PublicKey key_in_bucket(const Random *_Nonnull rng, const std::uint8_t *_Nonnull base, unsigned int bucket)
+{
+    std::array<std::uint8_t, CRYPTO_PUBLIC_KEY_SIZE> key;
+    random_bytes(rng, key.data(), key.size());
+
+    for (unsigned int bit = 0; bit <= bucket; ++bit) {
+        const std::uint8_t mask = 1 << (7 - bit % 8);
+        const bool base_bit = (base[bit / 8] & mask) != 0;
+        // Copy the leading bits, then flip the one after them.
+        if (base_bit != (bit == bucket)) {
+            key[bit / 8] |= mask;
+        } else {
+            key[bit / 8] &= ~mask;
+        }
+    }
+
+    return PublicKey(key);
+}
+
+IP_Port node_ip_port(std::uint32_t n)
+{
+    IP_Port ip_port = {0};
+    ip_port.ip.family = net_family_ipv4();
+    ip_port.ip.ip.v4.uint32 = net_htonl(0x01000000 + n);
+    ip_port.port = net_htons(33445);
+    return ip_port;
+}
+
+/**
+ * @brief The MAX_SENT_NODES closest live nodes, by looking at every node in the
+ * close list and the friends' lists.
+ */
+std::vector<Node_format> closest_known_nodes(DHT *_Nonnull dht, const std::uint8_t *_Nonnull target)
+{
+    std::vector<Node_format> nodes;
+    const auto add = [&nodes](const Client_data &client) {
+        if (client.assoc4.timestamp == 0
+            || std::any_of(nodes.begin(), nodes.end(), [&client](const Node_format &node) {
+                   return pk_equal(node.public_key, client.public_key);
+               })) {
+            return;
+        }
+
+        Node_format node;
+        std::memcpy(node.public_key, client.public_key, CRYPTO_PUBLIC_KEY_SIZE);
+        node.ip_port = client.assoc4.ip_port;
+        nodes.push_back(node);
+    };
+
+    const Client_data *list = dht_get_close_clientlist(dht);
+
+    for (std::size_t i = 0; i < LCLIENT_LIST; ++i) {
+        add(list[i]);
+    }
+
+    for (std::uint16_t f = 0; f < dht_get_num_friends(dht); ++f) {
+        for (std::size_t i = 0; i < MAX_FRIEND_CLIENTS; ++i) {
+            add(*dht_friend_client(dht_get_friend(dht, f), i));
+        }
+    }
+
+    std::sort(nodes.begin(), nodes.end(), [target](const Node_format &a, const Node_format &b) {
+        return id_closest(target, a.public_key, b.public_key) == 1;
+    });
+    nodes.resize(std::min<std::size_t>(nodes.size(), MAX_SENT_NODES));
+    return nodes;
+}
+
+std::vector<Node_format> close_nodes(const DHT *_Nonnull dht, const std::uint8_t *_Nonnull target)
+{
+    Node_format nodes[MAX_SENT_NODES];
+    const int num = get_close_nodes(dht, target, nodes, net_family_unspec(), true, false);
+    return std::vector<Node_format>(nodes, nodes + std::max(num, 0));
+}
+
+TEST(GetCloseNodes, MatchesSearchOfWholeCloseList)
+{
+    SimulatedEnvironment env{12345};
+    WrappedDHT node(env, 33445);
+    DHT *dht = node.get_dht();
+    const Random *rng = &node.node().c_random;
+    const std::uint8_t *self_pk = dht_get_self_public_key(dht);
+
+    EXPECT_THAT(close_nodes(dht, random_pk(rng).data()), ::testing::IsEmpty());
+
+    for (std::uint32_t n = 0; n < 800; ++n) {
+        // Half the keys are uniformly random and fill the low buckets; the
+        // rest spread over all buckets, like a table that's been running a while.
+        const PublicKey pk = n % 2 == 0 ? random_pk(rng) : key_in_bucket(rng, self_pk, random_u32(rng) % 256);
+        const IP_Port ip_port = node_ip_port(n);
+        addto_lists(dht, &ip_port, pk.data());
+
+        if (n % 50 != 0) {
+            continue;
+        }
+
+        for (int i = 0; i < 20; ++i) {
+            const PublicKey target = i % 2 == 0 ? random_pk(rng) : key_in_bucket(rng, self_pk, random_u32(rng) % 256);
+            ASSERT_EQ(close_nodes(dht, target.data()), closest_known_nodes(dht, target.data()))
+                << "after " << n + 1 << " nodes, target " << target;
+        }
+
+        ASSERT_EQ(close_nodes(dht, self_pk), closest_known_nodes(dht, self_pk));
+    }
+}
+
+TEST(GetCloseNodes, FindsNodeThatChangedKey)
+{
+    SimulatedEnvironment env{12345};
+    WrappedDHT node(env, 33445);
+    DHT *dht = node.get_dht();
+    const Random *rng = &node.node().c_random;
+    const std::uint8_t *self_pk = dht_get_self_public_key(dht);
+
+    for (std::uint32_t n = 0; n < 40; ++n) {
+        const PublicKey pk = key_in_bucket(rng, self_pk, n % 5);
+        const IP_Port ip_port = node_ip_port(n);
+        addto_lists(dht, &ip_port, pk.data());
+    }
+
+    // A node in a low bucket comes back with a key that belongs in bucket 200.
+    // It keeps its slot, but still has to be the closest node to its new key.
+    // Pick one that no friend list knows, so only the close list can find it.
+    const auto in_friend_lists = [dht](const IP_Port &ip_port) {
+        for (std::uint16_t f = 0; f < dht_get_num_friends(dht); ++f) {
+            for (std::size_t i = 0; i < MAX_FRIEND_CLIENTS; ++i) {
+                if (ipport_equal(&dht_friend_client(dht_get_friend(dht, f), i)->assoc4.ip_port, &ip_port)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+    std::uint32_t moved = 0;
+    while (in_friend_lists(node_ip_port(moved))) {
+        ++moved;
+    }
+    ASSERT_LT(moved, 40);
+
+    const PublicKey new_key = key_in_bucket(rng, self_pk, 200);
+    const IP_Port ip_port = node_ip_port(moved);
+    addto_lists(dht, &ip_port, new_key.data());
+
+    const std::vector<Node_format> nodes = close_nodes(dht, new_key.data());
+    ASSERT_FALSE(nodes.empty());
+    EXPECT_EQ(PublicKey(nodes[0].public_key), new_key);
+    EXPECT_EQ(nodes, closest_known_nodes(dht, new_key.data()));
+
+    // Changing our own key moves every node to another bucket.
+    const PublicKey other_self = random_pk(rng);
+    dht_set_self_public_key(dht, other_self.data());
+
+    for (int i = 0; i < 50; ++i) {
+        const PublicKey target = key_in_bucket(rng, other_self.data(), random_u32(rng) % 8);
+        EXPECT_EQ(close_nodes(dht, target.data()), closest_known_nodes(dht, target.data()));
+    }
+}
+
 }  // namespace
@@ -245,13 +245,18 @@ static bool send_broadcasts(const Networking_Core *_Nonnull net, const Broadcast
         return false;
     }
 
+    IP_Port ip_ports[MAX_INTERFACES];
+    Net_Packet packets[MAX_INTERFACES];
+
     for (uint32_t i = 0; i < broadcast->count; ++i) {
-        IP_Port ip_port;
-        ip_port.ip = broadcast->ips[i];
-        ip_port.port = port;
-        sendpacket(net, &ip_port, data, length);
+        ip_ports[i].ip = broadcast->ips[i];
+        ip_ports[i].port = port;
+        packets[i].data = data;
+        packets[i].length = length;
     }
 
+    net_send_packets(net, ip_ports, packets, (uint16_t)broadcast->count);
+
     return true;
 }
 
@@ -17,6 +17,10 @@
 #include "net.h"
 #include "network.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /**
  * Interval in seconds between LAN discovery packet sending.
  */
@@ -52,4 +56,8 @@ bool ip_is_local(const IP *_Nonnull ip);
  */
 bool ip_is_lan(const IP *_Nonnull ip);
 
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
 #endif /* C_TOXCORE_TOXCORE_LAN_DISCOVERY_H */
@@ -30,6 +30,7 @@
 #include "group_chats.h"
 #include "group_common.h"
 #include "group_onion_announce.h"
+#include "iter_profile.h"
 #include "logger.h"
 #include "mem.h"
 #include "mono_time.h"
@@ -216,6 +217,8 @@ static int32_t init_new_friend(Messenger *_Nonnull m, const uint8_t *_Nonnull re
                 ++m->numfriends;
             }
 
+            m_mark_state_dirty(m, STATE_TYPE_FRIENDS);
+
             if (friend_con_connected(m->fr_c, friendcon_id) == FRIENDCONN_STATUS_CONNECTED) {
                 send_online_packet(m, friendcon_id);
             }
@@ -305,6 +308,7 @@ int32_t m_addfriend(Messenger *m, const uint8_t *address, const uint8_t *data, u
         }
 
         m->friendlist[friend_id].friendrequest_nospam = nospam;
+        m_mark_state_dirty(m, STATE_TYPE_FRIENDS);
         return FAERR_SETNEWNOSPAM;
     }
 
@@ -473,6 +477,8 @@ static int do_receipts(Messenger *_Nonnull m, int32_t friendnumber, void *_Nulla
     return 0;
 }
 
+static void free_file_tables(const Memory *_Nonnull mem, Friend *_Nonnull f);
+
 /** @brief Remove a friend.
  *
  * @retval 0 if success.
@@ -494,6 +500,7 @@ int m_delfriend(Messenger *m, int32_t friendnumber)
     }
 
     kill_friend_connection(m->fr_c, m->friendlist[friendnumber].friendcon_id);
+    free_file_tables(m->mem, &m->friendlist[friendnumber]);
     m->friendlist[friendnumber] = empty_friend;
 
     uint32_t i;
@@ -505,6 +512,7 @@ int m_delfriend(Messenger *m, int32_t friendnumber)
     }
 
     m->numfriends = i;
+    m_mark_state_dirty(m, STATE_TYPE_FRIENDS);
 
     if (realloc_friendlist(m, m->numfriends) != 0) {
         return FAERR_NOMEM;
@@ -670,6 +678,7 @@ int setfriendname(Messenger *m, int32_t friendnumber, const uint8_t *name, uint1
 
     m->friendlist[friendnumber].name_length = length;
     memcpy(m->friendlist[friendnumber].name, name, length);
+    m_mark_state_dirty(m, STATE_TYPE_FRIENDS);
     return 0;
 }
 
@@ -697,6 +706,7 @@ int setname(Messenger *m, const uint8_t *name, uint16_t length)
     }
 
     m->name_length = length;
+    m_mark_state_dirty(m, STATE_TYPE_NAME);
 
     for (uint32_t i = 0; i < m->numfriends; ++i) {
         m->friendlist[i].name_sent = false;
@@ -771,6 +781,7 @@ int m_set_statusmessage(Messenger *m, const uint8_t *status, uint16_t length)
     }
 
     m->statusmessage_length = length;
+    m_mark_state_dirty(m, STATE_TYPE_STATUSMESSAGE);
 
     for (uint32_t i = 0; i < m->numfriends; ++i) {
         m->friendlist[i].statusmessage_sent = false;
@@ -820,6 +831,7 @@ int m_set_userstatus(Messenger *m, uint8_t status)
     }
 
     userstatus_from_int(status, &m->userstatus);
+    m_mark_state_dirty(m, STATE_TYPE_STATUS);
 
     for (uint32_t i = 0; i < m->numfriends; ++i) {
         m->friendlist[i].userstatus_sent = false;
@@ -965,12 +977,14 @@ static int set_friend_statusmessage(const Messenger *_Nonnull m, int32_t friendn
     }
 
     m->friendlist[friendnumber].statusmessage_length = length;
+    m_mark_state_dirty(m, STATE_TYPE_FRIENDS);
     return 0;
 }
 
 static void set_friend_userstatus(const Messenger *_Nonnull m, int32_t friendnumber, uint8_t status)
 {
     userstatus_from_int(status, &m->friendlist[friendnumber].userstatus);
+    m_mark_state_dirty(m, STATE_TYPE_FRIENDS);
 }
 
 static void set_friend_typing(const Messenger *_Nonnull m, int32_t friendnumber, bool is_typing)
@@ -1073,6 +1087,11 @@ static void check_friend_connectionstatus(Messenger *_Nonnull m, int32_t friendn
 
 static void set_friend_status(Messenger *_Nonnull m, int32_t friendnumber, uint8_t status, void *_Nullable userdata)
 {
+    if (m->friendlist[friendnumber].status != status) {
+        // The status and, once the friend goes offline, their last seen time are saved.
+        m_mark_state_dirty(m, STATE_TYPE_FRIENDS);
+    }
+
     check_friend_connectionstatus(m, friendnumber, status, userdata);
     m->friendlist[friendnumber].status = status;
 }
@@ -1136,8 +1155,102 @@ void callback_file_reqchunk(Messenger *m, m_file_chunk_request_cb *function)
     m->file_reqchunk = function;
 }
 
+/** @brief Set the callback that reads the data of streamed outgoing files. */
+void callback_file_read(Messenger *m, m_file_read_cb *function)
+{
+    m->file_read = function;
+}
+
 #define MAX_FILENAME_LENGTH 255
 
+/** @brief Return the transfer in slot `filenumber`.
+ *
+ * @return null if no transfer in that direction has used a slot since the
+ *   table was last freed, i.e. the slot is FILESTATUS_NONE.
+ */
+static struct File_Transfers *_Nullable file_slot(const Friend *_Nonnull f, bool sending, uint8_t filenumber)
+{
+    struct File_Transfers *const table = sending ? f->file_sending : f->file_receiving;
+    return table != nullptr ? &table[filenumber] : nullptr;
+}
+
+/** @brief Mark slot `filenumber` as used by a new transfer, allocating the table if needed.
+ *
+ * The slot must be FILESTATUS_NONE. Its status becomes FILESTATUS_NOT_ACCEPTED.
+ *
+ * @return null on allocation failure.
+ */
+static struct File_Transfers *_Nullable file_slot_start(const Memory *_Nonnull mem, Friend *_Nonnull f, bool sending,
+        uint8_t filenumber)
+{
+    struct File_Transfers **const table = sending ? &f->file_sending : &f->file_receiving;
+
+    if (*table == nullptr) {
+        *table = (struct File_Transfers *)mem_valloc(mem, MAX_CONCURRENT_FILE_PIPES, sizeof(struct File_Transfers));
+
+        if (*table == nullptr) {
+            return nullptr;
+        }
+    }
+
+    struct File_Transfers *const ft = &(*table)[filenumber];
+    assert(ft->status == FILESTATUS_NONE);
+    ft->status = FILESTATUS_NOT_ACCEPTED;
+
+    if (sending) {
+        ++f->file_sending_used;
+    } else {
+        ++f->file_receiving_used;
+    }
+
+    return ft;
+}
+
+/** @brief Set a used slot back to FILESTATUS_NONE.
+ *
+ * The table itself stays allocated until `release_idle_file_tables`, so callers
+ * may keep using `ft` until they return.
+ */
+static void file_slot_end(Friend *_Nonnull f, bool sending, struct File_Transfers *_Nonnull ft)
+{
+    if (ft->status == FILESTATUS_NONE) {
+        return;
+    }
+
+    ft->status = FILESTATUS_NONE;
+
+    if (sending) {
+        assert(f->file_sending_used > 0);
+        --f->file_sending_used;
+    } else {
+        assert(f->file_receiving_used > 0);
+        --f->file_receiving_used;
+    }
+}
+
+/** @brief Free the transfer tables of a friend that has no transfers in that direction. */
+static void release_idle_file_tables(const Memory *_Nonnull mem, Friend *_Nonnull f)
+{
+    if (f->file_sending != nullptr && f->file_sending_used == 0) {
+        mem_delete(mem, f->file_sending);
+        f->file_sending = nullptr;
+    }
+
+    if (f->file_receiving != nullptr && f->file_receiving_used == 0) {
+        mem_delete(mem, f->file_receiving);
+        f->file_receiving = nullptr;
+    }
+}
+
+/** @brief Free the transfer tables of a friend, dropping all its transfers. */
+static void free_file_tables(const Memory *_Nonnull mem, Friend *_Nonnull f)
+{
+    f->num_sending_files = 0;
+    f->file_sending_used = 0;
+    f->file_receiving_used = 0;
+    release_idle_file_tables(mem, f);
+}
+
 /** @brief Copy the file transfer file id to file_id
  *
  * @retval 0 on success.
@@ -1172,11 +1285,9 @@ int file_get_id(const Messenger *m, int32_t friendnumber, uint32_t filenumber, u
 
     file_number = temp_filenum;
 
-    const struct File_Transfers *const ft = inbound
-                                                ? &m->friendlist[friendnumber].file_receiving[file_number]
-                                                : &m->friendlist[friendnumber].file_sending[file_number];
+    const struct File_Transfers *const ft = file_slot(&m->friendlist[friendnumber], !inbound, file_number);
 
-    if (ft->status == FILESTATUS_NONE) {
+    if (ft == nullptr || ft->status == FILESTATUS_NONE) {
         return -2;
     }
 
@@ -1190,15 +1301,17 @@ int32_t file_by_id(const Messenger *m, uint32_t friendnumber, const uint8_t *fil
         return -1;
     }
 
+    const Friend *const f = &m->friendlist[friendnumber];
+
     for (uint32_t j = 0; j < MAX_CONCURRENT_FILE_PIPES; ++j) {
-        if (m->friendlist[friendnumber].file_sending[j].status != FILESTATUS_NONE) {
-            if (memcmp(m->friendlist[friendnumber].file_sending[j].id, file_id, FILE_ID_LENGTH) == 0) {
+        if (f->file_sending != nullptr && f->file_sending[j].status != FILESTATUS_NONE) {
+            if (memcmp(f->file_sending[j].id, file_id, FILE_ID_LENGTH) == 0) {
                 return (int32_t)j;
             }
         }
 
-        if (m->friendlist[friendnumber].file_receiving[j].status != FILESTATUS_NONE) {
-            if (memcmp(m->friendlist[friendnumber].file_receiving[j].id, file_id, FILE_ID_LENGTH) == 0) {
+        if (f->file_receiving != nullptr && f->file_receiving[j].status != FILESTATUS_NONE) {
+            if (memcmp(f->file_receiving[j].id, file_id, FILE_ID_LENGTH) == 0) {
                 return (int32_t)((j + 1) << 16);
             }
         }
@@ -1259,10 +1372,13 @@ long int new_filesender(const Messenger *m, int32_t friendnumber, uint32_t file_
         return -2;
     }
 
+    Friend *const f = &m->friendlist[friendnumber];
     uint32_t i;
 
     for (i = 0; i < MAX_CONCURRENT_FILE_PIPES; ++i) {
-        if (m->friendlist[friendnumber].file_sending[i].status == FILESTATUS_NONE) {
+        const struct File_Transfers *const slot = file_slot(f, true, i);
+
+        if (slot == nullptr || slot->status == FILESTATUS_NONE) {
             break;
         }
     }
@@ -1271,14 +1387,17 @@ long int new_filesender(const Messenger *m, int32_t friendnumber, uint32_t file_
         return -3;
     }
 
+    struct File_Transfers *ft = file_slot_start(m->mem, f, true, i);
+
+    if (ft == nullptr) {
+        return -3;
+    }
+
     if (!file_sendrequest(m, friendnumber, i, file_type, filesize, file_id, filename, filename_length)) {
+        file_slot_end(f, true, ft);
         return -4;
     }
 
-    struct File_Transfers *ft = &m->friendlist[friendnumber].file_sending[i];
-
-    ft->status = FILESTATUS_NOT_ACCEPTED;
-
     ft->size = filesize;
 
     ft->transferred = 0;
@@ -1287,6 +1406,8 @@ long int new_filesender(const Messenger *m, int32_t friendnumber, uint32_t file_
 
     ft->paused = FILE_PAUSE_NOT;
 
+    ft->stream_window = 0;
+
     memcpy(ft->id, file_id, FILE_ID_LENGTH);
 
     return i;
@@ -1354,15 +1475,10 @@ int file_control(const Messenger *m, int32_t friendnumber, uint32_t filenumber,
 
     file_number = temp_filenum;
 
-    struct File_Transfers *ft;
-
-    if (inbound) {
-        ft = &m->friendlist[friendnumber].file_receiving[file_number];
-    } else {
-        ft = &m->friendlist[friendnumber].file_sending[file_number];
-    }
+    Friend *const f = &m->friendlist[friendnumber];
+    struct File_Transfers *ft = file_slot(f, !inbound, file_number);
 
-    if (ft->status == FILESTATUS_NONE) {
+    if (ft == nullptr || ft->status == FILESTATUS_NONE) {
         return -3;
     }
 
@@ -1399,10 +1515,10 @@ int file_control(const Messenger *m, int32_t friendnumber, uint32_t filenumber,
             case FILECONTROL_KILL: {
                 if (!inbound && (ft->status == FILESTATUS_TRANSFERRING || ft->status == FILESTATUS_FINISHED)) {
                     // We are actively sending that file, remove from list
-                    --m->friendlist[friendnumber].num_sending_files;
+                    --f->num_sending_files;
                 }
 
-                ft->status = FILESTATUS_NONE;
+                file_slot_end(f, !inbound, ft);
                 break;
             }
             case FILECONTROL_PAUSE: {
@@ -1461,9 +1577,9 @@ int file_seek(const Messenger *m, int32_t friendnumber, uint32_t filenumber, uin
     const uint8_t file_number = temp_filenum;
 
     // We're always receiving at this point.
-    struct File_Transfers *ft = &m->friendlist[friendnumber].file_receiving[file_number];
+    struct File_Transfers *ft = file_slot(&m->friendlist[friendnumber], false, file_number);
 
-    if (ft->status == FILESTATUS_NONE) {
+    if (ft == nullptr || ft->status == FILESTATUS_NONE) {
         return -3;
     }
 
@@ -1513,7 +1629,7 @@ static int64_t send_file_data_packet(const Messenger *_Nonnull m, int32_t friend
 }
 
 #define MAX_FILE_DATA_SIZE (MAX_CRYPTO_DATA_SIZE - 2)
-#define MIN_SLOTS_FREE (CRYPTO_MIN_QUEUE_LENGTH / 4)
+#define MIN_SLOTS_FREE CRYPTO_RESERVED_QUEUE_LENGTH
 /** @brief Send file data.
  *
  * @retval 0 on success
@@ -1542,9 +1658,9 @@ int send_file_data(const Messenger *m, int32_t friendnumber, uint32_t filenumber
         return -3;
     }
 
-    struct File_Transfers *ft = &m->friendlist[friendnumber].file_sending[filenumber];
+    struct File_Transfers *ft = file_slot(&m->friendlist[friendnumber], true, filenumber);
 
-    if (ft->status != FILESTATUS_TRANSFERRING) {
+    if (ft == nullptr || ft->status != FILESTATUS_TRANSFERRING) {
         return -4;
     }
 
@@ -1588,6 +1704,128 @@ int send_file_data(const Messenger *m, int32_t friendnumber, uint32_t filenumber
     return -6;
 }
 
+int file_set_stream(const Messenger *m, int32_t friendnumber, uint32_t filenumber, uint16_t window)
+{
+    if (!m_friend_exists(m, friendnumber)) {
+        return -1;
+    }
+
+    if (filenumber >= MAX_CONCURRENT_FILE_PIPES) {
+        return -2;
+    }
+
+    struct File_Transfers *ft = file_slot(&m->friendlist[friendnumber], true, filenumber);
+
+    if (ft == nullptr || ft->status == FILESTATUS_NONE) {
+        return -2;
+    }
+
+    if (window != 0 && m->file_read == nullptr) {
+        return -3;
+    }
+
+    // Chunks already requested from the client are still sent by the client,
+    // so streaming carries on from the end of the last requested chunk.
+    ft->stream_window = window;
+    return 0;
+}
+
+typedef struct File_Read_Context {
+    Messenger *_Nonnull m;
+    uint32_t friend_number;
+    uint32_t file_number;
+    uint64_t position;
+    bool exact; // whether a short read is an error rather than the end of the file.
+    int32_t result; // what file_read returned, or 0 if it wasn't called.
+    void *_Nullable userdata;
+} File_Read_Context;
+
+static int32_t file_read_fill(void *_Nullable object, uint8_t *_Nonnull data, uint16_t length)
+{
+    File_Read_Context *ctx = (File_Read_Context *)object;
+    assert(ctx != nullptr);
+    assert(ctx->m->file_read != nullptr);
+
+    ctx->result = ctx->m->file_read(ctx->m, ctx->friend_number, ctx->file_number, ctx->position, data, length,
+                                    ctx->userdata);
+
+    if (ctx->result < 0 || ctx->result > length || (ctx->exact && ctx->result != length)) {
+        ctx->result = -1;
+        return -1;
+    }
+
+    return ctx->result;
+}
+
+/**
+ * Read up to `stream_window` chunks of a streamed file straight into crypto
+ * packets. A read error kills the transfer.
+ */
+static void stream_file_chunks(Messenger *_Nonnull m, int32_t friendnumber, uint8_t filenumber,
+                               struct File_Transfers *_Nonnull ft, uint32_t *_Nonnull free_slots, void *_Nullable userdata)
+{
+    const int crypt_connection_id = friend_connection_crypt_connection_id(
+                                        m->fr_c, m->friendlist[friendnumber].friendcon_id);
+    const uint8_t header[2] = {PACKET_ID_FILE_DATA, filenumber};
+
+    for (uint16_t i = 0; i < ft->stream_window && *free_slots > 0; ++i) {
+        // Chunks the client was asked for before streaming started come first.
+        if (ft->status != FILESTATUS_TRANSFERRING || ft->paused != FILE_PAUSE_NOT || ft->requested != ft->transferred) {
+            return;
+        }
+
+        if (max_speed_reached(m->net_crypto, crypt_connection_id)) {
+            return;
+        }
+
+        const uint16_t length = min_u64(ft->size - ft->transferred, MAX_FILE_DATA_SIZE);
+        File_Read_Context ctx = {m, (uint32_t)friendnumber, filenumber, ft->transferred, ft->size != UINT64_MAX, 0, userdata};
+        const int64_t ret = write_cryptpacket_fill(m->net_crypto, crypt_connection_id, header, sizeof(header), length,
+                            length > 0 ? file_read_fill : nullptr, &ctx, true);
+
+        if (ret == -1) {
+            if (ctx.result < 0) {
+                LOGGER_WARNING(m->log, "file read failed (friend %d, file %d); killing the transfer", friendnumber, filenumber);
+                file_control(m, friendnumber, filenumber, FILECONTROL_KILL);
+            }
+
+            // Otherwise the send queue is full; try again next iteration.
+            return;
+        }
+
+        ft->transferred += (uint32_t)ctx.result;
+        ft->requested = ft->transferred;
+        --*free_slots;
+
+        if (ctx.result != MAX_FILE_DATA_SIZE || ft->size == ft->transferred) {
+            ft->status = FILESTATUS_FINISHED;
+            ft->last_packet_number = ret;
+        }
+    }
+}
+
+/** @brief Send the next chunks of all streamed files of a friend. */
+static void do_stream_files(Messenger *_Nonnull m, int32_t friendnumber, uint32_t *_Nonnull free_slots, void *_Nullable userdata)
+{
+    Friend *const f = &m->friendlist[friendnumber];
+
+    if (m->file_read == nullptr) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < MAX_CONCURRENT_FILE_PIPES && *free_slots > 0; ++i) {
+        struct File_Transfers *const ft = file_slot(f, true, i);
+
+        if (ft == nullptr) {
+            return;
+        }
+
+        if (ft->stream_window != 0) {
+            stream_file_chunks(m, friendnumber, i, ft, free_slots, userdata);
+        }
+    }
+}
+
 /**
  * Iterate over all file transfers and request chunks (from the client) for each
  * of them.
@@ -1605,6 +1843,7 @@ int send_file_data(const Messenger *m, int32_t friendnumber, uint32_t filenumber
 static bool do_all_filetransfers(Messenger *_Nonnull m, int32_t friendnumber, void *_Nullable userdata, uint32_t *_Nonnull free_slots)
 {
     Friend *const friendcon = &m->friendlist[friendnumber];
+    bool progress = false;
 
     // Iterate over file transfers as long as we're sending files
     for (uint32_t i = 0; i < MAX_CONCURRENT_FILE_PIPES; ++i) {
@@ -1618,7 +1857,12 @@ static bool do_all_filetransfers(Messenger *_Nonnull m, int32_t friendnumber, vo
             return false;
         }
 
-        struct File_Transfers *const ft = &friendcon->file_sending[i];
+        struct File_Transfers *const ft = file_slot(friendcon, true, i);
+
+        if (ft == nullptr) {
+            // no sending table, so nothing is being sent
+            return false;
+        }
 
         if (ft->status == FILESTATUS_NONE || ft->status == FILESTATUS_NOT_ACCEPTED) {
             // Filetransfers not actively sending, nothing to do
@@ -1639,12 +1883,22 @@ static bool do_all_filetransfers(Messenger *_Nonnull m, int32_t friendnumber, vo
             }
 
             // Now it's inactive, we're no longer sending this.
-            ft->status = FILESTATUS_NONE;
-            --friendcon->num_sending_files;
+            if (ft->status == FILESTATUS_FINISHED) {
+                file_slot_end(friendcon, true, ft);
+                --friendcon->num_sending_files;
+            }
+
+            progress = true;
         } else if (ft->status == FILESTATUS_TRANSFERRING && ft->paused == FILE_PAUSE_NOT) {
+            if (ft->stream_window != 0 && m->file_read != nullptr) {
+                // Sent by do_stream_files.
+                continue;
+            }
+
             if (ft->size == 0) {
                 /* Send 0 data to friend if file is 0 length. */
                 send_file_data(m, friendnumber, i, 0, nullptr, 0);
+                progress = true;
                 continue;
             }
 
@@ -1663,10 +1917,12 @@ static bool do_all_filetransfers(Messenger *_Nonnull m, int32_t friendnumber, vo
 
             // The allocated slot is no longer free.
             --*free_slots;
+            progress = true;
         }
     }
 
-    return true;
+    // Another pass would find nothing new to request.
+    return progress;
 }
 
 static void do_reqchunk_filecb(Messenger *_Nonnull m, int32_t friendnumber, void *_Nullable userdata)
@@ -1688,6 +1944,9 @@ static void do_reqchunk_filecb(Messenger *_Nonnull m, int32_t friendnumber, void
     // transfers might block other traffic for a long time.
     free_slots = max_s32(0, (int32_t)free_slots - MIN_SLOTS_FREE);
 
+    // Streamed files are read straight into packets, up to their window.
+    do_stream_files(m, friendnumber, &free_slots, userdata);
+
     // Maximum number of outer loops below. If the client doesn't send file
     // chunks from within the chunk request callback handler, we never realise
     // that the file transfer has finished and may end up in an infinite loop.
@@ -1717,25 +1976,20 @@ static void break_files(const Messenger *m, int32_t friendnumber)
     Friend *const f = &m->friendlist[friendnumber];
 
     // TODO(irungentoo): Inform the client which file transfers get killed with a callback?
-    for (uint32_t i = 0; i < MAX_CONCURRENT_FILE_PIPES; ++i) {
-        f->file_sending[i].status = FILESTATUS_NONE;
-        f->file_receiving[i].status = FILESTATUS_NONE;
-    }
+    free_file_tables(m->mem, f);
 }
 
 static struct File_Transfers *_Nullable get_file_transfer(bool outbound, uint8_t filenumber, uint32_t *_Nonnull real_filenumber, Friend *_Nonnull sender)
 {
-    struct File_Transfers *ft;
-
     if (outbound) {
         *real_filenumber = filenumber;
-        ft = &sender->file_sending[filenumber];
     } else {
         *real_filenumber = (filenumber + 1) << 16;
-        ft = &sender->file_receiving[filenumber];
     }
 
-    if (ft->status == FILESTATUS_NONE) {
+    struct File_Transfers *ft = file_slot(sender, outbound, filenumber);
+
+    if (ft == nullptr || ft->status == FILESTATUS_NONE) {
         return nullptr;
     }
 
@@ -1805,7 +2059,7 @@ static int handle_filecontrol(Messenger *_Nonnull m, int32_t friendnumber, bool
                 --m->friendlist[friendnumber].num_sending_files;
             }
 
-            ft->status = FILESTATUS_NONE;
+            file_slot_end(&m->friendlist[friendnumber], outbound, ft);
 
             return 0;
         }
@@ -2021,6 +2275,7 @@ static int m_handle_packet_nickname(Messenger *_Nonnull m, const int friendcon_i
 
     memcpy(m->friendlist[friendcon_id].name, data_terminated, data_length);
     m->friendlist[friendcon_id].name_length = data_length;
+    m_mark_state_dirty(m, STATE_TYPE_FRIENDS);
 
     return 0;
 }
@@ -2146,13 +2401,20 @@ static int m_handle_packet_file_sendrequest(Messenger *_Nonnull m, const int fri
     file_type = net_ntohl(file_type);
 
     net_unpack_u64(data + 1 + sizeof(uint32_t), &filesize);
-    struct File_Transfers *ft = &m->friendlist[friendcon_id].file_receiving[filenumber];
+    Friend *const f = &m->friendlist[friendcon_id];
+    const struct File_Transfers *const slot = file_slot(f, false, filenumber);
 
-    if (ft->status != FILESTATUS_NONE) {
+    if (slot != nullptr && slot->status != FILESTATUS_NONE) {
+        return 0;
+    }
+
+    struct File_Transfers *ft = file_slot_start(m->mem, f, false, filenumber);
+
+    if (ft == nullptr) {
+        LOGGER_WARNING(m->log, "failed to allocate file receiving table for friend %d", friendcon_id);
         return 0;
     }
 
-    ft->status = FILESTATUS_NOT_ACCEPTED;
     ft->size = filesize;
     ft->transferred = 0;
     ft->paused = FILE_PAUSE_NOT;
@@ -2226,9 +2488,9 @@ static int m_handle_packet_file_data(Messenger *_Nonnull m, const int friendcon_
 
 #endif /* UINT8_MAX >= MAX_CONCURRENT_FILE_PIPES */
 
-    struct File_Transfers *ft = &m->friendlist[friendcon_id].file_receiving[filenumber];
+    struct File_Transfers *ft = file_slot(&m->friendlist[friendcon_id], false, filenumber);
 
-    if (ft->status != FILESTATUS_TRANSFERRING) {
+    if (ft == nullptr || ft->status != FILESTATUS_TRANSFERRING) {
         return 0;
     }
 
@@ -2269,7 +2531,7 @@ static int m_handle_packet_file_data(Messenger *_Nonnull m, const int friendcon_
 
     /* Data is zero, filetransfer is over. */
     if (file_data_length == 0) {
-        ft->status = FILESTATUS_NONE;
+        file_slot_end(&m->friendlist[friendcon_id], false, ft);
     }
 
     return 0;
@@ -2407,6 +2669,8 @@ static void do_friends(Messenger *_Nonnull m, void *_Nullable userdata)
 
             m->friendlist[i].last_seen_time = (uint64_t) time(nullptr);
         }
+
+        release_idle_file_tables(m->mem, &m->friendlist[i]);
     }
 }
 
@@ -2437,13 +2701,26 @@ static void m_connection_status_callback(Messenger *_Nonnull m, void *_Nullable
  */
 uint32_t messenger_run_interval(const Messenger *m)
 {
-    const uint32_t crypto_interval = crypto_run_interval(m->net_crypto);
+    uint32_t interval = crypto_run_interval(m->net_crypto);
+
+    // The DHT, onion and group chat code still check their timers on every
+    // iteration, so never sleep longer than MIN_RUN_INTERVAL.
+    if (interval > MIN_RUN_INTERVAL) {
+        interval = MIN_RUN_INTERVAL;
+    }
+
+    const uint64_t now = mono_time_get_ms(m->mono_time);
+    const uint64_t friend_deadline = friend_connections_next_deadline(m->fr_c);
+
+    if (friend_deadline <= now) {
+        return 0;
+    }
 
-    if (crypto_interval > MIN_RUN_INTERVAL) {
-        return MIN_RUN_INTERVAL;
+    if (friend_deadline - now < interval) {
+        interval = (uint32_t)(friend_deadline - now);
     }
 
-    return crypto_interval;
+    return interval;
 }
 
 /** @brief Attempts to create a DHT announcement for a group chat with our connection info. An
@@ -2525,8 +2802,32 @@ static void do_gc_onion_friends(const Messenger *_Nonnull m)
     }
 }
 
+/** @brief Visits the sockets `do_messenger` reads from, so the caller can wait on them. */
+void messenger_visit_sockets(const Messenger *m, net_socket_visit_cb *cb, void *obj)
+{
+    // The host waits for its own sockets.
+    if (m->host == nullptr) {
+        if (!m->options.udp_disabled && !net_family_is_unspec(net_family(m->net))) {
+            cb(obj, net_sock(m->net), 0, false);
+        }
+
+        tcp_connections_visit_sockets(nc_get_tcp_c(m->net_crypto), cb, obj);
+    }
+
+    gc_visit_sockets(m->group_handler, cb, obj);
+
+    if (m->tcp_server != nullptr) {
+        tcp_server_visit_sockets(m->tcp_server, cb, obj);
+    }
+}
+
 /** @brief The main loop that needs to be run at least 20 times per second. */
 void do_messenger(Messenger *m, void *userdata)
+{
+    do_messenger_ex(m, true, userdata);
+}
+
+void do_messenger_ex(Messenger *m, bool udp_readable, void *userdata)
 {
     // Add the TCP relays, but only if this is the first time calling do_messenger
     if (!m->has_added_relays) {
@@ -2548,22 +2849,57 @@ void do_messenger(Messenger *m, void *userdata)
         }
     }
 
-    if (!m->options.udp_disabled) {
-        networking_poll(m->net, userdata);
+    Iter_Profile *prof = m->iter_prof;
+    uint64_t start;
+
+    // A host reads the socket and runs the DHT for all its instances.
+    if (m->host == nullptr && !m->options.udp_disabled) {
+        if (udp_readable) {
+            start = iterprof_start(prof);
+            networking_poll(m->net, userdata);
+            iterprof_record(prof, ITER_STAGE_NETWORKING_POLL, start);
+        }
+
+        start = iterprof_start(prof);
         do_dht(m->dht);
+        iterprof_record(prof, ITER_STAGE_DHT, start);
     }
 
     if (m->tcp_server != nullptr) {
+        start = iterprof_start(prof);
         do_tcp_server(m->tcp_server, m->mono_time);
+        iterprof_record(prof, ITER_STAGE_TCP_SERVER, start);
     }
 
+    start = iterprof_start(prof);
     do_net_crypto(m->net_crypto, userdata);
+    iterprof_record(prof, ITER_STAGE_NET_CRYPTO, start);
+
+    start = iterprof_start(prof);
     do_onion_client(m->onion_c);
+    iterprof_record(prof, ITER_STAGE_ONION_CLIENT, start);
+
+    start = iterprof_start(prof);
     do_friend_connections(m->fr_c, userdata);
+    iterprof_record(prof, ITER_STAGE_FRIEND_CONNECTIONS, start);
+
+    start = iterprof_start(prof);
     do_friends(m, userdata);
+    iterprof_record(prof, ITER_STAGE_FRIENDS, start);
+
+    start = iterprof_start(prof);
     do_gc(m->group_handler, userdata);
-    do_gca(m->mono_time, m->group_announce);
+    iterprof_record(prof, ITER_STAGE_GC, start);
+
+    if (m->host == nullptr) {
+        start = iterprof_start(prof);
+        do_gca(m->mono_time, m->group_announce);
+        iterprof_record(prof, ITER_STAGE_GCA, start);
+    }
+
+    start = iterprof_start(prof);
     do_gc_onion_friends(m);
+    iterprof_record(prof, ITER_STAGE_GC_ONION_FRIENDS, start);
     m_connection_status_callback(m, userdata);
 
     if (mono_time_get(m->mono_time) > m->lastdump + DUMPING_CLIENTS_FRIENDS_EVERY_N_SECONDS) {
@@ -2841,10 +3177,42 @@ bool m_register_state_plugin(Messenger *m, State_Type type, m_state_size_cb *siz
     m->options.state_plugins[index].size = size_callback;
     m->options.state_plugins[index].load = load_callback;
     m->options.state_plugins[index].save = save_callback;
+    m->options.state_plugins[index].write = nullptr;
+    m->options.state_plugins[index].read = nullptr;
+    m->options.state_plugins[index].tracked = false;
+    // Nothing was saved yet.
+    m->options.state_plugins[index].dirty = true;
 
     return true;
 }
 
+static Messenger_State_Plugin *_Nullable m_find_state_plugin(const Messenger *_Nonnull m, State_Type type)
+{
+    for (uint8_t i = 0; i < m->options.state_plugins_length; ++i) {
+        if (m->options.state_plugins[i].type == type) {
+            return &m->options.state_plugins[i];
+        }
+    }
+
+    return nullptr;
+}
+
+void m_mark_state_dirty(const Messenger *m, State_Type type)
+{
+    Messenger_State_Plugin *const plugin = m_find_state_plugin(m, type);
+
+    if (plugin != nullptr) {
+        plugin->dirty = true;
+    }
+}
+
+void m_clear_state_dirty(const Messenger *m)
+{
+    for (uint8_t i = 0; i < m->options.state_plugins_length; ++i) {
+        m->options.state_plugins[i].dirty = false;
+    }
+}
+
 static uint32_t m_plugin_size(const Messenger *_Nonnull m, State_Type type)
 {
     for (uint8_t i = 0; i < m->options.state_plugins_length; ++i) {
@@ -2877,6 +3245,47 @@ uint8_t *messenger_save(const Messenger *m, uint8_t *data)
     return data;
 }
 
+/** @brief Write a section of a plugin that can only save into a buffer. */
+static bool m_write_state_plugin_buffered(const Messenger *_Nonnull m, const Messenger_State_Plugin *_Nonnull plugin,
+        State_Writer *_Nonnull writer)
+{
+    const uint32_t size = sizeof(uint32_t) * 2 + plugin->size(m);
+    uint8_t *buffer = (uint8_t *)mem_balloc(m->mem, size);
+
+    if (buffer == nullptr) {
+        return false;
+    }
+
+    // Some sections turn out shorter than their size.
+    const uint8_t *end = plugin->save(m, buffer);
+    assert(end >= buffer && (uint32_t)(end - buffer) <= size);
+
+    const bool ok = state_writer_write(writer, buffer, (uint32_t)(end - buffer));
+    mem_delete(m->mem, buffer);
+    return ok;
+}
+
+bool messenger_write(const Messenger *m, State_Writer *writer, bool changed_only)
+{
+    for (uint8_t i = 0; i < m->options.state_plugins_length; ++i) {
+        const Messenger_State_Plugin *const plugin = &m->options.state_plugins[i];
+
+        if (changed_only && plugin->tracked && !plugin->dirty) {
+            continue;
+        }
+
+        const bool ok = plugin->write != nullptr
+                        ? plugin->write(m, writer)
+                        : m_write_state_plugin_buffered(m, plugin, writer);
+
+        if (!ok) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 // nospam state plugin
 static uint32_t nospam_keys_size(const Messenger *_Nonnull m)
 {
@@ -2935,6 +3344,55 @@ static State_Load_Status m_dht_load(Messenger *_Nonnull m, const uint8_t *_Nonnu
     return STATE_LOAD_STATUS_CONTINUE;
 }
 
+static void friend_to_saved(const Friend *_Nonnull f, struct Saved_Friend *_Nonnull temp)
+{
+    temp->status = f->status;
+    memcpy(temp->real_pk, f->real_pk, CRYPTO_PUBLIC_KEY_SIZE);
+
+    if (temp->status < 3) {
+        // TODO(iphydf): Use uint16_t and min_u16 here.
+        const size_t friendrequest_length =
+            min_u32(f->info_size, min_u32(SAVED_FRIEND_REQUEST_SIZE, MAX_FRIEND_REQUEST_DATA_SIZE));
+        memcpy(temp->info, f->info, friendrequest_length);
+
+        temp->info_size = net_htons(f->info_size);
+        temp->friendrequest_nospam = f->friendrequest_nospam;
+    } else {
+        temp->status = 3;
+        memcpy(temp->name, f->name, f->name_length);
+        temp->name_length = net_htons(f->name_length);
+        memcpy(temp->statusmessage, f->statusmessage, f->statusmessage_length);
+        temp->statusmessage_length = net_htons(f->statusmessage_length);
+        temp->userstatus = f->userstatus;
+
+        net_pack_u64(temp->last_seen_time, f->last_seen_time);
+    }
+}
+
+static void friend_from_saved(Messenger *_Nonnull m, const struct Saved_Friend *_Nonnull temp)
+{
+    if (temp->status >= 3) {
+        const int fnum = m_addfriend_norequest(m, temp->real_pk);
+
+        if (fnum < 0) {
+            return;
+        }
+
+        setfriendname(m, fnum, temp->name, net_ntohs(temp->name_length));
+        set_friend_statusmessage(m, fnum, temp->statusmessage, net_ntohs(temp->statusmessage_length));
+        set_friend_userstatus(m, fnum, temp->userstatus);
+        net_unpack_u64(temp->last_seen_time, &m->friendlist[fnum].last_seen_time);
+    } else if (temp->status != 0) {
+        /* TODO(irungentoo): This is not a good way to do this. */
+        uint8_t address[FRIEND_ADDRESS_SIZE];
+        pk_copy(address, temp->real_pk);
+        memcpy(address + CRYPTO_PUBLIC_KEY_SIZE, &temp->friendrequest_nospam, sizeof(uint32_t));
+        uint16_t checksum = data_checksum(address, FRIEND_ADDRESS_SIZE - sizeof(checksum));
+        memcpy(address + CRYPTO_PUBLIC_KEY_SIZE + sizeof(uint32_t), &checksum, sizeof(checksum));
+        m_addfriend(m, address, temp->info, net_ntohs(temp->info_size));
+    }
+}
+
 // friendlist state plugin
 static uint32_t saved_friendslist_size(const Messenger *_Nonnull m)
 {
@@ -2952,28 +3410,7 @@ static uint8_t *_Nonnull friends_list_save(const Messenger *_Nonnull m, uint8_t
     for (uint32_t i = 0; i < m->numfriends; ++i) {
         if (m->friendlist[i].status > 0) {
             struct Saved_Friend temp = { 0 };
-            temp.status = m->friendlist[i].status;
-            memcpy(temp.real_pk, m->friendlist[i].real_pk, CRYPTO_PUBLIC_KEY_SIZE);
-
-            if (temp.status < 3) {
-                // TODO(iphydf): Use uint16_t and min_u16 here.
-                const size_t friendrequest_length =
-                    min_u32(m->friendlist[i].info_size,
-                            min_u32(SAVED_FRIEND_REQUEST_SIZE, MAX_FRIEND_REQUEST_DATA_SIZE));
-                memcpy(temp.info, m->friendlist[i].info, friendrequest_length);
-
-                temp.info_size = net_htons(m->friendlist[i].info_size);
-                temp.friendrequest_nospam = m->friendlist[i].friendrequest_nospam;
-            } else {
-                temp.status = 3;
-                memcpy(temp.name, m->friendlist[i].name, m->friendlist[i].name_length);
-                temp.name_length = net_htons(m->friendlist[i].name_length);
-                memcpy(temp.statusmessage, m->friendlist[i].statusmessage, m->friendlist[i].statusmessage_length);
-                temp.statusmessage_length = net_htons(m->friendlist[i].statusmessage_length);
-                temp.userstatus = m->friendlist[i].userstatus;
-
-                net_pack_u64(temp.last_seen_time, m->friendlist[i].last_seen_time);
-            }
+            friend_to_saved(&m->friendlist[i], &temp);
 
             uint8_t *next_data = friend_save(&temp, cur_data);
             assert(next_data - cur_data == friend_size());
@@ -3008,27 +3445,56 @@ static State_Load_Status friends_list_load(Messenger *_Nonnull m, const uint8_t
         assert(next_data - cur_data == l_friend_size);
 
         cur_data = next_data;
+        friend_from_saved(m, &temp);
+    }
 
-        if (temp.status >= 3) {
-            const int fnum = m_addfriend_norequest(m, temp.real_pk);
+    return STATE_LOAD_STATUS_CONTINUE;
+}
 
-            if (fnum < 0) {
-                continue;
+/** @brief Write the friend list one friend at a time, without a buffer for the whole list. */
+static bool friends_list_write(const Messenger *_Nonnull m, State_Writer *_Nonnull writer)
+{
+    const uint32_t l_friend_size = friend_size();
+    state_writer_section_header(writer, STATE_COOKIE_TYPE, m_plugin_size(m, STATE_TYPE_FRIENDS), STATE_TYPE_FRIENDS);
+
+    for (uint32_t i = 0; i < m->numfriends; ++i) {
+        if (m->friendlist[i].status > 0) {
+            struct Saved_Friend temp = { 0 };
+            friend_to_saved(&m->friendlist[i], &temp);
+
+            uint8_t *data = state_writer_reserve(writer, l_friend_size);
+
+            if (data == nullptr) {
+                return false;
             }
 
-            setfriendname(m, fnum, temp.name, net_ntohs(temp.name_length));
-            set_friend_statusmessage(m, fnum, temp.statusmessage, net_ntohs(temp.statusmessage_length));
-            set_friend_userstatus(m, fnum, temp.userstatus);
-            net_unpack_u64(temp.last_seen_time, &m->friendlist[fnum].last_seen_time);
-        } else if (temp.status != 0) {
-            /* TODO(irungentoo): This is not a good way to do this. */
-            uint8_t address[FRIEND_ADDRESS_SIZE];
-            pk_copy(address, temp.real_pk);
-            memcpy(address + CRYPTO_PUBLIC_KEY_SIZE, &temp.friendrequest_nospam, sizeof(uint32_t));
-            uint16_t checksum = data_checksum(address, FRIEND_ADDRESS_SIZE - sizeof(checksum));
-            memcpy(address + CRYPTO_PUBLIC_KEY_SIZE + sizeof(uint32_t), &checksum, sizeof(checksum));
-            m_addfriend(m, address, temp.info, net_ntohs(temp.info_size));
+            friend_save(&temp, data);
+        }
+    }
+
+    return !writer->failed;
+}
+
+static State_Load_Status friends_list_read(Messenger *_Nonnull m, State_Reader *_Nonnull reader, uint32_t length)
+{
+    const uint32_t l_friend_size = friend_size();
+
+    if (length % l_friend_size != 0) {
+        return STATE_LOAD_STATUS_ERROR;
+    }
+
+    const uint32_t num = length / l_friend_size;
+
+    for (uint32_t i = 0; i < num; ++i) {
+        const uint8_t *data = state_reader_read_chunk(reader, l_friend_size);
+
+        if (data == nullptr) {
+            return STATE_LOAD_STATUS_ERROR;
         }
+
+        struct Saved_Friend temp = { 0 };
+        friend_load(&temp, data);
+        friend_from_saved(m, &temp);
     }
 
     return STATE_LOAD_STATUS_CONTINUE;
@@ -3304,6 +3770,26 @@ static void m_register_default_plugins(Messenger *_Nonnull m)
     }
     m_register_state_plugin(m, STATE_TYPE_TCP_RELAY, tcp_relay_size, load_tcp_relays, save_tcp_relays);
     m_register_state_plugin(m, STATE_TYPE_PATH_NODE, path_node_size, load_path_nodes, save_path_nodes);
+
+    Messenger_State_Plugin *const friends = m_find_state_plugin(m, STATE_TYPE_FRIENDS);
+
+    if (friends != nullptr) {
+        friends->write = friends_list_write;
+        friends->read = friends_list_read;
+    }
+
+    // The other sections change all the time while we are online.
+    const State_Type tracked[] = {
+        STATE_TYPE_NOSPAMKEYS, STATE_TYPE_FRIENDS, STATE_TYPE_NAME, STATE_TYPE_STATUSMESSAGE, STATE_TYPE_STATUS,
+    };
+
+    for (size_t i = 0; i < sizeof(tracked) / sizeof(tracked[0]); ++i) {
+        Messenger_State_Plugin *const plugin = m_find_state_plugin(m, tracked[i]);
+
+        if (plugin != nullptr) {
+            plugin->tracked = true;
+        }
+    }
 }
 
 bool messenger_load_state_section(Messenger *m, const uint8_t *data, uint32_t length, uint16_t type,
@@ -3321,6 +3807,29 @@ bool messenger_load_state_section(Messenger *m, const uint8_t *data, uint32_t le
     return false;
 }
 
+bool messenger_read_state_section(Messenger *m, State_Reader *reader, uint32_t length, uint16_t type,
+                                  State_Load_Status *status)
+{
+    for (uint8_t i = 0; i < m->options.state_plugins_length; ++i) {
+        const Messenger_State_Plugin *const plugin = &m->options.state_plugins[i];
+
+        if (plugin->type != type) {
+            continue;
+        }
+
+        if (plugin->read != nullptr) {
+            *status = plugin->read(m, reader, length);
+            return true;
+        }
+
+        const uint8_t *data = state_reader_read_chunk(reader, length);
+        *status = data != nullptr ? plugin->load(m, data, length) : STATE_LOAD_STATUS_ERROR;
+        return true;
+    }
+
+    return false;
+}
+
 /** @brief Return the number of friends in the instance m.
  *
  * You should use this to determine how much memory to allocate
@@ -3380,6 +3889,23 @@ static void m_handle_friend_request(
     m->friend_request(m, public_key, message, length, user_data);
 }
 
+static fc_peer_cb m_host_peer;
+static void m_host_peer(void *object, const uint8_t *real_public_key, bool added)
+{
+    const Messenger *m = (const Messenger *)object;
+    assert(m != nullptr);
+
+    if (m->host_instance == nullptr) {
+        return;
+    }
+
+    if (added) {
+        host_instance_add_key(m->host_instance, real_public_key);
+    } else {
+        host_instance_remove_key(m->host_instance, real_public_key);
+    }
+}
+
 /** @brief Run this at startup.
  *
  * @return allocated instance of Messenger on success.
@@ -3412,6 +3938,7 @@ Messenger *new_messenger(Mono_Time *mono_time, const Memory *mem, const Random *
     m->forwarding = nullptr;
     m->announce = nullptr;
     m->tcp_server = nullptr;
+    m->host = options->host;
 
     Friend_Requests *fr = friendreq_new(mem);
     if (fr == nullptr) {
@@ -3420,146 +3947,117 @@ Messenger *new_messenger(Mono_Time *mono_time, const Memory *mem, const Random *
     }
     m->fr = fr;
 
-    unsigned int net_err = 0;
+    if (m->host != nullptr) {
+        // Everything that doesn't depend on our identity comes from the host.
+        options->udp_disabled = messenger_host_udp_disabled(m->host);
+        options->tcp_server_port = 0;
+        m->net = messenger_host_net(m->host);
+        m->dht = messenger_host_dht(m->host);
+        m->tcp_np = messenger_host_tcp_np(m->host);
+    } else {
+        unsigned int net_err = 0;
 
-    if (!options->udp_disabled && options->proxy_info.proxy_type != TCP_PROXY_NONE) {
-        // We don't currently support UDP over proxy.
-        LOGGER_INFO(m->log, "UDP enabled and proxy set: disabling UDP");
-        options->udp_disabled = true;
-    }
+        if (!options->udp_disabled && options->proxy_info.proxy_type != TCP_PROXY_NONE) {
+            // We don't currently support UDP over proxy.
+            LOGGER_INFO(m->log, "UDP enabled and proxy set: disabling UDP");
+            options->udp_disabled = true;
+        }
 
-    Networking_Core *net;
-    if (options->udp_disabled) {
-        net = new_networking_no_udp(m->log, m->mem, m->ns);
-    } else {
-        IP ip;
-        ip_init(&ip, options->ipv6enabled);
-        net = new_networking_ex(m->log, m->mem, m->ns, &ip, options->port_range[0], options->port_range[1], &net_err);
-    }
+        if (options->udp_disabled) {
+            m->net = new_networking_no_udp(m->log, m->mem, m->ns);
+        } else {
+            IP ip;
+            ip_init(&ip, options->ipv6enabled);
+            m->net = new_networking_ex(m->log, m->mem, m->ns, &ip, options->port_range[0], options->port_range[1], &net_err);
+        }
 
-    if (net == nullptr) {
-        friendreq_kill(m->fr);
+        if (m->net == nullptr) {
+            if (error != nullptr && net_err == 1) {
+                LOGGER_WARNING(m->log, "network initialisation failed (no ports available)");
+                *error = MESSENGER_ERROR_PORT;
+            }
 
-        if (error != nullptr && net_err == 1) {
-            LOGGER_WARNING(m->log, "network initialisation failed (no ports available)");
-            *error = MESSENGER_ERROR_PORT;
+            kill_messenger(m);
+            return nullptr;
         }
 
-        mem_delete(mem, m);
-        return nullptr;
-    }
-    m->net = net;
+        m->dht = new_dht(m->log, m->mem, m->rng, m->ns, m->mono_time, m->net, options->hole_punching_enabled, options->local_discovery_enabled);
+        if (m->dht == nullptr) {
+            kill_messenger(m);
+            return nullptr;
+        }
 
-    DHT *dht = new_dht(m->log, m->mem, m->rng, m->ns, m->mono_time, m->net, options->hole_punching_enabled, options->local_discovery_enabled);
-    if (dht == nullptr) {
-        kill_networking(m->net);
-        friendreq_kill(m->fr);
-        mem_delete(mem, m);
-        return nullptr;
+        m->tcp_np = netprof_new(m->log, mem);
+        if (m->tcp_np == nullptr) {
+            LOGGER_WARNING(m->log, "TCP netprof initialisation failed");
+            kill_messenger(m);
+            return nullptr;
+        }
     }
-    m->dht = dht;
 
-    Net_Profile *tcp_np = netprof_new(m->log, mem);
-    if (tcp_np == nullptr) {
-        LOGGER_WARNING(m->log, "TCP netprof initialisation failed");
-        kill_dht(m->dht);
-        kill_networking(m->net);
-        friendreq_kill(m->fr);
-        mem_delete(mem, m);
-        return nullptr;
+    if (m->host != nullptr) {
+        m->net_crypto = new_net_crypto_shared(m->log, m->mem, m->rng, m->ns, m->mono_time, m->net, m->dht, &m_dht_funcs,
+                                              messenger_host_tcp_c(m->host), messenger_host_cookie_key(m->host));
+    } else {
+        m->net_crypto = new_net_crypto(m->log, m->mem, m->rng, m->ns, m->mono_time, m->net, m->dht, &m_dht_funcs, &options->proxy_info, m->tcp_np);
     }
-    m->tcp_np = tcp_np;
 
-    Net_Crypto *net_crypto = new_net_crypto(m->log, m->mem, m->rng, m->ns, m->mono_time, m->net, m->dht, &m_dht_funcs, &options->proxy_info, m->tcp_np);
-
-    if (net_crypto == nullptr) {
+    if (m->net_crypto == nullptr) {
         LOGGER_WARNING(m->log, "net_crypto initialisation failed");
-
-        netprof_kill(mem, m->tcp_np);
-        kill_dht(m->dht);
-        kill_networking(m->net);
-        friendreq_kill(m->fr);
-        mem_delete(mem, m);
+        kill_messenger(m);
         return nullptr;
     }
-    m->net_crypto = net_crypto;
-
-    GC_Announces_List *group_announce = new_gca_list(m->mem);
-    if (group_announce == nullptr) {
-        LOGGER_WARNING(m->log, "DHT group chats initialisation failed");
+    net_crypto_set_congestion_control(m->net_crypto, options->congestion_control);
+    net_crypto_set_pacing(m->net_crypto, options->pacing);
 
-        kill_net_crypto(m->net_crypto);
-        netprof_kill(mem, m->tcp_np);
-        kill_dht(m->dht);
-        kill_networking(m->net);
-        friendreq_kill(m->fr);
-        mem_delete(mem, m);
-        return nullptr;
-    }
-    m->group_announce = group_announce;
+    if (m->host != nullptr) {
+        m->group_announce = messenger_host_group_announce(m->host);
+        m->forwarding = messenger_host_forwarding(m->host);
+        m->announce = messenger_host_announce(m->host);
+        m->onion = messenger_host_onion(m->host);
+        m->onion_a = messenger_host_onion_a(m->host);
+    } else {
+        m->group_announce = new_gca_list(m->mem, m->rng);
+        if (m->group_announce == nullptr) {
+            LOGGER_WARNING(m->log, "DHT group chats initialisation failed");
+            kill_messenger(m);
+            return nullptr;
+        }
 
-    if (options->dht_announcements_enabled) {
-        m->forwarding = new_forwarding(m->log, m->mem, m->rng, m->mono_time, m->dht, m->net);
-        if (m->forwarding != nullptr) {
-            m->announce = new_announcements(m->log, m->mem, m->rng, m->mono_time, m->forwarding, m->dht, m->net);
+        if (options->dht_announcements_enabled) {
+            m->forwarding = new_forwarding(m->log, m->mem, m->rng, m->mono_time, m->dht, m->net);
+            if (m->forwarding != nullptr) {
+                m->announce = new_announcements(m->log, m->mem, m->rng, m->mono_time, m->forwarding, m->dht, m->net);
+            }
         }
+
+        m->onion = new_onion(m->log, m->mem, m->mono_time, m->rng, m->dht, m->net);
+        m->onion_a = new_onion_announce(m->log, m->mem, m->rng, m->mono_time, m->dht, m->net);
     }
 
-    Onion *onion = new_onion(m->log, m->mem, m->mono_time, m->rng, m->dht, m->net);
-    Onion_Announce *onion_a = new_onion_announce(m->log, m->mem, m->rng, m->mono_time, m->dht, m->net);
-    Onion_Client *onion_c = new_onion_client(m->log, m->mem, m->rng, m->mono_time, m->net_crypto, m->dht, m->net);
-    Friend_Connections *fr_c = nullptr;
+    m->onion_c = new_onion_client(m->log, m->mem, m->rng, m->mono_time, m->net_crypto, m->dht, m->net);
 
-    if (onion_c != nullptr) {
-        fr_c = new_friend_connections(m->log, m->mem, m->mono_time, m->ns, onion_c, m->dht, m->net_crypto, m->net, options->local_discovery_enabled);
+    if (m->onion_c != nullptr) {
+        m->fr_c = new_friend_connections(m->log, m->mem, m->rng, m->mono_time, m->ns, m->onion_c, m->dht, m->net_crypto, m->net, options->local_discovery_enabled);
     }
 
-    if ((options->dht_announcements_enabled && (m->forwarding == nullptr || m->announce == nullptr)) ||
-            onion == nullptr || onion_a == nullptr || onion_c == nullptr || fr_c == nullptr) {
+    if ((m->host == nullptr && options->dht_announcements_enabled && (m->forwarding == nullptr || m->announce == nullptr)) ||
+            m->onion == nullptr || m->onion_a == nullptr || m->onion_c == nullptr || m->fr_c == nullptr) {
         LOGGER_WARNING(m->log, "onion initialisation failed");
-
-        kill_onion(onion);
-        kill_onion_announce(onion_a);
-        kill_onion_client(onion_c);
-        kill_gca(m->group_announce);
-        kill_friend_connections(fr_c);
-        kill_announcements(m->announce);
-        kill_forwarding(m->forwarding);
-        kill_net_crypto(m->net_crypto);
-        netprof_kill(mem, m->tcp_np);
-        kill_dht(m->dht);
-        kill_networking(m->net);
-        friendreq_kill(m->fr);
-        mem_delete(mem, m);
+        kill_messenger(m);
         return nullptr;
     }
-    m->onion = onion;
-    m->onion_a = onion_a;
-    m->onion_c = onion_c;
-    m->fr_c = fr_c;
 
-    gca_onion_init(m->group_announce, m->onion_a);
+    if (m->host == nullptr) {
+        gca_onion_init(m->group_announce, m->onion_a);
+    }
 
-    GC_Session *group_handler = new_dht_groupchats(m);
-    if (group_handler == nullptr) {
+    m->group_handler = new_dht_groupchats(m);
+    if (m->group_handler == nullptr) {
         LOGGER_WARNING(m->log, "conferences initialisation failed");
-
-        kill_onion(m->onion);
-        kill_onion_announce(m->onion_a);
-        kill_onion_client(m->onion_c);
-        kill_gca(m->group_announce);
-        kill_friend_connections(m->fr_c);
-        kill_announcements(m->announce);
-        kill_forwarding(m->forwarding);
-        kill_net_crypto(m->net_crypto);
-        netprof_kill(mem, m->tcp_np);
-        kill_dht(m->dht);
-        kill_networking(m->net);
-        friendreq_kill(m->fr);
-        mem_delete(mem, m);
+        kill_messenger(m);
         return nullptr;
     }
-    m->group_handler = group_handler;
 
     if (options->tcp_server_port != 0) {
         m->tcp_server = new_tcp_server(m->log, m->mem, m->rng, m->ns, options->ipv6enabled, 1,
@@ -3568,21 +4066,7 @@ Messenger *new_messenger(Mono_Time *mono_time, const Memory *mem, const Random *
 
         if (m->tcp_server == nullptr) {
             LOGGER_WARNING(m->log, "TCP server initialisation failed");
-
-            kill_onion(m->onion);
-            kill_onion_announce(m->onion_a);
-            kill_dht_groupchats(m->group_handler);
-            kill_friend_connections(m->fr_c);
-            kill_onion_client(m->onion_c);
-            kill_gca(m->group_announce);
-            kill_announcements(m->announce);
-            kill_forwarding(m->forwarding);
-            kill_net_crypto(m->net_crypto);
-            netprof_kill(mem, m->tcp_np);
-            kill_dht(m->dht);
-            kill_networking(m->net);
-            friendreq_kill(m->fr);
-            mem_delete(mem, m);
+            kill_messenger(m);
 
             if (error != nullptr) {
                 *error = MESSENGER_ERROR_TCP_SERVER;
@@ -3592,6 +4076,19 @@ Messenger *new_messenger(Mono_Time *mono_time, const Memory *mem, const Random *
         }
     }
 
+    if (m->host != nullptr) {
+        m->host_instance = messenger_host_attach(m->host, m->net_crypto);
+
+        if (m->host_instance == nullptr) {
+            LOGGER_WARNING(m->log, "attaching to the host failed");
+            kill_messenger(m);
+            return nullptr;
+        }
+
+        // The host sends the handshakes of our peers to us by their keys.
+        set_friend_connection_peer_callback(m->fr_c, &m_host_peer, m);
+    }
+
     m->options = *options;
     friendreq_init(m->fr, m->fr_c);
     set_nospam(m->fr, random_u32(m->rng));
@@ -3600,6 +4097,9 @@ Messenger *new_messenger(Mono_Time *mono_time, const Memory *mem, const Random *
     m->lastdump = 0;
     m->is_receiving_file = 0;
 
+    // Profiling is optional, so the messenger works without it.
+    m->iter_prof = iterprof_new(m->log, mem, m->mono_time);
+
     m_register_default_plugins(m);
     callback_friendrequest(m->fr, m_handle_friend_request, m);
 
@@ -3624,21 +4124,36 @@ void kill_messenger(Messenger *m)
         kill_tcp_server(m->tcp_server);
     }
 
-    kill_onion(m->onion);
-    kill_onion_announce(m->onion_a);
+    if (m->host == nullptr) {
+        kill_onion(m->onion);
+        kill_onion_announce(m->onion_a);
+    }
+
     kill_dht_groupchats(m->group_handler);
     kill_friend_connections(m->fr_c);
     kill_onion_client(m->onion_c);
-    kill_gca(m->group_announce);
-    kill_announcements(m->announce);
-    kill_forwarding(m->forwarding);
+
+    if (m->host == nullptr) {
+        kill_gca(m->group_announce);
+        kill_announcements(m->announce);
+        kill_forwarding(m->forwarding);
+    }
+
     kill_net_crypto(m->net_crypto);
-    netprof_kill(m->mem, m->tcp_np);
-    kill_dht(m->dht);
-    kill_networking(m->net);
+    iterprof_kill(m->mem, m->iter_prof);
+
+    if (m->host != nullptr) {
+        // Also puts back the handlers of the other instances that we just unregistered.
+        messenger_host_detach(m->host, m->host_instance);
+    } else {
+        netprof_kill(m->mem, m->tcp_np);
+        kill_dht(m->dht);
+        kill_networking(m->net);
+    }
 
     for (uint32_t i = 0; i < m->numfriends; ++i) {
         clear_receipts(m, i);
+        free_file_tables(m->mem, &m->friendlist[i]);
     }
 
     mem_delete(m->mem, m->friendlist);
@@ -3661,8 +4176,14 @@ bool m_is_receiving_file(Messenger *m)
     // TODO(iphydf): This is a very expensive loop. Consider keeping track of
     // the number of live file transfers.
     for (size_t friend_number = 0; friend_number < m->numfriends; ++friend_number) {
+        const struct File_Transfers *const file_receiving = m->friendlist[friend_number].file_receiving;
+
+        if (file_receiving == nullptr) {
+            continue;
+        }
+
         for (size_t i = 0; i < MAX_CONCURRENT_FILE_PIPES; ++i) {
-            if (m->friendlist[friend_number].file_receiving[i].status == FILESTATUS_TRANSFERRING) {
+            if (file_receiving[i].status == FILESTATUS_TRANSFERRING) {
                 m->is_receiving_file = skip_count;
                 return true;
             }
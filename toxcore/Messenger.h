@@ -24,8 +24,10 @@
 #include "friend_requests.h"
 #include "group_announce.h"
 #include "group_common.h"
+#include "iter_profile.h"
 #include "logger.h"
 #include "mem.h"
+#include "messenger_host.h"
 #include "mono_time.h"
 #include "net.h"
 #include "net_crypto.h"
@@ -66,11 +68,26 @@ typedef uint8_t *m_state_save_cb(const Messenger *_Nonnull m, uint8_t *_Nonnull
 // Returns if there were any erros during loading
 typedef State_Load_Status m_state_load_cb(Messenger *_Nonnull m, const uint8_t *_Nonnull data, uint32_t length);
 
+// Writes the section, header included. Returns false if the writer failed.
+typedef bool m_state_write_cb(const Messenger *_Nonnull m, State_Writer *_Nonnull writer);
+
+// Like m_state_load_cb, but reads the section's length bytes from the reader
+typedef State_Load_Status m_state_read_cb(Messenger *_Nonnull m, State_Reader *_Nonnull reader, uint32_t length);
+
 typedef struct Messenger_State_Plugin {
     State_Type type;
     m_state_size_cb *_Nullable size;
     m_state_save_cb *_Nullable save;
     m_state_load_cb *_Nullable load;
+
+    /* Optional. Without them, streaming goes through a buffer of `size` bytes. */
+    m_state_write_cb *_Nullable write;
+    m_state_read_cb *_Nullable read;
+
+    /* Whether changes to the section are tracked in `dirty`. Untracked
+     * sections are always written. */
+    bool tracked;
+    bool dirty;
 } Messenger_State_Plugin;
 
 typedef struct Messenger_Options {
@@ -91,6 +108,13 @@ typedef struct Messenger_Options {
     uint8_t state_plugins_length;
 
     bool dns_enabled;
+
+    Congestion_Control_Algorithm congestion_control;
+    bool pacing;
+
+    /* If set, the network, DHT, onion and TCP relays come from this host and
+     * the settings for them above are ignored. */
+    Messenger_Host *_Nullable host;
 } Messenger_Options;
 
 struct Receipts {
@@ -150,6 +174,7 @@ struct File_Transfers {
     uint8_t paused; /* 0: not paused, 1 = paused by us, 2 = paused by other, 3 = paused by both. */
     uint32_t last_packet_number; /* number of the last packet sent. */
     uint64_t requested; /* total data requested by the request chunk callback */
+    uint16_t stream_window; /* max chunks read per iteration through the file read callback, 0 = client sends chunks. */
     uint8_t id[FILE_ID_LENGTH];
 };
 typedef enum Filestatus {
@@ -199,6 +224,8 @@ typedef void m_file_recv_cb(Messenger *_Nonnull m, uint32_t friend_number, uint3
                             uint64_t file_size, const uint8_t *_Nonnull filename, size_t filename_length, void *_Nullable user_data);
 typedef void m_file_chunk_request_cb(Messenger *_Nonnull m, uint32_t friend_number, uint32_t file_number, uint64_t position,
                                      size_t length, void *_Nullable user_data);
+typedef int32_t m_file_read_cb(Messenger *_Nonnull m, uint32_t friend_number, uint32_t file_number, uint64_t position,
+                               uint8_t *_Nonnull data, uint16_t length, void *_Nullable user_data);
 typedef void m_file_recv_chunk_cb(Messenger *_Nonnull m, uint32_t friend_number, uint32_t file_number, uint64_t position,
                                   const uint8_t *_Nullable data, size_t length, void *_Nullable user_data);
 typedef void m_friend_lossy_packet_cb(Messenger *_Nonnull m, uint32_t friend_number, uint8_t packet_id, const uint8_t *_Nonnull data,
@@ -234,9 +261,14 @@ typedef struct Friend {
     uint32_t friendrequest_nospam; // The nospam number used in the friend request.
     uint64_t last_seen_time;
     Connection_Status last_connection_udp_tcp;
-    struct File_Transfers file_sending[MAX_CONCURRENT_FILE_PIPES];
-    uint32_t num_sending_files;
-    struct File_Transfers file_receiving[MAX_CONCURRENT_FILE_PIPES];
+    /* Transfer tables of MAX_CONCURRENT_FILE_PIPES entries, indexed by file
+     * number. Allocated by the first transfer in that direction and freed by
+     * do_friends once no slot is in use. Null means all slots are free. */
+    struct File_Transfers *_Nullable file_sending;
+    uint32_t num_sending_files; // number of outgoing files being sent, i.e. accepted and not yet done.
+    uint16_t file_sending_used; // number of file_sending slots not FILESTATUS_NONE.
+    struct File_Transfers *_Nullable file_receiving;
+    uint16_t file_receiving_used; // number of file_receiving slots not FILESTATUS_NONE.
 
     struct Receipts *_Nullable receipts_start;
     struct Receipts *_Nullable receipts_end;
@@ -252,6 +284,7 @@ struct Messenger {
     Networking_Core *_Nonnull net;
     Net_Crypto *_Nonnull net_crypto;
     Net_Profile *_Nonnull tcp_np;
+    Iter_Profile *_Nullable iter_prof;
     DHT *_Nonnull dht;
 
     Forwarding *_Nullable forwarding;
@@ -265,6 +298,12 @@ struct Messenger {
 
     TCP_Server *_Nullable tcp_server;
     Friend_Requests *_Nonnull fr;
+
+    /* Owns net, dht, tcp_np, forwarding, announce, onion, onion_a and
+     * group_announce if set. */
+    Messenger_Host *_Nullable host;
+    Host_Instance *_Nullable host_instance;
+
     uint8_t name[MAX_NAME_LENGTH];
     uint16_t name_length;
 
@@ -305,6 +344,7 @@ struct Messenger {
     m_file_recv_control_cb *_Nullable file_filecontrol;
     m_file_recv_chunk_cb *_Nullable file_filedata;
     m_file_chunk_request_cb *_Nullable file_reqchunk;
+    m_file_read_cb *_Nullable file_read;
 
     m_friend_lossy_packet_cb *_Nullable lossy_packethandler;
     m_friend_lossless_packet_cb *_Nullable lossless_packethandler;
@@ -621,6 +661,15 @@ void callback_file_data(Messenger *_Nonnull m, m_file_recv_chunk_cb *_Nonnull fu
 /** @brief Set the callback for file request chunk. */
 void callback_file_reqchunk(Messenger *_Nonnull m, m_file_chunk_request_cb *_Nonnull function);
 
+/** @brief Set the callback that reads the data of streamed outgoing files.
+ *
+ * The callback copies `length` bytes of the file from `position` to `data`
+ * and returns the number of bytes copied, or -1 on error. Copying fewer bytes
+ * than requested ends a file of unknown size (UINT64_MAX) and is an error for
+ * any other file.
+ */
+void callback_file_read(Messenger *_Nonnull m, m_file_read_cb *_Nullable function);
+
 /** @brief Copy the file transfer file id to file_id
  *
  * @retval 0 on success.
@@ -683,6 +732,19 @@ int file_seek(const Messenger *_Nonnull m, int32_t friendnumber, uint32_t filenu
  */
 int send_file_data(const Messenger *_Nonnull m, int32_t friendnumber, uint32_t filenumber, uint64_t position,
                    const uint8_t *_Nullable data, uint16_t length);
+
+/** @brief Let toxcore read an outgoing file through the file read callback.
+ *
+ * Instead of requesting chunks from the client, each iteration reads up to
+ * `window` chunks (limited by the free send queue slots) into crypto packets
+ * with the file read callback. A window of 0 switches back to chunk requests.
+ *
+ * @retval 0 on success
+ * @retval -1 if friend not valid.
+ * @retval -2 if file number invalid.
+ * @retval -3 if no file read callback is set.
+ */
+int file_set_stream(const Messenger *_Nonnull m, int32_t friendnumber, uint32_t filenumber, uint16_t window);
 /*** CUSTOM PACKETS */
 
 /** @brief Set handlers for custom lossy packets. */
@@ -739,6 +801,21 @@ Messenger *_Nullable new_messenger(Mono_Time *_Nonnull mono_time, const Memory *
 void kill_messenger(Messenger *_Nullable m);
 /** @brief The main loop that needs to be run at least 20 times per second. */
 void do_messenger(Messenger *_Nonnull m, void *_Nullable userdata);
+/**
+ * @brief Like `do_messenger()`, but only reads from the UDP socket if
+ *   `udp_readable` is true.
+ *
+ * Use this when an event loop has already found that the UDP socket has no
+ * pending datagrams, to save the receive system call.
+ */
+void do_messenger_ex(Messenger *_Nonnull m, bool udp_readable, void *_Nullable userdata);
+/**
+ * @brief Call `cb` for every socket that `do_messenger()` reads from.
+ *
+ * This is the UDP socket (if UDP is enabled), the TCP relay client
+ * connections of net_crypto and group chats, and the TCP server.
+ */
+void messenger_visit_sockets(const Messenger *_Nonnull m, net_socket_visit_cb *_Nonnull cb, void *_Nonnull obj);
 /**
  * @brief Return the time in milliseconds before `do_messenger()` should be called again
  *   for optimal performance.
@@ -762,6 +839,21 @@ uint32_t messenger_size(const Messenger *_Nonnull m);
 /** Save the messenger in data (must be allocated memory of size at least `Messenger_size()`) */
 uint8_t *_Nonnull messenger_save(const Messenger *_Nonnull m, uint8_t *_Nonnull data);
 
+/** @brief Write the messenger's sections to a writer.
+ *
+ * @param changed_only Skip tracked sections that haven't changed since the
+ *   last `m_clear_state_dirty`.
+ *
+ * @retval false if the writer failed or a buffer could not be allocated.
+ */
+bool messenger_write(const Messenger *_Nonnull m, State_Writer *_Nonnull writer, bool changed_only);
+
+/** @brief Note that a section must be written by the next changed-only save. */
+void m_mark_state_dirty(const Messenger *_Nonnull m, State_Type type);
+
+/** @brief Note that all sections are saved as they are now. */
+void m_clear_state_dirty(const Messenger *_Nonnull m);
+
 /** @brief Load a state section.
  *
  * @param data Data to load.
@@ -772,6 +864,12 @@ uint8_t *_Nonnull messenger_save(const Messenger *_Nonnull m, uint8_t *_Nonnull
  */
 bool messenger_load_state_section(Messenger *_Nonnull m, const uint8_t *_Nonnull data, uint32_t length, uint16_t type, State_Load_Status *_Nonnull status);
 
+/** @brief Like `messenger_load_state_section`, but reads the section from a reader.
+ *
+ * Nothing is read from the reader if the section isn't handled.
+ */
+bool messenger_read_state_section(Messenger *_Nonnull m, State_Reader *_Nonnull reader, uint32_t length, uint16_t type, State_Load_Status *_Nonnull status);
+
 /** @brief Return the number of friends in the instance m.
  *
  * You should use this to determine how much memory to allocate
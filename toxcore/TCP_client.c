@@ -86,6 +86,21 @@ TCP_Client_Status tcp_con_status(const TCP_Client_Connection *con)
 {
     return con->status;
 }
+
+Socket tcp_con_sock(const TCP_Client_Connection *con)
+{
+    return con->con.sock;
+}
+
+uint64_t tcp_con_sock_id(const TCP_Client_Connection *con)
+{
+    return con->con.sock_id;
+}
+
+bool tcp_con_has_pending_data(const TCP_Client_Connection *con)
+{
+    return tcp_connection_has_pending_data(&con->con);
+}
 void *tcp_con_custom_object(const TCP_Client_Connection *con)
 {
     return con->custom_object;
@@ -135,6 +150,7 @@ static bool connect_sock_to(const Network *_Nonnull ns, const Logger *_Nonnull l
  */
 static int proxy_http_generate_connection_request(TCP_Client_Connection *_Nonnull tcp_conn)
 {
+    char request[MAX_PACKET_SIZE];
     const char one[] = "CONNECT ";
     const char two[] = " HTTP/1.1\nHost: ";
     const char three[] = "\r\n\r\n";
@@ -146,16 +162,14 @@ static int proxy_http_generate_connection_request(TCP_Client_Connection *_Nonnul
     }
 
     const uint16_t port = net_ntohs(tcp_conn->ip_port.port);
-    const int written = snprintf((char *)tcp_conn->con.last_packet, MAX_PACKET_SIZE, "%s%s:%hu%s%s:%hu%s", one, ip, port,
+    const int written = snprintf(request, sizeof(request), "%s%s:%hu%s%s:%hu%s", one, ip, port,
                                  two, ip, port, three);
 
     if (written < 0 || MAX_PACKET_SIZE < written) {
         return 0;
     }
 
-    tcp_conn->con.last_packet_length = written;
-    tcp_conn->con.last_packet_sent = 0;
-    return 1;
+    return tcp_connection_queue_raw(&tcp_conn->con, (const uint8_t *)request, written) ? 1 : 0;
 }
 
 /**
@@ -212,14 +226,15 @@ enum Tcp_Socks5_Proxy_Hs {
     TCP_SOCKS5_PROXY_HS_ADDR_TYPE_IPV6          = 0x04,
 };
 
-static void proxy_socks5_generate_greetings(TCP_Client_Connection *_Nonnull tcp_conn)
+static bool proxy_socks5_generate_greetings(TCP_Client_Connection *_Nonnull tcp_conn)
 {
-    tcp_conn->con.last_packet[0] = TCP_SOCKS5_PROXY_HS_VERSION_SOCKS5;
-    tcp_conn->con.last_packet[1] = TCP_SOCKS5_PROXY_HS_AUTH_METHODS_SUPPORTED;
-    tcp_conn->con.last_packet[2] = TCP_SOCKS5_PROXY_HS_NO_AUTH;
+    const uint8_t greetings[3] = {
+        TCP_SOCKS5_PROXY_HS_VERSION_SOCKS5,
+        TCP_SOCKS5_PROXY_HS_AUTH_METHODS_SUPPORTED,
+        TCP_SOCKS5_PROXY_HS_NO_AUTH,
+    };
 
-    tcp_conn->con.last_packet_length = 3;
-    tcp_conn->con.last_packet_sent = 0;
+    return tcp_connection_queue_raw(&tcp_conn->con, greetings, sizeof(greetings));
 }
 
 /**
@@ -244,30 +259,30 @@ static int socks5_read_handshake_response(const Logger *_Nonnull logger, const T
     return -1;
 }
 
-static void proxy_socks5_generate_connection_request(TCP_Client_Connection *_Nonnull tcp_conn)
+static bool proxy_socks5_generate_connection_request(TCP_Client_Connection *_Nonnull tcp_conn)
 {
-    tcp_conn->con.last_packet[0] = TCP_SOCKS5_PROXY_HS_VERSION_SOCKS5;
-    tcp_conn->con.last_packet[1] = TCP_SOCKS5_PROXY_HS_COMM_ESTABLISH_REQUEST;
-    tcp_conn->con.last_packet[2] = TCP_SOCKS5_PROXY_HS_RESERVED;
+    uint8_t request[4 + sizeof(IP6) + sizeof(uint16_t)];
+    request[0] = TCP_SOCKS5_PROXY_HS_VERSION_SOCKS5;
+    request[1] = TCP_SOCKS5_PROXY_HS_COMM_ESTABLISH_REQUEST;
+    request[2] = TCP_SOCKS5_PROXY_HS_RESERVED;
     uint16_t length = 3;
 
     if (net_family_is_ipv4(tcp_conn->ip_port.ip.family)) {
-        tcp_conn->con.last_packet[3] = TCP_SOCKS5_PROXY_HS_ADDR_TYPE_IPV4;
+        request[3] = TCP_SOCKS5_PROXY_HS_ADDR_TYPE_IPV4;
         ++length;
-        memcpy(tcp_conn->con.last_packet + length, tcp_conn->ip_port.ip.ip.v4.uint8, sizeof(IP4));
+        memcpy(request + length, tcp_conn->ip_port.ip.ip.v4.uint8, sizeof(IP4));
         length += sizeof(IP4);
     } else {
-        tcp_conn->con.last_packet[3] = TCP_SOCKS5_PROXY_HS_ADDR_TYPE_IPV6;
+        request[3] = TCP_SOCKS5_PROXY_HS_ADDR_TYPE_IPV6;
         ++length;
-        memcpy(tcp_conn->con.last_packet + length, tcp_conn->ip_port.ip.ip.v6.uint8, sizeof(IP6));
+        memcpy(request + length, tcp_conn->ip_port.ip.ip.v6.uint8, sizeof(IP6));
         length += sizeof(IP6);
     }
 
-    memcpy(tcp_conn->con.last_packet + length, &tcp_conn->ip_port.port, sizeof(uint16_t));
+    memcpy(request + length, &tcp_conn->ip_port.port, sizeof(uint16_t));
     length += sizeof(uint16_t);
 
-    tcp_conn->con.last_packet_length = length;
-    tcp_conn->con.last_packet_sent = 0;
+    return tcp_connection_queue_raw(&tcp_conn->con, request, length);
 }
 
 /**
@@ -316,17 +331,20 @@ static int generate_handshake(TCP_Client_Connection *_Nonnull tcp_conn)
     crypto_new_keypair(tcp_conn->con.rng, plain, tcp_conn->temp_secret_key);
     random_nonce(tcp_conn->con.rng, tcp_conn->con.sent_nonce);
     memcpy(plain + CRYPTO_PUBLIC_KEY_SIZE, tcp_conn->con.sent_nonce, CRYPTO_NONCE_SIZE);
-    memcpy(tcp_conn->con.last_packet, tcp_conn->self_public_key, CRYPTO_PUBLIC_KEY_SIZE);
-    random_nonce(tcp_conn->con.rng, tcp_conn->con.last_packet + CRYPTO_PUBLIC_KEY_SIZE);
-    const int len = encrypt_data_symmetric(tcp_conn->con.mem, tcp_conn->con.shared_key, tcp_conn->con.last_packet + CRYPTO_PUBLIC_KEY_SIZE, plain,
-                                           sizeof(plain), tcp_conn->con.last_packet + CRYPTO_PUBLIC_KEY_SIZE + CRYPTO_NONCE_SIZE);
+    uint8_t handshake[TCP_CLIENT_HANDSHAKE_SIZE];
+    memcpy(handshake, tcp_conn->self_public_key, CRYPTO_PUBLIC_KEY_SIZE);
+    random_nonce(tcp_conn->con.rng, handshake + CRYPTO_PUBLIC_KEY_SIZE);
+    const int len = encrypt_data_symmetric(tcp_conn->con.mem, tcp_conn->con.shared_key, handshake + CRYPTO_PUBLIC_KEY_SIZE, plain,
+                                           sizeof(plain), handshake + CRYPTO_PUBLIC_KEY_SIZE + CRYPTO_NONCE_SIZE);
 
     if (len != sizeof(plain) + CRYPTO_MAC_SIZE) {
         return -1;
     }
 
-    tcp_conn->con.last_packet_length = CRYPTO_PUBLIC_KEY_SIZE + CRYPTO_NONCE_SIZE + sizeof(plain) + CRYPTO_MAC_SIZE;
-    tcp_conn->con.last_packet_sent = 0;
+    if (!tcp_connection_queue_raw(&tcp_conn->con, handshake, sizeof(handshake))) {
+        return -1;
+    }
+
     return 0;
 }
 
@@ -660,6 +678,7 @@ TCP_Client_Connection *new_tcp_connection(
     temp->con.mem = mem;
     temp->con.rng = rng;
     temp->con.sock = sock;
+    temp->con.sock_id = random_u64(rng);
     temp->con.ip_port = *ip_port;
     temp->con.net_profile = net_profile;
     memcpy(temp->public_key, public_key, CRYPTO_PUBLIC_KEY_SIZE);
@@ -668,33 +687,36 @@ TCP_Client_Connection *new_tcp_connection(
     temp->ip_port = *ip_port;
     temp->proxy_info = *proxy_info;
 
+    bool generated = false;
+
     switch (proxy_info->proxy_type) {
         case TCP_PROXY_HTTP: {
             temp->status = TCP_CLIENT_PROXY_HTTP_CONNECTING;
-            proxy_http_generate_connection_request(temp);
+            generated = proxy_http_generate_connection_request(temp) == 1;
             break;
         }
 
         case TCP_PROXY_SOCKS5: {
             temp->status = TCP_CLIENT_PROXY_SOCKS5_CONNECTING;
-            proxy_socks5_generate_greetings(temp);
+            generated = proxy_socks5_generate_greetings(temp);
             break;
         }
 
         case TCP_PROXY_NONE: {
             temp->status = TCP_CLIENT_CONNECTING;
-
-            if (generate_handshake(temp) == -1) {
-                LOGGER_ERROR(logger, "Failed to generate handshake");
-                kill_sock(ns, sock);
-                mem_delete(mem, temp);
-                return nullptr;
-            }
-
+            generated = generate_handshake(temp) == 0;
             break;
         }
     }
 
+    if (!generated) {
+        LOGGER_ERROR(logger, "Failed to generate handshake");
+        wipe_send_queue(&temp->con);
+        kill_sock(ns, sock);
+        mem_delete(mem, temp);
+        return nullptr;
+    }
+
     temp->kill_at = mono_time_get(mono_time) + TCP_CONNECTION_TIMEOUT;
 
     return temp;
@@ -966,8 +988,8 @@ void do_tcp_connection(const Logger *logger, const Mono_Time *mono_time,
             }
 
             if (ret == 1) {
-                generate_handshake(tcp_connection);
-                tcp_connection->status = TCP_CLIENT_CONNECTING;
+                tcp_connection->status = generate_handshake(tcp_connection) == 0
+                                         ? TCP_CLIENT_CONNECTING : TCP_CLIENT_DISCONNECTED;
             }
         }
     }
@@ -982,8 +1004,8 @@ void do_tcp_connection(const Logger *logger, const Mono_Time *mono_time,
             }
 
             if (ret == 1) {
-                proxy_socks5_generate_connection_request(tcp_connection);
-                tcp_connection->status = TCP_CLIENT_PROXY_SOCKS5_UNCONFIRMED;
+                tcp_connection->status = proxy_socks5_generate_connection_request(tcp_connection)
+                                         ? TCP_CLIENT_PROXY_SOCKS5_UNCONFIRMED : TCP_CLIENT_DISCONNECTED;
             }
         }
     }
@@ -998,8 +1020,8 @@ void do_tcp_connection(const Logger *logger, const Mono_Time *mono_time,
             }
 
             if (ret == 1) {
-                generate_handshake(tcp_connection);
-                tcp_connection->status = TCP_CLIENT_CONNECTING;
+                tcp_connection->status = generate_handshake(tcp_connection) == 0
+                                         ? TCP_CLIENT_CONNECTING : TCP_CLIENT_DISCONNECTED;
             }
         }
     }
@@ -1044,7 +1066,7 @@ void kill_tcp_connection(TCP_Client_Connection *tcp_connection)
 
     const Memory *mem = tcp_connection->con.mem;
 
-    wipe_priority_list(tcp_connection->con.mem, tcp_connection->con.priority_queue_start);
+    wipe_send_queue(&tcp_connection->con);
     kill_sock(tcp_connection->con.ns, tcp_connection->con.sock);
     crypto_memzero(tcp_connection, sizeof(TCP_Client_Connection));
     mem_delete(mem, tcp_connection);
@@ -55,6 +55,9 @@ typedef struct TCP_Client_Connection TCP_Client_Connection;
 const uint8_t *_Nonnull tcp_con_public_key(const TCP_Client_Connection *_Nonnull con);
 IP_Port tcp_con_ip_port(const TCP_Client_Connection *_Nonnull con);
 TCP_Client_Status tcp_con_status(const TCP_Client_Connection *_Nonnull con);
+Socket tcp_con_sock(const TCP_Client_Connection *_Nonnull con);
+uint64_t tcp_con_sock_id(const TCP_Client_Connection *_Nonnull con);
+bool tcp_con_has_pending_data(const TCP_Client_Connection *_Nonnull con);
 
 void *_Nullable tcp_con_custom_object(const TCP_Client_Connection *_Nonnull con);
 uint32_t tcp_con_custom_uint(const TCP_Client_Connection *_Nonnull con);
@@ -12,129 +12,128 @@
 #include "crypto_core.h"
 #include "logger.h"
 #include "mem.h"
+#include "net_profile.h"
 #include "network.h"
+#include "util.h"
 
-void wipe_priority_list(const Memory *mem, TCP_Priority_List *p)
+/** Smallest send queue allocation. Holds one full packet. */
+#define TCP_SEND_QUEUE_MIN_CAPACITY 4096
+
+void wipe_send_queue(TCP_Connection *con)
 {
-    while (p != nullptr) {
-        TCP_Priority_List *pp = p;
-        p = p->next;
-        mem_delete(mem, pp->data);
-        mem_delete(mem, pp);
-    }
+    mem_delete(con->mem, con->send_queue);
+    con->send_queue = nullptr;
+    con->send_queue_capacity = 0;
+    con->send_queue_start = 0;
+    con->send_queue_length = 0;
 }
 
-/**
- * @retval 0 if pending data was sent completely
- * @retval -1 if it wasn't
+/** @brief Reallocate the send queue to hold at least `needed` bytes, keeping its contents.
+ *
+ * @retval false on allocation failure. The queue is unchanged.
  */
-int send_pending_data_nonpriority(const Logger *logger, TCP_Connection *con)
+static bool send_queue_grow(TCP_Connection *_Nonnull con, uint32_t needed)
 {
-    if (con->last_packet_length == 0) {
-        return 0;
+    uint32_t capacity = max_u32(con->send_queue_capacity, TCP_SEND_QUEUE_MIN_CAPACITY);
+
+    while (capacity < needed) {
+        if (capacity > UINT32_MAX / 2) {
+            return false;
+        }
+
+        capacity *= 2;
     }
 
-    const uint16_t left = con->last_packet_length - con->last_packet_sent;
-    const int len = net_send(con->ns, logger, con->sock, con->last_packet + con->last_packet_sent, left, &con->ip_port,
-                             con->net_profile);
+    uint8_t *queue = (uint8_t *)mem_balloc(con->mem, capacity);
 
-    if (len <= 0) {
-        return -1;
+    if (queue == nullptr) {
+        return false;
     }
 
-    if (len == left) {
-        con->last_packet_length = 0;
-        con->last_packet_sent = 0;
-        return 0;
+    if (con->send_queue != nullptr) {
+        // Unwrap the old contents to the start of the new buffer.
+        const uint32_t first = min_u32(con->send_queue_length, con->send_queue_capacity - con->send_queue_start);
+        memcpy(queue, con->send_queue + con->send_queue_start, first);
+        memcpy(queue + first, con->send_queue, con->send_queue_length - first);
+        mem_delete(con->mem, con->send_queue);
     }
 
-    con->last_packet_sent += len;
-    return -1;
+    con->send_queue = queue;
+    con->send_queue_capacity = capacity;
+    con->send_queue_start = 0;
+    return true;
 }
 
-/**
- * @retval 0 if pending data was sent completely
- * @retval -1 if it wasn't
- */
-int send_pending_data(const Logger *logger, TCP_Connection *con)
+static bool send_queue_push(TCP_Connection *_Nonnull con, const uint8_t *_Nonnull data, uint32_t length)
 {
-    /* finish sending current non-priority packet */
-    if (send_pending_data_nonpriority(logger, con) == -1) {
-        return -1;
+    if (con->send_queue_length + length > con->send_queue_capacity
+            && !send_queue_grow(con, con->send_queue_length + length)) {
+        return false;
     }
 
-    TCP_Priority_List *p = con->priority_queue_start;
-
-    while (p != nullptr) {
-        const uint16_t left = p->size - p->sent;
-        const int len = net_send(con->ns, logger, con->sock, p->data + p->sent, left, &con->ip_port, con->net_profile);
-
-        if (len != left) {
-            if (len > 0) {
-                p->sent += len;
-            }
+    const uint32_t mask = con->send_queue_capacity - 1;
+    const uint32_t end = (con->send_queue_start + con->send_queue_length) & mask;
+    const uint32_t first = min_u32(length, con->send_queue_capacity - end);
+    memcpy(con->send_queue + end, data, first);
+    memcpy(con->send_queue, data + first, length - first);
+    con->send_queue_length += length;
+    return true;
+}
 
-            break;
-        }
+/** @brief Whether `size` more bytes fit in the send queue without going over budget. */
+static bool send_queue_has_room(const TCP_Connection *_Nonnull con, uint32_t size)
+{
+    const uint32_t limit = con->send_queue_budget != 0 ? con->send_queue_budget : TCP_SEND_QUEUE_DEFAULT_BUDGET;
+    return con->send_queue_length + size <= limit;
+}
 
-        TCP_Priority_List *pp = p;
-        p = p->next;
-        mem_delete(con->mem, pp->data);
-        mem_delete(con->mem, pp);
-    }
+bool tcp_connection_queue_raw(TCP_Connection *con, const uint8_t *data, uint16_t length)
+{
+    return send_queue_push(con, data, length);
+}
 
-    con->priority_queue_start = p;
+bool tcp_connection_has_pending_data(const TCP_Connection *con)
+{
+    return con->send_queue_length != 0;
+}
 
-    if (p == nullptr) {
-        con->priority_queue_end = nullptr;
+int send_pending_data(const Logger *logger, TCP_Connection *con)
+{
+    if (con->send_queue_length == 0) {
         return 0;
     }
 
-    return -1;
-}
-
-/**
- * @retval false on failure (only if mem_alloc fails)
- * @retval true on success
- */
-static bool add_priority(TCP_Connection *_Nonnull con, const uint8_t *_Nonnull packet, uint16_t size, uint16_t sent)
-{
-    TCP_Priority_List *p = con->priority_queue_end;
-    TCP_Priority_List *new_list = (TCP_Priority_List *)mem_alloc(con->mem, sizeof(TCP_Priority_List));
+    // The queued bytes are at most two pieces: up to the end of the buffer,
+    // and the part that wrapped around to its start.
+    const uint32_t first = min_u32(con->send_queue_length, con->send_queue_capacity - con->send_queue_start);
+    const Net_Send_Vec vecs[2] = {
+        {con->send_queue + con->send_queue_start, first},
+        {con->send_queue, con->send_queue_length - first},
+    };
+    const int len = net_sendv(con->ns, logger, con->sock, vecs, first == con->send_queue_length ? 1 : 2,
+                              &con->ip_port, con->net_profile);
 
-    if (new_list == nullptr) {
-        return false;
+    if (len <= 0) {
+        return -1;
     }
 
-    uint8_t *data = (uint8_t *)mem_balloc(con->mem, size);
+    con->send_queue_start = (con->send_queue_start + (uint32_t)len) & (con->send_queue_capacity - 1);
+    con->send_queue_length -= (uint32_t)len;
 
-    if (data == nullptr) {
-        mem_delete(con->mem, new_list);
-        return false;
+    if (con->send_queue_length != 0) {
+        return -1;
     }
 
-    memcpy(data, packet, size);
-    new_list->data = data;
-    new_list->size = size;
-
-    new_list->next = nullptr;
-    new_list->sent = sent;
+    con->send_queue_start = 0;
 
-    if (p != nullptr) {
-        p->next = new_list;
-    } else {
-        con->priority_queue_start = new_list;
+    if (con->send_queue_capacity > TCP_SEND_QUEUE_MIN_CAPACITY) {
+        // Don't hold on to a large buffer once the reader has caught up.
+        wipe_send_queue(con);
     }
 
-    con->priority_queue_end = new_list;
-    return true;
+    return 0;
 }
 
-/**
- * @retval 1 on success.
- * @retval 0 if could not send packet.
- * @retval -1 on failure (connection must be killed).
- */
 int write_packet_tcp_secure_connection(const Logger *logger, TCP_Connection *con, const uint8_t *data, uint16_t length,
                                        bool priority)
 {
@@ -142,59 +141,44 @@ int write_packet_tcp_secure_connection(const Logger *logger, TCP_Connection *con
         return -1;
     }
 
-    bool sendpriority = true;
+    const uint16_t packet_size = sizeof(uint16_t) + length + CRYPTO_MAC_SIZE;
 
-    if (send_pending_data(logger, con) == -1) {
-        if (priority) {
-            sendpriority = false;
-        } else {
-            return 0;
-        }
+    if (send_pending_data(logger, con) == -1 && !priority && !send_queue_has_room(con, packet_size)) {
+        netprof_record_drop(con->net_profile, packet_size);
+        return 0;
     }
 
-    const uint16_t packet_size = sizeof(uint16_t) + length + CRYPTO_MAC_SIZE;
     VLA(uint8_t, packet, packet_size);
 
     uint16_t c_length = net_htons(length + CRYPTO_MAC_SIZE);
     memcpy(packet, &c_length, sizeof(uint16_t));
-    int len = encrypt_data_symmetric(con->mem, con->shared_key, con->sent_nonce, data, length, packet + sizeof(uint16_t));
+    const int len = encrypt_data_symmetric(con->mem, con->shared_key, con->sent_nonce, data, length, packet + sizeof(uint16_t));
 
     if ((unsigned int)len != (packet_size - sizeof(uint16_t))) {
         return -1;
     }
 
-    if (priority) {
-        len = sendpriority ? net_send(con->ns, logger, con->sock, packet, packet_size, &con->ip_port,
-                                      con->net_profile) : 0;
-
-        if (len <= 0) {
-            len = 0;
-        }
+    int sent = 0;
 
-        increment_nonce(con->sent_nonce);
+    if (con->send_queue_length == 0) {
+        sent = net_send(con->ns, logger, con->sock, packet, packet_size, &con->ip_port, con->net_profile);
 
-        if ((unsigned int)len == packet_size) {
-            return 1;
+        if (sent < 0) {
+            sent = 0;
         }
-
-        return add_priority(con, packet, packet_size, len) ? 1 : 0;
     }
 
-    len = net_send(con->ns, logger, con->sock, packet, packet_size, &con->ip_port, con->net_profile);
+    if (sent < packet_size && !send_queue_push(con, packet + sent, packet_size - sent)) {
+        if (sent > 0) {
+            // Part of the packet is on the wire, and the rest is lost.
+            return -1;
+        }
 
-    if (len <= 0) {
+        netprof_record_drop(con->net_profile, packet_size);
         return 0;
     }
 
     increment_nonce(con->sent_nonce);
-
-    if ((unsigned int)len == packet_size) {
-        return 1;
-    }
-
-    memcpy(con->last_packet, packet, packet_size);
-    con->last_packet_length = packet_size;
-    con->last_packet_sent = len;
     return 1;
 }
 
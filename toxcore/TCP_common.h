@@ -22,15 +22,6 @@
 extern "C" {
 #endif
 
-typedef struct TCP_Priority_List TCP_Priority_List;
-struct TCP_Priority_List {
-    TCP_Priority_List *_Nullable next;
-    uint16_t size;
-    uint16_t sent;
-    uint8_t *_Nonnull data;
-};
-
-void wipe_priority_list(const Memory *_Nonnull mem, TCP_Priority_List *_Nullable p);
 #define NUM_RESERVED_PORTS 16
 #define NUM_CLIENT_CONNECTIONS (256 - NUM_RESERVED_PORTS)
 
@@ -63,39 +54,68 @@ bool tcp_packet_from_int(uint32_t value, Tcp_Packet *_Nonnull out_enum);
 
 #define MAX_PACKET_SIZE 2048
 
+/** Bytes of queued packets a connection holds for a slow reader by default. */
+#define TCP_SEND_QUEUE_DEFAULT_BUDGET (16 * (2 + MAX_PACKET_SIZE))
+
 typedef struct TCP_Connection {
     const Memory *_Nonnull mem;
     const Random *_Nonnull rng;
     const Network *_Nonnull ns;
     Socket sock;
+    /* Random, see `net_socket_visit_cb`. */
+    uint64_t sock_id;
     IP_Port ip_port;  // for debugging.
     uint8_t sent_nonce[CRYPTO_NONCE_SIZE]; /* Nonce of sent packets. */
     uint8_t shared_key[CRYPTO_SHARED_KEY_SIZE];
-    uint8_t last_packet[2 + MAX_PACKET_SIZE];
-    uint16_t last_packet_length;
-    uint16_t last_packet_sent;
 
-    TCP_Priority_List *_Nullable priority_queue_start;
-    TCP_Priority_List *_Nullable priority_queue_end;
+    /* Bytes waiting for the socket to become writable, oldest first. A ring
+     * buffer with a power of 2 capacity, allocated when the socket first
+     * blocks and released again once a large backlog has drained. */
+    uint8_t *_Nullable send_queue;
+    uint32_t send_queue_capacity;
+    uint32_t send_queue_start;
+    uint32_t send_queue_length;
+    /* Most bytes to queue before refusing packets. 0 means
+     * TCP_SEND_QUEUE_DEFAULT_BUDGET. */
+    uint32_t send_queue_budget;
 
     // This is a shared pointer to the parent's respective Net_Profile object
     // (either TCP_Server for TCP server packets or TCP_Connections for TCP client packets).
     Net_Profile *_Nullable net_profile;
 } TCP_Connection;
 
-/**
- * @retval 0 if pending data was sent completely
- * @retval -1 if it wasn't
- */
-int send_pending_data_nonpriority(const Logger *_Nonnull logger, TCP_Connection *_Nonnull con);
+/** @brief Free the send queue of a connection that is being destroyed. */
+void wipe_send_queue(TCP_Connection *_Nonnull con);
 
-/**
+/** @brief Write as much of the send queue to the socket as it takes, in one call.
+ *
  * @retval 0 if pending data was sent completely
  * @retval -1 if it wasn't
  */
 int send_pending_data(const Logger *_Nonnull logger, TCP_Connection *_Nonnull con);
 
+/** @brief Return true if there is queued data waiting for the socket to become writable. */
+bool tcp_connection_has_pending_data(const TCP_Connection *_Nonnull con);
+
+/** @brief Append raw bytes (e.g. a handshake) to the send queue, ignoring the budget.
+ *
+ * They are written out by the next send_pending_data.
+ *
+ * @retval false if memory allocation failed.
+ */
+bool tcp_connection_queue_raw(TCP_Connection *_Nonnull con, const uint8_t *_Nonnull data, uint16_t length);
+
 /**
+ * @brief Encrypt and send a packet, queueing whatever the socket doesn't take.
+ *
+ * Packets are always written in order. While older packets are still queued,
+ * a new packet is queued behind them if that keeps the queue within the
+ * connection's budget, and refused otherwise. Priority packets are small
+ * control packets (pings, routing and connection notifications) whose loss
+ * would leave the other side with a wrong view of the connection, so they are
+ * queued even beyond the budget. Refused packets are counted as drops in the
+ * connection's net profile.
+ *
  * @retval 1 on success.
  * @retval 0 if could not send packet.
  * @retval -1 on failure (connection must be killed).
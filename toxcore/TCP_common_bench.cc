@@ -0,0 +1,129 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "TCP_common.h"
+#include "crypto_core.h"
+#include "logger.h"
+#include "net_profile.h"
+#include "os_memory.h"
+#include "os_random.h"
+
+namespace {
+
+/** @brief Size of each relayed data packet, before encryption. */
+constexpr std::uint16_t kPayloadSize = 1024;
+/** @brief Packets the relay tries to forward to the reader per iteration. */
+constexpr int kPacketsPerTick = 32;
+
+/** @brief A client socket that accepts a fixed number of bytes per iteration. */
+struct SlowReader {
+    std::size_t window = 0;
+    std::size_t calls = 0;
+
+    int take(std::size_t len)
+    {
+        ++calls;
+        const std::size_t n = std::min(len, window);
+        if (n == 0) {
+            return -1;
+        }
+        window -= n;
+        return static_cast<int>(n);
+    }
+};
+
+constexpr Network_Funcs kSendFuncs = {
+    .send = [](void *obj, Socket sock, const std::uint8_t *buf,
+                std::size_t len) { return static_cast<SlowReader *>(obj)->take(len); },
+};
+
+constexpr Network_Funcs kSendvFuncs = {
+    .send = [](void *obj, Socket sock, const std::uint8_t *buf,
+                std::size_t len) { return static_cast<SlowReader *>(obj)->take(len); },
+    .sendv =
+        [](void *obj, Socket sock, const Net_Send_Vec *vecs, std::size_t count) {
+            std::size_t len = 0;
+            for (std::size_t i = 0; i < count; ++i) {
+                len += vecs[i].length;
+            }
+            return static_cast<SlowReader *>(obj)->take(len);
+        },
+};
+
+/**
+ * @brief A relay forwarding data to a reader that can't keep up.
+ *
+ * Each iteration the relay flushes what it can, then tries to forward
+ * kPacketsPerTick packets, as do_tcp_server would after reading them from the
+ * sender. The reader drains `range(0)` percent of the offered bytes per
+ * iteration. `range(1)` is the send queue budget in full-size packets, and
+ * `range(2)` selects vectored sends.
+ *
+ * Reports bytes delivered to the reader, packets dropped by the relay, and
+ * socket writes per iteration.
+ */
+void BM_SlowReaderRelay(benchmark::State &state)
+{
+    const auto reader_percent = static_cast<std::size_t>(state.range(0));
+    const auto budget_packets = static_cast<std::uint32_t>(state.range(1));
+    const bool use_sendv = state.range(2) != 0;
+
+    const Memory *mem = os_memory();
+    Logger *logger = logger_new(mem);
+    Net_Profile *profile = netprof_new(logger, mem);
+
+    SlowReader reader;
+    const Network ns = {use_sendv ? &kSendvFuncs : &kSendFuncs, &reader};
+
+    TCP_Connection con;
+    std::memset(&con, 0, sizeof(con));
+    con.mem = mem;
+    con.rng = os_random();
+    con.ns = &ns;
+    con.net_profile = profile;
+    con.send_queue_budget = budget_packets * (2 + MAX_PACKET_SIZE);
+    std::memset(con.shared_key, 0x42, sizeof(con.shared_key));
+
+    std::vector<std::uint8_t> payload(kPayloadSize, 0x55);
+    const std::size_t wire_size = 2 + kPayloadSize + CRYPTO_MAC_SIZE;
+    const std::size_t reader_bytes = kPacketsPerTick * wire_size * reader_percent / 100;
+
+    for (auto _ : state) {
+        reader.window = reader_bytes;
+        send_pending_data(logger, &con);
+
+        for (int i = 0; i < kPacketsPerTick; ++i) {
+            benchmark::DoNotOptimize(
+                write_packet_tcp_secure_connection(logger, &con, payload.data(), kPayloadSize, false));
+        }
+    }
+
+    const double iterations = static_cast<double>(state.iterations());
+    state.counters["delivered_B"] = benchmark::Counter(
+        static_cast<double>(netprof_get_bytes_total(profile, PACKET_DIRECTION_SEND)),
+        benchmark::Counter::kIsRate);
+    state.counters["dropped/iter"] = static_cast<double>(netprof_get_packet_count_dropped(profile)) / iterations;
+    state.counters["writes/iter"] = static_cast<double>(reader.calls) / iterations;
+    state.SetItemsProcessed(state.iterations() * kPacketsPerTick);
+
+    wipe_send_queue(&con);
+    netprof_kill(mem, profile);
+    logger_kill(logger);
+}
+
+BENCHMARK(BM_SlowReaderRelay)
+    ->ArgNames({"reader%", "budget", "sendv"})
+    ->ArgsProduct({{25, 90, 100, 200}, {4, 16, 64}, {0, 1}});
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -2,99 +2,272 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <array>
 #include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
 
+#include "crypto_core.h"
 #include "logger.h"
+#include "net_profile.h"
 #include "os_memory.h"
 #include "os_random.h"
 
 namespace {
 
-TEST(TCP_common, PriorityQueueOrderingAndIntegrity)
-{
-    constexpr Network_Funcs mock_funcs = {
-        nullptr,
-        nullptr,
-        nullptr,
-        nullptr,
-        nullptr,
-        nullptr,
-        nullptr,
-        nullptr,
-        // Mock net_send to simulate a full buffer (returns 0)
-        // This forces packets into the priority queue.
-        [](void *obj, Socket sock, const uint8_t *buf, std::size_t len) {
-            (void)obj;
-            (void)sock;
-            (void)buf;
-            (void)len;
-            return 0;
+/** A stream socket that takes at most `window` bytes per call and records them. */
+struct FakeStream {
+    std::size_t window = 0;
+    std::size_t calls = 0;
+    std::vector<std::uint8_t> wire;
+
+    int take(const std::uint8_t *buf, std::size_t len)
+    {
+        ++calls;
+        const std::size_t n = std::min(len, window);
+        if (n == 0) {
+            return -1;
+        }
+        wire.insert(wire.end(), buf, buf + n);
+        window -= n;
+        return static_cast<int>(n);
+    }
+};
+
+constexpr Network_Funcs kSendFuncs = {
+    .send =
+        [](void *obj, Socket sock, const std::uint8_t *buf, std::size_t len) {
+            return static_cast<FakeStream *>(obj)->take(buf, len);
         },
-        nullptr,
-        nullptr,
-        nullptr,
-        nullptr,
-        nullptr,
-        nullptr,
-        nullptr,
-    };
-
-    TCP_Connection con;
-    memset(&con, 0, sizeof(con));
-    con.mem = os_memory();
-    con.rng = os_random();
-    Network ns = {&mock_funcs, nullptr};
-    con.ns = &ns;
-
-    Logger *logger = logger_new(con.mem);
-    ASSERT_NE(logger, nullptr);
-
-    // Minimal initialization to make write_packet_tcp_secure_connection happy
-    // It calls encrypt_data_symmetric which needs shared_key and sent_nonce
-    memset(con.shared_key, 0x42, sizeof(con.shared_key));
-    memset(con.sent_nonce, 0x12, sizeof(con.sent_nonce));
-
-    uint8_t data1[] = "packet1";
-    uint8_t data2[] = "packet2";
-    uint8_t data3[] = "packet3";
-
-    // First packet: will fail net_send (mocked to 0) and go to add_priority
-    // Queue: [packet1]
-    int ret1 = write_packet_tcp_secure_connection(logger, &con, data1, sizeof(data1), true);
-    ASSERT_EQ(ret1, 1);
-    ASSERT_NE(con.priority_queue_start, nullptr);
-    ASSERT_EQ(con.priority_queue_start, con.priority_queue_end);
-
-    // Second packet: will go to add_priority
-    // Queue: [packet1] -> [packet2]
-    int ret2 = write_packet_tcp_secure_connection(logger, &con, data2, sizeof(data2), true);
-    ASSERT_EQ(ret2, 1);
-    ASSERT_NE(con.priority_queue_start->next, nullptr);
-    ASSERT_EQ(con.priority_queue_start->next, con.priority_queue_end);
-
-    // Third packet: will go to add_priority
-    // WITH BUG: Queue becomes [packet1] -> [packet3], packet2 is LOST
-    // WITHOUT BUG: Queue: [packet1] -> [packet2] -> [packet3]
-    int ret3 = write_packet_tcp_secure_connection(logger, &con, data3, sizeof(data3), true);
-    ASSERT_EQ(ret3, 1);
-
-    // Verify integrity
-    TCP_Priority_List *p = con.priority_queue_start;
-    int count = 0;
-    while (p) {
-        count++;
-        p = p->next;
+};
+
+/** Same, but with vectored sends, like the OS implementation. */
+constexpr Network_Funcs kSendvFuncs = {
+    .send =
+        [](void *obj, Socket sock, const std::uint8_t *buf, std::size_t len) {
+            return static_cast<FakeStream *>(obj)->take(buf, len);
+        },
+    .sendv =
+        [](void *obj, Socket sock, const Net_Send_Vec *vecs, std::size_t count) {
+            auto *stream = static_cast<FakeStream *>(obj);
+            std::vector<std::uint8_t> joined;
+            for (std::size_t i = 0; i < count; ++i) {
+                joined.insert(joined.end(), vecs[i].buf, vecs[i].buf + vecs[i].length);
+            }
+            return stream->take(joined.data(), joined.size());
+        },
+};
+
+class TcpCommonTest : public ::testing::TestWithParam<const Network_Funcs *> {
+protected:
+    void SetUp() override
+    {
+        ns_ = {GetParam(), &stream_};
+        std::memset(&con_, 0, sizeof(con_));
+        con_.mem = os_memory();
+        con_.rng = os_random();
+        con_.ns = &ns_;
+        logger_ = logger_new(con_.mem);
+        ASSERT_NE(logger_, nullptr);
+        profile_ = netprof_new(logger_, con_.mem);
+        ASSERT_NE(profile_, nullptr);
+        con_.net_profile = profile_;
+
+        // write_packet_tcp_secure_connection encrypts with these.
+        std::memset(con_.shared_key, 0x42, sizeof(con_.shared_key));
+        std::memset(con_.sent_nonce, 0x12, sizeof(con_.sent_nonce));
+        std::memcpy(recv_nonce_, con_.sent_nonce, sizeof(recv_nonce_));
+    }
+
+    void TearDown() override
+    {
+        wipe_send_queue(&con_);
+        netprof_kill(con_.mem, profile_);
+        logger_kill(logger_);
+    }
+
+    int write(const std::string &payload, bool priority)
+    {
+        return write_packet_tcp_secure_connection(logger_, &con_,
+            reinterpret_cast<const std::uint8_t *>(payload.data()),
+            static_cast<std::uint16_t>(payload.size()), priority);
+    }
+
+    /** Decrypt every complete packet on the wire so far. */
+    std::vector<std::string> received()
+    {
+        std::vector<std::string> packets;
+        std::size_t pos = 0;
+        std::array<std::uint8_t, sizeof(recv_nonce_)> nonce;
+        std::memcpy(nonce.data(), recv_nonce_, nonce.size());
+
+        while (pos + 2 <= stream_.wire.size()) {
+            const std::size_t length = (stream_.wire[pos] << 8) | stream_.wire[pos + 1];
+            if (pos + 2 + length > stream_.wire.size()) {
+                break;
+            }
+
+            std::vector<std::uint8_t> plain(length);
+            const int len = decrypt_data_symmetric(con_.mem, con_.shared_key, nonce.data(),
+                stream_.wire.data() + pos + 2, length, plain.data());
+            EXPECT_EQ(len, static_cast<int>(length) - CRYPTO_MAC_SIZE) << "packet at byte " << pos;
+            if (len < 0) {
+                break;
+            }
+            increment_nonce(nonce.data());
+            packets.emplace_back(plain.begin(), plain.begin() + len);
+            pos += 2 + length;
+        }
+
+        return packets;
+    }
+
+    FakeStream stream_;
+    Network ns_{};
+    TCP_Connection con_;
+    Logger *logger_ = nullptr;
+    Net_Profile *profile_ = nullptr;
+    std::uint8_t recv_nonce_[CRYPTO_NONCE_SIZE];
+};
+
+TEST_P(TcpCommonTest, PriorityQueueOrderingAndIntegrity)
+{
+    // The socket takes nothing, so every packet is queued.
+    EXPECT_EQ(write("packet1", true), 1);
+    EXPECT_EQ(write("packet2", true), 1);
+    EXPECT_EQ(write("packet3", true), 1);
+    EXPECT_TRUE(tcp_connection_has_pending_data(&con_));
+    EXPECT_EQ(con_.send_queue_length, 3 * (2 + 7 + CRYPTO_MAC_SIZE));
+
+    stream_.window = SIZE_MAX;
+    EXPECT_EQ(send_pending_data(logger_, &con_), 0);
+    EXPECT_FALSE(tcp_connection_has_pending_data(&con_));
+    EXPECT_EQ(received(), (std::vector<std::string>{"packet1", "packet2", "packet3"}));
+}
+
+TEST_P(TcpCommonTest, SendsDirectlyWhenNothingIsQueued)
+{
+    stream_.window = SIZE_MAX;
+    EXPECT_EQ(write("hello", false), 1);
+    EXPECT_FALSE(tcp_connection_has_pending_data(&con_));
+    EXPECT_EQ(con_.send_queue, nullptr);
+    EXPECT_EQ(received(), std::vector<std::string>{"hello"});
+}
+
+TEST_P(TcpCommonTest, QueuesRestOfPartiallySentPacket)
+{
+    stream_.window = 5;
+    EXPECT_EQ(write("partial", false), 1);
+    EXPECT_TRUE(tcp_connection_has_pending_data(&con_));
+
+    stream_.window = SIZE_MAX;
+    EXPECT_EQ(write("next", false), 1);
+    EXPECT_FALSE(tcp_connection_has_pending_data(&con_));
+    EXPECT_EQ(received(), (std::vector<std::string>{"partial", "next"}));
+}
+
+TEST_P(TcpCommonTest, RefusesNonPriorityPacketsOverBudget)
+{
+    const std::string payload(100, 'x');
+    const uint32_t packet_size = 2 + payload.size() + CRYPTO_MAC_SIZE;
+    con_.send_queue_budget = 4 * packet_size;
+
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(write(payload, false), 1) << i;
     }
 
-    // This is where it will fail if the change in
-    // https://github.com/TokTok/c-toxcore/pull/2387 is applied.
-    // The count will be 2 instead of 3.
-    EXPECT_EQ(count, 3)
-        << "Priority queue lost packets! (likely due to incorrect tail pointer usage)";
+    EXPECT_EQ(write(payload, false), 0);
+    EXPECT_EQ(con_.send_queue_length, 4 * packet_size);
+    EXPECT_EQ(netprof_get_packet_count_dropped(profile_), 1);
+    EXPECT_EQ(netprof_get_bytes_dropped(profile_), packet_size);
+
+    // Priority packets are queued beyond the budget.
+    EXPECT_EQ(write("ping", true), 1);
 
-    // Clean up
-    wipe_priority_list(con.mem, con.priority_queue_start);
-    logger_kill(logger);
+    // A refused packet must not use up a nonce, or the stream would break.
+    stream_.window = SIZE_MAX;
+    EXPECT_EQ(write("after", false), 1);
+    const std::vector<std::string> packets = received();
+    ASSERT_EQ(packets.size(), 6);
+    EXPECT_EQ(packets[4], "ping");
+    EXPECT_EQ(packets[5], "after");
 }
 
+TEST_P(TcpCommonTest, PriorityPacketsAreNeverRefused)
+{
+    const std::string payload(1000, 'p');
+    const uint32_t packet_size = 2 + payload.size() + CRYPTO_MAC_SIZE;
+    con_.send_queue_budget = 1;
+
+    // Far more than any budget, so a dropped disconnect notification or ping
+    // can't leave the other side believing in a dead route.
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_EQ(write(payload, true), 1) << i;
+    }
+
+    EXPECT_EQ(con_.send_queue_length, 100 * packet_size);
+    EXPECT_EQ(netprof_get_packet_count_dropped(profile_), 0);
+
+    // Other packets still respect the budget.
+    EXPECT_EQ(write(payload, false), 0);
+
+    stream_.window = SIZE_MAX;
+    EXPECT_EQ(write("after", false), 1);
+    const std::vector<std::string> packets = received();
+    ASSERT_EQ(packets.size(), 101);
+    EXPECT_EQ(packets[100], "after");
 }
+
+TEST_P(TcpCommonTest, SlowReaderKeepsStreamIntactAcrossWrapAround)
+{
+    // The reader takes a few hundred bytes at a time while the writer keeps
+    // adding packets, so the ring wraps around many times.
+    std::vector<std::string> sent;
+
+    for (int i = 0; i < 500; ++i) {
+        const std::string payload = "packet " + std::to_string(i) + std::string(i % 97, '.');
+
+        if (write(payload, i % 7 == 0) == 1) {
+            sent.push_back(payload);
+        }
+
+        stream_.window = 300;
+        send_pending_data(logger_, &con_);
+    }
+
+    stream_.window = SIZE_MAX;
+    EXPECT_EQ(send_pending_data(logger_, &con_), 0);
+    EXPECT_EQ(received(), sent);
+}
+
+TEST_P(TcpCommonTest, ReleasesLargeBufferOnceDrained)
+{
+    const std::string payload(1500, 'b');
+
+    for (int i = 0; i < 8; ++i) {
+        ASSERT_EQ(write(payload, false), 1);
+    }
+
+    EXPECT_GT(con_.send_queue_capacity, 8 * payload.size());
+
+    stream_.window = SIZE_MAX;
+    EXPECT_EQ(send_pending_data(logger_, &con_), 0);
+    EXPECT_EQ(con_.send_queue, nullptr);
+    EXPECT_EQ(con_.send_queue_capacity, 0);
+}
+
+TEST_P(TcpCommonTest, RawDataGoesOutBeforeLaterPackets)
+{
+    const std::uint8_t handshake[] = {1, 2, 3};
+    ASSERT_TRUE(tcp_connection_queue_raw(&con_, handshake, sizeof(handshake)));
+
+    stream_.window = SIZE_MAX;
+    EXPECT_EQ(send_pending_data(logger_, &con_), 0);
+    EXPECT_EQ(stream_.wire, std::vector<std::uint8_t>(handshake, handshake + sizeof(handshake)));
+}
+
+INSTANTIATE_TEST_SUITE_P(SendAndSendv, TcpCommonTest, ::testing::Values(&kSendFuncs, &kSendvFuncs));
+
+}  // namespace
@@ -22,6 +22,7 @@
 #include "mono_time.h"
 #include "net_profile.h"
 #include "network.h"
+#include "pk_index.h"
 #include "util.h"
 
 struct TCP_Connections {
@@ -37,6 +38,11 @@ struct TCP_Connections {
 
     TCP_Connection_to *_Nullable connections;
     uint32_t connections_length; /* Length of connections array. */
+    /* No connection below this index is free. */
+    uint32_t connections_free_hint;
+
+    /* Maps the public key of each connection to its connections_number. */
+    PK_Index *_Nonnull connections_by_pk;
 
     TCP_con *_Nullable tcp_connections;
     uint32_t tcp_connections_length; /* Length of tcp_connections array. */
@@ -75,6 +81,25 @@ uint32_t tcp_connections_count(const TCP_Connections *tcp_c)
     return tcp_c->tcp_connections_length;
 }
 
+void tcp_connections_visit_sockets(const TCP_Connections *tcp_c, net_socket_visit_cb *cb, void *obj)
+{
+    for (uint32_t i = 0; i < tcp_c->tcp_connections_length; ++i) {
+        const TCP_con *tcp_con = &tcp_c->tcp_connections[i];
+
+        if (tcp_con->status == TCP_CONN_NONE || tcp_con->connection == nullptr) {
+            continue;
+        }
+
+        /* Disconnected sockets are always readable (EOF) until they are killed. */
+        if (tcp_con_status(tcp_con->connection) == TCP_CLIENT_DISCONNECTED) {
+            continue;
+        }
+
+        cb(obj, tcp_con_sock(tcp_con->connection), tcp_con_sock_id(tcp_con->connection),
+           tcp_con_has_pending_data(tcp_con->connection));
+    }
+}
+
 /** @brief Set the size of the array to num.
  *
  * @retval -1 if mem_vrealloc fails.
@@ -158,8 +183,9 @@ static bool tcp_connections_number_is_valid(const TCP_Connections *_Nonnull tcp_
  */
 static int create_connection(TCP_Connections *_Nonnull tcp_c)
 {
-    for (uint32_t i = 0; i < tcp_c->connections_length; ++i) {
+    for (uint32_t i = tcp_c->connections_free_hint; i < tcp_c->connections_length; ++i) {
         if (tcp_c->connections[i].status == TCP_CONN_NONE) {
+            tcp_c->connections_free_hint = i + 1;
             return i;
         }
     }
@@ -170,6 +196,7 @@ static int create_connection(TCP_Connections *_Nonnull tcp_c)
         id = tcp_c->connections_length;
         ++tcp_c->connections_length;
         tcp_c->connections[id] = empty_tcp_connection_to;
+        tcp_c->connections_free_hint = tcp_c->connections_length;
     }
 
     return id;
@@ -210,9 +237,19 @@ static int wipe_connection(TCP_Connections *_Nonnull tcp_c, int connections_numb
         return -1;
     }
 
+    const uint8_t *public_key = tcp_c->connections[connections_number].public_key;
+
+    if (pk_index_get(tcp_c->connections_by_pk, public_key) == connections_number) {
+        pk_index_remove(tcp_c->connections_by_pk, public_key);
+    }
+
     uint32_t i;
     tcp_c->connections[connections_number] = empty_tcp_connection_to;
 
+    if ((uint32_t)connections_number < tcp_c->connections_free_hint) {
+        tcp_c->connections_free_hint = connections_number;
+    }
+
     for (i = tcp_c->connections_length; i != 0; --i) {
         if (tcp_c->connections[i - 1].status != TCP_CONN_NONE) {
             break;
@@ -580,6 +617,24 @@ void set_oob_packet_tcp_connection_callback(TCP_Connections *tcp_c, tcp_oob_cb *
     tcp_c->tcp_oob_callback_object = object;
 }
 
+tcp_data_cb *get_packet_tcp_connection_callback(const TCP_Connections *tcp_c, void **object)
+{
+    *object = tcp_c->tcp_data_callback_object;
+    return tcp_c->tcp_data_callback;
+}
+
+tcp_onion_cb *get_onion_packet_tcp_connection_callback(const TCP_Connections *tcp_c, void **object)
+{
+    *object = tcp_c->tcp_onion_callback_object;
+    return tcp_c->tcp_onion_callback;
+}
+
+tcp_oob_cb *get_oob_packet_tcp_connection_callback(const TCP_Connections *tcp_c, void **object)
+{
+    *object = tcp_c->tcp_oob_callback_object;
+    return tcp_c->tcp_oob_callback;
+}
+
 /** @brief Set the callback for TCP onion packets. */
 void set_onion_packet_tcp_connection_callback(TCP_Connections *tcp_c, tcp_onion_cb *tcp_onion_callback, void *object)
 {
@@ -626,17 +681,13 @@ bool ip_port_to_tcp_connections_number(const IP_Port *ip_port, unsigned int *tcp
  */
 static int find_tcp_connection_to(const TCP_Connections *_Nonnull tcp_c, const uint8_t *_Nonnull public_key)
 {
-    for (uint32_t i = 0; i < tcp_c->connections_length; ++i) {
-        const TCP_Connection_to *con_to = get_connection(tcp_c, i);
+    const int64_t connections_number = pk_index_get(tcp_c->connections_by_pk, public_key);
 
-        if (con_to != nullptr) {
-            if (pk_equal(con_to->public_key, public_key)) {
-                return i;
-            }
-        }
+    if (connections_number == -1 || get_connection(tcp_c, (int)connections_number) == nullptr) {
+        return -1;
     }
 
-    return -1;
+    return (int)connections_number;
 }
 
 /** @brief Find the TCP connection to a relay with relay_pk.
@@ -701,9 +752,26 @@ int new_tcp_connection_to(TCP_Connections *tcp_c, const uint8_t *public_key, int
     memcpy(con_to->public_key, public_key, CRYPTO_PUBLIC_KEY_SIZE);
     con_to->id = id;
 
+    if (!pk_index_add(tcp_c->connections_by_pk, public_key, (uint32_t)connections_number)) {
+        wipe_connection(tcp_c, connections_number);
+        return -1;
+    }
+
     return connections_number;
 }
 
+int set_tcp_connection_to_object(TCP_Connections *tcp_c, int connections_number, void *object)
+{
+    TCP_Connection_to *con_to = get_connection(tcp_c, connections_number);
+
+    if (con_to == nullptr) {
+        return -1;
+    }
+
+    con_to->object = object;
+    return 0;
+}
+
 /**
  * @retval 0 on success.
  * @retval -1 on failure.
@@ -1190,7 +1258,8 @@ static int tcp_conn_data_callback(void *_Nonnull object, uint32_t number, uint8_
     }
 
     if (tcp_c->tcp_data_callback != nullptr) {
-        tcp_c->tcp_data_callback(tcp_c->tcp_data_callback_object, con_to->id, data, length, userdata);
+        void *callback_object = con_to->object != nullptr ? con_to->object : tcp_c->tcp_data_callback_object;
+        tcp_c->tcp_data_callback(callback_object, con_to->id, data, length, userdata);
     }
 
     return 0;
@@ -1637,6 +1706,13 @@ TCP_Connections *new_tcp_connections(const Logger *logger, const Memory *mem, co
         return nullptr;
     }
 
+    temp->connections_by_pk = pk_index_new(mem, rng);
+
+    if (temp->connections_by_pk == nullptr) {
+        mem_delete(mem, temp);
+        return nullptr;
+    }
+
     temp->net_profile = tcp_np;
     temp->logger = logger;
     temp->mem = mem;
@@ -1767,6 +1843,7 @@ void kill_tcp_connections(TCP_Connections *tcp_c)
 
     mem_delete(tcp_c->mem, tcp_c->tcp_connections);
     mem_delete(tcp_c->mem, tcp_c->connections);
+    pk_index_kill(tcp_c->connections_by_pk);
     mem_delete(tcp_c->mem, tcp_c);
 }
 
@@ -65,6 +65,7 @@ typedef struct TCP_Connection_to {
     TCP_Conn_to connections[MAX_FRIEND_TCP_CONNECTIONS];
 
     int id; /* id used in callbacks. */
+    void *_Nullable object; /* object for the data callback, if not the default one. */
 } TCP_Connection_to;
 
 typedef struct TCP_con {
@@ -87,6 +88,9 @@ const uint8_t *_Nonnull tcp_connections_public_key(const TCP_Connections *_Nonnu
 
 uint32_t tcp_connections_count(const TCP_Connections *_Nonnull tcp_c);
 
+/** @brief Call `cb` for the socket of every open TCP relay connection. */
+void tcp_connections_visit_sockets(const TCP_Connections *_Nonnull tcp_c, net_socket_visit_cb *_Nonnull cb, void *_Nonnull obj);
+
 /** @brief Returns the number of connected TCP relays. */
 uint32_t tcp_connected_relays_count(const TCP_Connections *_Nonnull tcp_c);
 
@@ -173,6 +177,11 @@ typedef int tcp_oob_cb(void *_Nonnull object, const uint8_t *_Nonnull public_key
 /** @brief Set the callback for TCP oob data packets. */
 void set_oob_packet_tcp_connection_callback(TCP_Connections *_Nonnull tcp_c, tcp_oob_cb *_Nonnull tcp_oob_callback, void *_Nonnull object);
 
+/** @brief Get the callbacks set above and their objects. */
+tcp_data_cb *_Nullable get_packet_tcp_connection_callback(const TCP_Connections *_Nonnull tcp_c, void *_Nullable *_Nonnull object);
+tcp_onion_cb *_Nullable get_onion_packet_tcp_connection_callback(const TCP_Connections *_Nonnull tcp_c, void *_Nullable *_Nonnull object);
+tcp_oob_cb *_Nullable get_oob_packet_tcp_connection_callback(const TCP_Connections *_Nonnull tcp_c, void *_Nullable *_Nonnull object);
+
 /** @brief Encode tcp_connections_number as a custom ip_port.
  *
  * return ip_port.
@@ -197,6 +206,17 @@ bool ip_port_to_tcp_connections_number(const IP_Port *_Nonnull ip_port, unsigned
  */
 int new_tcp_connection_to(TCP_Connections *_Nonnull tcp_c, const uint8_t *_Nonnull public_key, int id);
 
+/** @brief Set the object passed to the data callback for packets of this connection.
+ *
+ * Without one, the object given to set_packet_tcp_connection_callback is used.
+ * This lets several users share one TCP_Connections and tell their
+ * connections apart.
+ *
+ * @retval 0 on success.
+ * @retval -1 on failure.
+ */
+int set_tcp_connection_to_object(TCP_Connections *_Nonnull tcp_c, int connections_number, void *_Nullable object);
+
 /**
  * @retval 0 on success.
  * @retval -1 on failure.
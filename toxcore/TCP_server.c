@@ -13,8 +13,11 @@
 #include <sys/ioctl.h>
 #endif /* !WIN32 */
 
+#include <pthread.h>
+
 #ifdef TCP_SERVER_USE_EPOLL
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
 #endif /* TCP_SERVER_USE_EPOLL */
 
@@ -27,23 +30,50 @@
 #include "logger.h"
 #include "mem.h"
 #include "mono_time.h"
+#include "mpsc_queue.h"
 #include "net_profile.h"
 #include "network.h"
 #include "onion.h"
+#include "pk_index.h"
 
 #ifdef TCP_SERVER_USE_EPOLL
 #define TCP_SOCKET_LISTENING 0
 #define TCP_SOCKET_INCOMING 1
 #define TCP_SOCKET_UNCONFIRMED 2
 #define TCP_SOCKET_CONFIRMED 3
+#define TCP_SOCKET_WAKEUP 4
+#define TCP_SOCKET_STOP 5
 #endif /* TCP_SERVER_USE_EPOLL */
 
+/** @brief Bits of a connection id below the shard number.
+ *
+ * In threaded mode, connections are identified across shards by their
+ * location: the shard number in the top bits and the index into that shard's
+ * accepted_connection_array in the low bits. A single-threaded server is
+ * shard 0, so its connection ids are plain indices.
+ */
+#define TCP_SHARD_SHIFT 24
+#define TCP_SHARD_INDEX_MASK ((1U << TCP_SHARD_SHIFT) - 1)
+#define TCP_MAX_SHARDS 64
+
+/** How long an idle worker thread sleeps in epoll_wait, in milliseconds. */
+#define TCP_SHARD_WAIT_MS 500
+
+/** @brief Most messages an inbox holds before packets for it are dropped.
+ *
+ * A packet that can't go into a full inbox is dropped like one for a client
+ * whose send queue is full. Messages that change connection state are always
+ * queued: there is at most a handful of them per connection.
+ */
+#define TCP_SHARD_INBOX_SIZE 4096
+
 typedef struct TCP_Secure_Conn {
     uint8_t public_key[CRYPTO_PUBLIC_KEY_SIZE];
     uint32_t index;
     // TODO(iphydf): Add an enum for this (same as in TCP_client.c, probably).
     uint8_t status; /* 0 if not used, 1 if other is offline, 2 if other is online. */
     uint8_t other_id;
+    uint16_t shard; /* Shard holding `index`, if status is 2. Always 0 when single-threaded. */
 } TCP_Secure_Conn;
 
 typedef struct TCP_Secure_Connection {
@@ -95,6 +125,33 @@ struct TCP_Server {
 
     /* Network profile for all TCP server packets. */
     Net_Profile *_Nullable net_profile;
+
+    /* Send queue budget for each accepted connection. 0 means the default. */
+    uint32_t send_queue_budget;
+
+    /* Threaded mode. The server returned by new_tcp_server_threaded is the
+     * front: it owns the worker shards and the directory, and runs onion and
+     * forwarding requests on the caller's thread. Each shard is a complete TCP
+     * server with its own listening sockets and epoll set, run by its own
+     * thread. Everything that crosses threads goes through the inboxes. */
+    TCP_Server *_Nullable front;                /* Set in shards. */
+    TCP_Server *_Nullable *_Nullable shards;    /* Set in the front. */
+    uint16_t num_shards;
+    uint16_t shard_id;
+    Mpsc_Queue *_Nullable inbox;
+
+    /* Maps the public key of every accepted connection to its location. Front only. */
+    PK_Index *_Nullable directory;
+    pthread_mutex_t directory_lock;
+
+#ifdef TCP_SERVER_USE_EPOLL
+    int wake_fd;
+    int stop_fd; /* Written by the front to make a shard's thread exit. */
+    pthread_t thread;
+    bool thread_started;
+    bool stopping;
+    Mono_Time *_Nullable shard_mono_time;
+#endif /* TCP_SERVER_USE_EPOLL */
 };
 
 static_assert(sizeof(TCP_Server) < 7 * 1024 * 1024,
@@ -107,6 +164,10 @@ const uint8_t *tcp_server_public_key(const TCP_Server *tcp_server)
 
 size_t tcp_server_listen_count(const TCP_Server *tcp_server)
 {
+    if (tcp_server->shards != nullptr) {
+        return tcp_server->shards[0]->num_listening_socks;
+    }
+
     return tcp_server->num_listening_socks;
 }
 
@@ -130,6 +191,10 @@ static int alloc_new_connections(TCP_Server *_Nonnull tcp_server, uint32_t num)
         return -1;
     }
 
+    if (tcp_server->front != nullptr && new_size > TCP_SHARD_INDEX_MASK + 1) {
+        return -1;
+    }
+
     TCP_Secure_Connection *new_connections = (TCP_Secure_Connection *)mem_vrealloc(
                 tcp_server->mem, tcp_server->accepted_connection_array,
                 new_size, sizeof(TCP_Secure_Connection));
@@ -151,7 +216,7 @@ static int alloc_new_connections(TCP_Server *_Nonnull tcp_server, uint32_t num)
 static void wipe_secure_connection(TCP_Secure_Connection *_Nonnull con)
 {
     if (con->status != 0) {
-        wipe_priority_list(con->con.mem, con->con.priority_queue_start);
+        wipe_send_queue(&con->con);
         crypto_memzero(con, sizeof(TCP_Secure_Connection));
     }
 }
@@ -186,6 +251,161 @@ static int get_tcp_connection_index(const TCP_Server *_Nonnull tcp_server, const
     return bs_list_find(&tcp_server->accepted_key_list, public_key);
 }
 
+typedef enum TCP_Shard_Msg_Type {
+    /* Shard to shard: `src` wants to talk to `dst`, which is on the receiving shard. */
+    TCP_SHARD_MSG_ROUTE_REQUEST,
+    /* Shard to shard: reply to a route request, `dst` has linked its slot to `src`. */
+    TCP_SHARD_MSG_ROUTE_ACCEPT,
+    /* Shard to shard: data packet from a linked peer. */
+    TCP_SHARD_MSG_DATA,
+    /* Shard to shard: the peer in `src` is gone, unlink it. */
+    TCP_SHARD_MSG_DISCONNECT,
+    /* Shard to shard: OOB packet for the connection with public key `dst_pk`. */
+    TCP_SHARD_MSG_OOB,
+    /* Shard to shard: `dst_pk` has reconnected elsewhere, drop its old connection. */
+    TCP_SHARD_MSG_KILL,
+    /* Shard to front: onion request from `src`. */
+    TCP_SHARD_MSG_ONION_REQUEST,
+    /* Shard to front: forward request from `src` to `ip_port`. */
+    TCP_SHARD_MSG_FORWARD_REQUEST,
+    /* Front to shard: onion response for `dst`. */
+    TCP_SHARD_MSG_ONION_RESPONSE,
+    /* Front to shard: forwarded packet for `dst`. */
+    TCP_SHARD_MSG_FORWARDING,
+    /* Front to shard: new send queue budget in `identifier`. */
+    TCP_SHARD_MSG_SEND_QUEUE_BUDGET,
+} TCP_Shard_Msg_Type;
+
+/** @brief Header of a message between threads. The packet payload follows it.
+ *
+ * Messages never leave the process, so this is copied as a plain struct.
+ * Connections are named by location (see TCP_SHARD_SHIFT) and validated by
+ * the receiver, since they may have been killed and replaced in the meantime.
+ */
+typedef struct TCP_Shard_Msg {
+    uint8_t type;
+    uint8_t dst_slot;
+    uint8_t src_slot;
+    uint32_t dst;
+    uint32_t src;
+    uint64_t identifier;
+    uint8_t dst_pk[CRYPTO_PUBLIC_KEY_SIZE];
+    uint8_t src_pk[CRYPTO_PUBLIC_KEY_SIZE];
+    IP_Port ip_port;
+} TCP_Shard_Msg;
+
+static uint32_t tcp_shard_location(const TCP_Server *_Nonnull tcp_server, uint32_t index)
+{
+    return ((uint32_t)tcp_server->shard_id << TCP_SHARD_SHIFT) | index;
+}
+
+/** @brief The shard holding the connection at `location`, or null if there is no such shard. */
+static TCP_Server *tcp_shard_at(const TCP_Server *_Nonnull front, uint32_t location)
+{
+    const uint32_t shard_id = location >> TCP_SHARD_SHIFT;
+
+    if (shard_id >= front->num_shards) {
+        return nullptr;
+    }
+
+    return front->shards[shard_id];
+}
+
+/** @brief Whether `type` carries a packet, which may be dropped if the receiver is busy. */
+static bool tcp_shard_msg_is_packet(TCP_Shard_Msg_Type type)
+{
+    switch (type) {
+        case TCP_SHARD_MSG_DATA:
+        case TCP_SHARD_MSG_OOB:
+        case TCP_SHARD_MSG_ONION_REQUEST:
+        case TCP_SHARD_MSG_FORWARD_REQUEST:
+        case TCP_SHARD_MSG_ONION_RESPONSE:
+        case TCP_SHARD_MSG_FORWARDING:
+            return true;
+
+        case TCP_SHARD_MSG_ROUTE_REQUEST:
+        case TCP_SHARD_MSG_ROUTE_ACCEPT:
+        case TCP_SHARD_MSG_DISCONNECT:
+        case TCP_SHARD_MSG_KILL:
+        case TCP_SHARD_MSG_SEND_QUEUE_BUDGET:
+            return false;
+    }
+
+    return false;
+}
+
+/** @brief Put a message into the inbox of `dest`.
+ *
+ * Packets are refused once the inbox holds TCP_SHARD_INBOX_SIZE messages.
+ *
+ * @retval true on success.
+ * @retval false if the message was dropped.
+ */
+static bool tcp_shard_send(const TCP_Server *_Nonnull dest, const TCP_Shard_Msg *_Nonnull msg,
+                           const uint8_t *_Nullable payload, uint16_t length)
+{
+    uint8_t buf[sizeof(TCP_Shard_Msg) + MAX_PACKET_SIZE];
+
+    if (length > MAX_PACKET_SIZE) {
+        return false;
+    }
+
+    memcpy(buf, msg, sizeof(TCP_Shard_Msg));
+
+    if (length > 0) {
+        memcpy(buf + sizeof(TCP_Shard_Msg), payload, length);
+    }
+
+    if (tcp_shard_msg_is_packet((TCP_Shard_Msg_Type)msg->type)) {
+        return mpsc_queue_push_bounded(dest->inbox, buf, sizeof(TCP_Shard_Msg) + length, TCP_SHARD_INBOX_SIZE);
+    }
+
+    return mpsc_queue_push(dest->inbox, buf, sizeof(TCP_Shard_Msg) + length);
+}
+
+/** @brief Look up the location of the connection with `public_key` on any shard.
+ *
+ * @retval -1 if no shard has a connection with that key.
+ */
+static int64_t tcp_directory_get(TCP_Server *_Nonnull front, const uint8_t *_Nonnull public_key)
+{
+    pthread_mutex_lock(&front->directory_lock);
+    const int64_t location = pk_index_get(front->directory, public_key);
+    pthread_mutex_unlock(&front->directory_lock);
+    return location;
+}
+
+/** @brief Point `public_key` at `location`.
+ *
+ * @return the previous location of the key.
+ * @retval -1 if the key had no location.
+ */
+static int64_t tcp_directory_set(TCP_Server *_Nonnull front, const Logger *_Nonnull logger,
+                                 const uint8_t *_Nonnull public_key, uint32_t location)
+{
+    pthread_mutex_lock(&front->directory_lock);
+    const int64_t old_location = pk_index_get(front->directory, public_key);
+
+    if (!pk_index_add(front->directory, public_key, location)) {
+        LOGGER_ERROR(logger, "failed to add connection %08x to the TCP shard directory", location);
+    }
+
+    pthread_mutex_unlock(&front->directory_lock);
+    return old_location;
+}
+
+/** @brief Remove `public_key` from the directory, unless it was moved to another location. */
+static void tcp_directory_remove(TCP_Server *_Nonnull front, const uint8_t *_Nonnull public_key, uint32_t location)
+{
+    pthread_mutex_lock(&front->directory_lock);
+
+    if (pk_index_get(front->directory, public_key) == location) {
+        pk_index_remove(front->directory, public_key);
+    }
+
+    pthread_mutex_unlock(&front->directory_lock);
+}
+
 static int kill_accepted(TCP_Server *_Nonnull tcp_server, int index);
 
 /** @brief Add accepted TCP connection to the list.
@@ -234,6 +454,27 @@ static int add_accepted(TCP_Server *_Nonnull tcp_server, const Mono_Time *_Nonnu
     tcp_server->accepted_connection_array[index].last_pinged = mono_time_get(mono_time);
     tcp_server->accepted_connection_array[index].ping_id = 0;
     tcp_server->accepted_connection_array[index].con.net_profile = tcp_server->net_profile;
+    tcp_server->accepted_connection_array[index].con.send_queue_budget = tcp_server->send_queue_budget;
+
+    if (tcp_server->front != nullptr) {
+        /* Only one connection per public key may exist on the whole server. If
+         * the key was connected to another shard, that shard must drop it. */
+        const uint8_t *public_key = tcp_server->accepted_connection_array[index].public_key;
+        const int64_t old_location = tcp_directory_set(tcp_server->front, tcp_server->logger, public_key,
+                                     tcp_shard_location(tcp_server, index));
+
+        if (old_location != -1 && (uint32_t)old_location >> TCP_SHARD_SHIFT != tcp_server->shard_id) {
+            const TCP_Server *old_shard = tcp_shard_at(tcp_server->front, old_location);
+
+            if (old_shard != nullptr) {
+                TCP_Shard_Msg msg = {0};
+                msg.type = TCP_SHARD_MSG_KILL;
+                msg.dst = old_location;
+                memcpy(msg.dst_pk, public_key, CRYPTO_PUBLIC_KEY_SIZE);
+                tcp_shard_send(old_shard, &msg, nullptr, 0);
+            }
+        }
+    }
 
     return index;
 }
@@ -257,6 +498,11 @@ static int del_accepted(TCP_Server *_Nonnull tcp_server, int index)
         return -1;
     }
 
+    if (tcp_server->front != nullptr) {
+        tcp_directory_remove(tcp_server->front, tcp_server->accepted_connection_array[index].public_key,
+                             tcp_shard_location(tcp_server, index));
+    }
+
     wipe_secure_connection(&tcp_server->accepted_connection_array[index]);
     --tcp_server->num_accepted_connections;
 
@@ -422,6 +668,35 @@ static int send_disconnect_notification(const Logger *_Nonnull logger, TCP_Secur
     return write_packet_tcp_secure_connection(logger, &con->con, data, sizeof(data), true);
 }
 
+/** @brief Ask the shard holding `public_key`, if any, to link it with `slot` of connection `con_id`. */
+static void tcp_shard_route_request(TCP_Server *_Nonnull tcp_server, uint32_t con_id, uint8_t slot, const uint8_t *_Nonnull public_key)
+{
+    if (tcp_server->front == nullptr) {
+        return;
+    }
+
+    const int64_t location = tcp_directory_get(tcp_server->front, public_key);
+
+    if (location == -1 || (uint32_t)location >> TCP_SHARD_SHIFT == tcp_server->shard_id) {
+        return;
+    }
+
+    const TCP_Server *other_shard = tcp_shard_at(tcp_server->front, location);
+
+    if (other_shard == nullptr) {
+        return;
+    }
+
+    TCP_Shard_Msg msg = {0};
+    msg.type = TCP_SHARD_MSG_ROUTE_REQUEST;
+    msg.dst = location;
+    memcpy(msg.dst_pk, public_key, CRYPTO_PUBLIC_KEY_SIZE);
+    msg.src = tcp_shard_location(tcp_server, con_id);
+    msg.src_slot = slot;
+    memcpy(msg.src_pk, tcp_server->accepted_connection_array[con_id].public_key, CRYPTO_PUBLIC_KEY_SIZE);
+    tcp_shard_send(other_shard, &msg, nullptr, 0);
+}
+
 /**
  * @retval 0 on success.
  * @retval -1 on failure (connection must be killed).
@@ -492,13 +767,17 @@ static int handle_tcp_routing_req(TCP_Server *_Nonnull tcp_server, uint32_t con_
             con->connections[index].status = 2;
             con->connections[index].index = other_index;
             con->connections[index].other_id = other_id;
+            con->connections[index].shard = tcp_server->shard_id;
             other_conn->connections[other_id].status = 2;
             other_conn->connections[other_id].index = con_id;
             other_conn->connections[other_id].other_id = index;
+            other_conn->connections[other_id].shard = tcp_server->shard_id;
             // TODO(irungentoo): return values?
             send_connect_notification(tcp_server->logger, con, index);
             send_connect_notification(tcp_server->logger, other_conn, other_id);
         }
+    } else {
+        tcp_shard_route_request(tcp_server, con_id, index, public_key);
     }
 
     return 0;
@@ -526,11 +805,42 @@ static int handle_tcp_oob_send(TCP_Server *_Nonnull tcp_server, uint32_t con_id,
         memcpy(resp_packet + 1 + CRYPTO_PUBLIC_KEY_SIZE, data, length);
         write_packet_tcp_secure_connection(tcp_server->logger, &tcp_server->accepted_connection_array[other_index].con,
                                            resp_packet, resp_packet_size, false);
+    } else if (tcp_server->front != nullptr) {
+        const int64_t location = tcp_directory_get(tcp_server->front, public_key);
+        const TCP_Server *other_shard = location != -1 ? tcp_shard_at(tcp_server->front, location) : nullptr;
+
+        if (other_shard != nullptr && other_shard != tcp_server) {
+            TCP_Shard_Msg msg = {0};
+            msg.type = TCP_SHARD_MSG_OOB;
+            memcpy(msg.dst_pk, public_key, CRYPTO_PUBLIC_KEY_SIZE);
+            memcpy(msg.src_pk, con->public_key, CRYPTO_PUBLIC_KEY_SIZE);
+            tcp_shard_send(other_shard, &msg, data, length);
+        }
     }
 
     return 0;
 }
 
+/** @brief Tell the shard holding the peer linked to `con_number` of `con` that the link is gone. */
+static void tcp_shard_unlink(TCP_Server *_Nonnull tcp_server, const TCP_Secure_Connection *_Nonnull con, uint8_t con_number)
+{
+    const TCP_Secure_Conn *link = &con->connections[con_number];
+    const uint32_t location = ((uint32_t)link->shard << TCP_SHARD_SHIFT) | link->index;
+    const TCP_Server *other_shard = tcp_server->front != nullptr ? tcp_shard_at(tcp_server->front, location) : nullptr;
+
+    if (other_shard == nullptr) {
+        return;
+    }
+
+    TCP_Shard_Msg msg = {0};
+    msg.type = TCP_SHARD_MSG_DISCONNECT;
+    msg.dst = location;
+    msg.dst_slot = link->other_id;
+    msg.src = tcp_shard_location(tcp_server, (uint32_t)(con - tcp_server->accepted_connection_array));
+    msg.src_slot = con_number;
+    tcp_shard_send(other_shard, &msg, nullptr, 0);
+}
+
 /** @brief Remove connection with con_number from the connections array of con.
  *
  * return -1 on failure.
@@ -547,20 +857,25 @@ static int rm_connection_index(TCP_Server *tcp_server, TCP_Secure_Connection *co
             const uint32_t index = con->connections[con_number].index;
             const uint8_t other_id = con->connections[con_number].other_id;
 
-            if (index >= tcp_server->size_accepted_connections) {
-                return -1;
-            }
+            if (con->connections[con_number].shard != tcp_server->shard_id) {
+                tcp_shard_unlink(tcp_server, con, con_number);
+            } else {
+                if (index >= tcp_server->size_accepted_connections) {
+                    return -1;
+                }
 
-            tcp_server->accepted_connection_array[index].connections[other_id].other_id = 0;
-            tcp_server->accepted_connection_array[index].connections[other_id].index = 0;
-            tcp_server->accepted_connection_array[index].connections[other_id].status = 1;
-            // TODO(irungentoo): return values?
-            send_disconnect_notification(tcp_server->logger, &tcp_server->accepted_connection_array[index], other_id);
+                tcp_server->accepted_connection_array[index].connections[other_id].other_id = 0;
+                tcp_server->accepted_connection_array[index].connections[other_id].index = 0;
+                tcp_server->accepted_connection_array[index].connections[other_id].status = 1;
+                // TODO(irungentoo): return values?
+                send_disconnect_notification(tcp_server->logger, &tcp_server->accepted_connection_array[index], other_id);
+            }
         }
 
         con->connections[con_number].index = 0;
         con->connections[con_number].other_id = 0;
         con->connections[con_number].status = 0;
+        con->connections[con_number].shard = 0;
         return 0;
     }
 
@@ -581,37 +896,61 @@ static IP_Port con_id_to_ip_port(uint32_t con_id, uint64_t identifier)
 
 }
 
-/** @brief Decode ip_port created by con_id_to_ip_port to con_id.
+/** @brief Send an onion response or forwarded packet to the client at `con_id`.
+ *
+ * The packet is dropped if the connection has been replaced since `identifier`
+ * was handed out.
  *
  * @retval true on success.
- * @retval false if ip_port is invalid.
+ * @retval false if the connection is gone or the packet could not be sent.
  */
-static bool ip_port_to_con_id(const TCP_Server *_Nonnull tcp_server, const IP_Port *_Nonnull ip_port, uint32_t *_Nonnull con_id)
+static bool send_to_client(TCP_Server *_Nonnull tcp_server, uint32_t con_id, uint64_t identifier,
+                           uint8_t packet_id, const uint8_t *_Nonnull data, uint16_t length)
 {
-    *con_id = ip_port->ip.ip.v6.uint32[0];
+    if (tcp_server->shards != nullptr) {
+        const TCP_Server *shard = tcp_shard_at(tcp_server, con_id);
+
+        if (shard == nullptr) {
+            return false;
+        }
+
+        TCP_Shard_Msg msg = {0};
+        msg.type = packet_id == TCP_PACKET_ONION_RESPONSE ? TCP_SHARD_MSG_ONION_RESPONSE : TCP_SHARD_MSG_FORWARDING;
+        msg.dst = con_id;
+        msg.identifier = identifier;
+        return tcp_shard_send(shard, &msg, data, length);
+    }
+
+    if (con_id >= tcp_server->size_accepted_connections) {
+        return false;
+    }
+
+    TCP_Secure_Connection *con = &tcp_server->accepted_connection_array[con_id];
+
+    if (con->identifier != identifier) {
+        return false;
+    }
+
+    const uint16_t packet_size = 1 + length;
+    VLA(uint8_t, packet, packet_size);
+    memcpy(packet + 1, data, length);
+    packet[0] = packet_id;
 
-    return net_family_is_tcp_client(ip_port->ip.family) &&
-           *con_id < tcp_server->size_accepted_connections &&
-           tcp_server->accepted_connection_array[*con_id].identifier == ip_port->ip.ip.v6.uint64[1];
+    return write_packet_tcp_secure_connection(tcp_server->logger, &con->con, packet, packet_size, false) == 1;
 }
 
 static int handle_onion_recv_1(void *_Nonnull object, const IP_Port *_Nonnull dest, const uint8_t *_Nonnull data, uint16_t length)
 {
     TCP_Server *tcp_server = (TCP_Server *)object;
-    uint32_t index;
 
-    if (!ip_port_to_con_id(tcp_server, dest, &index)) {
+    if (!net_family_is_tcp_client(dest->ip.family)) {
         return 1;
     }
 
-    TCP_Secure_Connection *con = &tcp_server->accepted_connection_array[index];
-
-    const uint16_t packet_size = 1 + length;
-    VLA(uint8_t, packet, packet_size);
-    memcpy(packet + 1, data, length);
-    packet[0] = TCP_PACKET_ONION_RESPONSE;
+    const uint32_t con_id = dest->ip.ip.v6.uint32[0];
+    const uint64_t identifier = dest->ip.ip.v6.uint64[1];
 
-    if (write_packet_tcp_secure_connection(tcp_server->logger, &con->con, packet, packet_size, false) != 1) {
+    if (!send_to_client(tcp_server, con_id, identifier, TCP_PACKET_ONION_RESPONSE, data, length)) {
         return 1;
     }
 
@@ -635,22 +974,49 @@ static bool handle_forward_reply_tcp(void *_Nonnull object, const uint8_t *_Nonn
     net_unpack_u32(sendback_data + 1, &con_id);
     net_unpack_u64(sendback_data + 1 + sizeof(uint32_t), &identifier);
 
-    if (con_id >= tcp_server->size_accepted_connections) {
-        return false;
-    }
+    return send_to_client(tcp_server, con_id, identifier, TCP_PACKET_FORWARDING, data, length);
+}
 
-    TCP_Secure_Connection *con = &tcp_server->accepted_connection_array[con_id];
+/**
+ * @retval 0 on success.
+ * @retval -1 on failure (connection must be killed).
+ */
+static int tcp_shard_onion_request(TCP_Server *_Nonnull tcp_server, uint32_t con_id, const uint8_t *_Nonnull data, uint16_t length)
+{
+    if (tcp_server->front->onion == nullptr) {
+        return 0;
+    }
 
-    if (con->identifier != identifier) {
-        return false;
+    if (length <= 1 + CRYPTO_NONCE_SIZE + ONION_SEND_BASE * 2) {
+        return -1;
     }
 
-    const uint16_t packet_size = 1 + length;
-    VLA(uint8_t, packet, packet_size);
-    memcpy(packet + 1, data, length);
-    packet[0] = TCP_PACKET_FORWARDING;
+    TCP_Shard_Msg msg = {0};
+    msg.type = TCP_SHARD_MSG_ONION_REQUEST;
+    msg.src = tcp_shard_location(tcp_server, con_id);
+    msg.identifier = tcp_server->accepted_connection_array[con_id].identifier;
+    tcp_shard_send(tcp_server->front, &msg, data + 1, length - 1);
+    return 0;
+}
 
-    return write_packet_tcp_secure_connection(tcp_server->logger, &con->con, packet, packet_size, false) == 1;
+/** @brief Pass a data packet from slot `c_id` of connection `con_id` to the linked peer on another shard. */
+static void tcp_shard_relay(TCP_Server *_Nonnull tcp_server, uint32_t con_id, uint8_t c_id, const uint8_t *_Nonnull data, uint16_t length)
+{
+    const TCP_Secure_Conn *link = &tcp_server->accepted_connection_array[con_id].connections[c_id];
+    const uint32_t location = ((uint32_t)link->shard << TCP_SHARD_SHIFT) | link->index;
+    const TCP_Server *other_shard = tcp_shard_at(tcp_server->front, location);
+
+    if (other_shard == nullptr) {
+        return;
+    }
+
+    TCP_Shard_Msg msg = {0};
+    msg.type = TCP_SHARD_MSG_DATA;
+    msg.dst = location;
+    msg.dst_slot = link->other_id;
+    msg.src = tcp_shard_location(tcp_server, con_id);
+    msg.src_slot = c_id;
+    tcp_shard_send(other_shard, &msg, data, length);
 }
 
 /**
@@ -743,6 +1109,10 @@ static int handle_tcp_packet(TCP_Server *_Nonnull tcp_server, uint32_t con_id, c
         case TCP_PACKET_ONION_REQUEST: {
             LOGGER_TRACE(tcp_server->logger, "handling onion request for %u", con_id);
 
+            if (tcp_server->front != nullptr) {
+                return tcp_shard_onion_request(tcp_server, con_id, data, length);
+            }
+
             if (tcp_server->onion != nullptr) {
                 if (length <= 1 + CRYPTO_NONCE_SIZE + ONION_SEND_BASE * 2) {
                     return -1;
@@ -762,7 +1132,9 @@ static int handle_tcp_packet(TCP_Server *_Nonnull tcp_server, uint32_t con_id, c
         }
 
         case TCP_PACKET_FORWARD_REQUEST: {
-            if (tcp_server->forwarding == nullptr) {
+            const Forwarding *forwarding = tcp_server->front != nullptr ? tcp_server->front->forwarding : tcp_server->forwarding;
+
+            if (forwarding == nullptr) {
                 return -1;
             }
 
@@ -786,6 +1158,16 @@ static int handle_tcp_packet(TCP_Server *_Nonnull tcp_server, uint32_t con_id, c
                 return -1;
             }
 
+            if (tcp_server->front != nullptr) {
+                TCP_Shard_Msg msg = {0};
+                msg.type = TCP_SHARD_MSG_FORWARD_REQUEST;
+                msg.src = tcp_shard_location(tcp_server, con_id);
+                msg.identifier = con->identifier;
+                msg.ip_port = dest;
+                tcp_shard_send(tcp_server->front, &msg, forward_data, forward_data_len);
+                return 0;
+            }
+
             send_forwarding(tcp_server->forwarding, &dest, sendback_data, sendback_data_len, forward_data, forward_data_len);
             return 0;
         }
@@ -814,6 +1196,11 @@ static int handle_tcp_packet(TCP_Server *_Nonnull tcp_server, uint32_t con_id, c
                 return 0;
             }
 
+            if (con->connections[c_id].shard != tcp_server->shard_id) {
+                tcp_shard_relay(tcp_server, con_id, c_id, data, length);
+                return 0;
+            }
+
             const uint32_t index = con->connections[c_id].index;
             const uint8_t other_c_id = con->connections[c_id].other_id + NUM_RESERVED_PORTS;
             VLA(uint8_t, new_data, length);
@@ -833,155 +1220,435 @@ static int handle_tcp_packet(TCP_Server *_Nonnull tcp_server, uint32_t con_id, c
     return 0;
 }
 
-static int confirm_tcp_connection(TCP_Server *_Nonnull tcp_server, const Mono_Time *_Nonnull mono_time, TCP_Secure_Connection *_Nonnull con, const uint8_t *_Nonnull data, uint16_t length)
+/** @brief The confirmed connection at `location` on this shard, or null. */
+static TCP_Secure_Connection *tcp_shard_connection(TCP_Server *_Nonnull tcp_server, uint32_t location)
 {
-    const int index = add_accepted(tcp_server, mono_time, con);
+    const uint32_t index = location & TCP_SHARD_INDEX_MASK;
 
-    if (index == -1) {
-        LOGGER_DEBUG(tcp_server->logger, "dropping connection %u: not accepted", (unsigned int)con->identifier);
-        kill_tcp_secure_connection(con);
-        return -1;
+    if (location >> TCP_SHARD_SHIFT != tcp_server->shard_id || index >= tcp_server->size_accepted_connections) {
+        return nullptr;
     }
 
-    wipe_secure_connection(con);
+    TCP_Secure_Connection *con = &tcp_server->accepted_connection_array[index];
 
-    if (handle_tcp_packet(tcp_server, index, data, length) == -1) {
-        LOGGER_DEBUG(tcp_server->logger, "dropping connection %u: data packet (len=%d) not handled",
-                     (unsigned int)con->identifier, length);
-        kill_accepted(tcp_server, index);
-        return -1;
+    if (con->status != TCP_STATUS_CONFIRMED) {
+        return nullptr;
     }
 
-    return index;
+    return con;
 }
 
-/**
- * @return index on success
- * @retval -1 on failure
- */
-static int accept_connection(TCP_Server *_Nonnull tcp_server, Socket sock)
+/** @brief Whether `link` points at slot `slot` of the connection at `location`. */
+static bool tcp_shard_is_linked(const TCP_Secure_Conn *_Nonnull link, uint32_t location, uint8_t slot)
 {
-    if (!sock_valid(sock)) {
-        return -1;
-    }
+    return link->status == 2
+           && link->shard == location >> TCP_SHARD_SHIFT
+           && link->index == (location & TCP_SHARD_INDEX_MASK)
+           && link->other_id == slot;
+}
 
-    if (!set_socket_nonblock(tcp_server->ns, sock)) {
-        kill_sock(tcp_server->ns, sock);
-        return -1;
-    }
+static void tcp_shard_link(TCP_Secure_Conn *_Nonnull link, uint32_t location, uint8_t slot)
+{
+    link->status = 2;
+    link->shard = location >> TCP_SHARD_SHIFT;
+    link->index = location & TCP_SHARD_INDEX_MASK;
+    link->other_id = slot;
+}
 
-    if (!set_socket_nosigpipe(tcp_server->ns, sock)) {
-        kill_sock(tcp_server->ns, sock);
-        return -1;
+static void tcp_shard_handle_route_request(TCP_Server *_Nonnull tcp_server, const TCP_Shard_Msg *_Nonnull msg)
+{
+    TCP_Secure_Connection *con = tcp_shard_connection(tcp_server, msg->dst);
+
+    if (con == nullptr || !pk_equal(con->public_key, msg->dst_pk)) {
+        return;
     }
 
-    const uint16_t index = tcp_server->incoming_connection_queue_index % MAX_INCOMING_CONNECTIONS;
+    for (uint32_t i = 0; i < NUM_CLIENT_CONNECTIONS; ++i) {
+        TCP_Secure_Conn *link = &con->connections[i];
 
-    TCP_Secure_Connection *conn = &tcp_server->incoming_connection_queue[index];
+        if (link->status == 0 || !pk_equal(link->public_key, msg->src_pk)) {
+            continue;
+        }
 
-    if (conn->status != TCP_STATUS_NO_STATUS) {
-        LOGGER_DEBUG(tcp_server->logger, "connection %d dropped before accepting", index);
-        kill_tcp_secure_connection(conn);
-    }
+        /* A link to another location of the same key is stale: that
+         * connection has been replaced and its shard is dropping it. */
+        if (!tcp_shard_is_linked(link, msg->src, msg->src_slot)) {
+            tcp_shard_link(link, msg->src, msg->src_slot);
+            send_connect_notification(tcp_server->logger, con, i);
+        }
 
-    conn->status = TCP_STATUS_CONNECTED;
-    conn->con.ns = tcp_server->ns;
-    conn->con.mem = tcp_server->mem;
-    conn->con.rng = tcp_server->rng;
-    conn->con.sock = sock;
-    conn->next_packet_length = 0;
+        const TCP_Server *other_shard = tcp_shard_at(tcp_server->front, msg->src);
+
+        if (other_shard != nullptr) {
+            TCP_Shard_Msg reply = {0};
+            reply.type = TCP_SHARD_MSG_ROUTE_ACCEPT;
+            reply.dst = msg->src;
+            reply.dst_slot = msg->src_slot;
+            memcpy(reply.dst_pk, msg->src_pk, CRYPTO_PUBLIC_KEY_SIZE);
+            reply.src = msg->dst;
+            reply.src_slot = i;
+            memcpy(reply.src_pk, con->public_key, CRYPTO_PUBLIC_KEY_SIZE);
+            tcp_shard_send(other_shard, &reply, nullptr, 0);
+        }
 
-    ++tcp_server->incoming_connection_queue_index;
-    return index;
+        return;
+    }
 }
 
-static Socket new_listening_tcp_socket(const Logger *_Nonnull logger, const Memory *_Nonnull mem, const Network *_Nonnull ns, Family family, uint16_t port)
+static void tcp_shard_handle_route_accept(TCP_Server *_Nonnull tcp_server, const TCP_Shard_Msg *_Nonnull msg)
 {
-    const Socket sock = net_socket(ns, family, TOX_SOCK_STREAM, TOX_PROTO_TCP);
+    TCP_Secure_Connection *con = tcp_shard_connection(tcp_server, msg->dst);
 
-    if (!sock_valid(sock)) {
-        LOGGER_ERROR(logger, "TCP socket creation failed (family = %d)", family.value);
-        return net_invalid_socket();
+    if (con == nullptr || !pk_equal(con->public_key, msg->dst_pk) || msg->dst_slot >= NUM_CLIENT_CONNECTIONS) {
+        return;
     }
 
-    bool ok = set_socket_nonblock(ns, sock);
+    TCP_Secure_Conn *link = &con->connections[msg->dst_slot];
 
-    if (ok && net_family_is_ipv6(family)) {
-        ok = set_socket_dualstack(ns, sock);
+    if (link->status == 0 || !pk_equal(link->public_key, msg->src_pk)) {
+        /* The client dropped the route while the request was in flight. The
+         * peer has already linked its side, so unlink it again. */
+        const TCP_Server *other_shard = tcp_shard_at(tcp_server->front, msg->src);
+
+        if (other_shard != nullptr) {
+            TCP_Shard_Msg reply = {0};
+            reply.type = TCP_SHARD_MSG_DISCONNECT;
+            reply.dst = msg->src;
+            reply.dst_slot = msg->src_slot;
+            reply.src = msg->dst;
+            reply.src_slot = msg->dst_slot;
+            tcp_shard_send(other_shard, &reply, nullptr, 0);
+        }
+
+        return;
     }
 
-    if (ok) {
-        ok = set_socket_reuseaddr(ns, sock);
+    if (tcp_shard_is_linked(link, msg->src, msg->src_slot)) {
+        return;
     }
 
-    ok = ok && bind_to_port(ns, sock, family, port) && (net_listen(ns, sock, TCP_MAX_BACKLOG) == 0);
+    tcp_shard_link(link, msg->src, msg->src_slot);
+    send_connect_notification(tcp_server->logger, con, msg->dst_slot);
+}
 
-    if (!ok) {
-        Net_Strerror error_str;
-        LOGGER_WARNING(logger, "could not bind to TCP port %d (family = %d): %s",
-                       port, family.value, net_strerror(net_error(), &error_str));
-        kill_sock(ns, sock);
-        return net_invalid_socket();
+static void tcp_shard_handle_data(TCP_Server *_Nonnull tcp_server, const TCP_Shard_Msg *_Nonnull msg, uint8_t *_Nonnull data, uint16_t length)
+{
+    TCP_Secure_Connection *con = tcp_shard_connection(tcp_server, msg->dst);
+
+    if (con == nullptr || length == 0 || msg->dst_slot >= NUM_CLIENT_CONNECTIONS
+            || !tcp_shard_is_linked(&con->connections[msg->dst_slot], msg->src, msg->src_slot)) {
+        return;
     }
 
-    LOGGER_DEBUG(logger, "successfully bound to TCP port %d", port);
-    return sock;
+    data[0] = msg->dst_slot + NUM_RESERVED_PORTS;
+    write_packet_tcp_secure_connection(tcp_server->logger, &con->con, data, length, false);
 }
 
-TCP_Server *new_tcp_server(const Logger *logger, const Memory *mem, const Random *rng, const Network *ns,
-                           bool ipv6_enabled, uint16_t num_sockets,
-                           const uint16_t *ports, const uint8_t *secret_key, Onion *onion, Forwarding *forwarding)
+static void tcp_shard_handle_disconnect(TCP_Server *_Nonnull tcp_server, const TCP_Shard_Msg *_Nonnull msg)
 {
-    if (num_sockets == 0 || ports == nullptr) {
-        LOGGER_ERROR(logger, "no sockets");
-        return nullptr;
+    TCP_Secure_Connection *con = tcp_shard_connection(tcp_server, msg->dst);
+
+    if (con == nullptr || msg->dst_slot >= NUM_CLIENT_CONNECTIONS
+            || !tcp_shard_is_linked(&con->connections[msg->dst_slot], msg->src, msg->src_slot)) {
+        return;
     }
 
-    if (ns == nullptr) {
-        LOGGER_ERROR(logger, "NULL network");
-        return nullptr;
+    TCP_Secure_Conn *link = &con->connections[msg->dst_slot];
+    link->status = 1;
+    link->shard = 0;
+    link->index = 0;
+    link->other_id = 0;
+    send_disconnect_notification(tcp_server->logger, con, msg->dst_slot);
+}
+
+static void tcp_shard_handle_oob(TCP_Server *_Nonnull tcp_server, const TCP_Shard_Msg *_Nonnull msg, const uint8_t *_Nonnull data, uint16_t length)
+{
+    const int index = get_tcp_connection_index(tcp_server, msg->dst_pk);
+
+    if (index == -1 || length == 0 || length > TCP_MAX_OOB_DATA_LENGTH) {
+        return;
     }
 
-    TCP_Server *temp = (TCP_Server *)mem_alloc(mem, sizeof(TCP_Server));
+    const uint16_t packet_size = 1 + CRYPTO_PUBLIC_KEY_SIZE + length;
+    VLA(uint8_t, packet, packet_size);
+    packet[0] = TCP_PACKET_OOB_RECV;
+    memcpy(packet + 1, msg->src_pk, CRYPTO_PUBLIC_KEY_SIZE);
+    memcpy(packet + 1 + CRYPTO_PUBLIC_KEY_SIZE, data, length);
+    write_packet_tcp_secure_connection(tcp_server->logger, &tcp_server->accepted_connection_array[index].con,
+                                       packet, packet_size, false);
+}
 
-    if (temp == nullptr) {
-        LOGGER_ERROR(logger, "TCP server allocation failed");
-        return nullptr;
+static void tcp_shard_handle_kill(TCP_Server *_Nonnull tcp_server, const TCP_Shard_Msg *_Nonnull msg)
+{
+    const TCP_Secure_Connection *con = tcp_shard_connection(tcp_server, msg->dst);
+
+    if (con != nullptr && pk_equal(con->public_key, msg->dst_pk)) {
+        LOGGER_TRACE(tcp_server->logger, "connection %08x reconnected on another shard", msg->dst);
+        kill_accepted(tcp_server, msg->dst & TCP_SHARD_INDEX_MASK);
+    }
+}
+
+/** @brief Handle an onion or forward request from a shard, on the front's thread. */
+static void tcp_front_handle_request(TCP_Server *_Nonnull tcp_server, const TCP_Shard_Msg *_Nonnull msg, const uint8_t *_Nonnull data, uint16_t length)
+{
+    if (msg->type == TCP_SHARD_MSG_ONION_REQUEST) {
+        if (tcp_server->onion == nullptr || length <= CRYPTO_NONCE_SIZE) {
+            return;
+        }
+
+        const IP_Port source = con_id_to_ip_port(msg->src, msg->identifier);
+        onion_send_1(tcp_server->onion, data + CRYPTO_NONCE_SIZE, length - CRYPTO_NONCE_SIZE, &source, data);
+        return;
+    }
+
+    if (tcp_server->forwarding == nullptr) {
+        return;
+    }
+
+    uint8_t sendback_data[1 + sizeof(uint32_t) + sizeof(uint64_t)];
+    sendback_data[0] = SENDBACK_TCP;
+    net_pack_u32(sendback_data + 1, msg->src);
+    net_pack_u64(sendback_data + 1 + sizeof(uint32_t), msg->identifier);
+
+    send_forwarding(tcp_server->forwarding, &msg->ip_port, sendback_data, sizeof(sendback_data), data, length);
+}
+
+/** @brief Set the send queue budget for this server's current and future connections. */
+static void tcp_server_apply_send_queue_budget(TCP_Server *_Nonnull tcp_server, uint32_t budget)
+{
+    tcp_server->send_queue_budget = budget;
+
+    for (uint32_t i = 0; i < tcp_server->size_accepted_connections; ++i) {
+        tcp_server->accepted_connection_array[i].con.send_queue_budget = budget;
+    }
+}
+
+/** @brief Handle up to `max_messages` messages from other threads. */
+static void tcp_server_handle_inbox(TCP_Server *_Nonnull tcp_server, uint32_t max_messages)
+{
+    uint8_t buf[sizeof(TCP_Shard_Msg) + MAX_PACKET_SIZE];
+
+    for (uint32_t i = 0; i < max_messages; ++i) {
+        const int len = mpsc_queue_pop(tcp_server->inbox, buf, sizeof(buf));
+
+        if (len == -1) {
+            break;
+        }
+
+        if ((size_t)len < sizeof(TCP_Shard_Msg)) {
+            continue;
+        }
+
+        TCP_Shard_Msg msg;
+        memcpy(&msg, buf, sizeof(msg));
+        uint8_t *const data = buf + sizeof(TCP_Shard_Msg);
+        const uint16_t length = (uint16_t)(len - sizeof(TCP_Shard_Msg));
+
+        switch ((TCP_Shard_Msg_Type)msg.type) {
+            case TCP_SHARD_MSG_ROUTE_REQUEST: {
+                tcp_shard_handle_route_request(tcp_server, &msg);
+                break;
+            }
+
+            case TCP_SHARD_MSG_ROUTE_ACCEPT: {
+                tcp_shard_handle_route_accept(tcp_server, &msg);
+                break;
+            }
+
+            case TCP_SHARD_MSG_DATA: {
+                tcp_shard_handle_data(tcp_server, &msg, data, length);
+                break;
+            }
+
+            case TCP_SHARD_MSG_DISCONNECT: {
+                tcp_shard_handle_disconnect(tcp_server, &msg);
+                break;
+            }
+
+            case TCP_SHARD_MSG_OOB: {
+                tcp_shard_handle_oob(tcp_server, &msg, data, length);
+                break;
+            }
+
+            case TCP_SHARD_MSG_KILL: {
+                tcp_shard_handle_kill(tcp_server, &msg);
+                break;
+            }
+
+            case TCP_SHARD_MSG_ONION_REQUEST:
+            case TCP_SHARD_MSG_FORWARD_REQUEST: {
+                tcp_front_handle_request(tcp_server, &msg, data, length);
+                break;
+            }
+
+            case TCP_SHARD_MSG_ONION_RESPONSE: {
+                send_to_client(tcp_server, msg.dst & TCP_SHARD_INDEX_MASK, msg.identifier, TCP_PACKET_ONION_RESPONSE, data, length);
+                break;
+            }
+
+            case TCP_SHARD_MSG_FORWARDING: {
+                send_to_client(tcp_server, msg.dst & TCP_SHARD_INDEX_MASK, msg.identifier, TCP_PACKET_FORWARDING, data, length);
+                break;
+            }
+
+            case TCP_SHARD_MSG_SEND_QUEUE_BUDGET: {
+                tcp_server_apply_send_queue_budget(tcp_server, (uint32_t)msg.identifier);
+                break;
+            }
+        }
+    }
+}
+
+static int confirm_tcp_connection(TCP_Server *_Nonnull tcp_server, const Mono_Time *_Nonnull mono_time, TCP_Secure_Connection *_Nonnull con, const uint8_t *_Nonnull data, uint16_t length)
+{
+    const int index = add_accepted(tcp_server, mono_time, con);
+
+    if (index == -1) {
+        LOGGER_DEBUG(tcp_server->logger, "dropping connection %u: not accepted", (unsigned int)con->identifier);
+        kill_tcp_secure_connection(con);
+        return -1;
+    }
+
+    wipe_secure_connection(con);
+
+    if (handle_tcp_packet(tcp_server, index, data, length) == -1) {
+        LOGGER_DEBUG(tcp_server->logger, "dropping connection %u: data packet (len=%d) not handled",
+                     (unsigned int)con->identifier, length);
+        kill_accepted(tcp_server, index);
+        return -1;
+    }
+
+    return index;
+}
+
+/**
+ * @return index on success
+ * @retval -1 on failure
+ */
+static int accept_connection(TCP_Server *_Nonnull tcp_server, Socket sock)
+{
+    if (!sock_valid(sock)) {
+        return -1;
+    }
+
+    if (!set_socket_nonblock(tcp_server->ns, sock)) {
+        kill_sock(tcp_server->ns, sock);
+        return -1;
+    }
+
+    if (!set_socket_nosigpipe(tcp_server->ns, sock)) {
+        kill_sock(tcp_server->ns, sock);
+        return -1;
+    }
+
+    const uint16_t index = tcp_server->incoming_connection_queue_index % MAX_INCOMING_CONNECTIONS;
+
+    TCP_Secure_Connection *conn = &tcp_server->incoming_connection_queue[index];
+
+    if (conn->status != TCP_STATUS_NO_STATUS) {
+        LOGGER_DEBUG(tcp_server->logger, "connection %d dropped before accepting", index);
+        kill_tcp_secure_connection(conn);
+    }
+
+    conn->status = TCP_STATUS_CONNECTED;
+    conn->con.ns = tcp_server->ns;
+    conn->con.mem = tcp_server->mem;
+    conn->con.rng = tcp_server->rng;
+    conn->con.sock = sock;
+    conn->con.sock_id = random_u64(tcp_server->rng);
+    conn->next_packet_length = 0;
+
+    ++tcp_server->incoming_connection_queue_index;
+    return index;
+}
+
+static Socket new_listening_tcp_socket(const Logger *_Nonnull logger, const Memory *_Nonnull mem, const Network *_Nonnull ns, Family family, uint16_t port, bool reuseport)
+{
+    const Socket sock = net_socket(ns, family, TOX_SOCK_STREAM, TOX_PROTO_TCP);
+
+    if (!sock_valid(sock)) {
+        LOGGER_ERROR(logger, "TCP socket creation failed (family = %d)", family.value);
+        return net_invalid_socket();
+    }
+
+    bool ok = set_socket_nonblock(ns, sock);
+
+    if (ok && net_family_is_ipv6(family)) {
+        ok = set_socket_dualstack(ns, sock);
+    }
+
+    if (ok) {
+        ok = set_socket_reuseaddr(ns, sock);
+    }
+
+    if (ok && reuseport) {
+        ok = set_socket_reuseport(ns, sock);
+    }
+
+    ok = ok && bind_to_port(ns, sock, family, port) && (net_listen(ns, sock, TCP_MAX_BACKLOG) == 0);
+
+    if (!ok) {
+        Net_Strerror error_str;
+        LOGGER_WARNING(logger, "could not bind to TCP port %d (family = %d): %s",
+                       port, family.value, net_strerror(net_error(), &error_str));
+        kill_sock(ns, sock);
+        return net_invalid_socket();
     }
 
-    Net_Profile *np = netprof_new(logger, mem);
+    LOGGER_DEBUG(logger, "successfully bound to TCP port %d", port);
+    return sock;
+}
 
-    if (np == nullptr) {
-        mem_delete(mem, temp);
+static TCP_Server *tcp_server_alloc(const Logger *_Nonnull logger, const Memory *_Nonnull mem, const Random *_Nonnull rng, const Network *_Nonnull ns,
+                                    const uint8_t *_Nonnull secret_key)
+{
+    TCP_Server *temp = (TCP_Server *)mem_alloc(mem, sizeof(TCP_Server));
+
+    if (temp == nullptr) {
+        LOGGER_ERROR(logger, "TCP server allocation failed");
         return nullptr;
     }
 
-    temp->net_profile = np;
     temp->logger = logger;
     temp->mem = mem;
     temp->ns = ns;
     temp->rng = rng;
 
-    Socket *socks_listening = (Socket *)mem_valloc(mem, num_sockets, sizeof(Socket));
+#ifdef TCP_SERVER_USE_EPOLL
+    temp->efd = -1;
+    temp->wake_fd = -1;
+    temp->stop_fd = -1;
+#endif /* TCP_SERVER_USE_EPOLL */
 
-    if (socks_listening == nullptr) {
-        LOGGER_ERROR(logger, "socket allocation failed");
-        netprof_kill(mem, temp->net_profile);
-        mem_delete(mem, temp);
-        return nullptr;
-    }
+    memcpy(temp->secret_key, secret_key, CRYPTO_SECRET_KEY_SIZE);
+    crypto_derive_public_key(temp->public_key, temp->secret_key);
+
+    bs_list_init(&temp->accepted_key_list, mem, CRYPTO_PUBLIC_KEY_SIZE, 8, memcmp);
+
+    return temp;
+}
+
+/** @brief Open the listening sockets, and with epoll the epoll set they are watched by.
+ *
+ * @param reuseport Let other sockets listen on the same ports.
+ *
+ * @retval true if at least one port could be bound.
+ */
+static bool tcp_server_listen(TCP_Server *_Nonnull tcp_server, bool ipv6_enabled, uint16_t num_sockets, const uint16_t *_Nonnull ports, bool reuseport)
+{
+    tcp_server->socks_listening = (Socket *)mem_valloc(tcp_server->mem, num_sockets, sizeof(Socket));
 
-    temp->socks_listening = socks_listening;
+    if (tcp_server->socks_listening == nullptr) {
+        LOGGER_ERROR(tcp_server->logger, "socket allocation failed");
+        return false;
+    }
 
 #ifdef TCP_SERVER_USE_EPOLL
-    temp->efd = epoll_create1(EPOLL_CLOEXEC);
+    tcp_server->efd = epoll_create1(EPOLL_CLOEXEC);
 
-    if (temp->efd == -1) {
-        LOGGER_ERROR(logger, "epoll initialisation failed");
-        netprof_kill(mem, temp->net_profile);
-        mem_delete(mem, socks_listening);
-        mem_delete(mem, temp);
-        return nullptr;
+    if (tcp_server->efd == -1) {
+        LOGGER_ERROR(tcp_server->logger, "epoll initialisation failed");
+        return false;
     }
 
 #endif /* TCP_SERVER_USE_EPOLL */
@@ -989,7 +1656,7 @@ TCP_Server *new_tcp_server(const Logger *logger, const Memory *mem, const Random
     const Family family = ipv6_enabled ? net_family_ipv6() : net_family_ipv4();
 
     for (uint32_t i = 0; i < num_sockets; ++i) {
-        const Socket sock = new_listening_tcp_socket(logger, mem, ns, family, ports[i]);
+        const Socket sock = new_listening_tcp_socket(tcp_server->logger, tcp_server->mem, tcp_server->ns, family, ports[i], reuseport);
 
         if (!sock_valid(sock)) {
             continue;
@@ -1001,37 +1668,109 @@ TCP_Server *new_tcp_server(const Logger *logger, const Memory *mem, const Random
         ev.events = EPOLLIN | EPOLLET;
         ev.data.u64 = net_socket_to_native(sock) | ((uint64_t)TCP_SOCKET_LISTENING << 32);
 
-        if (epoll_ctl(temp->efd, EPOLL_CTL_ADD, net_socket_to_native(sock), &ev) == -1) {
+        if (epoll_ctl(tcp_server->efd, EPOLL_CTL_ADD, net_socket_to_native(sock), &ev) == -1) {
+            kill_sock(tcp_server->ns, sock);
             continue;
         }
 
 #endif /* TCP_SERVER_USE_EPOLL */
 
-        temp->socks_listening[temp->num_listening_socks] = sock;
-        ++temp->num_listening_socks;
+        tcp_server->socks_listening[tcp_server->num_listening_socks] = sock;
+        ++tcp_server->num_listening_socks;
     }
 
-    if (temp->num_listening_socks == 0) {
-        netprof_kill(mem, temp->net_profile);
-        mem_delete(mem, temp->socks_listening);
-        mem_delete(mem, temp);
-        return nullptr;
-    }
+    return tcp_server->num_listening_socks != 0;
+}
 
+static void tcp_server_set_callbacks(TCP_Server *_Nonnull tcp_server, Onion *_Nullable onion, Forwarding *_Nullable forwarding)
+{
     if (onion != nullptr) {
-        temp->onion = onion;
-        set_callback_handle_recv_1(onion, &handle_onion_recv_1, temp);
+        tcp_server->onion = onion;
+        set_callback_handle_recv_1(onion, &handle_onion_recv_1, tcp_server);
     }
 
     if (forwarding != nullptr) {
-        temp->forwarding = forwarding;
-        set_callback_forward_reply(forwarding, &handle_forward_reply_tcp, temp);
+        tcp_server->forwarding = forwarding;
+        set_callback_forward_reply(forwarding, &handle_forward_reply_tcp, tcp_server);
     }
+}
 
-    memcpy(temp->secret_key, secret_key, CRYPTO_SECRET_KEY_SIZE);
-    crypto_derive_public_key(temp->public_key, temp->secret_key);
+/** @brief Free a server that no other thread uses any more. Shards are freed separately. */
+static void tcp_server_free(TCP_Server *_Nonnull tcp_server)
+{
+    for (uint32_t i = 0; i < tcp_server->num_listening_socks; ++i) {
+        kill_sock(tcp_server->ns, tcp_server->socks_listening[i]);
+    }
 
-    bs_list_init(&temp->accepted_key_list, mem, CRYPTO_PUBLIC_KEY_SIZE, 8, memcmp);
+    bs_list_free(&tcp_server->accepted_key_list);
+
+#ifdef TCP_SERVER_USE_EPOLL
+
+    if (tcp_server->efd != -1) {
+        close(tcp_server->efd);
+    }
+
+    if (tcp_server->wake_fd != -1) {
+        close(tcp_server->wake_fd);
+    }
+
+    if (tcp_server->stop_fd != -1) {
+        close(tcp_server->stop_fd);
+    }
+
+    mono_time_free(tcp_server->mem, tcp_server->shard_mono_time);
+#endif /* TCP_SERVER_USE_EPOLL */
+
+    for (uint32_t i = 0; i < MAX_INCOMING_CONNECTIONS; ++i) {
+        wipe_secure_connection(&tcp_server->incoming_connection_queue[i]);
+        wipe_secure_connection(&tcp_server->unconfirmed_connection_queue[i]);
+    }
+
+    free_accepted_connection_array(tcp_server);
+
+    crypto_memzero(tcp_server->secret_key, sizeof(tcp_server->secret_key));
+
+    mpsc_queue_kill(tcp_server->inbox);
+
+    if (tcp_server->directory != nullptr) {
+        pk_index_kill(tcp_server->directory);
+        pthread_mutex_destroy(&tcp_server->directory_lock);
+    }
+
+    mem_delete(tcp_server->mem, tcp_server->shards);
+    netprof_kill(tcp_server->mem, tcp_server->net_profile);
+    mem_delete(tcp_server->mem, tcp_server->socks_listening);
+    mem_delete(tcp_server->mem, tcp_server);
+}
+
+TCP_Server *new_tcp_server(const Logger *logger, const Memory *mem, const Random *rng, const Network *ns,
+                           bool ipv6_enabled, uint16_t num_sockets,
+                           const uint16_t *ports, const uint8_t *secret_key, Onion *onion, Forwarding *forwarding)
+{
+    if (num_sockets == 0 || ports == nullptr) {
+        LOGGER_ERROR(logger, "no sockets");
+        return nullptr;
+    }
+
+    if (ns == nullptr) {
+        LOGGER_ERROR(logger, "NULL network");
+        return nullptr;
+    }
+
+    TCP_Server *temp = tcp_server_alloc(logger, mem, rng, ns, secret_key);
+
+    if (temp == nullptr) {
+        return nullptr;
+    }
+
+    temp->net_profile = netprof_new(logger, mem);
+
+    if (temp->net_profile == nullptr || !tcp_server_listen(temp, ipv6_enabled, num_sockets, ports, false)) {
+        tcp_server_free(temp);
+        return nullptr;
+    }
+
+    tcp_server_set_callbacks(temp, onion, forwarding);
 
     return temp;
 }
@@ -1222,11 +1961,11 @@ static void do_tcp_confirmed(TCP_Server *_Nonnull tcp_server, const Mono_Time *_
 }
 
 #ifdef TCP_SERVER_USE_EPOLL
-static bool tcp_epoll_process(TCP_Server *_Nonnull tcp_server, const Mono_Time *_Nonnull mono_time)
+static bool tcp_epoll_process(TCP_Server *_Nonnull tcp_server, const Mono_Time *_Nonnull mono_time, int timeout_ms)
 {
 #define MAX_EVENTS 16
     struct epoll_event events[MAX_EVENTS];
-    const int nfds = epoll_wait(tcp_server->efd, events, MAX_EVENTS, 0);
+    const int nfds = epoll_wait(tcp_server->efd, events, MAX_EVENTS, timeout_ms);
 #undef MAX_EVENTS
 
     for (int n = 0; n < nfds; ++n) {
@@ -1341,6 +2080,28 @@ static bool tcp_epoll_process(TCP_Server *_Nonnull tcp_server, const Mono_Time *
                 do_confirmed_recv(tcp_server, index);
                 break;
             }
+
+            case TCP_SOCKET_WAKEUP: {
+                // the inbox is drained after all sockets are handled
+                uint64_t count;
+
+                if (read(tcp_server->wake_fd, &count, sizeof(count)) != sizeof(count)) {
+                    LOGGER_TRACE(tcp_server->logger, "spurious wakeup");
+                }
+
+                break;
+            }
+
+            case TCP_SOCKET_STOP: {
+                uint64_t count;
+
+                if (read(tcp_server->stop_fd, &count, sizeof(count)) != sizeof(count)) {
+                    LOGGER_TRACE(tcp_server->logger, "spurious stop event");
+                }
+
+                tcp_server->stopping = true;
+                break;
+            }
         }
     }
 
@@ -1349,15 +2110,296 @@ static bool tcp_epoll_process(TCP_Server *_Nonnull tcp_server, const Mono_Time *
 
 static void do_tcp_epoll(TCP_Server *_Nonnull tcp_server, const Mono_Time *_Nonnull mono_time)
 {
-    while (tcp_epoll_process(tcp_server, mono_time)) {
+    while (tcp_epoll_process(tcp_server, mono_time, 0)) {
         // Keep processing packets until there are no more FDs ready for reading.
         continue;
     }
 }
+
+/** Maximum number of inbox messages a shard handles between two epoll rounds. */
+#define TCP_SHARD_INBOX_BATCH 256
+
+static void *tcp_shard_run(void *arg)
+{
+    TCP_Server *shard = (TCP_Server *)arg;
+    Mono_Time *mono_time = shard->shard_mono_time;
+
+    while (!shard->stopping) {
+        /* Don't sleep if messages are left over from the last round, or a
+         * producer is in the middle of pushing one. */
+        const int timeout = mpsc_queue_empty(shard->inbox) ? TCP_SHARD_WAIT_MS : 0;
+
+        if (tcp_epoll_process(shard, mono_time, timeout)) {
+            do_tcp_epoll(shard, mono_time);
+        }
+
+        mono_time_update(mono_time);
+        tcp_server_handle_inbox(shard, TCP_SHARD_INBOX_BATCH);
+        do_tcp_confirmed(shard, mono_time);
+    }
+
+    return nullptr;
+}
+
+static void tcp_server_wake(void *_Nullable object)
+{
+    const TCP_Server *tcp_server = (const TCP_Server *)object;
+    const uint64_t one = 1;
+
+    if (write(tcp_server->wake_fd, &one, sizeof(one)) != sizeof(one)) {
+        // the counter is saturated, so the consumer is awake anyway
+        return;
+    }
+}
+
+static bool tcp_server_init_inbox(TCP_Server *_Nonnull tcp_server)
+{
+    tcp_server->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (tcp_server->wake_fd == -1) {
+        LOGGER_ERROR(tcp_server->logger, "eventfd initialisation failed");
+        return false;
+    }
+
+    tcp_server->inbox = mpsc_queue_new(tcp_server->mem, &tcp_server_wake, tcp_server);
+    return tcp_server->inbox != nullptr;
+}
+
+static TCP_Server *new_tcp_shard(TCP_Server *_Nonnull front, uint16_t shard_id, bool ipv6_enabled, uint16_t num_sockets, const uint16_t *_Nonnull ports)
+{
+    TCP_Server *shard = tcp_server_alloc(front->logger, front->mem, front->rng, front->ns, front->secret_key);
+
+    if (shard == nullptr) {
+        return nullptr;
+    }
+
+    shard->front = front;
+    shard->shard_id = shard_id;
+    shard->shard_mono_time = mono_time_new(front->mem, nullptr, nullptr);
+
+    if (shard->shard_mono_time == nullptr
+            || !tcp_server_listen(shard, ipv6_enabled, num_sockets, ports, true)
+            || !tcp_server_init_inbox(shard)) {
+        tcp_server_free(shard);
+        return nullptr;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = (uint32_t)shard->wake_fd | ((uint64_t)TCP_SOCKET_WAKEUP << 32);
+
+    if (epoll_ctl(shard->efd, EPOLL_CTL_ADD, shard->wake_fd, &ev) == -1) {
+        LOGGER_ERROR(front->logger, "could not add the wakeup event of TCP shard %u to epoll", shard_id);
+        tcp_server_free(shard);
+        return nullptr;
+    }
+
+    shard->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ev.data.u64 = (uint32_t)shard->stop_fd | ((uint64_t)TCP_SOCKET_STOP << 32);
+
+    if (shard->stop_fd == -1 || epoll_ctl(shard->efd, EPOLL_CTL_ADD, shard->stop_fd, &ev) == -1) {
+        LOGGER_ERROR(front->logger, "could not add the stop event of TCP shard %u to epoll", shard_id);
+        tcp_server_free(shard);
+        return nullptr;
+    }
+
+    return shard;
+}
+#endif /* TCP_SERVER_USE_EPOLL */
+
+static void tcp_server_stop_shards(TCP_Server *_Nonnull front)
+{
+#ifdef TCP_SERVER_USE_EPOLL
+    const uint64_t one = 1;
+
+    for (uint16_t i = 0; i < front->num_shards; ++i) {
+        const TCP_Server *shard = front->shards[i];
+
+        /* This can only fail if the counter is saturated, which means the
+         * shard has been told to stop already. */
+        if (shard->thread_started && write(shard->stop_fd, &one, sizeof(one)) != sizeof(one)) {
+            LOGGER_TRACE(front->logger, "TCP shard %u is already stopping", i);
+        }
+    }
+
+    for (uint16_t i = 0; i < front->num_shards; ++i) {
+        TCP_Server *shard = front->shards[i];
+
+        if (shard->thread_started) {
+            pthread_join(shard->thread, nullptr);
+        }
+    }
+
+#endif /* TCP_SERVER_USE_EPOLL */
+
+    /* Only free the shards once no thread can send them messages any more. */
+    for (uint16_t i = 0; i < front->num_shards; ++i) {
+        tcp_server_free(front->shards[i]);
+    }
+
+    front->num_shards = 0;
+}
+
+TCP_Server *new_tcp_server_threaded(const Logger *logger, const Memory *mem, const Random *rng, const Network *ns,
+                                    bool ipv6_enabled, uint16_t num_sockets, const uint16_t *ports,
+                                    const uint8_t *secret_key, Onion *onion, Forwarding *forwarding, uint16_t num_threads)
+{
+#ifndef TCP_SERVER_USE_EPOLL
+
+    if (num_threads != 0) {
+        LOGGER_WARNING(logger, "threaded TCP server needs epoll; running it on the caller's thread");
+    }
+
+    num_threads = 0;
+#endif /* TCP_SERVER_USE_EPOLL */
+
+    if (num_threads == 0) {
+        return new_tcp_server(logger, mem, rng, ns, ipv6_enabled, num_sockets, ports, secret_key, onion, forwarding);
+    }
+
+#ifdef TCP_SERVER_USE_EPOLL
+
+    if (num_sockets == 0 || ports == nullptr) {
+        LOGGER_ERROR(logger, "no sockets");
+        return nullptr;
+    }
+
+    if (ns == nullptr) {
+        LOGGER_ERROR(logger, "NULL network");
+        return nullptr;
+    }
+
+    if (num_threads > TCP_MAX_SHARDS) {
+        LOGGER_WARNING(logger, "limiting TCP server to %d threads", TCP_MAX_SHARDS);
+        num_threads = TCP_MAX_SHARDS;
+    }
+
+    TCP_Server *front = tcp_server_alloc(logger, mem, rng, ns, secret_key);
+
+    if (front == nullptr) {
+        return nullptr;
+    }
+
+    front->net_profile = netprof_new(logger, mem);
+    front->shards = (TCP_Server **)mem_valloc(mem, num_threads, sizeof(TCP_Server *));
+    front->directory = pk_index_new(mem, rng);
+
+    if (front->directory != nullptr && pthread_mutex_init(&front->directory_lock, nullptr) != 0) {
+        pk_index_kill(front->directory);
+        front->directory = nullptr;
+    }
+
+    if (front->net_profile == nullptr || front->shards == nullptr || front->directory == nullptr
+            || !tcp_server_init_inbox(front)) {
+        tcp_server_free(front);
+        return nullptr;
+    }
+
+    for (uint16_t i = 0; i < num_threads; ++i) {
+        TCP_Server *shard = new_tcp_shard(front, i, ipv6_enabled, num_sockets, ports);
+
+        if (shard == nullptr) {
+            LOGGER_ERROR(logger, "failed to create TCP shard %u", i);
+            tcp_server_stop_shards(front);
+            tcp_server_free(front);
+            return nullptr;
+        }
+
+        front->shards[i] = shard;
+        ++front->num_shards;
+    }
+
+    tcp_server_set_callbacks(front, onion, forwarding);
+
+    for (uint16_t i = 0; i < num_threads; ++i) {
+        TCP_Server *shard = front->shards[i];
+
+        if (pthread_create(&shard->thread, nullptr, &tcp_shard_run, shard) != 0) {
+            LOGGER_ERROR(logger, "failed to start thread for TCP shard %u", i);
+            kill_tcp_server(front);
+            return nullptr;
+        }
+
+        shard->thread_started = true;
+    }
+
+    LOGGER_INFO(logger, "TCP server running on %u threads", num_threads);
+    return front;
+#else
+    return nullptr;
+#endif /* TCP_SERVER_USE_EPOLL */
+}
+
+#ifndef TCP_SERVER_USE_EPOLL
+static void visit_secure_connection(const TCP_Secure_Connection *_Nonnull conn, net_socket_visit_cb *_Nonnull cb, void *_Nonnull obj)
+{
+    if (conn->status != TCP_STATUS_NO_STATUS) {
+        cb(obj, conn->con.sock, conn->con.sock_id, tcp_connection_has_pending_data(&conn->con));
+    }
+}
+#endif /* TCP_SERVER_USE_EPOLL */
+
+void tcp_server_set_send_queue_budget(TCP_Server *tcp_server, uint32_t budget)
+{
+    if (tcp_server->shards == nullptr) {
+        tcp_server_apply_send_queue_budget(tcp_server, budget);
+        return;
+    }
+
+    tcp_server->send_queue_budget = budget;
+
+    TCP_Shard_Msg msg = {0};
+    msg.type = TCP_SHARD_MSG_SEND_QUEUE_BUDGET;
+    msg.identifier = budget;
+
+    for (uint16_t i = 0; i < tcp_server->num_shards; ++i) {
+        if (!tcp_shard_send(tcp_server->shards[i], &msg, nullptr, 0)) {
+            LOGGER_ERROR(tcp_server->logger, "could not update the send queue budget of TCP shard %u", i);
+        }
+    }
+}
+
+void tcp_server_visit_sockets(const TCP_Server *tcp_server, net_socket_visit_cb *cb, void *obj)
+{
+#ifdef TCP_SERVER_USE_EPOLL
+
+    if (tcp_server->shards != nullptr) {
+        cb(obj, net_socket_from_native(tcp_server->wake_fd), 0, false);
+        return;
+    }
+
+    cb(obj, net_socket_from_native(tcp_server->efd), 0, false);
+#else
+    for (uint32_t i = 0; i < tcp_server->num_listening_socks; ++i) {
+        cb(obj, tcp_server->socks_listening[i], 0, false);
+    }
+
+    for (uint32_t i = 0; i < MAX_INCOMING_CONNECTIONS; ++i) {
+        visit_secure_connection(&tcp_server->incoming_connection_queue[i], cb, obj);
+        visit_secure_connection(&tcp_server->unconfirmed_connection_queue[i], cb, obj);
+    }
+
+    for (uint32_t i = 0; i < tcp_server->size_accepted_connections; ++i) {
+        visit_secure_connection(&tcp_server->accepted_connection_array[i], cb, obj);
+    }
 #endif /* TCP_SERVER_USE_EPOLL */
+}
 
 void do_tcp_server(TCP_Server *tcp_server, const Mono_Time *mono_time)
 {
+    if (tcp_server->shards != nullptr) {
+#ifdef TCP_SERVER_USE_EPOLL
+        uint64_t count;
+
+        if (read(tcp_server->wake_fd, &count, sizeof(count)) != sizeof(count)) {
+            LOGGER_TRACE(tcp_server->logger, "no requests from TCP shards");
+        }
+
+#endif /* TCP_SERVER_USE_EPOLL */
+        tcp_server_handle_inbox(tcp_server, UINT32_MAX);
+        return;
+    }
+
 #ifdef TCP_SERVER_USE_EPOLL
     do_tcp_epoll(tcp_server, mono_time);
 
@@ -1376,10 +2418,6 @@ void kill_tcp_server(TCP_Server *tcp_server)
         return;
     }
 
-    for (uint32_t i = 0; i < tcp_server->num_listening_socks; ++i) {
-        kill_sock(tcp_server->ns, tcp_server->socks_listening[i]);
-    }
-
     if (tcp_server->onion != nullptr) {
         set_callback_handle_recv_1(tcp_server->onion, nullptr, nullptr);
     }
@@ -1388,24 +2426,11 @@ void kill_tcp_server(TCP_Server *tcp_server)
         set_callback_forward_reply(tcp_server->forwarding, nullptr, nullptr);
     }
 
-    bs_list_free(&tcp_server->accepted_key_list);
-
-#ifdef TCP_SERVER_USE_EPOLL
-    close(tcp_server->efd);
-#endif /* TCP_SERVER_USE_EPOLL */
-
-    for (uint32_t i = 0; i < MAX_INCOMING_CONNECTIONS; ++i) {
-        wipe_secure_connection(&tcp_server->incoming_connection_queue[i]);
-        wipe_secure_connection(&tcp_server->unconfirmed_connection_queue[i]);
+    if (tcp_server->shards != nullptr) {
+        tcp_server_stop_shards(tcp_server);
     }
 
-    free_accepted_connection_array(tcp_server);
-
-    crypto_memzero(tcp_server->secret_key, sizeof(tcp_server->secret_key));
-
-    netprof_kill(tcp_server->mem, tcp_server->net_profile);
-    mem_delete(tcp_server->mem, tcp_server->socks_listening);
-    mem_delete(tcp_server->mem, tcp_server);
+    tcp_server_free(tcp_server);
 }
 
 const Net_Profile *tcp_server_get_net_profile(const TCP_Server *tcp_server)
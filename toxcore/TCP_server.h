@@ -50,6 +50,43 @@ size_t tcp_server_listen_count(const TCP_Server *_Nonnull tcp_server);
 TCP_Server *_Nullable new_tcp_server(const Logger *_Nonnull logger, const Memory *_Nonnull mem, const Random *_Nonnull rng, const Network *_Nonnull ns,
                                      bool ipv6_enabled, uint16_t num_sockets, const uint16_t *_Nonnull ports,
                                      const uint8_t *_Nonnull secret_key, Onion *_Nullable onion, Forwarding *_Nullable forwarding);
+
+/** @brief Create a TCP server that handles its clients on `num_threads` worker threads.
+ *
+ * Each worker binds its own listening sockets to `ports` with SO_REUSEPORT, so
+ * the kernel spreads new connections between the workers, and serves the
+ * connections it accepted from its own epoll set. Packets between clients on
+ * different workers go through lock-free queues. Onion and forwarding requests
+ * are handed back to the thread calling do_tcp_server, so `onion` and
+ * `forwarding` are only used from that thread.
+ *
+ * The logger may be called from any of the worker threads. The net profile of
+ * a threaded server stays empty.
+ *
+ * Without epoll support, or if `num_threads` is 0, this is new_tcp_server.
+ */
+TCP_Server *_Nullable new_tcp_server_threaded(const Logger *_Nonnull logger, const Memory *_Nonnull mem, const Random *_Nonnull rng, const Network *_Nonnull ns,
+        bool ipv6_enabled, uint16_t num_sockets, const uint16_t *_Nonnull ports,
+        const uint8_t *_Nonnull secret_key, Onion *_Nullable onion, Forwarding *_Nullable forwarding,
+        uint16_t num_threads);
+
+/** @brief Set how many bytes each client connection may queue for a slow reader.
+ *
+ * Once a client's queue is over the budget, packets relayed to it are dropped
+ * and counted in the server's net profile. 0 restores the default,
+ * TCP_SEND_QUEUE_DEFAULT_BUDGET. A threaded server applies the change on its
+ * worker threads shortly after this returns.
+ */
+void tcp_server_set_send_queue_budget(TCP_Server *_Nonnull tcp_server, uint32_t budget);
+
+/**
+ * @brief Call `cb` for every socket that do_tcp_server needs to read from.
+ *
+ * With epoll, this is only the server's epoll descriptor, which becomes
+ * readable when any of its registered sockets is ready.
+ */
+void tcp_server_visit_sockets(const TCP_Server *_Nonnull tcp_server, net_socket_visit_cb *_Nonnull cb, void *_Nonnull obj);
+
 /** Run the TCP_server */
 void do_tcp_server(TCP_Server *_Nonnull tcp_server, const Mono_Time *_Nonnull mono_time);
 
@@ -0,0 +1,360 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include <benchmark/benchmark.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "TCP_common.h"
+#include "TCP_server.h"
+#include "crypto_core.h"
+#include "logger.h"
+#include "mono_time.h"
+#include "os_memory.h"
+#include "os_network.h"
+#include "os_random.h"
+
+namespace {
+
+constexpr std::uint16_t kPayloadSize = 1024;
+constexpr int kBurst = 16;
+constexpr int kPairsPerClientThread = 4;
+
+bool write_all(int fd, const std::uint8_t *data, std::size_t length)
+{
+    while (length > 0) {
+        const ssize_t ret = ::send(fd, data, length, MSG_NOSIGNAL);
+        if (ret <= 0) {
+            return false;
+        }
+        data += ret;
+        length -= static_cast<std::size_t>(ret);
+    }
+    return true;
+}
+
+bool read_all(int fd, std::uint8_t *data, std::size_t length)
+{
+    while (length > 0) {
+        const ssize_t ret = ::recv(fd, data, length, 0);
+        if (ret <= 0) {
+            return false;
+        }
+        data += ret;
+        length -= static_cast<std::size_t>(ret);
+    }
+    return true;
+}
+
+/** A relay client speaking the TCP relay protocol over a blocking socket. */
+class FakeClient {
+public:
+    FakeClient(const Memory *mem, const Random *rng)
+        : mem_(mem)
+    {
+        crypto_new_keypair(rng, public_key_.data(), secret_key_.data());
+    }
+
+    ~FakeClient()
+    {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    FakeClient(const FakeClient &) = delete;
+    FakeClient &operator=(const FakeClient &) = delete;
+
+    bool connect(const Random *rng, const std::uint8_t *server_pk, std::uint16_t port)
+    {
+        fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd_ < 0) {
+            return false;
+        }
+
+        const int one = 1;
+        ::setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        if (::connect(fd_, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) != 0) {
+            return false;
+        }
+
+        std::uint8_t temp_secret_key[CRYPTO_SECRET_KEY_SIZE];
+        std::uint8_t plain[TCP_HANDSHAKE_PLAIN_SIZE];
+        crypto_new_keypair(rng, plain, temp_secret_key);
+        random_nonce(rng, sent_nonce_.data());
+        std::memcpy(plain + CRYPTO_PUBLIC_KEY_SIZE, sent_nonce_.data(), CRYPTO_NONCE_SIZE);
+
+        std::uint8_t handshake[TCP_CLIENT_HANDSHAKE_SIZE];
+        std::memcpy(handshake, public_key_.data(), CRYPTO_PUBLIC_KEY_SIZE);
+        random_nonce(rng, handshake + CRYPTO_PUBLIC_KEY_SIZE);
+
+        if (encrypt_data(mem_, server_pk, secret_key_.data(), handshake + CRYPTO_PUBLIC_KEY_SIZE, plain, sizeof(plain),
+                         handshake + CRYPTO_PUBLIC_KEY_SIZE + CRYPTO_NONCE_SIZE)
+            < 0) {
+            return false;
+        }
+
+        if (!write_all(fd_, handshake, sizeof(handshake))) {
+            return false;
+        }
+
+        std::uint8_t response[TCP_SERVER_HANDSHAKE_SIZE];
+        std::uint8_t response_plain[TCP_HANDSHAKE_PLAIN_SIZE];
+
+        if (!read_all(fd_, response, sizeof(response))
+            || decrypt_data(mem_, server_pk, secret_key_.data(), response, response + CRYPTO_NONCE_SIZE,
+                   sizeof(response) - CRYPTO_NONCE_SIZE, response_plain)
+                != TCP_HANDSHAKE_PLAIN_SIZE) {
+            return false;
+        }
+
+        encrypt_precompute(response_plain, temp_secret_key, shared_key_.data());
+        std::memcpy(recv_nonce_.data(), response_plain + CRYPTO_PUBLIC_KEY_SIZE, CRYPTO_NONCE_SIZE);
+        return true;
+    }
+
+    /** Encrypt `length` bytes into `out` as one length-prefixed relay packet. */
+    std::size_t seal(const std::uint8_t *data, std::uint16_t length, std::uint8_t *out)
+    {
+        const std::uint16_t c_length = htons(length + CRYPTO_MAC_SIZE);
+        std::memcpy(out, &c_length, sizeof(c_length));
+        encrypt_data_symmetric(mem_, shared_key_.data(), sent_nonce_.data(), data, length, out + sizeof(c_length));
+        increment_nonce(sent_nonce_.data());
+        return sizeof(c_length) + length + CRYPTO_MAC_SIZE;
+    }
+
+    bool send_packet(const std::uint8_t *data, std::uint16_t length)
+    {
+        std::uint8_t packet[sizeof(std::uint16_t) + MAX_PACKET_SIZE];
+        return write_all(fd_, packet, seal(data, length, packet));
+    }
+
+    /** @return the plaintext length, or -1 on error. */
+    int recv_packet(std::uint8_t *data)
+    {
+        std::uint8_t header[sizeof(std::uint16_t)];
+        if (!read_all(fd_, header, sizeof(header))) {
+            return -1;
+        }
+
+        std::uint16_t length;
+        std::memcpy(&length, header, sizeof(length));
+        length = ntohs(length);
+
+        std::uint8_t packet[MAX_PACKET_SIZE];
+        if (length > sizeof(packet) || length < CRYPTO_MAC_SIZE || !read_all(fd_, packet, length)) {
+            return -1;
+        }
+
+        const int len = decrypt_data_symmetric(mem_, shared_key_.data(), recv_nonce_.data(), packet, length, data);
+        increment_nonce(recv_nonce_.data());
+        return len;
+    }
+
+    int fd() const { return fd_; }
+    const std::uint8_t *public_key() const { return public_key_.data(); }
+
+    /** Packet id for data to the peer, from the routing response. */
+    std::uint8_t connection_id = 0;
+
+private:
+    const Memory *mem_;
+    int fd_ = -1;
+    std::array<std::uint8_t, CRYPTO_PUBLIC_KEY_SIZE> public_key_;
+    std::array<std::uint8_t, CRYPTO_SECRET_KEY_SIZE> secret_key_;
+    std::array<std::uint8_t, CRYPTO_NONCE_SIZE> sent_nonce_;
+    std::array<std::uint8_t, CRYPTO_NONCE_SIZE> recv_nonce_;
+    std::array<std::uint8_t, CRYPTO_SHARED_KEY_SIZE> shared_key_;
+};
+
+/** Ask the relay to link `client` with `peer` and wait until the peer is online. */
+bool link_clients(FakeClient &client, const FakeClient &peer)
+{
+    std::uint8_t request[1 + CRYPTO_PUBLIC_KEY_SIZE];
+    request[0] = TCP_PACKET_ROUTING_REQUEST;
+    std::memcpy(request + 1, peer.public_key(), CRYPTO_PUBLIC_KEY_SIZE);
+    return client.send_packet(request, sizeof(request));
+}
+
+bool wait_for_peer(FakeClient &client)
+{
+    std::uint8_t data[MAX_PACKET_SIZE];
+
+    while (true) {
+        const int len = client.recv_packet(data);
+        if (len <= 0) {
+            return false;
+        }
+
+        if (data[0] == TCP_PACKET_ROUTING_RESPONSE && len == 1 + 1 + CRYPTO_PUBLIC_KEY_SIZE) {
+            client.connection_id = data[1];
+        } else if (data[0] == TCP_PACKET_CONNECTION_NOTIFICATION && len == 2) {
+            return client.connection_id != 0 && data[1] == client.connection_id;
+        }
+    }
+}
+
+/**
+ * Relay throughput with pairs of fake clients pushing data through a relay.
+ *
+ * range(0): worker threads (0 = the classic single-threaded relay).
+ * range(1): client pairs.
+ */
+void BM_RelayThroughput(benchmark::State &state)
+{
+    const auto num_threads = static_cast<std::uint16_t>(state.range(0));
+    const auto num_pairs = static_cast<std::size_t>(state.range(1));
+
+    const Memory *mem = os_memory();
+    const Random *rng = os_random();
+    const Network *ns = os_network();
+    Logger *logger = logger_new(mem);
+    Mono_Time *mono_time = mono_time_new(mem, nullptr, nullptr);
+
+    std::uint8_t self_public_key[CRYPTO_PUBLIC_KEY_SIZE];
+    std::uint8_t self_secret_key[CRYPTO_SECRET_KEY_SIZE];
+    crypto_new_keypair(rng, self_public_key, self_secret_key);
+
+    TCP_Server *server = nullptr;
+    std::uint16_t port = 0;
+
+    for (std::uint16_t candidate = 34400; candidate < 34500 && server == nullptr; ++candidate) {
+        server = new_tcp_server_threaded(
+            logger, mem, rng, ns, false, 1, &candidate, self_secret_key, nullptr, nullptr, num_threads);
+        port = candidate;
+    }
+
+    if (server == nullptr) {
+        state.SkipWithError("could not start the TCP relay");
+        mono_time_free(mem, mono_time);
+        logger_kill(logger);
+        return;
+    }
+
+    // The caller's thread runs the relay itself in single-threaded mode, and
+    // handles onion/forwarding hand-offs in threaded mode.
+    std::atomic<bool> running{true};
+    std::thread driver([&]() {
+        while (running.load(std::memory_order_relaxed)) {
+            mono_time_update(mono_time);
+            do_tcp_server(server, mono_time);
+
+            if (num_threads != 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    });
+
+    std::vector<std::unique_ptr<FakeClient>> clients;
+    bool ok = true;
+
+    for (std::size_t i = 0; i < num_pairs * 2 && ok; ++i) {
+        clients.push_back(std::make_unique<FakeClient>(mem, rng));
+        ok = clients.back()->connect(rng, self_public_key, port);
+    }
+
+    for (std::size_t i = 0; i < clients.size() && ok; ++i) {
+        ok = link_clients(*clients[i], *clients[i ^ 1]);
+    }
+
+    for (std::size_t i = 0; i < clients.size() && ok; ++i) {
+        ok = wait_for_peer(*clients[i]);
+    }
+
+    if (!ok) {
+        state.SkipWithError("fake clients failed to connect");
+    }
+
+    const std::size_t num_client_threads = (num_pairs + kPairsPerClientThread - 1) / kPairsPerClientThread;
+
+    for (auto _ : state) {
+        if (!ok) {
+            break;
+        }
+
+        std::atomic<bool> failed{false};
+        std::vector<std::thread> workers;
+
+        for (std::size_t t = 0; t < num_client_threads; ++t) {
+            workers.emplace_back([&, t]() {
+                const std::size_t first = t * kPairsPerClientThread;
+                const std::size_t last = std::min(num_pairs, first + kPairsPerClientThread);
+
+                std::uint8_t payload[kPayloadSize] = {0};
+                std::vector<std::uint8_t> burst(kBurst * (sizeof(std::uint16_t) + kPayloadSize + CRYPTO_MAC_SIZE));
+
+                for (std::size_t p = first; p < last; ++p) {
+                    FakeClient &sender = *clients[p * 2];
+                    payload[0] = sender.connection_id;
+                    std::size_t size = 0;
+
+                    for (int i = 0; i < kBurst; ++i) {
+                        size += sender.seal(payload, sizeof(payload), burst.data() + size);
+                    }
+
+                    if (!write_all(sender.fd(), burst.data(), size)) {
+                        failed = true;
+                        return;
+                    }
+                }
+
+                std::uint8_t data[MAX_PACKET_SIZE];
+
+                for (std::size_t p = first; p < last; ++p) {
+                    for (int i = 0; i < kBurst; ++i) {
+                        if (clients[p * 2 + 1]->recv_packet(data) != kPayloadSize) {
+                            failed = true;
+                            return;
+                        }
+                    }
+                }
+            });
+        }
+
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+
+        if (failed) {
+            state.SkipWithError("relayed data went missing");
+            break;
+        }
+    }
+
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * num_pairs * kBurst * kPayloadSize));
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * num_pairs * kBurst));
+
+    clients.clear();
+    running = false;
+    driver.join();
+    kill_tcp_server(server);
+    mono_time_free(mem, mono_time);
+    logger_kill(logger);
+}
+
+BENCHMARK(BM_RelayThroughput)
+    ->ArgNames({"threads", "pairs"})
+    ->ArgsProduct({{0, 1, 2, 4}, {8, 32}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -26,7 +26,7 @@
 #include "util.h"
 
 /* Settings for the shared key cache */
-#define MAX_KEYS_PER_SLOT 4
+#define KEYS_CACHE_CAPACITY 512
 #define KEYS_TIMEOUT 600
 
 uint8_t announce_response_of_request_type(uint8_t request_type)
@@ -643,7 +643,7 @@ Announcements *new_announcements(const Logger *log, const Memory *mem, const Ran
     announce->public_key = dht_get_self_public_key(announce->dht);
     announce->secret_key = dht_get_self_secret_key(announce->dht);
     new_hmac_key(announce->rng, announce->hmac_key);
-    Shared_Key_Cache *const shared_keys = shared_key_cache_new(log, mono_time, mem, announce->secret_key, KEYS_TIMEOUT, MAX_KEYS_PER_SLOT);
+    Shared_Key_Cache *const shared_keys = shared_key_cache_new(log, mono_time, mem, rng, announce->secret_key, KEYS_TIMEOUT, KEYS_CACHE_CAPACITY);
     if (shared_keys == nullptr) {
         mem_delete(announce->mem, announce);
         return nullptr;
@@ -682,3 +682,8 @@ void kill_announcements(Announcements *announce)
 
     mem_delete(announce->mem, announce);
 }
+
+const Shared_Key_Cache *announce_get_shared_keys(const Announcements *announce)
+{
+    return announce->shared_keys;
+}
@@ -17,6 +17,7 @@
 #include "mono_time.h"
 #include "network.h"
 #include "rng.h"
+#include "shared_key_cache.h"
 
 #define MAX_ANNOUNCEMENT_SIZE 512
 
@@ -39,6 +40,9 @@ bool announce_on_stored(const Announcements *_Nonnull announce, const uint8_t *_
 void announce_set_synch_offset(Announcements *_Nonnull announce, int32_t synch_offset);
 
 void kill_announcements(Announcements *_Nullable announce);
+
+/** @brief The shared key cache for incoming announce and store requests. */
+const Shared_Key_Cache *_Nonnull announce_get_shared_keys(const Announcements *_Nonnull announce);
 /* The declarations below are not public, they are exposed only for tests. */
 
 /** @private
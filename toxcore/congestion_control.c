@@ -0,0 +1,221 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include "congestion_control.h"
+
+/**
+ * If the send queue is SEND_QUEUE_RATIO times larger than the
+ * calculated link speed the packet send speed will be reduced
+ * by a value depending on this number.
+ */
+#define SEND_QUEUE_RATIO 2.0
+
+/** Fraction of the rate the delay-based controller adds or removes per update at full offset from the target. */
+#define CONGESTION_DELAY_GAIN 0.25
+
+/** Rate multiplier when the delay-based controller sees heavy loss. */
+#define CONGESTION_DELAY_LOSS_BACKOFF 0.75
+
+/**
+ * The delay-based controller treats loss as congestion only when more than
+ * one in this many packets in an update had to be resent.
+ */
+#define CONGESTION_DELAY_LOSS_RATIO 8
+
+static void queue_update(Congestion_State *_Nonnull state, const Congestion_Sample *_Nonnull sample,
+                         const Congestion_Delivered *_Nonnull delivered)
+{
+    const double send_array_ratio = (double)sample->send_queue_size / delivered->sent;
+
+    // TODO(irungentoo): Improve formula?
+    if (send_array_ratio > SEND_QUEUE_RATIO && CRYPTO_MIN_QUEUE_LENGTH < sample->send_queue_size) {
+        state->send_rate = delivered->sent * (1.0 / (send_array_ratio / SEND_QUEUE_RATIO));
+    } else if (sample->last_congestion_event + CONGESTION_EVENT_TIMEOUT < sample->now) {
+        state->send_rate = delivered->sent * 1.2;
+    } else {
+        state->send_rate = delivered->sent * 0.9;
+    }
+
+    state->send_rate_requested = delivered->sent_and_resent * 1.2;
+}
+
+static uint64_t filtered_rtt(const Congestion_State *_Nonnull state)
+{
+    uint64_t rtt = 0;
+
+    for (uint32_t i = 0; i < CONGESTION_DELAY_FILTER_SIZE; ++i) {
+        const uint64_t sample = state->rtt_filter[i];
+
+        if (sample != 0 && (rtt == 0 || sample < rtt)) {
+            rtt = sample;
+        }
+    }
+
+    return rtt;
+}
+
+static uint64_t base_delay(const Congestion_State *_Nonnull state)
+{
+    uint64_t rtt = 0;
+
+    for (uint32_t i = 0; i < CONGESTION_BASE_HISTORY_SIZE; ++i) {
+        const uint64_t sample = state->base_history[i];
+
+        if (sample != 0 && (rtt == 0 || sample < rtt)) {
+            rtt = sample;
+        }
+    }
+
+    return rtt;
+}
+
+static void base_history_add(Congestion_State *_Nonnull state, uint64_t now, uint64_t rtt)
+{
+    if (state->base_interval_start == 0 || state->base_interval_start + CONGESTION_BASE_INTERVAL <= now) {
+        state->base_history_counter = (state->base_history_counter + 1) % CONGESTION_BASE_HISTORY_SIZE;
+        state->base_history[state->base_history_counter] = 0;
+        state->base_interval_start = now;
+    }
+
+    uint64_t *const slot = &state->base_history[state->base_history_counter];
+
+    if (*slot == 0 || rtt < *slot) {
+        *slot = rtt;
+    }
+}
+
+static void delay_update(Congestion_State *_Nonnull state, const Congestion_Sample *_Nonnull sample,
+                         const Congestion_Delivered *_Nonnull delivered)
+{
+    const uint64_t rtt = filtered_rtt(state);
+    const uint64_t base = base_delay(state);
+    const uint64_t queuing_delay = rtt > base ? rtt - base : 0;
+
+    double off_target = ((double)CONGESTION_DELAY_TARGET - (double)queuing_delay) / CONGESTION_DELAY_TARGET;
+
+    if (off_target < -1.0) {
+        off_target = -1.0;
+    }
+
+    /* Back off at most once per round trip, so one burst of delay or loss
+     * is not answered again before the lower rate could show its effect. */
+    const uint64_t backoff_interval = base > CONGESTION_UPDATE_INTERVAL ? base : CONGESTION_UPDATE_INTERVAL;
+    const bool may_back_off = state->last_decrease + backoff_interval <= sample->now;
+    const uint32_t total = sample->packets_sent + sample->packets_resent;
+    const bool heavy_loss = total != 0 && sample->packets_resent * CONGESTION_DELAY_LOSS_RATIO > total;
+
+    double rate = state->send_rate;
+
+    if (heavy_loss) {
+        if (may_back_off) {
+            rate *= CONGESTION_DELAY_LOSS_BACKOFF;
+            state->last_decrease = sample->now;
+        }
+    } else if (off_target >= 0.0) {
+        rate *= 1.0 + CONGESTION_DELAY_GAIN * off_target;
+    } else if (may_back_off) {
+        rate *= 1.0 + CONGESTION_DELAY_GAIN * off_target;
+        state->last_decrease = sample->now;
+    }
+
+    /* Don't let the rate run away while the application isn't using it. */
+    if (rate > delivered->sent * 2.0) {
+        rate = delivered->sent * 2.0;
+    }
+
+    state->send_rate = rate;
+    state->send_rate_requested = delivered->sent_and_resent * 1.2;
+}
+
+static const Congestion_Control congestion_controls[] = {
+    {"queue", queue_update},
+    {"delay", delay_update},
+};
+
+const Congestion_Control *congestion_control_get(Congestion_Control_Algorithm algorithm)
+{
+    if ((unsigned int)algorithm >= sizeof(congestion_controls) / sizeof(congestion_controls[0])) {
+        return &congestion_controls[CONGESTION_CONTROL_QUEUE];
+    }
+
+    return &congestion_controls[algorithm];
+}
+
+void congestion_state_init(Congestion_State *state)
+{
+    state->send_rate = CRYPTO_PACKET_MIN_RATE;
+    state->send_rate_requested = CRYPTO_PACKET_MIN_RATE;
+}
+
+void congestion_update(const Congestion_Control *cc, Congestion_State *state, const Congestion_Sample *sample)
+{
+    if (sample->recent_rtt != 0) {
+        state->rtt_filter[state->rtt_filter_counter % CONGESTION_DELAY_FILTER_SIZE] = sample->recent_rtt;
+        ++state->rtt_filter_counter;
+        base_history_add(state, sample->now, sample->recent_rtt);
+    }
+
+    const unsigned int pos = state->last_sendqueue_counter % CONGESTION_QUEUE_ARRAY_SIZE;
+    state->last_sendqueue_size[pos] = sample->send_queue_size;
+
+    long signed int sum = 0;
+    sum = (long signed int)state->last_sendqueue_size[pos] -
+          (long signed int)state->last_sendqueue_size[(pos + 1) % CONGESTION_QUEUE_ARRAY_SIZE];
+
+    const unsigned int n_p_pos = state->last_sendqueue_counter % CONGESTION_LAST_SENT_ARRAY_SIZE;
+    state->last_num_packets_sent[n_p_pos] = sample->packets_sent;
+    state->last_num_packets_resent[n_p_pos] = sample->packets_resent;
+
+    state->last_sendqueue_counter = (state->last_sendqueue_counter + 1) %
+                                    (CONGESTION_QUEUE_ARRAY_SIZE * CONGESTION_LAST_SENT_ARRAY_SIZE);
+
+    if (sample->hold_rate) {
+        return;
+    }
+
+    long signed int total_sent = 0;
+    long signed int total_resent = 0;
+
+    // TODO(irungentoo): use real delay
+    unsigned int delay = (unsigned int)(((double)sample->min_rtt / CONGESTION_UPDATE_INTERVAL) + 0.5);
+    const unsigned int packets_set_rem_array = CONGESTION_LAST_SENT_ARRAY_SIZE - CONGESTION_QUEUE_ARRAY_SIZE;
+
+    if (delay > packets_set_rem_array) {
+        delay = packets_set_rem_array;
+    }
+
+    for (unsigned j = 0; j < CONGESTION_QUEUE_ARRAY_SIZE; ++j) {
+        const unsigned int ind = (j + (packets_set_rem_array  - delay) + n_p_pos) % CONGESTION_LAST_SENT_ARRAY_SIZE;
+        total_sent += state->last_num_packets_sent[ind];
+        total_resent += state->last_num_packets_resent[ind];
+    }
+
+    if (sum > 0) {
+        total_sent -= sum;
+    } else {
+        if (total_resent > -sum) {
+            total_resent = -sum;
+        }
+    }
+
+    Congestion_Delivered delivered;
+    delivered.sent = 1000.0 * (((double)total_sent) / ((double)CONGESTION_QUEUE_ARRAY_SIZE *
+                               CONGESTION_UPDATE_INTERVAL));
+    delivered.sent_and_resent = 1000.0 * (((double)(total_sent + total_resent)) / (
+            (double)CONGESTION_QUEUE_ARRAY_SIZE * CONGESTION_UPDATE_INTERVAL));
+
+    if (delivered.sent < CRYPTO_PACKET_MIN_RATE) {
+        delivered.sent = CRYPTO_PACKET_MIN_RATE;
+    }
+
+    cc->update(state, sample, &delivered);
+
+    if (state->send_rate < CRYPTO_PACKET_MIN_RATE) {
+        state->send_rate = CRYPTO_PACKET_MIN_RATE;
+    }
+
+    if (state->send_rate_requested < state->send_rate) {
+        state->send_rate_requested = state->send_rate;
+    }
+}
@@ -0,0 +1,156 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+/**
+ * Send rate controllers for net_crypto connections.
+ *
+ * Every `CONGESTION_UPDATE_INTERVAL` ms, net_crypto hands each established
+ * connection's controller a sample of what happened since the last update:
+ * how many packets were sent and resent, how long the send queue is, and the
+ * round trip times it measured. The controller then picks the packet rate the
+ * connection may send at.
+ *
+ * Two controllers exist:
+ *
+ * - `CONGESTION_CONTROL_QUEUE` is the original toxcore algorithm. It backs off
+ *   when the send queue grows faster than packets leave it and when the send
+ *   budget runs out.
+ * - `CONGESTION_CONTROL_DELAY` is a LEDBAT-like controller. It compares the
+ *   recent round trip time with the lowest one seen in the last
+ *   `CONGESTION_BASE_HISTORY_SIZE` minutes and steers the rate so that the
+ *   extra (queuing) delay stays near `CONGESTION_DELAY_TARGET`. Random packet
+ *   loss on its own does not slow it down.
+ */
+#ifndef C_TOXCORE_TOXCORE_CONGESTION_CONTROL_H
+#define C_TOXCORE_TOXCORE_CONGESTION_CONTROL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "attributes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Minimum packet rate per second. */
+#define CRYPTO_PACKET_MIN_RATE 4.0
+
+/** Minimum packet queue max length. */
+#define CRYPTO_MIN_QUEUE_LENGTH 64
+
+/** Interval in ms between two samples handed to a controller. */
+#define CONGESTION_UPDATE_INTERVAL 50
+
+/** Time in ms after a congestion event during which the rate is not raised. */
+#define CONGESTION_EVENT_TIMEOUT 1000
+
+/**
+ * Base current transfer speed on last CONGESTION_QUEUE_ARRAY_SIZE number of points taken
+ * at CONGESTION_UPDATE_INTERVAL.
+ */
+#define CONGESTION_QUEUE_ARRAY_SIZE 12
+#define CONGESTION_LAST_SENT_ARRAY_SIZE (CONGESTION_QUEUE_ARRAY_SIZE * 2)
+
+/** Queuing delay in ms the delay-based controller aims for. */
+#define CONGESTION_DELAY_TARGET 50
+
+/** Number of recent RTT samples the delay-based controller takes the minimum of. */
+#define CONGESTION_DELAY_FILTER_SIZE 4
+
+/**
+ * The delay-based controller keeps the lowest RTT of each
+ * CONGESTION_BASE_INTERVAL ms and takes the minimum of the last
+ * CONGESTION_BASE_HISTORY_SIZE of them as the delay of the empty path. Old
+ * minimums expire, so a route change to a longer path raises the base delay
+ * instead of looking like queuing delay forever.
+ */
+#define CONGESTION_BASE_INTERVAL 60000
+#define CONGESTION_BASE_HISTORY_SIZE 10
+
+typedef enum Congestion_Control_Algorithm {
+    CONGESTION_CONTROL_QUEUE,
+    CONGESTION_CONTROL_DELAY,
+} Congestion_Control_Algorithm;
+
+/** @brief What happened on a connection since the previous update. */
+typedef struct Congestion_Sample {
+    /** Current time in ms. */
+    uint64_t now;
+    /** Number of packets in the send queue. */
+    uint32_t send_queue_size;
+    /** New packets sent since the last update. */
+    uint32_t packets_sent;
+    /** Packets resent on request of the peer since the last update. */
+    uint32_t packets_resent;
+    /** Lowest round trip time ever measured on the connection. Never rises, so only the queue controller uses it. */
+    uint64_t min_rtt;
+    /** Lowest round trip time measured since the last update, 0 if there was none. */
+    uint64_t recent_rtt;
+    /** Time the send budget last ran out. */
+    uint64_t last_congestion_event;
+    /** Record the sample but leave the rates alone, e.g. right after switching from TCP to UDP. */
+    bool hold_rate;
+} Congestion_Sample;
+
+/** @brief Per-connection controller state. Zero-initialise, then call `congestion_state_init`. */
+typedef struct Congestion_State {
+    uint32_t last_sendqueue_size[CONGESTION_QUEUE_ARRAY_SIZE];
+    uint32_t last_sendqueue_counter;
+    long signed int last_num_packets_sent[CONGESTION_LAST_SENT_ARRAY_SIZE];
+    long signed int last_num_packets_resent[CONGESTION_LAST_SENT_ARRAY_SIZE];
+
+    /* Used by the delay-based controller only. */
+    uint64_t rtt_filter[CONGESTION_DELAY_FILTER_SIZE];
+    uint32_t rtt_filter_counter;
+    uint64_t base_history[CONGESTION_BASE_HISTORY_SIZE];
+    uint32_t base_history_counter;
+    uint64_t base_interval_start;
+    uint64_t last_decrease;
+
+    /** Packets per second the connection may send. */
+    double send_rate;
+    /** Packets per second the connection may send, including resent packets. */
+    double send_rate_requested;
+} Congestion_State;
+
+/** @brief Rates actually achieved over the sample history, in packets per second. */
+typedef struct Congestion_Delivered {
+    /** New packets sent, corrected for send queue growth. Never below CRYPTO_PACKET_MIN_RATE. */
+    double sent;
+    /** New and resent packets. */
+    double sent_and_resent;
+} Congestion_Delivered;
+
+/** @brief Pick new rates for a connection.
+ *
+ * Sets `state->send_rate` and `state->send_rate_requested`. The caller clamps
+ * both afterwards, so they may be set to anything.
+ */
+typedef void congestion_update_cb(Congestion_State *_Nonnull state, const Congestion_Sample *_Nonnull sample,
+                                  const Congestion_Delivered *_Nonnull delivered);
+
+typedef struct Congestion_Control {
+    const char *_Nonnull name;
+    congestion_update_cb *_Nonnull update;
+} Congestion_Control;
+
+/** @brief Look up the controller for an algorithm.
+ *
+ * Unknown values get the `CONGESTION_CONTROL_QUEUE` controller.
+ */
+const Congestion_Control *_Nonnull congestion_control_get(Congestion_Control_Algorithm algorithm);
+
+/** @brief Set a new connection's rates to the minimum. */
+void congestion_state_init(Congestion_State *_Nonnull state);
+
+/** @brief Record a sample and, unless it says to hold the rate, let the controller pick new rates. */
+void congestion_update(const Congestion_Control *_Nonnull cc, Congestion_State *_Nonnull state,
+                       const Congestion_Sample *_Nonnull sample);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* C_TOXCORE_TOXCORE_CONGESTION_CONTROL_H */
@@ -0,0 +1,142 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include "congestion_control.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+
+namespace {
+
+class CongestionControlTest : public ::testing::TestWithParam<Congestion_Control_Algorithm> {
+protected:
+    void SetUp() override
+    {
+        cc = congestion_control_get(GetParam());
+        congestion_state_init(&state);
+    }
+
+    /** @brief Feed `count` updates, each sending `sent` new and `resent` old packets. */
+    void run(int count, std::uint32_t sent, std::uint32_t resent, std::uint64_t recent_rtt)
+    {
+        for (int i = 0; i < count; ++i) {
+            now += CONGESTION_UPDATE_INTERVAL;
+
+            Congestion_Sample sample{};
+            sample.now = now;
+            sample.send_queue_size = 16;
+            sample.packets_sent = sent;
+            sample.packets_resent = resent;
+            sample.min_rtt = kMinRtt;
+            sample.recent_rtt = recent_rtt;
+            congestion_update(cc, &state, &sample);
+
+            EXPECT_GE(state.send_rate, CRYPTO_PACKET_MIN_RATE);
+            EXPECT_GE(state.send_rate_requested, state.send_rate);
+        }
+    }
+
+    static constexpr std::uint64_t kMinRtt = 20;
+
+    const Congestion_Control *cc = nullptr;
+    Congestion_State state{};
+    std::uint64_t now = 10000;
+};
+
+TEST_P(CongestionControlTest, StartsAtMinimumRate)
+{
+    EXPECT_EQ(state.send_rate, CRYPTO_PACKET_MIN_RATE);
+    EXPECT_EQ(state.send_rate_requested, CRYPTO_PACKET_MIN_RATE);
+}
+
+TEST_P(CongestionControlTest, HoldRateRecordsButKeepsRates)
+{
+    Congestion_Sample sample{};
+    sample.now = now;
+    sample.packets_sent = 100;
+    sample.min_rtt = kMinRtt;
+    sample.hold_rate = true;
+    congestion_update(cc, &state, &sample);
+
+    EXPECT_EQ(state.send_rate, CRYPTO_PACKET_MIN_RATE);
+    EXPECT_EQ(state.last_num_packets_sent[0], 100);
+}
+
+TEST_P(CongestionControlTest, RampsUpOnAnUncongestedPath)
+{
+    // 100 packets per 50ms update is 2000 packets per second.
+    run(60, 100, 0, kMinRtt);
+    EXPECT_GT(state.send_rate, 2000.0);
+}
+
+INSTANTIATE_TEST_SUITE_P(AllAlgorithms, CongestionControlTest,
+    ::testing::Values(CONGESTION_CONTROL_QUEUE, CONGESTION_CONTROL_DELAY),
+    [](const ::testing::TestParamInfo<Congestion_Control_Algorithm> &info) {
+        return std::string(congestion_control_get(info.param)->name);
+    });
+
+TEST(CongestionControl, UnknownAlgorithmFallsBackToQueue)
+{
+    EXPECT_EQ(congestion_control_get(static_cast<Congestion_Control_Algorithm>(100)),
+        congestion_control_get(CONGESTION_CONTROL_QUEUE));
+    EXPECT_NE(congestion_control_get(CONGESTION_CONTROL_DELAY),
+        congestion_control_get(CONGESTION_CONTROL_QUEUE));
+}
+
+class DelayControlTest : public CongestionControlTest { };
+
+TEST_P(DelayControlTest, BacksOffWhenQueuingDelayExceedsTarget)
+{
+    run(60, 100, 0, kMinRtt);
+    const double before = state.send_rate;
+
+    // The RTT filter needs a few samples before it sees the delay.
+    run(8, 100, 0, kMinRtt + 2 * CONGESTION_DELAY_TARGET);
+    EXPECT_LT(state.send_rate, before / 2);
+}
+
+TEST_P(DelayControlTest, HoldsRateAtTarget)
+{
+    run(60, 100, 0, kMinRtt);
+    const double before = state.send_rate;
+
+    run(5, 100, 0, kMinRtt + CONGESTION_DELAY_TARGET);
+    EXPECT_EQ(state.send_rate, before);
+}
+
+TEST_P(DelayControlTest, IgnoresLightRandomLoss)
+{
+    // One in 20 packets lost, but no queue builds up.
+    run(60, 100, 5, kMinRtt);
+    EXPECT_GT(state.send_rate, 2000.0);
+}
+
+TEST_P(DelayControlTest, BacksOffOnHeavyLoss)
+{
+    run(60, 100, 0, kMinRtt);
+    const double before = state.send_rate;
+
+    run(5, 100, 30, kMinRtt);
+    EXPECT_LT(state.send_rate, before);
+}
+
+TEST_P(DelayControlTest, RecoversAfterRouteChangeRaisesBaseDelay)
+{
+    run(60, 100, 0, kMinRtt);
+
+    // net_crypto keeps reporting the old, lower min_rtt after the path gets longer.
+    const std::uint64_t new_base = kMinRtt + 2 * CONGESTION_DELAY_TARGET;
+    run(8, 100, 0, new_base);
+    EXPECT_LT(state.send_rate, 2000.0);
+
+    // Once the old minimums expire, the longer path is the new base delay.
+    run((CONGESTION_BASE_HISTORY_SIZE + 1) * CONGESTION_BASE_INTERVAL / CONGESTION_UPDATE_INTERVAL, 100, 0, new_base);
+    EXPECT_GT(state.send_rate, 2000.0);
+}
+
+INSTANTIATE_TEST_SUITE_P(Delay, DelayControlTest, ::testing::Values(CONGESTION_CONTROL_DELAY));
+
+}  // namespace
@@ -12,7 +12,6 @@
 
 #include "attributes.h"
 #include "ccompat.h"
-#include "mem.h"
 #include "rng.h"
 #include "util.h"
 
@@ -88,29 +87,6 @@ const uint8_t *get_chat_id(const Extended_Public_Key *key)
     return key->sig;
 }
 
-#if !defined(FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION)
-static uint8_t *_Nullable crypto_malloc(const Memory *_Nonnull mem, size_t bytes)
-{
-    uint8_t *ptr = (uint8_t *)mem_balloc(mem, bytes);
-
-    if (ptr != nullptr) {
-        crypto_memlock(ptr, bytes);
-    }
-
-    return ptr;
-}
-
-static void crypto_free(const Memory *_Nonnull mem, uint8_t *_Nullable ptr, size_t bytes)
-{
-    if (ptr != nullptr) {
-        crypto_memzero(ptr, bytes);
-        crypto_memunlock(ptr, bytes);
-    }
-
-    mem_delete(mem, ptr);
-}
-#endif /* !defined(FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION) */
-
 void crypto_memzero(void *data, size_t length)
 {
 #if defined(FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION)
@@ -212,6 +188,22 @@ bool crypto_signature_verify(const uint8_t signature[CRYPTO_SIGNATURE_SIZE],
     return crypto_sign_verify_detached(signature, message, message_length, public_key) == 0;
 }
 
+uint32_t crypto_signature_verify_batch(const Crypto_Signature_Check *checks, uint32_t count, bool *valid)
+{
+    uint32_t num_valid = 0;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const Crypto_Signature_Check *check = &checks[i];
+        valid[i] = crypto_signature_verify(check->signature, check->message, check->message_length, check->public_key);
+
+        if (valid[i]) {
+            ++num_valid;
+        }
+    }
+
+    return num_valid;
+}
+
 bool public_key_valid(const uint8_t public_key[CRYPTO_PUBLIC_KEY_SIZE])
 {
     /* Last bit of key is always zero. */
@@ -241,44 +233,18 @@ int32_t encrypt_data_symmetric(const Memory *mem,
 
 #ifdef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
     // Don't encrypt anything.
-    memcpy(encrypted, plain, length);
+    memmove(encrypted, plain, length);
     // Zero MAC to avoid uninitialized memory reads.
     memzero(encrypted + length, crypto_box_MACBYTES);
 #else
 
-    const size_t size_temp_plain = length + crypto_box_ZEROBYTES;
-    const size_t size_temp_encrypted = length + crypto_box_MACBYTES + crypto_box_BOXZEROBYTES;
-
-    uint8_t *temp_plain = crypto_malloc(mem, size_temp_plain);
-    uint8_t *temp_encrypted = crypto_malloc(mem, size_temp_encrypted);
-
-    if (temp_plain == nullptr || temp_encrypted == nullptr) {
-        crypto_free(mem, temp_plain, size_temp_plain);
-        crypto_free(mem, temp_encrypted, size_temp_encrypted);
+    // The "easy" API writes the MAC followed by the ciphertext straight into
+    // the output, which is the same layout crypto_box_afternm produces after
+    // stripping its zero padding.
+    if (crypto_box_easy_afternm(encrypted, plain, length, nonce, shared_key) != 0) {
         return -1;
     }
 
-    // crypto_box_afternm requires the entire range of the output array be
-    // initialised with something. It doesn't matter what it's initialised with,
-    // so we'll pick 0x00.
-    memzero(temp_encrypted, size_temp_encrypted);
-
-    memzero(temp_plain, crypto_box_ZEROBYTES);
-    // Pad the message with 32 0 bytes.
-    memcpy(temp_plain + crypto_box_ZEROBYTES, plain, length);
-
-    if (crypto_box_afternm(temp_encrypted, temp_plain, length + crypto_box_ZEROBYTES, nonce,
-                           shared_key) != 0) {
-        crypto_free(mem, temp_plain, size_temp_plain);
-        crypto_free(mem, temp_encrypted, size_temp_encrypted);
-        return -1;
-    }
-
-    // Unpad the encrypted message.
-    memcpy(encrypted, temp_encrypted + crypto_box_BOXZEROBYTES, length + crypto_box_MACBYTES);
-
-    crypto_free(mem, temp_plain, size_temp_plain);
-    crypto_free(mem, temp_encrypted, size_temp_encrypted);
 #endif /* FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION */
     assert(length < INT32_MAX - crypto_box_MACBYTES);
     return (int32_t)(length + crypto_box_MACBYTES);
@@ -296,41 +262,13 @@ int32_t decrypt_data_symmetric(const Memory *mem,
 
 #ifdef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
     assert(length >= crypto_box_MACBYTES);
-    memcpy(plain, encrypted, length - crypto_box_MACBYTES);  // Don't encrypt anything
+    memmove(plain, encrypted, length - crypto_box_MACBYTES);  // Don't encrypt anything
 #else
 
-    const size_t size_temp_plain = length + crypto_box_ZEROBYTES;
-    const size_t size_temp_encrypted = length + crypto_box_BOXZEROBYTES;
-
-    uint8_t *temp_plain = crypto_malloc(mem, size_temp_plain);
-    uint8_t *temp_encrypted = crypto_malloc(mem, size_temp_encrypted);
-
-    if (temp_plain == nullptr || temp_encrypted == nullptr) {
-        crypto_free(mem, temp_plain, size_temp_plain);
-        crypto_free(mem, temp_encrypted, size_temp_encrypted);
-        return -1;
-    }
-
-    // crypto_box_open_afternm requires the entire range of the output array be
-    // initialised with something. It doesn't matter what it's initialised with,
-    // so we'll pick 0x00.
-    memzero(temp_plain, size_temp_plain);
-
-    memzero(temp_encrypted, crypto_box_BOXZEROBYTES);
-    // Pad the message with 16 0 bytes.
-    memcpy(temp_encrypted + crypto_box_BOXZEROBYTES, encrypted, length);
-
-    if (crypto_box_open_afternm(temp_plain, temp_encrypted, length + crypto_box_BOXZEROBYTES, nonce,
-                                shared_key) != 0) {
-        crypto_free(mem, temp_plain, size_temp_plain);
-        crypto_free(mem, temp_encrypted, size_temp_encrypted);
+    if (crypto_box_open_easy_afternm(plain, encrypted, length, nonce, shared_key) != 0) {
         return -1;
     }
 
-    memcpy(plain, temp_plain + crypto_box_ZEROBYTES, length - crypto_box_MACBYTES);
-
-    crypto_free(mem, temp_plain, size_temp_plain);
-    crypto_free(mem, temp_encrypted, size_temp_encrypted);
 #endif /* FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION */
     assert(length > crypto_box_MACBYTES);
     assert(length < INT32_MAX);
@@ -245,6 +245,29 @@ bool crypto_signature_create(uint8_t signature[_Nonnull CRYPTO_SIGNATURE_SIZE],
 bool crypto_signature_verify(const uint8_t signature[_Nonnull CRYPTO_SIGNATURE_SIZE], const uint8_t *_Nonnull message, uint64_t message_length,
                              const uint8_t public_key[_Nonnull SIG_PUBLIC_KEY_SIZE]);
 
+/** @brief A signature and the message and key it is checked against. */
+typedef struct Crypto_Signature_Check {
+    const uint8_t *_Nonnull signature;  // CRYPTO_SIGNATURE_SIZE bytes
+    const uint8_t *_Nonnull message;
+    uint64_t message_length;
+    const uint8_t *_Nonnull public_key;  // SIG_PUBLIC_KEY_SIZE bytes
+} Crypto_Signature_Check;
+
+/** @brief Verifies a number of signatures in one call.
+ *
+ * Every entry is checked, even after one fails, so that callers can tell
+ * which entries to reject. libsodium has no batch verification, so each
+ * signature is verified on its own, with the same result as
+ * `crypto_signature_verify`.
+ *
+ * @param checks The signatures to verify.
+ * @param count The number of entries in `checks` and `valid`.
+ * @param valid Set to whether the signature at the same index is valid.
+ *
+ * @return the number of valid signatures.
+ */
+uint32_t crypto_signature_verify_batch(const Crypto_Signature_Check *_Nonnull checks, uint32_t count, bool *_Nonnull valid);
+
 /**
  * @brief Fill the given nonce with random bytes.
  */
@@ -353,6 +376,9 @@ int32_t encrypt_precompute(const uint8_t public_key[_Nonnull CRYPTO_PUBLIC_KEY_S
  * using a shared key @ref CRYPTO_SYMMETRIC_KEY_SIZE big and a @ref CRYPTO_NONCE_SIZE
  * byte nonce.
  *
+ * Writes straight into `encrypted` without allocating, so `mem` is not used.
+ * `plain` and `encrypted` may overlap.
+ *
  * @retval -1 if there was a problem.
  * @return length of encrypted data if everything was fine.
  */
@@ -366,6 +392,10 @@ int32_t encrypt_data_symmetric(const Memory *_Nonnull mem, const uint8_t shared_
  * `length - CRYPTO_MAC_SIZE` using a shared key @ref CRYPTO_SYMMETRIC_KEY_SIZE
  * big and a @ref CRYPTO_NONCE_SIZE byte nonce.
  *
+ * Writes straight into `plain` without allocating, so `mem` is not used.
+ * `encrypted` and `plain` may overlap. Nothing is written if the MAC doesn't
+ * match.
+ *
  * @retval -1 if there was a problem (decryption failed).
  * @return length of plain data if everything was fine.
  */
@@ -0,0 +1,173 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include <benchmark/benchmark.h>
+#include <sodium.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "crypto_core.h"
+#include "mem.h"
+
+namespace {
+
+/** @brief A malloc-backed allocator that counts allocations. */
+struct CountingAllocator {
+    std::size_t allocations = 0;
+
+    static void *malloc_cb(void *self, std::uint32_t size)
+    {
+        ++static_cast<CountingAllocator *>(self)->allocations;
+        return std::malloc(size);
+    }
+
+    static void *realloc_cb(void *self, void *ptr, std::uint32_t size)
+    {
+        ++static_cast<CountingAllocator *>(self)->allocations;
+        return std::realloc(ptr, size);
+    }
+
+    static void dealloc_cb(void *self, void *ptr) { std::free(ptr); }
+};
+
+constexpr Memory_Funcs kCountingFuncs = {
+    CountingAllocator::malloc_cb,
+    CountingAllocator::realloc_cb,
+    CountingAllocator::dealloc_cb,
+};
+
+/**
+ * @brief What encrypt_data_symmetric used to do: copy the message into a
+ * zero-padded heap buffer for crypto_box_afternm and copy the result out.
+ *
+ * Kept here as the baseline for the allocation-free version.
+ */
+std::int32_t padded_encrypt(const Memory *mem, const std::uint8_t *shared_key, const std::uint8_t *nonce,
+    const std::uint8_t *plain, std::size_t length, std::uint8_t *encrypted)
+{
+    const std::size_t size_temp_plain = length + crypto_box_ZEROBYTES;
+    const std::size_t size_temp_encrypted = length + crypto_box_MACBYTES + crypto_box_BOXZEROBYTES;
+    auto *temp_plain = static_cast<std::uint8_t *>(mem_balloc(mem, size_temp_plain));
+    auto *temp_encrypted = static_cast<std::uint8_t *>(mem_balloc(mem, size_temp_encrypted));
+
+    std::memset(temp_encrypted, 0, size_temp_encrypted);
+    std::memset(temp_plain, 0, crypto_box_ZEROBYTES);
+    std::memcpy(temp_plain + crypto_box_ZEROBYTES, plain, length);
+    crypto_box_afternm(temp_encrypted, temp_plain, length + crypto_box_ZEROBYTES, nonce, shared_key);
+    std::memcpy(encrypted, temp_encrypted + crypto_box_BOXZEROBYTES, length + crypto_box_MACBYTES);
+
+    sodium_memzero(temp_plain, size_temp_plain);
+    sodium_memzero(temp_encrypted, size_temp_encrypted);
+    mem_delete(mem, temp_plain);
+    mem_delete(mem, temp_encrypted);
+    return static_cast<std::int32_t>(length + crypto_box_MACBYTES);
+}
+
+/** @brief The old decrypt_data_symmetric, as a baseline. */
+std::int32_t padded_decrypt(const Memory *mem, const std::uint8_t *shared_key, const std::uint8_t *nonce,
+    const std::uint8_t *encrypted, std::size_t length, std::uint8_t *plain)
+{
+    const std::size_t size_temp_plain = length + crypto_box_ZEROBYTES;
+    const std::size_t size_temp_encrypted = length + crypto_box_BOXZEROBYTES;
+    auto *temp_plain = static_cast<std::uint8_t *>(mem_balloc(mem, size_temp_plain));
+    auto *temp_encrypted = static_cast<std::uint8_t *>(mem_balloc(mem, size_temp_encrypted));
+
+    std::memset(temp_plain, 0, size_temp_plain);
+    std::memset(temp_encrypted, 0, crypto_box_BOXZEROBYTES);
+    std::memcpy(temp_encrypted + crypto_box_BOXZEROBYTES, encrypted, length);
+    const int ret = crypto_box_open_afternm(
+        temp_plain, temp_encrypted, length + crypto_box_BOXZEROBYTES, nonce, shared_key);
+    std::memcpy(plain, temp_plain + crypto_box_ZEROBYTES, length - crypto_box_MACBYTES);
+
+    sodium_memzero(temp_plain, size_temp_plain);
+    sodium_memzero(temp_encrypted, size_temp_encrypted);
+    mem_delete(mem, temp_plain);
+    mem_delete(mem, temp_encrypted);
+    return ret == 0 ? static_cast<std::int32_t>(length - crypto_box_MACBYTES) : -1;
+}
+
+void report(benchmark::State &state, const CountingAllocator &alloc, std::size_t length)
+{
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(length));
+    state.counters["allocs/packet"]
+        = static_cast<double>(alloc.allocations) / static_cast<double>(state.iterations());
+}
+
+/**
+ * @brief Encrypt one packet of `range(0)` bytes with a precomputed key.
+ *
+ * `range(1)` selects the implementation: 0 for encrypt_data_symmetric, 1 for
+ * the old zero-padding version with two heap buffers per packet.
+ */
+void BM_EncryptSymmetric(benchmark::State &state)
+{
+    const auto length = static_cast<std::size_t>(state.range(0));
+    const bool padded = state.range(1) != 0;
+
+    CountingAllocator alloc;
+    const Memory mem = {&kCountingFuncs, &alloc};
+
+    std::uint8_t shared_key[CRYPTO_SHARED_KEY_SIZE];
+    std::uint8_t nonce[CRYPTO_NONCE_SIZE];
+    randombytes_buf(shared_key, sizeof(shared_key));
+    randombytes_buf(nonce, sizeof(nonce));
+
+    std::vector<std::uint8_t> plain(length, 0x42);
+    std::vector<std::uint8_t> encrypted(length + CRYPTO_MAC_SIZE);
+
+    for (auto _ : state) {
+        const std::int32_t ret = padded
+            ? padded_encrypt(&mem, shared_key, nonce, plain.data(), length, encrypted.data())
+            : encrypt_data_symmetric(&mem, shared_key, nonce, plain.data(), length, encrypted.data());
+        benchmark::DoNotOptimize(ret);
+        benchmark::ClobberMemory();
+    }
+
+    report(state, alloc, length);
+}
+
+/** @brief Decrypt one packet of `range(0)` bytes; `range(1)` as above. */
+void BM_DecryptSymmetric(benchmark::State &state)
+{
+    const auto length = static_cast<std::size_t>(state.range(0));
+    const bool padded = state.range(1) != 0;
+
+    CountingAllocator alloc;
+    const Memory mem = {&kCountingFuncs, &alloc};
+
+    std::uint8_t shared_key[CRYPTO_SHARED_KEY_SIZE];
+    std::uint8_t nonce[CRYPTO_NONCE_SIZE];
+    randombytes_buf(shared_key, sizeof(shared_key));
+    randombytes_buf(nonce, sizeof(nonce));
+
+    std::vector<std::uint8_t> plain(length, 0x42);
+    std::vector<std::uint8_t> encrypted(length + CRYPTO_MAC_SIZE);
+    encrypt_data_symmetric(&mem, shared_key, nonce, plain.data(), length, encrypted.data());
+    alloc.allocations = 0;
+
+    for (auto _ : state) {
+        const std::int32_t ret = padded
+            ? padded_decrypt(&mem, shared_key, nonce, encrypted.data(), encrypted.size(), plain.data())
+            : decrypt_data_symmetric(&mem, shared_key, nonce, encrypted.data(), encrypted.size(), plain.data());
+        if (ret != static_cast<std::int32_t>(length)) {
+            state.SkipWithError("decryption failed");
+            break;
+        }
+        benchmark::ClobberMemory();
+    }
+
+    report(state, alloc, length);
+}
+
+BENCHMARK(BM_EncryptSymmetric)->ArgNames({"bytes", "padded"})->ArgsProduct({{64, 512, 1400}, {0, 1}});
+BENCHMARK(BM_DecryptSymmetric)->ArgNames({"bytes", "padded"})->ArgsProduct({{64, 512, 1400}, {0, 1}});
+
+}  // namespace
+
+BENCHMARK_MAIN();
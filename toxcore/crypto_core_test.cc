@@ -128,6 +128,45 @@ TEST(CryptoCore, Signatures)
     }
 }
 
+TEST(CryptoCore, BatchVerifyReportsEachSignature)
+{
+    SimulatedEnvironment env{12345};
+    auto c_rng = env.fake_random().c_random();
+
+    Extended_Public_Key pk;
+    Extended_Secret_Key sk;
+
+    EXPECT_TRUE(create_extended_keypair(&pk, &sk, &c_rng));
+
+    constexpr std::uint32_t count = 8;
+    std::vector<std::array<std::uint8_t, 16>> messages(count);
+    std::vector<Signature> signatures(count);
+    std::vector<Crypto_Signature_Check> checks;
+
+    for (std::uint32_t i = 0; i < count; ++i) {
+        random_bytes(&c_rng, messages[i].data(), messages[i].size());
+        EXPECT_TRUE(crypto_signature_create(
+            signatures[i].data(), messages[i].data(), messages[i].size(), get_sig_sk(&sk)));
+        checks.push_back(
+            {signatures[i].data(), messages[i].data(), messages[i].size(), get_sig_pk(&pk)});
+    }
+
+    bool valid[count];
+    EXPECT_EQ(crypto_signature_verify_batch(checks.data(), count, valid), count);
+
+    // Break two entries; every other entry is still checked and reported valid.
+    signatures[1][0] ^= 1;
+    messages[6][3] ^= 1;
+
+    EXPECT_EQ(crypto_signature_verify_batch(checks.data(), count, valid), count - 2);
+
+    for (std::uint32_t i = 0; i < count; ++i) {
+        EXPECT_EQ(valid[i], i != 1 && i != 6) << "entry " << i;
+    }
+
+    EXPECT_EQ(crypto_signature_verify_batch(checks.data(), 0, valid), 0);
+}
+
 TEST(CryptoCore, Hmac)
 {
     SimulatedEnvironment env{12345};
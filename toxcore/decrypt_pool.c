@@ -0,0 +1,227 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include "decrypt_pool.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "ccompat.h"
+
+typedef struct Decrypt_Worker {
+    Decrypt_Pool *_Nonnull pool;
+    pthread_t thread;
+    /* Share of the batch this worker decrypts: 1 .. num_workers. The calling
+     * thread takes share 0. */
+    uint16_t share;
+} Decrypt_Worker;
+
+struct Decrypt_Pool {
+    const Memory *_Nonnull mem;
+
+    uint16_t num_workers;
+    Decrypt_Worker *_Nullable workers;
+
+    pthread_mutex_t lock;
+    /* Signalled when a new batch is ready, or when the workers should stop. */
+    pthread_cond_t work_ready;
+    /* Signalled when the last worker finished its share. */
+    pthread_cond_t work_done;
+
+    /* The current batch. Only written under the lock while no worker runs. */
+    Decrypt_Job *_Nullable jobs;
+    uint32_t count;
+    /* Incremented for each batch handed to the workers. */
+    uint64_t generation;
+    /* Workers that haven't finished their share of the current batch. */
+    uint16_t pending;
+    bool stopping;
+};
+
+static void decrypt_jobs(const Memory *_Nonnull mem, Decrypt_Job *_Nonnull jobs, uint32_t first, uint32_t last)
+{
+    for (uint32_t i = first; i < last; ++i) {
+        Decrypt_Job *job = &jobs[i];
+        job->result = decrypt_data_symmetric(mem, job->shared_key, job->nonce, job->encrypted, job->length, job->plain);
+    }
+}
+
+/** Jobs [first, last) of `count` belong to `share` out of `shares`. */
+static void share_range(uint32_t count, uint32_t share, uint32_t shares, uint32_t *_Nonnull first, uint32_t *_Nonnull last)
+{
+    *first = (uint32_t)((uint64_t)count * share / shares);
+    *last = (uint32_t)((uint64_t)count * (share + 1) / shares);
+}
+
+static void *decrypt_worker_run(void *arg)
+{
+    Decrypt_Worker *worker = (Decrypt_Worker *)arg;
+    Decrypt_Pool *pool = worker->pool;
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+
+    while (true) {
+        while (!pool->stopping && pool->generation == seen) {
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+        }
+
+        if (pool->stopping) {
+            break;
+        }
+
+        seen = pool->generation;
+        Decrypt_Job *jobs = pool->jobs;
+        uint32_t first;
+        uint32_t last;
+        share_range(pool->count, worker->share, pool->num_workers + 1, &first, &last);
+        pthread_mutex_unlock(&pool->lock);
+
+        if (jobs != nullptr) {
+            decrypt_jobs(pool->mem, jobs, first, last);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        --pool->pending;
+
+        if (pool->pending == 0) {
+            pthread_cond_signal(&pool->work_done);
+        }
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+    return nullptr;
+}
+
+/** Stop and join the first `started` workers. */
+static void decrypt_pool_stop(Decrypt_Pool *_Nonnull pool, uint16_t started)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (uint16_t i = 0; i < started; ++i) {
+        pthread_join(pool->workers[i].thread, nullptr);
+    }
+}
+
+Decrypt_Pool *decrypt_pool_new(const Memory *mem, uint16_t num_workers)
+{
+    if (num_workers > DECRYPT_POOL_MAX_WORKERS) {
+        return nullptr;
+    }
+
+    Decrypt_Pool *pool = (Decrypt_Pool *)mem_alloc(mem, sizeof(Decrypt_Pool));
+
+    if (pool == nullptr) {
+        return nullptr;
+    }
+
+    pool->mem = mem;
+
+    if (num_workers == 0) {
+        return pool;
+    }
+
+    pool->workers = (Decrypt_Worker *)mem_valloc(mem, num_workers, sizeof(Decrypt_Worker));
+
+    if (pool->workers == nullptr) {
+        mem_delete(mem, pool);
+        return nullptr;
+    }
+
+    if (pthread_mutex_init(&pool->lock, nullptr) != 0) {
+        mem_delete(mem, pool->workers);
+        mem_delete(mem, pool);
+        return nullptr;
+    }
+
+    if (pthread_cond_init(&pool->work_ready, nullptr) != 0) {
+        pthread_mutex_destroy(&pool->lock);
+        mem_delete(mem, pool->workers);
+        mem_delete(mem, pool);
+        return nullptr;
+    }
+
+    if (pthread_cond_init(&pool->work_done, nullptr) != 0) {
+        pthread_cond_destroy(&pool->work_ready);
+        pthread_mutex_destroy(&pool->lock);
+        mem_delete(mem, pool->workers);
+        mem_delete(mem, pool);
+        return nullptr;
+    }
+
+    pool->num_workers = num_workers;
+
+    for (uint16_t i = 0; i < num_workers; ++i) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].share = i + 1;
+
+        if (pthread_create(&pool->workers[i].thread, nullptr, &decrypt_worker_run, &pool->workers[i]) != 0) {
+            decrypt_pool_stop(pool, i);
+            pool->num_workers = 0;
+            decrypt_pool_kill(pool);
+            return nullptr;
+        }
+    }
+
+    return pool;
+}
+
+void decrypt_pool_kill(Decrypt_Pool *pool)
+{
+    if (pool == nullptr) {
+        return;
+    }
+
+    if (pool->workers != nullptr) {
+        if (pool->num_workers != 0) {
+            decrypt_pool_stop(pool, pool->num_workers);
+        }
+
+        pthread_cond_destroy(&pool->work_done);
+        pthread_cond_destroy(&pool->work_ready);
+        pthread_mutex_destroy(&pool->lock);
+        mem_delete(pool->mem, pool->workers);
+    }
+
+    mem_delete(pool->mem, pool);
+}
+
+uint16_t decrypt_pool_num_workers(const Decrypt_Pool *pool)
+{
+    return pool->num_workers;
+}
+
+void decrypt_pool_run(Decrypt_Pool *pool, Decrypt_Job *jobs, uint32_t count)
+{
+    if (pool->num_workers == 0 || count < DECRYPT_POOL_MIN_PARALLEL_BATCH) {
+        decrypt_jobs(pool->mem, jobs, 0, count);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->jobs = jobs;
+    pool->count = count;
+    pool->pending = pool->num_workers;
+    ++pool->generation;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    uint32_t first;
+    uint32_t last;
+    share_range(count, 0, pool->num_workers + 1, &first, &last);
+    decrypt_jobs(pool->mem, jobs, first, last);
+
+    pthread_mutex_lock(&pool->lock);
+
+    while (pool->pending != 0) {
+        pthread_cond_wait(&pool->work_done, &pool->lock);
+    }
+
+    pool->jobs = nullptr;
+    pool->count = 0;
+    pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,67 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+/**
+ * Decrypt a batch of symmetrically encrypted packets, optionally spreading the
+ * work over a small pool of worker threads.
+ *
+ * Each job is independent: it carries its own key, nonce and buffers, so jobs
+ * can be decrypted in any order and on any thread. The caller sees the results
+ * once `decrypt_pool_run` returns and processes them in its own order.
+ */
+#ifndef C_TOXCORE_TOXCORE_DECRYPT_POOL_H
+#define C_TOXCORE_TOXCORE_DECRYPT_POOL_H
+
+#include <stdint.h>
+
+#include "attributes.h"
+#include "crypto_core.h"
+#include "mem.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Batches smaller than this are decrypted on the calling thread. */
+#define DECRYPT_POOL_MIN_PARALLEL_BATCH 8
+
+/** @brief Most worker threads a pool may have. */
+#define DECRYPT_POOL_MAX_WORKERS 16
+
+typedef struct Decrypt_Job {
+    uint8_t shared_key[CRYPTO_SHARED_KEY_SIZE];
+    uint8_t nonce[CRYPTO_NONCE_SIZE];
+    const uint8_t *_Nonnull encrypted;
+    uint16_t length;
+    /** Must have room for `length - CRYPTO_MAC_SIZE` bytes. */
+    uint8_t *_Nonnull plain;
+    /** Set by `decrypt_pool_run`: the result of decrypt_data_symmetric. */
+    int32_t result;
+} Decrypt_Job;
+
+typedef struct Decrypt_Pool Decrypt_Pool;
+
+/** @brief Create a pool with `num_workers` threads besides the caller's.
+ *
+ * With 0 workers, every batch is decrypted on the calling thread.
+ */
+Decrypt_Pool *_Nullable decrypt_pool_new(const Memory *_Nonnull mem, uint16_t num_workers);
+
+/** @brief Stop the worker threads and free the pool. */
+void decrypt_pool_kill(Decrypt_Pool *_Nullable pool);
+
+uint16_t decrypt_pool_num_workers(const Decrypt_Pool *_Nonnull pool);
+
+/** @brief Decrypt all `count` jobs and set their `result`.
+ *
+ * The calling thread takes a share of the jobs and returns once every worker
+ * has finished its share. Only one thread at a time may run a batch.
+ */
+void decrypt_pool_run(Decrypt_Pool *_Nonnull pool, Decrypt_Job *_Nonnull jobs, uint32_t count);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* C_TOXCORE_TOXCORE_DECRYPT_POOL_H */
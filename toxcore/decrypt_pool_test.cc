@@ -0,0 +1,120 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include "decrypt_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "crypto_core.h"
+#include "os_memory.h"
+#include "os_random.h"
+
+namespace {
+
+struct Sealed {
+    std::array<std::uint8_t, CRYPTO_SHARED_KEY_SIZE> key;
+    std::array<std::uint8_t, CRYPTO_NONCE_SIZE> nonce;
+    std::string message;
+    std::vector<std::uint8_t> encrypted;
+    std::vector<std::uint8_t> plain;
+};
+
+std::vector<Sealed> seal_messages(std::size_t count)
+{
+    const Random *rng = os_random();
+    std::vector<Sealed> sealed(count);
+
+    for (std::size_t i = 0; i < count; ++i) {
+        Sealed &s = sealed[i];
+        new_symmetric_key(rng, s.key.data());
+        random_nonce(rng, s.nonce.data());
+        s.message = "message " + std::to_string(i) + std::string(i % 50, '.');
+        s.encrypted.resize(s.message.size() + CRYPTO_MAC_SIZE);
+        s.plain.resize(s.message.size());
+        EXPECT_EQ(encrypt_data_symmetric(os_memory(), s.key.data(), s.nonce.data(),
+                      reinterpret_cast<const std::uint8_t *>(s.message.data()), s.message.size(),
+                      s.encrypted.data()),
+            static_cast<int32_t>(s.encrypted.size()));
+    }
+
+    return sealed;
+}
+
+std::vector<Decrypt_Job> make_jobs(std::vector<Sealed> &sealed)
+{
+    std::vector<Decrypt_Job> jobs(sealed.size());
+
+    for (std::size_t i = 0; i < sealed.size(); ++i) {
+        std::copy(sealed[i].key.begin(), sealed[i].key.end(), jobs[i].shared_key);
+        std::copy(sealed[i].nonce.begin(), sealed[i].nonce.end(), jobs[i].nonce);
+        jobs[i].encrypted = sealed[i].encrypted.data();
+        jobs[i].length = static_cast<std::uint16_t>(sealed[i].encrypted.size());
+        jobs[i].plain = sealed[i].plain.data();
+        jobs[i].result = -1;
+    }
+
+    return jobs;
+}
+
+class DecryptPoolTest : public ::testing::TestWithParam<std::uint16_t> { };
+
+TEST_P(DecryptPoolTest, DecryptsEveryJob)
+{
+    Decrypt_Pool *pool = decrypt_pool_new(os_memory(), GetParam());
+    ASSERT_NE(pool, nullptr);
+    EXPECT_EQ(decrypt_pool_num_workers(pool), GetParam());
+
+    // Several batches of different sizes, including ones too small to share.
+    for (const std::size_t count : {1, 7, 8, 33, 64, 3}) {
+        std::vector<Sealed> sealed = seal_messages(count);
+        std::vector<Decrypt_Job> jobs = make_jobs(sealed);
+
+        decrypt_pool_run(pool, jobs.data(), static_cast<std::uint32_t>(jobs.size()));
+
+        for (std::size_t i = 0; i < count; ++i) {
+            ASSERT_EQ(jobs[i].result, static_cast<int32_t>(sealed[i].message.size())) << i;
+            EXPECT_EQ(std::string(sealed[i].plain.begin(), sealed[i].plain.end()), sealed[i].message);
+        }
+    }
+
+    decrypt_pool_kill(pool);
+}
+
+TEST_P(DecryptPoolTest, ReportsFailedJobs)
+{
+    Decrypt_Pool *pool = decrypt_pool_new(os_memory(), GetParam());
+    ASSERT_NE(pool, nullptr);
+
+    std::vector<Sealed> sealed = seal_messages(16);
+    sealed[5].encrypted[0] ^= 1;
+    sealed[11].key[0] ^= 1;
+    std::vector<Decrypt_Job> jobs = make_jobs(sealed);
+
+    decrypt_pool_run(pool, jobs.data(), static_cast<std::uint32_t>(jobs.size()));
+
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+        if (i == 5 || i == 11) {
+            EXPECT_EQ(jobs[i].result, -1) << i;
+        } else {
+            EXPECT_EQ(jobs[i].result, static_cast<int32_t>(sealed[i].message.size())) << i;
+        }
+    }
+
+    decrypt_pool_kill(pool);
+}
+
+INSTANTIATE_TEST_SUITE_P(Workers, DecryptPoolTest, ::testing::Values(0, 1, 3));
+
+TEST(DecryptPool, RejectsTooManyWorkers)
+{
+    EXPECT_EQ(decrypt_pool_new(os_memory(), DECRYPT_POOL_MAX_WORKERS + 1), nullptr);
+}
+
+}  // namespace
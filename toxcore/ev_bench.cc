@@ -5,12 +5,14 @@
 #include <benchmark/benchmark.h>
 
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <vector>
 
 #include "ev_test_util.hh"
 #include "logger.h"
 #include "net.h"
+#include "network.h"
 #include "os_event.h"
 #include "os_memory.h"
 #include "os_network.h"
@@ -148,6 +150,107 @@ BENCHMARK_REGISTER_F(EvBenchSocketsFixture, EventLoopMultipleActive)
     ->Args({1024, 100})
     ->Args({1024, 1024});
 
+/**
+ * @brief Bind a non-blocking UDP socket on the loopback interface.
+ *
+ * @return the bound port (in network byte order), or 0 on failure.
+ */
+std::uint16_t bind_udp_loopback(const Network *ns, Socket sock)
+{
+    if (ns_socket_nonblock(ns, sock, true) != 0) {
+        return 0;
+    }
+
+    IP_Port addr{};
+    ip_init(&addr.ip, false);
+    addr.ip.ip.v4.uint32 = net_htonl(0x7F000001);
+
+    for (std::uint16_t port = 33600; port < 33700; ++port) {
+        addr.port = net_htons(port);
+        if (ns_bind(ns, sock, &addr) == 0) {
+            return addr.port;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief UDP loopback throughput using the batched send/receive functions.
+ *
+ * The argument is the number of datagrams per ns_sendmmsg/ns_recvmmsg call.
+ * A batch size of 1 is equivalent to one sendto/recvfrom per datagram.
+ */
+void BM_UdpBatch(benchmark::State &state)
+{
+    const std::size_t batch = state.range(0);
+    const Network *ns = os_network();
+
+    if (ns == nullptr) {
+        state.SkipWithError("os_network failed");
+        return;
+    }
+
+    const Socket tx = ns_socket(ns, TOX_AF_INET, TOX_SOCK_DGRAM, TOX_PROTO_UDP);
+    const Socket rx = ns_socket(ns, TOX_AF_INET, TOX_SOCK_DGRAM, TOX_PROTO_UDP);
+    const std::uint16_t rx_port = bind_udp_loopback(ns, rx);
+
+    if (rx_port == 0 || ns_socket_nonblock(ns, tx, true) != 0) {
+        state.SkipWithError("failed to set up UDP sockets");
+        ns_close(ns, tx);
+        ns_close(ns, rx);
+        return;
+    }
+
+    IP_Port dest{};
+    ip_init(&dest.ip, false);
+    dest.ip.ip.v4.uint32 = net_htonl(0x7F000001);
+    dest.port = rx_port;
+
+    constexpr std::size_t packet_size = 512;
+    std::vector<std::uint8_t> send_buf(packet_size, 'x');
+    std::vector<std::uint8_t> recv_buf(batch * MAX_UDP_PACKET_SIZE);
+    std::vector<Net_Send_Msg> send_msgs(batch, Net_Send_Msg{send_buf.data(), packet_size, dest});
+    std::vector<Net_Recv_Msg> recv_msgs(batch);
+
+    for (std::size_t i = 0; i < batch; ++i) {
+        recv_msgs[i].buf = &recv_buf[i * MAX_UDP_PACKET_SIZE];
+        recv_msgs[i].size = MAX_UDP_PACKET_SIZE;
+    }
+
+    for (auto _ : state) {
+        std::size_t sent = 0;
+        while (sent < batch) {
+            const int n = ns_sendmmsg(ns, tx, &send_msgs[sent], batch - sent);
+            if (n <= 0) {
+                break;
+            }
+            sent += n;
+        }
+
+        std::size_t received = 0;
+        for (int tries = 0; received < sent && tries < 1000; ++tries) {
+            const int n = ns_recvmmsg(ns, rx, &recv_msgs[0], sent - received);
+            if (n > 0) {
+                received += n;
+            }
+        }
+
+        if (sent != batch || received != sent) {
+            state.SkipWithError("lost datagrams on loopback");
+            break;
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * batch);
+    state.SetBytesProcessed(state.iterations() * batch * packet_size);
+
+    ns_close(ns, tx);
+    ns_close(ns, rx);
+}
+
+BENCHMARK(BM_UdpBatch)->Arg(1)->Arg(8)->Arg(32)->Arg(64);
+
 }  // namespace
 
 BENCHMARK_MAIN();
@@ -24,10 +24,15 @@
 #include "onion.h"
 #include "onion_announce.h"
 #include "onion_client.h"
+#include "pk_index.h"
+#include "timer_wheel.h"
 #include "util.h"
 
 #define PORTS_PER_DISCOVERY 10
 
+/** Work that failed (sending a ping, starting a connection) is retried this often, in ms. */
+#define FRIEND_CONN_RETRY_INTERVAL 50
+
 typedef struct Friend_Conn_Callbacks {
     fc_status_cb *_Nullable status_callback;
     fc_data_cb *_Nullable data_callback;
@@ -80,12 +85,21 @@ struct Friend_Connections {
     Friend_Conn *_Nullable conns;
     uint32_t num_cons;
 
+    /* Maps the real public key of each friend connection to its id. */
+    PK_Index *_Nonnull conns_by_pk;
+
+    /* When each connection next has timed work to do, keyed by friendcon_id. */
+    Timer_Wheel *_Nonnull timers;
+
     fr_request_cb *_Nullable fr_request_callback;
     void *_Nullable fr_request_object;
 
     global_status_cb *_Nullable global_status_callback;
     void *_Nullable global_status_callback_object;
 
+    fc_peer_cb *_Nullable peer_callback;
+    void *_Nullable peer_callback_object;
+
     uint64_t last_lan_discovery;
     uint16_t next_lan_port;
 
@@ -176,6 +190,8 @@ static int wipe_friend_conn(Friend_Connections *_Nonnull fr_c, int friendcon_id)
         return -1;
     }
 
+    pk_index_remove(fr_c->conns_by_pk, fr_c->conns[friendcon_id].real_public_key);
+    timer_wheel_cancel(fr_c->timers, (uint32_t)friendcon_id);
     fr_c->conns[friendcon_id] = empty_friend_conn;
 
     uint32_t i;
@@ -203,23 +219,31 @@ Friend_Conn *get_conn(const Friend_Connections *fr_c, int friendcon_id)
     return &fr_c->conns[friendcon_id];
 }
 
+/** @brief Have `do_friend_connections` look at this connection on its next run.
+ *
+ * Called whenever the connection's state or timestamps change in a way that
+ * can bring its next timed work forward.
+ */
+static void wake_friend_conn(const Friend_Connections *_Nonnull fr_c, int friendcon_id)
+{
+    if (!timer_wheel_wake(fr_c->timers, (uint32_t)friendcon_id)) {
+        LOGGER_ERROR(fr_c->logger, "could not schedule friend connection %d", friendcon_id);
+    }
+}
+
 /**
  * @return friendcon_id corresponding to the real public key on success.
  * @retval -1 on failure.
  */
 int getfriend_conn_id_pk(const Friend_Connections *fr_c, const uint8_t *real_pk)
 {
-    for (uint32_t i = 0; i < fr_c->num_cons; ++i) {
-        const Friend_Conn *friend_con = get_conn(fr_c, i);
+    const int64_t friendcon_id = pk_index_get(fr_c->conns_by_pk, real_pk);
 
-        if (friend_con != nullptr) {
-            if (pk_equal(friend_con->real_public_key, real_pk)) {
-                return i;
-            }
-        }
+    if (friendcon_id == -1 || get_conn(fr_c, (int)friendcon_id) == nullptr) {
+        return -1;
     }
 
-    return -1;
+    return (int)friendcon_id;
 }
 
 /** @brief Add a TCP relay associated to the friend.
@@ -354,6 +378,7 @@ static void dht_ip_callback(void *_Nonnull object, int32_t number, const IP_Port
     set_direct_ip_port(fr_c->net_crypto, friend_con->crypt_connection_id, ip_port, true);
     friend_con->dht_ip_port = *ip_port;
     friend_con->dht_ip_port_lastrecv = mono_time_get(fr_c->mono_time);
+    wake_friend_conn(fr_c, number);
 
     if (friend_con->hosting_tcp_relay) {
         friend_add_tcp_relay(fr_c, number, ip_port, friend_con->dht_temp_pk);
@@ -381,6 +406,7 @@ static void change_dht_pk(Friend_Connections *_Nonnull fr_c, int friendcon_id, c
 
     dht_addfriend(fr_c->dht, dht_public_key, dht_ip_callback, fr_c, friendcon_id, &friend_con->dht_lock_token);
     memcpy(friend_con->dht_temp_pk, dht_public_key, CRYPTO_PUBLIC_KEY_SIZE);
+    wake_friend_conn(fr_c, friendcon_id);
 }
 
 static int handle_status(void *_Nonnull object, int id, bool status, void *_Nullable userdata)
@@ -412,6 +438,8 @@ static int handle_status(void *_Nonnull object, int id, bool status, void *_Null
         friend_con->hosting_tcp_relay = false;
     }
 
+    wake_friend_conn(fr_c, id);
+
     if (status_changed) {
         if (fr_c->global_status_callback != nullptr) {
             fr_c->global_status_callback(fr_c->global_status_callback_object, id, status, userdata);
@@ -575,6 +603,7 @@ static int handle_new_connections(void *_Nonnull object, const New_Connection *_
     } else {
         friend_con->dht_ip_port = n_c->source;
         friend_con->dht_ip_port_lastrecv = mono_time_get(fr_c->mono_time);
+        wake_friend_conn(fr_c, friendcon_id);
     }
 
     if (!pk_equal(friend_con->dht_temp_pk, n_c->dht_public_key)) {
@@ -792,6 +821,11 @@ int new_friend_connection(Friend_Connections *fr_c, const uint8_t *real_public_k
         return -1;
     }
 
+    if (!pk_index_add(fr_c->conns_by_pk, real_public_key, (uint32_t)friendcon_id)) {
+        onion_delfriend(fr_c->onion_c, onion_friendnum);
+        return -1;
+    }
+
     Friend_Conn *const friend_con = &fr_c->conns[friendcon_id];
 
     friend_con->crypt_connection_id = -1;
@@ -801,6 +835,11 @@ int new_friend_connection(Friend_Connections *fr_c, const uint8_t *real_public_k
 
     recv_tcp_relay_handler(fr_c->onion_c, onion_friendnum, &tcp_relay_node_callback, fr_c, friendcon_id);
     onion_dht_pk_callback(fr_c->onion_c, onion_friendnum, &dht_pk_callback, fr_c, friendcon_id);
+    wake_friend_conn(fr_c, friendcon_id);
+
+    if (fr_c->peer_callback != nullptr) {
+        fr_c->peer_callback(fr_c->peer_callback_object, real_public_key, true);
+    }
 
     return friendcon_id;
 }
@@ -831,9 +870,19 @@ int kill_friend_connection(Friend_Connections *fr_c, int friendcon_id)
         friend_con->dht_lock_token = 0;
     }
 
+    if (fr_c->peer_callback != nullptr) {
+        fr_c->peer_callback(fr_c->peer_callback_object, friend_con->real_public_key, false);
+    }
+
     return wipe_friend_conn(fr_c, friendcon_id);
 }
 
+void set_friend_connection_peer_callback(Friend_Connections *fr_c, fc_peer_cb *peer_callback, void *object)
+{
+    fr_c->peer_callback = peer_callback;
+    fr_c->peer_callback_object = object;
+}
+
 /** @brief Set friend request callback.
  *
  * This function will be called every time a friend request packet is received.
@@ -889,9 +938,120 @@ int send_friend_request_packet(Friend_Connections *fr_c, int friendcon_id, uint3
     return num;
 }
 
+/** @brief The time in ms at which `timestamp < mono_time_get()` becomes true.
+ *
+ * The timers below compare whole seconds, so each one fires at the start of
+ * the second after it runs out.
+ */
+static uint64_t seconds_passed_at(uint64_t timestamp)
+{
+    return (timestamp + 1) * 1000;
+}
+
+/** @brief Do the timed work for one connection: time out its DHT info, start
+ * a connection, send pings and relays, or give up on it.
+ */
+static void do_friend_connection(Friend_Connections *_Nonnull fr_c, int friendcon_id, void *_Nullable userdata)
+{
+    Friend_Conn *const friend_con = get_conn(fr_c, friendcon_id);
+
+    if (friend_con == nullptr) {
+        return;
+    }
+
+    const uint64_t temp_time = mono_time_get(fr_c->mono_time);
+
+    if (friend_con->status == FRIENDCONN_STATUS_CONNECTING) {
+        if (friend_con->dht_pk_lastrecv + FRIEND_DHT_TIMEOUT < temp_time) {
+            if (friend_con->dht_lock_token > 0) {
+                dht_delfriend(fr_c->dht, friend_con->dht_temp_pk, friend_con->dht_lock_token);
+                friend_con->dht_lock_token = 0;
+                memzero(friend_con->dht_temp_pk, CRYPTO_PUBLIC_KEY_SIZE);
+            }
+        }
+
+        if (friend_con->dht_ip_port_lastrecv + FRIEND_DHT_TIMEOUT < temp_time) {
+            friend_con->dht_ip_port.ip.family = net_family_unspec();
+        }
+
+        if (friend_con->dht_lock_token > 0) {
+            if (friend_new_connection(fr_c, friendcon_id) == 0) {
+                set_direct_ip_port(fr_c->net_crypto, friend_con->crypt_connection_id, &friend_con->dht_ip_port, false);
+                connect_to_saved_tcp_relays(fr_c, friendcon_id, MAX_FRIEND_TCP_CONNECTIONS / 2); /* Only fill it half up. */
+            }
+        }
+    } else if (friend_con->status == FRIENDCONN_STATUS_CONNECTED) {
+        if (friend_con->ping_lastsent + FRIEND_PING_INTERVAL < temp_time) {
+            send_ping(fr_c, friendcon_id);
+        }
+
+        if (friend_con->share_relays_lastsent + SHARE_RELAYS_INTERVAL < temp_time) {
+            send_relays(fr_c, friendcon_id);
+        }
+
+        if (friend_con->ping_lastrecv + FRIEND_CONNECTION_TIMEOUT < temp_time) {
+            /* If we stopped receiving ping packets, kill it. */
+            crypto_kill(fr_c->net_crypto, friend_con->crypt_connection_id);
+            friend_con->crypt_connection_id = -1;
+            handle_status(fr_c, friendcon_id, false, userdata); /* Going offline. */
+        }
+    }
+}
+
+/** @brief When `do_friend_connection` next has work for this connection, in ms.
+ *
+ * @return TIMER_WHEEL_NO_DEADLINE if nothing will happen until its state changes.
+ */
+static uint64_t friend_conn_deadline(const Friend_Connections *_Nonnull fr_c, const Friend_Conn *_Nonnull friend_con)
+{
+    uint64_t deadline = TIMER_WHEEL_NO_DEADLINE;
+
+    if (friend_con->status == FRIENDCONN_STATUS_CONNECTING) {
+        if (friend_con->dht_lock_token > 0) {
+            if (friend_con->crypt_connection_id == -1) {
+                /* friend_new_connection failed. */
+                return mono_time_get_ms(fr_c->mono_time) + FRIEND_CONN_RETRY_INTERVAL;
+            }
+
+            deadline = min_u64(deadline, seconds_passed_at(friend_con->dht_pk_lastrecv + FRIEND_DHT_TIMEOUT));
+        }
+
+        if (!net_family_is_unspec(friend_con->dht_ip_port.ip.family)) {
+            deadline = min_u64(deadline, seconds_passed_at(friend_con->dht_ip_port_lastrecv + FRIEND_DHT_TIMEOUT));
+        }
+    } else if (friend_con->status == FRIENDCONN_STATUS_CONNECTED) {
+        deadline = min_u64(deadline, seconds_passed_at(friend_con->ping_lastsent + FRIEND_PING_INTERVAL));
+        deadline = min_u64(deadline, seconds_passed_at(friend_con->share_relays_lastsent + SHARE_RELAYS_INTERVAL));
+        deadline = min_u64(deadline, seconds_passed_at(friend_con->ping_lastrecv + FRIEND_CONNECTION_TIMEOUT));
+    }
+
+    /* Anything still due is work that failed, e.g. a ping that could not be sent. */
+    return max_u64(deadline, mono_time_get_ms(fr_c->mono_time) + FRIEND_CONN_RETRY_INTERVAL);
+}
+
+static void friend_conn_timer(void *_Nonnull object, uint32_t id, void *_Nullable userdata)
+{
+    Friend_Connections *const fr_c = (Friend_Connections *)object;
+
+    do_friend_connection(fr_c, (int)id, userdata);
+
+    /* The status callbacks may have killed the connection. */
+    const Friend_Conn *const friend_con = get_conn(fr_c, (int)id);
+
+    if (friend_con == nullptr || timer_wheel_is_scheduled(fr_c->timers, id)) {
+        return;
+    }
+
+    const uint64_t deadline = friend_conn_deadline(fr_c, friend_con);
+
+    if (deadline != TIMER_WHEEL_NO_DEADLINE && !timer_wheel_schedule(fr_c->timers, id, deadline)) {
+        LOGGER_ERROR(fr_c->logger, "could not schedule friend connection %u", id);
+    }
+}
+
 /** Create new friend_connections instance. */
 Friend_Connections *new_friend_connections(
-    const Logger *logger, const Memory *mem, const Mono_Time *mono_time, const Network *ns,
+    const Logger *logger, const Memory *mem, const Random *rng, const Mono_Time *mono_time, const Network *ns,
     Onion_Client *onion_c, DHT *dht, Net_Crypto *net_crypto, Networking_Core *net,
     bool local_discovery_enabled)
 {
@@ -905,6 +1065,21 @@ Friend_Connections *new_friend_connections(
         return nullptr;
     }
 
+    temp->conns_by_pk = pk_index_new(mem, rng);
+
+    if (temp->conns_by_pk == nullptr) {
+        mem_delete(mem, temp);
+        return nullptr;
+    }
+
+    temp->timers = timer_wheel_new(mem, mono_time, &friend_conn_timer, temp);
+
+    if (temp->timers == nullptr) {
+        pk_index_kill(temp->conns_by_pk);
+        mem_delete(mem, temp);
+        return nullptr;
+    }
+
     temp->local_discovery_enabled = local_discovery_enabled;
 
     if (temp->local_discovery_enabled) {
@@ -960,55 +1135,24 @@ static void lan_discovery(Friend_Connections *_Nonnull fr_c)
 /** main friend_connections loop. */
 void do_friend_connections(Friend_Connections *fr_c, void *userdata)
 {
-    const uint64_t temp_time = mono_time_get(fr_c->mono_time);
-
-    for (uint32_t i = 0; i < fr_c->num_cons; ++i) {
-        Friend_Conn *const friend_con = get_conn(fr_c, i);
-
-        if (friend_con != nullptr) {
-            if (friend_con->status == FRIENDCONN_STATUS_CONNECTING) {
-                if (friend_con->dht_pk_lastrecv + FRIEND_DHT_TIMEOUT < temp_time) {
-                    if (friend_con->dht_lock_token > 0) {
-                        dht_delfriend(fr_c->dht, friend_con->dht_temp_pk, friend_con->dht_lock_token);
-                        friend_con->dht_lock_token = 0;
-                        memzero(friend_con->dht_temp_pk, CRYPTO_PUBLIC_KEY_SIZE);
-                    }
-                }
-
-                if (friend_con->dht_ip_port_lastrecv + FRIEND_DHT_TIMEOUT < temp_time) {
-                    friend_con->dht_ip_port.ip.family = net_family_unspec();
-                }
-
-                if (friend_con->dht_lock_token > 0) {
-                    if (friend_new_connection(fr_c, i) == 0) {
-                        set_direct_ip_port(fr_c->net_crypto, friend_con->crypt_connection_id, &friend_con->dht_ip_port, false);
-                        connect_to_saved_tcp_relays(fr_c, i, MAX_FRIEND_TCP_CONNECTIONS / 2); /* Only fill it half up. */
-                    }
-                }
-            } else if (friend_con->status == FRIENDCONN_STATUS_CONNECTED) {
-                if (friend_con->ping_lastsent + FRIEND_PING_INTERVAL < temp_time) {
-                    send_ping(fr_c, i);
-                }
-
-                if (friend_con->share_relays_lastsent + SHARE_RELAYS_INTERVAL < temp_time) {
-                    send_relays(fr_c, i);
-                }
-
-                if (friend_con->ping_lastrecv + FRIEND_CONNECTION_TIMEOUT < temp_time) {
-                    /* If we stopped receiving ping packets, kill it. */
-                    crypto_kill(fr_c->net_crypto, friend_con->crypt_connection_id);
-                    friend_con->crypt_connection_id = -1;
-                    handle_status(fr_c, i, false, userdata); /* Going offline. */
-                }
-            }
-        }
-    }
+    timer_wheel_run(fr_c->timers, userdata);
 
     if (fr_c->local_discovery_enabled) {
         lan_discovery(fr_c);
     }
 }
 
+uint64_t friend_connections_next_deadline(const Friend_Connections *fr_c)
+{
+    uint64_t deadline = timer_wheel_next_deadline(fr_c->timers);
+
+    if (fr_c->local_discovery_enabled && fr_c->broadcast != nullptr) {
+        deadline = min_u64(deadline, seconds_passed_at(fr_c->last_lan_discovery + LAN_DISCOVERY_INTERVAL));
+    }
+
+    return deadline;
+}
+
 /** Free everything related with friend_connections. */
 void kill_friend_connections(Friend_Connections *fr_c)
 {
@@ -1026,5 +1170,7 @@ void kill_friend_connections(Friend_Connections *fr_c)
     }
 
     lan_discovery_kill(fr_c->broadcast);
+    timer_wheel_kill(fr_c->timers);
+    pk_index_kill(fr_c->conns_by_pk);
     mem_delete(fr_c->mem, fr_c);
 }
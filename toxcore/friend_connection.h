@@ -14,6 +14,7 @@
 
 #include "DHT.h"
 #include "attributes.h"
+#include "crypto_core.h"
 #include "logger.h"
 #include "mem.h"
 #include "mono_time.h"
@@ -149,14 +150,31 @@ typedef int fr_request_cb(
  */
 void set_friend_request_callback(Friend_Connections *_Nonnull fr_c, fr_request_cb *_Nullable fr_request_callback, void *_Nullable object);
 
+typedef void fc_peer_cb(void *_Nullable object, const uint8_t *_Nonnull real_public_key, bool added);
+
+/** @brief Set the callback for when a friend connection for a peer is made or killed.
+ *
+ * A host uses it to send the handshakes of a peer to the instance that knows it.
+ */
+void set_friend_connection_peer_callback(Friend_Connections *_Nonnull fr_c, fc_peer_cb *_Nullable peer_callback, void *_Nullable object);
+
 /** Create new friend_connections instance. */
-Friend_Connections *_Nullable new_friend_connections(const Logger *_Nonnull logger, const Memory *_Nonnull mem, const Mono_Time *_Nonnull mono_time, const Network *_Nonnull ns,
+Friend_Connections *_Nullable new_friend_connections(const Logger *_Nonnull logger, const Memory *_Nonnull mem, const Random *_Nonnull rng, const Mono_Time *_Nonnull mono_time, const Network *_Nonnull ns,
         Onion_Client *_Nonnull onion_c, DHT *_Nonnull dht, Net_Crypto *_Nonnull net_crypto, Networking_Core *_Nonnull net,
         bool local_discovery_enabled);
 
 /** main friend_connections loop. */
 void do_friend_connections(Friend_Connections *_Nonnull fr_c, void *_Nullable userdata);
 
+/** @brief The time in ms (see `mono_time_get_ms`) at which `do_friend_connections` next has work to do.
+ *
+ * Connections register their deadlines in a timing wheel, so
+ * `do_friend_connections` only looks at the ones that are due.
+ *
+ * @return UINT64_MAX if there is nothing to do until something changes.
+ */
+uint64_t friend_connections_next_deadline(const Friend_Connections *_Nonnull fr_c);
+
 /** Free everything related with friend_connections. */
 void kill_friend_connections(Friend_Connections *_Nullable fr_c);
 typedef struct Friend_Conn Friend_Conn;
@@ -66,7 +66,7 @@ public:
         // Setup Friend Connections
         friend_connections_.reset(
             new_friend_connections(dht_wrapper_.logger(), &dht_wrapper_.node().c_memory,
-                dht_wrapper_.mono_time(), &dht_wrapper_.node().c_network, onion_client_.get(),
+                &dht_wrapper_.node().c_random, dht_wrapper_.mono_time(), &dht_wrapper_.node().c_network, onion_client_.get(),
                 dht_wrapper_.get_dht(), net_crypto_.get(), dht_wrapper_.networking(), true));
     }
 
@@ -15,26 +15,77 @@
 #include "mem.h"
 #include "mono_time.h"
 #include "network.h"
+#include "pk_index.h"
 
-/**
- * Removes `announces` from `gc_announces_list`.
- */
-static void remove_announces(GC_Announces_List *_Nonnull gc_announces_list, GC_Announces *_Nonnull announces)
+static_assert(CHAT_ID_SIZE == CRYPTO_PUBLIC_KEY_SIZE, "Chat IDs are hashed like public keys");
+static_assert(GCA_EXPIRY_WHEEL_SLOTS > GCA_ANNOUNCE_SAVE_TIMEOUT, "Expiry wheel must span the announce timeout");
+
+/* Smallest hash table size. Must be a power of 2. */
+#define GCA_MIN_BUCKETS 64
+
+static uint32_t gca_bucket(const GC_Announces_List *_Nonnull gc_announces_list, const uint8_t *_Nonnull chat_id)
 {
-    if (announces == nullptr || gc_announces_list == nullptr) {
-        return;
+    return (uint32_t)pk_index_hash(gc_announces_list->seed, chat_id) & (gc_announces_list->num_buckets - 1);
+}
+
+static uint64_t gca_expiry(const GC_Announces *_Nonnull announces)
+{
+    return announces->last_announce_received_timestamp + GCA_ANNOUNCE_SAVE_TIMEOUT;
+}
+
+static GC_Announces *_Nullable *_Nonnull gca_wheel_slot(GC_Announces_List *_Nonnull gc_announces_list, uint64_t time)
+{
+    return &gc_announces_list->expiry_wheel[time % GCA_EXPIRY_WHEEL_SLOTS];
+}
+
+/** Puts `announces` into the wheel slot for its expiry time. */
+static void wheel_link(GC_Announces_List *_Nonnull gc_announces_list, GC_Announces *_Nonnull announces)
+{
+    GC_Announces **slot = gca_wheel_slot(gc_announces_list, gca_expiry(announces));
+
+    announces->prev_announce = nullptr;
+    announces->next_announce = *slot;
+
+    if (*slot != nullptr) {
+        (*slot)->prev_announce = announces;
     }
 
+    *slot = announces;
+}
+
+/** Takes `announces` out of its wheel slot. Must be called before its timestamp changes. */
+static void wheel_unlink(GC_Announces_List *_Nonnull gc_announces_list, GC_Announces *_Nonnull announces)
+{
     if (announces->prev_announce != nullptr) {
         announces->prev_announce->next_announce = announces->next_announce;
     } else {
-        gc_announces_list->root_announces = announces->next_announce;
+        *gca_wheel_slot(gc_announces_list, gca_expiry(announces)) = announces->next_announce;
     }
 
     if (announces->next_announce != nullptr) {
         announces->next_announce->prev_announce = announces->prev_announce;
     }
 
+    announces->next_announce = nullptr;
+    announces->prev_announce = nullptr;
+}
+
+/**
+ * Removes `announces` from `gc_announces_list`.
+ */
+static void remove_announces(GC_Announces_List *_Nonnull gc_announces_list, GC_Announces *_Nonnull announces)
+{
+    GC_Announces **link = &gc_announces_list->buckets[gca_bucket(gc_announces_list, announces->chat_id)];
+
+    while (*link != announces) {
+        link = &(*link)->next_in_bucket;
+    }
+
+    *link = announces->next_in_bucket;
+
+    wheel_unlink(gc_announces_list, announces);
+    --gc_announces_list->num_announces;
+
     mem_delete(gc_announces_list->mem, announces);
 }
 
@@ -44,19 +95,50 @@ static void remove_announces(GC_Announces_List *_Nonnull gc_announces_list, GC_A
  */
 static GC_Announces *_Nullable get_announces_by_chat_id(const GC_Announces_List *_Nonnull gc_announces_list, const uint8_t *_Nonnull chat_id)
 {
-    GC_Announces *announces = gc_announces_list->root_announces;
+    GC_Announces *announces = gc_announces_list->buckets[gca_bucket(gc_announces_list, chat_id)];
 
     while (announces != nullptr) {
         if (memcmp(announces->chat_id, chat_id, CHAT_ID_SIZE) == 0) {
             return announces;
         }
 
-        announces = announces->next_announce;
+        announces = announces->next_in_bucket;
     }
 
     return nullptr;
 }
 
+/** Rehashes all groups into a table of `num_buckets` buckets. */
+static bool gca_resize(GC_Announces_List *_Nonnull gc_announces_list, uint32_t num_buckets)
+{
+    GC_Announces **buckets = (GC_Announces **)mem_valloc(gc_announces_list->mem, num_buckets, sizeof(GC_Announces *));
+
+    if (buckets == nullptr) {
+        return false;
+    }
+
+    GC_Announces **old_buckets = gc_announces_list->buckets;
+    const uint32_t old_num_buckets = gc_announces_list->num_buckets;
+
+    gc_announces_list->buckets = buckets;
+    gc_announces_list->num_buckets = num_buckets;
+
+    for (uint32_t i = 0; i < old_num_buckets; ++i) {
+        GC_Announces *announces = old_buckets[i];
+
+        while (announces != nullptr) {
+            GC_Announces *next = announces->next_in_bucket;
+            const uint32_t bucket = gca_bucket(gc_announces_list, announces->chat_id);
+            announces->next_in_bucket = buckets[bucket];
+            buckets[bucket] = announces;
+            announces = next;
+        }
+    }
+
+    mem_delete(gc_announces_list->mem, old_buckets);
+    return true;
+}
+
 int gca_get_announces(const GC_Announces_List *gc_announces_list, GC_Announce *gc_announces, uint8_t max_nodes,
                       const uint8_t *chat_id, const uint8_t *except_public_key)
 {
@@ -340,6 +422,11 @@ int gca_unpack_announces_list(const Logger *log, const uint8_t *data, uint16_t l
 
 static GC_Announces *_Nullable gca_new_announces(const Memory *_Nonnull mem, GC_Announces_List *_Nonnull gc_announces_list, const GC_Public_Announce *_Nonnull public_announce)
 {
+    if (gc_announces_list->num_announces >= gc_announces_list->num_buckets) {
+        // Keep chains short. If this fails, the old table still works.
+        gca_resize(gc_announces_list, gc_announces_list->num_buckets * 2);
+    }
+
     GC_Announces *announces = (GC_Announces *)mem_alloc(mem, sizeof(GC_Announces));
 
     if (announces == nullptr) {
@@ -347,16 +434,13 @@ static GC_Announces *_Nullable gca_new_announces(const Memory *_Nonnull mem, GC_
     }
 
     announces->index = 0;
-    announces->prev_announce = nullptr;
-
-    if (gc_announces_list->root_announces != nullptr) {
-        gc_announces_list->root_announces->prev_announce = announces;
-    }
-
-    announces->next_announce = gc_announces_list->root_announces;
-    gc_announces_list->root_announces = announces;
     memcpy(announces->chat_id, public_announce->chat_public_key, CHAT_ID_SIZE);
 
+    const uint32_t bucket = gca_bucket(gc_announces_list, announces->chat_id);
+    announces->next_in_bucket = gc_announces_list->buckets[bucket];
+    gc_announces_list->buckets[bucket] = announces;
+    ++gc_announces_list->num_announces;
+
     return announces;
 }
 
@@ -367,6 +451,8 @@ GC_Peer_Announce *gca_add_announce(const Memory *mem, const Mono_Time *mono_time
         return nullptr;
     }
 
+    const uint64_t cur_time = mono_time_get(mono_time);
+
     GC_Announces *announces = get_announces_by_chat_id(gc_announces_list, public_announce->chat_public_key);
 
     // No entry for this chat_id exists so we create one
@@ -376,11 +462,14 @@ GC_Peer_Announce *gca_add_announce(const Memory *mem, const Mono_Time *mono_time
         if (announces == nullptr) {
             return nullptr;
         }
-    }
-
-    const uint64_t cur_time = mono_time_get(mono_time);
 
-    announces->last_announce_received_timestamp = cur_time;
+        announces->last_announce_received_timestamp = cur_time;
+        wheel_link(gc_announces_list, announces);
+    } else if (announces->last_announce_received_timestamp != cur_time) {
+        wheel_unlink(gc_announces_list, announces);
+        announces->last_announce_received_timestamp = cur_time;
+        wheel_link(gc_announces_list, announces);
+    }
 
     const uint64_t index = announces->index % GCA_MAX_SAVED_ANNOUNCES_PER_GC;
 
@@ -404,7 +493,7 @@ bool gca_is_valid_announce(const GC_Announce *announce)
     return announce->tcp_relays_count > 0 || announce->ip_port_is_set;
 }
 
-GC_Announces_List *new_gca_list(const Memory *mem)
+GC_Announces_List *new_gca_list(const Memory *mem, const Random *rng)
 {
     GC_Announces_List *announces_list = (GC_Announces_List *)mem_alloc(mem, sizeof(GC_Announces_List));
 
@@ -412,7 +501,17 @@ GC_Announces_List *new_gca_list(const Memory *mem)
         return nullptr;
     }
 
+    GC_Announces **buckets = (GC_Announces **)mem_valloc(mem, GCA_MIN_BUCKETS, sizeof(GC_Announces *));
+
+    if (buckets == nullptr) {
+        mem_delete(mem, announces_list);
+        return nullptr;
+    }
+
     announces_list->mem = mem;
+    announces_list->buckets = buckets;
+    announces_list->num_buckets = GCA_MIN_BUCKETS;
+    announces_list->seed = random_u64(rng);
 
     return announces_list;
 }
@@ -423,23 +522,39 @@ void kill_gca(GC_Announces_List *announces_list)
         return;
     }
 
-    GC_Announces *root = announces_list->root_announces;
+    for (uint32_t i = 0; i < announces_list->num_buckets; ++i) {
+        GC_Announces *announces = announces_list->buckets[i];
 
-    while (root != nullptr) {
-        GC_Announces *next = root->next_announce;
-        mem_delete(announces_list->mem, root);
-        root = next;
+        while (announces != nullptr) {
+            GC_Announces *next = announces->next_in_bucket;
+            mem_delete(announces_list->mem, announces);
+            announces = next;
+        }
     }
 
+    mem_delete(announces_list->mem, announces_list->buckets);
     mem_delete(announces_list->mem, announces_list);
 }
 
-/* How long we save a peer's announce before we consider it stale and remove it. */
-#define GCA_ANNOUNCE_SAVE_TIMEOUT 30
-
 /* How often we run do_gca() */
 #define GCA_DO_GCA_TIMEOUT 1
 
+/** Removes the groups in the wheel slot for second `time` that are stale at `cur_time`. */
+static void expire_wheel_slot(GC_Announces_List *_Nonnull gc_announces_list, uint64_t time, uint64_t cur_time)
+{
+    GC_Announces *announces = *gca_wheel_slot(gc_announces_list, time);
+
+    while (announces != nullptr) {
+        GC_Announces *next = announces->next_announce;
+
+        if (gca_expiry(announces) <= cur_time) {
+            remove_announces(gc_announces_list, announces);
+        }
+
+        announces = next;
+    }
+}
+
 void do_gca(const Mono_Time *mono_time, GC_Announces_List *gc_announces_list)
 {
     if (gc_announces_list == nullptr) {
@@ -450,20 +565,22 @@ void do_gca(const Mono_Time *mono_time, GC_Announces_List *gc_announces_list)
         return;
     }
 
-    gc_announces_list->last_timeout_check = mono_time_get(mono_time);
+    const uint64_t cur_time = mono_time_get(mono_time);
+    gc_announces_list->last_timeout_check = cur_time;
 
-    GC_Announces *announces = gc_announces_list->root_announces;
+    // Visit the slot of every second since the last run. After a long pause,
+    // that's every slot once.
+    uint64_t time = gc_announces_list->expired_until + 1;
 
-    while (announces != nullptr) {
-        if (mono_time_is_timeout(mono_time, announces->last_announce_received_timestamp, GCA_ANNOUNCE_SAVE_TIMEOUT)) {
-            GC_Announces *to_delete = announces;
-            announces = announces->next_announce;
-            remove_announces(gc_announces_list, to_delete);
-            continue;
-        }
+    if (cur_time - gc_announces_list->expired_until > GCA_EXPIRY_WHEEL_SLOTS) {
+        time = cur_time - GCA_EXPIRY_WHEEL_SLOTS + 1;
+    }
 
-        announces = announces->next_announce;
+    for (; time <= cur_time; ++time) {
+        expire_wheel_slot(gc_announces_list, time, cur_time);
     }
+
+    gc_announces_list->expired_until = cur_time;
 }
 
 void cleanup_gca(GC_Announces_List *gc_announces_list, const uint8_t *chat_id)
@@ -20,6 +20,7 @@
 #include "mono_time.h"
 #include "net.h"
 #include "network.h"
+#include "rng.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -40,6 +41,12 @@ extern "C" {
 /* Maximum size of a public announce. */
 #define GCA_PUBLIC_ANNOUNCE_MAX_SIZE (ENC_PUBLIC_KEY_SIZE + GCA_ANNOUNCE_MAX_SIZE)
 
+/* How long in seconds we save a group's announces after the last one arrived. */
+#define GCA_ANNOUNCE_SAVE_TIMEOUT 30
+
+/* Number of one second slots in the expiry wheel. A power of 2 greater than GCA_ANNOUNCE_SAVE_TIMEOUT. */
+#define GCA_EXPIRY_WHEEL_SLOTS 32
+
 typedef struct GC_Announce GC_Announce;
 typedef struct GC_Peer_Announce GC_Peer_Announce;
 typedef struct GC_Announces GC_Announces;
@@ -67,7 +74,7 @@ struct GC_Public_Announce {
     uint8_t chat_public_key[ENC_PUBLIC_KEY_SIZE];
 };
 
-/* A linked list that holds all announces for a particular group. */
+/* All announces for a particular group. */
 struct GC_Announces {
     uint8_t chat_id[CHAT_ID_SIZE];
     uint64_t index;
@@ -75,15 +82,30 @@ struct GC_Announces {
 
     GC_Peer_Announce peer_announces[GCA_MAX_SAVED_ANNOUNCES_PER_GC];
 
+    /* Next group in the same hash bucket. */
+    GC_Announces *_Nullable next_in_bucket;
+
+    /* Neighbours in the expiry wheel slot for the second these announces go stale. */
     GC_Announces *_Nullable next_announce;
     GC_Announces *_Nullable prev_announce;
 };
 
-/* A list of all announces. */
+/* All announces, indexed by chat ID and by the time they go stale. */
 struct GC_Announces_List {
     const Memory *_Nonnull mem;
 
-    GC_Announces *_Nullable root_announces;
+    /* Hash table of groups by chat ID, chained through `next_in_bucket`. */
+    GC_Announces *_Nullable *_Nonnull buckets;
+    /* Always a power of 2. */
+    uint32_t num_buckets;
+    uint32_t num_announces;
+    uint64_t seed;
+
+    /* Groups whose announces go stale at second `t` are in slot `t % GCA_EXPIRY_WHEEL_SLOTS`. */
+    GC_Announces *_Nullable expiry_wheel[GCA_EXPIRY_WHEEL_SLOTS];
+    /* do_gca has removed everything that went stale up to this second. */
+    uint64_t expired_until;
+
     uint64_t last_timeout_check;
 };
 
@@ -91,16 +113,17 @@ struct GC_Announces_List {
  *
  * The caller is responsible for freeing the memory with `kill_gca`.
  */
-GC_Announces_List *_Nullable new_gca_list(const Memory *_Nonnull mem);
+GC_Announces_List *_Nullable new_gca_list(const Memory *_Nonnull mem, const Random *_Nonnull rng);
 
 /** @brief Frees all dynamically allocated memory associated with `announces_list`. */
 void kill_gca(GC_Announces_List *_Nullable announces_list);
-/** @brief Iterates through the announces list and removes announces that are considered stale.
+/** @brief Removes announces that are considered stale.
  *
- * @param gc_announces_list The list of announces to iterate.
+ * @param gc_announces_list The list of announces to clean up.
  *
- * This function should be called from the main loop, and will iterate the list a
- * maxmimum of once per second.
+ * This function should be called from the main loop. It runs at most once per
+ * second and only looks at the groups whose announces went stale since the
+ * last run.
  */
 void do_gca(const Mono_Time *_Nonnull mono_time, GC_Announces_List *_Nonnull gc_announces_list);
 
@@ -0,0 +1,211 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "../testing/support/public/simulation.hh"
+#include "crypto_core.h"
+#include "group_announce.h"
+#include "mono_time.h"
+
+namespace {
+
+using tox::test::SimulatedNode;
+using tox::test::Simulation;
+using ChatId = std::array<std::uint8_t, CHAT_ID_SIZE>;
+
+/** @brief Length of the pre-generated announce trace, replayed in a loop. */
+constexpr std::size_t kTraceLength = 1 << 16;
+
+/**
+ * @brief The announce store before it was hashed: one list of groups, searched
+ * front to back on every store and lookup, and walked in full for timeouts.
+ *
+ * Kept here as the baseline. It stores the same data per group.
+ */
+class ListAnnounces {
+public:
+    ~ListAnnounces()
+    {
+        while (root_ != nullptr) {
+            Entry *next = root_->next;
+            delete root_;
+            root_ = next;
+        }
+    }
+
+    void add(const GC_Public_Announce &announce, std::uint64_t cur_time)
+    {
+        Entry *entry = find(announce.chat_public_key);
+
+        if (entry == nullptr) {
+            entry = new Entry{};
+            std::memcpy(entry->chat_id, announce.chat_public_key, CHAT_ID_SIZE);
+            entry->next = root_;
+            if (root_ != nullptr) {
+                root_->prev = entry;
+            }
+            root_ = entry;
+        }
+
+        entry->last_received = cur_time;
+        GC_Peer_Announce &slot = entry->peer_announces[entry->index % GCA_MAX_SAVED_ANNOUNCES_PER_GC];
+        slot.base_announce = announce.base_announce;
+        slot.timestamp = cur_time;
+        ++entry->index;
+    }
+
+    bool contains(const std::uint8_t *chat_id) const { return find(chat_id) != nullptr; }
+
+    void expire(std::uint64_t cur_time)
+    {
+        Entry *entry = root_;
+
+        while (entry != nullptr) {
+            Entry *next = entry->next;
+
+            if (entry->last_received + GCA_ANNOUNCE_SAVE_TIMEOUT <= cur_time) {
+                (entry->prev != nullptr ? entry->prev->next : root_) = next;
+                if (next != nullptr) {
+                    next->prev = entry->prev;
+                }
+                delete entry;
+            }
+
+            entry = next;
+        }
+    }
+
+private:
+    struct Entry {
+        std::uint8_t chat_id[CHAT_ID_SIZE];
+        std::uint64_t index;
+        std::uint64_t last_received;
+        GC_Peer_Announce peer_announces[GCA_MAX_SAVED_ANNOUNCES_PER_GC];
+        Entry *next;
+        Entry *prev;
+    };
+
+    Entry *find(const std::uint8_t *chat_id) const
+    {
+        for (Entry *entry = root_; entry != nullptr; entry = entry->next) {
+            if (std::memcmp(entry->chat_id, chat_id, CHAT_ID_SIZE) == 0) {
+                return entry;
+            }
+        }
+        return nullptr;
+    }
+
+    Entry *root_ = nullptr;
+};
+
+/**
+ * @brief Announce traffic on a bootstrap node that knows `range(0)` groups.
+ *
+ * Each operation stores one announce for a random group and answers one
+ * announce request for another. The clock moves one second every
+ * `range(0) / 20` operations, so a group is announced about every 20 seconds
+ * and a fifth of them time out and come back between announces. do_gca runs
+ * once per simulated second and is part of the measured time.
+ *
+ * range(1): 0 for GC_Announces_List, 1 for the old linked list.
+ */
+void BM_AnnounceTraffic(benchmark::State &state)
+{
+    const auto num_groups = static_cast<std::size_t>(state.range(0));
+    const bool list = state.range(1) != 0;
+    const std::size_t ops_per_second = num_groups / 20;
+
+    Simulation sim{12345};
+    std::unique_ptr<SimulatedNode> node = sim.create_node();
+    sim.advance_time(1000);  // mono_time must not be 0
+    Mono_Time *mono_time = mono_time_new(
+        &node->c_memory,
+        [](void *_Nullable user_data) -> std::uint64_t {
+            return static_cast<Simulation *>(user_data)->clock().current_time_ms();
+        },
+        &sim);
+    mono_time_update(mono_time);
+
+    GC_Announces_List *gca = new_gca_list(&node->c_memory, &node->c_random);
+    ListAnnounces baseline;
+
+    std::vector<ChatId> groups(num_groups);
+    for (ChatId &chat_id : groups) {
+        random_bytes(&node->c_random, chat_id.data(), chat_id.size());
+    }
+
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<std::size_t> pick(0, num_groups - 1);
+    std::vector<std::uint32_t> trace(kTraceLength);
+    for (std::uint32_t &group : trace) {
+        group = static_cast<std::uint32_t>(pick(gen));
+    }
+
+    GC_Public_Announce announce{};
+    announce.base_announce.ip_port_is_set = true;
+    random_bytes(&node->c_random, announce.base_announce.peer_public_key, ENC_PUBLIC_KEY_SIZE);
+    const std::uint8_t except_pk[ENC_PUBLIC_KEY_SIZE] = {0};
+    GC_Announce found[GCA_MAX_SENT_ANNOUNCES];
+
+    // Start from a full table.
+    for (const ChatId &chat_id : groups) {
+        std::memcpy(announce.chat_public_key, chat_id.data(), CHAT_ID_SIZE);
+        if (list) {
+            baseline.add(announce, mono_time_get(mono_time));
+        } else {
+            gca_add_announce(&node->c_memory, mono_time, gca, &announce);
+        }
+    }
+
+    std::size_t i = 0;
+    std::size_t hits = 0;
+
+    for (auto _ : state) {
+        const ChatId &stored = groups[trace[i % kTraceLength]];
+        const ChatId &wanted = groups[trace[(i + kTraceLength / 2) % kTraceLength]];
+        std::memcpy(announce.chat_public_key, stored.data(), CHAT_ID_SIZE);
+
+        if (list) {
+            baseline.add(announce, mono_time_get(mono_time));
+            hits += baseline.contains(wanted.data()) ? 1 : 0;
+        } else {
+            gca_add_announce(&node->c_memory, mono_time, gca, &announce);
+            hits += gca_get_announces(gca, found, GCA_MAX_SENT_ANNOUNCES, wanted.data(), except_pk) > 0 ? 1 : 0;
+        }
+
+        if (++i % ops_per_second == 0) {
+            sim.advance_time(1000);
+            mono_time_update(mono_time);
+
+            if (list) {
+                baseline.expire(mono_time_get(mono_time));
+            } else {
+                do_gca(mono_time, gca);
+            }
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.counters["hit%"] = 100.0 * static_cast<double>(hits) / static_cast<double>(state.iterations());
+
+    kill_gca(gca);
+    mono_time_free(&node->c_memory, mono_time);
+}
+
+BENCHMARK(BM_AnnounceTraffic)
+    ->ArgNames({"groups", "list"})
+    ->ArgsProduct({{1000, 10000, 50000}, {0, 1}});
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -61,6 +61,7 @@ void TestDoGca(Fuzz_Data &input)
 {
     SimulatedEnvironment env{12345};
     auto c_mem = env.fake_memory().c_memory();
+    auto c_rng = env.fake_random().c_random();
     std::unique_ptr<Logger, void (*)(Logger *)> logger(logger_new(&c_mem), logger_kill);
 
     std::unique_ptr<Mono_Time, std::function<void(Mono_Time *)>> mono_time(
@@ -74,7 +75,7 @@ void TestDoGca(Fuzz_Data &input)
     assert(mono_time != nullptr);
 
     std::unique_ptr<GC_Announces_List, std::function<void(GC_Announces_List *)>> gca(
-        new_gca_list(&c_mem), [](GC_Announces_List *ptr) { kill_gca(ptr); });
+        new_gca_list(&c_mem, &c_rng), [](GC_Announces_List *ptr) { kill_gca(ptr); });
     assert(gca != nullptr);
 
     while (!input.empty()) {
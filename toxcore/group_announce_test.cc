@@ -6,6 +6,7 @@
 #include <gtest/gtest.h>
 
 #include <cstddef>
+#include <vector>
 
 #include "DHT.h"
 #include "attributes.h"
@@ -24,6 +25,7 @@ struct Announces : ::testing::Test {
 protected:
     SimulatedEnvironment env{12345};
     Memory c_mem_;
+    Random c_rng_;
     Mono_Time *_Nullable mono_time_ = nullptr;
     GC_Announces_List *_Nullable gca_ = nullptr;
     GC_Announce _ann1;
@@ -32,11 +34,12 @@ protected:
     void SetUp() override
     {
         c_mem_ = env.fake_memory().c_memory();
+        c_rng_ = env.fake_random().c_random();
         mono_time_ = mono_time_new(&c_mem_, nullptr, nullptr);
         ASSERT_NE(mono_time_, nullptr);
         setup_fake_clock(mono_time_, env.fake_clock());
 
-        gca_ = new_gca_list(&c_mem_);
+        gca_ = new_gca_list(&c_mem_, &c_rng_);
         ASSERT_NE(gca_, nullptr);
     }
 
@@ -73,26 +76,93 @@ TEST_F(Announces, CanBeCreatedAndDeleted)
 TEST_F(Announces, AnnouncesCanTimeOut)
 {
     advance_clock(100);
-    ASSERT_EQ(gca_->root_announces, nullptr);
+    ASSERT_EQ(gca_->num_announces, 0);
     GC_Public_Announce ann{};
     ann.chat_public_key[0] = 0xae;
+    ann.base_announce.peer_public_key[0] = 0x01;
     ASSERT_NE(gca_add_announce(&c_mem_, mono_time_, gca_, &ann), nullptr);
-    ASSERT_NE(gca_->root_announces, nullptr);
-    ASSERT_EQ(gca_->root_announces->chat_id[0], 0xae);
+    ASSERT_EQ(gca_->num_announces, 1);
+
+    const std::uint8_t empty_pk[ENC_PUBLIC_KEY_SIZE] = {0};
+    GC_Announce announce;
+    ASSERT_EQ(gca_get_announces(gca_, &announce, 1, ann.chat_public_key, empty_pk), 1);
+    ASSERT_EQ(announce.peer_public_key[0], 0x01);
 
     // One iteration without having any time passed => announce is still here.
     do_gca(mono_time_, gca_);
-    ASSERT_NE(gca_->root_announces, nullptr);
+    ASSERT_EQ(gca_->num_announces, 1);
 
     // 29 seconds later, still there
     advance_clock(29000);
     do_gca(mono_time_, gca_);
-    ASSERT_NE(gca_->root_announces, nullptr);
+    ASSERT_EQ(gca_->num_announces, 1);
 
     // One more second and it's gone.
     advance_clock(1000);
     do_gca(mono_time_, gca_);
-    ASSERT_EQ(gca_->root_announces, nullptr);
+    ASSERT_EQ(gca_->num_announces, 0);
+    ASSERT_EQ(gca_get_announces(gca_, &announce, 1, ann.chat_public_key, empty_pk), 0);
+}
+
+TEST_F(Announces, NewAnnounceDelaysTimeout)
+{
+    advance_clock(100);
+    GC_Public_Announce ann{};
+    ann.chat_public_key[0] = 0xae;
+    ASSERT_NE(gca_add_announce(&c_mem_, mono_time_, gca_, &ann), nullptr);
+
+    // The group is announced again 20 seconds later, so it stays for another 30.
+    advance_clock(20000);
+    do_gca(mono_time_, gca_);
+    ASSERT_NE(gca_add_announce(&c_mem_, mono_time_, gca_, &ann), nullptr);
+
+    advance_clock(29000);
+    do_gca(mono_time_, gca_);
+    ASSERT_EQ(gca_->num_announces, 1);
+
+    advance_clock(1000);
+    do_gca(mono_time_, gca_);
+    ASSERT_EQ(gca_->num_announces, 0);
+}
+
+TEST_F(Announces, ManyGroupsExpireInOrder)
+{
+    // One new group per second for longer than the expiry wheel spans, with
+    // do_gca skipping a few seconds now and then.
+    advance_clock(100);
+    constexpr std::uint32_t kGroups = 3 * GCA_EXPIRY_WHEEL_SLOTS;
+    std::vector<GC_Public_Announce> anns(kGroups);
+
+    for (std::uint32_t i = 0; i < kGroups; ++i) {
+        anns[i].chat_public_key[0] = static_cast<std::uint8_t>(i);
+        anns[i].chat_public_key[1] = static_cast<std::uint8_t>(i >> 8);
+        anns[i].base_announce.peer_public_key[0] = 0x01;
+        ASSERT_NE(gca_add_announce(&c_mem_, mono_time_, gca_, &anns[i]), nullptr);
+
+        advance_clock(1000);
+
+        if (i % 7 != 0) {
+            do_gca(mono_time_, gca_);
+        }
+    }
+
+    do_gca(mono_time_, gca_);
+
+    // Groups added in the last 30 seconds are still there, the others are gone.
+    const std::uint8_t empty_pk[ENC_PUBLIC_KEY_SIZE] = {0};
+    GC_Announce announce;
+
+    for (std::uint32_t i = 0; i < kGroups; ++i) {
+        const int expected = i + GCA_ANNOUNCE_SAVE_TIMEOUT > kGroups ? 1 : 0;
+        EXPECT_EQ(gca_get_announces(gca_, &announce, 1, anns[i].chat_public_key, empty_pk), expected) << i;
+    }
+
+    EXPECT_EQ(gca_->num_announces, GCA_ANNOUNCE_SAVE_TIMEOUT - 1);
+
+    // After a long pause, everything goes at once.
+    advance_clock(1000 * 1000);
+    do_gca(mono_time_, gca_);
+    EXPECT_EQ(gca_->num_announces, 0);
 }
 
 TEST_F(Announces, AnnouncesGetAndCleanup)
@@ -12,6 +12,7 @@
 #include <sodium.h>
 
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "DHT.h"
@@ -28,13 +29,16 @@
 #include "group_connection.h"
 #include "group_moderation.h"
 #include "group_pack.h"
+#include "group_relay.h"
 #include "logger.h"
 #include "mem.h"
+#include "messenger_host.h"
 #include "mono_time.h"
 #include "net_crypto.h"
 #include "network.h"
 #include "onion_announce.h"
 #include "onion_client.h"
+#include "pk_index.h"
 #include "util.h"
 
 /* The minimum size of a plaintext group handshake packet */
@@ -44,6 +48,12 @@
 #define GC_MIN_ENCRYPTED_HS_PAYLOAD_SIZE (1 + ENC_PUBLIC_KEY_SIZE + ENC_PUBLIC_KEY_SIZE +\
                                           GC_MIN_HS_PACKET_PAYLOAD_SIZE + CRYPTO_NONCE_SIZE + CRYPTO_MAC_SIZE)
 
+/* Room for the optional parts of a handshake packet: a TCP relay node and the feature flags */
+#define GC_HS_OPTIONAL_SIZE (sizeof(Node_format) + 1)
+
+/* Feature flag in handshake packets: the sender understands relayed broadcasts */
+#define GC_HS_FLAG_RELAYED_BROADCAST 0x01
+
 /* Size of a group's shared state in packed format */
 #define GC_PACKED_SHARED_STATE_SIZE (EXT_PUBLIC_KEY_SIZE + sizeof(uint16_t) + MAX_GC_GROUP_NAME_SIZE +\
                                      sizeof(uint16_t) + 1 + sizeof(uint16_t) + MAX_GC_PASSWORD_SIZE +\
@@ -57,6 +67,9 @@
 /* Header information attached to all broadcast messages: broadcast_type */
 #define GC_BROADCAST_ENC_HEADER_SIZE 1
 
+/* Header of a relayed broadcast: range end, original sender's public encryption key, relay message ID and fanout */
+#define GC_RELAY_HEADER_SIZE (ENC_PUBLIC_KEY_SIZE + ENC_PUBLIC_KEY_SIZE + sizeof(uint64_t) + 1)
+
 /* Size of a group packet message ID */
 #define GC_MESSAGE_ID_BYTES sizeof(uint64_t)
 
@@ -92,6 +105,14 @@
 /* How often in seconds we can send the peer list to any peer in the group in a sync response */
 #define GC_SYNC_RESPONSE_PEER_LIST_LIMIT 3
 
+/* Number of leading bytes of a peer's public encryption key that identify it in a sync request */
+#define GC_SYNC_PEER_ID_SIZE 8
+
+/* Size of the state versions in a sync request, followed by the number of peers the requester knows:
+ * shared state version, sanctions list version and checksum, topic version and checksum, peer count
+ */
+#define GC_SYNC_KNOWN_HEADER_SIZE ((sizeof(uint32_t) * 3) + (sizeof(uint16_t) * 3))
+
 /* How often in seconds we try to handshake with an unconfirmed peer */
 #define GC_SEND_HANDSHAKE_INTERVAL 3
 
@@ -159,13 +180,29 @@ typedef enum Group_Sync_Flags {
     GF_PEERS      = (1 << 0), // 1
     GF_TOPIC      = (1 << 1), // 2
     GF_STATE      = (1 << 2), // 4
+    GF_DELTA      = (1 << 3), // 8: the request says which state the requester already has
 } Group_Sync_Flags;
 
+/** The group state a peer already has, sent along with a sync request. */
+typedef struct GC_Sync_Known {
+    uint32_t shared_state_version;
+    uint32_t sanctions_creds_version;
+    uint16_t sanctions_creds_checksum;
+    uint32_t topic_version;
+    uint16_t topic_checksum;
+
+    /* Sorted GC_SYNC_PEER_ID_SIZE byte prefixes of the public keys of the requester's confirmed peers. */
+    const uint8_t *_Nullable peers;
+    uint16_t num_peers;
+} GC_Sync_Known;
+
 static bool self_gc_is_founder(const GC_Chat *_Nonnull chat);
 static bool group_number_valid(const GC_Session *_Nonnull c, int group_number);
 static int peer_update(const GC_Chat *_Nonnull chat, const GC_Peer *_Nonnull peer, uint32_t peer_number);
 static void group_delete(GC_Session *_Nonnull c, GC_Chat *_Nonnull chat);
 static void group_cleanup(const GC_Session *_Nonnull c, GC_Chat *_Nonnull chat);
+static void handle_gc_relay_pending(const GC_Session *_Nonnull c, GC_Chat *_Nonnull chat, const uint8_t *_Nonnull origin_pk,
+                                    void *_Nullable userdata);
 static bool group_exists(const GC_Session *_Nonnull c, const uint8_t *_Nonnull chat_id);
 static void add_tcp_relays_to_chat(const GC_Session *_Nonnull c, GC_Chat *_Nonnull chat);
 static void create_gc_session_keypair(const Logger *_Nonnull log, const Random *_Nonnull rng, uint8_t *_Nonnull public_key, uint8_t *_Nonnull secret_key);
@@ -610,25 +647,25 @@ static uint16_t get_gc_topic_checksum(const GC_TopicInfo *_Nonnull topic_info)
 
 int get_peer_number_of_enc_pk(const GC_Chat *chat, const uint8_t *public_enc_key, bool confirmed)
 {
-    for (uint32_t i = 0; i < chat->numpeers; ++i) {
-        const GC_Connection *gconn = get_gc_connection(chat, i);
+    const int64_t peer_number = pk_index_get(chat->peers_by_enc_pk, public_enc_key);
 
-        assert(gconn != nullptr);
+    if (peer_number < 0) {
+        return -1;
+    }
 
-        if (gconn->pending_delete) {
-            continue;
-        }
+    const GC_Connection *gconn = get_gc_connection(chat, (int)peer_number);
 
-        if (confirmed && !gconn->confirmed) {
-            continue;
-        }
+    assert(gconn != nullptr);
 
-        if (memcmp(gconn->addr.public_key.enc, public_enc_key, ENC_PUBLIC_KEY_SIZE) == 0) {
-            return i;
-        }
+    if (gconn->pending_delete) {
+        return -1;
     }
 
-    return -1;
+    if (confirmed && !gconn->confirmed) {
+        return -1;
+    }
+
+    return (int)peer_number;
 }
 
 /** @brief Check if peer associated with `public_sig_key` is in peer list.
@@ -638,35 +675,72 @@ int get_peer_number_of_enc_pk(const GC_Chat *chat, const uint8_t *public_enc_key
  */
 static int get_peer_number_of_sig_pk(const GC_Chat *_Nonnull chat, const uint8_t *_Nonnull public_sig_key)
 {
+    return (int)pk_index_get(chat->peers_by_sig_pk, public_sig_key);
+}
+
+static bool gc_get_enc_pk_from_sig_pk(const GC_Chat *_Nonnull chat, uint8_t *_Nonnull public_key, const uint8_t *_Nonnull public_sig_key)
+{
+    const GC_Connection *gconn = get_gc_connection(chat, get_peer_number_of_sig_pk(chat, public_sig_key));
+
+    if (gconn == nullptr) {
+        return false;
+    }
+
+    memcpy(public_key, get_enc_key(&gconn->addr.public_key), ENC_PUBLIC_KEY_SIZE);
+    return true;
+}
+
+/** @brief Removes the mapping of `public_key` to `peer_number` from one of the peer indexes.
+ *
+ * If another peer has the same key, the key is mapped to that peer instead.
+ * This happens when a peer that is about to be deleted rejoins, or when two
+ * peers claim the same signature key.
+ */
+static void peer_index_release(const GC_Chat *_Nonnull chat, PK_Index *_Nonnull index, bool sig_key,
+                               const uint8_t *_Nonnull public_key, uint32_t peer_number)
+{
+    if (pk_index_get(index, public_key) != peer_number) {
+        return;
+    }
+
     for (uint32_t i = 0; i < chat->numpeers; ++i) {
-        const GC_Connection *gconn = get_gc_connection(chat, i);
+        if (i == peer_number) {
+            continue;
+        }
 
-        assert(gconn != nullptr);
+        const Extended_Public_Key *full_pk = &chat->group[i].gconn.addr.public_key;
+        const uint8_t *other_key = sig_key ? get_sig_pk(full_pk) : get_enc_key(full_pk);
 
-        if (memcmp(get_sig_pk(&gconn->addr.public_key), public_sig_key, SIG_PUBLIC_KEY_SIZE) == 0) {
-            return i;
+        if (memcmp(other_key, public_key, CRYPTO_PUBLIC_KEY_SIZE) == 0) {
+            pk_index_add(index, public_key, i);  // replaces the mapping, so it doesn't allocate
+            return;
         }
     }
 
-    return -1;
+    pk_index_remove(index, public_key);
 }
 
-static bool gc_get_enc_pk_from_sig_pk(const GC_Chat *_Nonnull chat, uint8_t *_Nonnull public_key, const uint8_t *_Nonnull public_sig_key)
+/** @brief Sets the signature key of `peer_number`, which we learn in the handshake.
+ *
+ * Return true on success.
+ */
+static bool peer_set_sig_pk(const GC_Chat *_Nonnull chat, uint32_t peer_number, const uint8_t *_Nonnull public_sig_key)
 {
-    for (uint32_t i = 0; i < chat->numpeers; ++i) {
-        const GC_Connection *gconn = get_gc_connection(chat, i);
+    GC_Connection *gconn = get_gc_connection(chat, peer_number);
+    assert(gconn != nullptr);
 
-        assert(gconn != nullptr);
+    if (!pk_index_add(chat->peers_by_sig_pk, public_sig_key, peer_number)) {
+        return false;
+    }
 
-        const Extended_Public_Key *full_pk = &gconn->addr.public_key;
+    const uint8_t *old_sig_key = get_sig_pk(&gconn->addr.public_key);
 
-        if (memcmp(public_sig_key, get_sig_pk(full_pk), SIG_PUBLIC_KEY_SIZE) == 0) {
-            memcpy(public_key, get_enc_key(full_pk), ENC_PUBLIC_KEY_SIZE);
-            return true;
-        }
+    if (memcmp(old_sig_key, public_sig_key, SIG_PUBLIC_KEY_SIZE) != 0) {
+        peer_index_release(chat, chat->peers_by_sig_pk, true, old_sig_key, peer_number);
+        set_sig_pk(&gconn->addr.public_key, public_sig_key);
     }
 
-    return false;
+    return true;
 }
 
 static GC_Connection *_Nullable random_gc_connection(const GC_Chat *_Nonnull chat)
@@ -1635,7 +1709,114 @@ static bool send_lossless_group_packet(const GC_Chat *_Nonnull chat, GC_Connecti
     return gcc_send_lossless_packet(chat, gconn, data, length, packet_type) == 0;
 }
 
+static int compare_sync_peer_ids(const void *a, const void *b)
+{
+    return memcmp(a, b, GC_SYNC_PEER_ID_SIZE);
+}
+
+/** @brief Packs the group state we already have into `data`, so that a sync response can leave it out.
+ *
+ * The peers are only packed if `with_peers` is true, and at most `max_peers` of them.
+ *
+ * Returns the packed length.
+ */
+static uint16_t pack_gc_sync_known(const GC_Chat *_Nonnull chat, uint8_t *_Nonnull data, bool with_peers, uint16_t max_peers)
+{
+    uint32_t shared_state_version = chat->shared_state.version;
+    uint8_t mod_list_hash[MOD_MODERATION_HASH_SIZE];
+
+    // If the mod list we have isn't the one our shared state describes, we need both again.
+    if (!mod_list_make_hash(&chat->moderation, mod_list_hash)
+            || memcmp(mod_list_hash, chat->shared_state.mod_list_hash, MOD_MODERATION_HASH_SIZE) != 0) {
+        shared_state_version = 0;
+    }
+
+    uint16_t length = 0;
+
+    net_pack_u32(data + length, shared_state_version);
+    length += sizeof(uint32_t);
+    net_pack_u32(data + length, chat->moderation.sanctions_creds.version);
+    length += sizeof(uint32_t);
+    net_pack_u16(data + length, chat->moderation.sanctions_creds.checksum);
+    length += sizeof(uint16_t);
+    net_pack_u32(data + length, chat->topic_info.version);
+    length += sizeof(uint32_t);
+    net_pack_u16(data + length, chat->topic_info.checksum);
+    length += sizeof(uint16_t);
+
+    uint8_t *peers = data + GC_SYNC_KNOWN_HEADER_SIZE;
+    uint16_t num_peers = 0;
+
+    for (uint32_t i = 1; with_peers && i < chat->numpeers && num_peers < max_peers; ++i) {
+        const GC_Connection *gconn = get_gc_connection(chat, i);
+
+        assert(gconn != nullptr);
+
+        if (!gconn->confirmed || gconn->pending_delete) {
+            continue;
+        }
+
+        memcpy(peers + (num_peers * GC_SYNC_PEER_ID_SIZE), gconn->addr.public_key.enc, GC_SYNC_PEER_ID_SIZE);
+        ++num_peers;
+    }
+
+    qsort(peers, num_peers, GC_SYNC_PEER_ID_SIZE, compare_sync_peer_ids);
+
+    net_pack_u16(data + length, num_peers);
+    length += sizeof(uint16_t);
+
+    return length + (num_peers * GC_SYNC_PEER_ID_SIZE);
+}
+
+/** @brief Unpacks the group state a peer already has from the end of its sync request.
+ *
+ * Return true on success.
+ */
+static bool unpack_gc_sync_known(GC_Sync_Known *_Nonnull known, const uint8_t *_Nonnull data, uint16_t length)
+{
+    if (length < GC_SYNC_KNOWN_HEADER_SIZE) {
+        return false;
+    }
+
+    uint16_t unpacked_len = 0;
+
+    net_unpack_u32(data + unpacked_len, &known->shared_state_version);
+    unpacked_len += sizeof(uint32_t);
+    net_unpack_u32(data + unpacked_len, &known->sanctions_creds_version);
+    unpacked_len += sizeof(uint32_t);
+    net_unpack_u16(data + unpacked_len, &known->sanctions_creds_checksum);
+    unpacked_len += sizeof(uint16_t);
+    net_unpack_u32(data + unpacked_len, &known->topic_version);
+    unpacked_len += sizeof(uint32_t);
+    net_unpack_u16(data + unpacked_len, &known->topic_checksum);
+    unpacked_len += sizeof(uint16_t);
+    net_unpack_u16(data + unpacked_len, &known->num_peers);
+    unpacked_len += sizeof(uint16_t);
+
+    // The peer list must take up exactly the rest of the packet.
+    if (length - unpacked_len != known->num_peers * GC_SYNC_PEER_ID_SIZE) {
+        return false;
+    }
+
+    known->peers = known->num_peers > 0 ? data + unpacked_len : nullptr;
+
+    return true;
+}
+
+/** @brief Returns true if the peer with `public_key` is among the peers in `known`. */
+static bool gc_sync_known_has_peer(const GC_Sync_Known *_Nonnull known, const uint8_t *_Nonnull public_key)
+{
+    if (known->peers == nullptr) {
+        return false;
+    }
+
+    return bsearch(public_key, known->peers, known->num_peers, GC_SYNC_PEER_ID_SIZE, compare_sync_peer_ids) != nullptr;
+}
+
 /** @brief Sends a group sync request to peer.
+ *
+ * The request tells the peer which state we already have, so that it only
+ * sends what changed since.
  *
  * Returns true on success or if sync request timeout has not expired.
  */
@@ -1647,10 +1828,17 @@ static bool send_gc_sync_request(GC_Chat *_Nonnull chat, GC_Connection *_Nonnull
 
     chat->last_sync_request = mono_time_get(chat->mono_time);
 
-    uint8_t data[(sizeof(uint16_t) * 2) + MAX_GC_PASSWORD_SIZE];
+    const uint16_t header_length = (sizeof(uint16_t) * 2) + MAX_GC_PASSWORD_SIZE + GC_SYNC_KNOWN_HEADER_SIZE;
+    const uint32_t max_peers = min_u32(chat->numpeers, (MAX_GC_PACKET_SIZE - header_length) / GC_SYNC_PEER_ID_SIZE);
+    uint8_t *data = (uint8_t *)mem_balloc(chat->mem, header_length + (max_peers * GC_SYNC_PEER_ID_SIZE));
+
+    if (data == nullptr) {
+        return false;
+    }
+
     uint16_t length = sizeof(uint16_t);
 
-    net_pack_u16(data, sync_flags);
+    net_pack_u16(data, sync_flags | GF_DELTA);
 
     if (chat_is_password_protected(chat)) {
         net_pack_u16(data + length, chat->shared_state.password_length);
@@ -1660,7 +1848,13 @@ static bool send_gc_sync_request(GC_Chat *_Nonnull chat, GC_Connection *_Nonnull
         length += MAX_GC_PASSWORD_SIZE;
     }
 
-    return send_lossless_group_packet(chat, gconn, data, length, GP_SYNC_REQUEST);
+    length += pack_gc_sync_known(chat, data + length, (sync_flags & GF_PEERS) > 0, (uint16_t)max_peers);
+
+    const bool ret = send_lossless_group_packet(chat, gconn, data, length, GP_SYNC_REQUEST);
+
+    mem_delete(chat->mem, data);
+
+    return ret;
 }
 
 /** @brief Sends a sync response packet to peer designated by `gconn`.
@@ -1842,7 +2036,14 @@ static bool create_sync_announce(const GC_Chat *_Nonnull chat, const GC_Connecti
     return true;
 }
 
-static bool sync_response_send_peers(GC_Chat *_Nonnull chat, GC_Connection *_Nonnull gconn, uint32_t peer_number, bool first_sync)
+/** @brief Sends the peer designated by `gconn` an announce for each of our confirmed peers.
+ *
+ * Peers that are in `known` are left out.
+ *
+ * Return true on success.
+ */
+static bool sync_response_send_peers(GC_Chat *_Nonnull chat, GC_Connection *_Nonnull gconn, uint32_t peer_number, bool first_sync,
+                                     const GC_Sync_Known *_Nullable known)
 {
     // Always respond to a peer's first sync request
     if (!first_sync && !mono_time_is_timeout(chat->mono_time,
@@ -1870,6 +2071,10 @@ static bool sync_response_send_peers(GC_Chat *_Nonnull chat, GC_Connection *_Non
             continue;
         }
 
+        if (known != nullptr && gc_sync_known_has_peer(known, peer_gconn->addr.public_key.enc)) {
+            continue;
+        }
+
         GC_Announce announce = {0};
 
         if (!create_sync_announce(chat, peer_gconn, i, &announce)) {
@@ -1907,44 +2112,57 @@ static bool sync_response_send_peers(GC_Chat *_Nonnull chat, GC_Connection *_Non
 }
 
 /** @brief Sends group state specified by `sync_flags` peer designated by `peer_number`.
+ *
+ * If `known` is non-null, state the peer already has at the same version is
+ * left out.
  *
  * Return true on success.
  */
-static bool sync_response_send_state(GC_Chat *_Nonnull chat, GC_Connection *_Nonnull gconn, uint32_t peer_number, uint16_t sync_flags)
+static bool sync_response_send_state(GC_Chat *_Nonnull chat, GC_Connection *_Nonnull gconn, uint32_t peer_number, uint16_t sync_flags,
+                                     const GC_Sync_Known *_Nullable known)
 {
     const bool first_sync = gconn->last_sync_response == 0;
 
     // Do not change the order of these four send calls. See: https://toktok.ltd/spec.html#sync_request-0xf8
     if ((sync_flags & GF_STATE) > 0 && chat->shared_state.version > 0) {
-        if (!send_peer_shared_state(chat, gconn)) {
-            LOGGER_WARNING(chat->log, "Failed to send shared state");
-            return false;
-        }
+        // The shared state holds the mod list hash, so a peer with our shared state has our mod list.
+        if (known == nullptr || known->shared_state_version != chat->shared_state.version) {
+            if (!send_peer_shared_state(chat, gconn)) {
+                LOGGER_WARNING(chat->log, "Failed to send shared state");
+                return false;
+            }
 
-        if (!send_peer_mod_list(chat, gconn)) {
-            LOGGER_WARNING(chat->log, "Failed to send mod list");
-            return false;
+            if (!send_peer_mod_list(chat, gconn)) {
+                LOGGER_WARNING(chat->log, "Failed to send mod list");
+                return false;
+            }
         }
 
-        if (!send_peer_sanctions_list(chat, gconn)) {
-            LOGGER_WARNING(chat->log, "Failed to send sanctions list");
-            return false;
+        if (known == nullptr || known->sanctions_creds_version != chat->moderation.sanctions_creds.version
+                || known->sanctions_creds_checksum != chat->moderation.sanctions_creds.checksum) {
+            if (!send_peer_sanctions_list(chat, gconn)) {
+                LOGGER_WARNING(chat->log, "Failed to send sanctions list");
+                return false;
+            }
         }
 
         gconn->last_sync_response = mono_time_get(chat->mono_time);
     }
 
     if ((sync_flags & GF_TOPIC) > 0 && chat->time_connected > 0 && chat->topic_info.version > 0) {
-        if (!send_peer_topic(chat, gconn)) {
-            LOGGER_WARNING(chat->log, "Failed to send topic");
-            return false;
+        if (known == nullptr || known->topic_version != chat->topic_info.version
+                || known->topic_checksum != chat->topic_info.checksum) {
+            if (!send_peer_topic(chat, gconn)) {
+                LOGGER_WARNING(chat->log, "Failed to send topic");
+                return false;
+            }
         }
 
         gconn->last_sync_response = mono_time_get(chat->mono_time);
     }
 
     if ((sync_flags & GF_PEERS) > 0) {
-        if (!sync_response_send_peers(chat, gconn, peer_number, first_sync)) {
+        if (!sync_response_send_peers(chat, gconn, peer_number, first_sync, known)) {
             return false;
         }
 
@@ -1995,6 +2213,7 @@ static int handle_gc_sync_request(GC_Chat *_Nonnull chat, uint32_t peer_number,
 
     uint16_t sync_flags;
     net_unpack_u16(data, &sync_flags);
+    uint16_t unpacked_len = sizeof(uint16_t);
 
     if (chat_is_password_protected(chat)) {
         if (length < (sizeof(uint16_t) * 2) + MAX_GC_PASSWORD_SIZE) {
@@ -2010,9 +2229,16 @@ static int handle_gc_sync_request(GC_Chat *_Nonnull chat, uint32_t peer_number,
             LOGGER_DEBUG(chat->log, "Invalid password");
             return -2;
         }
+
+        unpacked_len += sizeof(uint16_t) + MAX_GC_PASSWORD_SIZE;
     }
 
-    if (!sync_response_send_state(chat, gconn, peer_number, sync_flags)) {
+    // Older clients don't say what they have, and get the full state.
+    GC_Sync_Known known;
+    const bool has_known = (sync_flags & GF_DELTA) > 0
+                           && unpack_gc_sync_known(&known, data + unpacked_len, length - unpacked_len);
+
+    if (!sync_response_send_state(chat, gconn, peer_number, sync_flags, has_known ? &known : nullptr)) {
         return -3;
     }
 
@@ -2329,7 +2555,176 @@ static uint16_t make_gc_broadcast_header(const uint8_t *_Nullable data, uint16_t
     return length + header_len;
 }
 
+/** @brief Returns true if a broadcast of this type may be sent over a relay tree.
+ *
+ * Only broadcasts that concern nobody but their sender qualify. The others change
+ * the group state and are always sent to every peer.
+ */
+static bool gc_broadcast_is_relayable(uint8_t bc_type)
+{
+    return bc_type == GM_STATUS || bc_type == GM_NICK || bc_type == GM_PLAIN_MESSAGE || bc_type == GM_ACTION_MESSAGE;
+}
+
+/** @brief Passes a relayed broadcast on to our children in the relay tree.
+ *
+ * `packet` holds the whole relayed broadcast. Its range end is overwritten with the
+ * range end of each child in turn.
+ *
+ * Returns the number of children the packet was sent to.
+ * Returns -1 on allocation failure.
+ */
+static int relay_gc_broadcast(const GC_Chat *_Nonnull chat, uint8_t *_Nonnull packet, uint16_t length)
+{
+    uint8_t range_end[ENC_PUBLIC_KEY_SIZE];
+    memcpy(range_end, packet, ENC_PUBLIC_KEY_SIZE);
+
+    const uint8_t *origin_pk = packet + ENC_PUBLIC_KEY_SIZE;
+    const uint8_t fanout = packet[GC_RELAY_HEADER_SIZE - 1];
+
+    if (chat->numpeers <= 1) {
+        return 0;
+    }
+
+    GC_Relay_Target *targets = (GC_Relay_Target *)mem_valloc(chat->mem, chat->numpeers - 1, sizeof(GC_Relay_Target));
+
+    if (targets == nullptr) {
+        return -1;
+    }
+
+    uint32_t num_targets = 0;
+
+    for (uint32_t i = 1; i < chat->numpeers; ++i) {
+        const GC_Connection *gconn = get_gc_connection(chat, i);
+
+        assert(gconn != nullptr);
+
+        if (!gconn->confirmed || !gconn->relays_broadcasts
+                || memcmp(gconn->addr.public_key.enc, origin_pk, ENC_PUBLIC_KEY_SIZE) == 0) {
+            continue;
+        }
+
+        targets[num_targets].public_key = gconn->addr.public_key.enc;
+        targets[num_targets].peer_number = i;
+        ++num_targets;
+    }
+
+    GC_Relay_Child children[GC_RELAY_MAX_FANOUT];
+    const uint16_t num_children = gc_relay_plan(get_enc_key(&chat->self_public_key), range_end, targets, num_targets,
+                                  fanout, children);
+
+    int sent = 0;
+
+    for (uint16_t i = 0; i < num_children; ++i) {
+        GC_Connection *gconn = get_gc_connection(chat, children[i].peer_number);
+
+        assert(gconn != nullptr);
+
+        memcpy(packet, children[i].range_end, ENC_PUBLIC_KEY_SIZE);
+
+        if (send_lossless_group_packet(chat, gconn, packet, length, GP_RELAYED_BROADCAST)) {
+            ++sent;
+        }
+    }
+
+    mem_delete(chat->mem, targets);
+
+    return sent;
+}
+
+/** @brief Returns true if a broadcast of `length` bytes should be sent over a relay tree. */
+static bool gc_should_relay_broadcast(const GC_Chat *_Nonnull chat, uint8_t bc_type, uint16_t length)
+{
+    if (chat->relay_fanout == 0 || !gc_broadcast_is_relayable(bc_type)) {
+        return false;
+    }
+
+    if (length + GC_RELAY_HEADER_SIZE + SIGNATURE_SIZE > MAX_GC_PACKET_SIZE) {
+        return false;
+    }
+
+    uint32_t relaying_peers = 0;
+
+    for (uint32_t i = 1; i < chat->numpeers; ++i) {
+        const GC_Connection *gconn = get_gc_connection(chat, i);
+
+        assert(gconn != nullptr);
+
+        if (gconn->confirmed && gconn->relays_broadcasts) {
+            ++relaying_peers;
+        }
+    }
+
+    // With this few peers, the tree would be us sending to everyone.
+    return relaying_peers > chat->relay_fanout;
+}
+
+/** @brief Signs a broadcast and sends it to the top of our relay tree.
+ *
+ * `data` is the broadcast including its header. Peers that don't understand relayed
+ * broadcasts aren't in the tree, so they get `data` directly.
+ *
+ * The signed relay message ID goes up by one with every broadcast, so peers can
+ * drop replayed broadcasts with a small window. It starts from the current time
+ * so that it stays above the IDs we used before a restart.
+ *
+ * Returns true if it was sent to at least one peer.
+ */
+static bool send_gc_relayed_broadcast(const GC_Chat *_Nonnull chat, const uint8_t *_Nonnull data, uint16_t length)
+{
+    const uint16_t packet_len = GC_RELAY_HEADER_SIZE + length + SIGNATURE_SIZE;
+    uint8_t *packet = (uint8_t *)mem_balloc(chat->mem, packet_len);
+
+    if (packet == nullptr) {
+        return false;
+    }
+
+    GC_Connection *self_gconn = get_gc_connection(chat, 0);
+    assert(self_gconn != nullptr);
+
+    if (self_gconn->relay_message_id == 0) {
+        // Leaves room for a million broadcasts per millisecond.
+        self_gconn->relay_message_id = mono_time_get_ms(chat->mono_time) << 20;
+    }
+
+    ++self_gconn->relay_message_id;
+
+    // Our own key as the range end makes the whole group our range.
+    memcpy(packet, get_enc_key(&chat->self_public_key), ENC_PUBLIC_KEY_SIZE);
+    memcpy(packet + ENC_PUBLIC_KEY_SIZE, get_enc_key(&chat->self_public_key), ENC_PUBLIC_KEY_SIZE);
+    net_pack_u64(packet + ENC_PUBLIC_KEY_SIZE * 2, self_gconn->relay_message_id);
+    packet[GC_RELAY_HEADER_SIZE - 1] = chat->relay_fanout;
+    memcpy(packet + GC_RELAY_HEADER_SIZE, data, length);
+
+    // The range end changes on every hop, so it's not signed.
+    if (!crypto_signature_create(packet + packet_len - SIGNATURE_SIZE, packet + ENC_PUBLIC_KEY_SIZE,
+                                 packet_len - ENC_PUBLIC_KEY_SIZE - SIGNATURE_SIZE, get_sig_sk(&chat->self_secret_key))) {
+        LOGGER_ERROR(chat->log, "Failed to sign relayed broadcast");
+        mem_delete(chat->mem, packet);
+        return false;
+    }
+
+    int sent = relay_gc_broadcast(chat, packet, packet_len);
+
+    mem_delete(chat->mem, packet);
+
+    for (uint32_t i = 1; i < chat->numpeers; ++i) {
+        GC_Connection *gconn = get_gc_connection(chat, i);
+
+        assert(gconn != nullptr);
+
+        if (gconn->confirmed && !gconn->relays_broadcasts
+                && send_lossless_group_packet(chat, gconn, data, length, GP_BROADCAST)) {
+            ++sent;
+        }
+    }
+
+    return sent > 0;
+}
+
 /** @brief sends a group broadcast packet to all confirmed peers.
+ *
+ * If the group has a relay fanout set, some broadcasts only go to the top of our
+ * relay tree instead.
  *
  * Returns true on success.
  */
@@ -2348,7 +2743,13 @@ static bool send_gc_broadcast_message(const GC_Chat *_Nonnull chat, const uint8_
 
     const uint16_t packet_len = make_gc_broadcast_header(data, length, packet, bc_type);
 
-    const bool ret = send_gc_lossless_packet_all_peers(chat, packet, packet_len, GP_BROADCAST);
+    bool ret;
+
+    if (gc_should_relay_broadcast(chat, bc_type, packet_len)) {
+        ret = send_gc_relayed_broadcast(chat, packet, packet_len);
+    } else {
+        ret = send_gc_lossless_packet_all_peers(chat, packet, packet_len, GP_BROADCAST);
+    }
 
     mem_delete(chat->mem, packet);
 
@@ -2756,6 +3157,10 @@ static int handle_gc_peer_info_response(const GC_Session *_Nonnull c, GC_Chat *_
         c->peer_join(c->messenger, chat->group_number, peer->peer_id, userdata);
     }
 
+    if (!was_confirmed) {
+        handle_gc_relay_pending(c, chat, get_enc_key(&gconn->addr.public_key), userdata);
+    }
+
     return 0;
 }
 
@@ -4769,6 +5174,11 @@ int gc_founder_set_max_peers(GC_Chat *chat, uint16_t max_peers)
     return 0;
 }
 
+void gc_set_relay_fanout(GC_Chat *chat, uint8_t fanout)
+{
+    chat->relay_fanout = (uint8_t)min_u16(fanout, GC_RELAY_MAX_FANOUT);
+}
+
 int gc_send_message(const GC_Chat *chat, const uint8_t *message, uint16_t length, uint8_t type, uint32_t *message_id)
 {
     if (length > MAX_GC_MESSAGE_SIZE) {
@@ -5221,7 +5631,7 @@ static int handle_gc_message_ack(const GC_Chat *_Nonnull chat, GC_Connection *_N
     const Group_Message_Ack_Type type = (Group_Message_Ack_Type) data[0];
 
     if (type == GR_ACK_RECV) {
-        if (!gcc_handle_ack(chat->log, chat->mem, gconn, message_id)) {
+        if (!gcc_handle_ack(chat->log, chat->packet_pool, gconn, message_id)) {
             return -2;
         }
 
@@ -5233,15 +5643,15 @@ static int handle_gc_message_ack(const GC_Chat *_Nonnull chat, GC_Connection *_N
     }
 
     const uint64_t tm = mono_time_get(chat->mono_time);
-    const uint16_t idx = gcc_get_array_index(message_id);
+    GC_Message_Array_Entry *entry = gcc_get_send_array_entry(gconn, message_id);
 
     /* re-send requested packet */
-    if (gconn->send_array[idx].message_id == message_id) {
-        if (gcc_encrypt_and_send_lossless_packet(chat, gconn, gconn->send_array[idx].data,
-                gconn->send_array[idx].data_length,
-                gconn->send_array[idx].message_id,
-                gconn->send_array[idx].packet_type) == 0) {
-            gconn->send_array[idx].last_send_try = tm;
+    if (entry != nullptr) {
+        if (gcc_encrypt_and_send_lossless_packet(chat, gconn, entry->data,
+                entry->data_length,
+                entry->message_id,
+                entry->packet_type) == 0) {
+            entry->last_send_try = tm;
             LOGGER_DEBUG(chat->log, "Re-sent requested packet %llu", (unsigned long long)message_id);
         } else {
             return -3;
@@ -5387,6 +5797,137 @@ static int handle_gc_broadcast(const GC_Session *_Nonnull c, GC_Chat *_Nonnull c
     return 0;
 }
 
+/** @brief Keeps a relayed broadcast until its sender is confirmed.
+ *
+ * Drops the oldest kept broadcast if there is no room.
+ */
+static void add_gc_relay_pending(GC_Chat *_Nonnull chat, const uint8_t *_Nonnull data, uint16_t length)
+{
+    uint8_t *packet = (uint8_t *)mem_balloc(chat->mem, length);
+
+    if (packet == nullptr) {
+        return;
+    }
+
+    memcpy(packet, data, length);
+
+    GC_Relay_Pending *pending = &chat->relay_pending[chat->relay_pending_index];
+    mem_delete(chat->mem, pending->packet);
+
+    pending->packet = packet;
+    pending->length = length;
+    pending->time_added = mono_time_get(chat->mono_time);
+
+    chat->relay_pending_index = (chat->relay_pending_index + 1) % GC_RELAY_PENDING_SIZE;
+}
+
+/** @brief Handles a relayed broadcast.
+ *
+ * Checks the original sender's signature, passes the broadcast on to our part of
+ * the relay tree and then handles it as if the original sender had sent it to us.
+ * Broadcasts from senders we haven't confirmed yet are kept until we do, since
+ * their signature can't be checked before.
+ * Broadcasts whose relay message ID we handled before, or that are too old to
+ * tell, are dropped, which stops replays.
+ *
+ * Returns 0 if packet is handled correctly or dropped.
+ * Returns -1 if the packet is invalid.
+ */
+static int handle_gc_relayed_broadcast(const GC_Session *_Nonnull c, GC_Chat *_Nonnull chat, const uint8_t *_Nullable data,
+                                       uint16_t length, void *_Nullable userdata)
+{
+    if (data == nullptr || length < GC_RELAY_HEADER_SIZE + GC_BROADCAST_ENC_HEADER_SIZE + SIGNATURE_SIZE) {
+        return -1;
+    }
+
+    const uint8_t *origin_pk = data + ENC_PUBLIC_KEY_SIZE;
+    const uint8_t *broadcast = data + GC_RELAY_HEADER_SIZE;
+    const uint16_t broadcast_len = length - GC_RELAY_HEADER_SIZE - SIGNATURE_SIZE;
+
+    if (!gc_broadcast_is_relayable(broadcast[0])) {
+        return -1;
+    }
+
+    // Our own broadcast can come back if a peer sees the group differently.
+    if (memcmp(origin_pk, get_enc_key(&chat->self_public_key), ENC_PUBLIC_KEY_SIZE) == 0) {
+        return 0;
+    }
+
+    uint64_t message_id;
+    net_unpack_u64(origin_pk + ENC_PUBLIC_KEY_SIZE, &message_id);
+
+    const uint64_t fingerprint = gc_relay_fingerprint(&chat->relay_seen, origin_pk, message_id);
+
+    if (gc_relay_seen_has(&chat->relay_seen, fingerprint)) {
+        return 0;
+    }
+
+    const int origin_peer_number = get_peer_number_of_enc_pk(chat, origin_pk, true);
+
+    if (origin_peer_number == -1) {
+        LOGGER_DEBUG(chat->log, "Keeping relayed broadcast from unknown peer");
+        add_gc_relay_pending(chat, data, length);
+        return 0;
+    }
+
+    GC_Connection *origin_gconn = get_gc_connection(chat, origin_peer_number);
+
+    assert(origin_gconn != nullptr);
+
+    if (!crypto_signature_verify(data + length - SIGNATURE_SIZE, origin_pk, length - ENC_PUBLIC_KEY_SIZE - SIGNATURE_SIZE,
+                                 get_sig_pk(&origin_gconn->addr.public_key))) {
+        LOGGER_WARNING(chat->log, "Relayed broadcast has an invalid signature");
+        return -1;
+    }
+
+    if (!gc_relay_window_accept(&origin_gconn->relay_window, message_id)) {
+        LOGGER_DEBUG(chat->log, "Dropping old or replayed relayed broadcast");
+        return 0;
+    }
+
+    gc_relay_seen_add(&chat->relay_seen, fingerprint);
+
+    uint8_t *packet = (uint8_t *)mem_balloc(chat->mem, length);
+
+    if (packet != nullptr) {
+        memcpy(packet, data, length);
+        relay_gc_broadcast(chat, packet, length);
+        mem_delete(chat->mem, packet);
+    }
+
+    return handle_gc_broadcast(c, chat, (uint32_t)origin_peer_number, broadcast, broadcast_len, userdata);
+}
+
+/** @brief Handles the kept relayed broadcasts of a sender that was just confirmed.
+ *
+ * Kept broadcasts that waited too long are dropped on the way.
+ */
+static void handle_gc_relay_pending(const GC_Session *c, GC_Chat *chat, const uint8_t *origin_pk, void *userdata)
+{
+    for (uint16_t i = 0; i < GC_RELAY_PENDING_SIZE; ++i) {
+        GC_Relay_Pending *pending = &chat->relay_pending[i];
+        uint8_t *packet = pending->packet;
+
+        if (packet == nullptr) {
+            continue;
+        }
+
+        const bool expired = mono_time_is_timeout(chat->mono_time, pending->time_added, GC_RELAY_PENDING_TIMEOUT);
+
+        if (!expired && memcmp(packet + ENC_PUBLIC_KEY_SIZE, origin_pk, ENC_PUBLIC_KEY_SIZE) != 0) {
+            continue;
+        }
+
+        pending->packet = nullptr;
+
+        if (!expired) {
+            handle_gc_relayed_broadcast(c, chat, packet, pending->length, userdata);
+        }
+
+        mem_delete(chat->mem, packet);
+    }
+}
+
 /** @brief Decrypts data of size `length` using self secret key and sender's public key.
  *
  * The packet payload should begin with a nonce.
@@ -5427,7 +5968,7 @@ static int unwrap_group_handshake_packet(const Logger *_Nonnull log, const Memor
 static int wrap_group_handshake_packet(const Logger *_Nonnull log, const Memory *_Nonnull mem, const Random *_Nonnull rng, const uint8_t *_Nonnull self_pk, const uint8_t *_Nonnull self_sk,
                                        const uint8_t *_Nonnull target_pk, uint8_t *_Nonnull packet, uint32_t packet_size, const uint8_t *_Nonnull data, uint16_t length)
 {
-    if (packet_size != GC_MIN_ENCRYPTED_HS_PAYLOAD_SIZE + sizeof(Node_format)) {
+    if (packet_size != GC_MIN_ENCRYPTED_HS_PAYLOAD_SIZE + GC_HS_OPTIONAL_SIZE) {
         LOGGER_FATAL(log, "Invalid packet size: %u", packet_size);
         return -1;
     }
@@ -5464,7 +6005,8 @@ static int wrap_group_handshake_packet(const Logger *_Nonnull log, const Memory
 /** @brief Makes, wraps and encrypts a group handshake packet (both request and response are the same format).
  *
  * Packet contains the packet header, handshake type, self public encryption key, self public signature key,
- * request type, and a single TCP relay node.
+ * request type, join type, a single TCP relay node and our feature flags. Clients that predate the flags
+ * ignore them.
  *
  * Returns length of encrypted packet on success.
  * Returns -1 on failure.
@@ -5476,12 +6018,12 @@ static int make_gc_handshake_packet(const GC_Chat *_Nonnull chat, const GC_Conne
         return -1;
     }
 
-    if (packet_size != GC_MIN_ENCRYPTED_HS_PAYLOAD_SIZE + sizeof(Node_format)) {
+    if (packet_size != GC_MIN_ENCRYPTED_HS_PAYLOAD_SIZE + GC_HS_OPTIONAL_SIZE) {
         LOGGER_FATAL(chat->log, "invalid packet size: %zu", packet_size);
         return -1;
     }
 
-    uint8_t data[GC_MIN_HS_PACKET_PAYLOAD_SIZE + sizeof(Node_format)];
+    uint8_t data[GC_MIN_HS_PACKET_PAYLOAD_SIZE + GC_HS_OPTIONAL_SIZE];
 
     uint32_t length = sizeof(uint8_t);
 
@@ -5503,11 +6045,14 @@ static int make_gc_handshake_packet(const GC_Chat *_Nonnull chat, const GC_Conne
         nodes_size = 0;
     }
 
+    data[length] = GC_HS_FLAG_RELAYED_BROADCAST;
+    ++length;
+
     const int enc_len = wrap_group_handshake_packet(
                             chat->log, chat->mem, chat->rng, chat->self_public_key.enc, chat->self_secret_key.enc,
                             gconn->addr.public_key.enc, packet, (uint16_t)packet_size, data, (uint16_t)length);
 
-    if (enc_len != GC_MIN_ENCRYPTED_HS_PAYLOAD_SIZE + nodes_size) {
+    if (enc_len != GC_MIN_ENCRYPTED_HS_PAYLOAD_SIZE + nodes_size + 1) {
         LOGGER_WARNING(chat->log, "Failed to wrap handshake packet: %d", enc_len);
         return -1;
     }
@@ -5533,7 +6078,7 @@ static bool send_gc_handshake_packet(const GC_Chat *chat, GC_Connection *gconn,
         LOGGER_TRACE(chat->log, "Failed to copy TCP relay during handshake (%u TCP relays)", gconn->tcp_relays_count);
     }
 
-    uint8_t packet[GC_MIN_ENCRYPTED_HS_PAYLOAD_SIZE + sizeof(Node_format)];
+    uint8_t packet[GC_MIN_ENCRYPTED_HS_PAYLOAD_SIZE + GC_HS_OPTIONAL_SIZE];
     const int length = make_gc_handshake_packet(chat, gconn, handshake_type, request_type, join_type, packet,
                        sizeof(packet), &node);
 
@@ -5591,7 +6136,7 @@ static bool send_gc_oob_handshake_request(const GC_Chat *chat, const GC_Connecti
         return false;
     }
 
-    uint8_t packet[GC_MIN_ENCRYPTED_HS_PAYLOAD_SIZE + sizeof(Node_format)];
+    uint8_t packet[GC_MIN_ENCRYPTED_HS_PAYLOAD_SIZE + GC_HS_OPTIONAL_SIZE];
     const int length = make_gc_handshake_packet(chat, gconn, GH_REQUEST, gconn->pending_handshake_type, chat->join_type,
                        packet, sizeof(packet), &node);
 
@@ -5611,6 +6156,23 @@ static bool send_gc_oob_handshake_request(const GC_Chat *chat, const GC_Connecti
  * Returns peer_number of new connected peer on success.
  * Returns -1 on failure.
  */
+/** @brief Returns the feature flags at the end of a handshake packet.
+ *
+ * `data` starts after the join type, at the optional TCP relay node. Clients that
+ * predate the flags don't send them, which reads as no flags.
+ */
+static uint8_t unpack_gc_handshake_flags(const uint8_t *_Nonnull data, uint16_t length)
+{
+    Node_format node;
+    uint16_t nodes_len = 0;
+
+    if (unpack_nodes(&node, 1, &nodes_len, data, length, true) <= 0) {
+        nodes_len = 0;
+    }
+
+    return length == nodes_len + 1 ? data[nodes_len] : 0;
+}
+
 static int handle_gc_handshake_response(const GC_Chat *_Nonnull chat, const IP_Port *_Nullable ipp,
                                         const uint8_t *_Nonnull sender_pk, const uint8_t *_Nonnull data, uint16_t length)
 {
@@ -5642,10 +6204,17 @@ static int handle_gc_handshake_response(const GC_Chat *_Nonnull chat, const IP_P
 
     gcc_make_session_shared_key(gconn, sender_session_pk);
 
-    set_sig_pk(&gconn->addr.public_key, data + ENC_PUBLIC_KEY_SIZE);
+    if (!peer_set_sig_pk(chat, peer_number, data + ENC_PUBLIC_KEY_SIZE)) {
+        LOGGER_ERROR(chat->log, "Failed to index signature key of peer %d", peer_number);
+        return -1;
+    }
 
     gcc_set_recv_message_id(gconn, 2);  // handshake response is always second packet
 
+    const uint16_t processed = ENC_PUBLIC_KEY_SIZE + SIG_PUBLIC_KEY_SIZE + 1 + 1;
+    const uint8_t flags = length > processed ? unpack_gc_handshake_flags(data + processed, length - processed) : 0;
+    gconn->relays_broadcasts = (flags & GC_HS_FLAG_RELAYED_BROADCAST) != 0;
+
     gconn->handshaked = true;
 
     send_gc_hs_response_ack(chat, gconn);
@@ -5794,7 +6363,11 @@ static int handle_gc_handshake_request(GC_Chat *_Nonnull chat, const IP_Port *_N
 
     gcc_make_session_shared_key(gconn, sender_session_pk);
 
-    set_sig_pk(&gconn->addr.public_key, public_sig_key);
+    if (!peer_set_sig_pk(chat, peer_number, public_sig_key)) {
+        LOGGER_ERROR(chat->log, "Failed to index signature key of peer %d", peer_number);
+        gcc_mark_for_deletion(gconn, chat->tcp_conn, GC_EXIT_TYPE_DISCONNECTED, nullptr, 0);
+        return -1;
+    }
 
     if (join_type == HJ_PUBLIC && !is_public_chat(chat)) {
         gcc_mark_for_deletion(gconn, chat->tcp_conn, GC_EXIT_TYPE_DISCONNECTED, nullptr, 0);
@@ -5804,6 +6377,9 @@ static int handle_gc_handshake_request(GC_Chat *_Nonnull chat, const IP_Port *_N
 
     gcc_set_recv_message_id(gconn, 1);  // handshake request is always first packet
 
+    const uint8_t flags = unpack_gc_handshake_flags(data + processed, length - processed);
+    gconn->relays_broadcasts = (flags & GC_HS_FLAG_RELAYED_BROADCAST) != 0;
+
     gconn->is_pending_handshake_response = true;
     gconn->pending_handshake_type = request_type;
 
@@ -5878,6 +6454,11 @@ bool handle_gc_lossless_helper(const GC_Session *c, GC_Chat *chat, uint32_t peer
             break;
         }
 
+        case GP_RELAYED_BROADCAST: {
+            ret = handle_gc_relayed_broadcast(c, chat, data, length, userdata);
+            break;
+        }
+
         case GP_PEER_INFO_REQUEST: {
             ret = handle_gc_peer_info_request(chat, peer_number);
             break;
@@ -6073,7 +6654,7 @@ static bool handle_gc_lossless_packet(const GC_Session *_Nonnull c, GC_Chat *_No
         return false;
     }
 
-    const int lossless_ret = gcc_handle_received_message(chat->log, chat->mem, chat->mono_time, gconn, data, (uint16_t) len, packet_type, message_id, direct_conn);
+    const int lossless_ret = gcc_handle_received_message(chat->log, chat->packet_pool, chat->mono_time, gconn, data, (uint16_t) len, packet_type, message_id, direct_conn);
 
     if (packet_type == GP_INVITE_REQUEST && !gconn->handshaked) {  // Both peers sent request at same time
         mem_delete(chat->mem, data);
@@ -6581,12 +7162,26 @@ static bool peer_delete(const GC_Session *_Nonnull c, GC_Chat *_Nonnull chat, ui
         saved_peers_remove_entry(chat, gconn->addr.public_key.enc);
     }
 
-    gcc_peer_cleanup(chat->mem, gconn);
+    peer_index_release(chat, chat->peers_by_enc_pk, false, get_enc_key(&gconn->addr.public_key), peer_number);
+    peer_index_release(chat, chat->peers_by_sig_pk, true, get_sig_pk(&gconn->addr.public_key), peer_number);
+
+    gcc_peer_cleanup(chat->packet_pool, gconn);
 
     --chat->numpeers;
 
     if (chat->numpeers != peer_number) {
         chat->group[peer_number] = chat->group[chat->numpeers];
+
+        // The last peer moved into the deleted peer's slot.
+        const Extended_Public_Key *moved_pk = &chat->group[peer_number].gconn.addr.public_key;
+
+        if (pk_index_get(chat->peers_by_enc_pk, get_enc_key(moved_pk)) == chat->numpeers) {
+            pk_index_add(chat->peers_by_enc_pk, get_enc_key(moved_pk), peer_number);
+        }
+
+        if (pk_index_get(chat->peers_by_sig_pk, get_sig_pk(moved_pk)) == chat->numpeers) {
+            pk_index_add(chat->peers_by_sig_pk, get_sig_pk(moved_pk), peer_number);
+        }
     }
 
     chat->group[chat->numpeers] = (GC_Peer) {
@@ -6669,37 +7264,37 @@ int peer_add(GC_Chat *chat, const IP_Port *ipp, const uint8_t *public_key)
         }
     }
 
-    GC_Message_Array_Entry *send = (GC_Message_Array_Entry *)mem_valloc(chat->mem, GCC_BUFFER_SIZE, sizeof(GC_Message_Array_Entry));
-    GC_Message_Array_Entry *recv = (GC_Message_Array_Entry *)mem_valloc(chat->mem, GCC_BUFFER_SIZE, sizeof(GC_Message_Array_Entry));
+    GC_Peer *tmp_group = (GC_Peer *)mem_vrealloc(chat->mem, chat->group, chat->numpeers + 1, sizeof(GC_Peer));
 
-    if (send == nullptr || recv == nullptr) {
-        LOGGER_ERROR(chat->log, "Failed to allocate memory for gconn buffers");
+    if (tmp_group == nullptr) {
+        LOGGER_ERROR(chat->log, "Failed to allocate memory for group mem_vrealloc");
 
         if (tcp_connection_num != -1) {
             kill_tcp_connection_to(chat->tcp_conn, tcp_connection_num);
         }
 
-        mem_delete(chat->mem, send);
-        mem_delete(chat->mem, recv);
         return -1;
     }
 
-    GC_Peer *tmp_group = (GC_Peer *)mem_vrealloc(chat->mem, chat->group, chat->numpeers + 1, sizeof(GC_Peer));
+    chat->group = tmp_group;
 
-    if (tmp_group == nullptr) {
-        LOGGER_ERROR(chat->log, "Failed to allocate memory for group mem_vrealloc");
+    if (!pk_index_add(chat->peers_by_enc_pk, public_key, peer_number)) {
+        LOGGER_ERROR(chat->log, "Failed to index peer %d", peer_number);
 
         if (tcp_connection_num != -1) {
             kill_tcp_connection_to(chat->tcp_conn, tcp_connection_num);
         }
 
-        mem_delete(chat->mem, send);
-        mem_delete(chat->mem, recv);
+        return -1;
+    }
+
+    if (peer_number == 0 && !pk_index_add(chat->peers_by_sig_pk, get_sig_pk(&chat->self_public_key), peer_number)) {
+        LOGGER_ERROR(chat->log, "Failed to index our own signature key");
+        pk_index_remove(chat->peers_by_enc_pk, public_key);
         return -1;
     }
 
     ++chat->numpeers;
-    chat->group = tmp_group;
 
     chat->group[peer_number] = (GC_Peer) {
         0
@@ -6707,9 +7302,6 @@ int peer_add(GC_Chat *chat, const IP_Port *ipp, const uint8_t *public_key)
 
     GC_Connection *gconn = &chat->group[peer_number].gconn;
 
-    gconn->send_array = send;
-    gconn->recv_array = recv;
-
     gcc_set_ip_port(gconn, ipp);
     chat->group[peer_number].role = GR_USER;
     chat->group[peer_number].peer_id = peer_id;
@@ -7178,6 +7770,19 @@ void do_gc(GC_Session *c, void *userdata)
     }
 }
 
+void gc_visit_sockets(const GC_Session *c, net_socket_visit_cb *cb, void *obj)
+{
+    for (uint32_t i = 0; i < c->chats_index; ++i) {
+        const GC_Chat *chat = &c->chats[i];
+
+        if (chat->connection_state == CS_NONE || chat->connection_state == CS_DISCONNECTED) {
+            continue;
+        }
+
+        tcp_connections_visit_sockets(chat->tcp_conn, cb, obj);
+    }
+}
+
 /** @brief Set the size of the groupchat list to n.
  *
  * Return true on success.
@@ -7317,6 +7922,14 @@ static void init_gc_moderation(GC_Chat *_Nonnull chat)
 
 static bool create_new_chat_ext_keypair(GC_Chat *_Nonnull chat);
 
+/** @brief Have the host we share the socket with, if any, send handshakes to our key in `chat` to us. */
+static void add_host_key(const GC_Session *_Nonnull c, const GC_Chat *_Nonnull chat)
+{
+    if (c->messenger->host_instance != nullptr) {
+        host_instance_add_key(c->messenger->host_instance, get_enc_key(&chat->self_public_key));
+    }
+}
+
 static int create_new_group(const Memory *_Nonnull mem, GC_Session *_Nonnull c, const uint8_t *_Nonnull nick, size_t nick_length, bool founder, const Group_Privacy_State privacy_state)
 {
     if (nick == nullptr || nick_length == 0) {
@@ -7351,6 +7964,24 @@ static int create_new_group(const Memory *_Nonnull mem, GC_Session *_Nonnull c,
     chat->last_ping_interval = tm;
     chat->friend_connection_id = -1;
 
+    chat->packet_pool = gcc_packet_pool_new(chat->mem);
+
+    if (chat->packet_pool == nullptr) {
+        LOGGER_ERROR(chat->log, "Failed to create packet pool");
+        group_delete(c, chat);
+        return -1;
+    }
+
+    chat->relay_seen.seed = random_u64(chat->rng);
+    chat->peers_by_enc_pk = pk_index_new(chat->mem, chat->rng);
+    chat->peers_by_sig_pk = pk_index_new(chat->mem, chat->rng);
+
+    if (chat->peers_by_enc_pk == nullptr || chat->peers_by_sig_pk == nullptr) {
+        LOGGER_ERROR(chat->log, "Failed to create peer indexes");
+        group_delete(c, chat);
+        return -1;
+    }
+
     if (!create_new_chat_ext_keypair(chat)) {
         LOGGER_ERROR(chat->log, "Failed to create extended keypair");
         group_delete(c, chat);
@@ -7382,6 +8013,7 @@ static int create_new_group(const Memory *_Nonnull mem, GC_Session *_Nonnull c,
     self_gc_set_role(chat, founder ? GR_FOUNDER : GR_USER);
     self_gc_set_confirmed(chat, true);
     self_gc_set_ext_public_key(chat, &chat->self_public_key);
+    add_host_key(c, chat);
 
     return group_number;
 }
@@ -7494,6 +8126,22 @@ int gc_group_load(GC_Session *c, Bin_Unpack *bu)
     chat->moderation.log = m->log;
     chat->moderation.mem = m->mem;
 
+    chat->packet_pool = gcc_packet_pool_new(chat->mem);
+
+    if (chat->packet_pool == nullptr) {
+        LOGGER_ERROR(chat->log, "Failed to create packet pool");
+        return -1;
+    }
+
+    chat->relay_seen.seed = random_u64(chat->rng);
+    chat->peers_by_enc_pk = pk_index_new(chat->mem, chat->rng);
+    chat->peers_by_sig_pk = pk_index_new(chat->mem, chat->rng);
+
+    if (chat->peers_by_enc_pk == nullptr || chat->peers_by_sig_pk == nullptr) {
+        LOGGER_ERROR(chat->log, "Failed to create peer indexes");
+        return -1;
+    }
+
     if (!gc_load_unpack_group(chat, bu)) {
         LOGGER_ERROR(chat->log, "Failed to unpack group");
         return -1;
@@ -7506,6 +8154,8 @@ int gc_group_load(GC_Session *c, Bin_Unpack *bu)
         return -1;
     }
 
+    add_host_key(c, chat);
+
     if (chat->connection_state == CS_DISCONNECTED) {
         return group_number;
     }
@@ -8139,6 +8789,10 @@ static void group_cleanup(const GC_Session *c, GC_Chat *chat)
 {
     kill_group_friend_connection(c, chat);
 
+    if (c->messenger->host_instance != nullptr) {
+        host_instance_remove_key(c->messenger->host_instance, get_enc_key(&chat->self_public_key));
+    }
+
     mod_list_cleanup(&chat->moderation);
     sanctions_list_cleanup(&chat->moderation);
 
@@ -8153,6 +8807,19 @@ static void group_cleanup(const GC_Session *c, GC_Chat *chat)
         chat->group = nullptr;
     }
 
+    gcc_packet_pool_kill(chat->packet_pool);
+    chat->packet_pool = nullptr;
+
+    for (uint16_t i = 0; i < GC_RELAY_PENDING_SIZE; ++i) {
+        mem_delete(chat->mem, chat->relay_pending[i].packet);
+        chat->relay_pending[i].packet = nullptr;
+    }
+
+    pk_index_kill(chat->peers_by_enc_pk);
+    chat->peers_by_enc_pk = nullptr;
+    pk_index_kill(chat->peers_by_sig_pk);
+    chat->peers_by_sig_pk = nullptr;
+
     crypto_memunlock(&chat->self_secret_key, sizeof(chat->self_secret_key));
     crypto_memunlock(&chat->chat_secret_key, sizeof(chat->chat_secret_key));
     crypto_memunlock(chat->shared_state.password, sizeof(chat->shared_state.password));
@@ -90,6 +90,7 @@ typedef enum Group_Packet_Type {
     GP_INVITE_RESPONSE_REJECT   = 0x03,
 
     /* lossless packets */
+    GP_RELAYED_BROADCAST        = 0xed,
     GP_CUSTOM_PRIVATE_PACKET    = 0xee,
     GP_FRAGMENT                 = 0xef,
     GP_KEY_ROTATION             = 0xf0,
@@ -499,6 +500,16 @@ int gc_founder_set_voice_state(const Messenger *_Nonnull m, int group_number, Gr
  */
 int gc_founder_set_max_peers(GC_Chat *_Nonnull chat, uint16_t max_peers);
 
+/** @brief Sets the fanout of the relay tree our messages, nick and status changes are sent over.
+ *
+ * With a fanout of 0 they are sent to every peer, which is the default. Otherwise they
+ * are sent to `fanout` peers, which pass them on (see group_relay.h). This only takes
+ * effect in groups with more than `fanout` peers that understand relayed broadcasts,
+ * which peers say in their handshake. Older peers are left out of the tree and get
+ * our broadcasts directly.
+ */
+void gc_set_relay_fanout(GC_Chat *_Nonnull chat, uint8_t fanout);
+
 /** @brief Removes peer designated by `peer_id` from peer list and sends a broadcast instructing
  * all other peers to remove the peer from their peerlist as well.
  *
@@ -541,6 +552,9 @@ void gc_callback_voice_state(const Messenger *_Nonnull m, gc_voice_state_cb *_Nu
 
 /** @brief The main loop. Should be called with every Messenger iteration. */
 void do_gc(GC_Session *_Nonnull c, void *_Nullable userdata);
+
+/** @brief Call `cb` for the sockets of every group chat's TCP relay connections. */
+void gc_visit_sockets(const GC_Session *_Nonnull c, net_socket_visit_cb *_Nonnull cb, void *_Nonnull obj);
 /**
  * Make sure that DHT is initialized before calling this.
  * Returns a NULL pointer on failure.
@@ -17,12 +17,14 @@
 #include "attributes.h"
 #include "crypto_core.h"
 #include "group_moderation.h"
+#include "group_relay.h"
 #include "logger.h"
 #include "mem.h"
 #include "mono_time.h"
 #include "net.h"
 #include "net_profile.h"
 #include "network.h"
+#include "pk_index.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -60,6 +62,9 @@ extern "C" {
 /* Max number of messages to store in the send/recv arrays */
 #define GCC_BUFFER_SIZE 2048
 
+/* Number of slots the send/recv arrays get on first use. They double on demand up to GCC_BUFFER_SIZE */
+#define GCC_BUFFER_MIN_SIZE 16
+
 /** Self UDP status. Must correspond to return values from `ipport_self_copy()`. */
 typedef enum Self_UDP_Status {
     SELF_UDP_STATUS_NONE = 0x00,
@@ -98,17 +103,27 @@ typedef struct GC_Message_Array_Entry {
     uint64_t last_send_try;
 } GC_Message_Array_Entry;
 
+/** Per-chat pool of data buffers for GC_Message_Array_Entry. See group_connection.h. */
+typedef struct GC_Packet_Pool GC_Packet_Pool;
+
 typedef struct GC_Connection {
     uint64_t send_message_id;   /* message_id of the next message we send to peer */
 
     uint16_t send_array_start;   /* send_array index of oldest item */
+    uint16_t send_array_size;    /* 0 or a power of 2, at most GCC_BUFFER_SIZE */
     GC_Message_Array_Entry *_Nullable send_array;
 
     uint64_t received_message_id;   /* message_id of peer's last message to us */
+    uint16_t recv_array_size;    /* 0 or a power of 2, at most GCC_BUFFER_SIZE */
+    uint16_t recv_array_count;   /* number of messages stored in recv_array */
     GC_Message_Array_Entry *_Nullable recv_array;
 
     uint64_t    last_chunk_id;  /* The message ID of the last packet fragment we received */
 
+    uint64_t    relay_message_id;  /* For self, the ID of the last relayed broadcast we sent */
+    GC_Relay_Window relay_window;  /* The relayed broadcasts we handled from this peer */
+    bool        relays_broadcasts;  /* true if this peer understands relayed broadcasts */
+
     GC_PeerAddress   addr;   /* holds peer's extended real public key and ip_port */
     uint32_t    public_key_hash;   /* Jenkins one at a time hash of peer's real encryption public key */
 
@@ -287,6 +302,9 @@ typedef struct GC_Chat {
     Group_Handshake_Join_Type join_type;
 
     GC_Peer         *_Nullable group;
+    GC_Packet_Pool  *_Nonnull packet_pool;  // data buffers for the peers' send and recv arrays
+    PK_Index        *_Nonnull peers_by_enc_pk;  // peer numbers by public encryption key
+    PK_Index        *_Nonnull peers_by_sig_pk;  // peer numbers by public signature key, once we know it
     Moderation      moderation;
 
     GC_Conn_State   connection_state;
@@ -345,6 +363,11 @@ typedef struct GC_Chat {
     uint8_t     m_group_public_key[CRYPTO_PUBLIC_KEY_SIZE];  // public key for group's messenger friend connection
     int         friend_connection_id;  // identifier for group's messenger friend connection
 
+    uint8_t     relay_fanout;  // relay our broadcasts over a tree with this fanout; 0 sends them to every peer
+    GC_Relay_Seen relay_seen;  // relayed broadcasts we've handled recently
+    GC_Relay_Pending relay_pending[GC_RELAY_PENDING_SIZE];  // relayed broadcasts from peers we haven't confirmed yet
+    uint16_t    relay_pending_index;  // the next slot in relay_pending to fill
+
     bool        flag_exit;  // true if the group will be deleted after the next do_gc() iteration
 } GC_Chat;
 
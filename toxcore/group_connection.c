@@ -32,6 +32,112 @@
 /** Seconds since last direct UDP packet was sent before we can try again. Cheap NAT hole punch */
 #define GCC_UDP_DIRECT_RETRY 1
 
+/** Maximum number of released buffers of each size a chat keeps around for reuse. */
+#define GCC_PACKET_POOL_MAX_FREE 64
+
+/** Number of buffer sizes in a GC_Packet_Pool. */
+#define GCC_PACKET_POOL_CLASSES 5
+
+/** The buffer sizes a GC_Packet_Pool hands out. The largest fits any entry. */
+static const uint16_t packet_pool_class_size[GCC_PACKET_POOL_CLASSES] = {
+    64, 128, 256, MAX_GC_PACKET_CHUNK_SIZE, MAX_GC_PACKET_INCOMING_CHUNK_SIZE
+};
+
+/**
+ * Free lists of entry data buffers, shared by all connections in a chat.
+ *
+ * Every packet waiting in a send or recv array needs a copy of its data. Taking
+ * these from a pool means steady traffic doesn't hit the allocator for every
+ * packet. Small packets such as chat messages get small buffers, so a broadcast
+ * queued for hundreds of peers doesn't pin a full chunk per peer. At most
+ * GCC_PACKET_POOL_MAX_FREE buffers of each size are kept; the rest go back to
+ * the allocator so memory is released after a burst.
+ */
+struct GC_Packet_Pool {
+    const Memory *_Nonnull mem;
+    uint8_t *_Nullable free_list[GCC_PACKET_POOL_CLASSES][GCC_PACKET_POOL_MAX_FREE];
+    uint16_t free_count[GCC_PACKET_POOL_CLASSES];
+};
+
+GC_Packet_Pool *gcc_packet_pool_new(const Memory *mem)
+{
+    GC_Packet_Pool *pool = (GC_Packet_Pool *)mem_alloc(mem, sizeof(GC_Packet_Pool));
+
+    if (pool == nullptr) {
+        return nullptr;
+    }
+
+    pool->mem = mem;
+    return pool;
+}
+
+void gcc_packet_pool_kill(GC_Packet_Pool *pool)
+{
+    if (pool == nullptr) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < GCC_PACKET_POOL_CLASSES; ++i) {
+        for (uint16_t j = 0; j < pool->free_count[i]; ++j) {
+            mem_delete(pool->mem, pool->free_list[i][j]);
+        }
+    }
+
+    mem_delete(pool->mem, pool);
+}
+
+/** @brief Returns the smallest buffer size class that fits `length` bytes. */
+static uint8_t packet_pool_class(uint16_t length)
+{
+    uint8_t i = 0;
+
+    while (i < GCC_PACKET_POOL_CLASSES - 1 && packet_pool_class_size[i] < length) {
+        ++i;
+    }
+
+    return i;
+}
+
+/** @brief Takes a buffer for `length` bytes from the pool.
+ *
+ * `length` must not exceed MAX_GC_PACKET_INCOMING_CHUNK_SIZE.
+ *
+ * Return null on allocation failure.
+ */
+static uint8_t *_Nullable packet_pool_get(GC_Packet_Pool *_Nonnull pool, uint16_t length)
+{
+    assert(length <= MAX_GC_PACKET_INCOMING_CHUNK_SIZE);
+
+    const uint8_t class_index = packet_pool_class(length);
+
+    if (pool->free_count[class_index] > 0) {
+        --pool->free_count[class_index];
+        uint8_t *data = pool->free_list[class_index][pool->free_count[class_index]];
+        pool->free_list[class_index][pool->free_count[class_index]] = nullptr;
+        return data;
+    }
+
+    return (uint8_t *)mem_balloc(pool->mem, packet_pool_class_size[class_index]);
+}
+
+/** @brief Returns a buffer for `length` bytes to the pool, or frees it if the pool is full. */
+static void packet_pool_put(GC_Packet_Pool *_Nonnull pool, uint8_t *_Nullable data, uint16_t length)
+{
+    if (data == nullptr) {
+        return;
+    }
+
+    const uint8_t class_index = packet_pool_class(length);
+
+    if (pool->free_count[class_index] >= GCC_PACKET_POOL_MAX_FREE) {
+        mem_delete(pool->mem, data);
+        return;
+    }
+
+    pool->free_list[class_index][pool->free_count[class_index]] = data;
+    ++pool->free_count[class_index];
+}
+
 /** Returns true if array entry does not contain an active packet. */
 static bool array_entry_is_empty(const GC_Message_Array_Entry *_Nonnull array_entry)
 {
@@ -40,42 +146,135 @@ static bool array_entry_is_empty(const GC_Message_Array_Entry *_Nonnull array_en
 }
 
 /** @brief Clears an array entry. */
-static void clear_array_entry(const Memory *_Nonnull mem, GC_Message_Array_Entry *_Nonnull array_entry)
+static void clear_array_entry(GC_Packet_Pool *_Nonnull pool, GC_Message_Array_Entry *_Nonnull array_entry)
 {
-    mem_delete(mem, array_entry->data);
+    packet_pool_put(pool, array_entry->data, array_entry->data_length);
 
     *array_entry = (GC_Message_Array_Entry) {
         nullptr
     };
 }
 
+/** @brief Return the index of message_id in an array of `size` slots. */
+static uint16_t get_array_index(uint16_t size, uint64_t message_id)
+{
+    assert(size > 0);
+    return message_id & (size - 1);
+}
+
+/** @brief Reallocates an array of `size` slots to `new_size` slots.
+ *
+ * Every entry moves to the slot for its message_id in the new array, so no two
+ * entries may share a slot in the new size.
+ *
+ * Return true on success. The array is unchanged on failure.
+ */
+static bool resize_array(const Memory *_Nonnull mem, GC_Message_Array_Entry *_Nullable *_Nonnull array, uint16_t size,
+                         uint16_t new_size)
+{
+    GC_Message_Array_Entry *new_array = (GC_Message_Array_Entry *)mem_valloc(mem, new_size, sizeof(GC_Message_Array_Entry));
+
+    if (new_array == nullptr) {
+        return false;
+    }
+
+    for (uint16_t i = 0; i < size; ++i) {
+        const GC_Message_Array_Entry *entry = &(*array)[i];
+
+        if (!array_entry_is_empty(entry)) {
+            new_array[get_array_index(new_size, entry->message_id)] = *entry;
+        }
+    }
+
+    mem_delete(mem, *array);
+    *array = new_array;
+
+    return true;
+}
+
+/** @brief Returns the message_id of the oldest packet in gconn's send array, or the next one if it's empty. */
+static uint64_t send_array_oldest_id(const GC_Connection *_Nonnull gconn)
+{
+    if (gconn->send_array_size == 0) {
+        return gconn->send_message_id;
+    }
+
+    const GC_Message_Array_Entry *entry = &gconn->send_array[gconn->send_array_start];
+    return array_entry_is_empty(entry) ? gconn->send_message_id : entry->message_id;
+}
+
+/** @brief Resizes gconn's send array to `new_size` slots.
+ *
+ * All unacknowledged packets must fit in the new size.
+ *
+ * Return true on success.
+ */
+static bool resize_send_array(const Memory *_Nonnull mem, GC_Connection *_Nonnull gconn, uint16_t new_size)
+{
+    const uint64_t oldest_id = send_array_oldest_id(gconn);
+
+    if (!resize_array(mem, &gconn->send_array, gconn->send_array_size, new_size)) {
+        return false;
+    }
+
+    gconn->send_array_size = new_size;
+    gconn->send_array_start = get_array_index(new_size, oldest_id);
+
+    return true;
+}
+
+/** @brief Halves gconn's send array while less than a quarter of it is in use.
+ *
+ * Failure to shrink is harmless: we keep the bigger array.
+ */
+static void shrink_send_array(const Memory *_Nonnull mem, GC_Connection *_Nonnull gconn)
+{
+    const uint64_t in_use = gconn->send_message_id - send_array_oldest_id(gconn);
+    uint16_t new_size = gconn->send_array_size;
+
+    while (new_size > GCC_BUFFER_MIN_SIZE && in_use < new_size / 4) {
+        new_size /= 2;
+    }
+
+    if (new_size != gconn->send_array_size) {
+        resize_send_array(mem, gconn, new_size);
+    }
+}
+
 /**
  * Clears every send array message from queue starting at the index designated by
  * `start_id` and ending at `end_id`, and sets the send_message_id for `gconn`
  * to `start_id`.
  */
-static void clear_send_queue_id_range(const Memory *_Nonnull mem, GC_Connection *_Nonnull gconn, uint64_t start_id, uint64_t end_id)
+static void clear_send_queue_id_range(GC_Packet_Pool *_Nonnull pool, GC_Connection *_Nonnull gconn, uint64_t start_id, uint64_t end_id)
 {
-    const uint16_t start_idx = gcc_get_array_index(start_id);
-    const uint16_t end_idx = gcc_get_array_index(end_id);
-
-    for (uint16_t i = start_idx; i != end_idx; i = (i + 1) % GCC_BUFFER_SIZE) {
-        GC_Message_Array_Entry *entry = &gconn->send_array[i];
-        clear_array_entry(mem, entry);
+    for (uint64_t id = start_id; id != end_id; ++id) {
+        GC_Message_Array_Entry *entry = &gconn->send_array[get_array_index(gconn->send_array_size, id)];
+        clear_array_entry(pool, entry);
     }
 
     gconn->send_message_id = start_id;
 }
 
-uint16_t gcc_get_array_index(uint64_t message_id)
+GC_Message_Array_Entry *gcc_get_send_array_entry(const GC_Connection *gconn, uint64_t message_id)
 {
-    return message_id % GCC_BUFFER_SIZE;
+    if (gconn->send_array_size == 0) {
+        return nullptr;
+    }
+
+    GC_Message_Array_Entry *entry = &gconn->send_array[get_array_index(gconn->send_array_size, message_id)];
+
+    if (array_entry_is_empty(entry) || entry->message_id != message_id) {
+        return nullptr;
+    }
+
+    return entry;
 }
 
 void gcc_set_send_message_id(GC_Connection *gconn, uint64_t id)
 {
     gconn->send_message_id = id;
-    gconn->send_array_start = id % GCC_BUFFER_SIZE;
+    gconn->send_array_start = gconn->send_array_size == 0 ? 0 : get_array_index(gconn->send_array_size, id);
 }
 
 void gcc_set_recv_message_id(GC_Connection *gconn, uint64_t id)
@@ -90,7 +289,7 @@ void gcc_set_recv_message_id(GC_Connection *gconn, uint64_t id)
  *
  * Return true on success.
  */
-static bool create_array_entry(const Logger *_Nonnull log, const Memory *_Nonnull mem, const Mono_Time *_Nonnull mono_time, GC_Message_Array_Entry *_Nonnull array_entry,
+static bool create_array_entry(const Logger *_Nonnull log, GC_Packet_Pool *_Nonnull pool, const Mono_Time *_Nonnull mono_time, GC_Message_Array_Entry *_Nonnull array_entry,
                                const uint8_t *_Nullable data, uint16_t length, uint8_t packet_type, uint64_t message_id)
 {
     if (!array_entry_is_empty(array_entry)) {
@@ -98,6 +297,11 @@ static bool create_array_entry(const Logger *_Nonnull log, const Memory *_Nonnul
         return false;
     }
 
+    if (length > MAX_GC_PACKET_INCOMING_CHUNK_SIZE) {
+        LOGGER_WARNING(log, "Failed to create array entry; length %u is too big", length);
+        return false;
+    }
+
     if (length == 0) {
         array_entry->data = nullptr;
         array_entry->data_length = 0;
@@ -108,7 +312,7 @@ static bool create_array_entry(const Logger *_Nonnull log, const Memory *_Nonnul
             return false;
         }
 
-        uint8_t *entry_data = (uint8_t *)mem_balloc(mem, length);
+        uint8_t *entry_data = packet_pool_get(pool, length);
 
         if (entry_data == nullptr) {
             return false;
@@ -129,23 +333,43 @@ static bool create_array_entry(const Logger *_Nonnull log, const Memory *_Nonnul
     return true;
 }
 
+/** @brief Makes room for one more packet in gconn's send array.
+ *
+ * Return false if the array is full and can't grow.
+ */
+static bool reserve_send_array(const Logger *_Nonnull log, const Memory *_Nonnull mem, GC_Connection *_Nonnull gconn)
+{
+    if (gconn->send_array_size == 0) {
+        return resize_send_array(mem, gconn, GCC_BUFFER_MIN_SIZE);
+    }
+
+    if (gconn->send_message_id - send_array_oldest_id(gconn) < (uint64_t)(gconn->send_array_size - 1)) {
+        return true;
+    }
+
+    if (gconn->send_array_size >= GCC_BUFFER_SIZE) {
+        LOGGER_DEBUG(log, "Send array overflow");
+        return false;
+    }
+
+    return resize_send_array(mem, gconn, gconn->send_array_size * 2);
+}
+
 /** @brief Adds data of length to gconn's send_array.
  *
  * Returns true and increments gconn's send_message_id on success.
  */
-static bool add_to_send_array(const Logger *_Nonnull log, const Memory *_Nonnull mem, const Mono_Time *_Nonnull mono_time, GC_Connection *_Nonnull gconn,
+static bool add_to_send_array(const Logger *_Nonnull log, GC_Packet_Pool *_Nonnull pool, const Mono_Time *_Nonnull mono_time, GC_Connection *_Nonnull gconn,
                               const uint8_t *_Nullable data, uint16_t length, uint8_t packet_type)
 {
-    /* check if send_array is full */
-    if ((gconn->send_message_id % GCC_BUFFER_SIZE) == (uint16_t)(gconn->send_array_start - 1)) {
-        LOGGER_DEBUG(log, "Send array overflow");
+    if (!reserve_send_array(log, pool->mem, gconn)) {
         return false;
     }
 
-    const uint16_t idx = gcc_get_array_index(gconn->send_message_id);
+    const uint16_t idx = get_array_index(gconn->send_array_size, gconn->send_message_id);
     GC_Message_Array_Entry *array_entry = &gconn->send_array[idx];
 
-    if (!create_array_entry(log, mem, mono_time, array_entry, data, length, packet_type, gconn->send_message_id)) {
+    if (!create_array_entry(log, pool, mono_time, array_entry, data, length, packet_type, gconn->send_message_id)) {
         return false;
     }
 
@@ -159,7 +383,7 @@ int gcc_send_lossless_packet(const GC_Chat *chat, GC_Connection *gconn, const ui
 {
     const uint64_t message_id = gconn->send_message_id;
 
-    if (!add_to_send_array(chat->log, chat->mem, chat->mono_time, gconn, data, length, packet_type)) {
+    if (!add_to_send_array(chat->log, chat->packet_pool, chat->mono_time, gconn, data, length, packet_type)) {
         LOGGER_WARNING(chat->log, "Failed to add payload to send array: (type: 0x%02x, length: %d)", packet_type, length);
         return -1;
     }
@@ -168,9 +392,9 @@ int gcc_send_lossless_packet(const GC_Chat *chat, GC_Connection *gconn, const ui
     // the same bad packet probably won't help much. Otherwise we don't care if it doesn't successfully
     // send through the wire as it will keep retrying until the connection times out.
     if (gcc_encrypt_and_send_lossless_packet(chat, gconn, data, length, message_id, packet_type) == -1) {
-        const uint16_t idx = gcc_get_array_index(message_id);
+        const uint16_t idx = get_array_index(gconn->send_array_size, message_id);
         GC_Message_Array_Entry *array_entry = &gconn->send_array[idx];
-        clear_array_entry(chat->mem, array_entry);
+        clear_array_entry(chat->packet_pool, array_entry);
         gconn->send_message_id = message_id;
         LOGGER_ERROR(chat->log, "Failed to encrypt payload: (type: 0x%02x, length: %d)", packet_type, length);
         return -2;
@@ -187,14 +411,14 @@ bool gcc_send_lossless_packet_fragments(const GC_Chat *chat, GC_Connection *gcon
         return false;
     }
 
-    const uint16_t start_id = gconn->send_message_id;
+    const uint64_t start_id = gconn->send_message_id;
 
     // First packet segment is comprised of packet type + first chunk of payload
     uint8_t chunk[MAX_GC_PACKET_CHUNK_SIZE];
     chunk[0] = packet_type;
     memcpy(chunk + 1, data, MAX_GC_PACKET_CHUNK_SIZE - 1);
 
-    if (!add_to_send_array(chat->log, chat->mem, chat->mono_time, gconn, chunk, MAX_GC_PACKET_CHUNK_SIZE, GP_FRAGMENT)) {
+    if (!add_to_send_array(chat->log, chat->packet_pool, chat->mono_time, gconn, chunk, MAX_GC_PACKET_CHUNK_SIZE, GP_FRAGMENT)) {
         return false;
     }
 
@@ -207,23 +431,20 @@ bool gcc_send_lossless_packet_fragments(const GC_Chat *chat, GC_Connection *gcon
         memcpy(chunk, data + processed, chunk_len);
         processed += chunk_len;
 
-        if (!add_to_send_array(chat->log, chat->mem, chat->mono_time, gconn, chunk, chunk_len, GP_FRAGMENT)) {
-            clear_send_queue_id_range(chat->mem, gconn, start_id, gconn->send_message_id);
+        if (!add_to_send_array(chat->log, chat->packet_pool, chat->mono_time, gconn, chunk, chunk_len, GP_FRAGMENT)) {
+            clear_send_queue_id_range(chat->packet_pool, gconn, start_id, gconn->send_message_id);
             return false;
         }
     }
 
     // empty packet signals the end of the sequence
-    if (!add_to_send_array(chat->log, chat->mem, chat->mono_time, gconn, nullptr, 0, GP_FRAGMENT)) {
-        clear_send_queue_id_range(chat->mem, gconn, start_id, gconn->send_message_id);
+    if (!add_to_send_array(chat->log, chat->packet_pool, chat->mono_time, gconn, nullptr, 0, GP_FRAGMENT)) {
+        clear_send_queue_id_range(chat->packet_pool, gconn, start_id, gconn->send_message_id);
         return false;
     }
 
-    const uint16_t start_idx = gcc_get_array_index(start_id);
-    const uint16_t end_idx = gcc_get_array_index(gconn->send_message_id);
-
-    for (uint16_t i = start_idx; i != end_idx; i = (i + 1) % GCC_BUFFER_SIZE) {
-        const GC_Message_Array_Entry *entry = &gconn->send_array[i];
+    for (uint64_t id = start_id; id != gconn->send_message_id; ++id) {
+        const GC_Message_Array_Entry *entry = &gconn->send_array[get_array_index(gconn->send_array_size, id)];
 
         if (array_entry_is_empty(entry)) {
             LOGGER_FATAL(chat->log, "array entry for packet chunk is empty");
@@ -239,9 +460,13 @@ bool gcc_send_lossless_packet_fragments(const GC_Chat *chat, GC_Connection *gcon
     return true;
 }
 
-bool gcc_handle_ack(const Logger *log, const Memory *mem, GC_Connection *gconn, uint64_t message_id)
+bool gcc_handle_ack(const Logger *log, GC_Packet_Pool *pool, GC_Connection *gconn, uint64_t message_id)
 {
-    uint16_t idx = gcc_get_array_index(message_id);
+    if (gconn->send_array_size == 0) {
+        return true;
+    }
+
+    uint16_t idx = get_array_index(gconn->send_array_size, message_id);
     GC_Message_Array_Entry *array_entry = &gconn->send_array[idx];
 
     if (array_entry_is_empty(array_entry)) {
@@ -253,16 +478,18 @@ bool gcc_handle_ack(const Logger *log, const Memory *mem, GC_Connection *gconn,
         return false;
     }
 
-    clear_array_entry(mem, array_entry);
+    clear_array_entry(pool, array_entry);
 
     /* Put send_array_start in proper position */
     if (idx == gconn->send_array_start) {
-        const uint16_t end = gconn->send_message_id % GCC_BUFFER_SIZE;
+        const uint16_t end = get_array_index(gconn->send_array_size, gconn->send_message_id);
 
         while (array_entry_is_empty(&gconn->send_array[idx]) && gconn->send_array_start != end) {
-            gconn->send_array_start = (gconn->send_array_start + 1) % GCC_BUFFER_SIZE;
-            idx = (idx + 1) % GCC_BUFFER_SIZE;
+            gconn->send_array_start = get_array_index(gconn->send_array_size, gconn->send_array_start + 1);
+            idx = gconn->send_array_start;
         }
+
+        shrink_send_array(pool->mem, gconn);
     }
 
     return true;
@@ -334,14 +561,59 @@ int gcc_save_tcp_relay(const Random *rng, GC_Connection *gconn, const Node_forma
  *
  * Return true on success.
  */
-static bool store_in_recv_array(const Logger *_Nonnull log, const Memory *_Nonnull mem, const Mono_Time *_Nonnull mono_time,
+static bool store_in_recv_array(const Logger *_Nonnull log, GC_Packet_Pool *_Nonnull pool, const Mono_Time *_Nonnull mono_time,
                                 GC_Connection *_Nonnull gconn, const uint8_t *_Nullable data,
                                 uint16_t length, uint8_t packet_type, uint64_t message_id)
 {
-    const uint16_t idx = gcc_get_array_index(message_id);
-    GC_Message_Array_Entry *ary_entry = &gconn->recv_array[idx];
+    if (gconn->recv_array_size == 0) {
+        if (!resize_array(pool->mem, &gconn->recv_array, 0, GCC_BUFFER_MIN_SIZE)) {
+            return false;
+        }
 
-    return create_array_entry(log, mem, mono_time, ary_entry, data, length, packet_type, message_id);
+        gconn->recv_array_size = GCC_BUFFER_MIN_SIZE;
+    }
+
+    // Grow the array until the message gets a slot of its own.
+    while (gconn->recv_array_size < GCC_BUFFER_SIZE) {
+        const GC_Message_Array_Entry *entry = &gconn->recv_array[get_array_index(gconn->recv_array_size, message_id)];
+
+        if (array_entry_is_empty(entry) || entry->message_id == message_id) {
+            break;
+        }
+
+        if (!resize_array(pool->mem, &gconn->recv_array, gconn->recv_array_size, gconn->recv_array_size * 2)) {
+            return false;
+        }
+
+        gconn->recv_array_size *= 2;
+    }
+
+    GC_Message_Array_Entry *ary_entry = &gconn->recv_array[get_array_index(gconn->recv_array_size, message_id)];
+
+    if (!create_array_entry(log, pool, mono_time, ary_entry, data, length, packet_type, message_id)) {
+        return false;
+    }
+
+    ++gconn->recv_array_count;
+
+    return true;
+}
+
+/** @brief Clears an entry in gconn's recv array, shrinking the array once it's empty. */
+static void clear_recv_array_entry(GC_Packet_Pool *_Nonnull pool, GC_Connection *_Nonnull gconn,
+                                   GC_Message_Array_Entry *_Nonnull array_entry)
+{
+    clear_array_entry(pool, array_entry);
+
+    assert(gconn->recv_array_count > 0);
+    --gconn->recv_array_count;
+
+    if (gconn->recv_array_count == 0 && gconn->recv_array_size > GCC_BUFFER_MIN_SIZE) {
+        // Failure to shrink is harmless: we keep the bigger array.
+        if (resize_array(pool->mem, &gconn->recv_array, gconn->recv_array_size, GCC_BUFFER_MIN_SIZE)) {
+            gconn->recv_array_size = GCC_BUFFER_MIN_SIZE;
+        }
+    }
 }
 
 /**
@@ -355,16 +627,20 @@ static bool store_in_recv_array(const Logger *_Nonnull log, const Memory *_Nonnu
  * Return the length of the fully reassembled packet on success.
  * Return 0 on failure.
  */
-static uint16_t reassemble_packet(const Logger *_Nonnull log, const Memory *_Nonnull mem, GC_Connection *_Nullable gconn, uint8_t *_Nonnull *payload, uint64_t message_id)
+static uint16_t reassemble_packet(const Logger *_Nonnull log, GC_Packet_Pool *_Nonnull pool, GC_Connection *_Nonnull gconn, uint8_t *_Nonnull *payload, uint64_t message_id)
 {
-    uint16_t end_idx = gcc_get_array_index(message_id - 1);
-    uint16_t start_idx = end_idx;
+    if (gconn->recv_array_size == 0) {
+        return 0;
+    }
+
+    uint64_t start_id = message_id;
     uint16_t packet_length = 0;
 
-    GC_Message_Array_Entry *entry = &gconn->recv_array[end_idx];
+    const GC_Message_Array_Entry *entry = &gconn->recv_array[get_array_index(gconn->recv_array_size, start_id - 1)];
 
-    // search backwards in recv array until we find an empty slot or a non-fragment packet type
-    while (!array_entry_is_empty(entry) && entry->packet_type == GP_FRAGMENT) {
+    // search backwards in recv array until we find an empty slot, a non-fragment packet type, or a
+    // packet that isn't the one right before the last one we found
+    while (!array_entry_is_empty(entry) && entry->packet_type == GP_FRAGMENT && entry->message_id == start_id - 1) {
         assert(entry->data != nullptr);
         assert(entry->data_length <= MAX_GC_PACKET_INCOMING_CHUNK_SIZE);
 
@@ -378,39 +654,31 @@ static uint16_t reassemble_packet(const Logger *_Nonnull log, const Memory *_Non
             return 0;
         }
 
-        start_idx = start_idx > 0 ? start_idx - 1 : GCC_BUFFER_SIZE - 1;
-        entry = &gconn->recv_array[start_idx];
-
-        if (start_idx == end_idx) {
-            LOGGER_ERROR(log, "Packet reassemble wrap-around");
-            return 0;
-        }
+        --start_id;
+        entry = &gconn->recv_array[get_array_index(gconn->recv_array_size, start_id - 1)];
     }
 
     if (packet_length == 0) {
         return 0;
     }
 
-    uint8_t *tmp_payload = (uint8_t *)mem_balloc(mem, packet_length);
+    uint8_t *tmp_payload = (uint8_t *)mem_balloc(pool->mem, packet_length);
 
     if (tmp_payload == nullptr) {
         LOGGER_ERROR(log, "Failed to allocate %u bytes for payload buffer", packet_length);
         return 0;
     }
 
-    start_idx = (start_idx + 1) % GCC_BUFFER_SIZE;
-    end_idx = (end_idx + 1) % GCC_BUFFER_SIZE;
-
     uint16_t processed = 0;
 
-    for (uint16_t i = start_idx; i != end_idx; i = (i + 1) % GCC_BUFFER_SIZE) {
-        entry = &gconn->recv_array[i];
+    for (uint64_t id = start_id; id != message_id; ++id) {
+        GC_Message_Array_Entry *fragment = &gconn->recv_array[get_array_index(gconn->recv_array_size, id)];
 
-        assert(processed + entry->data_length <= packet_length);
-        memcpy(tmp_payload + processed, entry->data, entry->data_length);
-        processed += entry->data_length;
+        assert(processed + fragment->data_length <= packet_length);
+        memcpy(tmp_payload + processed, fragment->data, fragment->data_length);
+        processed += fragment->data_length;
 
-        clear_array_entry(mem, entry);
+        clear_recv_array_entry(pool, gconn, fragment);
     }
 
     assert(*payload == nullptr);
@@ -424,7 +692,7 @@ int gcc_handle_packet_fragment(const GC_Session *c, GC_Chat *chat, uint32_t peer
                                uint64_t message_id, void *userdata)
 {
     if (length > 0) {
-        if (!store_in_recv_array(chat->log, chat->mem, chat->mono_time, gconn, chunk, length, packet_type, message_id)) {
+        if (!store_in_recv_array(chat->log, chat->packet_pool, chat->mono_time, gconn, chunk, length, packet_type, message_id)) {
             return -1;
         }
 
@@ -438,7 +706,7 @@ int gcc_handle_packet_fragment(const GC_Session *c, GC_Chat *chat, uint32_t peer
     memcpy(sender_pk, get_enc_key(&gconn->addr.public_key), ENC_PUBLIC_KEY_SIZE);
 
     uint8_t *payload = nullptr;
-    const uint16_t processed_len = reassemble_packet(chat->log, chat->mem, gconn, &payload, message_id);
+    const uint16_t processed_len = reassemble_packet(chat->log, chat->packet_pool, gconn, &payload, message_id);
 
     if (processed_len == 0) {
         mem_delete(chat->mem, payload);
@@ -469,7 +737,7 @@ int gcc_handle_packet_fragment(const GC_Session *c, GC_Chat *chat, uint32_t peer
     return 0;
 }
 
-int gcc_handle_received_message(const Logger *log, const Memory *mem, const Mono_Time *mono_time, GC_Connection *gconn,
+int gcc_handle_received_message(const Logger *log, GC_Packet_Pool *pool, const Mono_Time *mono_time, GC_Connection *gconn,
                                 const uint8_t *data, uint16_t length, uint8_t packet_type, uint64_t message_id,
                                 bool direct_conn)
 {
@@ -488,7 +756,7 @@ int gcc_handle_received_message(const Logger *log, const Memory *mem, const Mono
 
     /* we're missing an older message from this peer so we store it in recv_array */
     if (message_id > gconn->received_message_id + 1) {
-        if (!store_in_recv_array(log, mem, mono_time, gconn, data, length, packet_type, message_id)) {
+        if (!store_in_recv_array(log, pool, mono_time, gconn, data, length, packet_type, message_id)) {
             return -1;
         }
 
@@ -512,6 +780,7 @@ static bool process_recv_array_entry(const GC_Session *_Nonnull c, GC_Chat *_Non
     uint8_t sender_pk[ENC_PUBLIC_KEY_SIZE];
     memcpy(sender_pk, get_enc_key(&gconn->addr.public_key), ENC_PUBLIC_KEY_SIZE);
 
+    const uint64_t message_id = array_entry->message_id;
     const bool ret = handle_gc_lossless_helper(c, chat, peer_number, array_entry->data, array_entry->data_length,
                      array_entry->packet_type, userdata);
 
@@ -519,18 +788,19 @@ static bool process_recv_array_entry(const GC_Session *_Nonnull c, GC_Chat *_Non
     peer_number = get_peer_number_of_enc_pk(chat, sender_pk, false);
     gconn = get_gc_connection(chat, peer_number);
 
-    clear_array_entry(chat->mem, array_entry);
-
     if (gconn == nullptr) {
+        clear_array_entry(chat->packet_pool, array_entry);
         return true;
     }
 
+    clear_recv_array_entry(chat->packet_pool, gconn, array_entry);
+
     if (!ret) {
-        gc_send_message_ack(chat, gconn, array_entry->message_id, GR_ACK_REQ);
+        gc_send_message_ack(chat, gconn, message_id, GR_ACK_REQ);
         return false;
     }
 
-    gc_send_message_ack(chat, gconn, array_entry->message_id, GR_ACK_RECV);
+    gc_send_message_ack(chat, gconn, message_id, GR_ACK_RECV);
 
     gcc_set_recv_message_id(gconn, gconn->received_message_id + 1);
 
@@ -544,19 +814,27 @@ void gcc_check_recv_array(const GC_Session *c, GC_Chat *chat, GC_Connection *gco
         return;
     }
 
-    const uint16_t idx = (gconn->received_message_id + 1) % GCC_BUFFER_SIZE;
-    GC_Message_Array_Entry *const array_entry = &gconn->recv_array[idx];
+    if (gconn->recv_array_count == 0) {
+        return;
+    }
 
-    if (!array_entry_is_empty(array_entry)) {
+    const uint64_t message_id = gconn->received_message_id + 1;
+    GC_Message_Array_Entry *const array_entry = &gconn->recv_array[get_array_index(gconn->recv_array_size, message_id)];
+
+    if (!array_entry_is_empty(array_entry) && array_entry->message_id == message_id) {
         process_recv_array_entry(c, chat, gconn, peer_number, array_entry, userdata);
     }
 }
 
 void gcc_resend_packets(const GC_Chat *chat, GC_Connection *gconn)
 {
+    if (gconn->send_array_size == 0) {
+        return;
+    }
+
     const uint64_t tm = mono_time_get(chat->mono_time);
     const uint16_t start = gconn->send_array_start;
-    const uint16_t end = gconn->send_message_id % GCC_BUFFER_SIZE;
+    const uint16_t end = get_array_index(gconn->send_array_size, gconn->send_message_id);
 
     const GC_Message_Array_Entry *array_entry = &gconn->send_array[start];
 
@@ -570,7 +848,7 @@ void gcc_resend_packets(const GC_Chat *chat, GC_Connection *gconn)
         return;
     }
 
-    for (uint16_t i = start; i != end; i = (i + 1) % GCC_BUFFER_SIZE) {
+    for (uint16_t i = start; i != end; i = get_array_index(gconn->send_array_size, i + 1)) {
         GC_Message_Array_Entry *const array_entry_loop = &gconn->send_array[i];
 
         if (array_entry_is_empty(array_entry_loop)) {
@@ -697,15 +975,18 @@ void gcc_mark_for_deletion(GC_Connection *gconn, TCP_Connections *tcp_conn, Grou
     }
 }
 
-void gcc_peer_cleanup(const Memory *mem, GC_Connection *gconn)
+void gcc_peer_cleanup(GC_Packet_Pool *pool, GC_Connection *gconn)
 {
-    for (size_t i = 0; i < GCC_BUFFER_SIZE; ++i) {
-        mem_delete(mem, gconn->send_array[i].data);
-        mem_delete(mem, gconn->recv_array[i].data);
+    for (uint16_t i = 0; i < gconn->send_array_size; ++i) {
+        clear_array_entry(pool, &gconn->send_array[i]);
+    }
+
+    for (uint16_t i = 0; i < gconn->recv_array_size; ++i) {
+        clear_array_entry(pool, &gconn->recv_array[i]);
     }
 
-    mem_delete(mem, gconn->recv_array);
-    mem_delete(mem, gconn->send_array);
+    mem_delete(pool->mem, gconn->recv_array);
+    mem_delete(pool->mem, gconn->send_array);
 
     crypto_memunlock(gconn->session_secret_key, sizeof(gconn->session_secret_key));
     crypto_memunlock(gconn->session_shared_key, sizeof(gconn->session_shared_key));
@@ -718,6 +999,6 @@ void gcc_cleanup(const GC_Chat *chat)
         GC_Connection *gconn = get_gc_connection(chat, i);
         assert(gconn != nullptr);
 
-        gcc_peer_cleanup(chat->mem, gconn);
+        gcc_peer_cleanup(chat->packet_pool, gconn);
     }
 }
@@ -27,6 +27,15 @@
 /* Max number of TCP relays we share with a peer on handshake */
 #define GCC_MAX_TCP_SHARED_RELAYS 3
 
+/** @brief Creates the pool that holds the data of packets in a chat's send and recv arrays.
+ *
+ * Return null on allocation failure.
+ */
+GC_Packet_Pool *_Nullable gcc_packet_pool_new(const Memory *_Nonnull mem);
+
+/** @brief Frees a packet pool. All connections using it must have been cleaned up. */
+void gcc_packet_pool_kill(GC_Packet_Pool *_Nullable pool);
+
 /** Marks a peer for deletion. If gconn is null or already marked for deletion this function has no effect. */
 void gcc_mark_for_deletion(GC_Connection *_Nonnull gconn, TCP_Connections *_Nonnull tcp_conn, Group_Exit_Type type,
                            const uint8_t *_Nullable part_message, uint16_t length);
@@ -38,7 +47,7 @@ void gcc_mark_for_deletion(GC_Connection *_Nonnull gconn, TCP_Connections *_Nonn
  * Return 0 if message is a duplicate.
  * Return -1 on failure
  */
-int gcc_handle_received_message(const Logger *_Nonnull log, const Memory *_Nonnull mem, const Mono_Time *_Nonnull mono_time, GC_Connection *_Nonnull gconn,
+int gcc_handle_received_message(const Logger *_Nonnull log, GC_Packet_Pool *_Nonnull pool, const Mono_Time *_Nonnull mono_time, GC_Connection *_Nonnull gconn,
                                 const uint8_t *_Nullable data, uint16_t length, uint8_t packet_type, uint64_t message_id,
                                 bool direct_conn);
 /** @brief Handles a packet fragment.
@@ -54,14 +63,14 @@ int gcc_handle_received_message(const Logger *_Nonnull log, const Memory *_Nonnu
 int gcc_handle_packet_fragment(const GC_Session *_Nonnull c, GC_Chat *_Nonnull chat, uint32_t peer_number, GC_Connection *_Nonnull gconn,
                                const uint8_t *_Nullable chunk, uint16_t length, uint8_t packet_type, uint64_t message_id,
                                void *_Nullable userdata);
-/** @brief Return array index for message_id */
-uint16_t gcc_get_array_index(uint64_t message_id);
+/** @brief Returns the packet with message_id in gconn's send_array, or null if it isn't there. */
+GC_Message_Array_Entry *_Nullable gcc_get_send_array_entry(const GC_Connection *_Nonnull gconn, uint64_t message_id);
 
 /** @brief Removes send_array item with message_id.
  *
  * Return true on success.
  */
-bool gcc_handle_ack(const Logger *_Nonnull log, const Memory *_Nonnull mem, GC_Connection *_Nonnull gconn, uint64_t message_id);
+bool gcc_handle_ack(const Logger *_Nonnull log, GC_Packet_Pool *_Nonnull pool, GC_Connection *_Nonnull gconn, uint64_t message_id);
 
 /** @brief Sets the send_message_id and send_array_start for `gconn` to `id`.
  *
@@ -168,7 +177,7 @@ bool gcc_send_lossless_packet_fragments(const GC_Chat *_Nonnull chat, GC_Connect
 int gcc_encrypt_and_send_lossless_packet(const GC_Chat *_Nonnull chat, GC_Connection *_Nonnull gconn, const uint8_t *_Nullable data,
         uint16_t length, uint64_t message_id, uint8_t packet_type);
 /** @brief Called when a peer leaves the group. */
-void gcc_peer_cleanup(const Memory *_Nonnull mem, GC_Connection *_Nonnull gconn);
+void gcc_peer_cleanup(GC_Packet_Pool *_Nonnull pool, GC_Connection *_Nonnull gconn);
 
 /** @brief Called on group exit. */
 void gcc_cleanup(const GC_Chat *_Nonnull chat);
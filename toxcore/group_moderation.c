@@ -480,33 +480,128 @@ static bool sanctions_list_make_hash(const Memory *_Nonnull mem, const Mod_Sanct
     return true;
 }
 
-/** @brief Verifies that sanction contains valid info and was assigned by a current mod or group founder.
+/** @brief Checks that sanction contains valid info and was assigned by a current mod or group founder,
+ * and packs the data its signature covers into `packed_data`.
  *
- * Returns true on success.
+ * The signature itself is not verified.
+ *
+ * Returns the length of the signed data on success.
+ * Returns 0 on failure.
  */
-static bool sanctions_list_validate_entry(const Moderation *_Nonnull moderation, const Mod_Sanction *_Nonnull sanction)
+static uint16_t sanctions_list_prepare_entry(const Moderation *_Nonnull moderation, const Mod_Sanction *_Nonnull sanction,
+        uint8_t packed_data[_Nonnull MOD_SANCTION_PACKED_SIZE])
 {
     if (!mod_list_verify_sig_pk(moderation, sanction->setter_public_sig_key)) {
-        return false;
+        return 0;
     }
 
     if (sanction->type >= SA_INVALID) {
-        return false;
+        return 0;
     }
 
     if (sanction->time_set == 0) {
-        return false;
+        return 0;
     }
 
-    uint8_t packed_data[MOD_SANCTION_PACKED_SIZE];
-    const int packed_len = sanctions_list_pack(packed_data, sizeof(packed_data), sanction, 1, nullptr);
+    const int packed_len = sanctions_list_pack(packed_data, MOD_SANCTION_PACKED_SIZE, sanction, 1, nullptr);
 
     if (packed_len <= SIGNATURE_SIZE) {
+        return 0;
+    }
+
+    return (uint16_t)(packed_len - SIGNATURE_SIZE);
+}
+
+/** @brief Verifies that sanction contains valid info and was assigned by a current mod or group founder.
+ *
+ * Returns true on success.
+ */
+static bool sanctions_list_validate_entry(const Moderation *_Nonnull moderation, const Mod_Sanction *_Nonnull sanction)
+{
+    uint8_t packed_data[MOD_SANCTION_PACKED_SIZE];
+    const uint16_t signed_length = sanctions_list_prepare_entry(moderation, sanction, packed_data);
+
+    if (signed_length == 0) {
         return false;
     }
 
-    return crypto_signature_verify(sanction->signature, packed_data, packed_len - SIGNATURE_SIZE,
-                                   sanction->setter_public_sig_key);
+    return crypto_signature_verify(sanction->signature, packed_data, signed_length, sanction->setter_public_sig_key);
+}
+
+/** @brief Returns true if our sanctions list holds an exact copy of `sanction`, signature included.
+ *
+ * Sanctions only get into our list after their signature was verified, or
+ * when we made them ourselves, so such a copy needn't be verified again.
+ */
+static bool sanctions_list_has_copy(const Moderation *_Nonnull moderation, const Mod_Sanction *_Nonnull sanction)
+{
+    for (uint16_t i = 0; i < moderation->num_sanctions; ++i) {
+        const Mod_Sanction *curr_sanction = &moderation->sanctions[i];
+
+        if (memcmp(curr_sanction->signature, sanction->signature, SIGNATURE_SIZE) == 0
+                && curr_sanction->type == sanction->type
+                && curr_sanction->time_set == sanction->time_set
+                && memcmp(curr_sanction->setter_public_sig_key, sanction->setter_public_sig_key, SIG_PUBLIC_KEY_SIZE) == 0
+                && memcmp(curr_sanction->target_public_enc_key, sanction->target_public_enc_key, ENC_PUBLIC_KEY_SIZE) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/** @brief Verifies every entry of a sanctions list.
+ *
+ * Entries we already hold are only checked against the current mod list. The
+ * signatures of the others are verified together in one batch.
+ *
+ * Returns true if every entry is valid.
+ */
+static bool sanctions_list_validate_entries(const Moderation *_Nonnull moderation, const Mod_Sanction *_Nonnull sanctions,
+        uint16_t num_sanctions)
+{
+    if (num_sanctions > MOD_MAX_NUM_SANCTIONS) {
+        LOGGER_WARNING(moderation->log, "num_sanctions %u exceeds maximum", num_sanctions);
+        return false;
+    }
+
+    uint8_t packed_data[MOD_MAX_NUM_SANCTIONS][MOD_SANCTION_PACKED_SIZE];
+    Crypto_Signature_Check checks[MOD_MAX_NUM_SANCTIONS];
+    uint16_t check_index[MOD_MAX_NUM_SANCTIONS];
+    bool valid[MOD_MAX_NUM_SANCTIONS];
+    uint16_t num_checks = 0;
+
+    for (uint16_t i = 0; i < num_sanctions; ++i) {
+        const Mod_Sanction *sanction = &sanctions[i];
+        const uint16_t signed_length = sanctions_list_prepare_entry(moderation, sanction, packed_data[num_checks]);
+
+        if (signed_length == 0) {
+            LOGGER_WARNING(moderation->log, "Invalid entry %u", i);
+            return false;
+        }
+
+        if (sanctions_list_has_copy(moderation, sanction)) {
+            continue;
+        }
+
+        checks[num_checks] = (Crypto_Signature_Check) {
+            sanction->signature, packed_data[num_checks], signed_length, sanction->setter_public_sig_key
+        };
+        check_index[num_checks] = i;
+        ++num_checks;
+    }
+
+    if (crypto_signature_verify_batch(checks, num_checks, valid) == num_checks) {
+        return true;
+    }
+
+    for (uint16_t i = 0; i < num_checks; ++i) {
+        if (!valid[i]) {
+            LOGGER_WARNING(moderation->log, "Invalid signature on entry %u", check_index[i]);
+        }
+    }
+
+    return false;
 }
 
 static uint16_t sanctions_creds_get_checksum(const Mod_Sanction_Creds *_Nonnull creds)
@@ -610,11 +705,8 @@ static bool sanctions_creds_validate(const Moderation *_Nonnull moderation, cons
 bool sanctions_list_check_integrity(const Moderation *moderation, const Mod_Sanction_Creds *creds,
                                     const Mod_Sanction *sanctions, uint16_t num_sanctions)
 {
-    for (uint16_t i = 0; i < num_sanctions; ++i) {
-        if (!sanctions_list_validate_entry(moderation, &sanctions[i])) {
-            LOGGER_WARNING(moderation->log, "Invalid entry");
-            return false;
-        }
+    if (!sanctions_list_validate_entries(moderation, sanctions, num_sanctions)) {
+        return false;
     }
 
     return sanctions_creds_validate(moderation, sanctions, creds, num_sanctions);
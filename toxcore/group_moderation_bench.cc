@@ -0,0 +1,169 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "../testing/support/public/simulated_environment.hh"
+#include "crypto_core.h"
+#include "group_moderation.h"
+#include "logger.h"
+#include "mem.h"
+
+namespace {
+
+using tox::test::SimulatedEnvironment;
+
+/**
+ * @brief A founder with a full sanctions list, and a peer receiving it.
+ *
+ * The peer starts out holding the first `num_held` sanctions of the list, as
+ * it would after an earlier sync.
+ */
+class SanctionsSync {
+public:
+    explicit SanctionsSync(uint16_t num_held)
+        : c_mem_(env_.fake_memory().c_memory())
+        , c_rng_(env_.fake_random().c_random())
+        , log_(logger_new(&c_mem_))
+        , founder_{&c_mem_, log_}
+        , peer_{&c_mem_, log_}
+    {
+        Extended_Public_Key pk;
+        Extended_Secret_Key sk;
+        create_extended_keypair(&pk, &sk, &c_rng_);
+
+        std::memcpy(founder_.self_public_sig_key, get_sig_pk(&pk), SIG_PUBLIC_KEY_SIZE);
+        std::memcpy(founder_.self_secret_sig_key, get_sig_sk(&sk), SIG_SECRET_KEY_SIZE);
+        mod_list_add_entry(&founder_, get_sig_pk(&pk));
+        mod_list_add_entry(&peer_, get_sig_pk(&pk));
+
+        for (uint16_t i = 0; i < MOD_MAX_NUM_SANCTIONS; ++i) {
+            uint8_t target[ENC_PUBLIC_KEY_SIZE];
+            random_bytes(&c_rng_, target, sizeof(target));
+
+            Mod_Sanction sanction;
+            sanctions_list_make_entry(&founder_, target, &sanction, SA_OBSERVER);
+        }
+
+        if (num_held > 0) {
+            peer_.sanctions = static_cast<Mod_Sanction *>(
+                mem_valloc(&c_mem_, num_held, sizeof(Mod_Sanction)));
+            std::memcpy(peer_.sanctions, founder_.sanctions, num_held * sizeof(Mod_Sanction));
+            peer_.num_sanctions = num_held;
+        }
+    }
+
+    ~SanctionsSync()
+    {
+        sanctions_list_cleanup(&founder_);
+        sanctions_list_cleanup(&peer_);
+        mod_list_cleanup(&founder_);
+        mod_list_cleanup(&peer_);
+        logger_kill(log_);
+    }
+
+    /** @brief Validates the founder's list the way a peer does on receiving it. */
+    bool check() const
+    {
+        return sanctions_list_check_integrity(
+            &peer_, &founder_.sanctions_creds, founder_.sanctions, founder_.num_sanctions);
+    }
+
+    const Mod_Sanction *sanctions() const { return founder_.sanctions; }
+
+private:
+    SimulatedEnvironment env_{12345};
+    Memory c_mem_;
+    Random c_rng_;
+    Logger *log_;
+    Moderation founder_;
+    Moderation peer_;
+};
+
+/**
+ * @brief Validating a full sanctions list.
+ *
+ * Arg: the number of the list's sanctions the receiver already holds. 0 is a
+ * peer joining the group, MOD_MAX_NUM_SANCTIONS - 1 a peer that missed one
+ * change, and MOD_MAX_NUM_SANCTIONS a resync of an unchanged list.
+ */
+void BM_SanctionsListCheckIntegrity(benchmark::State &state)
+{
+    SanctionsSync sync(static_cast<uint16_t>(state.range(0)));
+
+    for (auto _ : state) {
+        if (!sync.check()) {
+            state.SkipWithError("sanctions list failed the integrity check");
+            return;
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * MOD_MAX_NUM_SANCTIONS);
+}
+BENCHMARK(BM_SanctionsListCheckIntegrity)
+    ->Arg(0)
+    ->Arg(MOD_MAX_NUM_SANCTIONS - 1)
+    ->Arg(MOD_MAX_NUM_SANCTIONS);
+
+/** @brief The signatures of a full sanctions list, checked one at a time or as a batch. */
+class SanctionSignatures {
+public:
+    SanctionSignatures()
+        : sync_(0)
+    {
+        const Mod_Sanction *sanctions = sync_.sanctions();
+
+        for (uint16_t i = 0; i < MOD_MAX_NUM_SANCTIONS; ++i) {
+            const int packed_len = sanctions_list_pack(
+                packed_[i], sizeof(packed_[i]), &sanctions[i], 1, nullptr);
+            checks_.push_back({sanctions[i].signature, packed_[i],
+                static_cast<uint64_t>(packed_len - SIGNATURE_SIZE),
+                sanctions[i].setter_public_sig_key});
+        }
+    }
+
+    const std::vector<Crypto_Signature_Check> &checks() const { return checks_; }
+
+private:
+    SanctionsSync sync_;
+    uint8_t packed_[MOD_MAX_NUM_SANCTIONS][MOD_SANCTION_PACKED_SIZE];
+    std::vector<Crypto_Signature_Check> checks_;
+};
+
+void BM_SanctionSignaturesVerifyEach(benchmark::State &state)
+{
+    const SanctionSignatures signatures;
+
+    for (auto _ : state) {
+        for (const Crypto_Signature_Check &check : signatures.checks()) {
+            benchmark::DoNotOptimize(crypto_signature_verify(
+                check.signature, check.message, check.message_length, check.public_key));
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * MOD_MAX_NUM_SANCTIONS);
+}
+BENCHMARK(BM_SanctionSignaturesVerifyEach);
+
+void BM_SanctionSignaturesVerifyBatch(benchmark::State &state)
+{
+    const SanctionSignatures signatures;
+    bool valid[MOD_MAX_NUM_SANCTIONS];
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(crypto_signature_verify_batch(
+            signatures.checks().data(), MOD_MAX_NUM_SANCTIONS, valid));
+    }
+
+    state.SetItemsProcessed(state.iterations() * MOD_MAX_NUM_SANCTIONS);
+}
+BENCHMARK(BM_SanctionSignaturesVerifyBatch);
+
+}  // namespace
+
+BENCHMARK_MAIN();
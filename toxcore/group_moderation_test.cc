@@ -296,4 +296,22 @@ TEST_F(SanctionsListMod, ReplaceSanctionSignatures)
         sanctions_list_check_integrity(&mod, &mod.sanctions_creds, sanctions, mod.num_sanctions));
 }
 
+TEST_F(SanctionsListMod, AlteredCopyOfHeldSanctionFailsIntegrityCheck)
+{
+    Mod_Sanction altered[2];
+    std::memcpy(altered, sanctions, sizeof(altered));
+
+    // The hash only covers the signatures, so only the signature check can catch this.
+    ++altered[1].time_set;
+
+    EXPECT_FALSE(
+        sanctions_list_check_integrity(&mod, &mod.sanctions_creds, altered, mod.num_sanctions));
+
+    altered[1] = sanctions[1];
+    altered[1].signature[0] ^= 1;
+
+    EXPECT_FALSE(
+        sanctions_list_check_integrity(&mod, &mod.sanctions_creds, altered, mod.num_sanctions));
+}
+
 }  // namespace
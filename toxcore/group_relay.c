@@ -0,0 +1,238 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+/**
+ * Relay trees for group broadcasts.
+ */
+
+#include "group_relay.h"
+
+#include <string.h>
+
+#include "attributes.h"
+#include "crypto_core.h"
+#include "pk_index.h"
+#include "util.h"
+
+/** @brief Returns true if `a` comes after `self_pk` on the circle before wrapping around. */
+static bool after_self(const uint8_t *_Nonnull self_pk, const uint8_t *_Nonnull a)
+{
+    return memcmp(a, self_pk, ENC_PUBLIC_KEY_SIZE) > 0;
+}
+
+/** @brief Returns true if `a` comes before `b` walking the circle from `self_pk`. */
+static bool circle_less(const uint8_t *_Nonnull self_pk, const uint8_t *_Nonnull a, const uint8_t *_Nonnull b)
+{
+    const bool a_after = after_self(self_pk, a);
+    const bool b_after = after_self(self_pk, b);
+
+    if (a_after != b_after) {
+        return a_after;
+    }
+
+    return memcmp(a, b, ENC_PUBLIC_KEY_SIZE) < 0;
+}
+
+bool gc_relay_in_range(const uint8_t *self_pk, const uint8_t *range_end, const uint8_t *public_key)
+{
+    if (memcmp(public_key, self_pk, ENC_PUBLIC_KEY_SIZE) == 0) {
+        return false;
+    }
+
+    if (memcmp(range_end, self_pk, ENC_PUBLIC_KEY_SIZE) == 0) {
+        return true;
+    }
+
+    return circle_less(self_pk, public_key, range_end);
+}
+
+/** @brief Returns the first 8 bytes of a key as a big-endian number. */
+static uint64_t key_prefix(const uint8_t *_Nonnull key)
+{
+    uint64_t prefix = 0;
+
+    for (uint8_t i = 0; i < sizeof(uint64_t); ++i) {
+        prefix = (prefix << 8) | key[i];
+    }
+
+    return prefix;
+}
+
+/** @brief Returns roughly how far along the circle from `self_pk` a key lies.
+ *
+ * Keys are ordered by position first, and only compared in full if their
+ * positions are equal, which makes sorting many keys a lot cheaper.
+ */
+static uint64_t circle_position(const uint8_t *_Nonnull self_pk, const uint8_t *_Nonnull key)
+{
+    const uint64_t self_prefix = key_prefix(self_pk);
+    const uint64_t prefix = key_prefix(key);
+
+    if (prefix == self_prefix && !after_self(self_pk, key)) {
+        // Just before us, so at the very end of the circle.
+        return UINT64_MAX;
+    }
+
+    return prefix - self_prefix;
+}
+
+static bool target_less(const uint8_t *_Nonnull self_pk, const GC_Relay_Target *_Nonnull a, const GC_Relay_Target *_Nonnull b)
+{
+    if (a->position != b->position) {
+        return a->position < b->position;
+    }
+
+    return circle_less(self_pk, a->public_key, b->public_key);
+}
+
+static void swap_targets(GC_Relay_Target *_Nonnull targets, uint32_t i, uint32_t j)
+{
+    const GC_Relay_Target tmp = targets[i];
+    targets[i] = targets[j];
+    targets[j] = tmp;
+}
+
+/** @brief Puts the target that comes `k`th along the circle at index `k`.
+ *
+ * Targets before it come earlier on the circle, targets after it later. This
+ * is quickselect, which is linear on average, where sorting all targets would
+ * cost a lot more in large groups.
+ */
+static void select_target(const uint8_t *_Nonnull self_pk, GC_Relay_Target *_Nonnull targets, uint32_t length, uint32_t k)
+{
+    uint32_t lo = 0;
+    uint32_t hi = length - 1;
+
+    while (lo < hi) {
+        // Median of three as the pivot, moved to the end.
+        const uint32_t mid = lo + (hi - lo) / 2;
+
+        if (target_less(self_pk, &targets[mid], &targets[lo])) {
+            swap_targets(targets, mid, lo);
+        }
+
+        if (target_less(self_pk, &targets[hi], &targets[lo])) {
+            swap_targets(targets, hi, lo);
+        }
+
+        if (target_less(self_pk, &targets[mid], &targets[hi])) {
+            swap_targets(targets, mid, hi);
+        }
+
+        uint32_t store = lo;
+
+        for (uint32_t i = lo; i < hi; ++i) {
+            if (target_less(self_pk, &targets[i], &targets[hi])) {
+                swap_targets(targets, i, store);
+                ++store;
+            }
+        }
+
+        swap_targets(targets, store, hi);
+
+        if (store == k) {
+            return;
+        }
+
+        if (k < store) {
+            hi = store - 1;
+        } else {
+            lo = store + 1;
+        }
+    }
+}
+
+uint16_t gc_relay_plan(const uint8_t *self_pk, const uint8_t *range_end, GC_Relay_Target *targets, uint32_t num_targets,
+                       uint8_t fanout, GC_Relay_Child *children)
+{
+    uint32_t in_range = 0;
+
+    for (uint32_t i = 0; i < num_targets; ++i) {
+        if (gc_relay_in_range(self_pk, range_end, targets[i].public_key)) {
+            targets[in_range] = targets[i];
+            targets[in_range].position = circle_position(self_pk, targets[i].public_key);
+            ++in_range;
+        }
+    }
+
+    if (in_range == 0 || fanout == 0) {
+        return 0;
+    }
+
+    const uint32_t num_children = min_u32(min_u32(fanout, GC_RELAY_MAX_FANOUT), in_range);
+
+    // Only the first target of each run needs to be in place.
+    uint32_t done = 0;
+
+    for (uint32_t i = 0; i < num_children; ++i) {
+        const uint32_t start = (uint32_t)((uint64_t)i * in_range / num_children);
+        select_target(self_pk, targets + done, in_range - done, start - done);
+        done = start + 1;
+    }
+
+    for (uint32_t i = 0; i < num_children; ++i) {
+        const uint32_t start = (uint32_t)((uint64_t)i * in_range / num_children);
+        const uint32_t next = (uint32_t)((uint64_t)(i + 1) * in_range / num_children);
+
+        children[i].peer_number = targets[start].peer_number;
+        children[i].range_end = next < in_range ? targets[next].public_key : range_end;
+    }
+
+    return (uint16_t)num_children;
+}
+
+uint64_t gc_relay_fingerprint(const GC_Relay_Seen *seen, const uint8_t *origin_pk, uint64_t message_id)
+{
+    uint64_t fingerprint = pk_index_hash(seen->seed, origin_pk) ^ message_id;
+    fingerprint *= 0x9e3779b97f4a7c15ULL;
+    fingerprint ^= fingerprint >> 29;
+    fingerprint *= 0xbf58476d1ce4e5b9ULL;
+    fingerprint ^= fingerprint >> 32;
+
+    // 0 marks an empty slot.
+    return fingerprint != 0 ? fingerprint : 1;
+}
+
+bool gc_relay_seen_has(const GC_Relay_Seen *seen, uint64_t fingerprint)
+{
+    for (uint16_t i = 0; i < GC_RELAY_SEEN_SIZE; ++i) {
+        if (seen->ids[i] == fingerprint) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void gc_relay_seen_add(GC_Relay_Seen *seen, uint64_t fingerprint)
+{
+    seen->ids[seen->index] = fingerprint;
+    seen->index = (seen->index + 1) % GC_RELAY_SEEN_SIZE;
+}
+
+bool gc_relay_window_accept(GC_Relay_Window *window, uint64_t message_id)
+{
+    if (message_id > window->newest) {
+        const uint64_t shift = message_id - window->newest;
+        window->handled = shift < GC_RELAY_WINDOW_SIZE ? window->handled << shift : 0;
+        window->handled |= 1;
+        window->newest = message_id;
+        return true;
+    }
+
+    const uint64_t age = window->newest - message_id;
+
+    if (age >= GC_RELAY_WINDOW_SIZE) {
+        return false;
+    }
+
+    const uint64_t bit = (uint64_t)1 << age;
+
+    if ((window->handled & bit) != 0) {
+        return false;
+    }
+
+    window->handled |= bit;
+    return true;
+}
@@ -0,0 +1,135 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+/**
+ * Relay trees for group broadcasts.
+ *
+ * Instead of sending a broadcast to every peer, the sender hands it to a few
+ * peers, which pass it on to a few more, and so on. The tree is laid over the
+ * peers' public encryption keys, seen as points on a circle. Every relay is
+ * responsible for the arc from its own key up to (not including) an end key,
+ * which is carried in the packet. The sender is responsible for the whole
+ * circle. A relay splits the peers it knows in its arc into `fanout`
+ * consecutive runs and forwards the broadcast to the first peer of each run,
+ * making it responsible for the rest of the run.
+ *
+ * Since every relay only looks at its own peer list, peers that see the group
+ * slightly differently still reach everyone they know about. Relays drop
+ * broadcasts they have seen before.
+ */
+
+#ifndef C_TOXCORE_TOXCORE_GROUP_RELAY_H
+#define C_TOXCORE_TOXCORE_GROUP_RELAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "attributes.h"
+#include "crypto_core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** The largest fanout a relay uses, whatever the packet asks for. */
+#define GC_RELAY_MAX_FANOUT 16
+
+/** The number of recent broadcasts a group remembers to drop duplicates. */
+#define GC_RELAY_SEEN_SIZE 512
+
+/** The number of message IDs up to a sender's newest one that a peer tells apart from replays. */
+#define GC_RELAY_WINDOW_SIZE 64
+
+/** The number of relayed broadcasts a group keeps while it waits to confirm their senders. */
+#define GC_RELAY_PENDING_SIZE 16
+
+/** Seconds a relayed broadcast waits for its sender to be confirmed. */
+#define GC_RELAY_PENDING_TIMEOUT 10
+
+/** A peer a relay can forward to. */
+typedef struct GC_Relay_Target {
+    const uint8_t *_Nonnull public_key;  // ENC_PUBLIC_KEY_SIZE bytes
+    uint32_t peer_number;
+    uint64_t position;  // set by gc_relay_plan
+} GC_Relay_Target;
+
+/** A peer a relay forwards to, and the end of the arc it becomes responsible for. */
+typedef struct GC_Relay_Child {
+    uint32_t peer_number;
+    const uint8_t *_Nonnull range_end;  // ENC_PUBLIC_KEY_SIZE bytes
+} GC_Relay_Child;
+
+/** @brief Returns true if `public_key` lies on the arc after `self_pk` up to `range_end`.
+ *
+ * The arc starts just after `self_pk` and ends just before `range_end`. If
+ * `range_end` equals `self_pk`, the arc is the whole circle except `self_pk`.
+ */
+bool gc_relay_in_range(const uint8_t *_Nonnull self_pk, const uint8_t *_Nonnull range_end,
+                       const uint8_t *_Nonnull public_key);
+
+/** @brief Picks the peers to forward a broadcast to.
+ *
+ * Drops the targets outside our arc and splits the others into at most
+ * `fanout` runs along the circle. `targets` is reordered in the process, and
+ * the returned children point into it, so it must outlive them.
+ *
+ * @param self_pk Our public encryption key.
+ * @param range_end The end of our arc. Our own key if we are the sender.
+ * @param targets The peers we could forward to.
+ * @param children Room for at least `fanout` children.
+ *
+ * @return the number of children.
+ */
+uint16_t gc_relay_plan(const uint8_t *_Nonnull self_pk, const uint8_t *_Nonnull range_end,
+                       GC_Relay_Target *_Nonnull targets, uint32_t num_targets, uint8_t fanout,
+                       GC_Relay_Child *_Nonnull children);
+
+/** Recently seen broadcasts, oldest overwritten first. */
+typedef struct GC_Relay_Seen {
+    uint64_t ids[GC_RELAY_SEEN_SIZE];
+    uint16_t index;
+    uint64_t seed;  // random, so peers can't make two broadcasts share a fingerprint
+} GC_Relay_Seen;
+
+/** @brief Returns a number identifying a broadcast by its sender and message id.
+ *
+ * The number is a hash keyed with `seen->seed`, see `pk_index_hash`.
+ */
+uint64_t gc_relay_fingerprint(const GC_Relay_Seen *_Nonnull seen, const uint8_t *_Nonnull origin_pk,
+                              uint64_t message_id);
+
+/** @brief Returns true if the broadcast with this fingerprint was seen recently. */
+bool gc_relay_seen_has(const GC_Relay_Seen *_Nonnull seen, uint64_t fingerprint);
+
+/** @brief Remembers a broadcast, forgetting the oldest one if there is no room. */
+void gc_relay_seen_add(GC_Relay_Seen *_Nonnull seen, uint64_t fingerprint);
+
+/** A relayed broadcast whose sender isn't confirmed yet, so its signature can't be checked. */
+typedef struct GC_Relay_Pending {
+    uint8_t *_Nullable packet;  // the whole relayed broadcast, null if the slot is empty
+    uint16_t length;
+    uint64_t time_added;
+} GC_Relay_Pending;
+
+/** The relayed broadcasts handled from one sender. Zero-initialise. */
+typedef struct GC_Relay_Window {
+    uint64_t newest;   // the highest message ID handled
+    uint64_t handled;  // bit i is set if message ID `newest - i` was handled
+} GC_Relay_Window;
+
+/** @brief Records a sender's message ID unless it was handled before.
+ *
+ * Broadcasts may arrive out of order when the relay tree changes, so any ID
+ * in the window that wasn't handled yet is accepted. IDs below the window can't
+ * be told apart from replays and are refused.
+ *
+ * @return true if the broadcast should be handled.
+ */
+bool gc_relay_window_accept(GC_Relay_Window *_Nonnull window, uint64_t message_id);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* C_TOXCORE_TOXCORE_GROUP_RELAY_H */
@@ -0,0 +1,274 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include "group_relay.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include "crypto_core.h"
+
+namespace {
+
+using PublicKey = std::array<uint8_t, ENC_PUBLIC_KEY_SIZE>;
+
+PublicKey key_with_first_byte(uint8_t first)
+{
+    PublicKey pk{};
+    pk[0] = first;
+    return pk;
+}
+
+std::vector<PublicKey> random_keys(std::size_t count, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::vector<PublicKey> keys(count);
+
+    for (PublicKey &pk : keys) {
+        for (uint8_t &b : pk) {
+            b = static_cast<uint8_t>(byte(rng));
+        }
+    }
+
+    return keys;
+}
+
+TEST(GroupRelay, RangeWrapsAroundTheCircle)
+{
+    const PublicKey self = key_with_first_byte(0xc0);
+    const PublicKey end = key_with_first_byte(0x40);
+
+    EXPECT_TRUE(gc_relay_in_range(self.data(), end.data(), key_with_first_byte(0xd0).data()));
+    EXPECT_TRUE(gc_relay_in_range(self.data(), end.data(), key_with_first_byte(0x10).data()));
+    EXPECT_FALSE(gc_relay_in_range(self.data(), end.data(), key_with_first_byte(0x40).data()));
+    EXPECT_FALSE(gc_relay_in_range(self.data(), end.data(), key_with_first_byte(0x80).data()));
+    EXPECT_FALSE(gc_relay_in_range(self.data(), end.data(), self.data()));
+}
+
+TEST(GroupRelay, OwnKeyAsRangeEndCoversEveryoneElse)
+{
+    const PublicKey self = key_with_first_byte(0x80);
+
+    EXPECT_TRUE(gc_relay_in_range(self.data(), self.data(), key_with_first_byte(0x00).data()));
+    EXPECT_TRUE(gc_relay_in_range(self.data(), self.data(), key_with_first_byte(0xff).data()));
+    EXPECT_FALSE(gc_relay_in_range(self.data(), self.data(), self.data()));
+}
+
+TEST(GroupRelay, FewPeersAllBecomeChildren)
+{
+    const PublicKey self = key_with_first_byte(0x80);
+    const std::vector<PublicKey> keys
+        = {key_with_first_byte(0x10), key_with_first_byte(0x90), key_with_first_byte(0xa0)};
+
+    std::vector<GC_Relay_Target> targets;
+
+    for (uint32_t i = 0; i < keys.size(); ++i) {
+        targets.push_back({keys[i].data(), i, 0});
+    }
+
+    GC_Relay_Child children[GC_RELAY_MAX_FANOUT];
+    const uint16_t num_children
+        = gc_relay_plan(self.data(), self.data(), targets.data(), targets.size(), 4, children);
+
+    // Sorted along the circle from our key, each responsible only for itself.
+    ASSERT_EQ(num_children, 3u);
+    EXPECT_EQ(children[0].peer_number, 1u);
+    EXPECT_EQ(children[0].range_end, keys[2].data());
+    EXPECT_EQ(children[1].peer_number, 2u);
+    EXPECT_EQ(children[1].range_end, keys[0].data());
+    EXPECT_EQ(children[2].peer_number, 0u);
+    EXPECT_EQ(children[2].range_end, self.data());
+}
+
+TEST(GroupRelay, KeysSharingOurPrefixAreOrderedAlongTheCircle)
+{
+    PublicKey self{};
+    self.fill(0x80);
+
+    // The same first 8 bytes as ours, just before and just after us.
+    PublicKey before = self;
+    before[ENC_PUBLIC_KEY_SIZE - 1] = 0x7f;
+    PublicKey after = self;
+    after[ENC_PUBLIC_KEY_SIZE - 1] = 0x81;
+    const PublicKey far = key_with_first_byte(0x90);
+
+    std::vector<GC_Relay_Target> targets
+        = {{before.data(), 0, 0}, {far.data(), 1, 0}, {after.data(), 2, 0}};
+
+    GC_Relay_Child children[GC_RELAY_MAX_FANOUT];
+    ASSERT_EQ(gc_relay_plan(self.data(), self.data(), targets.data(), targets.size(), 4, children),
+        3u);
+    EXPECT_EQ(children[0].peer_number, 2u);
+    EXPECT_EQ(children[1].peer_number, 1u);
+    EXPECT_EQ(children[2].peer_number, 0u);
+}
+
+TEST(GroupRelay, NoChildrenOutsideTheRange)
+{
+    const PublicKey self = key_with_first_byte(0x80);
+    const PublicKey end = key_with_first_byte(0x90);
+    const PublicKey other = key_with_first_byte(0xa0);
+
+    GC_Relay_Target targets[] = {{other.data(), 0, 0}};
+    GC_Relay_Child children[GC_RELAY_MAX_FANOUT];
+    EXPECT_EQ(gc_relay_plan(self.data(), end.data(), targets, 1, 4, children), 0u);
+}
+
+/** @brief Walks a whole relay tree where every peer knows every other peer. */
+std::vector<uint32_t> deliveries(const std::vector<PublicKey> &keys, uint8_t fanout, uint32_t *depth)
+{
+    std::vector<uint32_t> received(keys.size());
+    std::vector<uint32_t> hops(keys.size());
+
+    struct Hop {
+        uint32_t node;
+        const uint8_t *range_end;
+    };
+
+    // Node 0 is the sender.
+    std::deque<Hop> queue{{0, keys[0].data()}};
+    *depth = 0;
+
+    while (!queue.empty()) {
+        const Hop hop = queue.front();
+        queue.pop_front();
+
+        std::vector<GC_Relay_Target> targets;
+
+        for (uint32_t i = 1; i < keys.size(); ++i) {
+            if (i != hop.node) {
+                targets.push_back({keys[i].data(), i, 0});
+            }
+        }
+
+        GC_Relay_Child children[GC_RELAY_MAX_FANOUT];
+        const uint16_t num_children = gc_relay_plan(keys[hop.node].data(), hop.range_end,
+            targets.data(), targets.size(), fanout, children);
+
+        EXPECT_LE(num_children, fanout);
+
+        for (uint16_t i = 0; i < num_children; ++i) {
+            const uint32_t child = children[i].peer_number;
+            ++received[child];
+            hops[child] = hops[hop.node] + 1;
+            *depth = std::max(*depth, hops[child]);
+            queue.push_back({child, children[i].range_end});
+        }
+    }
+
+    return received;
+}
+
+TEST(GroupRelay, TreeReachesEveryPeerExactlyOnce)
+{
+    for (const uint8_t fanout : {1, 2, 4, 8}) {
+        const std::vector<PublicKey> keys = random_keys(500, fanout);
+        uint32_t depth;
+        const std::vector<uint32_t> received = deliveries(keys, fanout, &depth);
+
+        EXPECT_EQ(received[0], 0u);
+
+        for (uint32_t i = 1; i < keys.size(); ++i) {
+            EXPECT_EQ(received[i], 1u) << "peer " << i << " with fanout " << int{fanout};
+        }
+
+        if (fanout > 1) {
+            // Each hop splits the range roughly evenly.
+            EXPECT_LE(depth, std::ceil(std::log(keys.size()) / std::log(fanout)) + 1);
+        }
+    }
+}
+
+TEST(GroupRelay, FingerprintDependsOnTheSeed)
+{
+    const PublicKey pk = key_with_first_byte(0x12);
+
+    GC_Relay_Seen seen{};
+    seen.seed = 1;
+    GC_Relay_Seen other{};
+    other.seed = 2;
+
+    EXPECT_NE(gc_relay_fingerprint(&seen, pk.data(), 1), gc_relay_fingerprint(&seen, pk.data(), 2));
+    EXPECT_NE(gc_relay_fingerprint(&seen, pk.data(), 1), gc_relay_fingerprint(&other, pk.data(), 1));
+}
+
+TEST(GroupRelay, FingerprintCollisionsDontFollowFromTheKey)
+{
+    // Without a keyed hash, flipping the same bits in the key and the message id
+    // gave the same fingerprint.
+    PublicKey pk = key_with_first_byte(0x12);
+    PublicKey flipped = pk;
+    flipped[0] ^= 0xff;
+
+    GC_Relay_Seen seen{};
+    seen.seed = 42;
+
+    EXPECT_NE(gc_relay_fingerprint(&seen, pk.data(), 0), gc_relay_fingerprint(&seen, flipped.data(), 0xff));
+}
+
+TEST(GroupRelay, SeenForgetsTheOldest)
+{
+    GC_Relay_Seen seen{};
+
+    EXPECT_FALSE(gc_relay_seen_has(&seen, 1));
+    gc_relay_seen_add(&seen, 1);
+    EXPECT_TRUE(gc_relay_seen_has(&seen, 1));
+
+    for (uint64_t id = 2; id <= GC_RELAY_SEEN_SIZE; ++id) {
+        gc_relay_seen_add(&seen, id);
+    }
+
+    EXPECT_TRUE(gc_relay_seen_has(&seen, 1));
+
+    gc_relay_seen_add(&seen, GC_RELAY_SEEN_SIZE + 1);
+    EXPECT_FALSE(gc_relay_seen_has(&seen, 1));
+    EXPECT_TRUE(gc_relay_seen_has(&seen, 2));
+}
+
+TEST(GroupRelay, WindowAcceptsEachIdOnce)
+{
+    GC_Relay_Window window{};
+
+    EXPECT_TRUE(gc_relay_window_accept(&window, 1000));
+    EXPECT_FALSE(gc_relay_window_accept(&window, 1000));
+    EXPECT_TRUE(gc_relay_window_accept(&window, 1001));
+    EXPECT_FALSE(gc_relay_window_accept(&window, 1001));
+}
+
+TEST(GroupRelay, WindowAcceptsLateIdsItHasNotSeen)
+{
+    GC_Relay_Window window{};
+
+    EXPECT_TRUE(gc_relay_window_accept(&window, 1000));
+    EXPECT_TRUE(gc_relay_window_accept(&window, 1003));
+    EXPECT_TRUE(gc_relay_window_accept(&window, 1002));
+    EXPECT_TRUE(gc_relay_window_accept(&window, 1001));
+    EXPECT_FALSE(gc_relay_window_accept(&window, 1002));
+    EXPECT_FALSE(gc_relay_window_accept(&window, 1000));
+}
+
+TEST(GroupRelay, WindowRefusesIdsBelowIt)
+{
+    GC_Relay_Window window{};
+
+    EXPECT_TRUE(gc_relay_window_accept(&window, 1000));
+    EXPECT_TRUE(gc_relay_window_accept(&window, 1000 + GC_RELAY_WINDOW_SIZE - 1));
+    EXPECT_FALSE(gc_relay_window_accept(&window, 1000));
+    EXPECT_FALSE(gc_relay_window_accept(&window, 999));
+
+    // A jump past the whole window forgets everything in it.
+    EXPECT_TRUE(gc_relay_window_accept(&window, 5000));
+    EXPECT_TRUE(gc_relay_window_accept(&window, 4999));
+    EXPECT_FALSE(gc_relay_window_accept(&window, 1000 + GC_RELAY_WINDOW_SIZE - 1));
+}
+
+}  // namespace
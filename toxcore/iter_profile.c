@@ -0,0 +1,150 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+/**
+ * Timing counters for the stages of one tox_iterate call.
+ */
+#include "iter_profile.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "attributes.h"
+#include "ccompat.h"
+#include "logger.h"
+#include "mem.h"
+#include "mono_time.h"
+
+typedef struct Iter_Profile_Counters {
+    uint64_t calls;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t histogram[ITER_PROFILE_HISTOGRAM_SIZE];
+} Iter_Profile_Counters;
+
+struct Iter_Profile {
+    const Mono_Time *_Nonnull mono_time;
+    Iter_Profile_Counters stages[ITER_PROFILE_NUM_STAGES];
+};
+
+static uint32_t histogram_bucket(uint64_t duration_ns)
+{
+    uint64_t us = duration_ns / 1000;
+    uint32_t bucket = 0;
+
+    while (us != 0 && bucket < ITER_PROFILE_HISTOGRAM_SIZE - 1) {
+        us >>= 1;
+        ++bucket;
+    }
+
+    return bucket;
+}
+
+uint64_t iterprof_start(const Iter_Profile *profile)
+{
+    if (profile == nullptr) {
+        return 0;
+    }
+
+    return current_time_monotonic_ns(profile->mono_time);
+}
+
+void iterprof_record(Iter_Profile *profile, Iter_Profile_Stage stage, uint64_t start)
+{
+    if (profile == nullptr) {
+        return;
+    }
+
+    const uint64_t now = current_time_monotonic_ns(profile->mono_time);
+    // A clock that went backwards counts as an instant run.
+    iterprof_record_duration(profile, stage, now > start ? now - start : 0);
+}
+
+void iterprof_record_duration(Iter_Profile *profile, Iter_Profile_Stage stage, uint64_t duration_ns)
+{
+    if (profile == nullptr || (unsigned int)stage >= ITER_PROFILE_NUM_STAGES) {
+        return;
+    }
+
+    Iter_Profile_Counters *counters = &profile->stages[stage];
+    ++counters->calls;
+    counters->total_ns += duration_ns;
+
+    if (duration_ns > counters->max_ns) {
+        counters->max_ns = duration_ns;
+    }
+
+    ++counters->histogram[histogram_bucket(duration_ns)];
+}
+
+static const Iter_Profile_Counters *_Nullable get_counters(const Iter_Profile *_Nullable profile,
+        Iter_Profile_Stage stage)
+{
+    if (profile == nullptr || (unsigned int)stage >= ITER_PROFILE_NUM_STAGES) {
+        return nullptr;
+    }
+
+    return &profile->stages[stage];
+}
+
+uint64_t iterprof_get_calls(const Iter_Profile *profile, Iter_Profile_Stage stage)
+{
+    const Iter_Profile_Counters *counters = get_counters(profile, stage);
+    return counters != nullptr ? counters->calls : 0;
+}
+
+uint64_t iterprof_get_total_ns(const Iter_Profile *profile, Iter_Profile_Stage stage)
+{
+    const Iter_Profile_Counters *counters = get_counters(profile, stage);
+    return counters != nullptr ? counters->total_ns : 0;
+}
+
+uint64_t iterprof_get_max_ns(const Iter_Profile *profile, Iter_Profile_Stage stage)
+{
+    const Iter_Profile_Counters *counters = get_counters(profile, stage);
+    return counters != nullptr ? counters->max_ns : 0;
+}
+
+uint64_t iterprof_get_histogram(const Iter_Profile *profile, Iter_Profile_Stage stage, uint32_t bucket)
+{
+    const Iter_Profile_Counters *counters = get_counters(profile, stage);
+
+    if (counters == nullptr || bucket >= ITER_PROFILE_HISTOGRAM_SIZE) {
+        return 0;
+    }
+
+    return counters->histogram[bucket];
+}
+
+void iterprof_reset(Iter_Profile *profile)
+{
+    if (profile != nullptr) {
+        memset(profile->stages, 0, sizeof(profile->stages));
+    }
+}
+
+Iter_Profile *iterprof_new(const Logger *log, const Memory *mem, const Mono_Time *mono_time)
+{
+    if (!ITER_PROFILE) {
+        // Compiled out: without a profile, no other function reads the clock.
+        return nullptr;
+    }
+
+    Iter_Profile *profile = (Iter_Profile *)mem_alloc(mem, sizeof(Iter_Profile));
+
+    if (profile == nullptr) {
+        LOGGER_ERROR(log, "failed to allocate memory for iteration profiler");
+        return nullptr;
+    }
+
+    profile->mono_time = mono_time;
+    return profile;
+}
+
+void iterprof_kill(const Memory *mem, Iter_Profile *profile)
+{
+    if (profile != nullptr) {
+        mem_delete(mem, profile);
+    }
+}
@@ -0,0 +1,112 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+/**
+ * Timing counters for the stages of one tox_iterate call.
+ *
+ * Each stage keeps a call count, the total and maximum time spent in it, and a
+ * histogram of its latencies. Recording a sample reads the Mono_Time clock at
+ * nanosecond resolution twice and updates a handful of counters, so it can stay on in
+ * production builds. Building with `ITER_PROFILE=0` removes the clock reads
+ * altogether: `iterprof_new` then returns null and every other function does
+ * nothing.
+ */
+#ifndef C_TOXCORE_TOXCORE_ITER_PROFILE_H
+#define C_TOXCORE_TOXCORE_ITER_PROFILE_H
+
+#include <stdint.h>
+
+#include "attributes.h"
+#include "logger.h"
+#include "mem.h"
+#include "mono_time.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef ITER_PROFILE
+#define ITER_PROFILE 1
+#endif /* ITER_PROFILE */
+
+/**
+ * @brief Number of latency histogram buckets per stage.
+ *
+ * Bucket 0 counts samples under 1 microsecond. Bucket `i` for `0 < i < 19`
+ * counts samples of at least `2^(i-1)` and under `2^i` microseconds. The last
+ * bucket counts everything from 2^18 microseconds (about 262 ms) up.
+ */
+#define ITER_PROFILE_HISTOGRAM_SIZE 20
+
+/** @brief The parts of an iteration that are timed separately. */
+typedef enum Iter_Profile_Stage {
+    /** All of tox_iterate except waiting for events. */
+    ITER_STAGE_ITERATE,
+    ITER_STAGE_NETWORKING_POLL,
+    ITER_STAGE_DHT,
+    ITER_STAGE_TCP_SERVER,
+    ITER_STAGE_NET_CRYPTO,
+    ITER_STAGE_ONION_CLIENT,
+    ITER_STAGE_FRIEND_CONNECTIONS,
+    ITER_STAGE_FRIENDS,
+    ITER_STAGE_GC,
+    ITER_STAGE_GCA,
+    ITER_STAGE_GC_ONION_FRIENDS,
+    ITER_STAGE_GROUPCHATS,
+} Iter_Profile_Stage;
+
+#define ITER_PROFILE_NUM_STAGES (ITER_STAGE_GROUPCHATS + 1)
+
+/* If passed to an iterprof function as a nullptr the function will have no effect. */
+typedef struct Iter_Profile Iter_Profile;
+
+/** @brief Returns the time to pass to `iterprof_record` when the stage ends.
+ *
+ * Returns 0 without reading the clock if `profile` is null.
+ */
+uint64_t iterprof_start(const Iter_Profile *_Nullable profile);
+
+/** @brief Records one run of `stage` that began at `start` (see `iterprof_start`). */
+void iterprof_record(Iter_Profile *_Nullable profile, Iter_Profile_Stage stage, uint64_t start);
+
+/** @brief Records one run of `stage` that took `duration_ns` nanoseconds. */
+void iterprof_record_duration(Iter_Profile *_Nullable profile, Iter_Profile_Stage stage, uint64_t duration_ns);
+
+/** @brief Returns the number of recorded runs of `stage`. */
+uint64_t iterprof_get_calls(const Iter_Profile *_Nullable profile, Iter_Profile_Stage stage);
+
+/** @brief Returns the total time spent in `stage`, in nanoseconds. */
+uint64_t iterprof_get_total_ns(const Iter_Profile *_Nullable profile, Iter_Profile_Stage stage);
+
+/** @brief Returns the longest single run of `stage`, in nanoseconds. */
+uint64_t iterprof_get_max_ns(const Iter_Profile *_Nullable profile, Iter_Profile_Stage stage);
+
+/** @brief Returns the number of runs of `stage` that fell into histogram bucket `bucket`.
+ *
+ * Returns 0 if `bucket` is not less than ITER_PROFILE_HISTOGRAM_SIZE.
+ */
+uint64_t iterprof_get_histogram(const Iter_Profile *_Nullable profile, Iter_Profile_Stage stage, uint32_t bucket);
+
+/** @brief Sets all counters of all stages back to 0. */
+void iterprof_reset(Iter_Profile *_Nullable profile);
+
+/**
+ * Returns a new iteration profile, or null if profiling was compiled out or
+ * the allocation failed. It reads the time from `mono_time`, which must outlive
+ * it. The caller is responsible for freeing the returned memory via
+ * `iterprof_kill`.
+ */
+Iter_Profile *_Nullable iterprof_new(const Logger *_Nonnull log, const Memory *_Nonnull mem,
+                                     const Mono_Time *_Nonnull mono_time);
+
+/**
+ * Kills an iteration profile and frees all associated memory.
+ */
+void iterprof_kill(const Memory *_Nonnull mem, Iter_Profile *_Nullable profile);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* C_TOXCORE_TOXCORE_ITER_PROFILE_H */
@@ -0,0 +1,140 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include "iter_profile.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "logger.h"
+#include "mono_time.h"
+#include "os_memory.h"
+
+namespace {
+
+class IterProfileTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        log = logger_new(os_memory());
+        ASSERT_NE(log, nullptr);
+        mono_time = mono_time_new(os_memory(), nullptr, nullptr);
+        ASSERT_NE(mono_time, nullptr);
+        profile = iterprof_new(log, os_memory(), mono_time);
+#if ITER_PROFILE
+        ASSERT_NE(profile, nullptr);
+#endif /* ITER_PROFILE */
+    }
+
+    void TearDown() override
+    {
+        iterprof_kill(os_memory(), profile);
+        mono_time_free(os_memory(), mono_time);
+        logger_kill(log);
+    }
+
+    Logger *log = nullptr;
+    Mono_Time *mono_time = nullptr;
+    Iter_Profile *profile = nullptr;
+};
+
+TEST_F(IterProfileTest, NullProfileIsIgnored)
+{
+    EXPECT_EQ(iterprof_start(nullptr), 0);
+    iterprof_record(nullptr, ITER_STAGE_DHT, 0);
+    iterprof_record_duration(nullptr, ITER_STAGE_DHT, 1000);
+    iterprof_reset(nullptr);
+    EXPECT_EQ(iterprof_get_calls(nullptr, ITER_STAGE_DHT), 0);
+    EXPECT_EQ(iterprof_get_total_ns(nullptr, ITER_STAGE_DHT), 0);
+    EXPECT_EQ(iterprof_get_max_ns(nullptr, ITER_STAGE_DHT), 0);
+    EXPECT_EQ(iterprof_get_histogram(nullptr, ITER_STAGE_DHT, 0), 0);
+}
+
+#if ITER_PROFILE
+TEST_F(IterProfileTest, RecordsCallsTotalAndMax)
+{
+    iterprof_record_duration(profile, ITER_STAGE_NET_CRYPTO, 500);
+    iterprof_record_duration(profile, ITER_STAGE_NET_CRYPTO, 3000);
+    iterprof_record_duration(profile, ITER_STAGE_NET_CRYPTO, 1500);
+
+    EXPECT_EQ(iterprof_get_calls(profile, ITER_STAGE_NET_CRYPTO), 3);
+    EXPECT_EQ(iterprof_get_total_ns(profile, ITER_STAGE_NET_CRYPTO), 5000);
+    EXPECT_EQ(iterprof_get_max_ns(profile, ITER_STAGE_NET_CRYPTO), 3000);
+
+    // Other stages are untouched.
+    EXPECT_EQ(iterprof_get_calls(profile, ITER_STAGE_DHT), 0);
+}
+
+TEST_F(IterProfileTest, HistogramBucketsArePowersOfTwoMicroseconds)
+{
+    iterprof_record_duration(profile, ITER_STAGE_GC, 999);       // < 1us
+    iterprof_record_duration(profile, ITER_STAGE_GC, 1000);      // [1us, 2us)
+    iterprof_record_duration(profile, ITER_STAGE_GC, 1999);      // [1us, 2us)
+    iterprof_record_duration(profile, ITER_STAGE_GC, 2000);      // [2us, 4us)
+    iterprof_record_duration(profile, ITER_STAGE_GC, 1000000);   // [512us, 1024us)
+    iterprof_record_duration(profile, ITER_STAGE_GC, UINT64_MAX);  // last bucket
+
+    EXPECT_EQ(iterprof_get_histogram(profile, ITER_STAGE_GC, 0), 1);
+    EXPECT_EQ(iterprof_get_histogram(profile, ITER_STAGE_GC, 1), 2);
+    EXPECT_EQ(iterprof_get_histogram(profile, ITER_STAGE_GC, 2), 1);
+    EXPECT_EQ(iterprof_get_histogram(profile, ITER_STAGE_GC, 10), 1);
+    EXPECT_EQ(iterprof_get_histogram(profile, ITER_STAGE_GC, ITER_PROFILE_HISTOGRAM_SIZE - 1), 1);
+    EXPECT_EQ(iterprof_get_histogram(profile, ITER_STAGE_GC, ITER_PROFILE_HISTOGRAM_SIZE), 0);
+
+    std::uint64_t sum = 0;
+
+    for (std::uint32_t i = 0; i < ITER_PROFILE_HISTOGRAM_SIZE; ++i) {
+        sum += iterprof_get_histogram(profile, ITER_STAGE_GC, i);
+    }
+
+    EXPECT_EQ(sum, iterprof_get_calls(profile, ITER_STAGE_GC));
+}
+
+TEST_F(IterProfileTest, StartAndRecordMeasuresElapsedTime)
+{
+    const std::uint64_t start = iterprof_start(profile);
+    EXPECT_NE(start, 0);
+    iterprof_record(profile, ITER_STAGE_ITERATE, start);
+
+    EXPECT_EQ(iterprof_get_calls(profile, ITER_STAGE_ITERATE), 1);
+    EXPECT_EQ(iterprof_get_total_ns(profile, ITER_STAGE_ITERATE),
+              iterprof_get_max_ns(profile, ITER_STAGE_ITERATE));
+}
+
+TEST_F(IterProfileTest, ReadsTheMonoTimeClock)
+{
+    std::uint64_t now_ms = 1000;
+    mono_time_set_current_time_callback(
+        mono_time, [](void *user_data) { return *static_cast<std::uint64_t *>(user_data); },
+        &now_ms);
+
+    const std::uint64_t start = iterprof_start(profile);
+    now_ms += 3;
+    iterprof_record(profile, ITER_STAGE_ITERATE, start);
+
+    EXPECT_EQ(iterprof_get_total_ns(profile, ITER_STAGE_ITERATE), 3000000);
+}
+
+TEST_F(IterProfileTest, InvalidStageIsIgnored)
+{
+    const Iter_Profile_Stage invalid = static_cast<Iter_Profile_Stage>(ITER_PROFILE_NUM_STAGES);
+    iterprof_record_duration(profile, invalid, 1000);
+    EXPECT_EQ(iterprof_get_calls(profile, invalid), 0);
+}
+
+TEST_F(IterProfileTest, ResetClearsAllCounters)
+{
+    iterprof_record_duration(profile, ITER_STAGE_FRIENDS, 5000);
+    iterprof_record_duration(profile, ITER_STAGE_GROUPCHATS, 7000);
+    iterprof_reset(profile);
+
+    EXPECT_EQ(iterprof_get_calls(profile, ITER_STAGE_FRIENDS), 0);
+    EXPECT_EQ(iterprof_get_total_ns(profile, ITER_STAGE_GROUPCHATS), 0);
+    EXPECT_EQ(iterprof_get_max_ns(profile, ITER_STAGE_GROUPCHATS), 0);
+    EXPECT_EQ(iterprof_get_histogram(profile, ITER_STAGE_FRIENDS, 3), 0);
+}
+#endif /* ITER_PROFILE */
+
+}  // namespace
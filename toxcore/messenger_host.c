@@ -0,0 +1,809 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include "messenger_host.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "DHT.h"
+#include "TCP_connection.h"
+#include "announce.h"
+#include "attributes.h"
+#include "ccompat.h"
+#include "crypto_core.h"
+#include "forwarding.h"
+#include "group_announce.h"
+#include "group_onion_announce.h"
+#include "list.h"
+#include "logger.h"
+#include "mem.h"
+#include "mono_time.h"
+#include "net_crypto.h"
+#include "net_profile.h"
+#include "network.h"
+#include "onion.h"
+#include "onion_announce.h"
+
+/** The DHT, onion and group announce code check their timers on every run. */
+#define MESSENGER_HOST_RUN_INTERVAL 50
+
+typedef struct Host_Packet_Handler {
+    uint8_t byte;
+    packet_handler_cb *_Nonnull function;
+    void *_Nullable object;
+} Host_Packet_Handler;
+
+typedef struct Host_Cryptopacket_Handler {
+    uint8_t byte;
+    cryptopacket_handler_cb *_Nonnull function;
+    void *_Nullable object;
+} Host_Cryptopacket_Handler;
+
+/** @brief Handlers as registered on the shared components. */
+typedef struct Host_Packet_Registration {
+    packet_handler_cb *_Nullable function;
+    void *_Nullable object;
+} Host_Packet_Registration;
+
+typedef struct Host_Cryptopacket_Registration {
+    cryptopacket_handler_cb *_Nullable function;
+    void *_Nullable object;
+} Host_Cryptopacket_Registration;
+
+/** @brief The object of the host's handler for one cryptopacket type, which isn't passed the type. */
+typedef struct Host_Cryptopacket_Type {
+    Messenger_Host *_Nonnull host;
+    uint8_t byte;
+} Host_Cryptopacket_Type;
+
+struct Host_Instance {
+    Messenger_Host *_Nonnull host;
+    /* Where the instance is in the host's instances, which the lists below map to. */
+    uint32_t index;
+
+    void *_Nullable userdata;
+
+    Host_Packet_Handler udp[MESSENGER_HOST_MAX_HANDLERS];
+    uint8_t udp_length;
+
+    Host_Cryptopacket_Handler crypto[MESSENGER_HOST_MAX_HANDLERS];
+    uint8_t crypto_length;
+
+    tcp_data_cb *_Nullable tcp_data_callback;
+    void *_Nullable tcp_data_object;
+    tcp_oob_cb *_Nullable tcp_oob_callback;
+    void *_Nullable tcp_oob_object;
+    tcp_onion_cb *_Nullable tcp_onion_callback;
+    void *_Nullable tcp_onion_object;
+};
+
+struct Messenger_Host {
+    const Logger *_Nonnull log;
+    const Memory *_Nonnull mem;
+    const Random *_Nonnull rng;
+    const Network *_Nonnull ns;
+    Mono_Time *_Nonnull mono_time;
+
+    bool udp_disabled;
+
+    Networking_Core *_Nonnull net;
+    DHT *_Nonnull dht;
+    Net_Profile *_Nonnull tcp_np;
+    TCP_Connections *_Nonnull tcp_c;
+    Forwarding *_Nullable forwarding;
+    Announcements *_Nullable announce;
+    Onion *_Nonnull onion;
+    Onion_Announce *_Nonnull onion_a;
+    GC_Announces_List *_Nonnull group_announce;
+
+    uint8_t cookie_key[CRYPTO_SYMMETRIC_KEY_SIZE];
+
+    /* What the host expects to be registered, to spot what an instance added. */
+    Host_Packet_Registration udp[256];
+    Host_Cryptopacket_Registration crypto[256];
+    Host_Cryptopacket_Type crypto_types[256];
+
+    Host_Instance *_Nonnull *_Nullable instances;
+    uint32_t instances_length;
+
+    /* Gets TCP data for connections that belong to no instance. */
+    Host_Instance no_instance;
+
+    /* Maps the address of each net_crypto connection to the index of its instance. */
+    BS_List sources;
+    /* Maps the public keys instances added to the index of the instance. */
+    BS_List keys;
+    /* Maps a group chat peer's key to the index of the instance that last took a handshake from it. */
+    BS_List senders;
+};
+
+static const Host_Packet_Handler *_Nullable instance_udp_handler(const Host_Instance *_Nonnull instance, uint8_t byte)
+{
+    for (uint8_t i = 0; i < instance->udp_length; ++i) {
+        if (instance->udp[i].byte == byte) {
+            return &instance->udp[i];
+        }
+    }
+
+    return nullptr;
+}
+
+static const Host_Cryptopacket_Handler *_Nullable instance_crypto_handler(const Host_Instance *_Nonnull instance, uint8_t byte)
+{
+    for (uint8_t i = 0; i < instance->crypto_length; ++i) {
+        if (instance->crypto[i].byte == byte) {
+            return &instance->crypto[i];
+        }
+    }
+
+    return nullptr;
+}
+
+static int instance_handle_packet(const Host_Instance *_Nonnull instance, const IP_Port *_Nonnull source,
+                                  const uint8_t *_Nonnull packet, uint16_t length)
+{
+    const Host_Packet_Handler *handler = instance_udp_handler(instance, packet[0]);
+
+    if (handler == nullptr) {
+        return 1;
+    }
+
+    return handler->function(handler->object, source, packet, length, instance->userdata);
+}
+
+/** @brief Remove the `i`th element of a list of IP_Ports or public keys. */
+static void list_remove_at(BS_List *_Nonnull list, uint32_t i)
+{
+    uint8_t element[sizeof(IP_Port) > CRYPTO_PUBLIC_KEY_SIZE ? sizeof(IP_Port) : CRYPTO_PUBLIC_KEY_SIZE];
+    assert(list->element_size <= sizeof(element));
+    memcpy(element, &list->data[i * list->element_size], list->element_size);
+    bs_list_remove(list, element, list->ids[i]);
+}
+
+static void remember_sender(Messenger_Host *_Nonnull host, const uint8_t *_Nonnull public_key, uint32_t index)
+{
+    const int old = bs_list_find(&host->senders, public_key);
+
+    if (old != -1) {
+        bs_list_remove(&host->senders, public_key, old);
+    } else if (host->senders.n >= MESSENGER_HOST_SENDER_CACHE_SIZE) {
+        // Make room by forgetting one sender, so a burst of new ones can't flush the cache.
+        list_remove_at(&host->senders, random_range_u32(host->rng, host->senders.n));
+    }
+
+    bs_list_add(&host->senders, public_key, (int)index);
+}
+
+/** @brief Drop what `list` maps to the instance that was at `index`.
+ *
+ * The last instance has moved into its place.
+ */
+static void forget_instance(BS_List *_Nonnull list, uint32_t index, uint32_t moved)
+{
+    for (uint32_t i = list->n; i > 0; --i) {
+        const uint32_t j = i - 1;
+
+        if ((uint32_t)list->ids[j] == index) {
+            list_remove_at(list, j);
+        } else if ((uint32_t)list->ids[j] == moved) {
+            list->ids[j] = (int)index;
+        }
+    }
+}
+
+/** @brief Return the instance `list` maps `data` to, or NULL. */
+static const Host_Instance *_Nullable find_instance(const Messenger_Host *_Nonnull host, const BS_List *_Nonnull list,
+        const uint8_t *_Nonnull data)
+{
+    const int index = bs_list_find(list, data);
+
+    if (index < 0 || (uint32_t)index >= host->instances_length) {
+        return nullptr;
+    }
+
+    return host->instances[index];
+}
+
+static int handle_packet_for(const Host_Instance *_Nullable instance, const IP_Port *_Nonnull source,
+                             const uint8_t *_Nonnull packet, uint16_t length)
+{
+    if (instance == nullptr) {
+        return 1;
+    }
+
+    return instance_handle_packet(instance, source, packet, length);
+}
+
+/** @brief Give a handshake to the instance with a connection at its source, or else to the one that knows its sender. */
+static int host_handle_handshake(const Messenger_Host *_Nonnull host, const IP_Port *_Nonnull source,
+                                 const uint8_t *_Nonnull packet, uint16_t length)
+{
+    const Host_Instance *instance = find_instance(host, &host->sources, (const uint8_t *)source);
+
+    if (instance == nullptr) {
+        uint8_t real_public_key[CRYPTO_PUBLIC_KEY_SIZE];
+
+        if (!nc_handshake_sender(host->mem, host->mono_time, host->cookie_key, packet, length, real_public_key)) {
+            return 1;
+        }
+
+        instance = find_instance(host, &host->keys, real_public_key);
+    }
+
+    return handle_packet_for(instance, source, packet, length);
+}
+
+/** @brief Give a group chat handshake to the instance with the receiver's key.
+ *
+ * Other group chat packets only carry the sender's key, so the host remembers
+ * whose it is.
+ */
+static int host_handle_gc_handshake(Messenger_Host *_Nonnull host, const IP_Port *_Nonnull source,
+                                    const uint8_t *_Nonnull packet, uint16_t length)
+{
+    if (length < 1 + CRYPTO_PUBLIC_KEY_SIZE * 2) {
+        return 1;
+    }
+
+    const uint8_t *sender_pk = packet + 1;
+    const uint8_t *receiver_pk = packet + 1 + CRYPTO_PUBLIC_KEY_SIZE;
+    const int index = bs_list_find(&host->keys, receiver_pk);
+
+    if (index < 0 || (uint32_t)index >= host->instances_length) {
+        return 1;
+    }
+
+    if (instance_handle_packet(host->instances[index], source, packet, length) != 0) {
+        return 1;
+    }
+
+    remember_sender(host, sender_pk, (uint32_t)index);
+    return 0;
+}
+
+static int host_handle_packet(void *_Nullable object, const IP_Port *_Nonnull source, const uint8_t *_Nonnull packet, uint16_t length,
+                              void *_Nullable userdata)
+{
+    Messenger_Host *host = (Messenger_Host *)object;
+
+    switch (packet[0]) {
+        case NET_PACKET_COOKIE_REQUEST: {
+            // The answer takes only the DHT and cookie keys, which all instances share.
+            return handle_packet_for(host->instances_length == 0 ? nullptr : host->instances[0], source, packet, length);
+        }
+
+        case NET_PACKET_COOKIE_RESPONSE:
+        case NET_PACKET_CRYPTO_DATA: {
+            return handle_packet_for(find_instance(host, &host->sources, (const uint8_t *)source), source, packet, length);
+        }
+
+        case NET_PACKET_CRYPTO_HS: {
+            return host_handle_handshake(host, source, packet, length);
+        }
+
+        case NET_PACKET_GC_HANDSHAKE: {
+            return host_handle_gc_handshake(host, source, packet, length);
+        }
+
+        case NET_PACKET_GC_LOSSLESS:
+        case NET_PACKET_GC_LOSSY: {
+            if (length < 1 + CRYPTO_PUBLIC_KEY_SIZE) {
+                return 1;
+            }
+
+            return handle_packet_for(find_instance(host, &host->senders, packet + 1), source, packet, length);
+        }
+
+        default: {
+            break;
+        }
+    }
+
+    // Onion responses don't say whose they are, so each instance checks its own sendbacks and keys.
+    for (uint32_t i = 0; i < host->instances_length; ++i) {
+        if (instance_handle_packet(host->instances[i], source, packet, length) == 0) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static int cryptopacket_for(const Host_Instance *_Nullable instance, uint8_t byte, const IP_Port *_Nonnull source,
+                            const uint8_t *_Nonnull source_pubkey, const uint8_t *_Nonnull packet, uint16_t length)
+{
+    if (instance == nullptr) {
+        return 1;
+    }
+
+    const Host_Cryptopacket_Handler *handler = instance_crypto_handler(instance, byte);
+
+    if (handler == nullptr) {
+        return 1;
+    }
+
+    return handler->function(handler->object, source, source_pubkey, packet, length, instance->userdata);
+}
+
+static int host_handle_cryptopacket(void *_Nullable object, const IP_Port *_Nonnull source, const uint8_t *_Nonnull source_pubkey,
+                                    const uint8_t *_Nonnull packet, uint16_t length, void *_Nullable userdata)
+{
+    const Host_Cryptopacket_Type *type = (const Host_Cryptopacket_Type *)object;
+    const Messenger_Host *host = type->host;
+
+    if (type->byte == CRYPTO_PACKET_DHTPK) {
+        // Starts with the real public key of the peer that sent it.
+        if (length < CRYPTO_PUBLIC_KEY_SIZE) {
+            return 1;
+        }
+
+        return cryptopacket_for(find_instance(host, &host->keys, packet), type->byte, source, source_pubkey, packet, length);
+    }
+
+    for (uint32_t i = 0; i < host->instances_length; ++i) {
+        if (cryptopacket_for(host->instances[i], type->byte, source, source_pubkey, packet, length) == 0) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static int host_tcp_data(void *_Nonnull object, int crypt_connection_id, const uint8_t *_Nonnull packet, uint16_t length,
+                         void *_Nullable userdata)
+{
+    const Host_Instance *instance = (const Host_Instance *)object;
+
+    if (instance->tcp_data_callback == nullptr) {
+        return -1;
+    }
+
+    return instance->tcp_data_callback(instance->tcp_data_object, crypt_connection_id, packet, length, instance->userdata);
+}
+
+static int host_tcp_oob(void *_Nonnull object, const uint8_t *_Nonnull public_key, unsigned int tcp_connections_number,
+                        const uint8_t *_Nonnull packet, uint16_t length, void *_Nullable userdata)
+{
+    const Messenger_Host *host = (const Messenger_Host *)object;
+    const Host_Instance *instance = nullptr;
+    uint8_t real_public_key[CRYPTO_PUBLIC_KEY_SIZE];
+
+    if (length > 0 && packet[0] == NET_PACKET_COOKIE_REQUEST) {
+        instance = host->instances_length == 0 ? nullptr : host->instances[0];
+    } else if (nc_handshake_sender(host->mem, host->mono_time, host->cookie_key, packet, length, real_public_key)) {
+        instance = find_instance(host, &host->keys, real_public_key);
+    }
+
+    if (instance == nullptr || instance->tcp_oob_callback == nullptr) {
+        return -1;
+    }
+
+    return instance->tcp_oob_callback(instance->tcp_oob_object, public_key, tcp_connections_number, packet, length,
+                                      instance->userdata);
+}
+
+static int host_tcp_onion(void *_Nullable object, const uint8_t *_Nonnull data, uint16_t length, void *_Nullable userdata)
+{
+    const Messenger_Host *host = (const Messenger_Host *)object;
+
+    // Like onion responses over UDP, these don't say whose they are.
+    for (uint32_t i = 0; i < host->instances_length; ++i) {
+        const Host_Instance *instance = host->instances[i];
+
+        if (instance->tcp_onion_callback != nullptr
+                && instance->tcp_onion_callback(instance->tcp_onion_object, data, length, instance->userdata) == 0) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static void instance_ip_port_changed(void *_Nullable object, const IP_Port *_Nonnull ip_port, bool added)
+{
+    const Host_Instance *instance = (const Host_Instance *)object;
+    BS_List *sources = &instance->host->sources;
+
+    if (added) {
+        bs_list_add(sources, (const uint8_t *)ip_port, (int)instance->index);
+    } else {
+        bs_list_remove(sources, (const uint8_t *)ip_port, (int)instance->index);
+    }
+}
+
+bool host_instance_add_key(Host_Instance *instance, const uint8_t *public_key)
+{
+    return bs_list_add(&instance->host->keys, public_key, (int)instance->index);
+}
+
+void host_instance_remove_key(Host_Instance *instance, const uint8_t *public_key)
+{
+    bs_list_remove(&instance->host->keys, public_key, (int)instance->index);
+}
+
+/** @brief Register the host's handlers for every packet type an instance handles.
+ *
+ * Types no instance handles anymore get back what the shared components
+ * registered, or nothing.
+ */
+static void install_handlers(Messenger_Host *_Nonnull host)
+{
+    for (uint32_t byte = 0; byte < 256; ++byte) {
+        bool udp_used = false;
+        bool crypto_used = false;
+
+        for (uint32_t i = 0; i < host->instances_length; ++i) {
+            udp_used = udp_used || instance_udp_handler(host->instances[i], (uint8_t)byte) != nullptr;
+            crypto_used = crypto_used || instance_crypto_handler(host->instances[i], (uint8_t)byte) != nullptr;
+        }
+
+        Host_Packet_Registration *udp = &host->udp[byte];
+
+        if (udp_used) {
+            udp->function = &host_handle_packet;
+            udp->object = host;
+        } else if (udp->function == &host_handle_packet) {
+            udp->function = nullptr;
+            udp->object = nullptr;
+        }
+
+        networking_registerhandler(host->net, (uint8_t)byte, udp->function, udp->object);
+
+        Host_Cryptopacket_Registration *crypto = &host->crypto[byte];
+
+        if (crypto_used) {
+            crypto->function = &host_handle_cryptopacket;
+            crypto->object = &host->crypto_types[byte];
+        } else if (crypto->function == &host_handle_cryptopacket) {
+            crypto->function = nullptr;
+            crypto->object = nullptr;
+        }
+
+        cryptopacket_registerhandler(host->dht, (uint8_t)byte, crypto->function, crypto->object);
+    }
+
+    set_packet_tcp_connection_callback(host->tcp_c, &host_tcp_data, &host->no_instance);
+    set_oob_packet_tcp_connection_callback(host->tcp_c, &host_tcp_oob, host);
+    set_onion_packet_tcp_connection_callback(host->tcp_c, &host_tcp_onion, host);
+}
+
+/** @brief Move the handlers registered since the last install into the instance.
+ *
+ * @retval false if the instance registered too many.
+ */
+static bool capture_handlers(Messenger_Host *_Nonnull host, Host_Instance *_Nonnull instance)
+{
+    for (uint32_t byte = 0; byte < 256; ++byte) {
+        void *object;
+        packet_handler_cb *function = networking_get_handler(host->net, (uint8_t)byte, &object);
+
+        if (function != nullptr && (function != host->udp[byte].function || object != host->udp[byte].object)) {
+            if (instance->udp_length == MESSENGER_HOST_MAX_HANDLERS) {
+                return false;
+            }
+
+            const Host_Packet_Handler handler = {(uint8_t)byte, function, object};
+            instance->udp[instance->udp_length] = handler;
+            ++instance->udp_length;
+        }
+
+        cryptopacket_handler_cb *crypto_function = cryptopacket_get_handler(host->dht, (uint8_t)byte, &object);
+
+        if (crypto_function != nullptr && (crypto_function != host->crypto[byte].function || object != host->crypto[byte].object)) {
+            if (instance->crypto_length == MESSENGER_HOST_MAX_HANDLERS) {
+                return false;
+            }
+
+            const Host_Cryptopacket_Handler handler = {(uint8_t)byte, crypto_function, object};
+            instance->crypto[instance->crypto_length] = handler;
+            ++instance->crypto_length;
+        }
+    }
+
+    void *object;
+    tcp_data_cb *data_function = get_packet_tcp_connection_callback(host->tcp_c, &object);
+
+    if (data_function != &host_tcp_data) {
+        instance->tcp_data_callback = data_function;
+        instance->tcp_data_object = object;
+    }
+
+    tcp_oob_cb *oob_function = get_oob_packet_tcp_connection_callback(host->tcp_c, &object);
+
+    if (oob_function != &host_tcp_oob) {
+        instance->tcp_oob_callback = oob_function;
+        instance->tcp_oob_object = object;
+    }
+
+    tcp_onion_cb *onion_function = get_onion_packet_tcp_connection_callback(host->tcp_c, &object);
+
+    if (onion_function != &host_tcp_onion) {
+        instance->tcp_onion_callback = onion_function;
+        instance->tcp_onion_object = object;
+    }
+
+    return true;
+}
+
+Host_Instance *messenger_host_attach(Messenger_Host *host, Net_Crypto *net_crypto)
+{
+    Host_Instance *instance = (Host_Instance *)mem_alloc(host->mem, sizeof(Host_Instance));
+
+    if (instance == nullptr) {
+        install_handlers(host);
+        return nullptr;
+    }
+
+    if (!capture_handlers(host, instance)) {
+        LOGGER_ERROR(host->log, "instance registered more than %d handlers", MESSENGER_HOST_MAX_HANDLERS);
+        mem_delete(host->mem, instance);
+        install_handlers(host);
+        return nullptr;
+    }
+
+    Host_Instance **instances = (Host_Instance **)mem_vrealloc(host->mem, host->instances,
+                                host->instances_length + 1, sizeof(Host_Instance *));
+
+    if (instances == nullptr) {
+        mem_delete(host->mem, instance);
+        install_handlers(host);
+        return nullptr;
+    }
+
+    instance->host = host;
+    instance->index = host->instances_length;
+    instances[host->instances_length] = instance;
+    host->instances = instances;
+    ++host->instances_length;
+
+    nc_set_tcp_object(net_crypto, instance);
+    nc_set_ip_port_callback(net_crypto, &instance_ip_port_changed, instance);
+    install_handlers(host);
+
+    return instance;
+}
+
+void messenger_host_detach(Messenger_Host *host, Host_Instance *instance)
+{
+    for (uint32_t i = 0; i < host->instances_length; ++i) {
+        if (host->instances[i] != instance) {
+            continue;
+        }
+
+        --host->instances_length;
+        host->instances[i] = host->instances[host->instances_length];
+        host->instances[i]->index = i;
+
+        forget_instance(&host->sources, i, host->instances_length);
+        forget_instance(&host->keys, i, host->instances_length);
+        forget_instance(&host->senders, i, host->instances_length);
+        break;
+    }
+
+    mem_delete(host->mem, instance);
+    install_handlers(host);
+}
+
+void host_instance_set_userdata(Host_Instance *instance, void *userdata)
+{
+    instance->userdata = userdata;
+}
+
+/** @brief Remember what the shared components registered. */
+static void snapshot_handlers(Messenger_Host *_Nonnull host)
+{
+    for (uint32_t byte = 0; byte < 256; ++byte) {
+        void *object;
+        packet_handler_cb *function = networking_get_handler(host->net, (uint8_t)byte, &object);
+        host->udp[byte].function = function;
+        host->udp[byte].object = object;
+
+        cryptopacket_handler_cb *crypto_function = cryptopacket_get_handler(host->dht, (uint8_t)byte, &object);
+        host->crypto[byte].function = crypto_function;
+        host->crypto[byte].object = object;
+    }
+}
+
+Messenger_Host *new_messenger_host(const Memory *mem, const Random *rng, const Network *ns, Mono_Time *mono_time,
+                                   const Messenger_Host_Options *options, Messenger_Host_Error *error)
+{
+    if (error != nullptr) {
+        *error = MESSENGER_HOST_ERROR_OTHER;
+    }
+
+    Messenger_Host *host = (Messenger_Host *)mem_alloc(mem, sizeof(Messenger_Host));
+
+    if (host == nullptr) {
+        return nullptr;
+    }
+
+    host->log = options->log;
+    host->mem = mem;
+    host->rng = rng;
+    host->ns = ns;
+    host->mono_time = mono_time;
+    host->udp_disabled = options->udp_disabled || options->proxy_info.proxy_type != TCP_PROXY_NONE;
+
+    unsigned int net_err = 0;
+
+    if (host->udp_disabled) {
+        host->net = new_networking_no_udp(host->log, mem, ns);
+    } else {
+        IP ip;
+        ip_init(&ip, options->ipv6enabled);
+        host->net = new_networking_ex(host->log, mem, ns, &ip, options->port_range[0], options->port_range[1], &net_err);
+    }
+
+    if (host->net == nullptr) {
+        if (error != nullptr && net_err == 1) {
+            *error = MESSENGER_HOST_ERROR_PORT;
+        }
+
+        mem_delete(mem, host);
+        return nullptr;
+    }
+
+    bs_list_init(&host->sources, mem, sizeof(IP_Port), 8, ipport_cmp_handler);
+    bs_list_init(&host->keys, mem, CRYPTO_PUBLIC_KEY_SIZE, 8, memcmp);
+    bs_list_init(&host->senders, mem, CRYPTO_PUBLIC_KEY_SIZE, 8, memcmp);
+
+    for (uint32_t byte = 0; byte < 256; ++byte) {
+        host->crypto_types[byte].host = host;
+        host->crypto_types[byte].byte = (uint8_t)byte;
+    }
+
+    host->dht = new_dht(host->log, mem, rng, ns, mono_time, host->net, options->hole_punching_enabled,
+                        options->local_discovery_enabled);
+    host->tcp_np = netprof_new(host->log, mem);
+    host->group_announce = new_gca_list(mem, rng);
+
+    if (host->dht != nullptr && host->tcp_np != nullptr) {
+        host->tcp_c = new_tcp_connections(host->log, mem, rng, ns, mono_time, dht_get_self_secret_key(host->dht),
+                                          &options->proxy_info, host->tcp_np);
+    }
+
+    if (host->dht != nullptr && options->dht_announcements_enabled) {
+        host->forwarding = new_forwarding(host->log, mem, rng, mono_time, host->dht, host->net);
+
+        if (host->forwarding != nullptr) {
+            host->announce = new_announcements(host->log, mem, rng, mono_time, host->forwarding, host->dht, host->net);
+        }
+    }
+
+    if (host->dht != nullptr) {
+        host->onion = new_onion(host->log, mem, mono_time, rng, host->dht, host->net);
+        host->onion_a = new_onion_announce(host->log, mem, rng, mono_time, host->dht, host->net);
+    }
+
+    if (host->dht == nullptr || host->tcp_np == nullptr || host->tcp_c == nullptr || host->group_announce == nullptr
+            || host->onion == nullptr || host->onion_a == nullptr
+            || (options->dht_announcements_enabled && host->announce == nullptr)) {
+        LOGGER_WARNING(host->log, "host initialisation failed");
+        kill_messenger_host(host);
+        return nullptr;
+    }
+
+    gca_onion_init(host->group_announce, host->onion_a);
+    new_symmetric_key(rng, host->cookie_key);
+
+    snapshot_handlers(host);
+    install_handlers(host);
+
+    if (error != nullptr) {
+        *error = MESSENGER_HOST_ERROR_NONE;
+    }
+
+    return host;
+}
+
+void kill_messenger_host(Messenger_Host *host)
+{
+    if (host == nullptr) {
+        return;
+    }
+
+    if (host->instances_length != 0) {
+        LOGGER_ERROR(host->log, "killing a host with %u instances still attached", host->instances_length);
+    }
+
+    const Memory *mem = host->mem;
+
+    bs_list_free(&host->sources);
+    bs_list_free(&host->keys);
+    bs_list_free(&host->senders);
+    mem_delete(mem, host->instances);
+    kill_onion(host->onion);
+    kill_onion_announce(host->onion_a);
+    kill_gca(host->group_announce);
+    kill_announcements(host->announce);
+    kill_forwarding(host->forwarding);
+    kill_tcp_connections(host->tcp_c);
+    netprof_kill(mem, host->tcp_np);
+    kill_dht(host->dht);
+    kill_networking(host->net);
+    crypto_memzero(host->cookie_key, sizeof(host->cookie_key));
+    mem_delete(mem, host);
+}
+
+void do_messenger_host(Messenger_Host *host)
+{
+    if (!host->udp_disabled) {
+        networking_poll(host->net, host);
+        do_dht(host->dht);
+    }
+
+    do_tcp_connections(host->log, host->tcp_c, host);
+    do_gca(host->mono_time, host->group_announce);
+}
+
+uint32_t messenger_host_run_interval(const Messenger_Host *host)
+{
+    return MESSENGER_HOST_RUN_INTERVAL;
+}
+
+uint32_t messenger_host_count(const Messenger_Host *host)
+{
+    return host->instances_length;
+}
+
+Mono_Time *messenger_host_mono_time(const Messenger_Host *host)
+{
+    return host->mono_time;
+}
+
+Networking_Core *messenger_host_net(const Messenger_Host *host)
+{
+    return host->net;
+}
+
+DHT *messenger_host_dht(const Messenger_Host *host)
+{
+    return host->dht;
+}
+
+Net_Profile *messenger_host_tcp_np(const Messenger_Host *host)
+{
+    return host->tcp_np;
+}
+
+TCP_Connections *messenger_host_tcp_c(const Messenger_Host *host)
+{
+    return host->tcp_c;
+}
+
+Forwarding *messenger_host_forwarding(const Messenger_Host *host)
+{
+    return host->forwarding;
+}
+
+Announcements *messenger_host_announce(const Messenger_Host *host)
+{
+    return host->announce;
+}
+
+Onion *messenger_host_onion(const Messenger_Host *host)
+{
+    return host->onion;
+}
+
+Onion_Announce *messenger_host_onion_a(const Messenger_Host *host)
+{
+    return host->onion_a;
+}
+
+GC_Announces_List *messenger_host_group_announce(const Messenger_Host *host)
+{
+    return host->group_announce;
+}
+
+bool messenger_host_udp_disabled(const Messenger_Host *host)
+{
+    return host->udp_disabled;
+}
+
+const uint8_t *messenger_host_cookie_key(const Messenger_Host *host)
+{
+    return host->cookie_key;
+}
@@ -0,0 +1,162 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+/**
+ * Run the identity independent parts of toxcore once for many Messengers.
+ *
+ * A host owns the UDP socket, the DHT, the onion and announce nodes, the group
+ * announce list and the TCP relay connections. Messengers created on a host
+ * only keep what belongs to their identity: keys, friends, net_crypto
+ * connections, the onion client and group chats.
+ *
+ * Packet handlers are registered with a single object, so the host sits in
+ * between: after an instance has registered its handlers on the shared
+ * components, `messenger_host_attach` takes them over and puts a handler in
+ * their place that picks the instance from what the packet carries:
+ * - net_crypto packets go to the instance with a connection at their source.
+ *   Handshakes from elsewhere go to the instance that added the real public
+ *   key in their cookie, and so do DHT public key announcements.
+ * - Group chat handshakes go to the instance that added the receiver's key.
+ *   Other group chat packets go to the instance that last took a handshake
+ *   from their sender.
+ * - Cookie requests go to any instance, as the answer is the same.
+ * Packets that match no instance are dropped. Onion responses don't say whose
+ * they are, so they are still offered to each instance in turn.
+ *
+ * All instances share the DHT key, and so the TCP connection to a peer with a
+ * given DHT key. A remote peer can therefore only be connected to one identity
+ * of a host at a time: the first instance to add a key or a connection address
+ * gets the packets for it.
+ */
+#ifndef C_TOXCORE_TOXCORE_MESSENGER_HOST_H
+#define C_TOXCORE_TOXCORE_MESSENGER_HOST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "DHT.h"
+#include "TCP_connection.h"
+#include "announce.h"
+#include "attributes.h"
+#include "crypto_core.h"
+#include "forwarding.h"
+#include "group_announce.h"
+#include "logger.h"
+#include "mem.h"
+#include "mono_time.h"
+#include "net_crypto.h"
+#include "net_profile.h"
+#include "network.h"
+#include "onion.h"
+#include "onion_announce.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Most packet types a single instance may register handlers for. */
+#define MESSENGER_HOST_MAX_HANDLERS 16
+
+/** @brief Most group chat peers whose instance the host remembers. */
+#define MESSENGER_HOST_SENDER_CACHE_SIZE 4096
+
+typedef struct Messenger_Host_Options {
+    const Logger *_Nonnull log;
+
+    bool ipv6enabled;
+    bool udp_disabled;
+    TCP_Proxy_Info proxy_info;
+    uint16_t port_range[2];
+
+    bool hole_punching_enabled;
+    bool local_discovery_enabled;
+    bool dht_announcements_enabled;
+} Messenger_Host_Options;
+
+typedef enum Messenger_Host_Error {
+    MESSENGER_HOST_ERROR_NONE,
+    MESSENGER_HOST_ERROR_PORT,
+    MESSENGER_HOST_ERROR_OTHER,
+} Messenger_Host_Error;
+
+typedef struct Messenger_Host Messenger_Host;
+
+/** @brief The part of a host that belongs to one instance. */
+typedef struct Host_Instance Host_Instance;
+
+/** @brief Create a host.
+ *
+ * If error is not NULL it is set to one of the values above.
+ */
+Messenger_Host *_Nullable new_messenger_host(const Memory *_Nonnull mem, const Random *_Nonnull rng, const Network *_Nonnull ns,
+        Mono_Time *_Nonnull mono_time, const Messenger_Host_Options *_Nonnull options, Messenger_Host_Error *_Nullable error);
+
+/** @brief Free a host. All its instances must have been detached. */
+void kill_messenger_host(Messenger_Host *_Nullable host);
+
+/** @brief Read the UDP socket and run the DHT and the TCP relay connections.
+ *
+ * Handlers of an instance are called with the userdata set for it with
+ * `host_instance_set_userdata`.
+ */
+void do_messenger_host(Messenger_Host *_Nonnull host);
+
+/** @brief Return the time in ms before `do_messenger_host` should be called again. */
+uint32_t messenger_host_run_interval(const Messenger_Host *_Nonnull host);
+
+/** @brief Return the number of attached instances. */
+uint32_t messenger_host_count(const Messenger_Host *_Nonnull host);
+
+Mono_Time *_Nonnull messenger_host_mono_time(const Messenger_Host *_Nonnull host);
+Networking_Core *_Nonnull messenger_host_net(const Messenger_Host *_Nonnull host);
+DHT *_Nonnull messenger_host_dht(const Messenger_Host *_Nonnull host);
+Net_Profile *_Nonnull messenger_host_tcp_np(const Messenger_Host *_Nonnull host);
+TCP_Connections *_Nonnull messenger_host_tcp_c(const Messenger_Host *_Nonnull host);
+Forwarding *_Nullable messenger_host_forwarding(const Messenger_Host *_Nonnull host);
+Announcements *_Nullable messenger_host_announce(const Messenger_Host *_Nonnull host);
+Onion *_Nonnull messenger_host_onion(const Messenger_Host *_Nonnull host);
+Onion_Announce *_Nonnull messenger_host_onion_a(const Messenger_Host *_Nonnull host);
+GC_Announces_List *_Nonnull messenger_host_group_announce(const Messenger_Host *_Nonnull host);
+bool messenger_host_udp_disabled(const Messenger_Host *_Nonnull host);
+
+/** @brief Return the cookie key every net_crypto on the host must use. */
+const uint8_t *_Nonnull messenger_host_cookie_key(const Messenger_Host *_Nonnull host);
+
+/** @brief Take over the handlers an instance registered since the last attach or detach.
+ *
+ * Call this right after creating the instance's components, with the
+ * net_crypto that was created with `new_net_crypto_shared` on the host's TCP
+ * connections. The instance must not register handlers on the shared
+ * components after that.
+ *
+ * @return the instance, or NULL on failure. The handlers are then unregistered.
+ */
+Host_Instance *_Nullable messenger_host_attach(Messenger_Host *_Nonnull host, Net_Crypto *_Nonnull net_crypto);
+
+/** @brief Stop dispatching packets to an instance.
+ *
+ * Call this after the instance's components were killed.
+ */
+void messenger_host_detach(Messenger_Host *_Nonnull host, Host_Instance *_Nullable instance);
+
+/** @brief Set the userdata the instance's handlers get in `do_messenger_host`. */
+void host_instance_set_userdata(Host_Instance *_Nonnull instance, void *_Nullable userdata);
+
+/** @brief Send the packets that name `public_key` to this instance.
+ *
+ * Instances add the real public keys of the peers they have friend
+ * connections with and their own keys in group chats.
+ *
+ * @retval false if another instance has added the key, or on allocation failure.
+ */
+bool host_instance_add_key(Host_Instance *_Nonnull instance, const uint8_t *_Nonnull public_key);
+
+/** @brief Stop sending the packets that name `public_key` to this instance. */
+void host_instance_remove_key(Host_Instance *_Nonnull instance, const uint8_t *_Nonnull public_key);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* C_TOXCORE_TOXCORE_MESSENGER_HOST_H */
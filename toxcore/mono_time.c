@@ -51,13 +51,14 @@ struct Mono_Time {
     void *_Nullable user_data;
 };
 
-static uint64_t timespec_to_u64(struct timespec clock_mono)
+static uint64_t timespec_to_ns(struct timespec clock_mono)
 {
-    return UINT64_C(1000) * clock_mono.tv_sec + (clock_mono.tv_nsec / UINT64_C(1000000));
+    return UINT64_C(1000000000) * clock_mono.tv_sec + clock_mono.tv_nsec;
 }
 
+/** @brief The system's monotonic clock in nanoseconds. */
 #ifdef OS_WIN32
-static uint64_t current_time_monotonic_default(void *_Nonnull user_data)
+static uint64_t clock_monotonic_ns(void)
 {
     LARGE_INTEGER freq;
     LARGE_INTEGER count;
@@ -74,11 +75,11 @@ static uint64_t current_time_monotonic_default(void *_Nonnull user_data)
     } else {
         sp.tv_nsec = (long)((count.QuadPart % freq.QuadPart) * (1000000000.0 / freq.QuadPart));
     }
-    return timespec_to_u64(sp);
+    return timespec_to_ns(sp);
 }
 #else
 #ifdef __APPLE__
-static uint64_t current_time_monotonic_default(void *_Nonnull user_data)
+static uint64_t clock_monotonic_ns(void)
 {
     struct timespec clock_mono;
     clock_serv_t muhclock;
@@ -90,22 +91,27 @@ static uint64_t current_time_monotonic_default(void *_Nonnull user_data)
 
     clock_mono.tv_sec = machtime.tv_sec;
     clock_mono.tv_nsec = machtime.tv_nsec;
-    return timespec_to_u64(clock_mono);
+    return timespec_to_ns(clock_mono);
 }
 #else // !__APPLE__
+static uint64_t clock_monotonic_ns(void)
+{
+    struct timespec clock_mono;
+    clock_gettime(CLOCK_MONOTONIC, &clock_mono);
+    return timespec_to_ns(clock_mono);
+}
+#endif /* !__APPLE__ */
+#endif /* !OS_WIN32 */
+
 static uint64_t current_time_monotonic_default(void *_Nonnull user_data)
 {
-#ifdef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
+#if defined(FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION) && !defined(OS_WIN32) && !defined(__APPLE__)
     // This assert should always fail. If it does, the fuzzing harness didn't
     // override the mono time callback.
     assert(user_data == nullptr);
 #endif /* FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION */
-    struct timespec clock_mono;
-    clock_gettime(CLOCK_MONOTONIC, &clock_mono);
-    return timespec_to_u64(clock_mono);
+    return clock_monotonic_ns() / UINT64_C(1000000);
 }
-#endif /* !__APPLE__ */
-#endif /* !OS_WIN32 */
 
 Mono_Time *mono_time_new(const Memory *mem, mono_time_current_time_cb *current_time_callback, void *user_data)
 {
@@ -219,3 +225,12 @@ uint64_t current_time_monotonic(const Mono_Time *mono_time)
 {
     return mono_time->current_time_callback(mono_time->user_data);
 }
+
+uint64_t current_time_monotonic_ns(const Mono_Time *mono_time)
+{
+    if (mono_time->current_time_callback == current_time_monotonic_default) {
+        return clock_monotonic_ns();
+    }
+
+    return current_time_monotonic(mono_time) * UINT64_C(1000000);
+}
@@ -80,6 +80,14 @@ bool mono_time_is_timeout(const Mono_Time *_Nonnull mono_time, uint64_t timestam
  */
 uint64_t current_time_monotonic(const Mono_Time *_Nonnull mono_time);
 
+/** @brief Return current monotonic time in nanoseconds (ns).
+ *
+ * The same clock as `current_time_monotonic()`, at the full resolution of the
+ * system clock. With an overridden time callback, this is the callback's time
+ * in whole milliseconds.
+ */
+uint64_t current_time_monotonic_ns(const Mono_Time *_Nonnull mono_time);
+
 /**
  * Override implementation of `current_time_monotonic()` (for tests).
  *
@@ -0,0 +1,284 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include "mpsc_queue.h"
+
+#include <string.h>
+
+#include "ccompat.h"
+
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_ATOMICS__)
+#define MPSC_QUEUE_LOCK_FREE 1
+#include <stdatomic.h>
+#else
+#include <pthread.h>
+#endif /* __STDC_NO_ATOMICS__ */
+
+typedef struct Mpsc_Node Mpsc_Node;
+
+/** The message bytes follow the node header in the same allocation. */
+struct Mpsc_Node {
+#ifdef MPSC_QUEUE_LOCK_FREE
+    _Atomic(Mpsc_Node *) next;
+#else
+    Mpsc_Node *next;
+#endif /* MPSC_QUEUE_LOCK_FREE */
+    uint16_t length;
+};
+
+struct Mpsc_Queue {
+    const Memory *_Nonnull mem;
+
+    mpsc_queue_wake_cb *_Nullable wake_callback;
+    void *_Nullable wake_object;
+
+#ifdef MPSC_QUEUE_LOCK_FREE
+    /* Most recently pushed node. Producers swap themselves in here. */
+    _Atomic(Mpsc_Node *) head;
+    /* Next node to pop. Only touched by the consumer. */
+    Mpsc_Node *_Nonnull tail;
+    /* Placeholder node that keeps the list non-empty. */
+    Mpsc_Node stub;
+    /* Messages pushed but not yet popped. Incremented before a node is linked
+     * in, so it is never lower than the number of reachable nodes. */
+    atomic_uint_fast32_t size;
+#else
+    pthread_mutex_t lock;
+    Mpsc_Node *_Nullable first;
+    Mpsc_Node *_Nullable last;
+    uint32_t size;
+#endif /* MPSC_QUEUE_LOCK_FREE */
+};
+
+static uint8_t *mpsc_node_data(Mpsc_Node *_Nonnull node)
+{
+    return (uint8_t *)(node + 1);
+}
+
+#ifdef MPSC_QUEUE_LOCK_FREE
+static void mpsc_push_node(Mpsc_Queue *_Nonnull queue, Mpsc_Node *_Nonnull node)
+{
+    atomic_store_explicit(&node->next, nullptr, memory_order_relaxed);
+    Mpsc_Node *prev = atomic_exchange_explicit(&queue->head, node, memory_order_acq_rel);
+    /* Between the exchange and this store, the list is cut at `prev`, and the
+     * consumer sees the queue as empty. */
+    atomic_store_explicit(&prev->next, node, memory_order_release);
+}
+
+static Mpsc_Node *mpsc_pop_node(Mpsc_Queue *_Nonnull queue)
+{
+    Mpsc_Node *tail = queue->tail;
+    Mpsc_Node *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+    if (tail == &queue->stub) {
+        if (next == nullptr) {
+            return nullptr;
+        }
+
+        queue->tail = next;
+        tail = next;
+        next = atomic_load_explicit(&next->next, memory_order_acquire);
+    }
+
+    if (next != nullptr) {
+        queue->tail = next;
+        return tail;
+    }
+
+    if (tail != atomic_load_explicit(&queue->head, memory_order_acquire)) {
+        /* A producer has swapped in a new head but not linked it yet. */
+        return nullptr;
+    }
+
+    /* `tail` is the last node. Push the stub behind it so it can be unlinked. */
+    mpsc_push_node(queue, &queue->stub);
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+    if (next != nullptr) {
+        queue->tail = next;
+        return tail;
+    }
+
+    return nullptr;
+}
+#endif /* MPSC_QUEUE_LOCK_FREE */
+
+Mpsc_Queue *mpsc_queue_new(const Memory *mem, mpsc_queue_wake_cb *wake_callback, void *wake_object)
+{
+    Mpsc_Queue *queue = (Mpsc_Queue *)mem_alloc(mem, sizeof(Mpsc_Queue));
+
+    if (queue == nullptr) {
+        return nullptr;
+    }
+
+    queue->mem = mem;
+    queue->wake_callback = wake_callback;
+    queue->wake_object = wake_object;
+
+#ifdef MPSC_QUEUE_LOCK_FREE
+    atomic_init(&queue->stub.next, nullptr);
+    atomic_init(&queue->head, &queue->stub);
+    atomic_init(&queue->size, 0);
+    queue->tail = &queue->stub;
+#else
+
+    if (pthread_mutex_init(&queue->lock, nullptr) != 0) {
+        mem_delete(mem, queue);
+        return nullptr;
+    }
+
+#endif /* MPSC_QUEUE_LOCK_FREE */
+
+    return queue;
+}
+
+void mpsc_queue_kill(Mpsc_Queue *queue)
+{
+    if (queue == nullptr) {
+        return;
+    }
+
+#ifdef MPSC_QUEUE_LOCK_FREE
+    Mpsc_Node *node;
+
+    while ((node = mpsc_pop_node(queue)) != nullptr) {
+        mem_delete(queue->mem, node);
+    }
+
+#else
+    Mpsc_Node *node = queue->first;
+
+    while (node != nullptr) {
+        Mpsc_Node *next = node->next;
+        mem_delete(queue->mem, node);
+        node = next;
+    }
+
+    pthread_mutex_destroy(&queue->lock);
+#endif /* MPSC_QUEUE_LOCK_FREE */
+
+    mem_delete(queue->mem, queue);
+}
+
+bool mpsc_queue_push(Mpsc_Queue *queue, const uint8_t *data, uint16_t length)
+{
+    return mpsc_queue_push_bounded(queue, data, length, UINT32_MAX);
+}
+
+bool mpsc_queue_push_bounded(Mpsc_Queue *queue, const uint8_t *data, uint16_t length, uint32_t max_size)
+{
+#ifdef MPSC_QUEUE_LOCK_FREE
+    /* Reserve a place before allocating, so concurrent producers can't
+     * overshoot `max_size`. */
+    const uint_fast32_t old_size = atomic_fetch_add_explicit(&queue->size, 1, memory_order_acq_rel);
+
+    if (old_size >= max_size) {
+        atomic_fetch_sub_explicit(&queue->size, 1, memory_order_acq_rel);
+        return false;
+    }
+
+#endif /* MPSC_QUEUE_LOCK_FREE */
+
+    Mpsc_Node *node = (Mpsc_Node *)mem_balloc(queue->mem, sizeof(Mpsc_Node) + length);
+
+    if (node == nullptr) {
+#ifdef MPSC_QUEUE_LOCK_FREE
+        atomic_fetch_sub_explicit(&queue->size, 1, memory_order_acq_rel);
+#endif /* MPSC_QUEUE_LOCK_FREE */
+        return false;
+    }
+
+    node->length = length;
+    memcpy(mpsc_node_data(node), data, length);
+
+#ifdef MPSC_QUEUE_LOCK_FREE
+    const bool was_empty = old_size == 0;
+    mpsc_push_node(queue, node);
+#else
+    node->next = nullptr;
+
+    pthread_mutex_lock(&queue->lock);
+
+    if (queue->size >= max_size) {
+        pthread_mutex_unlock(&queue->lock);
+        mem_delete(queue->mem, node);
+        return false;
+    }
+
+    if (queue->last == nullptr) {
+        queue->first = node;
+    } else {
+        queue->last->next = node;
+    }
+
+    queue->last = node;
+    const bool was_empty = queue->size == 0;
+    ++queue->size;
+
+    pthread_mutex_unlock(&queue->lock);
+#endif /* MPSC_QUEUE_LOCK_FREE */
+
+    if (was_empty && queue->wake_callback != nullptr) {
+        queue->wake_callback(queue->wake_object);
+    }
+
+    return true;
+}
+
+int mpsc_queue_pop(Mpsc_Queue *queue, uint8_t *data, uint16_t max_length)
+{
+    while (true) {
+#ifdef MPSC_QUEUE_LOCK_FREE
+        Mpsc_Node *node = mpsc_pop_node(queue);
+
+        if (node == nullptr) {
+            return -1;
+        }
+
+        atomic_fetch_sub_explicit(&queue->size, 1, memory_order_acq_rel);
+#else
+        pthread_mutex_lock(&queue->lock);
+        Mpsc_Node *node = queue->first;
+
+        if (node != nullptr) {
+            queue->first = node->next;
+
+            if (queue->first == nullptr) {
+                queue->last = nullptr;
+            }
+
+            --queue->size;
+        }
+
+        pthread_mutex_unlock(&queue->lock);
+
+        if (node == nullptr) {
+            return -1;
+        }
+
+#endif /* MPSC_QUEUE_LOCK_FREE */
+
+        const uint16_t length = node->length;
+
+        if (length <= max_length) {
+            memcpy(data, mpsc_node_data(node), length);
+            mem_delete(queue->mem, node);
+            return length;
+        }
+
+        mem_delete(queue->mem, node);
+    }
+}
+
+bool mpsc_queue_empty(Mpsc_Queue *queue)
+{
+#ifdef MPSC_QUEUE_LOCK_FREE
+    return atomic_load_explicit(&queue->size, memory_order_acquire) == 0;
+#else
+    pthread_mutex_lock(&queue->lock);
+    const bool empty = queue->size == 0;
+    pthread_mutex_unlock(&queue->lock);
+    return empty;
+#endif /* MPSC_QUEUE_LOCK_FREE */
+}
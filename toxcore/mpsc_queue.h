@@ -0,0 +1,87 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+/**
+ * Multi-producer single-consumer message queue.
+ *
+ * Any thread may push messages, but only one thread at a time may pop them.
+ * Messages are copied into the queue on push and out of it on pop, so the
+ * caller never shares memory with another thread.
+ *
+ * With C11 atomics this is an intrusive lock-free linked list (Dmitry Vyukov's
+ * MPSC queue): a push is one atomic exchange and never waits for the consumer
+ * or for other producers. Without atomics it falls back to a mutex.
+ */
+#ifndef C_TOXCORE_TOXCORE_MPSC_QUEUE_H
+#define C_TOXCORE_TOXCORE_MPSC_QUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "attributes.h"
+#include "mem.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct Mpsc_Queue Mpsc_Queue;
+
+/** @brief Called by a producer when its push made the queue non-empty.
+ *
+ * Used to wake up the consumer, e.g. by writing to an eventfd. Called from the
+ * producer's thread.
+ */
+typedef void mpsc_queue_wake_cb(void *_Nullable object);
+
+/** @brief Create a new, empty queue.
+ *
+ * @param wake_callback Optional callback to wake up the consumer.
+ */
+Mpsc_Queue *_Nullable mpsc_queue_new(const Memory *_Nonnull mem, mpsc_queue_wake_cb *_Nullable wake_callback, void *_Nullable wake_object);
+
+/** @brief Free the queue and all messages still in it.
+ *
+ * No other thread may use the queue any more.
+ */
+void mpsc_queue_kill(Mpsc_Queue *_Nullable queue);
+
+/** @brief Append a copy of `data` to the queue. Safe to call from any thread.
+ *
+ * @retval true on success.
+ * @retval false if memory allocation failed. The message is dropped.
+ */
+bool mpsc_queue_push(Mpsc_Queue *_Nonnull queue, const uint8_t *_Nonnull data, uint16_t length);
+
+/** @brief Like `mpsc_queue_push`, but refuse the message if the queue already
+ * holds `max_size` messages. Safe to call from any thread.
+ *
+ * @retval true on success.
+ * @retval false if the queue is full or memory allocation failed. The message
+ *   is dropped.
+ */
+bool mpsc_queue_push_bounded(Mpsc_Queue *_Nonnull queue, const uint8_t *_Nonnull data, uint16_t length, uint32_t max_size);
+
+/** @brief Take the oldest message out of the queue. Consumer thread only.
+ *
+ * Messages longer than `max_length` are dropped.
+ *
+ * @return the length of the message copied into `data`.
+ * @retval -1 if the queue is empty, or a message is still being pushed.
+ */
+int mpsc_queue_pop(Mpsc_Queue *_Nonnull queue, uint8_t *_Nonnull data, uint16_t max_length);
+
+/** @brief Whether there are no pushed messages left to pop.
+ *
+ * If this returns false after `mpsc_queue_pop` returned -1, a producer is in
+ * the middle of a push and the consumer should try again soon rather than go
+ * to sleep.
+ */
+bool mpsc_queue_empty(Mpsc_Queue *_Nonnull queue);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* C_TOXCORE_TOXCORE_MPSC_QUEUE_H */
@@ -0,0 +1,174 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include "mpsc_queue.h"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "os_memory.h"
+
+namespace {
+
+class MpscQueueTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        queue = mpsc_queue_new(
+            os_memory(), [](void *obj) { ++*static_cast<std::atomic<int> *>(obj); }, &wakeups);
+        ASSERT_NE(queue, nullptr);
+    }
+
+    void TearDown() override { mpsc_queue_kill(queue); }
+
+    bool push_u32(std::uint32_t value)
+    {
+        std::uint8_t data[sizeof(value)];
+        std::memcpy(data, &value, sizeof(value));
+        return mpsc_queue_push(queue, data, sizeof(data));
+    }
+
+    int pop_u32(std::uint32_t *value)
+    {
+        std::uint8_t data[sizeof(*value)];
+        const int len = mpsc_queue_pop(queue, data, sizeof(data));
+        if (len == sizeof(*value)) {
+            std::memcpy(value, data, sizeof(*value));
+        }
+        return len;
+    }
+
+    Mpsc_Queue *queue = nullptr;
+    std::atomic<int> wakeups{0};
+};
+
+TEST_F(MpscQueueTest, EmptyQueuePopsNothing)
+{
+    std::uint32_t value;
+    EXPECT_TRUE(mpsc_queue_empty(queue));
+    EXPECT_EQ(pop_u32(&value), -1);
+    EXPECT_EQ(wakeups, 0);
+}
+
+TEST_F(MpscQueueTest, PopsInPushOrder)
+{
+    for (std::uint32_t i = 0; i < 100; ++i) {
+        ASSERT_TRUE(push_u32(i));
+    }
+
+    EXPECT_FALSE(mpsc_queue_empty(queue));
+
+    for (std::uint32_t i = 0; i < 100; ++i) {
+        std::uint32_t value;
+        ASSERT_EQ(pop_u32(&value), sizeof(value));
+        EXPECT_EQ(value, i);
+    }
+
+    std::uint32_t value;
+    EXPECT_EQ(pop_u32(&value), -1);
+    EXPECT_TRUE(mpsc_queue_empty(queue));
+}
+
+TEST_F(MpscQueueTest, WakesOnlyWhenQueueBecomesNonEmpty)
+{
+    ASSERT_TRUE(push_u32(1));
+    ASSERT_TRUE(push_u32(2));
+    EXPECT_EQ(wakeups, 1);
+
+    std::uint32_t value;
+    ASSERT_EQ(pop_u32(&value), sizeof(value));
+    ASSERT_EQ(pop_u32(&value), sizeof(value));
+
+    ASSERT_TRUE(push_u32(3));
+    EXPECT_EQ(wakeups, 2);
+}
+
+TEST_F(MpscQueueTest, KeepsEmptyMessages)
+{
+    const std::uint8_t unused = 0;
+    ASSERT_TRUE(mpsc_queue_push(queue, &unused, 0));
+
+    std::uint8_t data[4];
+    EXPECT_EQ(mpsc_queue_pop(queue, data, sizeof(data)), 0);
+    EXPECT_TRUE(mpsc_queue_empty(queue));
+}
+
+TEST_F(MpscQueueTest, DropsMessagesTooLargeForBuffer)
+{
+    const std::array<std::uint8_t, 16> large{};
+    ASSERT_TRUE(mpsc_queue_push(queue, large.data(), large.size()));
+    ASSERT_TRUE(push_u32(42));
+
+    std::uint32_t value;
+    ASSERT_EQ(pop_u32(&value), sizeof(value));
+    EXPECT_EQ(value, 42);
+}
+
+TEST_F(MpscQueueTest, BoundedPushRefusesWhenFull)
+{
+    const std::uint8_t data[1] = {0};
+    ASSERT_TRUE(mpsc_queue_push_bounded(queue, data, sizeof(data), 2));
+    ASSERT_TRUE(mpsc_queue_push_bounded(queue, data, sizeof(data), 2));
+    EXPECT_FALSE(mpsc_queue_push_bounded(queue, data, sizeof(data), 2));
+
+    std::uint8_t out[1];
+    ASSERT_EQ(mpsc_queue_pop(queue, out, sizeof(out)), 1);
+    EXPECT_TRUE(mpsc_queue_push_bounded(queue, data, sizeof(data), 2));
+    EXPECT_EQ(wakeups, 1);
+}
+
+TEST_F(MpscQueueTest, FreesUnpoppedMessagesOnKill)
+{
+    for (std::uint32_t i = 0; i < 10; ++i) {
+        ASSERT_TRUE(push_u32(i));
+    }
+    // TearDown kills the queue; leak checkers catch unfreed nodes.
+}
+
+TEST_F(MpscQueueTest, ConcurrentProducersPreservePerProducerOrder)
+{
+    constexpr std::uint32_t kProducers = 4;
+    constexpr std::uint32_t kPerProducer = 20000;
+
+    std::vector<std::thread> producers;
+    for (std::uint32_t p = 0; p < kProducers; ++p) {
+        producers.emplace_back([this, p]() {
+            for (std::uint32_t i = 0; i < kPerProducer; ++i) {
+                while (!push_u32(p << 24 | i)) {
+                }
+            }
+        });
+    }
+
+    std::array<std::uint32_t, kProducers> next{};
+    std::uint32_t received = 0;
+
+    while (received < kProducers * kPerProducer) {
+        std::uint32_t value;
+        if (pop_u32(&value) == -1) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        const std::uint32_t producer = value >> 24;
+        ASSERT_LT(producer, kProducers);
+        ASSERT_EQ(value & 0xFFFFFF, next[producer]);
+        ++next[producer];
+        ++received;
+    }
+
+    for (std::thread &producer : producers) {
+        producer.join();
+    }
+
+    EXPECT_TRUE(mpsc_queue_empty(queue));
+}
+
+}  // namespace
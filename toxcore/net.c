@@ -5,6 +5,10 @@
 
 #include "net.h"
 
+#include <limits.h>
+
+#include "ccompat.h"
+
 int net_socket_to_native(Socket sock)
 {
     return (force int)sock.value;
@@ -96,6 +100,83 @@ int ns_freeaddrinfo(const Network *ns, const Memory *mem, IP_Port *addrs)
     return ns->funcs->freeaddrinfo(ns->obj, mem, addrs);
 }
 
+int ns_recvmmsg(const Network *ns, Socket sock, Net_Recv_Msg *msgs, size_t count)
+{
+    if (count > INT_MAX) {
+        count = INT_MAX;
+    }
+
+    if (ns->funcs->recvmmsg != nullptr) {
+        return ns->funcs->recvmmsg(ns->obj, sock, msgs, count);
+    }
+
+    size_t received = 0;
+
+    while (received < count) {
+        Net_Recv_Msg *const msg = &msgs[received];
+        const int len = ns->funcs->recvfrom(ns->obj, sock, msg->buf, msg->size, &msg->addr);
+
+        if (len < 0) {
+            break;
+        }
+
+        msg->length = (size_t)len;
+        ++received;
+    }
+
+    return received == 0 && count != 0 ? -1 : (int)received;
+}
+
+int ns_sendmmsg(const Network *ns, Socket sock, const Net_Send_Msg *msgs, size_t count)
+{
+    if (count > INT_MAX) {
+        count = INT_MAX;
+    }
+
+    if (ns->funcs->sendmmsg != nullptr) {
+        return ns->funcs->sendmmsg(ns->obj, sock, msgs, count);
+    }
+
+    size_t sent = 0;
+
+    while (sent < count) {
+        const Net_Send_Msg *const msg = &msgs[sent];
+
+        if (ns->funcs->sendto(ns->obj, sock, msg->buf, msg->length, &msg->addr) < 0) {
+            break;
+        }
+
+        ++sent;
+    }
+
+    return sent == 0 && count != 0 ? -1 : (int)sent;
+}
+
+int ns_sendv(const Network *ns, Socket sock, const Net_Send_Vec *vecs, size_t count)
+{
+    if (ns->funcs->sendv != nullptr) {
+        return ns->funcs->sendv(ns->obj, sock, vecs, count);
+    }
+
+    int total = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        const int ret = ns->funcs->send(ns->obj, sock, vecs[i].buf, vecs[i].length);
+
+        if (ret < 0) {
+            return total == 0 ? -1 : total;
+        }
+
+        total += ret;
+
+        if ((size_t)ret != vecs[i].length) {
+            break;
+        }
+    }
+
+    return total;
+}
+
 size_t net_pack_bool(uint8_t *bytes, bool v)
 {
     bytes[0] = v ? 1 : 0;
@@ -100,6 +100,57 @@ typedef int net_setsockopt_cb(void *_Nullable obj, Socket sock, int level, int o
 typedef int net_getaddrinfo_cb(void *_Nullable obj, const Memory *_Nonnull mem, const char *_Nonnull address, int family, int protocol, IP_Port *_Nullable *_Nonnull addrs);
 typedef int net_freeaddrinfo_cb(void *_Nullable obj, const Memory *_Nonnull mem, IP_Port *_Nullable addrs);
 
+/**
+ * @brief One datagram slot for a batched receive.
+ *
+ * The caller provides `buf` and `size`; the implementation fills in `length`
+ * and `addr`. A `length` of 0 means the slot was consumed but the datagram
+ * was dropped (e.g. because of an unsupported address family).
+ */
+typedef struct Net_Recv_Msg {
+    uint8_t *_Nonnull buf;
+    size_t size;
+    size_t length;
+    IP_Port addr;
+} Net_Recv_Msg;
+
+/** @brief One datagram for a batched send. */
+typedef struct Net_Send_Msg {
+    const uint8_t *_Nonnull buf;
+    size_t length;
+    IP_Port addr;
+} Net_Send_Msg;
+
+/**
+ * @brief Receive up to `count` datagrams in one call.
+ *
+ * @return the number of slots filled (which may be less than `count`), or -1
+ *   if nothing could be received.
+ */
+typedef int net_recvmmsg_cb(void *_Nullable obj, Socket sock, Net_Recv_Msg *_Nonnull msgs, size_t count);
+/**
+ * @brief Send up to `count` datagrams in one call.
+ *
+ * @return the number of leading messages that were sent (which may be less
+ *   than `count`), or -1 if the first message could not be sent.
+ */
+typedef int net_sendmmsg_cb(void *_Nullable obj, Socket sock, const Net_Send_Msg *_Nonnull msgs, size_t count);
+
+/** @brief One piece of a vectored stream send. */
+typedef struct Net_Send_Vec {
+    const uint8_t *_Nonnull buf;
+    size_t length;
+} Net_Send_Vec;
+
+/**
+ * @brief Send the concatenation of `count` buffers on a stream socket in one
+ *   call (writev).
+ *
+ * @return the number of bytes sent (which may end in the middle of a buffer),
+ *   or -1 if nothing could be sent.
+ */
+typedef int net_sendv_cb(void *_Nullable obj, Socket sock, const Net_Send_Vec *_Nonnull vecs, size_t count);
+
 typedef struct Network_Funcs {
     net_close_cb *_Nullable close;
     net_accept_cb *_Nullable accept;
@@ -117,6 +168,13 @@ typedef struct Network_Funcs {
     net_setsockopt_cb *_Nullable setsockopt;
     net_getaddrinfo_cb *_Nullable getaddrinfo;
     net_freeaddrinfo_cb *_Nullable freeaddrinfo;
+    /* Optional batch operations. If null, `ns_recvmmsg` and `ns_sendmmsg`
+     * fall back to one `recvfrom`/`sendto` per datagram. */
+    net_recvmmsg_cb *_Nullable recvmmsg;
+    net_sendmmsg_cb *_Nullable sendmmsg;
+    /* Optional vectored stream send. If null, `ns_sendv` falls back to one
+     * `send` per buffer. */
+    net_sendv_cb *_Nullable sendv;
 } Network_Funcs;
 
 typedef struct Network {
@@ -140,6 +198,9 @@ int ns_getsockopt(const Network *_Nonnull ns, Socket sock, int level, int optnam
 int ns_setsockopt(const Network *_Nonnull ns, Socket sock, int level, int optname, const void *_Nonnull optval, size_t optlen);
 int ns_getaddrinfo(const Network *_Nonnull ns, const Memory *_Nonnull mem, const char *_Nonnull address, int family, int protocol, IP_Port *_Nullable *_Nonnull addrs);
 int ns_freeaddrinfo(const Network *_Nonnull ns, const Memory *_Nonnull mem, IP_Port *_Nullable addrs);
+int ns_recvmmsg(const Network *_Nonnull ns, Socket sock, Net_Recv_Msg *_Nonnull msgs, size_t count);
+int ns_sendmmsg(const Network *_Nonnull ns, Socket sock, const Net_Send_Msg *_Nonnull msgs, size_t count);
+int ns_sendv(const Network *_Nonnull ns, Socket sock, const Net_Send_Vec *_Nonnull vecs, size_t count);
 
 bool net_family_is_unspec(Family family);
 bool net_family_is_ipv4(Family family);
@@ -220,6 +281,7 @@ bool net_join_multicast(const Network *_Nonnull ns, Socket sock, Family family);
 bool net_set_socket_nonblock(const Network *_Nonnull ns, Socket sock);
 bool net_set_socket_nosigpipe(const Network *_Nonnull ns, Socket sock);
 bool net_set_socket_reuseaddr(const Network *_Nonnull ns, Socket sock);
+bool net_set_socket_reuseport(const Network *_Nonnull ns, Socket sock);
 bool net_set_socket_dualstack(const Network *_Nonnull ns, Socket sock);
 bool net_set_socket_buffer_size(const Network *_Nonnull ns, Socket sock, int size);
 bool net_set_socket_broadcast(const Network *_Nonnull ns, Socket sock);
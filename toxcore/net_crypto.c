@@ -10,22 +10,26 @@
  */
 #include "net_crypto.h"
 
+#include <assert.h>
 #include <pthread.h>
 #include <string.h>
 
 #include "DHT.h" // Node_format
+#include "congestion_control.h"
 #include "LAN_discovery.h"
 #include "TCP_client.h"
 #include "TCP_connection.h"
 #include "attributes.h"
 #include "ccompat.h"
 #include "crypto_core.h"
+#include "decrypt_pool.h"
 #include "list.h"
 #include "logger.h"
 #include "mem.h"
 #include "mono_time.h"
 #include "net_profile.h"
 #include "network.h"
+#include "pk_index.h"
 #include "util.h"
 
 typedef struct Packet_Data {
@@ -34,12 +38,46 @@ typedef struct Packet_Data {
     uint8_t data[MAX_CRYPTO_DATA_SIZE];
 } Packet_Data;
 
+/** Number of slots a Packets_Array allocates when the first packet is stored. */
+#define PACKETS_ARRAY_MIN_SIZE 16
+
+/**
+ * Ring of packet slots indexed by `packet_number % capacity`.
+ *
+ * The slot table grows with the number of packets in flight (up to
+ * CRYPTO_PACKET_BUFFER_SIZE) and shrinks again once the window drains, so idle
+ * connections only pay for PACKETS_ARRAY_MIN_SIZE pointers. Only packet numbers
+ * in `{buffer_start, buffer_start + capacity)` can have data; the rest of the
+ * window up to buffer_end (see set_buffer_end) is treated as empty.
+ *
+ * `present` has one bit per slot, set when the slot holds a packet, so the
+ * request code can skip over runs of full or empty slots 64 at a time.
+ */
 typedef struct Packets_Array {
-    Packet_Data *_Nullable buffer[CRYPTO_PACKET_BUFFER_SIZE];
+    Packet_Data *_Nullable *_Nullable buffer;
+    uint64_t *_Nullable present;
+    uint32_t  capacity; /* 0 or a power of 2, at most CRYPTO_PACKET_BUFFER_SIZE */
     uint32_t  buffer_start;
     uint32_t  buffer_end; /* packet numbers in array: `{buffer_start, buffer_end)` */
 } Packets_Array;
 
+/** Maximum number of released Packet_Data objects kept around for reuse. */
+#define PACKET_POOL_MAX_FREE 256
+
+/**
+ * Per-Net_Crypto pool of Packet_Data objects shared by all connections.
+ *
+ * Queued packets are taken from and returned to this pool, so steady-state
+ * traffic doesn't hit the allocator for every packet. At most
+ * PACKET_POOL_MAX_FREE unused objects are retained; the rest go back to the
+ * allocator so memory is released after a burst.
+ */
+typedef struct Packet_Pool {
+    const Memory *_Nonnull mem;
+    Packet_Data *_Nullable free_list[PACKET_POOL_MAX_FREE];
+    uint32_t free_count;
+} Packet_Pool;
+
 typedef enum Crypto_Conn_State {
     /* the connection slot is free. This value is 0 so it is valid after
      * `crypto_memzero(...)` of the parent struct
@@ -100,24 +138,29 @@ typedef struct Crypto_Connection {
     double packet_recv_rate;
     uint64_t packet_counter_set;
 
-    double packet_send_rate;
+    Congestion_State congestion;
+
     uint32_t packets_left;
     uint64_t last_packets_left_set;
     double last_packets_left_rem;
 
-    double packet_send_rate_requested;
     uint32_t packets_left_requested;
     uint64_t last_packets_left_requested_set;
     double last_packets_left_requested_rem;
 
-    uint32_t last_sendqueue_size[CONGESTION_QUEUE_ARRAY_SIZE];
-    uint32_t last_sendqueue_counter;
-    long signed int last_num_packets_sent[CONGESTION_LAST_SENT_ARRAY_SIZE];
-    long signed int last_num_packets_resent[CONGESTION_LAST_SENT_ARRAY_SIZE];
+    /* With pacing: when the send budget gets its next packet. */
+    uint64_t next_send_time;
+
     uint32_t packets_sent;
     uint32_t packets_resent;
     uint64_t last_congestion_event;
     uint64_t rtt_time;
+    uint64_t rtt_recent; /* Lowest RTT measured since the last congestion control update, 0 if none. */
+
+    /* The peer sent us a PACKET_ID_REQUEST_SACK, so it understands them. */
+    bool peer_sack;
+    /* SACK requests sent alongside classic ones while peer_sack is unknown. */
+    uint8_t sack_probes_sent;
 
     /* TCP_connection connection_number */
     unsigned int connection_number_tcp;
@@ -131,6 +174,8 @@ typedef struct Crypto_Connection {
 
 static const Crypto_Connection empty_crypto_connection = {{0}};
 
+typedef struct Crypto_Data_Batch Crypto_Data_Batch;
+
 struct Net_Crypto {
     const Logger *_Nonnull log;
     const Memory *_Nonnull mem;
@@ -143,10 +188,33 @@ struct Net_Crypto {
     const Net_Crypto_DHT_Funcs *_Nonnull dht_funcs;
 
     TCP_Connections *_Nonnull tcp_c;
+    /* False if tcp_c is shared with other instances and run by its owner. */
+    bool owns_tcp_c;
+    /* Object for the TCP data callback of our connections, if not this instance. */
+    void *_Nullable tcp_object;
+    /* Told about the addresses in ip_port_list, if the socket is shared. */
+    nc_ip_port_cb *_Nullable ip_port_callback;
+    void *_Nullable ip_port_callback_object;
+
+    Packet_Pool *_Nonnull packet_pool;
+
+    /* Picks the send rate of every connection. */
+    const Congestion_Control *_Nonnull congestion_control;
+
+    /* Offer PACKET_ID_REQUEST_SACK to peers and use it with those that answer. */
+    bool sack_requests;
+
+    /* Hand out send budget in small steps and wake up when it is due. */
+    bool pacing;
 
     Crypto_Connection *_Nullable crypto_connections;
 
     uint32_t crypto_connections_length; /* Length of connections array. */
+    /* No connection below this index is free. */
+    uint32_t crypto_connections_free_hint;
+
+    /* Maps the real public key of each allocated connection to its id. */
+    PK_Index *_Nonnull connections_by_pk;
 
     /* Our public and secret keys. */
     uint8_t self_public_key[CRYPTO_PUBLIC_KEY_SIZE];
@@ -166,6 +234,11 @@ struct Net_Crypto {
     /* Rate limiter for cookie requests */
     uint64_t cookie_request_last_time;
     uint32_t cookie_request_tokens;
+
+    /* Data packets from the UDP socket waiting to be decrypted together.
+     * Both are null unless batched decryption is enabled. */
+    Crypto_Data_Batch *_Nullable data_batch;
+    Decrypt_Pool *_Nullable decrypt_pool;
 };
 
 const uint8_t *nc_get_self_public_key(const Net_Crypto *c)
@@ -601,6 +674,30 @@ static Crypto_Connection *_Nullable get_crypto_connection(const Net_Crypto *_Non
     return &c->crypto_connections[crypt_connection_id];
 }
 
+static bool ip_port_list_add(Net_Crypto *_Nonnull c, const IP_Port *_Nonnull ip_port, int crypt_connection_id)
+{
+    if (!bs_list_add(&c->ip_port_list, (const uint8_t *)ip_port, crypt_connection_id)) {
+        return false;
+    }
+
+    if (c->ip_port_callback != nullptr) {
+        c->ip_port_callback(c->ip_port_callback_object, ip_port, true);
+    }
+
+    return true;
+}
+
+static void ip_port_list_remove(Net_Crypto *_Nonnull c, const IP_Port *_Nonnull ip_port, int crypt_connection_id)
+{
+    if (!bs_list_remove(&c->ip_port_list, (const uint8_t *)ip_port, crypt_connection_id)) {
+        return;
+    }
+
+    if (c->ip_port_callback != nullptr) {
+        c->ip_port_callback(c->ip_port_callback_object, ip_port, false);
+    }
+}
+
 /** @brief Associate an ip_port to a connection.
  *
  * @retval -1 on failure.
@@ -616,21 +713,21 @@ static int add_ip_port_connection(Net_Crypto *_Nonnull c, int crypt_connection_i
 
     if (net_family_is_ipv4(ip_port->ip.family)) {
         if (!ipport_equal(ip_port, &conn->ip_portv4) && !ip_is_lan(&conn->ip_portv4.ip)) {
-            if (!bs_list_add(&c->ip_port_list, (const uint8_t *)ip_port, crypt_connection_id)) {
+            if (!ip_port_list_add(c, ip_port, crypt_connection_id)) {
                 return -1;
             }
 
-            bs_list_remove(&c->ip_port_list, (uint8_t *)&conn->ip_portv4, crypt_connection_id);
+            ip_port_list_remove(c, &conn->ip_portv4, crypt_connection_id);
             conn->ip_portv4 = *ip_port;
             return 0;
         }
     } else if (net_family_is_ipv6(ip_port->ip.family)) {
         if (!ipport_equal(ip_port, &conn->ip_portv6)) {
-            if (!bs_list_add(&c->ip_port_list, (const uint8_t *)ip_port, crypt_connection_id)) {
+            if (!ip_port_list_add(c, ip_port, crypt_connection_id)) {
                 return -1;
             }
 
-            bs_list_remove(&c->ip_port_list, (uint8_t *)&conn->ip_portv6, crypt_connection_id);
+            ip_port_list_remove(c, &conn->ip_portv6, crypt_connection_id);
             conn->ip_portv6 = *ip_port;
             return 0;
         }
@@ -757,6 +854,79 @@ static int send_packet_to(const Net_Crypto *_Nonnull c, int crypt_connection_id,
 
 /*** START: Array Related functions */
 
+static Packet_Pool *_Nullable packet_pool_new(const Memory *_Nonnull mem)
+{
+    Packet_Pool *pool = (Packet_Pool *)mem_alloc(mem, sizeof(Packet_Pool));
+
+    if (pool == nullptr) {
+        return nullptr;
+    }
+
+    pool->mem = mem;
+    return pool;
+}
+
+static void packet_pool_kill(Packet_Pool *_Nullable pool)
+{
+    if (pool == nullptr) {
+        return;
+    }
+
+    const Memory *mem = pool->mem;
+
+    for (uint32_t i = 0; i < pool->free_count; ++i) {
+        mem_delete(mem, pool->free_list[i]);
+    }
+
+    mem_delete(mem, pool);
+}
+
+/** @brief Take an uninitialised Packet_Data from the pool.
+ *
+ * @retval nullptr on allocation failure.
+ */
+static Packet_Data *_Nullable packet_pool_take(Packet_Pool *_Nonnull pool)
+{
+    if (pool->free_count > 0) {
+        --pool->free_count;
+        Packet_Data *const new_d = pool->free_list[pool->free_count];
+        pool->free_list[pool->free_count] = nullptr;
+        return new_d;
+    }
+
+    return (Packet_Data *)mem_alloc(pool->mem, sizeof(Packet_Data));
+}
+
+/** @brief Take a Packet_Data from the pool and initialise it with a copy of data.
+ *
+ * @retval nullptr on allocation failure.
+ */
+static Packet_Data *_Nullable packet_pool_get(Packet_Pool *_Nonnull pool, const Packet_Data *_Nonnull data)
+{
+    Packet_Data *new_d = packet_pool_take(pool);
+
+    if (new_d == nullptr) {
+        return nullptr;
+    }
+
+    new_d->sent_time = data->sent_time;
+    new_d->length = data->length;
+    memcpy(new_d->data, data->data, data->length);
+    return new_d;
+}
+
+/** @brief Return a Packet_Data to the pool, or free it if the pool is full. */
+static void packet_pool_put(Packet_Pool *_Nonnull pool, Packet_Data *_Nonnull data)
+{
+    if (pool->free_count >= PACKET_POOL_MAX_FREE) {
+        mem_delete(pool->mem, data);
+        return;
+    }
+
+    pool->free_list[pool->free_count] = data;
+    ++pool->free_count;
+}
+
 /** @brief Return number of packets in array
  * Note that holes are counted too.
  */
@@ -765,33 +935,222 @@ static uint32_t num_packets_array(const Packets_Array *_Nonnull array)
     return array->buffer_end - array->buffer_start;
 }
 
+/** @brief Get the slot for packet number.
+ *
+ * The caller must ensure that `number - buffer_start < capacity`.
+ */
+static Packet_Data *_Nullable *_Nonnull packets_array_slot(const Packets_Array *_Nonnull array, uint32_t number)
+{
+    assert(array->buffer != nullptr);
+    return &array->buffer[number & (array->capacity - 1)];
+}
+
+/** @brief Store data (or nullptr to empty the slot) for packet number.
+ *
+ * The caller must ensure that `number - buffer_start < capacity`.
+ */
+static void packets_array_set(Packets_Array *_Nonnull array, uint32_t number, Packet_Data *_Nullable data)
+{
+    assert(array->present != nullptr);
+    const uint32_t index = number & (array->capacity - 1);
+    const uint64_t bit = (uint64_t)1 << (index % 64);
+
+    *packets_array_slot(array, number) = data;
+
+    if (data != nullptr) {
+        array->present[index / 64] |= bit;
+    } else {
+        array->present[index / 64] &= ~bit;
+    }
+}
+
+/** @brief Index of the lowest set bit of a non-zero word. */
+static uint32_t lowest_bit(uint64_t word)
+{
+    assert(word != 0);
+#ifdef __GNUC__
+    return (uint32_t)__builtin_ctzll(word);
+#else
+    uint32_t n = 0;
+
+    while ((word & 1) == 0) {
+        word >>= 1;
+        ++n;
+    }
+
+    return n;
+#endif /* __GNUC__ */
+}
+
+/** @brief Find the first packet at or after `buffer_start + offset` that is (or isn't) stored.
+ *
+ * @param present true to look for a stored packet, false for a missing one.
+ *
+ * @return the offset from buffer_start of that packet, or
+ *   `num_packets_array(array)` if there is none before buffer_end.
+ */
+static uint32_t packets_array_find(const Packets_Array *_Nonnull array, uint32_t offset, bool present)
+{
+    const uint32_t num_spots = num_packets_array(array);
+    // Slots beyond the table's capacity are always empty.
+    const uint32_t limit = min_u32(num_spots, array->capacity);
+
+    while (offset < limit) {
+        const uint32_t index = (array->buffer_start + offset) & (array->capacity - 1);
+        const uint32_t bit = index % 64;
+        uint32_t avail = min_u32(min_u32(64, array->capacity) - bit, limit - offset);
+        uint64_t word = array->present[index / 64];
+
+        if (!present) {
+            word = ~word;
+        }
+
+        word >>= bit;
+
+        if (avail < 64) {
+            word &= ((uint64_t)1 << avail) - 1;
+        }
+
+        if (word != 0) {
+            return offset + lowest_bit(word);
+        }
+
+        offset += avail;
+    }
+
+    if (!present && offset < num_spots) {
+        return offset;
+    }
+
+    return num_spots;
+}
+
+/** @brief Get the data stored for packet number, or nullptr if there is none. */
+static Packet_Data *_Nullable packets_array_get(const Packets_Array *_Nonnull array, uint32_t number)
+{
+    if (number - array->buffer_start >= array->capacity) {
+        return nullptr;
+    }
+
+    return *packets_array_slot(array, number);
+}
+
+/** @brief Reallocate the slot table of array to new_capacity slots.
+ *
+ * All packets stored in the array must be within the first
+ * `min(capacity, new_capacity)` packet numbers after buffer_start.
+ *
+ * @retval false on allocation failure. The array is unchanged.
+ */
+static bool packets_array_resize(const Memory *_Nonnull mem, Packets_Array *_Nonnull array, uint32_t new_capacity)
+{
+    Packet_Data **new_buffer = nullptr;
+    uint64_t *new_present = nullptr;
+
+    if (new_capacity > 0) {
+        new_buffer = (Packet_Data **)mem_valloc(mem, new_capacity, sizeof(Packet_Data *));
+        new_present = (uint64_t *)mem_valloc(mem, (new_capacity + 63) / 64, sizeof(uint64_t));
+
+        if (new_buffer == nullptr || new_present == nullptr) {
+            mem_delete(mem, new_present);
+            mem_delete(mem, new_buffer);
+            return false;
+        }
+    }
+
+    const uint32_t keep = min_u32(array->capacity, new_capacity);
+
+    for (uint32_t i = 0; i < keep; ++i) {
+        const uint32_t number = array->buffer_start + i;
+        const uint32_t index = number & (new_capacity - 1);
+        Packet_Data *const d = *packets_array_slot(array, number);
+        new_buffer[index] = d;
+
+        if (d != nullptr) {
+            new_present[index / 64] |= (uint64_t)1 << (index % 64);
+        }
+    }
+
+    mem_delete(mem, array->present);
+    mem_delete(mem, array->buffer);
+    array->buffer = new_buffer;
+    array->present = new_present;
+    array->capacity = new_capacity;
+    return true;
+}
+
+/** @brief Make sure the slot table can hold packet number `buffer_start + offset`.
+ *
+ * offset must be less than CRYPTO_PACKET_BUFFER_SIZE.
+ *
+ * @retval false on allocation failure.
+ */
+static bool packets_array_reserve(const Memory *_Nonnull mem, Packets_Array *_Nonnull array, uint32_t offset)
+{
+    if (offset < array->capacity) {
+        return true;
+    }
+
+    uint32_t new_capacity = array->capacity == 0 ? PACKETS_ARRAY_MIN_SIZE : array->capacity;
+
+    while (new_capacity <= offset) {
+        new_capacity *= 2;
+    }
+
+    assert(new_capacity <= CRYPTO_PACKET_BUFFER_SIZE);
+    return packets_array_resize(mem, array, new_capacity);
+}
+
+/** @brief Give back slot table memory once the window has drained.
+ *
+ * The table is halved while less than a quarter of it is in use, so a window
+ * oscillating around a power of 2 doesn't reallocate on every packet.
+ */
+static void packets_array_shrink(const Memory *_Nonnull mem, Packets_Array *_Nonnull array)
+{
+    uint32_t new_capacity = array->capacity;
+    const uint32_t num_spots = num_packets_array(array);
+
+    while (new_capacity > PACKETS_ARRAY_MIN_SIZE && num_spots < new_capacity / 4) {
+        new_capacity /= 2;
+    }
+
+    if (new_capacity != array->capacity) {
+        // Failure to shrink is harmless: we just keep the bigger table.
+        packets_array_resize(mem, array, new_capacity);
+    }
+}
+
 /** @brief Add data with packet number to array.
  *
  * @retval -1 on failure.
  * @retval 0 on success.
  */
-static int add_data_to_buffer(const Memory *_Nonnull mem, Packets_Array *_Nonnull array, uint32_t number, const Packet_Data *_Nonnull data)
+static int add_data_to_buffer(Packet_Pool *_Nonnull pool, Packets_Array *_Nonnull array, uint32_t number, const Packet_Data *_Nonnull data)
 {
-    if (number - array->buffer_start >= CRYPTO_PACKET_BUFFER_SIZE) {
+    const uint32_t offset = number - array->buffer_start;
+
+    if (offset >= CRYPTO_PACKET_BUFFER_SIZE) {
         return -1;
     }
 
-    const uint32_t num = number % CRYPTO_PACKET_BUFFER_SIZE;
+    if (packets_array_get(array, number) != nullptr) {
+        return -1;
+    }
 
-    if (array->buffer[num] != nullptr) {
+    if (!packets_array_reserve(pool->mem, array, offset)) {
         return -1;
     }
 
-    Packet_Data *new_d = (Packet_Data *)mem_alloc(mem, sizeof(Packet_Data));
+    Packet_Data *new_d = packet_pool_get(pool, data);
 
     if (new_d == nullptr) {
         return -1;
     }
 
-    *new_d = *data;
-    array->buffer[num] = new_d;
+    packets_array_set(array, number, new_d);
 
-    if (number - array->buffer_start >= num_packets_array(array)) {
+    if (offset >= num_packets_array(array)) {
         array->buffer_end = number + 1;
     }
 
@@ -812,40 +1171,39 @@ static int get_data_pointer(const Packets_Array *_Nonnull array, Packet_Data *_N
         return -1;
     }
 
-    const uint32_t num = number % CRYPTO_PACKET_BUFFER_SIZE;
+    Packet_Data *const d = packets_array_get(array, number);
 
-    if (array->buffer[num] == nullptr) {
+    if (d == nullptr) {
         return 0;
     }
 
-    *data = array->buffer[num];
+    *data = d;
     return 1;
 }
 
-/** @brief Add data to end of array.
+/** @brief Add a packet taken from the pool to the end of array.
+ *
+ * On failure, the caller still owns `new_d`.
  *
  * @retval -1 on failure.
  * @return packet number on success.
  */
-static int64_t add_data_end_of_buffer(const Logger *_Nonnull logger, const Memory *_Nonnull mem, Packets_Array *_Nonnull array, const Packet_Data *_Nonnull data)
+static int64_t add_data_end_of_buffer(const Logger *_Nonnull logger, const Memory *_Nonnull mem, Packets_Array *_Nonnull array, Packet_Data *_Nonnull new_d)
 {
     const uint32_t num_spots = num_packets_array(array);
 
     if (num_spots >= CRYPTO_PACKET_BUFFER_SIZE) {
-        LOGGER_WARNING(logger, "crypto packet buffer size exceeded; rejecting packet of length %d", data->length);
+        LOGGER_WARNING(logger, "crypto packet buffer size exceeded; rejecting packet of length %d", new_d->length);
         return -1;
     }
 
-    Packet_Data *new_d = (Packet_Data *)mem_alloc(mem, sizeof(Packet_Data));
-
-    if (new_d == nullptr) {
-        LOGGER_ERROR(logger, "packet data allocation failed");
+    if (!packets_array_reserve(mem, array, num_spots)) {
+        LOGGER_ERROR(logger, "packet array allocation failed");
         return -1;
     }
 
-    *new_d = *data;
     const uint32_t id = array->buffer_end;
-    array->buffer[id % CRYPTO_PACKET_BUFFER_SIZE] = new_d;
+    packets_array_set(array, id, new_d);
     ++array->buffer_end;
     return id;
 }
@@ -855,23 +1213,25 @@ static int64_t add_data_end_of_buffer(const Logger *_Nonnull logger, const Memor
  * @retval -1 on failure.
  * @return packet number on success.
  */
-static int64_t read_data_beg_buffer(const Memory *_Nonnull mem, Packets_Array *_Nonnull array, Packet_Data *_Nonnull data)
+static int64_t read_data_beg_buffer(Packet_Pool *_Nonnull pool, Packets_Array *_Nonnull array, Packet_Data *_Nonnull data)
 {
     if (array->buffer_end == array->buffer_start) {
         return -1;
     }
 
-    const uint32_t num = array->buffer_start % CRYPTO_PACKET_BUFFER_SIZE;
+    Packet_Data *const d = packets_array_get(array, array->buffer_start);
 
-    if (array->buffer[num] == nullptr) {
+    if (d == nullptr) {
         return -1;
     }
 
-    *data = *array->buffer[num];
+    *data = *d;
+    packets_array_set(array, array->buffer_start, nullptr);
+    packet_pool_put(pool, d);
+
     const uint32_t id = array->buffer_start;
     ++array->buffer_start;
-    mem_delete(mem, array->buffer[num]);
-    array->buffer[num] = nullptr;
+    packets_array_shrink(pool->mem, array);
     return id;
 }
 
@@ -880,7 +1240,7 @@ static int64_t read_data_beg_buffer(const Memory *_Nonnull mem, Packets_Array *_
  * @retval -1 on failure.
  * @retval 0 on success
  */
-static int clear_buffer_until(const Memory *_Nonnull mem, Packets_Array *_Nonnull array, uint32_t number)
+static int clear_buffer_until(Packet_Pool *_Nonnull pool, Packets_Array *_Nonnull array, uint32_t number)
 {
     const uint32_t num_spots = num_packets_array(array);
 
@@ -888,35 +1248,39 @@ static int clear_buffer_until(const Memory *_Nonnull mem, Packets_Array *_Nonnul
         return -1;
     }
 
-    uint32_t i;
+    // Slots beyond the table's capacity are always empty.
+    const uint32_t num_clear = min_u32(number - array->buffer_start, array->capacity);
 
-    for (i = array->buffer_start; i != number; ++i) {
-        const uint32_t num = i % CRYPTO_PACKET_BUFFER_SIZE;
+    for (uint32_t i = 0; i < num_clear; ++i) {
+        Packet_Data *const d = *packets_array_slot(array, array->buffer_start + i);
 
-        if (array->buffer[num] != nullptr) {
-            mem_delete(mem, array->buffer[num]);
-            array->buffer[num] = nullptr;
+        if (d != nullptr) {
+            packet_pool_put(pool, d);
+            packets_array_set(array, array->buffer_start + i, nullptr);
         }
     }
 
-    array->buffer_start = i;
+    array->buffer_start = number;
+    packets_array_shrink(pool->mem, array);
     return 0;
 }
 
-static int clear_buffer(const Memory *_Nonnull mem, Packets_Array *_Nonnull array)
+/** @brief Delete all packets in array and release its slot table. */
+static int clear_buffer(Packet_Pool *_Nonnull pool, Packets_Array *_Nonnull array)
 {
-    uint32_t i;
+    const uint32_t num_clear = min_u32(num_packets_array(array), array->capacity);
 
-    for (i = array->buffer_start; i != array->buffer_end; ++i) {
-        const uint32_t num = i % CRYPTO_PACKET_BUFFER_SIZE;
+    for (uint32_t i = 0; i < num_clear; ++i) {
+        Packet_Data *const d = *packets_array_slot(array, array->buffer_start + i);
 
-        if (array->buffer[num] != nullptr) {
-            mem_delete(mem, array->buffer[num]);
-            array->buffer[num] = nullptr;
+        if (d != nullptr) {
+            packet_pool_put(pool, d);
+            packets_array_set(array, array->buffer_start + i, nullptr);
         }
     }
 
-    array->buffer_start = i;
+    array->buffer_start = array->buffer_end;
+    packets_array_resize(pool->mem, array, 0);
     return 0;
 }
 
@@ -967,9 +1331,7 @@ static int generate_request_packet(uint8_t *_Nonnull data, uint16_t length, cons
     uint32_t n = 1;
 
     for (uint32_t i = recv_array->buffer_start; i != recv_array->buffer_end; ++i) {
-        const uint32_t num = i % CRYPTO_PACKET_BUFFER_SIZE;
-
-        if (recv_array->buffer[num] == nullptr) {
+        if (packets_array_get(recv_array, i) == nullptr) {
             data[cur_len] = n;
             n = 0;
             ++cur_len;
@@ -999,7 +1361,7 @@ static int generate_request_packet(uint8_t *_Nonnull data, uint16_t length, cons
  * @retval -1 on failure.
  * @return number of requested packets on success.
  */
-static int handle_request_packet(const Memory *_Nonnull mem, const Mono_Time *_Nonnull mono_time, Packets_Array *_Nonnull send_array, const uint8_t *_Nonnull data, uint16_t length,
+static int handle_request_packet(Packet_Pool *_Nonnull pool, const Mono_Time *_Nonnull mono_time, Packets_Array *_Nonnull send_array, const uint8_t *_Nonnull data, uint16_t length,
                                  uint64_t *_Nonnull latest_send_time, uint64_t rtt_time)
 {
     if (length == 0) {
@@ -1028,14 +1390,14 @@ static int handle_request_packet(const Memory *_Nonnull mem, const Mono_Time *_N
             break;
         }
 
-        const uint32_t num = i % CRYPTO_PACKET_BUFFER_SIZE;
+        Packet_Data *const dt = packets_array_get(send_array, i);
 
         if (n == data[0]) {
-            if (send_array->buffer[num] != nullptr) {
-                const uint64_t sent_time = send_array->buffer[num]->sent_time;
+            if (dt != nullptr) {
+                const uint64_t sent_time = dt->sent_time;
 
                 if ((sent_time + rtt_time) < temp_time) {
-                    send_array->buffer[num]->sent_time = 0;
+                    dt->sent_time = 0;
                 }
             }
 
@@ -1044,11 +1406,11 @@ static int handle_request_packet(const Memory *_Nonnull mem, const Mono_Time *_N
             n = 0;
             ++requested;
         } else {
-            if (send_array->buffer[num] != nullptr) {
-                l_sent_time = max_u64(l_sent_time, send_array->buffer[num]->sent_time);
+            if (dt != nullptr) {
+                l_sent_time = max_u64(l_sent_time, dt->sent_time);
 
-                mem_delete(mem, send_array->buffer[num]);
-                send_array->buffer[num] = nullptr;
+                packets_array_set(send_array, i, nullptr);
+                packet_pool_put(pool, dt);
             }
         }
 
@@ -1071,6 +1433,134 @@ static int handle_request_packet(const Memory *_Nonnull mem, const Mono_Time *_N
     return requested;
 }
 
+/**
+ * @brief Create a selective request packet from recv_array into data of length.
+ *
+ * Format: `[PACKET_ID_REQUEST_SACK][uint16_t covered]` followed by any number
+ * of `[uint16_t skip][uint16_t missing]` pairs. Offsets count from the
+ * buffer_start we send in the data packet header. Each pair says that `skip`
+ * packets were received and the `missing` packets after them were not. The
+ * packets between the last pair and `covered` were all received. If the runs
+ * don't fit, `covered` ends where the first run that was left out starts.
+ *
+ * @retval -1 on failure.
+ * @return length of packet on success.
+ */
+static int generate_sack_request_packet(uint8_t *_Nonnull data, uint16_t length, const Packets_Array *_Nonnull recv_array)
+{
+    if (length < 1 + sizeof(uint16_t)) {
+        return -1;
+    }
+
+    data[0] = PACKET_ID_REQUEST_SACK;
+
+    uint16_t cur_len = 1 + sizeof(uint16_t);
+    const uint32_t num_spots = num_packets_array(recv_array);
+    uint32_t covered = num_spots;
+    uint32_t pos = 0;
+
+    while (true) {
+        const uint32_t missing_start = packets_array_find(recv_array, pos, false);
+
+        if (missing_start >= num_spots) {
+            break;
+        }
+
+        if ((uint16_t)(length - cur_len) < 2 * sizeof(uint16_t)) {
+            covered = missing_start;
+            break;
+        }
+
+        const uint32_t missing_end = packets_array_find(recv_array, missing_start, true);
+
+        net_pack_u16(data + cur_len, (uint16_t)(missing_start - pos));
+        net_pack_u16(data + cur_len + sizeof(uint16_t), (uint16_t)(missing_end - missing_start));
+        cur_len += 2 * sizeof(uint16_t);
+        pos = missing_end;
+    }
+
+    net_pack_u16(data + 1, (uint16_t)covered);
+
+    return cur_len;
+}
+
+/** @brief Handle a selective request packet.
+ * Remove all the packets the other received from the array.
+ *
+ * @retval -1 on failure.
+ * @return number of requested packets on success.
+ */
+static int handle_sack_request_packet(Packet_Pool *_Nonnull pool, const Mono_Time *_Nonnull mono_time, Packets_Array *_Nonnull send_array, const uint8_t *_Nonnull data, uint16_t length,
+                                      uint64_t *_Nonnull latest_send_time, uint64_t rtt_time)
+{
+    if (length < 1 + sizeof(uint16_t) || data[0] != PACKET_ID_REQUEST_SACK) {
+        return -1;
+    }
+
+    uint16_t covered;
+    net_unpack_u16(data + 1, &covered);
+    data += 1 + sizeof(uint16_t);
+    length -= 1 + sizeof(uint16_t);
+
+    if (covered > num_packets_array(send_array) || length % (2 * sizeof(uint16_t)) != 0) {
+        return -1;
+    }
+
+    const uint64_t temp_time = current_time_monotonic(mono_time);
+    uint64_t l_sent_time = 0;
+    uint32_t requested = 0;
+    uint32_t pos = 0;
+
+    while (pos < covered || length > 0) {
+        uint16_t skip = covered - pos;
+        uint16_t missing = 0;
+
+        if (length > 0) {
+            net_unpack_u16(data, &skip);
+            net_unpack_u16(data + sizeof(uint16_t), &missing);
+            data += 2 * sizeof(uint16_t);
+            length -= 2 * sizeof(uint16_t);
+
+            if (skip > covered - pos || missing > covered - pos - skip) {
+                return -1;
+            }
+        }
+
+        const uint32_t received_end = pos + skip;
+
+        for (uint32_t i = packets_array_find(send_array, pos, true); i < received_end;
+                i = packets_array_find(send_array, i + 1, true)) {
+            const uint32_t number = send_array->buffer_start + i;
+            Packet_Data *const dt = packets_array_get(send_array, number);
+            assert(dt != nullptr);
+
+            l_sent_time = max_u64(l_sent_time, dt->sent_time);
+
+            packets_array_set(send_array, number, nullptr);
+            packet_pool_put(pool, dt);
+        }
+
+        const uint32_t missing_end = received_end + missing;
+
+        for (uint32_t i = packets_array_find(send_array, received_end, true); i < missing_end;
+                i = packets_array_find(send_array, i + 1, true)) {
+            Packet_Data *const dt = packets_array_get(send_array, send_array->buffer_start + i);
+            assert(dt != nullptr);
+
+            if ((dt->sent_time + rtt_time) < temp_time) {
+                dt->sent_time = 0;
+            }
+        }
+
+        requested += missing;
+        pos = missing_end;
+    }
+
+    *latest_send_time = max_u64(*latest_send_time, l_sent_time);
+
+    return requested;
+}
+
 /** END: Array Related functions */
 
 #define MAX_DATA_DATA_PACKET_SIZE (MAX_CRYPTO_PACKET_SIZE - (1 + sizeof(uint16_t) + CRYPTO_MAC_SIZE))
@@ -1168,13 +1658,22 @@ static int reset_max_speed_reached(const Net_Crypto *_Nonnull c, int crypt_conne
 }
 
 /**
+ * @brief Queue and send a lossless packet built in its send queue buffer.
+ *
+ * The packet starts with `header_length` bytes from `header`. If `fill` is not
+ * null, it then writes up to `payload_length` bytes directly after them.
+ *
  * @retval -1 if data could not be put in packet queue.
  * @return positive packet number if data was put into the queue.
  */
-static int64_t send_lossless_packet(const Net_Crypto *_Nonnull c, int crypt_connection_id, const uint8_t *_Nonnull data, uint16_t length, bool congestion_control)
+static int64_t send_lossless_packet(const Net_Crypto *_Nonnull c, int crypt_connection_id,
+        const uint8_t *_Nonnull header, uint16_t header_length, uint16_t payload_length,
+        nc_packet_fill_cb *_Nullable fill, void *_Nullable fill_object, bool congestion_control)
 {
-    if (length == 0 || length > MAX_CRYPTO_DATA_SIZE) {
-        LOGGER_ERROR(c->log, "rejecting too large (or empty) packet of size %d on crypt connection %d", length,
+    const uint32_t max_length = (uint32_t)header_length + (fill != nullptr ? payload_length : 0);
+
+    if (header_length == 0 || max_length > MAX_CRYPTO_DATA_SIZE) {
+        LOGGER_ERROR(c->log, "rejecting too large (or empty) packet of size %u on crypt connection %d", max_length,
                      crypt_connection_id);
         return -1;
     }
@@ -1194,13 +1693,33 @@ static int64_t send_lossless_packet(const Net_Crypto *_Nonnull c, int crypt_conn
         return -1;
     }
 
-    Packet_Data dt;
-    dt.sent_time = 0;
-    dt.length = length;
-    memcpy(dt.data, data, length);
-    const int64_t packet_num = add_data_end_of_buffer(c->log, c->mem, &conn->send_array, &dt);
+    // Build the packet in the buffer it is queued in, so it's copied only once.
+    Packet_Data *dt = packet_pool_take(c->packet_pool);
+
+    if (dt == nullptr) {
+        LOGGER_ERROR(c->log, "packet data allocation failed");
+        return -1;
+    }
+
+    dt->sent_time = 0;
+    dt->length = header_length;
+    memcpy(dt->data, header, header_length);
+
+    if (fill != nullptr) {
+        const int32_t written = fill(fill_object, dt->data + header_length, payload_length);
+
+        if (written < 0 || written > payload_length) {
+            packet_pool_put(c->packet_pool, dt);
+            return -1;
+        }
+
+        dt->length += (uint16_t)written;
+    }
+
+    const int64_t packet_num = add_data_end_of_buffer(c->log, c->mem, &conn->send_array, dt);
 
     if (packet_num == -1) {
+        packet_pool_put(c->packet_pool, dt);
         return -1;
     }
 
@@ -1208,12 +1727,8 @@ static int64_t send_lossless_packet(const Net_Crypto *_Nonnull c, int crypt_conn
         return packet_num;
     }
 
-    if (send_data_packet_helper(c, crypt_connection_id, conn->recv_array.buffer_start, packet_num, data, length) == 0) {
-        Packet_Data *dt1 = nullptr;
-
-        if (get_data_pointer(&conn->send_array, &dt1, packet_num) == 1) {
-            dt1->sent_time = current_time_monotonic(c->mono_time);
-        }
+    if (send_data_packet_helper(c, crypt_connection_id, conn->recv_array.buffer_start, packet_num, dt->data, dt->length) == 0) {
+        dt->sent_time = current_time_monotonic(c->mono_time);
     } else {
         conn->maximum_speed_reached = true;
         LOGGER_DEBUG(c->log, "send_data_packet failed (packet_num = %ld)", (long)packet_num);
@@ -1235,8 +1750,35 @@ static uint16_t get_nonce_uint16(const uint8_t *_Nonnull nonce)
 
 #define DATA_NUM_THRESHOLD 21845
 
-/** @brief Handle a data packet.
- * Decrypt packet of length and put it into data.
+#define CRYPTO_DATA_PACKET_OVERHEAD (1 + sizeof(uint16_t) + CRYPTO_MAC_SIZE)
+
+/** @brief Work out the nonce a data packet was encrypted with.
+ *
+ * @return the distance of the packet's nonce from the connection's receive
+ *   nonce, to pass to `data_packet_nonce_used` once the packet was decrypted.
+ */
+static uint16_t data_packet_nonce(const Crypto_Connection *_Nonnull conn, const uint8_t *_Nonnull packet,
+                                  uint8_t nonce[_Nonnull CRYPTO_NONCE_SIZE])
+{
+    memcpy(nonce, conn->recv_nonce, CRYPTO_NONCE_SIZE);
+    const uint16_t num_cur_nonce = get_nonce_uint16(nonce);
+    uint16_t num;
+    net_unpack_u16(packet + 1, &num);
+    const uint16_t diff = num - num_cur_nonce;
+    increment_nonce_number(nonce, diff);
+    return diff;
+}
+
+/** @brief Move the receive nonce along after a data packet was decrypted. */
+static void data_packet_nonce_used(Crypto_Connection *_Nonnull conn, uint16_t diff)
+{
+    if (diff > DATA_NUM_THRESHOLD * 2) {
+        increment_nonce_number(conn->recv_nonce, DATA_NUM_THRESHOLD);
+    }
+}
+
+/** @brief Handle a data packet.
+ * Decrypt packet of length and put it into data.
  * data must be at least MAX_DATA_DATA_PACKET_SIZE big.
  *
  * @retval -1 on failure.
@@ -1244,9 +1786,7 @@ static uint16_t get_nonce_uint16(const uint8_t *_Nonnull nonce)
  */
 static int handle_data_packet(const Net_Crypto *_Nonnull c, int crypt_connection_id, uint8_t *_Nonnull data, const uint8_t *_Nonnull packet, uint16_t length)
 {
-    const uint16_t crypto_packet_overhead = 1 + sizeof(uint16_t) + CRYPTO_MAC_SIZE;
-
-    if (length <= crypto_packet_overhead || length > MAX_CRYPTO_PACKET_SIZE) {
+    if (length <= CRYPTO_DATA_PACKET_OVERHEAD || length > MAX_CRYPTO_PACKET_SIZE) {
         return -1;
     }
 
@@ -1257,40 +1797,58 @@ static int handle_data_packet(const Net_Crypto *_Nonnull c, int crypt_connection
     }
 
     uint8_t nonce[CRYPTO_NONCE_SIZE];
-    memcpy(nonce, conn->recv_nonce, CRYPTO_NONCE_SIZE);
-    const uint16_t num_cur_nonce = get_nonce_uint16(nonce);
-    uint16_t num;
-    net_unpack_u16(packet + 1, &num);
-    const uint16_t diff = num - num_cur_nonce;
-    increment_nonce_number(nonce, diff);
+    const uint16_t diff = data_packet_nonce(conn, packet, nonce);
     const int len = decrypt_data_symmetric(c->mem, conn->shared_key, nonce, packet + 1 + sizeof(uint16_t),
                                            length - (1 + sizeof(uint16_t)), data);
 
-    if ((unsigned int)len != length - crypto_packet_overhead) {
+    if ((unsigned int)len != length - CRYPTO_DATA_PACKET_OVERHEAD) {
         return -1;
     }
 
-    if (diff > DATA_NUM_THRESHOLD * 2) {
-        increment_nonce_number(conn->recv_nonce, DATA_NUM_THRESHOLD);
-    }
+    data_packet_nonce_used(conn, diff);
 
     return len;
 }
 
+/** Number of request packets sent in both formats before giving up on a peer answering with SACK. */
+#define SACK_PROBE_COUNT 8
+
 /** @brief Send a request packet.
+ *
+ * Peers known to understand PACKET_ID_REQUEST_SACK get only that. Until we
+ * know, the first SACK_PROBE_COUNT requests go out in both formats; a peer
+ * that doesn't know the new one drops it and keeps using the classic one.
  *
  * @retval -1 on failure.
  * @retval 0 on success.
  */
 static int send_request_packet(const Net_Crypto *_Nonnull c, int crypt_connection_id)
 {
-    const Crypto_Connection *conn = get_crypto_connection(c, crypt_connection_id);
+    Crypto_Connection *conn = get_crypto_connection(c, crypt_connection_id);
 
     if (conn == nullptr) {
         return -1;
     }
 
     uint8_t data[MAX_CRYPTO_DATA_SIZE];
+
+    if (c->sack_requests && (conn->peer_sack || conn->sack_probes_sent < SACK_PROBE_COUNT)) {
+        const int len = generate_sack_request_packet(data, sizeof(data), &conn->recv_array);
+
+        if (len == -1) {
+            return -1;
+        }
+
+        const int ret = send_data_packet_helper(c, crypt_connection_id, conn->recv_array.buffer_start,
+                                                conn->send_array.buffer_end, data, len);
+
+        if (conn->peer_sack) {
+            return ret;
+        }
+
+        ++conn->sack_probes_sent;
+    }
+
     const int len = generate_request_packet(data, sizeof(data), &conn->recv_array);
 
     if (len == -1) {
@@ -1322,18 +1880,11 @@ static int send_requested_packets(const Net_Crypto *_Nonnull c, int crypt_connec
     const uint32_t array_size = num_packets_array(&conn->send_array);
     uint32_t num_sent = 0;
 
-    for (uint32_t i = 0; i < array_size; ++i) {
-        Packet_Data *dt;
+    for (uint32_t i = packets_array_find(&conn->send_array, 0, true); i < array_size;
+            i = packets_array_find(&conn->send_array, i + 1, true)) {
         const uint32_t packet_num = i + conn->send_array.buffer_start;
-        const int ret = get_data_pointer(&conn->send_array, &dt, packet_num);
-
-        if (ret == -1) {
-            return -1;
-        }
-
-        if (ret == 0) {
-            continue;
-        }
+        Packet_Data *const dt = packets_array_get(&conn->send_array, packet_num);
+        assert(dt != nullptr);
 
         if (dt->sent_time != 0) {
             continue;
@@ -1500,27 +2051,20 @@ static void connection_kill(Net_Crypto *_Nonnull c, int crypt_connection_id, voi
     crypto_kill(c, crypt_connection_id);
 }
 
-/** @brief Handle a received data packet.
+/** @brief Handle the decrypted contents of a received data packet.
  *
  * @retval -1 on failure.
  * @retval 0 on success.
  */
-static int handle_data_packet_core(Net_Crypto *_Nonnull c, int crypt_connection_id, const uint8_t *_Nonnull packet, uint16_t length,
-                                   bool udp, void *_Nullable userdata)
+static int handle_data_packet_plain(Net_Crypto *_Nonnull c, int crypt_connection_id, const uint8_t *_Nonnull data, int len,
+                                    bool udp, void *_Nullable userdata)
 {
-    if (length > MAX_CRYPTO_PACKET_SIZE || length <= CRYPTO_DATA_PACKET_MIN_SIZE) {
-        return -1;
-    }
-
     Crypto_Connection *conn = get_crypto_connection(c, crypt_connection_id);
 
     if (conn == nullptr) {
         return -1;
     }
 
-    uint8_t data[MAX_DATA_DATA_PACKET_SIZE];
-    const int len = handle_data_packet(c, crypt_connection_id, data, packet, length);
-
     if (len <= (int)(sizeof(uint32_t) * 2)) {
         return -1;
     }
@@ -1541,7 +2085,7 @@ static int handle_data_packet_core(Net_Crypto *_Nonnull c, int crypt_connection_
             rtt_calc_time = packet_time->sent_time;
         }
 
-        if (clear_buffer_until(c->mem, &conn->send_array, buffer_start) != 0) {
+        if (clear_buffer_until(c->packet_pool, &conn->send_array, buffer_start) != 0) {
             return -1;
         }
     }
@@ -1573,7 +2117,7 @@ static int handle_data_packet_core(Net_Crypto *_Nonnull c, int crypt_connection_
         }
     }
 
-    if (real_data[0] == PACKET_ID_REQUEST) {
+    if (real_data[0] == PACKET_ID_REQUEST || real_data[0] == PACKET_ID_REQUEST_SACK) {
         uint64_t rtt_time;
 
         if (udp) {
@@ -1582,7 +2126,14 @@ static int handle_data_packet_core(Net_Crypto *_Nonnull c, int crypt_connection_
             rtt_time = DEFAULT_TCP_PING_CONNECTION;
         }
 
-        const int requested = handle_request_packet(c->mem, c->mono_time, &conn->send_array, real_data, real_length, &rtt_calc_time, rtt_time);
+        int requested;
+
+        if (real_data[0] == PACKET_ID_REQUEST_SACK) {
+            requested = handle_sack_request_packet(c->packet_pool, c->mono_time, &conn->send_array, real_data, real_length, &rtt_calc_time, rtt_time);
+            conn->peer_sack = conn->peer_sack || requested != -1;
+        } else {
+            requested = handle_request_packet(c->packet_pool, c->mono_time, &conn->send_array, real_data, real_length, &rtt_calc_time, rtt_time);
+        }
 
         if (requested == -1) {
             return -1;
@@ -1594,12 +2145,12 @@ static int handle_data_packet_core(Net_Crypto *_Nonnull c, int crypt_connection_
         dt.length = real_length;
         memcpy(dt.data, real_data, real_length);
 
-        if (add_data_to_buffer(c->mem, &conn->recv_array, num, &dt) != 0) {
+        if (add_data_to_buffer(c->packet_pool, &conn->recv_array, num, &dt) != 0) {
             return -1;
         }
 
         while (true) {
-            const int ret = read_data_beg_buffer(c->mem, &conn->recv_array, &dt);
+            const int ret = read_data_beg_buffer(c->packet_pool, &conn->recv_array, &dt);
 
             if (ret == -1) {
                 break;
@@ -1638,11 +2189,37 @@ static int handle_data_packet_core(Net_Crypto *_Nonnull c, int crypt_connection_
         if (rtt_time < conn->rtt_time) {
             conn->rtt_time = rtt_time;
         }
+
+        if (conn->rtt_recent == 0 || rtt_time < conn->rtt_recent) {
+            conn->rtt_recent = rtt_time;
+        }
     }
 
     return 0;
 }
 
+/** @brief Handle a received data packet.
+ *
+ * @retval -1 on failure.
+ * @retval 0 on success.
+ */
+static int handle_data_packet_core(Net_Crypto *_Nonnull c, int crypt_connection_id, const uint8_t *_Nonnull packet, uint16_t length,
+                                   bool udp, void *_Nullable userdata)
+{
+    if (length > MAX_CRYPTO_PACKET_SIZE || length <= CRYPTO_DATA_PACKET_MIN_SIZE) {
+        return -1;
+    }
+
+    if (get_crypto_connection(c, crypt_connection_id) == nullptr) {
+        return -1;
+    }
+
+    uint8_t data[MAX_DATA_DATA_PACKET_SIZE];
+    const int len = handle_data_packet(c, crypt_connection_id, data, packet, length);
+
+    return handle_data_packet_plain(c, crypt_connection_id, data, len, udp, userdata);
+}
+
 static int handle_packet_cookie_response(const Net_Crypto *_Nonnull c, int crypt_connection_id, const uint8_t *_Nonnull packet, uint16_t length)
 {
     Crypto_Connection *conn = get_crypto_connection(c, crypt_connection_id);
@@ -1782,16 +2359,19 @@ static int realloc_cryptoconnection(Net_Crypto *_Nonnull c, uint32_t num)
     return 0;
 }
 
-/** @brief Create a new empty crypto connection.
+/** @brief Create a new empty crypto connection to the peer with the given real public key.
+ *
+ * The connection is added to the public key index, so it must be wiped with
+ * wipe_crypto_connection.
  *
  * @retval -1 on failure.
  * @return connection id on success.
  */
-static int create_crypto_connection(Net_Crypto *_Nonnull c)
+static int create_crypto_connection(Net_Crypto *_Nonnull c, const uint8_t *_Nonnull public_key)
 {
     int id = -1;
 
-    for (uint32_t i = 0; i < c->crypto_connections_length; ++i) {
+    for (uint32_t i = c->crypto_connections_free_hint; i < c->crypto_connections_length; ++i) {
         if (c->crypto_connections[i].status == CRYPTO_CONN_FREE) {
             id = i;
             break;
@@ -1806,12 +2386,20 @@ static int create_crypto_connection(Net_Crypto *_Nonnull c)
         }
     }
 
+    if (id != -1 && !pk_index_add(c->connections_by_pk, public_key, (uint32_t)id)) {
+        LOGGER_ERROR(c->log, "Could not index new crypto connection");
+        id = -1;
+    }
+
     if (id != -1) {
+        c->crypto_connections_free_hint = (uint32_t)id + 1;
+        memcpy(c->crypto_connections[id].public_key, public_key, CRYPTO_PUBLIC_KEY_SIZE);
+
         // Memsetting float/double to 0 is non-portable, so we explicitly set them to 0
         c->crypto_connections[id].packet_recv_rate = 0.0;
-        c->crypto_connections[id].packet_send_rate = 0.0;
+        c->crypto_connections[id].congestion.send_rate = 0.0;
         c->crypto_connections[id].last_packets_left_rem = 0.0;
-        c->crypto_connections[id].packet_send_rate_requested = 0.0;
+        c->crypto_connections[id].congestion.send_rate_requested = 0.0;
         c->crypto_connections[id].last_packets_left_requested_rem = 0.0;
 
         // TODO(Green-Sky): This enum is likely unneeded and the same as FREE.
@@ -1842,10 +2430,22 @@ static int wipe_crypto_connection(Net_Crypto *_Nonnull c, int crypt_connection_i
         return -1;
     }
 
+    const uint8_t *public_key = c->crypto_connections[crypt_connection_id].public_key;
+
+    if (pk_index_get(c->connections_by_pk, public_key) == crypt_connection_id) {
+        pk_index_remove(c->connections_by_pk, public_key);
+    }
+
     uint32_t i;
 
+    clear_buffer(c->packet_pool, &c->crypto_connections[crypt_connection_id].send_array);
+    clear_buffer(c->packet_pool, &c->crypto_connections[crypt_connection_id].recv_array);
     crypto_memzero(&c->crypto_connections[crypt_connection_id], sizeof(Crypto_Connection));
 
+    if ((uint32_t)crypt_connection_id < c->crypto_connections_free_hint) {
+        c->crypto_connections_free_hint = crypt_connection_id;
+    }
+
     /* check if we can resize the connections array */
     for (i = c->crypto_connections_length; i != 0; --i) {
         if (c->crypto_connections[i - 1].status != CRYPTO_CONN_FREE) {
@@ -1868,17 +2468,13 @@ static int wipe_crypto_connection(Net_Crypto *_Nonnull c, int crypt_connection_i
  */
 static int getcryptconnection_id(const Net_Crypto *_Nonnull c, const uint8_t *_Nonnull public_key)
 {
-    for (uint32_t i = 0; i < c->crypto_connections_length; ++i) {
-        if (!crypt_connection_id_is_valid(c, i)) {
-            continue;
-        }
+    const int64_t id = pk_index_get(c->connections_by_pk, public_key);
 
-        if (pk_equal(public_key, c->crypto_connections[i].public_key)) {
-            return i;
-        }
+    if (id == -1 || !crypt_connection_id_is_valid(c, (int)id)) {
+        return -1;
     }
 
-    return -1;
+    return (int)id;
 }
 
 /** @brief Add a source to the crypto connection.
@@ -2008,7 +2604,7 @@ int accept_crypto_connection(Net_Crypto *c, const New_Connection *n_c)
         return -1;
     }
 
-    const int crypt_connection_id = create_crypto_connection(c);
+    const int crypt_connection_id = create_crypto_connection(c, n_c->public_key);
 
     if (crypt_connection_id == -1) {
         LOGGER_ERROR(c->log, "Could not create new crypto connection");
@@ -2029,8 +2625,9 @@ int accept_crypto_connection(Net_Crypto *c, const New_Connection *n_c)
         return -1;
     }
 
+    set_tcp_connection_to_object(c->tcp_c, connection_number_tcp, c->tcp_object);
+
     conn->connection_number_tcp = connection_number_tcp;
-    memcpy(conn->public_key, n_c->public_key, CRYPTO_PUBLIC_KEY_SIZE);
     memcpy(conn->recv_nonce, n_c->recv_nonce, CRYPTO_NONCE_SIZE);
     memcpy(conn->peersessionpublic_key, n_c->peersessionpublic_key, CRYPTO_PUBLIC_KEY_SIZE);
     random_nonce(c->rng, conn->sent_nonce);
@@ -2045,8 +2642,7 @@ int accept_crypto_connection(Net_Crypto *c, const New_Connection *n_c)
     }
 
     memcpy(conn->dht_public_key, n_c->dht_public_key, CRYPTO_PUBLIC_KEY_SIZE);
-    conn->packet_send_rate = CRYPTO_PACKET_MIN_RATE;
-    conn->packet_send_rate_requested = CRYPTO_PACKET_MIN_RATE;
+    congestion_state_init(&conn->congestion);
     conn->packets_left = CRYPTO_MIN_QUEUE_LENGTH;
     conn->rtt_time = DEFAULT_PING_CONNECTION;
     crypto_connection_add_source(c, crypt_connection_id, &n_c->source);
@@ -2067,7 +2663,7 @@ int new_crypto_connection(Net_Crypto *c, const uint8_t *real_public_key, const u
         return crypt_connection_id;
     }
 
-    crypt_connection_id = create_crypto_connection(c);
+    crypt_connection_id = create_crypto_connection(c, real_public_key);
 
     if (crypt_connection_id == -1) {
         return -1;
@@ -2082,13 +2678,13 @@ int new_crypto_connection(Net_Crypto *c, const uint8_t *real_public_key, const u
         return -1;
     }
 
+    set_tcp_connection_to_object(c->tcp_c, connection_number_tcp, c->tcp_object);
+
     conn->connection_number_tcp = connection_number_tcp;
-    memcpy(conn->public_key, real_public_key, CRYPTO_PUBLIC_KEY_SIZE);
     random_nonce(c->rng, conn->sent_nonce);
     crypto_new_keypair(c->rng, conn->sessionpublic_key, conn->sessionsecret_key);
     conn->status = CRYPTO_CONN_COOKIE_REQUESTING;
-    conn->packet_send_rate = CRYPTO_PACKET_MIN_RATE;
-    conn->packet_send_rate_requested = CRYPTO_PACKET_MIN_RATE;
+    congestion_state_init(&conn->congestion);
     conn->packets_left = CRYPTO_MIN_QUEUE_LENGTH;
     conn->rtt_time = DEFAULT_PING_CONNECTION;
     memcpy(conn->dht_public_key, dht_public_key, CRYPTO_PUBLIC_KEY_SIZE);
@@ -2292,7 +2888,9 @@ uint32_t copy_connected_tcp_relays_index(const Net_Crypto *c, Node_format *tcp_r
 
 static void do_tcp(Net_Crypto *_Nonnull c, void *_Nullable userdata)
 {
-    do_tcp_connections(c->log, c->tcp_c, userdata);
+    if (c->owns_tcp_c) {
+        do_tcp_connections(c->log, c->tcp_c, userdata);
+    }
 
     for (uint32_t i = 0; i < c->crypto_connections_length; ++i) {
         const Crypto_Connection *conn = get_crypto_connection(c, i);
@@ -2423,6 +3021,158 @@ static int crypto_id_ip_port(const Net_Crypto *_Nonnull c, const IP_Port *_Nonnu
 
 #define CRYPTO_MIN_PACKET_SIZE (1 + sizeof(uint16_t) + CRYPTO_MAC_SIZE)
 
+/** @brief Remember when a packet last arrived on the connection's direct UDP route. */
+static void udp_packet_received(const Net_Crypto *_Nonnull c, int crypt_connection_id, const IP_Port *_Nonnull source)
+{
+    Crypto_Connection *conn = get_crypto_connection(c, crypt_connection_id);
+
+    if (conn == nullptr) {
+        return;
+    }
+
+    if (net_family_is_ipv4(source->ip.family)) {
+        conn->direct_lastrecv_timev4 = mono_time_get(c->mono_time);
+    } else {
+        conn->direct_lastrecv_timev6 = mono_time_get(c->mono_time);
+    }
+}
+
+/** Most data packets held back for batched decryption at a time. */
+#define CRYPTO_DATA_BATCH_SIZE 64
+
+typedef struct Batched_Data_Packet {
+    IP_Port source;
+    int crypt_connection_id;
+    uint16_t length;
+    uint8_t packet[MAX_CRYPTO_PACKET_SIZE];
+    uint8_t plain[MAX_DATA_DATA_PACKET_SIZE];
+} Batched_Data_Packet;
+
+struct Crypto_Data_Batch {
+    Batched_Data_Packet packets[CRYPTO_DATA_BATCH_SIZE];
+    /* jobs[i] decrypts packets[i] into its plain buffer. */
+    Decrypt_Job jobs[CRYPTO_DATA_BATCH_SIZE];
+    uint32_t count;
+};
+
+/** @brief Handle a data packet from the batch once it has been decrypted.
+ *
+ * The packet was decrypted with the connection's state at the time it
+ * arrived. If an earlier packet in the batch changed that state, e.g. moved
+ * the receive nonce along or replaced the connection, it is decrypted again.
+ *
+ * @retval -1 on failure.
+ * @retval 0 on success.
+ */
+static int handle_batched_data_packet(Net_Crypto *_Nonnull c, int crypt_connection_id, const Batched_Data_Packet *_Nonnull batched,
+                                      const Decrypt_Job *_Nonnull job, void *_Nullable userdata)
+{
+    Crypto_Connection *conn = get_crypto_connection(c, crypt_connection_id);
+
+    if (conn == nullptr) {
+        return -1;
+    }
+
+    if (conn->status != CRYPTO_CONN_NOT_CONFIRMED && conn->status != CRYPTO_CONN_ESTABLISHED) {
+        return -1;
+    }
+
+    uint8_t nonce[CRYPTO_NONCE_SIZE];
+    const uint16_t diff = data_packet_nonce(conn, batched->packet, nonce);
+
+    // The shared key is 32 bytes like a public key, so pk_equal compares it in constant time.
+    if (crypt_connection_id != batched->crypt_connection_id || memcmp(nonce, job->nonce, CRYPTO_NONCE_SIZE) != 0
+            || !pk_equal(conn->shared_key, job->shared_key)) {
+        return handle_data_packet_core(c, crypt_connection_id, batched->packet, batched->length, true, userdata);
+    }
+
+    if ((unsigned int)job->result != batched->length - CRYPTO_DATA_PACKET_OVERHEAD) {
+        return -1;
+    }
+
+    data_packet_nonce_used(conn, diff);
+
+    return handle_data_packet_plain(c, crypt_connection_id, batched->plain, job->result, true, userdata);
+}
+
+/** @brief Decrypt all data packets in the batch, then handle them in the order they arrived. */
+static void handle_data_batch(Net_Crypto *_Nonnull c, void *_Nullable userdata)
+{
+    Crypto_Data_Batch *batch = c->data_batch;
+
+    if (batch == nullptr || batch->count == 0) {
+        return;
+    }
+
+    decrypt_pool_run(c->decrypt_pool, batch->jobs, batch->count);
+
+    for (uint32_t i = 0; i < batch->count; ++i) {
+        const Batched_Data_Packet *batched = &batch->packets[i];
+        const int crypt_connection_id = crypto_id_ip_port(c, &batched->source);
+
+        if (crypt_connection_id == -1) {
+            continue;
+        }
+
+        if (handle_batched_data_packet(c, crypt_connection_id, batched, &batch->jobs[i], userdata) == 0) {
+            udp_packet_received(c, crypt_connection_id, &batched->source);
+        }
+    }
+
+    batch->count = 0;
+}
+
+static void udp_poll_done(void *_Nonnull object, void *_Nullable userdata)
+{
+    Net_Crypto *c = (Net_Crypto *)object;
+    handle_data_batch(c, userdata);
+}
+
+/** @brief Add a data packet from the UDP socket to the batch.
+ *
+ * @retval 1 if the packet was dropped.
+ * @retval 0 if it was queued.
+ */
+static int batch_data_packet(Net_Crypto *_Nonnull c, const IP_Port *_Nonnull source, const uint8_t *_Nonnull packet, uint16_t length,
+                             void *_Nullable userdata)
+{
+    Crypto_Data_Batch *batch = c->data_batch;
+    assert(batch != nullptr);
+
+    if (batch->count == CRYPTO_DATA_BATCH_SIZE) {
+        handle_data_batch(c, userdata);
+    }
+
+    const int crypt_connection_id = crypto_id_ip_port(c, source);
+    const Crypto_Connection *conn = get_crypto_connection(c, crypt_connection_id);
+
+    if (conn == nullptr || length <= CRYPTO_DATA_PACKET_MIN_SIZE) {
+        return 1;
+    }
+
+    if (conn->status != CRYPTO_CONN_NOT_CONFIRMED && conn->status != CRYPTO_CONN_ESTABLISHED) {
+        return 1;
+    }
+
+    Batched_Data_Packet *batched = &batch->packets[batch->count];
+    Decrypt_Job *job = &batch->jobs[batch->count];
+    ++batch->count;
+
+    batched->source = *source;
+    batched->crypt_connection_id = crypt_connection_id;
+    batched->length = length;
+    memcpy(batched->packet, packet, length);
+
+    memcpy(job->shared_key, conn->shared_key, CRYPTO_SHARED_KEY_SIZE);
+    data_packet_nonce(conn, packet, job->nonce);
+    job->encrypted = batched->packet + 1 + sizeof(uint16_t);
+    job->length = length - (1 + sizeof(uint16_t));
+    job->plain = batched->plain;
+    job->result = -1;
+
+    return 0;
+}
+
 /** @brief Handle raw UDP packets coming directly from the socket.
  *
  * Handles:
@@ -2439,6 +3189,15 @@ static int udp_handle_packet(void *_Nonnull object, const IP_Port *_Nonnull sour
         return 1;
     }
 
+    if (c->data_batch != nullptr) {
+        if (packet[0] == NET_PACKET_CRYPTO_DATA) {
+            return batch_data_packet(c, source, packet, length, userdata);
+        }
+
+        /* Keep packets in the order they arrived. */
+        handle_data_batch(c, userdata);
+    }
+
     const int crypt_connection_id = crypto_id_ip_port(c, source);
 
     if (crypt_connection_id == -1) {
@@ -2457,17 +3216,11 @@ static int udp_handle_packet(void *_Nonnull object, const IP_Port *_Nonnull sour
         return 1;
     }
 
-    Crypto_Connection *conn = get_crypto_connection(c, crypt_connection_id);
-
-    if (conn == nullptr) {
+    if (get_crypto_connection(c, crypt_connection_id) == nullptr) {
         return -1;
     }
 
-    if (net_family_is_ipv4(source->ip.family)) {
-        conn->direct_lastrecv_timev4 = mono_time_get(c->mono_time);
-    } else {
-        conn->direct_lastrecv_timev6 = mono_time_get(c->mono_time);
-    }
+    udp_packet_received(c, crypt_connection_id, source);
 
     return 0;
 }
@@ -2475,22 +3228,69 @@ static int udp_handle_packet(void *_Nonnull object, const IP_Port *_Nonnull sour
 /** @brief The dT for the average packet receiving rate calculations.
  * Also used as the
  */
-#define PACKET_COUNTER_AVERAGE_INTERVAL 50
+#define PACKET_COUNTER_AVERAGE_INTERVAL CONGESTION_UPDATE_INTERVAL
 
 /** @brief Ratio of recv queue size / recv packet rate (in seconds) times
  * the number of ms between request packets to send at that ratio
  */
 #define REQUEST_PACKETS_COMPARE_CONSTANT (0.125 * 100.0)
 
-/** @brief Timeout for increasing speed after congestion event (in ms). */
-#define CONGESTION_EVENT_TIMEOUT 1000
+/** With pacing, the send budget never exceeds this many ms worth of packets. */
+#define CRYPTO_PACING_BURST_TIME 5
 
-/**
- * If the send queue is SEND_QUEUE_RATIO times larger than the
- * calculated link speed the packet send speed will be reduced
- * by a value depending on this number.
+/** With pacing, the send budget may always hold at least this many packets. */
+#define CRYPTO_PACING_MIN_BURST 2
+
+/** @brief Largest send budget a paced connection sending at rate may have.
+ *
+ * The reserved slots come on top, otherwise file transfers would never see
+ * a budget big enough to send anything.
  */
-#define SEND_QUEUE_RATIO 2.0
+static uint32_t pacing_burst(double rate)
+{
+    const uint32_t burst = (uint32_t)(rate * CRYPTO_PACING_BURST_TIME / 1000.0);
+    return max_u32(burst, CRYPTO_PACING_MIN_BURST) + CRYPTO_RESERVED_QUEUE_LENGTH;
+}
+
+/** @brief Add the packets rate allows since `*last_set` to a send budget of `left`, up to burst.
+ *
+ * @return the new budget.
+ */
+static uint32_t pacing_refill(uint32_t left, double rate, uint32_t burst, uint64_t temp_time,
+                              uint64_t *_Nonnull last_set, double *_Nonnull rem)
+{
+    const double n_packets = rate * ((double)(temp_time - *last_set) / 1000.0) + *rem;
+    *last_set = temp_time;
+
+    if (left >= burst || n_packets >= (double)(burst - left)) {
+        // Budget that isn't used right away is lost, so it can't pile up into a burst.
+        *rem = 0;
+        return burst;
+    }
+
+    const uint32_t num_packets = (uint32_t)n_packets;
+    *rem = n_packets - (double)num_packets;
+    return left + num_packets;
+}
+
+/** @brief Refill the send budgets of a paced connection and set when it next grows. */
+static void pace_connection(Crypto_Connection *_Nonnull conn, uint64_t temp_time)
+{
+    const double rate = conn->congestion.send_rate;
+    const double rate_requested = conn->congestion.send_rate_requested;
+
+    conn->packets_left = pacing_refill(conn->packets_left, rate, pacing_burst(rate), temp_time,
+                                       &conn->last_packets_left_set, &conn->last_packets_left_rem);
+    conn->packets_left_requested = pacing_refill(conn->packets_left_requested, rate_requested,
+                                   pacing_burst(rate_requested), temp_time,
+                                   &conn->last_packets_left_requested_set, &conn->last_packets_left_requested_rem);
+
+    if (conn->packets_left > conn->packets_left_requested) {
+        conn->packets_left_requested = conn->packets_left;
+    }
+
+    conn->next_send_time = temp_time + (uint64_t)((1.0 - conn->last_packets_left_rem) * 1000.0 / rate) + 1;
+}
 
 static void send_crypto_packets(Net_Crypto *_Nonnull c)
 {
@@ -2554,104 +3354,40 @@ static void send_crypto_packets(Net_Crypto *_Nonnull c)
                 conn->packet_counter = 0;
                 conn->packet_counter_set = temp_time;
 
-                const uint32_t packets_sent = conn->packets_sent;
-                conn->packets_sent = 0;
-
-                const uint32_t packets_resent = conn->packets_resent;
-                conn->packets_resent = 0;
-
-                /* conjestion control
-                 *  calculate a new value of conn->packet_send_rate based on some data
-                 */
-
-                const unsigned int pos = conn->last_sendqueue_counter % CONGESTION_QUEUE_ARRAY_SIZE;
-                conn->last_sendqueue_size[pos] = num_packets_array(&conn->send_array);
-
-                long signed int sum = 0;
-                sum = (long signed int)conn->last_sendqueue_size[pos] -
-                      (long signed int)conn->last_sendqueue_size[(pos + 1) % CONGESTION_QUEUE_ARRAY_SIZE];
-
-                const unsigned int n_p_pos = conn->last_sendqueue_counter % CONGESTION_LAST_SENT_ARRAY_SIZE;
-                conn->last_num_packets_sent[n_p_pos] = packets_sent;
-                conn->last_num_packets_resent[n_p_pos] = packets_resent;
-
-                conn->last_sendqueue_counter = (conn->last_sendqueue_counter + 1) %
-                                               (CONGESTION_QUEUE_ARRAY_SIZE * CONGESTION_LAST_SENT_ARRAY_SIZE);
-
                 bool direct_connected = false;
                 /* return value can be ignored since the `if` above ensures the connection is established */
                 crypto_connection_status(c, i, &direct_connected, nullptr);
 
+                Congestion_Sample sample;
+                sample.now = temp_time;
+                sample.send_queue_size = num_packets_array(&conn->send_array);
+                sample.packets_sent = conn->packets_sent;
+                sample.packets_resent = conn->packets_resent;
+                sample.min_rtt = conn->rtt_time;
+                sample.recent_rtt = conn->rtt_recent;
+                sample.last_congestion_event = conn->last_congestion_event;
                 /* When switching from TCP to UDP, don't change the packet send rate for CONGESTION_EVENT_TIMEOUT ms. */
-                if (!(direct_connected && conn->last_tcp_sent + CONGESTION_EVENT_TIMEOUT > temp_time)) {
-                    long signed int total_sent = 0;
-                    long signed int total_resent = 0;
-
-                    // TODO(irungentoo): use real delay
-                    unsigned int delay = (unsigned int)(((double)conn->rtt_time / PACKET_COUNTER_AVERAGE_INTERVAL) + 0.5);
-                    const unsigned int packets_set_rem_array = CONGESTION_LAST_SENT_ARRAY_SIZE - CONGESTION_QUEUE_ARRAY_SIZE;
+                sample.hold_rate = direct_connected && conn->last_tcp_sent + CONGESTION_EVENT_TIMEOUT > temp_time;
 
-                    if (delay > packets_set_rem_array) {
-                        delay = packets_set_rem_array;
-                    }
-
-                    for (unsigned j = 0; j < CONGESTION_QUEUE_ARRAY_SIZE; ++j) {
-                        const unsigned int ind = (j + (packets_set_rem_array  - delay) + n_p_pos) % CONGESTION_LAST_SENT_ARRAY_SIZE;
-                        total_sent += conn->last_num_packets_sent[ind];
-                        total_resent += conn->last_num_packets_resent[ind];
-                    }
-
-                    if (sum > 0) {
-                        total_sent -= sum;
-                    } else {
-                        if (total_resent > -sum) {
-                            total_resent = -sum;
-                        }
-                    }
-
-                    /* if queue is too big only allow resending packets. */
-                    const uint32_t npackets = num_packets_array(&conn->send_array);
-                    double min_speed = 1000.0 * (((double)total_sent) / ((double)CONGESTION_QUEUE_ARRAY_SIZE *
-                                                 PACKET_COUNTER_AVERAGE_INTERVAL));
-
-                    const double min_speed_request = 1000.0 * (((double)(total_sent + total_resent)) / (
-                                                         (double)CONGESTION_QUEUE_ARRAY_SIZE * PACKET_COUNTER_AVERAGE_INTERVAL));
-
-                    if (min_speed < CRYPTO_PACKET_MIN_RATE) {
-                        min_speed = CRYPTO_PACKET_MIN_RATE;
-                    }
-
-                    const double send_array_ratio = (double)npackets / min_speed;
-
-                    // TODO(irungentoo): Improve formula?
-                    if (send_array_ratio > SEND_QUEUE_RATIO && CRYPTO_MIN_QUEUE_LENGTH < npackets) {
-                        conn->packet_send_rate = min_speed * (1.0 / (send_array_ratio / SEND_QUEUE_RATIO));
-                    } else if (conn->last_congestion_event + CONGESTION_EVENT_TIMEOUT < temp_time) {
-                        conn->packet_send_rate = min_speed * 1.2;
-                    } else {
-                        conn->packet_send_rate = min_speed * 0.9;
-                    }
-
-                    conn->packet_send_rate_requested = min_speed_request * 1.2;
-
-                    if (conn->packet_send_rate < CRYPTO_PACKET_MIN_RATE) {
-                        conn->packet_send_rate = CRYPTO_PACKET_MIN_RATE;
-                    }
+                conn->packets_sent = 0;
+                conn->packets_resent = 0;
+                conn->rtt_recent = 0;
 
-                    if (conn->packet_send_rate_requested < conn->packet_send_rate) {
-                        conn->packet_send_rate_requested = conn->packet_send_rate;
-                    }
-                }
+                congestion_update(c->congestion_control, &conn->congestion, &sample);
             }
 
             if (conn->last_packets_left_set == 0 || conn->last_packets_left_requested_set == 0) {
+                const uint32_t initial = c->pacing ? pacing_burst(conn->congestion.send_rate) : CRYPTO_MIN_QUEUE_LENGTH;
                 conn->last_packets_left_requested_set = temp_time;
                 conn->last_packets_left_set = temp_time;
-                conn->packets_left_requested = CRYPTO_MIN_QUEUE_LENGTH;
-                conn->packets_left = CRYPTO_MIN_QUEUE_LENGTH;
+                conn->packets_left_requested = initial;
+                conn->packets_left = initial;
+                conn->next_send_time = temp_time;
+            } else if (c->pacing) {
+                pace_connection(conn, temp_time);
             } else {
-                if (((uint64_t)((1000.0 / conn->packet_send_rate) + 0.5) + conn->last_packets_left_set) <= temp_time) {
-                    double n_packets = conn->packet_send_rate * (((double)(temp_time - conn->last_packets_left_set)) / 1000.0);
+                if (((uint64_t)((1000.0 / conn->congestion.send_rate) + 0.5) + conn->last_packets_left_set) <= temp_time) {
+                    double n_packets = conn->congestion.send_rate * (((double)(temp_time - conn->last_packets_left_set)) / 1000.0);
                     n_packets += conn->last_packets_left_rem;
 
                     const uint32_t num_packets = n_packets;
@@ -2667,9 +3403,9 @@ static void send_crypto_packets(Net_Crypto *_Nonnull c)
                     conn->last_packets_left_rem = rem;
                 }
 
-                if (((uint64_t)((1000.0 / conn->packet_send_rate_requested) + 0.5) + conn->last_packets_left_requested_set) <=
+                if (((uint64_t)((1000.0 / conn->congestion.send_rate_requested) + 0.5) + conn->last_packets_left_requested_set) <=
                         temp_time) {
-                    double n_packets = conn->packet_send_rate_requested * (((double)(temp_time - conn->last_packets_left_requested_set)) /
+                    double n_packets = conn->congestion.send_rate_requested * (((double)(temp_time - conn->last_packets_left_requested_set)) /
                                        1000.0);
                     n_packets += conn->last_packets_left_requested_rem;
 
@@ -2695,13 +3431,17 @@ static void send_crypto_packets(Net_Crypto *_Nonnull c)
                 if ((unsigned int)ret < conn->packets_left) {
                     conn->packets_left -= ret;
                 } else {
-                    conn->last_congestion_event = temp_time;
+                    /* A paced budget is often empty just because it's small. */
+                    if (!c->pacing || ret > 0) {
+                        conn->last_congestion_event = temp_time;
+                    }
+
                     conn->packets_left = 0;
                 }
             }
 
-            if (conn->packet_send_rate > CRYPTO_PACKET_MIN_RATE * 1.5) {
-                total_send_rate += conn->packet_send_rate;
+            if (conn->congestion.send_rate > CRYPTO_PACKET_MIN_RATE * 1.5) {
+                total_send_rate += conn->congestion.send_rate;
             }
         }
     }
@@ -2713,7 +3453,8 @@ static void send_crypto_packets(Net_Crypto *_Nonnull c)
         c->current_sleep_time = sleep_time;
     }
 
-    if (total_send_rate > CRYPTO_PACKET_MIN_RATE) {
+    /* With pacing, crypto_run_interval wakes us for each connection that waits for budget instead. */
+    if (!c->pacing && total_send_rate > CRYPTO_PACKET_MIN_RATE) {
         sleep_time = 1000.0 / total_send_rate;
 
         if (c->current_sleep_time > sleep_time) {
@@ -2770,14 +3511,20 @@ uint32_t crypto_num_free_sendqueue_slots(const Net_Crypto *c, int crypt_connecti
 int64_t write_cryptpacket(const Net_Crypto *c, int crypt_connection_id, const uint8_t *data, uint16_t length,
                           bool congestion_control)
 {
-    if (length == 0) {
+    return write_cryptpacket_fill(c, crypt_connection_id, data, length, 0, nullptr, nullptr, congestion_control);
+}
+
+int64_t write_cryptpacket_fill(const Net_Crypto *c, int crypt_connection_id, const uint8_t *header, uint16_t header_length,
+                               uint16_t payload_length, nc_packet_fill_cb *fill, void *fill_object, bool congestion_control)
+{
+    if (header_length == 0) {
         // We need at least a packet id.
         LOGGER_ERROR(c->log, "rejecting empty packet for crypto connection %d", crypt_connection_id);
         return -1;
     }
 
-    if (data[0] < PACKET_ID_RANGE_LOSSLESS_START || data[0] > PACKET_ID_RANGE_LOSSLESS_END) {
-        LOGGER_ERROR(c->log, "rejecting lossless packet with out-of-range id %d", data[0]);
+    if (header[0] < PACKET_ID_RANGE_LOSSLESS_START || header[0] > PACKET_ID_RANGE_LOSSLESS_END) {
+        LOGGER_ERROR(c->log, "rejecting lossless packet with out-of-range id %d", header[0]);
         return -1;
     }
 
@@ -2794,12 +3541,13 @@ int64_t write_cryptpacket(const Net_Crypto *c, int crypt_connection_id, const ui
     }
 
     if (congestion_control && conn->packets_left == 0) {
-        LOGGER_ERROR(c->log, "congestion control: rejecting packet of length %d on crypt connection %d", length,
-                     crypt_connection_id);
+        LOGGER_ERROR(c->log, "congestion control: rejecting packet of length %d on crypt connection %d",
+                     header_length + payload_length, crypt_connection_id);
         return -1;
     }
 
-    const int64_t ret = send_lossless_packet(c, crypt_connection_id, data, length, congestion_control);
+    const int64_t ret = send_lossless_packet(c, crypt_connection_id, header, header_length, payload_length,
+                        fill, fill_object, congestion_control);
 
     if (ret == -1) {
         return -1;
@@ -2894,11 +3642,9 @@ int crypto_kill(Net_Crypto *c, int crypt_connection_id)
 
         kill_tcp_connection_to(c->tcp_c, conn->connection_number_tcp);
 
-        bs_list_remove(&c->ip_port_list, (uint8_t *)&conn->ip_portv4, crypt_connection_id);
-        bs_list_remove(&c->ip_port_list, (uint8_t *)&conn->ip_portv6, crypt_connection_id);
+        ip_port_list_remove(c, &conn->ip_portv4, crypt_connection_id);
+        ip_port_list_remove(c, &conn->ip_portv6, crypt_connection_id);
         clear_temp_packet(c, crypt_connection_id);
-        clear_buffer(c->mem, &conn->send_array);
-        clear_buffer(c->mem, &conn->recv_array);
         ret = wipe_crypto_connection(c, crypt_connection_id);
     }
 
@@ -2957,16 +3703,10 @@ void load_secret_key(Net_Crypto *c, const uint8_t *sk)
     crypto_derive_public_key(c->self_public_key, c->self_secret_key);
 }
 
-/** @brief Create new instance of Net_Crypto.
- * Sets all the global connection variables to their default values.
- */
-Net_Crypto *new_net_crypto(const Logger *log, const Memory *mem, const Random *rng, const Network *ns,
-                           Mono_Time *mono_time, Networking_Core *net, void *dht, const Net_Crypto_DHT_Funcs *dht_funcs, const TCP_Proxy_Info *proxy_info, Net_Profile *tcp_np)
+static Net_Crypto *_Nullable net_crypto_new_with_tcp(const Logger *_Nonnull log, const Memory *_Nonnull mem, const Random *_Nonnull rng, const Network *_Nonnull ns,
+        Mono_Time *_Nonnull mono_time, Networking_Core *_Nonnull net, void *_Nonnull dht, const Net_Crypto_DHT_Funcs *_Nonnull dht_funcs,
+        TCP_Connections *_Nonnull tcp_c, bool owns_tcp_c)
 {
-    if (dht == nullptr || dht_funcs == nullptr || dht_funcs->get_shared_key_sent == nullptr || dht_funcs->get_self_public_key == nullptr || dht_funcs->get_self_secret_key == nullptr) {
-        return nullptr;
-    }
-
     Net_Crypto *temp = (Net_Crypto *)mem_alloc(mem, sizeof(Net_Crypto));
 
     if (temp == nullptr) {
@@ -2983,14 +3723,29 @@ Net_Crypto *new_net_crypto(const Logger *log, const Memory *mem, const Random *r
     temp->dht = dht;
     temp->dht_funcs = dht_funcs;
 
-    TCP_Connections *const tcp_c = new_tcp_connections(log, mem, rng, ns, mono_time, dht_funcs->get_self_secret_key(dht), proxy_info, tcp_np);
+    temp->tcp_c = tcp_c;
+    temp->owns_tcp_c = owns_tcp_c;
 
-    if (tcp_c == nullptr) {
+    Packet_Pool *const packet_pool = packet_pool_new(mem);
+
+    if (packet_pool == nullptr) {
         mem_delete(mem, temp);
         return nullptr;
     }
 
-    temp->tcp_c = tcp_c;
+    temp->packet_pool = packet_pool;
+    temp->congestion_control = congestion_control_get(CONGESTION_CONTROL_QUEUE);
+    temp->sack_requests = true;
+
+    PK_Index *const connections_by_pk = pk_index_new(mem, rng);
+
+    if (connections_by_pk == nullptr) {
+        packet_pool_kill(packet_pool);
+        mem_delete(mem, temp);
+        return nullptr;
+    }
+
+    temp->connections_by_pk = connections_by_pk;
 
     set_packet_tcp_connection_callback(temp->tcp_c, &tcp_data_callback, temp);
     set_oob_packet_tcp_connection_callback(temp->tcp_c, &tcp_oob_callback, temp);
@@ -3013,6 +3768,102 @@ Net_Crypto *new_net_crypto(const Logger *log, const Memory *mem, const Random *r
     return temp;
 }
 
+static bool dht_funcs_valid(const void *_Nullable dht, const Net_Crypto_DHT_Funcs *_Nullable dht_funcs)
+{
+    return dht != nullptr && dht_funcs != nullptr && dht_funcs->get_shared_key_sent != nullptr
+           && dht_funcs->get_self_public_key != nullptr && dht_funcs->get_self_secret_key != nullptr;
+}
+
+/** @brief Create new instance of Net_Crypto.
+ * Sets all the global connection variables to their default values.
+ */
+Net_Crypto *new_net_crypto(const Logger *log, const Memory *mem, const Random *rng, const Network *ns,
+                           Mono_Time *mono_time, Networking_Core *net, void *dht, const Net_Crypto_DHT_Funcs *dht_funcs, const TCP_Proxy_Info *proxy_info, Net_Profile *tcp_np)
+{
+    if (!dht_funcs_valid(dht, dht_funcs)) {
+        return nullptr;
+    }
+
+    TCP_Connections *const tcp_c = new_tcp_connections(log, mem, rng, ns, mono_time, dht_funcs->get_self_secret_key(dht), proxy_info, tcp_np);
+
+    if (tcp_c == nullptr) {
+        return nullptr;
+    }
+
+    Net_Crypto *const c = net_crypto_new_with_tcp(log, mem, rng, ns, mono_time, net, dht, dht_funcs, tcp_c, true);
+
+    if (c == nullptr) {
+        kill_tcp_connections(tcp_c);
+        return nullptr;
+    }
+
+    return c;
+}
+
+Net_Crypto *new_net_crypto_shared(const Logger *log, const Memory *mem, const Random *rng, const Network *ns,
+                                  Mono_Time *mono_time, Networking_Core *net, void *dht, const Net_Crypto_DHT_Funcs *dht_funcs,
+                                  TCP_Connections *tcp_c, const uint8_t *secret_symmetric_key)
+{
+    if (!dht_funcs_valid(dht, dht_funcs)) {
+        return nullptr;
+    }
+
+    Net_Crypto *const c = net_crypto_new_with_tcp(log, mem, rng, ns, mono_time, net, dht, dht_funcs, tcp_c, false);
+
+    if (c == nullptr) {
+        return nullptr;
+    }
+
+    memcpy(c->secret_symmetric_key, secret_symmetric_key, CRYPTO_SYMMETRIC_KEY_SIZE);
+    return c;
+}
+
+void nc_set_tcp_object(Net_Crypto *c, void *object)
+{
+    c->tcp_object = object;
+
+    for (uint32_t i = 0; i < c->crypto_connections_length; ++i) {
+        const Crypto_Connection *conn = get_crypto_connection(c, i);
+
+        if (conn != nullptr) {
+            set_tcp_connection_to_object(c->tcp_c, conn->connection_number_tcp, object);
+        }
+    }
+}
+
+void nc_set_ip_port_callback(Net_Crypto *c, nc_ip_port_cb *function, void *object)
+{
+    c->ip_port_callback = function;
+    c->ip_port_callback_object = object;
+
+    if (function == nullptr) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < c->ip_port_list.n; ++i) {
+        IP_Port ip_port;
+        memcpy(&ip_port, &c->ip_port_list.data[i * sizeof(IP_Port)], sizeof(IP_Port));
+        function(object, &ip_port, true);
+    }
+}
+
+bool nc_handshake_sender(const Memory *mem, const Mono_Time *mono_time, const uint8_t *cookie_key,
+                         const uint8_t *packet, uint16_t length, uint8_t *real_public_key)
+{
+    if (length != HANDSHAKE_PACKET_LENGTH || packet[0] != NET_PACKET_CRYPTO_HS) {
+        return false;
+    }
+
+    uint8_t cookie_plain[COOKIE_DATA_LENGTH];
+
+    if (open_cookie(mem, mono_time, cookie_plain, packet + 1, cookie_key) != 0) {
+        return false;
+    }
+
+    memcpy(real_public_key, cookie_plain, CRYPTO_PUBLIC_KEY_SIZE);
+    return true;
+}
+
 static void kill_timedout(Net_Crypto *_Nonnull c, void *_Nullable userdata)
 {
     for (uint32_t i = 0; i < c->crypto_connections_length; ++i) {
@@ -3041,10 +3892,85 @@ static void kill_timedout(Net_Crypto *_Nonnull c, void *_Nullable userdata)
     }
 }
 
+bool net_crypto_set_batch_decrypt(Net_Crypto *c, bool enabled, uint16_t num_workers)
+{
+    if (c->data_batch != nullptr) {
+        networking_register_poll_done(c->net, nullptr, nullptr);
+        crypto_memzero(c->data_batch, sizeof(Crypto_Data_Batch));
+        mem_delete(c->mem, c->data_batch);
+        c->data_batch = nullptr;
+        decrypt_pool_kill(c->decrypt_pool);
+        c->decrypt_pool = nullptr;
+    }
+
+    if (!enabled) {
+        return true;
+    }
+
+    Decrypt_Pool *pool = decrypt_pool_new(c->mem, num_workers);
+
+    if (pool == nullptr) {
+        LOGGER_ERROR(c->log, "failed to start %u decryption workers", num_workers);
+        return false;
+    }
+
+    Crypto_Data_Batch *batch = (Crypto_Data_Batch *)mem_alloc(c->mem, sizeof(Crypto_Data_Batch));
+
+    if (batch == nullptr) {
+        decrypt_pool_kill(pool);
+        return false;
+    }
+
+    c->decrypt_pool = pool;
+    c->data_batch = batch;
+    networking_register_poll_done(c->net, &udp_poll_done, c);
+
+    return true;
+}
+
+void net_crypto_set_congestion_control(Net_Crypto *c, Congestion_Control_Algorithm algorithm)
+{
+    c->congestion_control = congestion_control_get(algorithm);
+    LOGGER_DEBUG(c->log, "using %s congestion control", c->congestion_control->name);
+}
+
+void net_crypto_set_sack_requests(Net_Crypto *c, bool enabled)
+{
+    c->sack_requests = enabled;
+}
+
+void net_crypto_set_pacing(Net_Crypto *c, bool enabled)
+{
+    c->pacing = enabled;
+}
+
 /** return the optimal interval in ms for running do_net_crypto. */
 uint32_t crypto_run_interval(const Net_Crypto *c)
 {
-    return c->current_sleep_time;
+    if (!c->pacing) {
+        return c->current_sleep_time;
+    }
+
+    const uint64_t temp_time = current_time_monotonic(c->mono_time);
+    uint32_t interval = c->current_sleep_time;
+
+    for (uint32_t i = 0; i < c->crypto_connections_length; ++i) {
+        const Crypto_Connection *conn = get_crypto_connection(c, i);
+
+        // Connections with a full budget aren't sending anything, so there's nothing to wait for.
+        if (conn == nullptr || conn->status != CRYPTO_CONN_ESTABLISHED
+                || conn->packets_left >= pacing_burst(conn->congestion.send_rate)) {
+            continue;
+        }
+
+        if (conn->next_send_time <= temp_time) {
+            return 0;
+        }
+
+        interval = min_u32(interval, (uint32_t)min_u64(conn->next_send_time - temp_time, UINT32_MAX));
+    }
+
+    return interval;
 }
 
 /** Main loop. */
@@ -3067,7 +3993,14 @@ void kill_net_crypto(Net_Crypto *c)
         crypto_kill(c, i);
     }
 
-    kill_tcp_connections(c->tcp_c);
+    net_crypto_set_batch_decrypt(c, false, 0);
+
+    if (c->owns_tcp_c) {
+        kill_tcp_connections(c->tcp_c);
+    }
+
+    packet_pool_kill(c->packet_pool);
+    pk_index_kill(c->connections_by_pk);
     bs_list_free(&c->ip_port_list);
     networking_registerhandler(c->net, NET_PACKET_COOKIE_REQUEST, nullptr, nullptr);
     networking_registerhandler(c->net, NET_PACKET_COOKIE_RESPONSE, nullptr, nullptr);
@@ -3086,3 +4019,9 @@ void nc_testonly_get_secrets(const Net_Crypto *c, int conn_id, uint8_t *shared_k
         memcpy(recv_nonce, conn->recv_nonce, CRYPTO_NONCE_SIZE);
     }
 }
+
+bool nc_testonly_peer_sack(const Net_Crypto *c, int conn_id)
+{
+    const Crypto_Connection *conn = get_crypto_connection(c, conn_id);
+    return conn != nullptr && conn->peer_sack;
+}
@@ -16,6 +16,7 @@
 #include "TCP_client.h"
 #include "TCP_connection.h"
 #include "attributes.h"
+#include "congestion_control.h"
 #include "crypto_core.h"
 #include "logger.h"
 #include "mem.h"
@@ -68,6 +69,7 @@ typedef struct Net_Crypto_DHT_Funcs {
 typedef enum Packet_Id {
     PACKET_ID_REQUEST            = 1, // Used to request unreceived packets
     PACKET_ID_KILL               = 2, // Used to kill connection
+    PACKET_ID_REQUEST_SACK       = 3, // Used to request unreceived packets by range
 
     PACKET_ID_ONLINE             = 24,
     PACKET_ID_OFFLINE            = 25,
@@ -93,11 +95,10 @@ typedef enum Packet_Id {
 /** Maximum size of receiving and sending packet buffers. */
 #define CRYPTO_PACKET_BUFFER_SIZE 32768 // Must be a power of 2
 
-/** Minimum packet rate per second. */
-#define CRYPTO_PACKET_MIN_RATE 4.0
+/* CRYPTO_PACKET_MIN_RATE and CRYPTO_MIN_QUEUE_LENGTH are defined in congestion_control.h. */
 
-/** Minimum packet queue max length. */
-#define CRYPTO_MIN_QUEUE_LENGTH 64
+/** Send queue slots that bulk senders like file transfers leave for other packets. */
+#define CRYPTO_RESERVED_QUEUE_LENGTH (CRYPTO_MIN_QUEUE_LENGTH / 4)
 
 /** Maximum total size of packets that net_crypto sends. */
 #define MAX_CRYPTO_PACKET_SIZE 1400
@@ -125,13 +126,6 @@ typedef enum Packet_Id {
 /** All packets will be padded a number of bytes based on this number. */
 #define CRYPTO_MAX_PADDING 8
 
-/**
- * Base current transfer speed on last CONGESTION_QUEUE_ARRAY_SIZE number of points taken
- * at the dT defined in net_crypto.c
- */
-#define CONGESTION_QUEUE_ARRAY_SIZE 12
-#define CONGESTION_LAST_SENT_ARRAY_SIZE (CONGESTION_QUEUE_ARRAY_SIZE * 2)
-
 /** Default connection ping in ms. */
 #define DEFAULT_PING_CONNECTION 1000
 #define DEFAULT_TCP_PING_CONNECTION 500
@@ -257,6 +251,25 @@ bool max_speed_reached(const Net_Crypto *_Nonnull c, int crypt_connection_id);
  */
 int64_t write_cryptpacket(const Net_Crypto *_Nonnull c, int crypt_connection_id, const uint8_t *_Nonnull data, uint16_t length, bool congestion_control);
 
+/** @brief Writes up to `length` bytes of packet payload to `data`.
+ *
+ * @return the number of bytes written, or -1 to drop the packet.
+ */
+typedef int32_t nc_packet_fill_cb(void *_Nullable object, uint8_t *_Nonnull data, uint16_t length);
+
+/** @brief Sends a lossless cryptopacket whose payload is written in place.
+ *
+ * Like write_cryptpacket, but the packet is `header_length` bytes of `header`
+ * followed by whatever `fill` writes, at most `payload_length` bytes. The
+ * payload goes straight into the send queue buffer instead of being copied
+ * from a caller's buffer. If `fill` fails, nothing is queued or sent.
+ *
+ * `fill` must not call back into this Net_Crypto.
+ */
+int64_t write_cryptpacket_fill(const Net_Crypto *_Nonnull c, int crypt_connection_id, const uint8_t *_Nonnull header,
+                               uint16_t header_length, uint16_t payload_length, nc_packet_fill_cb *_Nullable fill,
+                               void *_Nullable fill_object, bool congestion_control);
+
 /** @brief Check if packet_number was received by the other side.
  *
  * packet_number must be a valid packet number of a packet sent on this connection.
@@ -387,6 +400,86 @@ Net_Crypto *_Nullable new_net_crypto(const Logger *_Nonnull log, const Memory *_
                                      Networking_Core *_Nonnull net, void *_Nonnull dht, const Net_Crypto_DHT_Funcs *_Nonnull dht_funcs,
                                      const TCP_Proxy_Info *_Nonnull proxy_info, Net_Profile *_Nonnull tcp_np);
 
+/** @brief Create an instance of Net_Crypto that uses TCP connections shared with others.
+ *
+ * All instances sharing tcp_c must use the same DHT and the same cookie key,
+ * so that any of them can answer a cookie request for the others. The owner
+ * of tcp_c runs and kills it; do_net_crypto and kill_net_crypto leave it alone.
+ */
+Net_Crypto *_Nullable new_net_crypto_shared(const Logger *_Nonnull log, const Memory *_Nonnull mem, const Random *_Nonnull rng, const Network *_Nonnull ns, Mono_Time *_Nonnull mono_time,
+        Networking_Core *_Nonnull net, void *_Nonnull dht, const Net_Crypto_DHT_Funcs *_Nonnull dht_funcs,
+        TCP_Connections *_Nonnull tcp_c, const uint8_t *_Nonnull secret_symmetric_key);
+
+/** @brief Set the object the TCP data callback gets for packets on our connections.
+ *
+ * Instances sharing their TCP connections use it to tell their packets apart.
+ * By default it is the object the callback was set with.
+ */
+void nc_set_tcp_object(Net_Crypto *_Nonnull c, void *_Nullable object);
+
+typedef void nc_ip_port_cb(void *_Nullable object, const IP_Port *_Nonnull ip_port, bool added);
+
+/** @brief Set the function told when an address starts or stops belonging to one of our connections.
+ *
+ * Instances sharing a socket use it to send the packets from an address to
+ * the instance with a connection there. It is told about the addresses
+ * connections already have.
+ */
+void nc_set_ip_port_callback(Net_Crypto *_Nonnull c, nc_ip_port_cb *_Nullable function, void *_Nullable object);
+
+/** @brief Get the real public key of the peer that sent a handshake packet.
+ *
+ * Only opens the cookie in the handshake, which takes the cookie key and
+ * nothing of the receiver's identity. The rest of the handshake is not
+ * checked.
+ *
+ * @param real_public_key must be CRYPTO_PUBLIC_KEY_SIZE bytes.
+ * @retval true if the packet is a handshake with a valid cookie.
+ */
+bool nc_handshake_sender(const Memory *_Nonnull mem, const Mono_Time *_Nonnull mono_time, const uint8_t *_Nonnull cookie_key,
+                         const uint8_t *_Nonnull packet, uint16_t length, uint8_t *_Nonnull real_public_key);
+
+/** @brief Decrypt data packets from the UDP socket in batches.
+ *
+ * When enabled, data packets read by one networking_poll are held back,
+ * decrypted together at the end of the poll, and then handled in the order
+ * they arrived. With `num_workers` > 0 the decryption is spread over that
+ * many threads besides the caller's. Any other packet for net_crypto first
+ * flushes the batch, so packets on a connection are never reordered.
+ *
+ * Must not be called from a net_crypto callback.
+ *
+ * @retval true on success.
+ * @retval false if the batch could not be allocated or the threads could not
+ *   be started. Batching is then disabled.
+ */
+bool net_crypto_set_batch_decrypt(Net_Crypto *_Nonnull c, bool enabled, uint16_t num_workers);
+
+/** @brief Select the algorithm that picks the send rate of every connection.
+ *
+ * Takes effect at the next rate update of each connection. The default is
+ * `CONGESTION_CONTROL_QUEUE`.
+ */
+void net_crypto_set_congestion_control(Net_Crypto *_Nonnull c, Congestion_Control_Algorithm algorithm);
+
+/** @brief Offer selective (range based) packet requests to peers.
+ *
+ * Peers that answer with one get only selective requests from then on; the
+ * others keep getting classic ones. Enabled by default.
+ */
+void net_crypto_set_sack_requests(Net_Crypto *_Nonnull c, bool enabled);
+
+/** @brief Pace sending on every connection.
+ *
+ * Without pacing, each do_net_crypto lets a connection send everything its
+ * send rate allowed since the last one, plus some slack, so data leaves in
+ * bursts as large as the gaps between iterations. With pacing, a connection
+ * may send at most a few ms worth of packets at once, and crypto_run_interval
+ * asks to be run again when a connection that used up its budget gets more.
+ * Disabled by default.
+ */
+void net_crypto_set_pacing(Net_Crypto *_Nonnull c, bool enabled);
+
 /** return the optimal interval in ms for running do_net_crypto. */
 uint32_t crypto_run_interval(const Net_Crypto *_Nonnull c);
 
@@ -396,6 +489,7 @@ void kill_net_crypto(Net_Crypto *_Nullable c);
 
 /** Unit test support functions. Do not use outside tests. */
 void nc_testonly_get_secrets(const Net_Crypto *_Nonnull c, int conn_id, uint8_t *_Nonnull shared_key, uint8_t *_Nonnull sent_nonce, uint8_t *_Nonnull recv_nonce);
+bool nc_testonly_peer_sack(const Net_Crypto *_Nonnull c, int conn_id);
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -0,0 +1,200 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "../testing/support/public/simulated_environment.hh"
+#include "DHT_test_util.hh"
+#include "crypto_core.h"
+#include "logger.h"
+#include "net_crypto.h"
+#include "net_profile.h"
+#include "network.h"
+
+namespace {
+
+using tox::test::SimulatedEnvironment;
+
+class BenchNode {
+public:
+    BenchNode(SimulatedEnvironment &env, std::uint16_t port)
+        : dht_(env, port)
+        , net_profile_(netprof_new(dht_.logger(), &dht_.node().c_memory),
+              [mem = &dht_.node().c_memory](Net_Profile *p) { netprof_kill(mem, p); })
+        , net_crypto_(nullptr, [](Net_Crypto *c) { kill_net_crypto(c); })
+    {
+        TCP_Proxy_Info proxy_info = {{0}, TCP_PROXY_NONE};
+        net_crypto_.reset(new_net_crypto(dht_.logger(), &dht_.node().c_memory,
+            &dht_.node().c_random, &dht_.node().c_network, dht_.mono_time(), dht_.networking(),
+            dht_.get_dht(), &WrappedMockDHT::funcs, &proxy_info, net_profile_.get()));
+        new_connection_handler(net_crypto_.get(), &BenchNode::accept_cb, this);
+    }
+
+    Net_Crypto *get_net_crypto() { return net_crypto_.get(); }
+    const std::uint8_t *dht_public_key() const { return dht_.dht_public_key(); }
+    const std::uint8_t *real_public_key() const { return nc_get_self_public_key(net_crypto_.get()); }
+    IP_Port get_ip_port() const { return dht_.get_ip_port(); }
+    std::size_t current_allocation() { return dht_.node().node->fake_memory().current_allocation(); }
+
+    void poll()
+    {
+        dht_.poll();
+        do_net_crypto(net_crypto_.get(), nullptr);
+    }
+
+    int connect_to(BenchNode &other)
+    {
+        const int id = new_crypto_connection(
+            net_crypto_.get(), other.real_public_key(), other.dht_public_key());
+        if (id != -1) {
+            IP_Port addr = other.get_ip_port();
+            set_direct_ip_port(net_crypto_.get(), id, &addr, true);
+            connection_status_handler(net_crypto_.get(), id, &BenchNode::status_cb, this, id);
+        }
+        return id;
+    }
+
+    bool is_established() const { return established_; }
+
+private:
+    static int status_cb(void *object, int id, bool status, void *userdata)
+    {
+        static_cast<BenchNode *>(object)->established_ = status;
+        return 0;
+    }
+
+    static int accept_cb(void *object, const New_Connection *n_c)
+    {
+        auto *self = static_cast<BenchNode *>(object);
+        return accept_crypto_connection(self->net_crypto_.get(), n_c);
+    }
+
+    WrappedMockDHT dht_;
+    std::unique_ptr<Net_Profile, std::function<void(Net_Profile *)>> net_profile_;
+    std::unique_ptr<Net_Crypto, void (*)(Net_Crypto *)> net_crypto_;
+    bool established_ = false;
+};
+
+/**
+ * @brief Memory cost of idle crypto connections.
+ *
+ * Each connection is created to a random peer and never gets any traffic, so
+ * this measures the fixed per-connection overhead, including the send and
+ * receive packet windows.
+ */
+void BM_MemoryPerConnection(benchmark::State &state)
+{
+    const int num_connections = state.range(0);
+
+    SimulatedEnvironment env{12345};
+    BenchNode alice(env, 33445);
+
+    std::size_t bytes_per_connection = 0;
+
+    for (auto _ : state) {
+        const std::size_t before = alice.current_allocation();
+
+        std::vector<int> ids;
+        ids.reserve(num_connections);
+
+        for (int i = 0; i < num_connections; ++i) {
+            std::uint8_t real_pk[CRYPTO_PUBLIC_KEY_SIZE];
+            std::uint8_t dht_pk[CRYPTO_PUBLIC_KEY_SIZE];
+            env.fake_random().bytes(real_pk, sizeof(real_pk));
+            env.fake_random().bytes(dht_pk, sizeof(dht_pk));
+            ids.push_back(new_crypto_connection(alice.get_net_crypto(), real_pk, dht_pk));
+        }
+
+        bytes_per_connection = (alice.current_allocation() - before) / num_connections;
+
+        for (const int id : ids) {
+            crypto_kill(alice.get_net_crypto(), id);
+        }
+    }
+
+    state.counters["bytes_per_connection"] = benchmark::Counter(
+        static_cast<double>(bytes_per_connection), benchmark::Counter::kDefaults,
+        benchmark::Counter::OneK::kIs1024);
+}
+BENCHMARK(BM_MemoryPerConnection)->Arg(1)->Arg(16)->Arg(256)->Arg(1024);
+
+/**
+ * @brief Queue a window of lossless packets on an established connection and
+ * let the peer acknowledge them.
+ *
+ * Reports the peak memory per queued packet and the memory left behind once
+ * the window has drained.
+ */
+void BM_SendWindow(benchmark::State &state)
+{
+    const int window = state.range(0);
+
+    SimulatedEnvironment env{12345};
+    BenchNode alice(env, 33445);
+    BenchNode bob(env, 33446);
+
+    const int alice_conn_id = alice.connect_to(bob);
+
+    if (alice_conn_id == -1) {
+        state.SkipWithError("failed to create connection");
+        return;
+    }
+
+    for (int i = 0; i < 500 && !alice.is_established(); ++i) {
+        alice.poll();
+        bob.poll();
+        env.advance_time(10);
+    }
+
+    if (!alice.is_established()) {
+        state.SkipWithError("failed to establish connection");
+        return;
+    }
+
+    std::vector<std::uint8_t> data(1000, 'A');
+    data[0] = PACKET_ID_RANGE_LOSSLESS_CUSTOM_START;
+
+    std::size_t bytes_per_packet = 0;
+    std::size_t idle_bytes = 0;
+
+    for (auto _ : state) {
+        const std::size_t before = alice.current_allocation();
+
+        for (int i = 0; i < window; ++i) {
+            if (write_cryptpacket(alice.get_net_crypto(), alice_conn_id, data.data(), data.size(),
+                    false)
+                == -1) {
+                state.SkipWithError("failed to queue packet");
+                return;
+            }
+        }
+
+        bytes_per_packet = (alice.current_allocation() - before) / window;
+
+        for (int i = 0; i < 50; ++i) {
+            bob.poll();
+            alice.poll();
+            env.advance_time(10);
+        }
+
+        idle_bytes = alice.current_allocation();
+    }
+
+    state.counters["bytes_per_packet"] = benchmark::Counter(
+        static_cast<double>(bytes_per_packet), benchmark::Counter::kDefaults,
+        benchmark::Counter::OneK::kIs1024);
+    state.counters["mem_idle"] = benchmark::Counter(static_cast<double>(idle_bytes),
+        benchmark::Counter::kDefaults, benchmark::Counter::OneK::kIs1024);
+}
+BENCHMARK(BM_SendWindow)->Arg(16)->Arg(256)->Arg(1024)->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -108,6 +108,30 @@ public:
         return write_cryptpacket(net_crypto_.get(), conn_id, data.data(), data.size(), false) != -1;
     }
 
+    // Sends `header` followed by `payload`, which is written in place by a fill callback.
+    // A negative `fill_result` makes the callback fail.
+    bool send_filled(int conn_id, const std::vector<std::uint8_t> &header,
+        const std::vector<std::uint8_t> &payload, std::int32_t fill_result = 0)
+    {
+        struct Fill {
+            const std::vector<std::uint8_t> *payload;
+            std::int32_t result;
+        } fill{&payload, fill_result};
+
+        auto fill_cb = [](void *object, std::uint8_t *data, std::uint16_t length) -> std::int32_t {
+            const Fill *f = static_cast<const Fill *>(object);
+            if (f->result < 0) {
+                return f->result;
+            }
+            std::copy(f->payload->begin(), f->payload->end(), data);
+            return static_cast<std::int32_t>(f->payload->size());
+        };
+
+        return write_cryptpacket_fill(net_crypto_.get(), conn_id, header.data(), header.size(),
+                   payload.size(), fill_cb, &fill, false)
+            != -1;
+    }
+
     void send_direct_packet(const IP_Port &dest, const std::vector<std::uint8_t> &data)
     {
         if (data.empty())
@@ -131,6 +155,13 @@ public:
         return connections_[conn_id].received_data;
     }
 
+    std::size_t get_received_count(int conn_id) const
+    {
+        if (conn_id < 0 || conn_id >= static_cast<int>(connections_.size()))
+            return 0;
+        return connections_[conn_id].received_count;
+    }
+
     // Helper to get the ID assigned to a peer by Public Key (for the acceptor side)
     int get_connection_id_by_pk(const std::uint8_t *pk) { return last_accepted_id_; }
 
@@ -142,6 +173,7 @@ private:
     struct ConnectionState {
         bool connected = false;
         std::vector<std::uint8_t> received_data;
+        std::size_t received_count = 0;
     };
 
     // We map connection IDs to state. connection IDs are small ints.
@@ -189,6 +221,7 @@ private:
         auto *self = static_cast<TestNode *>(object);
         if (id < static_cast<int>(self->connections_.size())) {
             self->connections_[id].received_data.assign(data, data + length);
+            ++self->connections_[id].received_count;
         }
         return 0;
     }
@@ -261,6 +294,117 @@ TEST_F(NetCryptoTest, EndToEndDataExchange)
     EXPECT_TRUE(data_received) << "Bob did not receive the correct data";
 }
 
+TEST_F(NetCryptoTest, FilledPacketArrivesWithHeaderAndPayload)
+{
+    NetCryptoNode alice(env, 33445);
+    NetCryptoNode bob(env, 33446);
+
+    int alice_conn_id = alice.connect_to(bob);
+    ASSERT_NE(alice_conn_id, -1);
+
+    auto start = env.clock().current_time_ms();
+    int bob_conn_id = -1;
+    bool connected = false;
+
+    while ((env.clock().current_time_ms() - start) < 5000) {
+        alice.poll();
+        bob.poll();
+        env.advance_time(10);
+
+        bob_conn_id = bob.get_connection_id_by_pk(alice.real_public_key());
+        if (alice.is_connected(alice_conn_id) && bob_conn_id != -1
+            && bob.is_connected(bob_conn_id)) {
+            connected = true;
+            break;
+        }
+    }
+
+    ASSERT_TRUE(connected) << "Failed to establish connection within timeout";
+
+    const std::vector<std::uint8_t> header = {160, 7};
+    const std::vector<std::uint8_t> payload = {'c', 'h', 'u', 'n', 'k'};
+
+    // A failing fill queues nothing; the next packet is the one that arrives.
+    EXPECT_FALSE(alice.send_filled(alice_conn_id, header, payload, -1));
+    EXPECT_TRUE(alice.send_filled(alice_conn_id, header, payload));
+
+    std::vector<std::uint8_t> expected = header;
+    expected.insert(expected.end(), payload.begin(), payload.end());
+
+    start = env.clock().current_time_ms();
+    bool data_received = false;
+    while ((env.clock().current_time_ms() - start) < 1000) {
+        alice.poll();
+        bob.poll();
+        env.advance_time(10);
+
+        if (bob.get_last_received_data(bob_conn_id) == expected) {
+            data_received = true;
+            break;
+        }
+    }
+
+    EXPECT_TRUE(data_received) << "Bob did not receive the filled packet";
+}
+
+TEST_F(NetCryptoTest, BatchedDecryptDeliversEveryPacketInOrder)
+{
+    NetCryptoNode alice(env, 33445);
+    NetCryptoNode bob(env, 33446);
+    ASSERT_TRUE(net_crypto_set_batch_decrypt(bob.get_net_crypto(), true, 2));
+
+    int alice_conn_id = alice.connect_to(bob);
+    ASSERT_NE(alice_conn_id, -1);
+
+    int bob_conn_id = -1;
+
+    for (int i = 0; i < 500; ++i) {
+        alice.poll();
+        bob.poll();
+        env.advance_time(10);
+
+        bob_conn_id = bob.get_connection_id_by_pk(alice.real_public_key());
+        if (alice.is_connected(alice_conn_id) && bob_conn_id != -1
+            && bob.is_connected(bob_conn_id)) {
+            break;
+        }
+    }
+
+    ASSERT_TRUE(bob.is_connected(bob_conn_id));
+
+    // Enough packets that bob reads several full batches in one poll.
+    constexpr int kPackets = 200;
+    std::vector<std::uint8_t> message(100, 'x');
+    message[0] = 160;
+
+    for (int i = 0; i < kPackets; ++i) {
+        message[1] = static_cast<std::uint8_t>(i);
+        ASSERT_TRUE(alice.send_data(alice_conn_id, message)) << i;
+    }
+
+    for (int i = 0; i < 500 && bob.get_received_count(bob_conn_id) < kPackets; ++i) {
+        alice.poll();
+        bob.poll();
+        env.advance_time(10);
+    }
+
+    EXPECT_EQ(bob.get_received_count(bob_conn_id), kPackets);
+    EXPECT_EQ(bob.get_last_received_data(bob_conn_id), message);
+
+    // Turning batching off again leaves the connection working.
+    ASSERT_TRUE(net_crypto_set_batch_decrypt(bob.get_net_crypto(), false, 0));
+    message[1] = 'z';
+    ASSERT_TRUE(alice.send_data(alice_conn_id, message));
+
+    for (int i = 0; i < 100 && bob.get_received_count(bob_conn_id) == kPackets; ++i) {
+        alice.poll();
+        bob.poll();
+        env.advance_time(10);
+    }
+
+    EXPECT_EQ(bob.get_last_received_data(bob_conn_id), message);
+}
+
 TEST_F(NetCryptoTest, ConnectionTimeout)
 {
     NetCryptoNode alice(env, 33445);
@@ -365,6 +509,122 @@ TEST_F(NetCryptoTest, DataLossAndRetransmission)
     EXPECT_TRUE(data_received) << "Bob failed to receive data after retransmission";
 }
 
+TEST_F(NetCryptoTest, ScatteredLossIsRecoveredWithSackRequests)
+{
+    NetCryptoNode alice(env, 33445);
+    NetCryptoNode bob(env, 33446);
+
+    int alice_conn_id = alice.connect_to(bob);
+    ASSERT_NE(alice_conn_id, -1);
+
+    auto start = env.clock().current_time_ms();
+    int bob_conn_id = -1;
+    bool connected = false;
+
+    while ((env.clock().current_time_ms() - start) < 5000) {
+        alice.poll();
+        bob.poll();
+        env.advance_time(10);
+
+        bob_conn_id = bob.get_connection_id_by_pk(alice.real_public_key());
+        if (alice.is_connected(alice_conn_id) && bob_conn_id != -1
+            && bob.is_connected(bob_conn_id)) {
+            connected = true;
+            break;
+        }
+    }
+    ASSERT_TRUE(connected);
+
+    // Drop every 4th data packet from Alice, leaving many gaps in Bob's window.
+    int data_packets = 0;
+    int dropped = 0;
+    env.simulation().net().add_filter([&](tox::test::Packet &p) {
+        if (net_ntohs(p.to.port) == 33446 && p.data.size() > 0
+            && p.data[0] == NET_PACKET_CRYPTO_DATA && ++data_packets % 4 == 0) {
+            ++dropped;
+            return false;
+        }
+        return true;
+    });
+
+    constexpr int kNumPackets = 300;
+    std::vector<std::uint8_t> message(100, 'S');
+    for (int i = 0; i < kNumPackets; ++i) {
+        message[0] = 160 + (i % 30);
+        ASSERT_TRUE(alice.send_data(alice_conn_id, message));
+    }
+
+    start = env.clock().current_time_ms();
+    while ((env.clock().current_time_ms() - start) < 20000
+        && bob.get_received_count(bob_conn_id) < kNumPackets) {
+        alice.poll();
+        bob.poll();
+        env.advance_time(10);
+    }
+
+    EXPECT_GT(dropped, 0);
+    EXPECT_EQ(bob.get_received_count(bob_conn_id), kNumPackets);
+    EXPECT_TRUE(nc_testonly_peer_sack(alice.get_net_crypto(), alice_conn_id));
+    EXPECT_TRUE(nc_testonly_peer_sack(bob.get_net_crypto(), bob_conn_id));
+}
+
+TEST_F(NetCryptoTest, PacingLimitsBurstsAndReportsWhenToSendNext)
+{
+    NetCryptoNode alice(env, 33445);
+    NetCryptoNode bob(env, 33446);
+    net_crypto_set_pacing(alice.get_net_crypto(), true);
+
+    int alice_conn_id = alice.connect_to(bob);
+    ASSERT_NE(alice_conn_id, -1);
+
+    auto start = env.clock().current_time_ms();
+    int bob_conn_id = -1;
+    bool connected = false;
+
+    while ((env.clock().current_time_ms() - start) < 5000) {
+        alice.poll();
+        bob.poll();
+        env.advance_time(10);
+
+        bob_conn_id = bob.get_connection_id_by_pk(alice.real_public_key());
+        if (alice.is_connected(alice_conn_id) && bob_conn_id != -1
+            && bob.is_connected(bob_conn_id)) {
+            connected = true;
+            break;
+        }
+    }
+    ASSERT_TRUE(connected);
+
+    alice.poll();
+    bob.poll();
+
+    const std::vector<std::uint8_t> message(100, 160);
+    auto send_until_refused = [&message](Net_Crypto *c, int conn_id) {
+        int sent = 0;
+        while (sent < CRYPTO_PACKET_BUFFER_SIZE
+            && write_cryptpacket(c, conn_id, message.data(), message.size(), true) != -1) {
+            ++sent;
+        }
+        return sent;
+    };
+
+    // Bob isn't paced, so he may send a whole queue at once. Alice may not.
+    EXPECT_GE(send_until_refused(bob.get_net_crypto(), bob_conn_id), CRYPTO_MIN_QUEUE_LENGTH);
+
+    const int burst = send_until_refused(alice.get_net_crypto(), alice_conn_id);
+    EXPECT_GT(burst, 0);
+    EXPECT_LT(burst, CRYPTO_MIN_QUEUE_LENGTH);
+
+    // Alice used up her budget, so she asks to be woken when it grows again.
+    const std::uint32_t interval = crypto_run_interval(alice.get_net_crypto());
+    EXPECT_GT(interval, 0u);
+    EXPECT_LE(interval, static_cast<std::uint32_t>(1000 / CRYPTO_PACKET_MIN_RATE + 1));
+
+    env.advance_time(interval);
+    alice.poll();
+    EXPECT_GT(send_until_refused(alice.get_net_crypto(), alice_conn_id), 0);
+}
+
 TEST_F(NetCryptoTest, CookieRequestCPUExhaustion)
 {
     NetCryptoNode victim(env, 33445);
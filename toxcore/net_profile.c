@@ -30,6 +30,9 @@ typedef struct Net_Profile {
 
     uint64_t total_bytes_recv;
     uint64_t total_bytes_sent;
+
+    uint64_t total_packets_dropped;
+    uint64_t total_bytes_dropped;
 } Net_Profile;
 
 /** Returns the number of sent or received packets for all ID's between `start_id` and `end_id`. */
@@ -135,6 +138,34 @@ uint64_t netprof_get_bytes_total(const Net_Profile *profile, Packet_Direction di
     return dir == PACKET_DIRECTION_SEND ? profile->total_bytes_sent : profile->total_bytes_recv;
 }
 
+void netprof_record_drop(Net_Profile *profile, size_t length)
+{
+    if (profile == nullptr) {
+        return;
+    }
+
+    ++profile->total_packets_dropped;
+    profile->total_bytes_dropped += length;
+}
+
+uint64_t netprof_get_packet_count_dropped(const Net_Profile *profile)
+{
+    if (profile == nullptr) {
+        return 0;
+    }
+
+    return profile->total_packets_dropped;
+}
+
+uint64_t netprof_get_bytes_dropped(const Net_Profile *profile)
+{
+    if (profile == nullptr) {
+        return 0;
+    }
+
+    return profile->total_bytes_dropped;
+}
+
 Net_Profile *netprof_new(const Logger *log, const Memory *mem)
 {
     Net_Profile *np = (Net_Profile *)mem_alloc(mem, sizeof(Net_Profile));
@@ -51,6 +51,19 @@ uint64_t netprof_get_bytes_id(const Net_Profile *_Nullable profile, uint8_t id,
  * Returns the total number of bytes sent or received for the given profile.
  */
 uint64_t netprof_get_bytes_total(const Net_Profile *_Nullable profile, Packet_Direction dir);
+/**
+ * Records a packet of size `length` that was dropped before it could be sent,
+ * e.g. because the connection's send queue was full.
+ */
+void netprof_record_drop(Net_Profile *_Nullable profile, size_t length);
+/**
+ * Returns the number of packets dropped before they could be sent.
+ */
+uint64_t netprof_get_packet_count_dropped(const Net_Profile *_Nullable profile);
+/**
+ * Returns the number of bytes in packets dropped before they could be sent.
+ */
+uint64_t netprof_get_bytes_dropped(const Net_Profile *_Nullable profile);
 /**
  * Returns a new net_profile object. The caller is responsible for freeing the
  * returned memory via `netprof_kill`.
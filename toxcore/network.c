@@ -71,6 +71,19 @@ int net_send(const Network *ns, const Logger *log,
     return res;
 }
 
+int net_sendv(const Network *ns, const Logger *log, Socket sock, const Net_Send_Vec *vecs, size_t count,
+              const IP_Port *ip_port, Net_Profile *net_profile)
+{
+    const int res = ns_sendv(ns, sock, vecs, count);
+
+    if (res > 0) {
+        netprof_record_packet(net_profile, vecs[0].buf[0], res, PACKET_DIRECTION_SEND);
+    }
+
+    net_log_data(log, "T=>", vecs[0].buf, vecs[0].length, ip_port, res);
+    return res;
+}
+
 int net_recv(const Network *ns, const Logger *log,
              Socket sock, uint8_t *buf, size_t len, const IP_Port *ip_port)
 {
@@ -110,11 +123,21 @@ bool set_socket_reuseaddr(const Network *ns, Socket sock)
     return net_set_socket_reuseaddr(ns, sock);
 }
 
+bool set_socket_reuseport(const Network *ns, Socket sock)
+{
+    return net_set_socket_reuseport(ns, sock);
+}
+
 bool set_socket_dualstack(const Network *ns, Socket sock)
 {
     return net_set_socket_dualstack(ns, sock);
 }
 
+/** Number of datagrams drained from the socket per receive call in networking_poll. */
+#define NET_RECV_BATCH_SIZE 16
+/** Number of datagrams handed to the OS per send call in net_send_packets. */
+#define NET_SEND_BATCH_SIZE 16
+
 typedef struct Packet_Handler {
     packet_handler_cb *_Nullable function;
     void *_Nullable object;
@@ -132,6 +155,12 @@ struct Networking_Core {
     Socket sock;
 
     Net_Profile *_Nullable udp_net_profile;
+
+    /* NET_RECV_BATCH_SIZE receive buffers of MAX_UDP_PACKET_SIZE bytes each. */
+    uint8_t *_Nullable recv_buf;
+
+    net_poll_done_cb *_Nullable poll_done_callback;
+    void *_Nullable poll_done_object;
 };
 
 Family net_family(const Networking_Core *net)
@@ -144,6 +173,11 @@ uint16_t net_port(const Networking_Core *net)
     return net->port;
 }
 
+Socket net_sock(const Networking_Core *net)
+{
+    return net->sock;
+}
+
 /* Basic network functions:
  */
 
@@ -163,31 +197,37 @@ bool net_socket_family_compatible(const Networking_Core *net, const IP_Port *ip_
     return false;
 }
 
-int net_send_packet(const Networking_Core *net, const IP_Port *ip_port, Net_Packet packet)
+/** @brief Check that a packet can be sent to `ip_port` and compute the address to pass to the OS.
+ *
+ * IPv4 destinations are converted to IPv4-in-IPv6 on dual-stack sockets.
+ *
+ * @retval true if `out` holds the destination address.
+ */
+static bool net_prepare_send(const Networking_Core *_Nonnull net, const IP_Port *_Nonnull ip_port, uint16_t length, IP_Port *_Nonnull out)
 {
-    IP_Port ipp_copy = *ip_port;
-
     if (net_family_is_unspec(ip_port->ip.family)) {
         // TODO(iphydf): Make this an error. Currently this fails sometimes when
         // called from DHT.c:do_ping_and_sendnode_requests.
-        return -1;
+        return false;
     }
 
     if (net_family_is_unspec(net->family)) { /* Socket not initialized */
         // TODO(iphydf): Make this an error. Currently, the onion client calls
         // this via DHT nodes requests.
-        LOGGER_WARNING(net->log, "attempted to send message of length %u on uninitialised socket", packet.length);
-        return -1;
+        LOGGER_WARNING(net->log, "attempted to send message of length %u on uninitialised socket", length);
+        return false;
     }
 
     /* socket TOX_AF_INET, but target IP NOT: can't send */
     if (!net_socket_family_compatible(net, ip_port, true)) {
         // TODO(iphydf): Make this an error. Occasionally we try to send to an
         // all-zero ip_port.
-        return -1;
+        return false;
     }
 
-    if (net_family_is_ipv4(ipp_copy.ip.family) && net_family_is_ipv6(net->family)) {
+    *out = *ip_port;
+
+    if (net_family_is_ipv4(out->ip.family) && net_family_is_ipv6(net->family)) {
         /* must convert to IPV4-in-IPV6 address */
         IP6 ip6;
 
@@ -196,10 +236,21 @@ int net_send_packet(const Networking_Core *net, const IP_Port *ip_port, Net_Pack
         ip6.uint32[0] = 0;
         ip6.uint32[1] = 0;
         ip6.uint32[2] = net_htonl(0xFFFF);
-        ip6.uint32[3] = ipp_copy.ip.ip.v4.uint32;
+        ip6.uint32[3] = out->ip.ip.v4.uint32;
 
-        ipp_copy.ip.family = net_family_ipv6();
-        ipp_copy.ip.ip.v6 = ip6;
+        out->ip.family = net_family_ipv6();
+        out->ip.ip.v6 = ip6;
+    }
+
+    return true;
+}
+
+int net_send_packet(const Networking_Core *net, const IP_Port *ip_port, Net_Packet packet)
+{
+    IP_Port ipp_copy;
+
+    if (!net_prepare_send(net, ip_port, packet.length, &ipp_copy)) {
+        return -1;
     }
 
     const long res = ns_sendto(net->ns, net->sock, packet.data, packet.length, &ipp_copy);
@@ -214,6 +265,57 @@ int net_send_packet(const Networking_Core *net, const IP_Port *ip_port, Net_Pack
     return (int)res;
 }
 
+int net_send_packets(const Networking_Core *net, const IP_Port *ip_ports, const Net_Packet *packets, uint16_t count)
+{
+    Net_Send_Msg msgs[NET_SEND_BATCH_SIZE];
+    const IP_Port *origs[NET_SEND_BATCH_SIZE];
+    uint16_t sent = 0;
+    uint16_t i = 0;
+
+    while (i < count) {
+        /* Collect the next batch of sendable packets. */
+        uint16_t batch = 0;
+
+        while (i < count && batch < NET_SEND_BATCH_SIZE) {
+            if (net_prepare_send(net, &ip_ports[i], packets[i].length, &msgs[batch].addr)) {
+                msgs[batch].buf = packets[i].data;
+                msgs[batch].length = packets[i].length;
+                origs[batch] = &ip_ports[i];
+                ++batch;
+            }
+
+            ++i;
+        }
+
+        uint16_t done = 0;
+
+        while (done < batch) {
+            const int res = ns_sendmmsg(net->ns, net->sock, &msgs[done], batch - done);
+
+            if (res <= 0) {
+                /* The first message failed; log it and move on to the rest. */
+                net_log_data(net->log, "O=>", msgs[done].buf, msgs[done].length, origs[done], -1);
+                ++done;
+                continue;
+            }
+
+            for (int j = 0; j < res; ++j) {
+                const Net_Send_Msg *const msg = &msgs[done + j];
+                net_log_data(net->log, "O=>", msg->buf, msg->length, origs[done + j], msg->length);
+
+                if (msg->length > 0) {
+                    netprof_record_packet(net->udp_net_profile, msg->buf[0], msg->length, PACKET_DIRECTION_SEND);
+                }
+            }
+
+            done += (uint16_t)res;
+            sent += (uint16_t)res;
+        }
+    }
+
+    return sent;
+}
+
 /**
  * Function to send packet(data) of length length to ip_port.
  *
@@ -225,19 +327,22 @@ int sendpacket(const Networking_Core *net, const IP_Port *ip_port, const uint8_t
     return net_send_packet(net, ip_port, packet);
 }
 
-/** @brief Function to receive data
- * ip and port of sender is put into ip_port.
- * Packet data is put into data.
- * Packet length is put into length.
+/** @brief Receive a batch of datagrams into the slots in `msgs`.
+ *
+ * IPv4-in-IPv6 sender addresses are converted back to plain IPv4.
+ *
+ * @return the number of slots filled, or -1 if nothing was received.
  */
-static int receivepacket(const Network *_Nonnull ns, const Logger *_Nonnull log, Socket sock, IP_Port *_Nonnull ip_port, uint8_t *_Nonnull data, uint32_t *_Nonnull length)
+static int receivepackets(const Network *_Nonnull ns, const Logger *_Nonnull log, Socket sock, Net_Recv_Msg *_Nonnull msgs, size_t count)
 {
-    memset(ip_port, 0, sizeof(IP_Port));
-    *length = 0;
+    for (size_t i = 0; i < count; ++i) {
+        memset(&msgs[i].addr, 0, sizeof(IP_Port));
+        msgs[i].length = 0;
+    }
 
-    const int fail_or_len = ns_recvfrom(ns, sock, data, MAX_UDP_PACKET_SIZE, ip_port);
+    const int fail_or_count = ns_recvmmsg(ns, sock, msgs, count);
 
-    if (fail_or_len < 0) {
+    if (fail_or_count < 0) {
         const int error = net_error();
 
         if (!net_should_ignore_recv_error(error)) {
@@ -248,16 +353,18 @@ static int receivepacket(const Network *_Nonnull ns, const Logger *_Nonnull log,
         return -1; /* Nothing received. */
     }
 
-    *length = (uint32_t)fail_or_len;
+    for (int i = 0; i < fail_or_count; ++i) {
+        IP_Port *const ip_port = &msgs[i].addr;
 
-    if (net_family_is_ipv6(ip_port->ip.family) && ipv6_ipv4_in_v6(&ip_port->ip.ip.v6)) {
-        ip_port->ip.family = net_family_ipv4();
-        ip_port->ip.ip.v4.uint32 = ip_port->ip.ip.v6.uint32[3];
-    }
+        if (net_family_is_ipv6(ip_port->ip.family) && ipv6_ipv4_in_v6(&ip_port->ip.ip.v6)) {
+            ip_port->ip.family = net_family_ipv4();
+            ip_port->ip.ip.v4.uint32 = ip_port->ip.ip.v6.uint32[3];
+        }
 
-    net_log_data(log, "=>O", data, MAX_UDP_PACKET_SIZE, ip_port, *length);
+        net_log_data(log, "=>O", msgs[i].buf, MAX_UDP_PACKET_SIZE, ip_port, msgs[i].length);
+    }
 
-    return 0;
+    return fail_or_count;
 }
 
 void networking_registerhandler(Networking_Core *net, uint8_t byte, packet_handler_cb *cb, void *object)
@@ -266,6 +373,18 @@ void networking_registerhandler(Networking_Core *net, uint8_t byte, packet_handl
     net->packethandlers[byte].object = object;
 }
 
+packet_handler_cb *networking_get_handler(const Networking_Core *net, uint8_t byte, void **object)
+{
+    *object = net->packethandlers[byte].object;
+    return net->packethandlers[byte].function;
+}
+
+void networking_register_poll_done(Networking_Core *net, net_poll_done_cb *cb, void *object)
+{
+    net->poll_done_callback = cb;
+    net->poll_done_object = object;
+}
+
 void networking_poll(const Networking_Core *net, void *userdata)
 {
     if (net_family_is_unspec(net->family)) {
@@ -273,27 +392,45 @@ void networking_poll(const Networking_Core *net, void *userdata)
         return;
     }
 
-    IP_Port ip_port;
-    uint8_t data[MAX_UDP_PACKET_SIZE] = {0};
-    uint32_t length;
+    if (net->recv_buf == nullptr) {
+        return;
+    }
 
-    while (receivepacket(net->ns, net->log, net->sock, &ip_port, data, &length) != -1) {
-        if (length < 1) {
-            continue;
-        }
+    Net_Recv_Msg msgs[NET_RECV_BATCH_SIZE];
+
+    for (uint32_t i = 0; i < NET_RECV_BATCH_SIZE; ++i) {
+        msgs[i].buf = &net->recv_buf[i * MAX_UDP_PACKET_SIZE];
+        msgs[i].size = MAX_UDP_PACKET_SIZE;
+    }
 
-        netprof_record_packet(net->udp_net_profile, data[0], length, PACKET_DIRECTION_RECV);
+    int received;
 
-        const Packet_Handler *const handler = &net->packethandlers[data[0]];
+    while ((received = receivepackets(net->ns, net->log, net->sock, msgs, NET_RECV_BATCH_SIZE)) > 0) {
+        for (int i = 0; i < received; ++i) {
+            const uint8_t *const data = msgs[i].buf;
+            const uint32_t length = (uint32_t)msgs[i].length;
+
+            if (length < 1) {
+                continue;
+            }
 
-        if (handler->function == nullptr) {
-            // TODO(https://github.com/TokTok/c-toxcore/issues/1115): Make this
-            // a warning or error again.
-            LOGGER_DEBUG(net->log, "[%02u] -- Packet has no handler", data[0]);
-            continue;
+            netprof_record_packet(net->udp_net_profile, data[0], length, PACKET_DIRECTION_RECV);
+
+            const Packet_Handler *const handler = &net->packethandlers[data[0]];
+
+            if (handler->function == nullptr) {
+                // TODO(https://github.com/TokTok/c-toxcore/issues/1115): Make this
+                // a warning or error again.
+                LOGGER_DEBUG(net->log, "[%02u] -- Packet has no handler", data[0]);
+                continue;
+            }
+
+            handler->function(handler->object, &msgs[i].addr, data, length, userdata);
         }
+    }
 
-        handler->function(handler->object, &ip_port, data, length, userdata);
+    if (net->poll_done_callback != nullptr) {
+        net->poll_done_callback(net->poll_done_object, userdata);
     }
 }
 
@@ -351,6 +488,15 @@ Networking_Core *new_networking_ex(
         return nullptr;
     }
 
+    uint8_t *recv_buf = (uint8_t *)mem_balloc(mem, NET_RECV_BATCH_SIZE * MAX_UDP_PACKET_SIZE);
+
+    if (recv_buf == nullptr) {
+        netprof_kill(mem, np);
+        mem_delete(mem, temp);
+        return nullptr;
+    }
+
+    temp->recv_buf = recv_buf;
     temp->udp_net_profile = np;
     temp->ns = ns;
     temp->log = log;
@@ -368,6 +514,7 @@ Networking_Core *new_networking_ex(
         Net_Strerror error_str;
         LOGGER_ERROR(log, "failed to get a socket?! %d, %s", neterror, net_strerror(neterror, &error_str));
         netprof_kill(mem, temp->udp_net_profile);
+        mem_delete(mem, temp->recv_buf);
         mem_delete(mem, temp);
 
         if (error != nullptr) {
@@ -420,6 +567,7 @@ Networking_Core *new_networking_ex(
         addr.port = 0;
         portptr = &addr.port;
     } else {
+        mem_delete(mem, temp->recv_buf);
         mem_delete(mem, temp);
         return nullptr;
     }
@@ -539,6 +687,7 @@ void kill_networking(Networking_Core *net)
     }
 
     netprof_kill(net->mem, net->udp_net_profile);
+    mem_delete(net->mem, net->recv_buf);
     mem_delete(net->mem, net);
 }
 
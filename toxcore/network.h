@@ -108,6 +108,16 @@ bool sock_valid(Socket sock);
  */
 int net_send(const Network *_Nonnull ns, const Logger *_Nonnull log, Socket sock, const uint8_t *_Nonnull buf, size_t len, const IP_Port *_Nonnull ip_port,
              Net_Profile *_Nullable net_profile);
+/**
+ * Sends the concatenation of `count` buffers in one call, like writev.
+ *
+ * The whole write is recorded in `net_profile` as one packet, identified by
+ * the first byte of the first buffer, just like net_send.
+ *
+ * @param vecs Buffers to send, in order. `count` must be at least 1.
+ */
+int net_sendv(const Network *_Nonnull ns, const Logger *_Nonnull log, Socket sock, const Net_Send_Vec *_Nonnull vecs, size_t count,
+              const IP_Port *_Nonnull ip_port, Net_Profile *_Nullable net_profile);
 /**
  * Calls recv(sockfd, buf, len, MSG_NOSIGNAL).
  *
@@ -257,6 +267,19 @@ typedef struct Networking_Core Networking_Core;
 
 Family net_family(const Networking_Core *_Nonnull net);
 uint16_t net_port(const Networking_Core *_Nonnull net);
+/** @brief Our UDP socket. Only valid if `net_family` is not unspecified. */
+Socket net_sock(const Networking_Core *_Nonnull net);
+
+/**
+ * @brief Callback for enumerating the sockets owned by a networking object.
+ *
+ * @param sock A socket that has incoming data to be processed when readable.
+ * @param sock_id Tells `sock` apart from an earlier, closed socket that had the
+ *   same descriptor. 0 for sockets that live as long as their owner.
+ * @param want_write True if the owner has queued outgoing data and would like
+ *   to be woken up when the socket becomes writable.
+ */
+typedef void net_socket_visit_cb(void *_Nonnull obj, Socket sock, uint64_t sock_id, bool want_write);
 
 /** Close the socket. */
 void kill_sock(const Network *_Nonnull ns, Socket sock);
@@ -282,6 +305,15 @@ bool set_socket_nosigpipe(const Network *_Nonnull ns, Socket sock);
  */
 bool set_socket_reuseaddr(const Network *_Nonnull ns, Socket sock);
 
+/**
+ * Enable SO_REUSEPORT on socket, so several sockets can listen on the same
+ * port and the kernel spreads incoming connections between them.
+ *
+ * @return true on success, false on failure or if the platform has no
+ *   SO_REUSEPORT.
+ */
+bool set_socket_reuseport(const Network *_Nonnull ns, Socket sock);
+
 /**
  * Set socket to dual (IPv4 + IPv6 socket)
  *
@@ -314,6 +346,17 @@ bool net_socket_family_compatible(const Networking_Core *_Nonnull net, const IP_
  */
 int net_send_packet(const Networking_Core *_Nonnull net, const IP_Port *_Nonnull ip_port, Net_Packet packet);
 
+/**
+ * @brief Send a batch of network packets, each to its own IP/port.
+ *
+ * `packets[i]` is sent to `ip_ports[i]`. The packets are handed to the OS in
+ * as few system calls as the network stack allows. Packets that could not
+ * be sent (e.g. because of an incompatible address family) are skipped.
+ *
+ * @return the number of packets sent.
+ */
+int net_send_packets(const Networking_Core *_Nonnull net, const IP_Port *_Nonnull ip_ports, const Net_Packet *_Nonnull packets, uint16_t count);
+
 /**
  * Function to send packet(data) of length length to ip_port.
  *
@@ -323,6 +366,19 @@ int sendpacket(const Networking_Core *_Nonnull net, const IP_Port *_Nonnull ip_p
 
 /** Function to call when packet beginning with byte is received. */
 void networking_registerhandler(Networking_Core *_Nonnull net, uint8_t byte, packet_handler_cb *_Nullable cb, void *_Nullable object);
+
+/** @brief Get the function and object registered for packets beginning with byte. */
+packet_handler_cb *_Nullable networking_get_handler(const Networking_Core *_Nonnull net, uint8_t byte, void *_Nullable *_Nonnull object);
+
+/** @brief Function to call once networking_poll has handed out all packets it read. */
+typedef void net_poll_done_cb(void *_Nullable object, void *_Nullable userdata);
+
+/** @brief Set the function called at the end of each networking_poll.
+ *
+ * Lets a packet handler that defers work, e.g. to process packets in
+ * batches, finish it before networking_poll returns. Pass NULL to unset.
+ */
+void networking_register_poll_done(Networking_Core *_Nonnull net, net_poll_done_cb *_Nullable cb, void *_Nullable object);
 /** Call this several times a second. */
 void networking_poll(const Networking_Core *_Nonnull net, void *_Nullable userdata);
 typedef enum Net_Err_Connect {
@@ -34,7 +34,7 @@
 #define KEY_REFRESH_INTERVAL (2 * 60 * 60)
 
 // Settings for the shared key cache
-#define MAX_KEYS_PER_SLOT 4
+#define KEYS_CACHE_CAPACITY 512
 #define KEYS_TIMEOUT 600
 
 /** Change symmetric keys every 2 hours to make paths expire eventually. */
@@ -739,9 +739,9 @@ Onion *new_onion(const Logger *log, const Memory *mem, const Mono_Time *mono_tim
     onion->timestamp = mono_time_get(onion->mono_time);
 
     const uint8_t *secret_key = dht_get_self_secret_key(dht);
-    Shared_Key_Cache *const temp_shared_keys_1 = shared_key_cache_new(log, mono_time, mem, secret_key, KEYS_TIMEOUT, MAX_KEYS_PER_SLOT);
-    Shared_Key_Cache *const temp_shared_keys_2 = shared_key_cache_new(log, mono_time, mem, secret_key, KEYS_TIMEOUT, MAX_KEYS_PER_SLOT);
-    Shared_Key_Cache *const temp_shared_keys_3 = shared_key_cache_new(log, mono_time, mem, secret_key, KEYS_TIMEOUT, MAX_KEYS_PER_SLOT);
+    Shared_Key_Cache *const temp_shared_keys_1 = shared_key_cache_new(log, mono_time, mem, rng, secret_key, KEYS_TIMEOUT, KEYS_CACHE_CAPACITY);
+    Shared_Key_Cache *const temp_shared_keys_2 = shared_key_cache_new(log, mono_time, mem, rng, secret_key, KEYS_TIMEOUT, KEYS_CACHE_CAPACITY);
+    Shared_Key_Cache *const temp_shared_keys_3 = shared_key_cache_new(log, mono_time, mem, rng, secret_key, KEYS_TIMEOUT, KEYS_CACHE_CAPACITY);
 
     if (temp_shared_keys_1 == nullptr || temp_shared_keys_2 == nullptr || temp_shared_keys_3 == nullptr) {
         shared_key_cache_free(temp_shared_keys_3);
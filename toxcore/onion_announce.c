@@ -40,7 +40,7 @@
 #define ONION_MINIMAL_SIZE (ONION_PING_ID_SIZE + CRYPTO_PUBLIC_KEY_SIZE * 2 + ONION_ANNOUNCE_SENDBACK_DATA_LENGTH)
 
 /* Settings for the shared key cache */
-#define MAX_KEYS_PER_SLOT 4
+#define KEYS_CACHE_CAPACITY 512
 #define KEYS_TIMEOUT 600
 
 static_assert(ONION_PING_ID_SIZE == CRYPTO_PUBLIC_KEY_SIZE,
@@ -693,7 +693,7 @@ Onion_Announce *new_onion_announce(const Logger *log, const Memory *mem, const R
         return nullptr;
     }
 
-    Shared_Key_Cache *const shared_keys_recv = shared_key_cache_new(log, mono_time, mem, dht_get_self_secret_key(dht), KEYS_TIMEOUT, MAX_KEYS_PER_SLOT);
+    Shared_Key_Cache *const shared_keys_recv = shared_key_cache_new(log, mono_time, mem, rng, dht_get_self_secret_key(dht), KEYS_TIMEOUT, KEYS_CACHE_CAPACITY);
     if (shared_keys_recv == nullptr) {
         mem_delete(mem, onion_a);
         return nullptr;
@@ -733,3 +733,8 @@ void kill_onion_announce(Onion_Announce *onion_a)
 
     mem_delete(onion_a->mem, onion_a);
 }
+
+const Shared_Key_Cache *onion_announce_get_shared_keys(const Onion_Announce *onion_a)
+{
+    return onion_a->shared_keys_recv;
+}
@@ -20,6 +20,7 @@
 #include "net.h"
 #include "network.h"
 #include "onion.h"
+#include "shared_key_cache.h"
 #include "timed_auth.h"
 
 #define ONION_ANNOUNCE_MAX_ENTRIES 160
@@ -136,6 +137,9 @@ Onion_Announce *_Nullable new_onion_announce(const Logger *_Nonnull log, const M
 
 void kill_onion_announce(Onion_Announce *_Nullable onion_a);
 
+/** @brief The shared key cache for incoming announce requests. */
+const Shared_Key_Cache *_Nonnull onion_announce_get_shared_keys(const Onion_Announce *_Nonnull onion_a);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
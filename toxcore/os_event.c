@@ -229,8 +229,11 @@ static bool os_ev_del(void *_Nonnull self, Socket sock)
     for (uint32_t i = 0; i < os_ev->regs_count; ++i) {
         if (net_socket_to_native(os_ev->regs[i]->sock) == net_socket_to_native(sock)) {
             if (epoll_ctl(os_ev->epoll_fd, EPOLL_CTL_DEL, net_socket_to_native(sock), nullptr) == -1) {
-                Net_Strerror error_buf;
-                LOGGER_ERROR(os_ev->log, "epoll_ctl(DEL) failed: %s", net_strerror(errno, &error_buf));
+                // Closed sockets are removed from the epoll set automatically.
+                if (errno != EBADF && errno != ENOENT) {
+                    Net_Strerror error_buf;
+                    LOGGER_ERROR(os_ev->log, "epoll_ctl(DEL) failed: %s", net_strerror(errno, &error_buf));
+                }
             }
 
             LOGGER_DEBUG(os_ev->log, "Removed socket %d from epoll", net_socket_to_native(sock));
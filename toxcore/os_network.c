@@ -12,6 +12,11 @@
 #define __EXTENSIONS__ 1
 #endif /* __sun */
 
+// For recvmmsg/sendmmsg on Linux.
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif /* defined(__linux__) && !defined(_GNU_SOURCE) */
+
 // For Linux (and some BSDs).
 #ifndef _XOPEN_SOURCE
 #define _XOPEN_SOURCE 700
@@ -436,6 +441,108 @@ static int sys_recvfrom(void *_Nullable obj, Socket sock, uint8_t *_Nonnull buf,
     return ret;
 }
 
+#ifdef __linux__
+/** Maximum number of datagrams handed to the kernel in one recvmmsg/sendmmsg call. */
+#define SYS_MMSG_MAX 64
+
+static int sys_recvmmsg(void *_Nullable obj, Socket sock, Net_Recv_Msg *_Nonnull msgs, size_t count)
+{
+    struct mmsghdr hdrs[SYS_MMSG_MAX];
+    struct iovec iovs[SYS_MMSG_MAX];
+    Network_Addr naddrs[SYS_MMSG_MAX];
+
+    if (count > SYS_MMSG_MAX) {
+        count = SYS_MMSG_MAX;
+    }
+
+    memset(hdrs, 0, count * sizeof(hdrs[0]));
+
+    for (size_t i = 0; i < count; ++i) {
+        iovs[i].iov_base = msgs[i].buf;
+        iovs[i].iov_len = msgs[i].size;
+        hdrs[i].msg_hdr.msg_name = &naddrs[i].addr;
+        hdrs[i].msg_hdr.msg_namelen = sizeof(naddrs[i].addr);
+        hdrs[i].msg_hdr.msg_iov = &iovs[i];
+        hdrs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    const int ret = recvmmsg(net_socket_to_native(sock), hdrs, (unsigned int)count, 0, nullptr);
+
+    for (int i = 0; i < ret; ++i) {
+        naddrs[i].size = hdrs[i].msg_hdr.msg_namelen;
+        msgs[i].length = hdrs[i].msg_len;
+
+        if (!network_addr_to_ip_port(&naddrs[i], &msgs[i].addr)) {
+            // Ignore packets from unknown families
+            msgs[i].length = 0;
+        }
+    }
+
+    return ret;
+}
+
+static int sys_sendmmsg(void *_Nullable obj, Socket sock, const Net_Send_Msg *_Nonnull msgs, size_t count)
+{
+    struct mmsghdr hdrs[SYS_MMSG_MAX];
+    struct iovec iovs[SYS_MMSG_MAX];
+    Network_Addr naddrs[SYS_MMSG_MAX];
+
+    if (count > SYS_MMSG_MAX) {
+        count = SYS_MMSG_MAX;
+    }
+
+    memset(hdrs, 0, count * sizeof(hdrs[0]));
+
+    for (size_t i = 0; i < count; ++i) {
+        ip_port_to_network_addr(&msgs[i].addr, &naddrs[i]);
+
+        if (naddrs[i].size == 0) {
+            // Only send the valid prefix; the caller retries from here.
+            count = i;
+            break;
+        }
+
+        iovs[i].iov_base = (void *)(uintptr_t)msgs[i].buf;
+        iovs[i].iov_len = msgs[i].length;
+        hdrs[i].msg_hdr.msg_name = &naddrs[i].addr;
+        hdrs[i].msg_hdr.msg_namelen = (socklen_t)naddrs[i].size;
+        hdrs[i].msg_hdr.msg_iov = &iovs[i];
+        hdrs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    if (count == 0) {
+        return -1;
+    }
+
+    return sendmmsg(net_socket_to_native(sock), hdrs, (unsigned int)count, 0);
+}
+#endif /* __linux__ */
+
+#ifndef OS_WIN32
+/** Maximum number of buffers handed to the kernel in one sendmsg call. */
+#define SYS_SENDV_MAX 16
+
+static int sys_sendv(void *_Nullable obj, Socket sock, const Net_Send_Vec *_Nonnull vecs, size_t count)
+{
+    struct iovec iovs[SYS_SENDV_MAX];
+
+    if (count > SYS_SENDV_MAX) {
+        count = SYS_SENDV_MAX;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        iovs[i].iov_base = (void *)(uintptr_t)vecs[i].buf;
+        iovs[i].iov_len = vecs[i].length;
+    }
+
+    struct msghdr hdr = {nullptr};
+    hdr.msg_iov = iovs;
+    hdr.msg_iovlen = count;
+
+    return (int)sendmsg(net_socket_to_native(sock), &hdr, MSG_NOSIGNAL);
+}
+#endif /* OS_WIN32 */
+
 static Socket sys_socket(void *_Nullable obj, int domain, int type, int proto)
 {
     const int platform_domain = make_family(domain);
@@ -562,6 +669,18 @@ static const Network_Funcs os_network_funcs = {
     sys_setsockopt,
     sys_getaddrinfo,
     sys_freeaddrinfo,
+#ifdef __linux__
+    sys_recvmmsg,
+    sys_sendmmsg,
+#else
+    nullptr,
+    nullptr,
+#endif /* __linux__ */
+#ifndef OS_WIN32
+    sys_sendv,
+#else
+    nullptr,
+#endif /* OS_WIN32 */
 };
 const Network os_network_obj = {&os_network_funcs, nullptr};
 
@@ -688,6 +807,16 @@ bool net_set_socket_reuseaddr(const Network *ns, Socket sock)
 #endif /* OS_WIN32 */
 }
 
+bool net_set_socket_reuseport(const Network *ns, Socket sock)
+{
+#ifdef SO_REUSEPORT
+    int set = 1;
+    return ns_setsockopt(ns, sock, SOL_SOCKET, SO_REUSEPORT, &set, sizeof(set)) == 0;
+#else
+    return false;
+#endif /* SO_REUSEPORT */
+}
+
 bool net_set_socket_dualstack(const Network *ns, Socket sock)
 {
     int ipv6only = 0;
@@ -0,0 +1,210 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include "pk_index.h"
+
+#include <string.h>
+
+#include "ccompat.h"
+
+/** Smallest table size. Must be a power of 2. */
+#define PK_INDEX_MIN_CAPACITY 16
+
+typedef struct PK_Index_Slot {
+    uint8_t public_key[CRYPTO_PUBLIC_KEY_SIZE];
+    uint32_t id;
+    bool occupied;
+} PK_Index_Slot;
+
+static const PK_Index_Slot empty_slot = {{0}};
+
+struct PK_Index {
+    const Memory *_Nonnull mem;
+
+    uint64_t seed;
+
+    PK_Index_Slot *_Nonnull slots;
+    /* Always a power of 2, and at least twice `count`. */
+    uint32_t capacity;
+    uint32_t count;
+};
+
+static uint64_t load_u64(const uint8_t *_Nonnull bytes)
+{
+    uint64_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+uint64_t pk_index_hash(uint64_t seed, const uint8_t public_key[CRYPTO_PUBLIC_KEY_SIZE])
+{
+    uint64_t h = seed;
+
+    for (uint32_t i = 0; i < CRYPTO_PUBLIC_KEY_SIZE; i += sizeof(uint64_t)) {
+        h ^= load_u64(public_key + i);
+        h *= 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 29;
+    }
+
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+static uint32_t pk_index_home(const PK_Index *_Nonnull index, const uint8_t *_Nonnull public_key)
+{
+    return (uint32_t)pk_index_hash(index->seed, public_key) & (index->capacity - 1);
+}
+
+/** @brief Find the slot holding `public_key`, or the empty slot where it would go. */
+static uint32_t pk_index_find_slot(const PK_Index *_Nonnull index, const uint8_t *_Nonnull public_key)
+{
+    const uint32_t mask = index->capacity - 1;
+    uint32_t i = pk_index_home(index, public_key);
+
+    while (index->slots[i].occupied && !pk_equal(index->slots[i].public_key, public_key)) {
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+static bool pk_index_resize(PK_Index *_Nonnull index, uint32_t new_capacity)
+{
+    PK_Index_Slot *new_slots = (PK_Index_Slot *)mem_valloc(index->mem, new_capacity, sizeof(PK_Index_Slot));
+
+    if (new_slots == nullptr) {
+        return false;
+    }
+
+    PK_Index_Slot *old_slots = index->slots;
+    const uint32_t old_capacity = index->capacity;
+
+    index->slots = new_slots;
+    index->capacity = new_capacity;
+
+    for (uint32_t i = 0; i < old_capacity; ++i) {
+        if (old_slots[i].occupied) {
+            new_slots[pk_index_find_slot(index, old_slots[i].public_key)] = old_slots[i];
+        }
+    }
+
+    mem_delete(index->mem, old_slots);
+    return true;
+}
+
+PK_Index *pk_index_new(const Memory *mem, const Random *rng)
+{
+    PK_Index *index = (PK_Index *)mem_alloc(mem, sizeof(PK_Index));
+
+    if (index == nullptr) {
+        return nullptr;
+    }
+
+    PK_Index_Slot *slots = (PK_Index_Slot *)mem_valloc(mem, PK_INDEX_MIN_CAPACITY, sizeof(PK_Index_Slot));
+
+    if (slots == nullptr) {
+        mem_delete(mem, index);
+        return nullptr;
+    }
+
+    index->mem = mem;
+    index->seed = random_u64(rng);
+    index->slots = slots;
+    index->capacity = PK_INDEX_MIN_CAPACITY;
+
+    return index;
+}
+
+void pk_index_kill(PK_Index *index)
+{
+    if (index == nullptr) {
+        return;
+    }
+
+    mem_delete(index->mem, index->slots);
+    mem_delete(index->mem, index);
+}
+
+bool pk_index_add(PK_Index *index, const uint8_t public_key[CRYPTO_PUBLIC_KEY_SIZE], uint32_t id)
+{
+    uint32_t i = pk_index_find_slot(index, public_key);
+
+    if (index->slots[i].occupied) {
+        index->slots[i].id = id;
+        return true;
+    }
+
+    if ((index->count + 1) * 2 > index->capacity) {
+        if (index->capacity > UINT32_MAX / 2 || !pk_index_resize(index, index->capacity * 2)) {
+            return false;
+        }
+
+        i = pk_index_find_slot(index, public_key);
+    }
+
+    PK_Index_Slot *slot = &index->slots[i];
+    memcpy(slot->public_key, public_key, CRYPTO_PUBLIC_KEY_SIZE);
+    slot->id = id;
+    slot->occupied = true;
+    ++index->count;
+
+    return true;
+}
+
+bool pk_index_remove(PK_Index *index, const uint8_t public_key[CRYPTO_PUBLIC_KEY_SIZE])
+{
+    const uint32_t mask = index->capacity - 1;
+    uint32_t hole = pk_index_find_slot(index, public_key);
+
+    if (!index->slots[hole].occupied) {
+        return false;
+    }
+
+    /* Backward-shift deletion: move later entries of the probe run into the
+     * hole if their home slot is not between the hole and their position. This
+     * keeps lookups correct without tombstones. */
+    uint32_t i = hole;
+
+    while (true) {
+        i = (i + 1) & mask;
+
+        if (!index->slots[i].occupied) {
+            break;
+        }
+
+        const uint32_t home = pk_index_home(index, index->slots[i].public_key);
+
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            index->slots[hole] = index->slots[i];
+            hole = i;
+        }
+    }
+
+    index->slots[hole] = empty_slot;
+    --index->count;
+
+    if (index->capacity > PK_INDEX_MIN_CAPACITY && index->count < index->capacity / 8) {
+        /* Shrinking is best-effort: on failure the larger table stays valid. */
+        pk_index_resize(index, index->capacity / 2);
+    }
+
+    return true;
+}
+
+int64_t pk_index_get(const PK_Index *index, const uint8_t public_key[CRYPTO_PUBLIC_KEY_SIZE])
+{
+    const PK_Index_Slot *slot = &index->slots[pk_index_find_slot(index, public_key)];
+
+    if (!slot->occupied) {
+        return -1;
+    }
+
+    return slot->id;
+}
+
+uint32_t pk_index_size(const PK_Index *index)
+{
+    return index->count;
+}
@@ -0,0 +1,72 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+/**
+ * Hash index from 32 byte public keys to small integer ids.
+ *
+ * This is an open-addressing hash table with linear probing, used to replace
+ * linear scans over connection arrays when looking up a connection by the
+ * peer's public key. Keys are hashed with a per-instance random seed, so peers
+ * can't choose keys that collide in every instance.
+ */
+#ifndef C_TOXCORE_TOXCORE_PK_INDEX_H
+#define C_TOXCORE_TOXCORE_PK_INDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "attributes.h"
+#include "crypto_core.h"
+#include "mem.h"
+#include "rng.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct PK_Index PK_Index;
+
+/** @brief Seeded 64 bit hash over all bytes of a public key.
+ *
+ * Public keys are uniformly random for honest peers, but a peer can pick its
+ * key freely. Hashing with a secret random seed keeps the position of a key in
+ * a hash table unpredictable, so peers can't flood a single bucket.
+ */
+uint64_t pk_index_hash(uint64_t seed, const uint8_t public_key[_Nonnull CRYPTO_PUBLIC_KEY_SIZE]);
+
+/** @brief Create a new, empty public key index. */
+PK_Index *_Nullable pk_index_new(const Memory *_Nonnull mem, const Random *_Nonnull rng);
+
+/** @brief Free the index. The ids it maps to are not touched. */
+void pk_index_kill(PK_Index *_Nullable index);
+
+/** @brief Map `public_key` to `id`, replacing any previous mapping for that key.
+ *
+ * @retval true on success.
+ * @retval false if memory allocation failed. The index is unchanged.
+ */
+bool pk_index_add(PK_Index *_Nonnull index, const uint8_t public_key[_Nonnull CRYPTO_PUBLIC_KEY_SIZE], uint32_t id);
+
+/** @brief Remove the mapping for `public_key`.
+ *
+ * @retval true if the key was in the index.
+ * @retval false if it was not.
+ */
+bool pk_index_remove(PK_Index *_Nonnull index, const uint8_t public_key[_Nonnull CRYPTO_PUBLIC_KEY_SIZE]);
+
+/** @brief Look up the id mapped to `public_key`.
+ *
+ * @return the id on success.
+ * @retval -1 if the key is not in the index.
+ */
+int64_t pk_index_get(const PK_Index *_Nonnull index, const uint8_t public_key[_Nonnull CRYPTO_PUBLIC_KEY_SIZE]);
+
+/** @brief Number of keys in the index. */
+uint32_t pk_index_size(const PK_Index *_Nonnull index);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* C_TOXCORE_TOXCORE_PK_INDEX_H */
@@ -0,0 +1,132 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include "pk_index.h"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "crypto_core.h"
+#include "os_memory.h"
+#include "os_random.h"
+
+namespace {
+
+using PublicKey = std::array<std::uint8_t, CRYPTO_PUBLIC_KEY_SIZE>;
+
+class PkIndexTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        const Random *rng = os_random();
+        ASSERT_NE(rng, nullptr);
+        index = pk_index_new(os_memory(), rng);
+        ASSERT_NE(index, nullptr);
+    }
+
+    void TearDown() override { pk_index_kill(index); }
+
+    PublicKey random_key()
+    {
+        PublicKey pk;
+        for (auto &b : pk) {
+            b = static_cast<std::uint8_t>(gen());
+        }
+        return pk;
+    }
+
+    PK_Index *index = nullptr;
+    std::mt19937 gen{42};
+};
+
+TEST_F(PkIndexTest, EmptyIndexFindsNothing)
+{
+    const PublicKey pk = random_key();
+    EXPECT_EQ(pk_index_get(index, pk.data()), -1);
+    EXPECT_FALSE(pk_index_remove(index, pk.data()));
+    EXPECT_EQ(pk_index_size(index), 0);
+}
+
+TEST_F(PkIndexTest, AddGetRemove)
+{
+    const PublicKey pk = random_key();
+    ASSERT_TRUE(pk_index_add(index, pk.data(), 7));
+    EXPECT_EQ(pk_index_get(index, pk.data()), 7);
+    EXPECT_EQ(pk_index_size(index), 1);
+
+    // Adding the same key again replaces the id.
+    ASSERT_TRUE(pk_index_add(index, pk.data(), 9));
+    EXPECT_EQ(pk_index_get(index, pk.data()), 9);
+    EXPECT_EQ(pk_index_size(index), 1);
+
+    EXPECT_TRUE(pk_index_remove(index, pk.data()));
+    EXPECT_EQ(pk_index_get(index, pk.data()), -1);
+    EXPECT_EQ(pk_index_size(index), 0);
+}
+
+TEST_F(PkIndexTest, KeysDifferingInLastByteAreDistinct)
+{
+    PublicKey a{};
+    PublicKey b{};
+    b[CRYPTO_PUBLIC_KEY_SIZE - 1] = 1;
+
+    ASSERT_TRUE(pk_index_add(index, a.data(), 1));
+    ASSERT_TRUE(pk_index_add(index, b.data(), 2));
+    EXPECT_EQ(pk_index_get(index, a.data()), 1);
+    EXPECT_EQ(pk_index_get(index, b.data()), 2);
+}
+
+TEST_F(PkIndexTest, MatchesReferenceMapUnderRandomOperations)
+{
+    std::map<PublicKey, std::uint32_t> reference;
+    std::vector<PublicKey> keys;
+
+    for (int i = 0; i < 2000; ++i) {
+        keys.push_back(random_key());
+    }
+
+    // Grow to 2000 entries, then remove and re-add at random, then shrink back
+    // to empty. This exercises resizing in both directions and deletion from
+    // the middle of probe runs.
+    for (std::uint32_t i = 0; i < keys.size(); ++i) {
+        ASSERT_TRUE(pk_index_add(index, keys[i].data(), i));
+        reference[keys[i]] = i;
+    }
+
+    for (int round = 0; round < 10000; ++round) {
+        const PublicKey &pk = keys[gen() % keys.size()];
+
+        if (gen() % 2 == 0) {
+            EXPECT_EQ(pk_index_remove(index, pk.data()), reference.erase(pk) == 1);
+        } else {
+            const std::uint32_t id = gen();
+            ASSERT_TRUE(pk_index_add(index, pk.data(), id));
+            reference[pk] = id;
+        }
+    }
+
+    ASSERT_EQ(pk_index_size(index), reference.size());
+
+    for (const PublicKey &pk : keys) {
+        const auto it = reference.find(pk);
+        EXPECT_EQ(pk_index_get(index, pk.data()), it == reference.end() ? -1 : std::int64_t{it->second});
+    }
+
+    for (const auto &[pk, id] : reference) {
+        EXPECT_TRUE(pk_index_remove(index, pk.data()));
+    }
+
+    EXPECT_EQ(pk_index_size(index), 0);
+
+    for (const PublicKey &pk : keys) {
+        EXPECT_EQ(pk_index_get(index, pk.data()), -1);
+    }
+}
+
+}  // namespace
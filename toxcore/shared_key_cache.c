@@ -13,11 +13,14 @@
 #include "logger.h"
 #include "mem.h"
 #include "mono_time.h"
+#include "pk_index.h"
 
 typedef struct Shared_Key {
     uint8_t public_key[CRYPTO_PUBLIC_KEY_SIZE];
     uint8_t shared_key[CRYPTO_SHARED_KEY_SIZE];
     uint64_t time_last_requested;
+    /** Value of the cache's lookup counter when this key was last requested, used for LRU ordering. */
+    uint64_t last_used;
 } Shared_Key;
 
 struct Shared_Key_Cache {
@@ -27,7 +30,10 @@ struct Shared_Key_Cache {
     const Mono_Time *_Nonnull mono_time;
     const Memory *_Nonnull mem;
     const Logger *_Nonnull log;
-    uint8_t keys_per_slot;
+    uint64_t seed; /** Secret seed for the hash that selects the set of a public key */
+    uint32_t num_sets; /** Always a power of 2 */
+    uint64_t lookups;
+    Shared_Key_Cache_Stats stats;
 };
 
 static bool shared_key_is_empty(const Logger *_Nonnull log, const Shared_Key *_Nonnull k)
@@ -46,9 +52,15 @@ static void shared_key_set_empty(const Logger *_Nonnull log, Shared_Key *_Nonnul
     LOGGER_ASSERT(log, shared_key_is_empty(log, k), "shared key must be empty after clearing it");
 }
 
-Shared_Key_Cache *shared_key_cache_new(const Logger *log, const Mono_Time *mono_time, const Memory *mem, const uint8_t *self_secret_key, uint64_t timeout, uint8_t keys_per_slot)
+static uint32_t shared_key_cache_size(const Shared_Key_Cache *_Nonnull cache)
 {
-    if (mono_time == nullptr || self_secret_key == nullptr || timeout == 0 || keys_per_slot == 0) {
+    return cache->num_sets * SHARED_KEY_CACHE_WAYS;
+}
+
+Shared_Key_Cache *shared_key_cache_new(const Logger *log, const Mono_Time *mono_time, const Memory *mem, const Random *rng,
+                                       const uint8_t *self_secret_key, uint64_t timeout, uint32_t capacity)
+{
+    if (mono_time == nullptr || self_secret_key == nullptr || timeout == 0 || capacity == 0) {
         return nullptr;
     }
 
@@ -59,6 +71,12 @@ Shared_Key_Cache *shared_key_cache_new(const Logger *log, const Mono_Time *mono_
         return nullptr;
     }
 
+    uint32_t num_sets = 1;
+
+    while ((uint64_t)num_sets * SHARED_KEY_CACHE_WAYS < capacity) {
+        num_sets *= 2;
+    }
+
     Shared_Key_Cache *res = (Shared_Key_Cache *)mem_alloc(mem, sizeof(Shared_Key_Cache));
     if (res == nullptr) {
         return nullptr;
@@ -68,10 +86,11 @@ Shared_Key_Cache *shared_key_cache_new(const Logger *log, const Mono_Time *mono_
     res->mono_time = mono_time;
     res->mem = mem;
     res->log = log;
-    res->keys_per_slot = keys_per_slot;
+    res->timeout = timeout;
+    res->seed = random_u64(rng);
+    res->num_sets = num_sets;
 
-    // We take one byte from the public key for each bucket and store keys_per_slot elements there
-    const size_t cache_size = 256 * keys_per_slot;
+    const uint32_t cache_size = shared_key_cache_size(res);
     Shared_Key *keys = (Shared_Key *)mem_valloc(mem, cache_size, sizeof(Shared_Key));
 
     if (keys == nullptr) {
@@ -92,7 +111,7 @@ void shared_key_cache_free(Shared_Key_Cache *cache)
         return;
     }
 
-    const size_t cache_size = 256 * cache->keys_per_slot;
+    const size_t cache_size = shared_key_cache_size(cache);
     // Don't leave key material in memory
     crypto_memzero(cache->keys, cache_size * sizeof(Shared_Key));
     crypto_memunlock(cache->keys, cache_size * sizeof(Shared_Key));
@@ -105,65 +124,66 @@ const uint8_t *shared_key_cache_lookup(Shared_Key_Cache *cache, const uint8_t pu
 {
     // caching the time is not necessary, but calls to mono_time_get(...) are not free
     const uint64_t cur_time = mono_time_get(cache->mono_time);
-    // We can't use the first and last bytes because they are masked in curve25519. Selected 8 for good alignment.
-    const uint8_t bucket_idx = public_key[8];
-    Shared_Key *bucket_start = &cache->keys[bucket_idx * cache->keys_per_slot];
+    const uint32_t set_idx = (uint32_t)pk_index_hash(cache->seed, public_key) & (cache->num_sets - 1);
+    Shared_Key *set_start = &cache->keys[set_idx * SHARED_KEY_CACHE_WAYS];
 
-    const uint8_t *found = nullptr;
+    ++cache->lookups;
 
-    // Perform lookup
-    for (size_t i = 0; i < cache->keys_per_slot; ++i) {
-        if (shared_key_is_empty(cache->log, &bucket_start[i])) {
-            continue;
-        }
+    Shared_Key *victim = &set_start[0];
 
-        if (pk_equal(public_key, bucket_start[i].public_key)) {
-            found = bucket_start[i].shared_key;
-            bucket_start[i].time_last_requested = cur_time;
-            break;
-        }
-    }
+    // Perform lookup and housekeeping for this set, and find the entry to replace on a miss
+    for (size_t i = 0; i < SHARED_KEY_CACHE_WAYS; ++i) {
+        Shared_Key *entry = &set_start[i];
 
-    // Perform housekeeping for this bucket
-    for (size_t i = 0; i < cache->keys_per_slot; ++i) {
-        if (shared_key_is_empty(cache->log, &bucket_start[i])) {
-            continue;
-        }
+        if (!shared_key_is_empty(cache->log, entry)) {
+            const bool timed_out = (entry->time_last_requested + cache->timeout) < cur_time;
 
-        const bool timed_out = (bucket_start[i].time_last_requested + cache->timeout) < cur_time;
-        if (timed_out) {
-            shared_key_set_empty(cache->log, &bucket_start[i]);
+            if (timed_out) {
+                shared_key_set_empty(cache->log, entry);
+            } else if (pk_equal(public_key, entry->public_key)) {
+                entry->time_last_requested = cur_time;
+                entry->last_used = cache->lookups;
+                ++cache->stats.hits;
+                return entry->shared_key;
+            }
         }
-    }
-
-    if (found == nullptr) {
-        // Insert into cache
-
-        uint64_t oldest_timestamp = UINT64_MAX;
-        size_t oldest_index = 0;
 
         /*
          *  Find least recently used entry, unused entries are prioritised,
-         *  because their time_last_requested field is zeroed.
+         *  because their last_used field is zeroed.
          */
-        for (size_t i = 0; i < cache->keys_per_slot; ++i) {
-            if (bucket_start[i].time_last_requested < oldest_timestamp) {
-                oldest_timestamp = bucket_start[i].time_last_requested;
-                oldest_index = i;
-            }
+        if (entry->last_used < victim->last_used) {
+            victim = entry;
         }
+    }
 
-        // Compute the shared key for the cache
-        if (encrypt_precompute(public_key, cache->self_secret_key, bucket_start[oldest_index].shared_key) != 0) {
-            // Don't put anything in the cache on error
-            return nullptr;
-        }
+    ++cache->stats.misses;
 
-        // update cache entry
-        memcpy(bucket_start[oldest_index].public_key, public_key, CRYPTO_PUBLIC_KEY_SIZE);
-        bucket_start[oldest_index].time_last_requested = cur_time;
-        found = bucket_start[oldest_index].shared_key;
+    if (!shared_key_is_empty(cache->log, victim)) {
+        ++cache->stats.evictions;
     }
 
-    return found;
+    // Compute the shared key for the cache
+    if (encrypt_precompute(public_key, cache->self_secret_key, victim->shared_key) != 0) {
+        // Don't put anything in the cache on error
+        shared_key_set_empty(cache->log, victim);
+        return nullptr;
+    }
+
+    // update cache entry
+    memcpy(victim->public_key, public_key, CRYPTO_PUBLIC_KEY_SIZE);
+    victim->time_last_requested = cur_time;
+    victim->last_used = cache->lookups;
+
+    return victim->shared_key;
+}
+
+uint32_t shared_key_cache_capacity(const Shared_Key_Cache *cache)
+{
+    return shared_key_cache_size(cache);
+}
+
+void shared_key_cache_get_stats(const Shared_Key_Cache *cache, Shared_Key_Cache_Stats *stats)
+{
+    *stats = cache->stats;
 }
@@ -12,6 +12,7 @@
 #include "logger.h"
 #include "mem.h"
 #include "mono_time.h"
+#include "rng.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -19,21 +20,40 @@ extern "C" {
 
 /**
  * This implements a cache for shared keys, since key generation is expensive.
+ *
+ * The cache is set-associative: a public key hashes to one set of
+ * SHARED_KEY_CACHE_WAYS entries, and the least recently used entry of that
+ * set is replaced on a miss.
  */
 
+/** Number of entries in each set of the cache. */
+#define SHARED_KEY_CACHE_WAYS 8
+
 typedef struct Shared_Key_Cache Shared_Key_Cache;
 
+/** @brief Lookup counters, used to size the cache for the traffic it sees. */
+typedef struct Shared_Key_Cache_Stats {
+    /** Lookups that found the key in the cache. */
+    uint64_t hits;
+    /** Lookups that had to compute the shared key. */
+    uint64_t misses;
+    /** Live entries that were replaced to make room for another key. */
+    uint64_t evictions;
+} Shared_Key_Cache_Stats;
+
 /**
  * @brief Initializes a new shared key cache.
  * @param mono_time Time object for retrieving current time.
+ * @param rng Random number generator, used to seed the hash of the cache index.
  * @param self_secret_key Our own secret key of length CRYPTO_SECRET_KEY_SIZE,
  * it must not change during the lifetime of the cache.
- * @param timeout Number of milliseconds, after which a key should be evicted.
- * @param keys_per_slot There are 256 slots, this controls how many keys are stored per slot and the size of the cache.
+ * @param timeout Number of seconds, after which a key should be evicted.
+ * @param capacity Minimum number of keys the cache can hold. It is rounded up
+ * to a power of 2 number of sets.
  * @return nullptr on error.
  */
-Shared_Key_Cache *_Nullable shared_key_cache_new(const Logger *_Nonnull log, const Mono_Time *_Nonnull mono_time, const Memory *_Nonnull mem, const uint8_t *_Nonnull self_secret_key, uint64_t timeout,
-        uint8_t keys_per_slot);
+Shared_Key_Cache *_Nullable shared_key_cache_new(const Logger *_Nonnull log, const Mono_Time *_Nonnull mono_time, const Memory *_Nonnull mem, const Random *_Nonnull rng,
+        const uint8_t *_Nonnull self_secret_key, uint64_t timeout, uint32_t capacity);
 
 /**
  * @brief Deletes the cache and frees all resources.
@@ -50,6 +70,12 @@ void shared_key_cache_free(Shared_Key_Cache *_Nullable cache);
  */
 const uint8_t *_Nullable shared_key_cache_lookup(Shared_Key_Cache *_Nonnull cache, const uint8_t public_key[_Nonnull CRYPTO_PUBLIC_KEY_SIZE]);
 
+/** @brief Number of keys the cache can hold. */
+uint32_t shared_key_cache_capacity(const Shared_Key_Cache *_Nonnull cache);
+
+/** @brief Copy the lookup counters of the cache into `stats`. */
+void shared_key_cache_get_stats(const Shared_Key_Cache *_Nonnull cache, Shared_Key_Cache_Stats *_Nonnull stats);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -0,0 +1,199 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "../testing/support/public/simulation.hh"
+#include "crypto_core.h"
+#include "logger.h"
+#include "mono_time.h"
+#include "shared_key_cache.h"
+
+namespace {
+
+using tox::test::SimulatedNode;
+using tox::test::Simulation;
+using PublicKey = std::array<std::uint8_t, CRYPTO_PUBLIC_KEY_SIZE>;
+
+/** @brief Number of distinct peers that send us packets. */
+constexpr std::size_t kNumPeers = 4096;
+/** @brief Length of the pre-generated lookup trace, replayed in a loop. */
+constexpr std::size_t kTraceLength = 1 << 16;
+
+/** @brief How popular each peer is, i.e. how often its key is looked up. */
+enum class Popularity {
+    /** Every peer is equally likely. */
+    kUniform,
+    /**
+     * A few peers (DHT neighbours, friends, onion paths) send most packets,
+     * with a long tail of peers seen rarely. Zipf with exponent 1.
+     */
+    kZipf,
+    /**
+     * Zipf, but a quarter of lookups are from peers we have never seen and
+     * won't see again, e.g. nodes requests from strangers crawling the DHT.
+     */
+    kZipfWithStrangers,
+    /** Peers are looked up round-robin. This is the worst case for LRU. */
+    kScan,
+};
+
+class KeyCacheFixture {
+public:
+    explicit KeyCacheFixture(std::uint32_t capacity)
+        : sim_(12345)
+        , node_(sim_.create_node())
+    {
+        std::uint8_t self_pk[CRYPTO_PUBLIC_KEY_SIZE];
+        crypto_new_keypair(&node_->c_random, self_pk, self_sk_);
+
+        sim_.advance_time(1000);  // mono_time must not be 0
+        mono_time_ = mono_time_new(
+            &node_->c_memory,
+            [](void *_Nullable user_data) -> std::uint64_t {
+                return static_cast<Simulation *>(user_data)->clock().current_time_ms();
+            },
+            &sim_);
+        mono_time_update(mono_time_);
+        logger_ = logger_new(&node_->c_memory);
+
+        cache_ = shared_key_cache_new(
+            logger_, mono_time_, &node_->c_memory, &node_->c_random, self_sk_, 60, capacity);
+    }
+
+    ~KeyCacheFixture()
+    {
+        shared_key_cache_free(cache_);
+        logger_kill(logger_);
+        mono_time_free(&node_->c_memory, mono_time_);
+    }
+
+    Shared_Key_Cache *cache() { return cache_; }
+
+    PublicKey random_key()
+    {
+        PublicKey pk;
+        std::uint8_t sk[CRYPTO_SECRET_KEY_SIZE];
+        crypto_new_keypair(&node_->c_random, pk.data(), sk);
+        return pk;
+    }
+
+private:
+    Simulation sim_;
+    std::unique_ptr<SimulatedNode> node_;
+    std::uint8_t self_sk_[CRYPTO_SECRET_KEY_SIZE];
+    Mono_Time *_Nullable mono_time_ = nullptr;
+    Logger *_Nullable logger_ = nullptr;
+    Shared_Key_Cache *_Nullable cache_ = nullptr;
+};
+
+std::vector<PublicKey> make_trace(KeyCacheFixture &fixture, Popularity popularity)
+{
+    std::vector<PublicKey> peers(kNumPeers);
+    for (PublicKey &pk : peers) {
+        pk = fixture.random_key();
+    }
+
+    std::vector<double> weights(kNumPeers, 1.0);
+    if (popularity == Popularity::kZipf || popularity == Popularity::kZipfWithStrangers) {
+        for (std::size_t i = 0; i < kNumPeers; ++i) {
+            weights[i] = 1.0 / static_cast<double>(i + 1);
+        }
+    }
+
+    std::mt19937 gen{42};
+    std::discrete_distribution<std::size_t> pick(weights.begin(), weights.end());
+
+    std::vector<PublicKey> trace;
+    trace.reserve(kTraceLength);
+
+    for (std::size_t i = 0; i < kTraceLength; ++i) {
+        if (popularity == Popularity::kScan) {
+            trace.push_back(peers[i % kNumPeers]);
+        } else if (popularity == Popularity::kZipfWithStrangers && gen() % 4 == 0) {
+            trace.push_back(fixture.random_key());
+        } else {
+            trace.push_back(peers[pick(gen)]);
+        }
+    }
+
+    return trace;
+}
+
+/**
+ * @brief Replay a lookup trace against a cache of the given capacity.
+ *
+ * Every miss costs a curve25519 scalar multiplication, so the time per lookup
+ * mostly reflects the miss rate. The hit rate and evictions per lookup are
+ * reported as counters.
+ */
+void BM_SharedKeyCacheLookup(benchmark::State &state, Popularity popularity)
+{
+    const std::uint32_t capacity = static_cast<std::uint32_t>(state.range(0));
+
+    KeyCacheFixture fixture(capacity);
+    if (fixture.cache() == nullptr) {
+        state.SkipWithError("failed to create cache");
+        return;
+    }
+
+    const std::vector<PublicKey> trace = make_trace(fixture, popularity);
+
+    // Warm up the cache, so the counters reflect the steady state.
+    for (const PublicKey &pk : trace) {
+        shared_key_cache_lookup(fixture.cache(), pk.data());
+    }
+
+    Shared_Key_Cache_Stats before;
+    shared_key_cache_get_stats(fixture.cache(), &before);
+
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(shared_key_cache_lookup(fixture.cache(), trace[i].data()));
+        i = (i + 1) % trace.size();
+    }
+
+    Shared_Key_Cache_Stats after;
+    shared_key_cache_get_stats(fixture.cache(), &after);
+
+    const double hits = static_cast<double>(after.hits - before.hits);
+    const double misses = static_cast<double>(after.misses - before.misses);
+    const double lookups = std::max(hits + misses, 1.0);
+    state.counters["hit_rate"] = hits / lookups;
+    state.counters["evictions"] = static_cast<double>(after.evictions - before.evictions) / lookups;
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_CAPTURE(BM_SharedKeyCacheLookup, Uniform, Popularity::kUniform)
+    ->Arg(32)
+    ->Arg(256)
+    ->Arg(1024)
+    ->Arg(4096);
+BENCHMARK_CAPTURE(BM_SharedKeyCacheLookup, Zipf, Popularity::kZipf)
+    ->Arg(32)
+    ->Arg(256)
+    ->Arg(1024)
+    ->Arg(4096);
+BENCHMARK_CAPTURE(BM_SharedKeyCacheLookup, ZipfWithStrangers, Popularity::kZipfWithStrangers)
+    ->Arg(32)
+    ->Arg(256)
+    ->Arg(1024)
+    ->Arg(4096);
+BENCHMARK_CAPTURE(BM_SharedKeyCacheLookup, Scan, Popularity::kScan)
+    ->Arg(32)
+    ->Arg(256)
+    ->Arg(1024)
+    ->Arg(4096);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -9,6 +9,7 @@
 #include <cstdint>
 #include <cstring>
 #include <memory>
+#include <vector>
 
 #include "../testing/support/public/simulation.hh"
 #include "attributes.h"
@@ -39,7 +40,7 @@ protected:
 
         logger = logger_new(&node->c_memory);
 
-        cache = shared_key_cache_new(logger, mono_time, &node->c_memory, alice_sk, 10000, 4);
+        cache = shared_key_cache_new(logger, mono_time, &node->c_memory, &node->c_random, alice_sk, 10, 1024);
         ASSERT_NE(cache, nullptr);
     }
 
@@ -89,75 +90,108 @@ TEST_F(SharedKeyCacheTest, TimeoutEviction)
     // Should re-compute/re-insert after timeout
     const std::uint8_t *shared = shared_key_cache_lookup(cache, bob_pk);
     ASSERT_NE(shared, nullptr);
+
+    Shared_Key_Cache_Stats stats;
+    shared_key_cache_get_stats(cache, &stats);
+    EXPECT_EQ(stats.hits, 0);
+    EXPECT_EQ(stats.misses, 2);
+    // An expired entry is dropped, not evicted.
+    EXPECT_EQ(stats.evictions, 0);
+}
+
+TEST_F(SharedKeyCacheTest, CapacityIsRoundedUpToWholeSets)
+{
+    EXPECT_EQ(shared_key_cache_capacity(cache), 1024);
+
+    Shared_Key_Cache *small = shared_key_cache_new(logger, mono_time, &node->c_memory, &node->c_random, alice_sk, 10, 5);
+    ASSERT_NE(small, nullptr);
+    EXPECT_EQ(shared_key_cache_capacity(small), SHARED_KEY_CACHE_WAYS);
+    shared_key_cache_free(small);
+
+    Shared_Key_Cache *odd = shared_key_cache_new(logger, mono_time, &node->c_memory, &node->c_random, alice_sk, 10, 100);
+    ASSERT_NE(odd, nullptr);
+    EXPECT_EQ(shared_key_cache_capacity(odd), 16 * SHARED_KEY_CACHE_WAYS);
+    shared_key_cache_free(odd);
+}
+
+TEST_F(SharedKeyCacheTest, CountsHitsAndMisses)
+{
+    std::uint8_t bob_pk[CRYPTO_PUBLIC_KEY_SIZE], bob_sk[CRYPTO_SECRET_KEY_SIZE];
+    crypto_new_keypair(&node->c_random, bob_pk, bob_sk);
+
+    shared_key_cache_lookup(cache, bob_pk);
+    shared_key_cache_lookup(cache, bob_pk);
+    shared_key_cache_lookup(cache, bob_pk);
+
+    Shared_Key_Cache_Stats stats;
+    shared_key_cache_get_stats(cache, &stats);
+    EXPECT_EQ(stats.hits, 2);
+    EXPECT_EQ(stats.misses, 1);
+    EXPECT_EQ(stats.evictions, 0);
 }
 
-TEST_F(SharedKeyCacheTest, SlotExhaustionAndLRU)
+TEST_F(SharedKeyCacheTest, EvictsLeastRecentlyUsedEntryOfFullSet)
 {
-    // Fill one bucket (4 slots)
+    // A cache of a single set, so every key competes for the same entries.
+    Shared_Key_Cache *small = shared_key_cache_new(logger, mono_time, &node->c_memory, &node->c_random, alice_sk, 10, SHARED_KEY_CACHE_WAYS);
+    ASSERT_NE(small, nullptr);
+
     std::vector<std::vector<std::uint8_t>> pks;
-    // Store pointers to verify cache hits (stable memory addresses)
     std::vector<const std::uint8_t *> pointers;
-    std::uint8_t target_hash = 0x42;
 
-    for (int i = 0; i < 5; ++i) {
+    for (int i = 0; i < SHARED_KEY_CACHE_WAYS; ++i) {
         std::uint8_t pk[CRYPTO_PUBLIC_KEY_SIZE], sk[CRYPTO_SECRET_KEY_SIZE];
-        while (true) {
-            crypto_new_keypair(&node->c_random, pk, sk);
-            if (pk[8] == target_hash)
-                break;
-        }
-        pks.push_back(std::vector<std::uint8_t>(pk, pk + CRYPTO_PUBLIC_KEY_SIZE));
-        sim->advance_time(100);
-        mono_time_update(mono_time);
-        pointers.push_back(shared_key_cache_lookup(cache, pk));
+        crypto_new_keypair(&node->c_random, pk, sk);
+        pks.emplace_back(pk, pk + CRYPTO_PUBLIC_KEY_SIZE);
+        pointers.push_back(shared_key_cache_lookup(small, pk));
     }
 
-    // 5th lookup should have evicted the oldest (LRU)
-    bool reused = false;
-    for (int i = 0; i < 4; ++i) {
-        if (pointers[4] == pointers[i])
-            reused = true;
+    // Touch the oldest key, so the second oldest becomes the LRU entry.
+    EXPECT_EQ(shared_key_cache_lookup(small, pks[0].data()), pointers[0]);
+
+    std::uint8_t pk[CRYPTO_PUBLIC_KEY_SIZE], sk[CRYPTO_SECRET_KEY_SIZE];
+    crypto_new_keypair(&node->c_random, pk, sk);
+    EXPECT_EQ(shared_key_cache_lookup(small, pk), pointers[1]);
+
+    Shared_Key_Cache_Stats stats;
+    shared_key_cache_get_stats(small, &stats);
+    EXPECT_EQ(stats.misses, SHARED_KEY_CACHE_WAYS + 1);
+    EXPECT_EQ(stats.hits, 1);
+    EXPECT_EQ(stats.evictions, 1);
+
+    // The other keys are still cached.
+    for (int i = 2; i < SHARED_KEY_CACHE_WAYS; ++i) {
+        EXPECT_EQ(shared_key_cache_lookup(small, pks[i].data()), pointers[i]);
     }
-    EXPECT_TRUE(reused);
 
-    // Most recent should still be cached
-    EXPECT_EQ(shared_key_cache_lookup(cache, pks[1].data()), pointers[1]);
+    shared_key_cache_free(small);
 }
 
-TEST_F(SharedKeyCacheTest, HashDistribution)
+TEST_F(SharedKeyCacheTest, WorkingSetSmallerThanCapacityStaysCached)
 {
-    const int total_keys = 256;
+    const int total_keys = 128;
     std::vector<std::vector<std::uint8_t>> pks;
     // Store pointers to verify cache hits (stable memory addresses)
     std::vector<const std::uint8_t *> pointers;
 
-    // Fill cache with keys having unique hashes
     for (int i = 0; i < total_keys; ++i) {
         std::uint8_t pk[CRYPTO_PUBLIC_KEY_SIZE], sk[CRYPTO_SECRET_KEY_SIZE];
-        while (true) {
-            crypto_new_keypair(&node->c_random, pk, sk);
-            std::uint8_t h = pk[8];
-            bool duplicate = false;
-            for (const auto &existing : pks) {
-                if (existing[8] == h) {
-                    duplicate = true;
-                    break;
-                }
-            }
-            if (!duplicate)
-                break;
-        }
-        pks.push_back(std::vector<std::uint8_t>(pk, pk + CRYPTO_PUBLIC_KEY_SIZE));
+        crypto_new_keypair(&node->c_random, pk, sk);
+        pks.emplace_back(pk, pk + CRYPTO_PUBLIC_KEY_SIZE);
         pointers.push_back(shared_key_cache_lookup(cache, pk));
     }
 
-    // Verify high hit rate (low collisions)
     int hits = 0;
     for (int i = 0; i < total_keys; ++i) {
         if (shared_key_cache_lookup(cache, pks[i].data()) == pointers[i])
             hits++;
     }
     EXPECT_EQ(hits, total_keys);
+
+    Shared_Key_Cache_Stats stats;
+    shared_key_cache_get_stats(cache, &stats);
+    EXPECT_EQ(stats.hits, total_keys);
+    EXPECT_EQ(stats.evictions, 0);
 }
 
 }  // namespace
@@ -0,0 +1,223 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include "socket_watch.h"
+
+#include "ccompat.h"
+
+typedef struct Socket_Watch_Entry {
+    Socket sock;
+    uint64_t sock_id;
+    Ev_Events events;
+} Socket_Watch_Entry;
+
+struct Socket_Watch {
+    const Memory *_Nonnull mem;
+    const Logger *_Nonnull log;
+    Ev *_Nonnull ev;
+
+    /* Sockets currently registered with the event loop. */
+    Socket_Watch_Entry *_Nullable registered;
+    uint32_t registered_count;
+    uint32_t registered_capacity;
+
+    /* The set being built between socket_watch_begin and socket_watch_commit. */
+    Socket_Watch_Entry *_Nullable pending;
+    uint32_t pending_count;
+    uint32_t pending_capacity;
+    bool pending_incomplete;
+
+    Ev_Result *_Nullable results;
+    uint32_t results_capacity;
+    uint32_t ready_count;
+};
+
+/** @brief Make room for at least `needed` entries in `*entries`. */
+static bool entries_reserve(const Memory *_Nonnull mem, Socket_Watch_Entry *_Nullable *_Nonnull entries,
+                            uint32_t *_Nonnull capacity, uint32_t needed)
+{
+    if (needed <= *capacity) {
+        return true;
+    }
+
+    const uint32_t new_capacity = *capacity == 0 ? 8 : *capacity * 2;
+
+    if (new_capacity < needed) {
+        return false;
+    }
+
+    Socket_Watch_Entry *new_entries = (Socket_Watch_Entry *)mem_vrealloc(
+                                          mem, *entries, new_capacity, sizeof(Socket_Watch_Entry));
+
+    if (new_entries == nullptr) {
+        return false;
+    }
+
+    *entries = new_entries;
+    *capacity = new_capacity;
+    return true;
+}
+
+static Socket_Watch_Entry *_Nullable entries_find(Socket_Watch_Entry *_Nullable entries, uint32_t count, const Socket_Watch_Entry *_Nonnull entry)
+{
+    for (uint32_t i = 0; i < count; ++i) {
+        if (net_socket_to_native(entries[i].sock) == net_socket_to_native(entry->sock)
+                && entries[i].sock_id == entry->sock_id) {
+            return &entries[i];
+        }
+    }
+
+    return nullptr;
+}
+
+Socket_Watch *socket_watch_new(const Memory *mem, const Logger *log, Ev *ev)
+{
+    Socket_Watch *sw = (Socket_Watch *)mem_alloc(mem, sizeof(Socket_Watch));
+
+    if (sw == nullptr) {
+        return nullptr;
+    }
+
+    sw->mem = mem;
+    sw->log = log;
+    sw->ev = ev;
+
+    return sw;
+}
+
+void socket_watch_kill(Socket_Watch *sw)
+{
+    if (sw == nullptr) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < sw->registered_count; ++i) {
+        ev_del(sw->ev, sw->registered[i].sock);
+    }
+
+    mem_delete(sw->mem, sw->results);
+    mem_delete(sw->mem, sw->pending);
+    mem_delete(sw->mem, sw->registered);
+    mem_delete(sw->mem, sw);
+}
+
+void socket_watch_begin(Socket_Watch *sw)
+{
+    sw->pending_count = 0;
+    sw->pending_incomplete = false;
+}
+
+void socket_watch_add(void *obj, Socket sock, uint64_t sock_id, bool want_write)
+{
+    Socket_Watch *sw = (Socket_Watch *)obj;
+
+    if (!entries_reserve(sw->mem, &sw->pending, &sw->pending_capacity, sw->pending_count + 1)) {
+        sw->pending_incomplete = true;
+        return;
+    }
+
+    Socket_Watch_Entry *entry = &sw->pending[sw->pending_count];
+    entry->sock = sock;
+    entry->sock_id = sock_id;
+    entry->events = want_write ? EV_READ | EV_WRITE : EV_READ;
+    ++sw->pending_count;
+}
+
+bool socket_watch_commit(Socket_Watch *sw)
+{
+    bool ok = !sw->pending_incomplete;
+
+    /* Drop registrations that are no longer wanted and update changed ones.
+     * A registration whose descriptor now belongs to a new socket is dropped
+     * as well: the event loop may have forgotten it when the old one closed. */
+    uint32_t i = 0;
+
+    while (i < sw->registered_count) {
+        Socket_Watch_Entry *reg = &sw->registered[i];
+        const Socket_Watch_Entry *want = entries_find(sw->pending, sw->pending_count, reg);
+
+        if (want != nullptr && want->events == reg->events) {
+            ++i;
+            continue;
+        }
+
+        if (want != nullptr && ev_mod(sw->ev, reg->sock, want->events, nullptr)) {
+            reg->events = want->events;
+            ++i;
+            continue;
+        }
+
+        /* Either unwanted, or modifying failed; in the latter case it is re-added below. */
+        ev_del(sw->ev, reg->sock);
+        *reg = sw->registered[sw->registered_count - 1];
+        --sw->registered_count;
+    }
+
+    /* Register new sockets. */
+    for (uint32_t j = 0; j < sw->pending_count; ++j) {
+        const Socket_Watch_Entry *want = &sw->pending[j];
+
+        if (entries_find(sw->registered, sw->registered_count, want) != nullptr) {
+            continue;
+        }
+
+        if (!entries_reserve(sw->mem, &sw->registered, &sw->registered_capacity, sw->registered_count + 1)) {
+            ok = false;
+            break;
+        }
+
+        if (!ev_add(sw->ev, want->sock, want->events, nullptr)) {
+            LOGGER_WARNING(sw->log, "failed to watch socket %d", net_socket_to_native(want->sock));
+            ok = false;
+            continue;
+        }
+
+        sw->registered[sw->registered_count] = *want;
+        ++sw->registered_count;
+    }
+
+    return ok;
+}
+
+int32_t socket_watch_wait(Socket_Watch *sw, int32_t timeout_ms)
+{
+    sw->ready_count = 0;
+
+    const uint32_t needed = sw->registered_count == 0 ? 1 : sw->registered_count;
+
+    if (sw->results_capacity < needed) {
+        Ev_Result *new_results = (Ev_Result *)mem_vrealloc(sw->mem, sw->results, needed, sizeof(Ev_Result));
+
+        if (new_results == nullptr) {
+            return -1;
+        }
+
+        sw->results = new_results;
+        sw->results_capacity = needed;
+    }
+
+    const int32_t ret = ev_run(sw->ev, sw->results, sw->results_capacity, timeout_ms);
+
+    if (ret > 0) {
+        sw->ready_count = (uint32_t)ret;
+    }
+
+    return ret;
+}
+
+bool socket_watch_is_ready(const Socket_Watch *sw, Socket sock)
+{
+    for (uint32_t i = 0; i < sw->ready_count; ++i) {
+        if (net_socket_to_native(sw->results[i].sock) == net_socket_to_native(sock)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+uint32_t socket_watch_count(const Socket_Watch *sw)
+{
+    return sw->registered_count;
+}
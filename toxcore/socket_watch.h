@@ -0,0 +1,90 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+/**
+ * Keeps an event loop's registrations in sync with a changing set of sockets.
+ *
+ * The owner rebuilds the set of sockets it is interested in before each wait
+ * (socket_watch_begin, socket_watch_add, socket_watch_commit). Only the
+ * difference to the previous set is applied to the Ev instance, so a mostly
+ * static set of sockets costs no system calls per iteration. Sockets are told
+ * apart by descriptor and `sock_id`, so a new socket that reuses a closed
+ * one's descriptor is registered afresh.
+ */
+#ifndef C_TOXCORE_TOXCORE_SOCKET_WATCH_H
+#define C_TOXCORE_TOXCORE_SOCKET_WATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "attributes.h"
+#include "ev.h"
+#include "logger.h"
+#include "mem.h"
+#include "net.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct Socket_Watch Socket_Watch;
+
+/**
+ * @brief Create a new socket watch on top of an event loop.
+ *
+ * The event loop is not owned by the socket watch and must outlive it. It
+ * should not be used for any other sockets.
+ */
+Socket_Watch *_Nullable socket_watch_new(const Memory *_Nonnull mem, const Logger *_Nonnull log, Ev *_Nonnull ev);
+
+/** @brief Remove all registrations from the event loop and free the socket watch. */
+void socket_watch_kill(Socket_Watch *_Nullable sw);
+
+/** @brief Start building a new set of watched sockets. */
+void socket_watch_begin(Socket_Watch *_Nonnull sw);
+
+/**
+ * @brief Add a socket to the set being built.
+ *
+ * The signature matches `net_socket_visit_cb`, so this can be passed directly
+ * to the `*_visit_sockets` functions with the socket watch as `obj`.
+ *
+ * @param sock_id Tells `sock` apart from earlier sockets with the same descriptor.
+ * @param want_write Also wake up when the socket becomes writable.
+ */
+void socket_watch_add(void *_Nonnull sw, Socket sock, uint64_t sock_id, bool want_write);
+
+/**
+ * @brief Apply the set built since socket_watch_begin to the event loop.
+ *
+ * Sockets no longer in the set are removed, new ones are added and changed
+ * interests are modified.
+ *
+ * @retval true if all sockets in the set are registered.
+ * @retval false if some could not be registered. They are retried on the next commit.
+ */
+bool socket_watch_commit(Socket_Watch *_Nonnull sw);
+
+/**
+ * @brief Block until a watched socket is ready or the timeout expires.
+ *
+ * This also waits for the full timeout if no sockets are watched.
+ *
+ * @param timeout_ms Maximum time to wait in milliseconds.
+ *
+ * @return number of ready sockets, 0 on timeout, or -1 on error.
+ */
+int32_t socket_watch_wait(Socket_Watch *_Nonnull sw, int32_t timeout_ms);
+
+/** @brief Return true if `sock` was reported as ready by the last socket_watch_wait. */
+bool socket_watch_is_ready(const Socket_Watch *_Nonnull sw, Socket sock);
+
+/** @brief Number of sockets currently registered with the event loop. */
+uint32_t socket_watch_count(const Socket_Watch *_Nonnull sw);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* C_TOXCORE_TOXCORE_SOCKET_WATCH_H */
@@ -0,0 +1,142 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include "socket_watch.h"
+
+#include <gtest/gtest.h>
+
+#include "ev.h"
+#include "ev_test_util.hh"
+#include "logger.h"
+#include "net.h"
+#include "os_event.h"
+#include "os_memory.h"
+#include "os_network.h"
+
+namespace {
+
+class SocketWatchTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        ASSERT_NE(os_network(), nullptr);  // WSAStartup
+        mem = os_memory();
+        log = logger_new(mem);
+        ev = os_event_new(mem, log);
+        ASSERT_NE(ev, nullptr);
+        sw = socket_watch_new(mem, log, ev);
+        ASSERT_NE(sw, nullptr);
+        ASSERT_EQ(create_pair(&r1, &w1), 0);
+        ASSERT_EQ(create_pair(&r2, &w2), 0);
+    }
+
+    void TearDown() override
+    {
+        socket_watch_kill(sw);
+        ev_kill(ev);
+        close_pair(r1, w1);
+        close_pair(r2, w2);
+        logger_kill(log);
+    }
+
+    void watch(std::initializer_list<Socket> socks)
+    {
+        socket_watch_begin(sw);
+        for (const Socket sock : socks) {
+            socket_watch_add(sw, sock, 0, false);
+        }
+        EXPECT_TRUE(socket_watch_commit(sw));
+    }
+
+    const Memory *mem = nullptr;
+    Logger *log = nullptr;
+    Ev *ev = nullptr;
+    Socket_Watch *sw = nullptr;
+    Socket r1{}, w1{}, r2{}, w2{};
+};
+
+TEST_F(SocketWatchTest, ReportsOnlyReadySockets)
+{
+    watch({r1, r2});
+    EXPECT_EQ(socket_watch_count(sw), 2);
+
+    const char buf = 'x';
+    ASSERT_EQ(write_socket(w2, &buf, 1), 1);
+
+    EXPECT_EQ(socket_watch_wait(sw, 1000), 1);
+    EXPECT_FALSE(socket_watch_is_ready(sw, r1));
+    EXPECT_TRUE(socket_watch_is_ready(sw, r2));
+}
+
+TEST_F(SocketWatchTest, TimesOutWithoutActivity)
+{
+    watch({r1});
+    EXPECT_EQ(socket_watch_wait(sw, 10), 0);
+    EXPECT_FALSE(socket_watch_is_ready(sw, r1));
+}
+
+TEST_F(SocketWatchTest, WaitsWithNoSockets)
+{
+    watch({});
+    EXPECT_EQ(socket_watch_count(sw), 0);
+    EXPECT_EQ(socket_watch_wait(sw, 10), 0);
+}
+
+TEST_F(SocketWatchTest, CommitAppliesDifference)
+{
+    watch({r1, r2});
+    watch({r2});
+    EXPECT_EQ(socket_watch_count(sw), 1);
+
+    // r1 is no longer registered with the event loop, so it can be added directly.
+    EXPECT_TRUE(ev_add(ev, r1, EV_READ, nullptr));
+    EXPECT_TRUE(ev_del(ev, r1));
+
+    // Committing the same set again is a no-op.
+    watch({r2});
+    EXPECT_EQ(socket_watch_count(sw), 1);
+    EXPECT_FALSE(ev_add(ev, r2, EV_READ, nullptr));
+}
+
+TEST_F(SocketWatchTest, WantWriteReportsWritableSocket)
+{
+    socket_watch_begin(sw);
+    socket_watch_add(sw, w1, 0, true);
+    ASSERT_TRUE(socket_watch_commit(sw));
+
+    EXPECT_EQ(socket_watch_wait(sw, 1000), 1);
+    EXPECT_TRUE(socket_watch_is_ready(sw, w1));
+
+    // Without write interest, an idle writable socket is not reported.
+    watch({w1});
+    EXPECT_EQ(socket_watch_wait(sw, 10), 0);
+}
+
+TEST_F(SocketWatchTest, NewSocketReusingADescriptorIsRegistered)
+{
+    socket_watch_begin(sw);
+    socket_watch_add(sw, r1, 1, false);
+    ASSERT_TRUE(socket_watch_commit(sw));
+
+    // Closing a socket drops it from the event loop behind the watch's back.
+    const int old_fd = net_socket_to_native(r1);
+    close_pair(r1, w1);
+    ASSERT_EQ(create_pair(&r1, &w1), 0);
+
+    if (net_socket_to_native(r1) != old_fd) {
+        GTEST_SKIP() << "the new socket got a different descriptor";
+    }
+
+    socket_watch_begin(sw);
+    socket_watch_add(sw, r1, 2, false);
+    ASSERT_TRUE(socket_watch_commit(sw));
+
+    const char buf = 'x';
+    ASSERT_EQ(write_socket(w1, &buf, 1), 1);
+
+    EXPECT_EQ(socket_watch_wait(sw, 1000), 1);
+    EXPECT_TRUE(socket_watch_is_ready(sw, r1));
+}
+
+}  // namespace
@@ -4,10 +4,13 @@
  */
 #include "state.h"
 
+#include <assert.h>
 #include <string.h>
 
 #include "ccompat.h"
 #include "logger.h"
+#include "mem.h"
+#include "util.h"
 
 /** state load/save */
 int state_load(const Logger *log, state_load_cb *state_load_callback, void *outer,
@@ -79,6 +82,188 @@ uint8_t *state_write_section_header(uint8_t *data, uint16_t cookie_type, uint32_
     return data;
 }
 
+void state_writer_init(State_Writer *writer, state_write_cb *write, void *user_data)
+{
+    writer->write = write;
+    writer->user_data = user_data;
+    writer->buffer_length = 0;
+    writer->failed = false;
+}
+
+bool state_writer_flush(State_Writer *writer)
+{
+    if (!writer->failed && writer->buffer_length > 0) {
+        writer->failed = !writer->write(writer->user_data, writer->buffer, writer->buffer_length);
+    }
+
+    writer->buffer_length = 0;
+    return !writer->failed;
+}
+
+uint8_t *state_writer_reserve(State_Writer *writer, uint32_t length)
+{
+    if (length > sizeof(writer->buffer)) {
+        return nullptr;
+    }
+
+    if (sizeof(writer->buffer) - writer->buffer_length < length) {
+        state_writer_flush(writer);
+    }
+
+    uint8_t *data = writer->buffer + writer->buffer_length;
+    memzero(data, length);
+    writer->buffer_length += length;
+    return data;
+}
+
+bool state_writer_write(State_Writer *writer, const uint8_t *data, uint32_t length)
+{
+    if (length == 0) {
+        return !writer->failed;
+    }
+
+    assert(data != nullptr);
+
+    if (length > sizeof(writer->buffer)) {
+        // Too big to be worth copying, hand it to the sink directly.
+        if (state_writer_flush(writer)) {
+            writer->failed = !writer->write(writer->user_data, data, length);
+        }
+
+        return !writer->failed;
+    }
+
+    memcpy(state_writer_reserve(writer, length), data, length);
+    return !writer->failed;
+}
+
+bool state_writer_section_header(State_Writer *writer, uint16_t cookie_type, uint32_t len, uint32_t section_type)
+{
+    state_write_section_header(state_writer_reserve(writer, sizeof(uint32_t) * 2), cookie_type, len, section_type);
+    return !writer->failed;
+}
+
+void state_reader_init(State_Reader *reader, const Memory *mem, state_read_cb *read, void *user_data)
+{
+    reader->mem = mem;
+    reader->read = read;
+    reader->user_data = user_data;
+    reader->section_remaining = 0;
+    reader->scratch = nullptr;
+    reader->scratch_size = 0;
+}
+
+void state_reader_free(State_Reader *reader)
+{
+    mem_delete(reader->mem, reader->scratch);
+    reader->scratch = nullptr;
+    reader->scratch_size = 0;
+}
+
+bool state_reader_read(State_Reader *reader, uint8_t *data, uint32_t length)
+{
+    if (length > reader->section_remaining) {
+        return false;
+    }
+
+    if (length == 0) {
+        return true;
+    }
+
+    const uint32_t read = reader->read(reader->user_data, data, length);
+    reader->section_remaining -= read;
+    return read == length;
+}
+
+const uint8_t *state_reader_read_chunk(State_Reader *reader, uint32_t length)
+{
+    if (reader->scratch == nullptr || reader->scratch_size < length) {
+        const uint32_t size = max_u32(length, 1);
+        uint8_t *scratch = (uint8_t *)mem_balloc(reader->mem, size);
+
+        if (scratch == nullptr) {
+            return nullptr;
+        }
+
+        mem_delete(reader->mem, reader->scratch);
+        reader->scratch = scratch;
+        reader->scratch_size = size;
+    }
+
+    if (!state_reader_read(reader, reader->scratch, length)) {
+        return nullptr;
+    }
+
+    return reader->scratch;
+}
+
+/** @brief Read and drop what is left of the current section. */
+static bool state_reader_skip(State_Reader *_Nonnull reader)
+{
+    uint8_t buffer[1024];
+
+    while (reader->section_remaining > 0) {
+        if (!state_reader_read(reader, buffer, min_u32(reader->section_remaining, sizeof(buffer)))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int state_load_stream(const Logger *log, state_load_stream_cb *state_load_callback, void *outer,
+                      State_Reader *reader, uint16_t cookie_inner)
+{
+    uint8_t head[sizeof(uint32_t) * 2];
+
+    while (true) {
+        const uint32_t head_length = reader->read(reader->user_data, head, sizeof(head));
+
+        if (head_length == 0) {
+            return 0;
+        }
+
+        if (head_length != sizeof(head)) {
+            LOGGER_ERROR(log, "state file truncated in a section header");
+            return -1;
+        }
+
+        uint32_t length_sub;
+        lendian_bytes_to_host32(&length_sub, head);
+
+        uint32_t cookie_type;
+        lendian_bytes_to_host32(&cookie_type, head + sizeof(uint32_t));
+
+        if (lendian_to_host16(cookie_type >> 16) != cookie_inner) {
+            LOGGER_ERROR(log, "state file garbled: %04x != %04x", cookie_type >> 16, cookie_inner);
+            return -1;
+        }
+
+        const uint16_t type = lendian_to_host16(cookie_type & 0xFFFF);
+        reader->section_remaining = length_sub;
+
+        switch (state_load_callback(outer, reader, length_sub, type)) {
+            case STATE_LOAD_STATUS_CONTINUE: {
+                if (!state_reader_skip(reader)) {
+                    LOGGER_ERROR(log, "state file too short: section of type 0x%02x truncated", type);
+                    return -1;
+                }
+
+                break;
+            }
+
+            case STATE_LOAD_STATUS_ERROR: {
+                LOGGER_ERROR(log, "Error occcured in state file (type: 0x%02x).", type);
+                return -1;
+            }
+
+            case STATE_LOAD_STATUS_END: {
+                return 0;
+            }
+        }
+    }
+}
+
 uint16_t lendian_to_host16(uint16_t lendian)
 {
 #ifdef WORDS_BIGENDIAN
@@ -17,10 +17,12 @@
 #ifndef C_TOXCORE_TOXCORE_STATE_H
 #define C_TOXCORE_TOXCORE_STATE_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "attributes.h"
 #include "logger.h"
+#include "mem.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -61,6 +63,89 @@ int state_load(const Logger *_Nonnull log, state_load_cb *_Nonnull state_load_ca
 
 uint8_t *_Nonnull state_write_section_header(uint8_t *_Nonnull data, uint16_t cookie_type, uint32_t len, uint32_t section_type);
 
+/** @brief Sink of a State_Writer.
+ *
+ * @retval false if the data could not be written. Nothing is written after that.
+ */
+typedef bool state_write_cb(void *_Nullable user_data, const uint8_t *_Nonnull data, uint32_t length);
+
+#define STATE_WRITER_BUFFER_SIZE 4096
+
+/** @brief Writes state data through a callback, in chunks of up to STATE_WRITER_BUFFER_SIZE bytes. */
+typedef struct State_Writer {
+    state_write_cb *_Nonnull write;
+    void *_Nullable user_data;
+
+    uint8_t buffer[STATE_WRITER_BUFFER_SIZE];
+    uint32_t buffer_length;
+    bool failed;
+} State_Writer;
+
+void state_writer_init(State_Writer *_Nonnull writer, state_write_cb *_Nonnull write, void *_Nullable user_data);
+
+/** @brief Return a zeroed buffer of `length` bytes to write into, or NULL if length exceeds the buffer size.
+ *
+ * The bytes count as written once this returns. The pointer is only valid until
+ * the next call on the writer.
+ */
+uint8_t *_Nullable state_writer_reserve(State_Writer *_Nonnull writer, uint32_t length);
+
+/** @retval false if this or any previous write failed. */
+bool state_writer_write(State_Writer *_Nonnull writer, const uint8_t *_Nullable data, uint32_t length);
+bool state_writer_section_header(State_Writer *_Nonnull writer, uint16_t cookie_type, uint32_t len, uint32_t section_type);
+
+/** @brief Pass everything still buffered to the sink.
+ *
+ * @retval false if this or any previous write failed.
+ */
+bool state_writer_flush(State_Writer *_Nonnull writer);
+
+/** @brief Source of a State_Reader.
+ *
+ * @return the number of bytes read into data. Less than length only at the end of the data.
+ */
+typedef uint32_t state_read_cb(void *_Nullable user_data, uint8_t *_Nonnull data, uint32_t length);
+
+/** @brief Reads state data through a callback, one section at a time. */
+typedef struct State_Reader {
+    const Memory *_Nonnull mem;
+    state_read_cb *_Nonnull read;
+    void *_Nullable user_data;
+
+    /** Bytes of the current section not read yet. */
+    uint32_t section_remaining;
+
+    uint8_t *_Nullable scratch;
+    uint32_t scratch_size;
+} State_Reader;
+
+void state_reader_init(State_Reader *_Nonnull reader, const Memory *_Nonnull mem, state_read_cb *_Nonnull read, void *_Nullable user_data);
+void state_reader_free(State_Reader *_Nonnull reader);
+
+/** @brief Read the next `length` bytes of the current section.
+ *
+ * @retval false if the section has fewer bytes left or the source ran out.
+ */
+bool state_reader_read(State_Reader *_Nonnull reader, uint8_t *_Nonnull data, uint32_t length);
+
+/** @brief Read the next `length` bytes of the current section into a buffer owned by the reader.
+ *
+ * The buffer is valid until the next call on the reader.
+ *
+ * @return NULL if the bytes could not be read or the buffer could not be grown.
+ */
+const uint8_t *_Nullable state_reader_read_chunk(State_Reader *_Nonnull reader, uint32_t length);
+
+/** @brief Called for each section by state_load_stream.
+ *
+ * The section's `length` bytes can be read from the reader. What the callback
+ * doesn't read is skipped.
+ */
+typedef State_Load_Status state_load_stream_cb(void *_Nonnull outer, State_Reader *_Nonnull reader, uint32_t length, uint16_t type);
+
+/** @brief Like state_load, but reads the sections from a reader instead of a buffer. */
+int state_load_stream(const Logger *_Nonnull log, state_load_stream_cb *_Nonnull state_load_callback, void *_Nonnull outer, State_Reader *_Nonnull reader, uint16_t cookie_inner);
+
 // Utilities for state data serialisation.
 
 uint16_t lendian_to_host16(uint16_t lendian);
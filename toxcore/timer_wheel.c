@@ -0,0 +1,434 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include "timer_wheel.h"
+
+#include "attributes.h"
+#include "ccompat.h"
+#include "mem.h"
+#include "mono_time.h"
+
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_WHEEL_SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+/* After the wheel slots come the list of entries that are due and the list of
+ * entries `timer_wheel_run` is working through. */
+#define TIMER_LIST_DUE (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS)
+#define TIMER_LIST_RUNNING (TIMER_LIST_DUE + 1)
+#define TIMER_NUM_LISTS (TIMER_LIST_RUNNING + 1)
+#define TIMER_LIST_NONE UINT16_MAX
+
+#define TIMER_NIL UINT32_MAX
+
+typedef struct Timer_Node {
+    uint64_t deadline;
+    uint32_t next;
+    uint32_t prev;
+    /* The list this entry is in, or TIMER_LIST_NONE if it is not scheduled. */
+    uint16_t list;
+} Timer_Node;
+
+typedef struct Timer_List {
+    uint32_t head;
+    uint32_t tail;
+} Timer_List;
+
+struct Timer_Wheel {
+    const Memory *_Nonnull mem;
+    const Mono_Time *_Nonnull mono_time;
+
+    timer_wheel_cb *_Nonnull callback;
+    void *_Nonnull object;
+
+    Timer_Node *_Nullable nodes;
+    uint32_t nodes_size;
+    uint32_t count;
+
+    /* Every deadline up to and including this time has been moved to the due list. */
+    uint64_t now;
+
+    /* Bit i of occupied[level] is set if slot i of that level is not empty. */
+    uint64_t occupied[TIMER_WHEEL_LEVELS];
+    Timer_List lists[TIMER_NUM_LISTS];
+
+    /* The earliest deadline added to each wheel slot since it was last empty.
+     * Removing an entry does not raise it, so it is a lower bound. */
+    uint64_t slot_min[TIMER_LIST_DUE];
+};
+
+static uint32_t lowest_bit(uint64_t bits)
+{
+    uint32_t index = 0;
+
+    for (uint32_t width = 32; width != 0; width /= 2) {
+        const uint64_t low_mask = (UINT64_C(1) << width) - 1;
+
+        if ((bits & low_mask) == 0) {
+            bits >>= width;
+            index += width;
+        }
+    }
+
+    return index;
+}
+
+static void list_append(Timer_Wheel *_Nonnull wheel, uint16_t list, uint32_t id)
+{
+    Timer_Node *const node = &wheel->nodes[id];
+    Timer_List *const l = &wheel->lists[list];
+
+    node->list = list;
+    node->next = TIMER_NIL;
+    node->prev = l->tail;
+
+    if (l->tail != TIMER_NIL) {
+        wheel->nodes[l->tail].next = id;
+    } else {
+        l->head = id;
+    }
+
+    l->tail = id;
+
+    if (list < TIMER_LIST_DUE) {
+        const uint64_t bit = UINT64_C(1) << (list % TIMER_WHEEL_SLOTS);
+        uint64_t *const occupied = &wheel->occupied[list / TIMER_WHEEL_SLOTS];
+
+        if ((*occupied & bit) == 0 || node->deadline < wheel->slot_min[list]) {
+            wheel->slot_min[list] = node->deadline;
+        }
+
+        *occupied |= bit;
+    }
+}
+
+static void list_remove(Timer_Wheel *_Nonnull wheel, uint32_t id)
+{
+    Timer_Node *const node = &wheel->nodes[id];
+    Timer_List *const l = &wheel->lists[node->list];
+
+    if (node->prev != TIMER_NIL) {
+        wheel->nodes[node->prev].next = node->next;
+    } else {
+        l->head = node->next;
+    }
+
+    if (node->next != TIMER_NIL) {
+        wheel->nodes[node->next].prev = node->prev;
+    } else {
+        l->tail = node->prev;
+    }
+
+    if (node->list < TIMER_LIST_DUE && l->head == TIMER_NIL) {
+        wheel->occupied[node->list / TIMER_WHEEL_SLOTS] &= ~(UINT64_C(1) << (node->list % TIMER_WHEEL_SLOTS));
+    }
+
+    node->list = TIMER_LIST_NONE;
+}
+
+static uint16_t slot_of(uint32_t level, uint64_t period)
+{
+    return (uint16_t)(level * TIMER_WHEEL_SLOTS + (period & TIMER_WHEEL_SLOT_MASK));
+}
+
+/** @brief Put a node into the due list or the finest wheel slot that covers its deadline. */
+static void place(Timer_Wheel *_Nonnull wheel, uint32_t id)
+{
+    const uint64_t deadline = wheel->nodes[id].deadline;
+
+    if (deadline <= wheel->now) {
+        list_append(wheel, TIMER_LIST_DUE, id);
+        return;
+    }
+
+    uint32_t level;
+    uint64_t period = 0;
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        const uint32_t shift = level * TIMER_WHEEL_SLOT_BITS;
+        period = deadline >> shift;
+
+        if (period - (wheel->now >> shift) < TIMER_WHEEL_SLOTS) {
+            break;
+        }
+    }
+
+    if (level == TIMER_WHEEL_LEVELS) {
+        /* Out of range: park it in the farthest top level slot. */
+        level = TIMER_WHEEL_LEVELS - 1;
+        period = (wheel->now >> (level * TIMER_WHEEL_SLOT_BITS)) + TIMER_WHEEL_SLOTS - 1;
+    }
+
+    list_append(wheel, slot_of(level, period), id);
+}
+
+/** @brief The period of the earliest non-empty slot of a level, or 0 if it is empty.
+ *
+ * Slots hold periods from 1 to 63 after the current one, so the earliest is
+ * the first occupied slot after the current slot, wrapping around.
+ */
+static uint64_t first_period(const Timer_Wheel *_Nonnull wheel, uint32_t level)
+{
+    const uint64_t occupied = wheel->occupied[level];
+
+    if (occupied == 0) {
+        return 0;
+    }
+
+    const uint64_t current = wheel->now >> (level * TIMER_WHEEL_SLOT_BITS);
+    const uint32_t start = (uint32_t)((current + 1) & TIMER_WHEEL_SLOT_MASK);
+    const uint64_t rotated = start == 0 ? occupied : (occupied >> start) | (occupied << (TIMER_WHEEL_SLOTS - start));
+
+    return current + 1 + lowest_bit(rotated);
+}
+
+/** @brief Move the wheel forward to `target`, moving every entry that comes due to the due list. */
+static void advance(Timer_Wheel *_Nonnull wheel, uint64_t target)
+{
+    while (wheel->now < target) {
+        /* The next time anything happens: a level 0 deadline, or the start
+         * of an occupied slot in a higher level, whose entries then move down. */
+        uint64_t next = UINT64_MAX;
+
+        for (uint32_t level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+            const uint64_t period = first_period(wheel, level);
+
+            if (period != 0) {
+                const uint64_t start = period << (level * TIMER_WHEEL_SLOT_BITS);
+                next = start < next ? start : next;
+            }
+        }
+
+        if (next > target) {
+            wheel->now = target;
+            return;
+        }
+
+        wheel->now = next;
+
+        for (uint32_t level = TIMER_WHEEL_LEVELS; level-- != 0;) {
+            const uint32_t shift = level * TIMER_WHEEL_SLOT_BITS;
+
+            if (level > 0 && (next & ((UINT64_C(1) << shift) - 1)) != 0) {
+                continue;
+            }
+
+            Timer_List *const l = &wheel->lists[slot_of(level, next >> shift)];
+
+            while (l->head != TIMER_NIL) {
+                const uint32_t id = l->head;
+                list_remove(wheel, id);
+                place(wheel, id);
+            }
+        }
+    }
+}
+
+/** @brief Move the wheel back to `target` when the clock went backwards.
+ *
+ * This happens when a Mono_Time gets a new time source. Every entry is placed
+ * again, relative to the new time.
+ */
+static void rewind_to(Timer_Wheel *_Nonnull wheel, uint64_t target)
+{
+    wheel->now = target;
+
+    for (uint16_t list = 0; list < TIMER_LIST_DUE; ++list) {
+        const Timer_List slot = wheel->lists[list];
+
+        if (slot.head == TIMER_NIL) {
+            continue;
+        }
+
+        wheel->lists[list].head = TIMER_NIL;
+        wheel->lists[list].tail = TIMER_NIL;
+        wheel->occupied[list / TIMER_WHEEL_SLOTS] &= ~(UINT64_C(1) << (list % TIMER_WHEEL_SLOTS));
+
+        uint32_t id = slot.head;
+
+        while (id != TIMER_NIL) {
+            const uint32_t next = wheel->nodes[id].next;
+            place(wheel, id);
+            id = next;
+        }
+    }
+}
+
+Timer_Wheel *timer_wheel_new(const Memory *mem, const Mono_Time *mono_time, timer_wheel_cb *callback, void *object)
+{
+    Timer_Wheel *const wheel = (Timer_Wheel *)mem_alloc(mem, sizeof(Timer_Wheel));
+
+    if (wheel == nullptr) {
+        return nullptr;
+    }
+
+    wheel->mem = mem;
+    wheel->mono_time = mono_time;
+    wheel->callback = callback;
+    wheel->object = object;
+    wheel->now = mono_time_get_ms(mono_time);
+
+    for (uint32_t i = 0; i < TIMER_NUM_LISTS; ++i) {
+        wheel->lists[i].head = TIMER_NIL;
+        wheel->lists[i].tail = TIMER_NIL;
+    }
+
+    return wheel;
+}
+
+void timer_wheel_kill(Timer_Wheel *wheel)
+{
+    if (wheel == nullptr) {
+        return;
+    }
+
+    mem_delete(wheel->mem, wheel->nodes);
+    mem_delete(wheel->mem, wheel);
+}
+
+/** @brief Make sure there is a node for `id`. */
+static bool reserve(Timer_Wheel *_Nonnull wheel, uint32_t id)
+{
+    if (id < wheel->nodes_size) {
+        return true;
+    }
+
+    if (id == TIMER_NIL) {
+        return false;
+    }
+
+    uint32_t new_size = wheel->nodes_size < 8 ? 8 : wheel->nodes_size;
+
+    while (new_size <= id) {
+        new_size = new_size > UINT32_MAX / 2 ? UINT32_MAX : new_size * 2;
+    }
+
+    Timer_Node *const nodes = (Timer_Node *)mem_vrealloc(wheel->mem, wheel->nodes, new_size, sizeof(Timer_Node));
+
+    if (nodes == nullptr) {
+        return false;
+    }
+
+    for (uint32_t i = wheel->nodes_size; i < new_size; ++i) {
+        nodes[i].list = TIMER_LIST_NONE;
+    }
+
+    wheel->nodes = nodes;
+    wheel->nodes_size = new_size;
+    return true;
+}
+
+static void unschedule(Timer_Wheel *_Nonnull wheel, uint32_t id)
+{
+    list_remove(wheel, id);
+    --wheel->count;
+}
+
+bool timer_wheel_schedule(Timer_Wheel *wheel, uint32_t id, uint64_t deadline)
+{
+    if (!reserve(wheel, id)) {
+        return false;
+    }
+
+    if (wheel->nodes[id].list != TIMER_LIST_NONE) {
+        unschedule(wheel, id);
+    }
+
+    ++wheel->count;
+    wheel->nodes[id].deadline = deadline;
+    place(wheel, id);
+    return true;
+}
+
+bool timer_wheel_wake(Timer_Wheel *wheel, uint32_t id)
+{
+    return timer_wheel_schedule(wheel, id, wheel->now);
+}
+
+void timer_wheel_cancel(Timer_Wheel *wheel, uint32_t id)
+{
+    if (!timer_wheel_is_scheduled(wheel, id)) {
+        return;
+    }
+
+    unschedule(wheel, id);
+}
+
+bool timer_wheel_is_scheduled(const Timer_Wheel *wheel, uint32_t id)
+{
+    return id < wheel->nodes_size && wheel->nodes[id].list != TIMER_LIST_NONE;
+}
+
+uint32_t timer_wheel_size(const Timer_Wheel *wheel)
+{
+    return wheel->count;
+}
+
+uint32_t timer_wheel_run(Timer_Wheel *wheel, void *userdata)
+{
+    const uint64_t cur_time = mono_time_get_ms(wheel->mono_time);
+
+    if (cur_time < wheel->now) {
+        rewind_to(wheel, cur_time);
+    } else {
+        advance(wheel, cur_time);
+    }
+
+    /* Entries the callbacks make due go to the due list and wait for the
+     * next run, so a callback that keeps waking itself can't loop here. */
+    Timer_List *const due = &wheel->lists[TIMER_LIST_DUE];
+    Timer_List *const running = &wheel->lists[TIMER_LIST_RUNNING];
+
+    for (uint32_t id = due->head; id != TIMER_NIL; id = wheel->nodes[id].next) {
+        wheel->nodes[id].list = TIMER_LIST_RUNNING;
+    }
+
+    *running = *due;
+    due->head = TIMER_NIL;
+    due->tail = TIMER_NIL;
+
+    uint32_t ran = 0;
+
+    while (running->head != TIMER_NIL) {
+        const uint32_t id = running->head;
+        unschedule(wheel, id);
+        ++ran;
+        wheel->callback(wheel->object, id, userdata);
+    }
+
+    return ran;
+}
+
+uint64_t timer_wheel_next_deadline(const Timer_Wheel *wheel)
+{
+    if (wheel->lists[TIMER_LIST_DUE].head != TIMER_NIL || wheel->lists[TIMER_LIST_RUNNING].head != TIMER_NIL) {
+        return wheel->now;
+    }
+
+    uint64_t earliest = TIMER_WHEEL_NO_DEADLINE;
+
+    for (uint32_t level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        if (wheel->occupied[level] == 0) {
+            continue;
+        }
+
+        /* Deadlines in a slot are never before the start of its period, so
+         * stop at the first slot that starts after the earliest deadline seen.
+         * That is after one slot, except when the top level has parked
+         * entries whose deadlines are far beyond their slot. */
+        const uint32_t shift = level * TIMER_WHEEL_SLOT_BITS;
+
+        for (uint64_t period = first_period(wheel, level);
+                period <= (wheel->now >> shift) + TIMER_WHEEL_SLOTS && (period << shift) < earliest; ++period) {
+            const uint16_t list = slot_of(level, period);
+
+            if (wheel->lists[list].head != TIMER_NIL && wheel->slot_min[list] < earliest) {
+                earliest = wheel->slot_min[list];
+            }
+        }
+    }
+
+    return earliest;
+}
@@ -0,0 +1,92 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+/**
+ * Hierarchical timing wheel for per-object deadlines.
+ *
+ * A module registers a deadline (in Mono_Time milliseconds) for each of its
+ * objects, identified by a small integer such as a friend connection id. Each
+ * `timer_wheel_run` calls the module's callback for the objects whose
+ * deadline has passed, and touches no others, so an iteration costs the same
+ * with ten objects or ten thousand when nothing is due.
+ *
+ * Deadlines are kept in 4 levels of 64 slots. Level 0 slots are 1 ms wide,
+ * and each level above is 64 times coarser. An entry sits in the finest level
+ * that covers its deadline and moves down a level when the wheel reaches its
+ * slot. Deadlines more than about 4.6 hours out park in the last slot of the
+ * top level until they come within range.
+ */
+#ifndef C_TOXCORE_TOXCORE_TIMER_WHEEL_H
+#define C_TOXCORE_TOXCORE_TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "attributes.h"
+#include "mem.h"
+#include "mono_time.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Returned by `timer_wheel_next_deadline` when nothing is scheduled. */
+#define TIMER_WHEEL_NO_DEADLINE UINT64_MAX
+
+typedef struct Timer_Wheel Timer_Wheel;
+
+/** @brief Called by `timer_wheel_run` for each entry that is due.
+ *
+ * The entry is no longer scheduled when this is called. The callback may
+ * schedule or cancel any entry, including `id`. Entries it schedules for a
+ * time that has already passed run on the next `timer_wheel_run`.
+ */
+typedef void timer_wheel_cb(void *_Nonnull object, uint32_t id, void *_Nullable userdata);
+
+Timer_Wheel *_Nullable timer_wheel_new(const Memory *_Nonnull mem, const Mono_Time *_Nonnull mono_time,
+                                       timer_wheel_cb *_Nonnull callback, void *_Nonnull object);
+
+void timer_wheel_kill(Timer_Wheel *_Nullable wheel);
+
+/** @brief Schedule entry `id` to run at `deadline` (in ms, see `mono_time_get_ms`).
+ *
+ * Replaces any deadline the entry already had. A deadline that has already
+ * passed runs on the next `timer_wheel_run`.
+ *
+ * @retval false if memory for the entry could not be allocated.
+ */
+bool timer_wheel_schedule(Timer_Wheel *_Nonnull wheel, uint32_t id, uint64_t deadline);
+
+/** @brief Schedule entry `id` to run on the next `timer_wheel_run`. */
+bool timer_wheel_wake(Timer_Wheel *_Nonnull wheel, uint32_t id);
+
+/** @brief Unschedule entry `id`. Does nothing if it is not scheduled. */
+void timer_wheel_cancel(Timer_Wheel *_Nonnull wheel, uint32_t id);
+
+bool timer_wheel_is_scheduled(const Timer_Wheel *_Nonnull wheel, uint32_t id);
+
+/** @brief Number of entries that are scheduled. */
+uint32_t timer_wheel_size(const Timer_Wheel *_Nonnull wheel);
+
+/** @brief Run the callback for every entry whose deadline is at or before the current time.
+ *
+ * @return the number of callbacks run.
+ */
+uint32_t timer_wheel_run(Timer_Wheel *_Nonnull wheel, void *_Nullable userdata);
+
+/** @brief The earliest deadline of any scheduled entry, in ms.
+ *
+ * This is exact unless entries were cancelled or moved since the wheel slot
+ * with the earliest deadline was last empty. It can then be early, but it is
+ * never later than the earliest deadline.
+ *
+ * @return TIMER_WHEEL_NO_DEADLINE if no entry is scheduled.
+ */
+uint64_t timer_wheel_next_deadline(const Timer_Wheel *_Nonnull wheel);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* C_TOXCORE_TOXCORE_TIMER_WHEEL_H */
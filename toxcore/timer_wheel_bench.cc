@@ -0,0 +1,111 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "mono_time.h"
+#include "os_memory.h"
+#include "timer_wheel.h"
+
+namespace {
+
+/** @brief Period of each entry, like the friend connection ping interval. */
+constexpr std::uint64_t kPeriodMs = 8000;
+/** @brief Simulated time between iterations, as with an idle Tox instance. */
+constexpr std::uint64_t kIterationMs = 50;
+
+/** @brief An object with timed work, about the size of a Friend_Conn. */
+struct Object {
+    std::uint64_t last_run;
+    std::uint8_t state[1784];
+};
+
+struct Entries {
+    Timer_Wheel *wheel = nullptr;
+    std::vector<Object> objects;
+    const Mono_Time *mono_time = nullptr;
+    std::uint64_t runs = 0;
+};
+
+void on_timer(void *object, std::uint32_t id, void *userdata)
+{
+    auto *entries = static_cast<Entries *>(object);
+    const std::uint64_t now = mono_time_get_ms(entries->mono_time);
+    entries->objects[id].last_run = now;
+    ++entries->runs;
+    timer_wheel_schedule(entries->wheel, id, now + kPeriodMs);
+}
+
+/**
+ * @brief One iteration of a module with `range(0)` objects that each have work
+ * every 8 seconds, at random phases, with the clock moving 50 ms per iteration.
+ *
+ * range(1): 0 runs the due entries from a timer wheel, 1 checks every object's
+ *   timestamp, as do_friend_connections used to.
+ */
+void BM_PeriodicWork(benchmark::State &state)
+{
+    const auto num_entries = static_cast<std::uint32_t>(state.range(0));
+    const bool scan = state.range(1) != 0;
+
+    std::uint64_t clock_ms = 1000000;
+    Mono_Time *mono_time = mono_time_new(os_memory(), nullptr, nullptr);
+    mono_time_set_current_time_callback(
+        mono_time, [](void *_Nullable user_data) { return *static_cast<std::uint64_t *>(user_data); },
+        &clock_ms);
+    mono_time_update(mono_time);
+
+    Entries entries;
+    entries.mono_time = mono_time;
+    entries.objects.resize(num_entries);
+    entries.wheel = timer_wheel_new(os_memory(), mono_time, &on_timer, &entries);
+
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<std::uint64_t> phase(0, kPeriodMs - 1);
+    const std::uint64_t start = mono_time_get_ms(mono_time);
+
+    for (std::uint32_t id = 0; id < num_entries; ++id) {
+        entries.objects[id].last_run = start - phase(gen);
+        timer_wheel_schedule(entries.wheel, id, entries.objects[id].last_run + kPeriodMs);
+    }
+
+    for (auto _ : state) {
+        clock_ms += kIterationMs;
+        mono_time_update(mono_time);
+
+        if (scan) {
+            const std::uint64_t now = mono_time_get_ms(mono_time);
+
+            for (std::uint32_t id = 0; id < num_entries; ++id) {
+                if (entries.objects[id].last_run + kPeriodMs <= now) {
+                    entries.objects[id].last_run = now;
+                    ++entries.runs;
+                }
+            }
+        } else {
+            timer_wheel_run(entries.wheel, nullptr);
+            benchmark::DoNotOptimize(timer_wheel_next_deadline(entries.wheel));
+            benchmark::ClobberMemory();
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.counters["runs/iter"] = static_cast<double>(entries.runs) / static_cast<double>(state.iterations());
+
+    timer_wheel_kill(entries.wheel);
+    mono_time_free(os_memory(), mono_time);
+}
+
+BENCHMARK(BM_PeriodicWork)
+    ->ArgNames({"entries", "scan"})
+    ->ArgsProduct({{100, 1000, 10000, 100000}, {0, 1}});
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,273 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include "timer_wheel.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "mono_time.h"
+#include "os_memory.h"
+
+namespace {
+
+class TimerWheelTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        mono_time = mono_time_new(os_memory(), nullptr, nullptr);
+        ASSERT_NE(mono_time, nullptr);
+        mono_time_set_current_time_callback(
+            mono_time, [](void *_Nullable user_data) { return *static_cast<std::uint64_t *>(user_data); },
+            &clock_ms);
+        mono_time_update(mono_time);
+
+        wheel = timer_wheel_new(os_memory(), mono_time, &TimerWheelTest::on_timer, this);
+        ASSERT_NE(wheel, nullptr);
+    }
+
+    void TearDown() override
+    {
+        timer_wheel_kill(wheel);
+        mono_time_free(os_memory(), mono_time);
+    }
+
+    void advance(std::uint64_t ms)
+    {
+        clock_ms += ms;
+        mono_time_update(mono_time);
+    }
+
+    std::uint64_t now() const { return mono_time_get_ms(mono_time); }
+
+    /** @brief Run the wheel and return the ids it fired, in order. */
+    std::vector<std::uint32_t> run()
+    {
+        fired.clear();
+        const std::uint32_t ran = timer_wheel_run(wheel, nullptr);
+        EXPECT_EQ(ran, fired.size());
+        return fired;
+    }
+
+    static void on_timer(void *object, std::uint32_t id, void *userdata)
+    {
+        auto *self = static_cast<TimerWheelTest *>(object);
+        EXPECT_FALSE(timer_wheel_is_scheduled(self->wheel, id));
+        self->fired.push_back(id);
+
+        if (self->period != 0) {
+            timer_wheel_schedule(self->wheel, id, self->now() + self->period);
+        }
+
+        if (self->wake_self) {
+            timer_wheel_wake(self->wheel, id);
+        }
+    }
+
+    std::uint64_t clock_ms = 1000000;
+    Mono_Time *mono_time = nullptr;
+    Timer_Wheel *wheel = nullptr;
+    std::vector<std::uint32_t> fired;
+    std::uint64_t period = 0;
+    bool wake_self = false;
+};
+
+TEST_F(TimerWheelTest, EmptyWheelHasNoDeadline)
+{
+    EXPECT_EQ(timer_wheel_next_deadline(wheel), TIMER_WHEEL_NO_DEADLINE);
+    EXPECT_EQ(timer_wheel_size(wheel), 0);
+    advance(5000);
+    EXPECT_TRUE(run().empty());
+}
+
+TEST_F(TimerWheelTest, FiresAtDeadlineAndNotBefore)
+{
+    ASSERT_TRUE(timer_wheel_schedule(wheel, 3, now() + 10000));
+    EXPECT_TRUE(timer_wheel_is_scheduled(wheel, 3));
+    EXPECT_EQ(timer_wheel_next_deadline(wheel), now() + 10000);
+
+    advance(9999);
+    EXPECT_TRUE(run().empty());
+    EXPECT_EQ(timer_wheel_next_deadline(wheel), now() + 1);
+
+    advance(1);
+    EXPECT_EQ(run(), std::vector<std::uint32_t>{3});
+    EXPECT_FALSE(timer_wheel_is_scheduled(wheel, 3));
+    EXPECT_EQ(timer_wheel_size(wheel), 0);
+}
+
+TEST_F(TimerWheelTest, FiresInDeadlineOrder)
+{
+    ASSERT_TRUE(timer_wheel_schedule(wheel, 0, now() + 300000));
+    ASSERT_TRUE(timer_wheel_schedule(wheel, 1, now() + 20));
+    ASSERT_TRUE(timer_wheel_schedule(wheel, 2, now() + 5000));
+    ASSERT_TRUE(timer_wheel_schedule(wheel, 3, now()));
+
+    advance(1000000);
+    EXPECT_EQ(run(), (std::vector<std::uint32_t>{3, 1, 2, 0}));
+}
+
+TEST_F(TimerWheelTest, RescheduleAndCancel)
+{
+    ASSERT_TRUE(timer_wheel_schedule(wheel, 1, now() + 100));
+    ASSERT_TRUE(timer_wheel_schedule(wheel, 2, now() + 100));
+    ASSERT_TRUE(timer_wheel_schedule(wheel, 1, now() + 500));
+    timer_wheel_cancel(wheel, 2);
+    timer_wheel_cancel(wheel, 7);
+    EXPECT_EQ(timer_wheel_size(wheel), 1);
+
+    advance(100);
+    EXPECT_TRUE(run().empty());
+    advance(400);
+    EXPECT_EQ(run(), std::vector<std::uint32_t>{1});
+}
+
+TEST_F(TimerWheelTest, FarDeadlinesFireOnTime)
+{
+    const std::uint64_t far = UINT64_C(24) * 3600 * 1000;
+    ASSERT_TRUE(timer_wheel_schedule(wheel, 0, now() + far));
+    EXPECT_EQ(timer_wheel_next_deadline(wheel), now() + far);
+
+    for (int hour = 0; hour < 23; ++hour) {
+        advance(3600 * 1000);
+        EXPECT_TRUE(run().empty());
+    }
+
+    advance(3600 * 1000 - 1);
+    EXPECT_TRUE(run().empty());
+    advance(1);
+    EXPECT_EQ(run(), std::vector<std::uint32_t>{0});
+}
+
+TEST_F(TimerWheelTest, NextDeadlineIsExactWithoutCancels)
+{
+    std::mt19937 gen{7};
+    std::uint64_t earliest = TIMER_WHEEL_NO_DEADLINE;
+
+    for (std::uint32_t id = 0; id < 1000; ++id) {
+        const std::uint64_t deadline = now() + 100 + gen() % (UINT64_C(10) * 3600 * 1000);
+        ASSERT_TRUE(timer_wheel_schedule(wheel, id, deadline));
+        earliest = std::min(earliest, deadline);
+        ASSERT_EQ(timer_wheel_next_deadline(wheel), earliest);
+    }
+
+    advance(earliest - now() - 1);
+    EXPECT_TRUE(run().empty());
+    EXPECT_EQ(timer_wheel_next_deadline(wheel), earliest);
+}
+
+TEST_F(TimerWheelTest, ClockGoingBackwardsKeepsDeadlines)
+{
+    const std::uint64_t start = now();
+    ASSERT_TRUE(timer_wheel_schedule(wheel, 0, start + 100));
+    ASSERT_TRUE(timer_wheel_schedule(wheel, 1, start + 100000));
+
+    clock_ms -= 50000;
+    mono_time_update(mono_time);
+    EXPECT_TRUE(run().empty());
+    ASSERT_TRUE(timer_wheel_schedule(wheel, 2, now() + 10));
+
+    advance(10);
+    EXPECT_EQ(run(), std::vector<std::uint32_t>{2});
+    advance(50090);
+    EXPECT_EQ(run(), std::vector<std::uint32_t>{0});
+    EXPECT_EQ(timer_wheel_next_deadline(wheel), start + 100000);
+}
+
+TEST_F(TimerWheelTest, CallbackCanRescheduleItself)
+{
+    period = 8000;
+    ASSERT_TRUE(timer_wheel_schedule(wheel, 0, now() + period));
+
+    for (int i = 0; i < 10; ++i) {
+        advance(period);
+        EXPECT_EQ(run(), std::vector<std::uint32_t>{0});
+    }
+
+    EXPECT_EQ(timer_wheel_next_deadline(wheel), now() + period);
+}
+
+TEST_F(TimerWheelTest, WakeDuringRunWaitsForNextRun)
+{
+    wake_self = true;
+    ASSERT_TRUE(timer_wheel_wake(wheel, 4));
+    EXPECT_EQ(timer_wheel_next_deadline(wheel), now());
+
+    EXPECT_EQ(run(), std::vector<std::uint32_t>{4});
+    EXPECT_EQ(run(), std::vector<std::uint32_t>{4});
+}
+
+TEST_F(TimerWheelTest, MatchesReferenceUnderRandomLoad)
+{
+    constexpr std::uint32_t kIds = 500;
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<std::uint32_t> pick_id(0, kIds - 1);
+    std::uniform_int_distribution<int> pick_op(0, 9);
+
+    std::map<std::uint32_t, std::uint64_t> expected;
+
+    const auto random_delay = [&]() -> std::uint64_t {
+        switch (gen() % 4) {
+        case 0:
+            return gen() % 64;
+        case 1:
+            return gen() % 10000;
+        case 2:
+            return gen() % 600000;
+        default:
+            return gen() % (UINT64_C(48) * 3600 * 1000);
+        }
+    };
+
+    for (int step = 0; step < 20000; ++step) {
+        const std::uint32_t id = pick_id(gen);
+        const int op = pick_op(gen);
+
+        if (op < 6) {
+            const std::uint64_t deadline = now() + random_delay();
+            ASSERT_TRUE(timer_wheel_schedule(wheel, id, deadline));
+            expected[id] = deadline;
+        } else if (op < 8) {
+            timer_wheel_cancel(wheel, id);
+            expected.erase(id);
+        } else {
+            advance(op == 8 ? gen() % 200 : random_delay());
+
+            std::set<std::uint32_t> due;
+            for (auto it = expected.begin(); it != expected.end();) {
+                if (it->second <= now()) {
+                    due.insert(it->first);
+                    it = expected.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+
+            const std::vector<std::uint32_t> ran = run();
+            ASSERT_EQ(std::set<std::uint32_t>(ran.begin(), ran.end()), due);
+            ASSERT_EQ(ran.size(), due.size());
+        }
+
+        ASSERT_EQ(timer_wheel_size(wheel), expected.size());
+
+        std::uint64_t earliest = TIMER_WHEEL_NO_DEADLINE;
+        for (const auto &[key, deadline] : expected) {
+            earliest = std::min(earliest, deadline);
+        }
+        // Cancelled entries can make the reported deadline early, never late.
+        const std::uint64_t next = timer_wheel_next_deadline(wheel);
+        ASSERT_LE(next, earliest);
+        if (earliest > now()) {
+            ASSERT_GT(next, now());
+        }
+    }
+}
+
+}  // namespace
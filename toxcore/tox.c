@@ -26,6 +26,7 @@
 #include "group.h"
 #include "group_chats.h"
 #include "group_common.h"
+#include "iter_profile.h"
 #include "logger.h"
 #include "mem.h"
 #include "mono_time.h"
@@ -33,6 +34,9 @@
 #include "net_crypto.h"
 #include "network.h"
 #include "onion_client.h"
+#include "os_event.h"
+#include "os_network.h"
+#include "socket_watch.h"
 #include "state.h"
 #include "tox_log_level.h"
 #include "tox_options.h"
@@ -76,11 +80,6 @@ static_assert(TOX_GROUP_MAX_MESSAGE_LENGTH == GROUP_MAX_MESSAGE_LENGTH,
 static_assert(TOX_MAX_CUSTOM_PACKET_SIZE == MAX_GC_CUSTOM_LOSSLESS_PACKET_SIZE,
               "TOX_MAX_CUSTOM_PACKET_SIZE is assumed to be equal to MAX_GC_CUSTOM_LOSSLESS_PACKET_SIZE");
 
-struct Tox_Userdata {
-    Tox *_Nonnull tox;
-    void *_Nullable user_data;
-};
-
 static logger_cb tox_log_handler;
 static void tox_log_handler(void *context, Logger_Level level, const char *file, uint32_t line, const char *func,
                             const char *message, void *userdata)
@@ -225,6 +224,20 @@ static void tox_file_chunk_request_handler(Messenger *m, uint32_t friend_number,
     }
 }
 
+static m_file_read_cb tox_file_read_handler;
+static int32_t tox_file_read_handler(Messenger *m, uint32_t friend_number, uint32_t file_number, uint64_t position,
+                                     uint8_t *data, uint16_t length, void *user_data)
+{
+    struct Tox_Userdata *tox_data = (struct Tox_Userdata *)user_data;
+    if (tox_data->tox->file_read_callback == nullptr) {
+        return -1;
+    }
+
+    // Called while building a packet in the send queue, so the lock is kept.
+    return tox_data->tox->file_read_callback(tox_data->tox, friend_number, file_number, position, data, length,
+            tox_data->user_data);
+}
+
 static m_file_recv_cb tox_file_recv_handler;
 static void tox_file_recv_handler(Messenger *m, uint32_t friend_number, uint32_t file_number, uint32_t kind,
                                   uint64_t file_size, const uint8_t *filename, size_t filename_length, void *user_data)
@@ -635,7 +648,138 @@ static int tox_load(Tox *_Nonnull tox, const uint8_t *_Nonnull data, uint32_t le
                       length - cookie_len, STATE_COOKIE_TYPE);
 }
 
-static Tox *_Nullable tox_new_system(const struct Tox_Options *_Nullable options, Tox_Err_New *_Nullable error, const Tox_System *_Nullable sys)
+typedef struct Tox_Savedata_Source {
+    tox_savedata_read_cb *_Nonnull read;
+    void *_Nullable user_data;
+} Tox_Savedata_Source;
+
+static uint32_t tox_savedata_source_read(void *_Nullable user_data, uint8_t *_Nonnull data, uint32_t length)
+{
+    const Tox_Savedata_Source *source = (const Tox_Savedata_Source *)user_data;
+    assert(source != nullptr);
+    return (uint32_t)min_u64(source->read(data, length, source->user_data), length);
+}
+
+static State_Load_Status state_read_callback(void *_Nonnull outer, State_Reader *_Nonnull reader, uint32_t length, uint16_t type)
+{
+    Tox *tox = (Tox *)outer;
+    State_Load_Status status = STATE_LOAD_STATUS_CONTINUE;
+
+    if (messenger_read_state_section(tox->m, reader, length, type, &status)) {
+        return status;
+    }
+
+    const uint8_t *data = state_reader_read_chunk(reader, length);
+
+    if (data == nullptr) {
+        return STATE_LOAD_STATUS_ERROR;
+    }
+
+    return state_load_callback(tox, data, length, type);
+}
+
+/** @brief Load tox from a callback.
+ *
+ * @retval -2 if the save is encrypted.
+ */
+static int tox_load_stream(Tox *_Nonnull tox, tox_savedata_read_cb *_Nonnull read, void *_Nullable user_data)
+{
+    Tox_Savedata_Source source = {read, user_data};
+    State_Reader reader;
+    state_reader_init(&reader, tox->sys.mem, tox_savedata_source_read, &source);
+
+    uint8_t cookie[sizeof(uint32_t) * 2];
+    static_assert(sizeof(cookie) == TOX_ENC_SAVE_MAGIC_LENGTH, "the cookie and the encrypted save magic differ in size");
+
+    if (reader.read(reader.user_data, cookie, sizeof(cookie)) != sizeof(cookie)) {
+        return -1;
+    }
+
+    if (memcmp(cookie, TOX_ENC_SAVE_MAGIC_NUMBER, TOX_ENC_SAVE_MAGIC_LENGTH) == 0) {
+        return -2;
+    }
+
+    uint32_t data32[2];
+    memcpy(data32, cookie, sizeof(uint32_t));
+    lendian_bytes_to_host32(data32 + 1, cookie + sizeof(uint32_t));
+
+    if (data32[0] != 0 || data32[1] != STATE_COOKIE_GLOBAL) {
+        return -1;
+    }
+
+    const int ret = state_load_stream(tox->m->log, state_read_callback, tox, &reader, STATE_COOKIE_TYPE);
+    state_reader_free(&reader);
+    return ret;
+}
+
+/** @brief Read the proxy settings from the options.
+ *
+ * @retval false if they are invalid. The error is set then.
+ */
+static bool tox_parse_proxy_info(const struct Tox_Options *_Nonnull opts, const Network *_Nonnull ns, const Memory *_Nonnull mem,
+                                 bool ipv6enabled, TCP_Proxy_Info *_Nonnull proxy_info, Tox_Err_New *_Nullable error)
+{
+    switch (tox_options_get_proxy_type(opts)) {
+        case TOX_PROXY_TYPE_HTTP: {
+            proxy_info->proxy_type = TCP_PROXY_HTTP;
+            break;
+        }
+
+        case TOX_PROXY_TYPE_SOCKS5: {
+            proxy_info->proxy_type = TCP_PROXY_SOCKS5;
+            break;
+        }
+
+        case TOX_PROXY_TYPE_NONE: {
+            proxy_info->proxy_type = TCP_PROXY_NONE;
+            break;
+        }
+
+        default: {
+            SET_ERROR_PARAMETER(error, TOX_ERR_NEW_PROXY_BAD_TYPE);
+            return false;
+        }
+    }
+
+    if (proxy_info->proxy_type == TCP_PROXY_NONE) {
+        return true;
+    }
+
+    if (tox_options_get_proxy_port(opts) == 0) {
+        SET_ERROR_PARAMETER(error, TOX_ERR_NEW_PROXY_BAD_PORT);
+        return false;
+    }
+
+    ip_init(&proxy_info->ip_port.ip, ipv6enabled);
+
+    if (ipv6enabled) {
+        proxy_info->ip_port.ip.family = net_family_unspec();
+    }
+
+    const char *const proxy_host = tox_options_get_proxy_host(opts);
+    const bool dns_enabled = !tox_options_get_experimental_disable_dns(opts);
+
+    if (proxy_host == nullptr
+            || !addr_resolve_or_parse_ip(ns, mem, proxy_host, &proxy_info->ip_port.ip, nullptr, dns_enabled)) {
+        SET_ERROR_PARAMETER(error, TOX_ERR_NEW_PROXY_BAD_HOST);
+        // TODO(irungentoo): TOX_ERR_NEW_PROXY_NOT_FOUND if domain.
+        return false;
+    }
+
+    proxy_info->ip_port.port = net_htons(tox_options_get_proxy_port(opts));
+    return true;
+}
+
+/** @brief Free the mono_time of a Tox, unless it belongs to the host. */
+static void tox_free_mono_time(Tox *_Nonnull tox)
+{
+    if (tox->host == nullptr) {
+        mono_time_free(tox->sys.mem, tox->mono_time);
+    }
+}
+
+static Tox *_Nullable tox_new_system(const struct Tox_Options *_Nullable options, Tox_Err_New *_Nullable error, const Tox_System *_Nullable sys,
+                                     Tox_Host *_Nullable host)
 {
     struct Tox_Options *default_options = nullptr;
     if (options == nullptr) {
@@ -681,8 +825,13 @@ static Tox *_Nullable tox_new_system(const struct Tox_Options *_Nullable options
 
     bool load_savedata_sk = false;
     bool load_savedata_tox = false;
+    tox_savedata_read_cb *savedata_reader = nullptr;
 
-    if (tox_options_get_savedata_type(opts) != TOX_SAVEDATA_TYPE_NONE) {
+    if (tox_options_get_savedata_type(opts) == TOX_SAVEDATA_TYPE_TOX_SAVE) {
+        savedata_reader = tox_options_get_experimental_savedata_reader(opts);
+    }
+
+    if (tox_options_get_savedata_type(opts) != TOX_SAVEDATA_TYPE_NONE && savedata_reader == nullptr) {
         if (tox_options_get_savedata_data(opts) == nullptr || tox_options_get_savedata_length(opts) == 0) {
             SET_ERROR_PARAMETER(error, TOX_ERR_NEW_LOAD_BAD_FORMAT);
             tox_options_free(default_options);
@@ -698,6 +847,9 @@ static Tox *_Nullable tox_new_system(const struct Tox_Options *_Nullable options
         }
 
         load_savedata_sk = true;
+    } else if (savedata_reader != nullptr) {
+        // The format is checked while reading.
+        load_savedata_tox = true;
     } else if (tox_options_get_savedata_type(opts) == TOX_SAVEDATA_TYPE_TOX_SAVE) {
         if (tox_options_get_savedata_length(opts) < TOX_ENC_SAVE_MAGIC_LENGTH) {
             SET_ERROR_PARAMETER(error, TOX_ERR_NEW_LOAD_BAD_FORMAT);
@@ -723,11 +875,18 @@ static Tox *_Nullable tox_new_system(const struct Tox_Options *_Nullable options
     m_options.local_discovery_enabled = tox_options_get_local_discovery_enabled(opts);
     m_options.dht_announcements_enabled = tox_options_get_dht_announcements_enabled(opts);
     m_options.groups_persistence_enabled = tox_options_get_experimental_groups_persistence(opts);
+    m_options.congestion_control = tox_options_get_experimental_congestion_control(opts) == TOX_CONGESTION_CONTROL_DELAY
+                                   ? CONGESTION_CONTROL_DELAY : CONGESTION_CONTROL_QUEUE;
+    m_options.pacing = tox_options_get_experimental_pacing(opts);
 
     if (m_options.udp_disabled) {
         m_options.local_discovery_enabled = false;
     }
 
+    if (host != nullptr) {
+        m_options.host = host->host;
+    }
+
     Tox *tox = (Tox *)mem_alloc(mem, sizeof(Tox));
 
     if (tox == nullptr) {
@@ -736,6 +895,8 @@ static Tox *_Nullable tox_new_system(const struct Tox_Options *_Nullable options
         return nullptr;
     }
 
+    tox->host = host;
+
     tox->log_callback = tox_options_get_log_callback(opts);
 
     Logger *log = logger_new(mem);
@@ -753,65 +914,18 @@ static Tox *_Nullable tox_new_system(const struct Tox_Options *_Nullable options
 
     logger_callback_log(tox->log, tox_log_handler, tox, tox_options_get_log_user_data(opts));
 
-    switch (tox_options_get_proxy_type(opts)) {
-        case TOX_PROXY_TYPE_HTTP: {
-            m_options.proxy_info.proxy_type = TCP_PROXY_HTTP;
-            break;
-        }
-
-        case TOX_PROXY_TYPE_SOCKS5: {
-            m_options.proxy_info.proxy_type = TCP_PROXY_SOCKS5;
-            break;
-        }
-
-        case TOX_PROXY_TYPE_NONE: {
-            m_options.proxy_info.proxy_type = TCP_PROXY_NONE;
-            break;
-        }
-
-        default: {
-            SET_ERROR_PARAMETER(error, TOX_ERR_NEW_PROXY_BAD_TYPE);
-            logger_kill(tox->log);
-            mem_delete(mem, tox);
-            tox_options_free(default_options);
-            return nullptr;
-        }
-    }
-
     tox->sys = *sys;
 
-    if (m_options.proxy_info.proxy_type != TCP_PROXY_NONE) {
-        if (tox_options_get_proxy_port(opts) == 0) {
-            SET_ERROR_PARAMETER(error, TOX_ERR_NEW_PROXY_BAD_PORT);
-            logger_kill(tox->log);
-            mem_delete(mem, tox);
-            tox_options_free(default_options);
-            return nullptr;
-        }
-
-        ip_init(&m_options.proxy_info.ip_port.ip, m_options.ipv6enabled);
-
-        if (m_options.ipv6enabled) {
-            m_options.proxy_info.ip_port.ip.family = net_family_unspec();
-        }
-
-        const char *const proxy_host = tox_options_get_proxy_host(opts);
-        const bool dns_enabled = !tox_options_get_experimental_disable_dns(opts);
-
-        if (proxy_host == nullptr
-                || !addr_resolve_or_parse_ip(ns, mem, proxy_host, &m_options.proxy_info.ip_port.ip, nullptr, dns_enabled)) {
-            SET_ERROR_PARAMETER(error, TOX_ERR_NEW_PROXY_BAD_HOST);
-            // TODO(irungentoo): TOX_ERR_NEW_PROXY_NOT_FOUND if domain.
-            logger_kill(tox->log);
-            mem_delete(mem, tox);
-            tox_options_free(default_options);
-            return nullptr;
-        }
-
-        m_options.proxy_info.ip_port.port = net_htons(tox_options_get_proxy_port(opts));
+    if (host == nullptr && !tox_parse_proxy_info(opts, ns, mem, m_options.ipv6enabled, &m_options.proxy_info, error)) {
+        logger_kill(tox->log);
+        mem_delete(mem, tox);
+        tox_options_free(default_options);
+        return nullptr;
     }
 
-    Mono_Time *temp_mono_time = mono_time_new(mem, sys->mono_time_callback, sys->mono_time_user_data);
+    Mono_Time *temp_mono_time = host != nullptr
+                                ? host->mono_time
+                                : mono_time_new(mem, sys->mono_time_callback, sys->mono_time_user_data);
 
     if (temp_mono_time == nullptr) {
         SET_ERROR_PARAMETER(error, TOX_ERR_NEW_MALLOC);
@@ -827,7 +941,7 @@ static Tox *_Nullable tox_new_system(const struct Tox_Options *_Nullable options
 
         if (mutex == nullptr) {
             SET_ERROR_PARAMETER(error, TOX_ERR_NEW_MALLOC);
-            mono_time_free(mem, tox->mono_time);
+            tox_free_mono_time(tox);
             logger_kill(tox->log);
             mem_delete(mem, tox);
             tox_options_free(default_options);
@@ -860,7 +974,7 @@ static Tox *_Nullable tox_new_system(const struct Tox_Options *_Nullable options
             }
         }
 
-        mono_time_free(mem, tox->mono_time);
+        tox_free_mono_time(tox);
         tox_unlock(tox);
 
         if (tox->mutex != nullptr) {
@@ -880,7 +994,7 @@ static Tox *_Nullable tox_new_system(const struct Tox_Options *_Nullable options
     if (tox->m->conferences_object == nullptr) {
         kill_messenger(tox->m);
 
-        mono_time_free(mem, tox->mono_time);
+        tox_free_mono_time(tox);
         tox_unlock(tox);
 
         if (tox->mutex != nullptr) {
@@ -896,12 +1010,19 @@ static Tox *_Nullable tox_new_system(const struct Tox_Options *_Nullable options
         return nullptr;
     }
 
-    if (load_savedata_tox
-            && tox_load(tox, tox_options_get_savedata_data(opts), tox_options_get_savedata_length(opts)) == -1) {
+    int load_result = 0;
+
+    if (load_savedata_tox) {
+        load_result = savedata_reader != nullptr
+                      ? tox_load_stream(tox, savedata_reader, tox_options_get_experimental_savedata_reader_user_data(opts))
+                      : tox_load(tox, tox_options_get_savedata_data(opts), tox_options_get_savedata_length(opts));
+    }
+
+    if (load_result != 0) {
         kill_groupchats(tox->m->conferences_object);
         kill_messenger(tox->m);
 
-        mono_time_free(mem, tox->mono_time);
+        tox_free_mono_time(tox);
         tox_unlock(tox);
 
         if (tox->mutex != nullptr) {
@@ -912,11 +1033,16 @@ static Tox *_Nullable tox_new_system(const struct Tox_Options *_Nullable options
         logger_kill(tox->log);
         mem_delete(mem, tox);
 
-        SET_ERROR_PARAMETER(error, TOX_ERR_NEW_LOAD_BAD_FORMAT);
+        SET_ERROR_PARAMETER(error, load_result == -2 ? TOX_ERR_NEW_LOAD_ENCRYPTED : TOX_ERR_NEW_LOAD_BAD_FORMAT);
         tox_options_free(default_options);
         return nullptr;
     }
 
+    if (load_savedata_tox) {
+        // Everything loaded is saved already.
+        m_clear_state_dirty(tox->m);
+    }
+
     if (load_savedata_sk) {
         load_secret_key(tox->m->net_crypto, tox_options_get_savedata_data(opts));
     }
@@ -932,9 +1058,15 @@ static Tox *_Nullable tox_new_system(const struct Tox_Options *_Nullable options
     m_callback_friendmessage(tox->m, tox_friend_message_handler);
     callback_file_control(tox->m, tox_file_recv_control_handler);
     callback_file_reqchunk(tox->m, tox_file_chunk_request_handler);
+    callback_file_read(tox->m, tox_file_read_handler);
     callback_file_sendrequest(tox->m, tox_file_recv_handler);
     callback_file_data(tox->m, tox_file_recv_chunk_handler);
-    dht_callback_nodes_response(tox->m->dht, tox_dht_nodes_response_handler);
+
+    if (host == nullptr) {
+        // The DHT of a host doesn't belong to any of its instances.
+        dht_callback_nodes_response(tox->m->dht, tox_dht_nodes_response_handler);
+    }
+
     g_callback_group_invite(tox->m->conferences_object, tox_conference_invite_handler);
     g_callback_group_connected(tox->m->conferences_object, tox_conference_connected_handler);
     g_callback_group_message(tox->m->conferences_object, tox_conference_message_handler);
@@ -963,6 +1095,11 @@ static Tox *_Nullable tox_new_system(const struct Tox_Options *_Nullable options
     gc_callback_rejected(tox->m, tox_group_join_fail_handler);
     gc_callback_voice_state(tox->m, tox_group_voice_state_handler);
 
+    if (host != nullptr) {
+        tox->host_userdata.tox = tox;
+        host_instance_set_userdata(tox->m->host_instance, &tox->host_userdata);
+    }
+
     tox_unlock(tox);
 
     SET_ERROR_PARAMETER(error, TOX_ERR_NEW_OK);
@@ -973,7 +1110,7 @@ static Tox *_Nullable tox_new_system(const struct Tox_Options *_Nullable options
 
 Tox *_Nullable tox_new(const struct Tox_Options *_Nullable options, Tox_Err_New *_Nullable error)
 {
-    return tox_new_system(options, error, nullptr);
+    return tox_new_system(options, error, nullptr, nullptr);
 }
 
 Tox *tox_new_testing(const Tox_Options *options, Tox_Err_New *error,
@@ -1000,7 +1137,25 @@ Tox *tox_new_testing(const Tox_Options *options, Tox_Err_New *error,
     }
 
     SET_ERROR_PARAMETER(testing_error, TOX_ERR_NEW_TESTING_OK);
-    return tox_new_system(options, error, sys);
+    return tox_new_system(options, error, sys, nullptr);
+}
+
+/** @brief Remove a hosted Tox from its host's list of instances. */
+static void tox_host_remove(Tox *_Nonnull tox)
+{
+    Tox_Host *host = tox->host;
+
+    if (host == nullptr) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < host->toxes_length; ++i) {
+        if (host->toxes[i] == tox) {
+            --host->toxes_length;
+            memmove(&host->toxes[i], &host->toxes[i + 1], (host->toxes_length - i) * sizeof(Tox *));
+            return;
+        }
+    }
 }
 
 void tox_kill(Tox *_Nullable tox)
@@ -1011,10 +1166,13 @@ void tox_kill(Tox *_Nullable tox)
 
     tox_lock(tox);
     LOGGER_ASSERT(tox->m->log, tox->toxav_object == nullptr, "Attempted to kill tox while toxav is still alive");
+    socket_watch_kill(tox->socket_watch);
+    ev_kill(tox->ev);
     kill_groupchats(tox->m->conferences_object);
     kill_messenger(tox->m);
     logger_kill(tox->log);
-    mono_time_free(tox->sys.mem, tox->mono_time);
+    tox_free_mono_time(tox);
+    tox_host_remove(tox);
     tox_unlock(tox);
 
     if (tox->mutex != nullptr) {
@@ -1074,6 +1232,63 @@ void tox_get_savedata(const Tox *_Nonnull tox, uint8_t *_Nullable savedata)
     tox_unlock(tox);
 }
 
+typedef struct Tox_Savedata_Sink {
+    tox_savedata_write_cb *_Nonnull write;
+    void *_Nullable user_data;
+} Tox_Savedata_Sink;
+
+static bool tox_savedata_sink_write(void *_Nullable user_data, const uint8_t *_Nonnull data, uint32_t length)
+{
+    const Tox_Savedata_Sink *sink = (const Tox_Savedata_Sink *)user_data;
+    assert(sink != nullptr);
+    return sink->write(data, length, sink->user_data);
+}
+
+/** @brief Write the conferences section, which can only be saved into a buffer. */
+static bool tox_write_conferences(const Tox *_Nonnull tox, State_Writer *_Nonnull writer)
+{
+    const Group_Chats *g_c = tox->m->conferences_object;
+    const uint32_t size = conferences_size(g_c);
+    uint8_t *buffer = (uint8_t *)mem_balloc(tox->sys.mem, size);
+
+    if (buffer == nullptr) {
+        return false;
+    }
+
+    const uint8_t *end = conferences_save(g_c, buffer);
+    const bool ok = state_writer_write(writer, buffer, (uint32_t)(end - buffer));
+    mem_delete(tox->sys.mem, buffer);
+    return ok;
+}
+
+bool tox_savedata_write(Tox *tox, bool changed_only, tox_savedata_write_cb *callback, void *user_data)
+{
+    assert(tox != nullptr);
+
+    Tox_Savedata_Sink sink = {callback, user_data};
+    State_Writer writer;
+    state_writer_init(&writer, tox_savedata_sink_write, &sink);
+
+    tox_lock(tox);
+
+    uint8_t cookie[sizeof(uint32_t) * 2] = {0};
+    host_to_lendian_bytes32(cookie + sizeof(uint32_t), STATE_COOKIE_GLOBAL);
+
+    const bool ok = state_writer_write(&writer, cookie, sizeof(cookie))
+                    && messenger_write(tox->m, &writer, changed_only)
+                    && tox_write_conferences(tox, &writer)
+                    && state_writer_section_header(&writer, STATE_COOKIE_TYPE, 0, STATE_TYPE_END)
+                    && state_writer_flush(&writer);
+
+    if (ok) {
+        m_clear_state_dirty(tox->m);
+    }
+
+    tox_unlock(tox);
+
+    return ok;
+}
+
 static int32_t resolve_bootstrap_node(Tox *_Nullable tox, const char *_Nullable host, uint16_t port,
                                       const Tox_Dht_Id _Nonnull public_key,
                                       IP_Port *_Nonnull *root, Tox_Err_Bootstrap *_Nullable error)
@@ -1220,30 +1435,108 @@ void tox_callback_self_connection_status(Tox *_Nonnull tox, tox_self_connection_
     tox->self_connection_status_callback = callback;
 }
 
+static uint32_t iteration_interval(const Tox *_Nonnull tox)
+{
+    if (m_is_receiving_file(tox->m)) {
+        return 1;
+    }
+
+    return messenger_run_interval(tox->m);
+}
+
 uint32_t tox_iteration_interval(const Tox *_Nonnull tox)
 {
     assert(tox != nullptr);
     tox_lock(tox);
-    uint32_t ret = messenger_run_interval(tox->m);
+    const uint32_t ret = iteration_interval(tox);
+    tox_unlock(tox);
+    return ret;
+}
 
-    if (m_is_receiving_file(tox->m)) {
-        ret = 1;
+/** @brief Lazily create the event loop used by waiting iterations. Must be called with the lock held. */
+static bool tox_socket_watch_init(Tox *_Nonnull tox)
+{
+    if (tox->socket_watch != nullptr) {
+        return true;
     }
 
+    tox->ev = os_event_new(tox->sys.mem, tox->m->log);
+
+    if (tox->ev == nullptr) {
+        return false;
+    }
+
+    tox->socket_watch = socket_watch_new(tox->sys.mem, tox->m->log, tox->ev);
+
+    if (tox->socket_watch == nullptr) {
+        ev_kill(tox->ev);
+        tox->ev = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+/** @brief Block until a socket is ready or the next iteration is due.
+ *
+ * Must be called without the lock held.
+ *
+ * @retval false if the UDP socket is known to have nothing to read.
+ */
+static bool tox_wait_for_events(Tox *_Nonnull tox)
+{
+    // Only the OS network stack has sockets we can wait on.
+    if (tox->sys.ns != &os_network_obj) {
+        return true;
+    }
+
+    tox_lock(tox);
+
+    if (!tox_socket_watch_init(tox)) {
+        tox_unlock(tox);
+        return true;
+    }
+
+    Socket_Watch *sw = tox->socket_watch;
+    socket_watch_begin(sw);
+    messenger_visit_sockets(tox->m, socket_watch_add, sw);
+    socket_watch_commit(sw);
+
+    const Socket udp_sock = net_sock(tox->m->net);
+    const int32_t timeout = (int32_t)min_u32(iteration_interval(tox), INT32_MAX);
+
     tox_unlock(tox);
-    return ret;
+
+    if (socket_watch_wait(sw, timeout) < 0) {
+        return true;
+    }
+
+    return socket_watch_is_ready(sw, udp_sock);
 }
 
 void tox_iterate_with_options(Tox *_Nonnull tox, const Tox_Iterate_Options *_Nullable options, void *_Nullable user_data)
 {
     assert(tox != nullptr);
+
+    const bool udp_readable = tox_iterate_options_get_wait_for_events(options)
+                              ? tox_wait_for_events(tox)
+                              : true;
+
     tox_lock(tox);
 
+    Iter_Profile *prof = tox->m->iter_prof;
+    const uint64_t iterate_start = iterprof_start(prof);
+
     mono_time_update(tox->mono_time);
 
     struct Tox_Userdata tox_data = { tox, user_data };
-    do_messenger(tox->m, &tox_data);
+    do_messenger_ex(tox->m, udp_readable, &tox_data);
+
+    const uint64_t groupchats_start = iterprof_start(prof);
     do_groupchats(tox->m->conferences_object, &tox_data);
+    iterprof_record(prof, ITER_STAGE_GROUPCHATS, groupchats_start);
+
+    iterprof_record(prof, ITER_STAGE_ITERATE, iterate_start);
 
     tox_unlock(tox);
 }
@@ -1253,6 +1546,166 @@ void tox_iterate(Tox *_Nonnull tox, void *_Nullable user_data)
     tox_iterate_with_options(tox, nullptr, user_data);
 }
 
+Tox_Host *tox_host_new(const Tox_Options *options, const Tox_System *sys, Tox_Err_New *error)
+{
+    struct Tox_Options *default_options = nullptr;
+    if (options == nullptr) {
+        default_options = tox_options_new(nullptr);
+
+        if (default_options == nullptr) {
+            SET_ERROR_PARAMETER(error, TOX_ERR_NEW_MALLOC);
+            return nullptr;
+        }
+    }
+
+    const struct Tox_Options *const opts = options != nullptr ? options : default_options;
+    assert(opts != nullptr);
+
+    const Tox_System default_system = tox_default_system();
+
+    if (sys == nullptr) {
+        sys = &default_system;
+    }
+
+    if (sys->rng == nullptr || sys->ns == nullptr || sys->mem == nullptr) {
+        SET_ERROR_PARAMETER(error, TOX_ERR_NEW_MALLOC);
+        tox_options_free(default_options);
+        return nullptr;
+    }
+
+    const Memory *const mem = sys->mem;
+
+    Messenger_Host_Options h_options = {nullptr};
+    h_options.ipv6enabled = tox_options_get_ipv6_enabled(opts);
+    h_options.udp_disabled = !tox_options_get_udp_enabled(opts);
+    h_options.port_range[0] = tox_options_get_start_port(opts);
+    h_options.port_range[1] = tox_options_get_end_port(opts);
+    h_options.hole_punching_enabled = tox_options_get_hole_punching_enabled(opts);
+    h_options.local_discovery_enabled = tox_options_get_local_discovery_enabled(opts) && !h_options.udp_disabled;
+    h_options.dht_announcements_enabled = tox_options_get_dht_announcements_enabled(opts);
+
+    if (!tox_parse_proxy_info(opts, sys->ns, mem, h_options.ipv6enabled, &h_options.proxy_info, error)) {
+        tox_options_free(default_options);
+        return nullptr;
+    }
+
+    tox_options_free(default_options);
+
+    Tox_Host *host = (Tox_Host *)mem_alloc(mem, sizeof(Tox_Host));
+
+    if (host == nullptr) {
+        SET_ERROR_PARAMETER(error, TOX_ERR_NEW_MALLOC);
+        return nullptr;
+    }
+
+    host->sys = *sys;
+    host->log = logger_new(mem);
+    host->mono_time = mono_time_new(mem, sys->mono_time_callback, sys->mono_time_user_data);
+
+    if (host->log == nullptr || host->mono_time == nullptr) {
+        SET_ERROR_PARAMETER(error, TOX_ERR_NEW_MALLOC);
+        tox_host_kill(host);
+        return nullptr;
+    }
+
+    h_options.log = host->log;
+
+    Messenger_Host_Error h_error;
+    host->host = new_messenger_host(mem, sys->rng, sys->ns, host->mono_time, &h_options, &h_error);
+
+    if (host->host == nullptr) {
+        SET_ERROR_PARAMETER(error, h_error == MESSENGER_HOST_ERROR_PORT ? TOX_ERR_NEW_PORT_ALLOC : TOX_ERR_NEW_MALLOC);
+        tox_host_kill(host);
+        return nullptr;
+    }
+
+    SET_ERROR_PARAMETER(error, TOX_ERR_NEW_OK);
+    return host;
+}
+
+void tox_host_kill(Tox_Host *host)
+{
+    if (host == nullptr) {
+        return;
+    }
+
+    LOGGER_ASSERT(host->log, host->toxes_length == 0, "Attempted to kill a host that still has instances");
+    kill_messenger_host(host->host);
+    mono_time_free(host->sys.mem, host->mono_time);
+    logger_kill(host->log);
+    mem_delete(host->sys.mem, host->toxes);
+    mem_delete(host->sys.mem, host);
+}
+
+Tox *tox_new_hosted(Tox_Host *host, const Tox_Options *options, Tox_Err_New *error)
+{
+    assert(host != nullptr);
+
+    Tox **toxes = (Tox **)mem_vrealloc(host->sys.mem, host->toxes, host->toxes_length + 1, sizeof(Tox *));
+
+    if (toxes == nullptr) {
+        SET_ERROR_PARAMETER(error, TOX_ERR_NEW_MALLOC);
+        return nullptr;
+    }
+
+    host->toxes = toxes;
+
+    Tox *tox = tox_new_system(options, error, &host->sys, host);
+
+    if (tox == nullptr) {
+        return nullptr;
+    }
+
+    host->toxes[host->toxes_length] = tox;
+    ++host->toxes_length;
+    return tox;
+}
+
+void tox_host_iterate(Tox_Host *host, void *user_data)
+{
+    assert(host != nullptr);
+
+    mono_time_update(host->mono_time);
+
+    for (uint32_t i = 0; i < host->toxes_length; ++i) {
+        Tox *tox = host->toxes[i];
+        tox_lock(tox);
+        tox->host_userdata.user_data = user_data;
+    }
+
+    do_messenger_host(host->host);
+
+    for (uint32_t i = 0; i < host->toxes_length; ++i) {
+        tox_unlock(host->toxes[i]);
+    }
+
+    for (uint32_t i = 0; i < host->toxes_length; ++i) {
+        tox_iterate(host->toxes[i], user_data);
+    }
+}
+
+uint32_t tox_host_iteration_interval(const Tox_Host *host)
+{
+    assert(host != nullptr);
+
+    uint32_t ret = messenger_host_run_interval(host->host);
+
+    for (uint32_t i = 0; i < host->toxes_length; ++i) {
+        const Tox *tox = host->toxes[i];
+        tox_lock(tox);
+        ret = min_u32(ret, iteration_interval(tox));
+        tox_unlock(tox);
+    }
+
+    return ret;
+}
+
+uint32_t tox_host_get_instance_count(const Tox_Host *host)
+{
+    assert(host != nullptr);
+    return host->toxes_length;
+}
+
 void tox_self_get_address(const Tox *_Nonnull tox, Tox_Address _Nullable address)
 {
     assert(tox != nullptr);
@@ -1269,6 +1722,7 @@ void tox_self_set_nospam(Tox *_Nonnull tox, uint32_t nospam)
     assert(tox != nullptr);
     tox_lock(tox);
     set_nospam(tox->m->fr, net_htonl(nospam));
+    m_mark_state_dirty(tox->m, STATE_TYPE_NOSPAMKEYS);
     tox_unlock(tox);
 }
 
@@ -4751,6 +5205,7 @@ const Tox_System *tox_get_system(const Tox *tox)
 
 struct Tox_Iterate_Options {
     bool fail_hard;
+    bool wait_for_events;
 };
 
 Tox_Iterate_Options *tox_iterate_options_new(Tox_Err_Iterate_Options_New *error)
@@ -4760,6 +5215,7 @@ Tox_Iterate_Options *tox_iterate_options_new(Tox_Err_Iterate_Options_New *error)
 
     if (options != nullptr) {
         options->fail_hard = false;
+        options->wait_for_events = false;
 
         SET_ERROR_PARAMETER(error, TOX_ERR_ITERATE_OPTIONS_NEW_OK);
 
@@ -4787,3 +5243,15 @@ bool tox_iterate_options_get_fail_hard(const Tox_Iterate_Options *options)
 {
     return options == nullptr ? false : options->fail_hard;
 }
+
+void tox_iterate_options_set_wait_for_events(Tox_Iterate_Options *options, bool wait_for_events)
+{
+    if (options != nullptr) {
+        options->wait_for_events = wait_for_events;
+    }
+}
+
+bool tox_iterate_options_get_wait_for_events(const Tox_Iterate_Options *options)
+{
+    return options == nullptr ? false : options->wait_for_events;
+}
@@ -131,6 +131,10 @@ uint32_t tox_dht_node_public_key_size(void)
 {
     return TOX_DHT_NODE_PUBLIC_KEY_SIZE;
 }
+uint32_t tox_iteration_histogram_size(void)
+{
+    return TOX_ITERATION_HISTOGRAM_SIZE;
+}
 
 const char *_Nonnull tox_user_status_to_string(Tox_User_Status value)
 {
@@ -189,6 +193,18 @@ const char *_Nonnull tox_savedata_type_to_string(Tox_Savedata_Type value)
 
     return "<invalid Tox_Savedata_Type>";
 }
+const char *_Nonnull tox_congestion_control_to_string(Tox_Congestion_Control value)
+{
+    switch (value) {
+        case TOX_CONGESTION_CONTROL_QUEUE:
+            return "TOX_CONGESTION_CONTROL_QUEUE";
+
+        case TOX_CONGESTION_CONTROL_DELAY:
+            return "TOX_CONGESTION_CONTROL_DELAY";
+    }
+
+    return "<invalid Tox_Congestion_Control>";
+}
 const char *_Nonnull tox_err_options_new_to_string(Tox_Err_Options_New value)
 {
     switch (value) {
@@ -1653,3 +1669,77 @@ const char *tox_netprof_direction_to_string(Tox_Netprof_Direction value)
 
     return "<invalid Tox_Netprof_Direction>";
 }
+const char *tox_key_cache_type_to_string(Tox_Key_Cache_Type value)
+{
+    switch (value) {
+        case TOX_KEY_CACHE_TYPE_DHT_RECV:
+            return "TOX_KEY_CACHE_TYPE_DHT_RECV";
+        case TOX_KEY_CACHE_TYPE_DHT_SENT:
+            return "TOX_KEY_CACHE_TYPE_DHT_SENT";
+        case TOX_KEY_CACHE_TYPE_ONION:
+            return "TOX_KEY_CACHE_TYPE_ONION";
+        case TOX_KEY_CACHE_TYPE_ONION_ANNOUNCE:
+            return "TOX_KEY_CACHE_TYPE_ONION_ANNOUNCE";
+        case TOX_KEY_CACHE_TYPE_ANNOUNCE:
+            return "TOX_KEY_CACHE_TYPE_ANNOUNCE";
+    }
+
+    return "<invalid Tox_Key_Cache_Type>";
+}
+const char *tox_key_cache_counter_to_string(Tox_Key_Cache_Counter value)
+{
+    switch (value) {
+        case TOX_KEY_CACHE_COUNTER_HITS:
+            return "TOX_KEY_CACHE_COUNTER_HITS";
+        case TOX_KEY_CACHE_COUNTER_MISSES:
+            return "TOX_KEY_CACHE_COUNTER_MISSES";
+        case TOX_KEY_CACHE_COUNTER_EVICTIONS:
+            return "TOX_KEY_CACHE_COUNTER_EVICTIONS";
+    }
+
+    return "<invalid Tox_Key_Cache_Counter>";
+}
+const char *tox_iteration_stage_to_string(Tox_Iteration_Stage value)
+{
+    switch (value) {
+        case TOX_ITERATION_STAGE_ITERATE:
+            return "TOX_ITERATION_STAGE_ITERATE";
+        case TOX_ITERATION_STAGE_NETWORKING_POLL:
+            return "TOX_ITERATION_STAGE_NETWORKING_POLL";
+        case TOX_ITERATION_STAGE_DHT:
+            return "TOX_ITERATION_STAGE_DHT";
+        case TOX_ITERATION_STAGE_TCP_SERVER:
+            return "TOX_ITERATION_STAGE_TCP_SERVER";
+        case TOX_ITERATION_STAGE_NET_CRYPTO:
+            return "TOX_ITERATION_STAGE_NET_CRYPTO";
+        case TOX_ITERATION_STAGE_ONION_CLIENT:
+            return "TOX_ITERATION_STAGE_ONION_CLIENT";
+        case TOX_ITERATION_STAGE_FRIEND_CONNECTIONS:
+            return "TOX_ITERATION_STAGE_FRIEND_CONNECTIONS";
+        case TOX_ITERATION_STAGE_FRIENDS:
+            return "TOX_ITERATION_STAGE_FRIENDS";
+        case TOX_ITERATION_STAGE_GC:
+            return "TOX_ITERATION_STAGE_GC";
+        case TOX_ITERATION_STAGE_GCA:
+            return "TOX_ITERATION_STAGE_GCA";
+        case TOX_ITERATION_STAGE_GC_ONION_FRIENDS:
+            return "TOX_ITERATION_STAGE_GC_ONION_FRIENDS";
+        case TOX_ITERATION_STAGE_GROUPCHATS:
+            return "TOX_ITERATION_STAGE_GROUPCHATS";
+    }
+
+    return "<invalid Tox_Iteration_Stage>";
+}
+const char *tox_iteration_counter_to_string(Tox_Iteration_Counter value)
+{
+    switch (value) {
+        case TOX_ITERATION_COUNTER_CALLS:
+            return "TOX_ITERATION_COUNTER_CALLS";
+        case TOX_ITERATION_COUNTER_TOTAL_NS:
+            return "TOX_ITERATION_COUNTER_TOTAL_NS";
+        case TOX_ITERATION_COUNTER_MAX_NS:
+            return "TOX_ITERATION_COUNTER_MAX_NS";
+    }
+
+    return "<invalid Tox_Iteration_Counter>";
+}
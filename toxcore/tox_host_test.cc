@@ -0,0 +1,267 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "../testing/support/public/simulation.hh"
+#include "network.h"
+#include "tox.h"
+#include "tox_private.h"
+
+namespace {
+
+using tox::test::FakeClock;
+using tox::test::Simulation;
+using tox::test::SimulatedNode;
+
+struct Tox_Host_Deleter {
+    void operator()(Tox_Host *host) { tox_host_kill(host); }
+};
+
+using Tox_Host_Ptr = std::unique_ptr<Tox_Host, Tox_Host_Deleter>;
+
+struct Tox_Deleter {
+    void operator()(Tox *tox) { tox_kill(tox); }
+};
+
+using Tox_Ptr = std::unique_ptr<Tox, Tox_Deleter>;
+
+struct Received {
+    std::vector<std::pair<Tox *, uint32_t>> messages;
+};
+
+class ToxHostTest : public ::testing::Test {
+protected:
+    ToxHostTest()
+        : host_node_(sim_.create_node())
+    {
+        system_.ns = &host_node_->c_network;
+        system_.rng = &host_node_->c_random;
+        system_.mem = &host_node_->c_memory;
+        system_.mono_time_callback = [](void *user_data) -> uint64_t {
+            return static_cast<FakeClock *>(user_data)->current_time_ms();
+        };
+        system_.mono_time_user_data = &sim_.clock();
+    }
+
+    Tox_Host_Ptr new_host()
+    {
+        std::unique_ptr<Tox_Options, decltype(&tox_options_free)> opts(
+            tox_options_new(nullptr), tox_options_free);
+        tox_options_set_ipv6_enabled(opts.get(), false);
+        tox_options_set_local_discovery_enabled(opts.get(), false);
+
+        Tox_Err_New err;
+        Tox_Host_Ptr host(tox_host_new(opts.get(), &system_, &err));
+        EXPECT_EQ(err, TOX_ERR_NEW_OK);
+        return host;
+    }
+
+    static Tox_Ptr new_hosted(Tox_Host *host)
+    {
+        Tox_Err_New err;
+        Tox_Ptr tox(tox_new_hosted(host, nullptr, &err));
+        EXPECT_EQ(err, TOX_ERR_NEW_OK);
+        return tox;
+    }
+
+    SimulatedNode::ToxPtr new_peer()
+    {
+        peer_nodes_.push_back(sim_.create_node());
+
+        std::unique_ptr<Tox_Options, decltype(&tox_options_free)> opts(
+            tox_options_new(nullptr), tox_options_free);
+        tox_options_set_ipv6_enabled(opts.get(), false);
+        tox_options_set_local_discovery_enabled(opts.get(), false);
+        return peer_nodes_.back()->create_tox(opts.get());
+    }
+
+    /** @brief Make a hosted instance and a peer friends and bootstrap the peer off the host. */
+    void befriend(Tox *hosted, Tox *peer)
+    {
+        std::array<uint8_t, TOX_PUBLIC_KEY_SIZE> hosted_pk;
+        tox_self_get_public_key(hosted, hosted_pk.data());
+        std::array<uint8_t, TOX_PUBLIC_KEY_SIZE> peer_pk;
+        tox_self_get_public_key(peer, peer_pk.data());
+        std::array<uint8_t, TOX_PUBLIC_KEY_SIZE> dht_id;
+        tox_self_get_dht_id(hosted, dht_id.data());
+
+        ASSERT_EQ(tox_friend_add_norequest(hosted, peer_pk.data(), nullptr), 0);
+        ASSERT_EQ(tox_friend_add_norequest(peer, hosted_pk.data(), nullptr), 0);
+
+        char ip[TOX_INET6_ADDRSTRLEN];
+        ip_parse_addr(&host_node_->ip, ip, sizeof(ip));
+        const uint16_t port = host_node_->get_primary_socket()->local_port();
+        ASSERT_TRUE(tox_bootstrap(peer, ip, port, dht_id.data(), nullptr));
+    }
+
+    void run_until(Tox_Host *host, const std::vector<Tox *> &peers, Received *received,
+        std::function<bool()> condition)
+    {
+        sim_.run_until(
+            [&]() {
+                tox_host_iterate(host, received);
+
+                for (Tox *peer : peers) {
+                    tox_iterate(peer, received);
+                }
+
+                sim_.advance_time(40);
+                return condition();
+            },
+            60000);
+    }
+
+    Simulation sim_{12345};
+    std::unique_ptr<SimulatedNode> host_node_;
+    std::vector<std::unique_ptr<SimulatedNode>> peer_nodes_;
+    Tox_System system_;
+};
+
+void record_message(Tox *tox, uint32_t friend_number, Tox_Message_Type, const uint8_t *,
+    std::size_t, void *user_data)
+{
+    static_cast<Received *>(user_data)->messages.emplace_back(tox, friend_number);
+}
+
+TEST_F(ToxHostTest, HostedInstancesTalkToTheirFriends)
+{
+    Tox_Host_Ptr host = new_host();
+    ASSERT_NE(host, nullptr);
+
+    Tox_Ptr alice = new_hosted(host.get());
+    Tox_Ptr bob = new_hosted(host.get());
+    ASSERT_NE(alice, nullptr);
+    ASSERT_NE(bob, nullptr);
+    EXPECT_EQ(tox_host_get_instance_count(host.get()), 2);
+
+    // Both instances use the host's socket and DHT.
+    EXPECT_EQ(tox_self_get_udp_port(alice.get(), nullptr), tox_self_get_udp_port(bob.get(), nullptr));
+
+    auto carol = new_peer();
+    auto dave = new_peer();
+    ASSERT_NE(carol, nullptr);
+    ASSERT_NE(dave, nullptr);
+
+    befriend(alice.get(), carol.get());
+    befriend(bob.get(), dave.get());
+
+    for (Tox *tox : {alice.get(), bob.get(), carol.get(), dave.get()}) {
+        tox_callback_friend_message(tox, record_message);
+    }
+
+    Received received;
+    const std::vector<Tox *> peers = {carol.get(), dave.get()};
+    run_until(host.get(), peers, &received, [&]() {
+        for (Tox *tox : {alice.get(), bob.get(), carol.get(), dave.get()}) {
+            if (tox_friend_get_connection_status(tox, 0, nullptr) == TOX_CONNECTION_NONE) {
+                return false;
+            }
+        }
+        return true;
+    });
+
+    for (Tox *tox : {alice.get(), bob.get(), carol.get(), dave.get()}) {
+        ASSERT_NE(tox_friend_get_connection_status(tox, 0, nullptr), TOX_CONNECTION_NONE);
+    }
+
+    const uint8_t message[] = "hello";
+
+    for (Tox *tox : {alice.get(), bob.get(), carol.get(), dave.get()}) {
+        tox_friend_send_message(tox, 0, TOX_MESSAGE_TYPE_NORMAL, message, sizeof(message), nullptr);
+    }
+
+    run_until(host.get(), peers, &received, [&]() { return received.messages.size() >= 4; });
+
+    ASSERT_EQ(received.messages.size(), 4);
+
+    // Every instance got exactly one message, with the userdata passed to iterate.
+    for (Tox *tox : {alice.get(), bob.get(), carol.get(), dave.get()}) {
+        int count = 0;
+
+        for (const auto &[receiver, friend_number] : received.messages) {
+            if (receiver == tox) {
+                EXPECT_EQ(friend_number, 0);
+                ++count;
+            }
+        }
+
+        EXPECT_EQ(count, 1);
+    }
+}
+
+TEST_F(ToxHostTest, KillingAnInstanceKeepsTheOthersRunning)
+{
+    Tox_Host_Ptr host = new_host();
+    ASSERT_NE(host, nullptr);
+
+    Tox_Ptr alice = new_hosted(host.get());
+    Tox_Ptr bob = new_hosted(host.get());
+    ASSERT_NE(alice, nullptr);
+    ASSERT_NE(bob, nullptr);
+
+    auto carol = new_peer();
+    ASSERT_NE(carol, nullptr);
+    befriend(bob.get(), carol.get());
+    tox_callback_friend_message(bob.get(), record_message);
+
+    alice.reset();
+    EXPECT_EQ(tox_host_get_instance_count(host.get()), 1);
+
+    Received received;
+    const std::vector<Tox *> peers = {carol.get()};
+    run_until(host.get(), peers, &received, [&]() {
+        return tox_friend_get_connection_status(carol.get(), 0, nullptr) != TOX_CONNECTION_NONE;
+    });
+    ASSERT_NE(tox_friend_get_connection_status(carol.get(), 0, nullptr), TOX_CONNECTION_NONE);
+
+    const uint8_t message[] = "hello";
+    tox_friend_send_message(carol.get(), 0, TOX_MESSAGE_TYPE_NORMAL, message, sizeof(message), nullptr);
+
+    run_until(host.get(), peers, &received, [&]() { return !received.messages.empty(); });
+
+    ASSERT_EQ(received.messages.size(), 1);
+    EXPECT_EQ(received.messages[0].first, bob.get());
+}
+
+TEST_F(ToxHostTest, InstancesDontGetBatchDecryption)
+{
+    Tox_Host_Ptr host = new_host();
+    ASSERT_NE(host, nullptr);
+    Tox_Ptr alice = new_hosted(host.get());
+    ASSERT_NE(alice, nullptr);
+
+    EXPECT_FALSE(tox_set_batch_decrypt(alice.get(), true, 0));
+}
+
+TEST_F(ToxHostTest, FreesEverything)
+{
+    const std::size_t before = host_node_->fake_memory().current_allocation();
+
+    {
+        Tox_Host_Ptr host = new_host();
+        ASSERT_NE(host, nullptr);
+        Tox_Ptr alice = new_hosted(host.get());
+        Tox_Ptr bob = new_hosted(host.get());
+        ASSERT_NE(alice, nullptr);
+        ASSERT_NE(bob, nullptr);
+
+        for (int i = 0; i < 10; ++i) {
+            tox_host_iterate(host.get(), nullptr);
+            sim_.advance_time(tox_host_iteration_interval(host.get()));
+        }
+    }
+
+    EXPECT_EQ(host_node_->fake_memory().current_allocation(), before);
+}
+
+}  // namespace
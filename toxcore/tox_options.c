@@ -189,6 +189,41 @@ void tox_options_set_experimental_disable_dns(Tox_Options *_Nonnull options, boo
 {
     options->experimental_disable_dns = experimental_disable_dns;
 }
+Tox_Congestion_Control tox_options_get_experimental_congestion_control(const Tox_Options *_Nonnull options)
+{
+    return options->experimental_congestion_control;
+}
+void tox_options_set_experimental_congestion_control(
+    Tox_Options *_Nonnull options, Tox_Congestion_Control experimental_congestion_control)
+{
+    options->experimental_congestion_control = experimental_congestion_control;
+}
+bool tox_options_get_experimental_pacing(const Tox_Options *_Nonnull options)
+{
+    return options->experimental_pacing;
+}
+void tox_options_set_experimental_pacing(Tox_Options *_Nonnull options, bool experimental_pacing)
+{
+    options->experimental_pacing = experimental_pacing;
+}
+tox_savedata_read_cb *_Nullable tox_options_get_experimental_savedata_reader(const Tox_Options *_Nonnull options)
+{
+    return options->experimental_savedata_reader;
+}
+void tox_options_set_experimental_savedata_reader(
+    Tox_Options *_Nonnull options, tox_savedata_read_cb *_Nullable experimental_savedata_reader)
+{
+    options->experimental_savedata_reader = experimental_savedata_reader;
+}
+void *_Nullable tox_options_get_experimental_savedata_reader_user_data(const Tox_Options *_Nonnull options)
+{
+    return options->experimental_savedata_reader_user_data;
+}
+void tox_options_set_experimental_savedata_reader_user_data(
+    Tox_Options *_Nonnull options, void *_Nullable experimental_savedata_reader_user_data)
+{
+    options->experimental_savedata_reader_user_data = experimental_savedata_reader_user_data;
+}
 bool tox_options_get_experimental_owned_data(const Tox_Options *_Nonnull options)
 {
     return options->experimental_owned_data;
@@ -257,6 +292,8 @@ void tox_options_default(Tox_Options *_Nonnull options)
         tox_options_set_experimental_groups_persistence(options, false);
         tox_options_set_experimental_disable_dns(options, false);
         tox_options_set_experimental_owned_data(options, false);
+        tox_options_set_experimental_congestion_control(options, TOX_CONGESTION_CONTROL_QUEUE);
+        tox_options_set_experimental_pacing(options, false);
     }
 }
 
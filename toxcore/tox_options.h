@@ -66,6 +66,24 @@ typedef enum Tox_Savedata_Type {
 
 const char *tox_savedata_type_to_string(Tox_Savedata_Type value);
 
+/**
+ * @brief Algorithm that picks how fast data is sent to each friend.
+ */
+typedef enum Tox_Congestion_Control {
+    /**
+     * Slow down when the send queue grows faster than packets leave it.
+     */
+    TOX_CONGESTION_CONTROL_QUEUE,
+
+    /**
+     * Keep the extra round trip delay caused by queues along the path small,
+     * and don't slow down for occasional packet loss.
+     */
+    TOX_CONGESTION_CONTROL_DELAY,
+} Tox_Congestion_Control;
+
+const char *tox_congestion_control_to_string(Tox_Congestion_Control value);
+
 /**
  * @brief This event is triggered when Tox logs an internal message.
  *
@@ -91,6 +109,18 @@ typedef void tox_log_cb(struct Tox *tox, Tox_Log_Level level, const char *file,
                         uint32_t line, const char *func, const char *message,
                         void *user_data);
 
+/**
+ * @brief Reads the next part of a Tox save.
+ *
+ * @param data Where to put the bytes.
+ * @param length How many bytes to read.
+ * @param user_data The user data pointer set in the options.
+ *
+ * @return the number of bytes read. Less than length only at the end of the
+ *   save or on a read error.
+ */
+typedef size_t tox_savedata_read_cb(uint8_t *data, size_t length, void *user_data);
+
 /**
  * @brief This struct contains all the startup options for Tox.
  *
@@ -300,6 +330,44 @@ struct Tox_Options {
      */
     bool experimental_owned_data;
 
+    /**
+     * @brief Congestion control algorithm for friend connections.
+     *
+     * Default: TOX_CONGESTION_CONTROL_QUEUE.
+     */
+    Tox_Congestion_Control experimental_congestion_control;
+
+    /**
+     * @brief Spread data sent to friends evenly over time.
+     *
+     * Without pacing, each tox_iterate sends everything that became allowed
+     * since the previous one, so data leaves in bursts. With pacing, only a
+     * few ms worth is sent at once, and tox_iteration_interval returns the
+     * time until more may be sent. Clients need to honour that interval for
+     * pacing to keep up full speed. Since the send rate can only grow with
+     * what was actually sent, paced transfers take longer to ramp up.
+     *
+     * Default: false.
+     */
+    bool experimental_pacing;
+
+    /**
+     * @brief Read the Tox save through this callback instead of from
+     *   savedata_data.
+     *
+     * Only used if savedata_type is TOX_SAVEDATA_TYPE_TOX_SAVE. The save is
+     * read one section at a time during tox_new, so it never has to be in
+     * memory as a whole.
+     *
+     * Default: NULL.
+     */
+    tox_savedata_read_cb *experimental_savedata_reader;
+
+    /**
+     * @brief User data pointer passed to experimental_savedata_reader.
+     */
+    void *experimental_savedata_reader_user_data;
+
     /**
      * @brief Owned pointer to the savedata data.
      * @private
@@ -398,6 +466,25 @@ bool tox_options_get_experimental_disable_dns(const Tox_Options *options);
 
 void tox_options_set_experimental_disable_dns(Tox_Options *options, bool experimental_disable_dns);
 
+Tox_Congestion_Control tox_options_get_experimental_congestion_control(const Tox_Options *options);
+
+void tox_options_set_experimental_congestion_control(
+    Tox_Options *options, Tox_Congestion_Control experimental_congestion_control);
+
+bool tox_options_get_experimental_pacing(const Tox_Options *options);
+
+void tox_options_set_experimental_pacing(Tox_Options *options, bool experimental_pacing);
+
+tox_savedata_read_cb *tox_options_get_experimental_savedata_reader(const Tox_Options *options);
+
+void tox_options_set_experimental_savedata_reader(
+    Tox_Options *options, tox_savedata_read_cb *experimental_savedata_reader);
+
+void *tox_options_get_experimental_savedata_reader_user_data(const Tox_Options *options);
+
+void tox_options_set_experimental_savedata_reader_user_data(
+    Tox_Options *options, void *experimental_savedata_reader_user_data);
+
 /**
  * @brief Initialises a Tox_Options object with the default options.
  *
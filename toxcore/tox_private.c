@@ -13,19 +13,25 @@
 #include "DHT.h"
 #include "Messenger.h"
 #include "TCP_server.h"
+#include "announce.h"
 #include "ccompat.h"
 #include "crypto_core.h"
 #include "group_chats.h"
 #include "group_common.h"
+#include "group_relay.h"
+#include "iter_profile.h"
 #include "logger.h"
 #include "mem.h"
 #include "net.h"
 #include "net_crypto.h"
 #include "net_profile.h"
 #include "network.h"
+#include "onion.h"
+#include "onion_announce.h"
 #include "os_memory.h"
 #include "os_network.h"
 #include "os_random.h"
+#include "shared_key_cache.h"
 #include "tox.h"
 #include "tox_struct.h"  // IWYU pragma: keep
 
@@ -36,6 +42,11 @@
         }                             \
     } while (0)
 
+static_assert(TOX_ITERATION_HISTOGRAM_SIZE == ITER_PROFILE_HISTOGRAM_SIZE,
+              "TOX_ITERATION_HISTOGRAM_SIZE is assumed to be equal to ITER_PROFILE_HISTOGRAM_SIZE");
+static_assert(TOX_GROUP_MAX_RELAY_FANOUT == GC_RELAY_MAX_FANOUT,
+              "TOX_GROUP_MAX_RELAY_FANOUT is assumed to be equal to GC_RELAY_MAX_FANOUT");
+
 Tox_System tox_default_system(void)
 {
     const Tox_System sys = {
@@ -98,12 +109,75 @@ void *tox_get_av_object(const Tox *tox)
     return object;
 }
 
+bool tox_set_batch_decrypt(Tox *tox, bool enabled, uint16_t num_workers)
+{
+    assert(tox != nullptr);
+
+    if (tox->host != nullptr) {
+        // The host reads the socket, so there is no end of a poll to decrypt at.
+        return false;
+    }
+
+    tox_lock(tox);
+    const bool ok = net_crypto_set_batch_decrypt(tox->m->net_crypto, enabled, num_workers);
+    tox_unlock(tox);
+    return ok;
+}
+
 void tox_callback_dht_nodes_response(Tox *tox, tox_dht_nodes_response_cb *callback)
 {
     assert(tox != nullptr);
     tox->dht_nodes_response_callback = callback;
 }
 
+void tox_callback_file_read(Tox *tox, tox_file_read_cb *callback)
+{
+    assert(tox != nullptr);
+    tox->file_read_callback = callback;
+}
+
+bool tox_file_stream(Tox *tox, uint32_t friend_number, uint32_t file_number, uint16_t window,
+                     Tox_Err_File_Stream *error)
+{
+    assert(tox != nullptr);
+
+    if (window != 0 && tox->file_read_callback == nullptr) {
+        SET_ERROR_PARAMETER(error, TOX_ERR_FILE_STREAM_NO_CALLBACK);
+        return false;
+    }
+
+    tox_lock(tox);
+    const int ret = file_set_stream(tox->m, friend_number, file_number, window);
+    tox_unlock(tox);
+
+    switch (ret) {
+        case 0: {
+            SET_ERROR_PARAMETER(error, TOX_ERR_FILE_STREAM_OK);
+            return true;
+        }
+
+        case -1: {
+            SET_ERROR_PARAMETER(error, TOX_ERR_FILE_STREAM_FRIEND_NOT_FOUND);
+            return false;
+        }
+
+        case -2: {
+            SET_ERROR_PARAMETER(error, TOX_ERR_FILE_STREAM_NOT_FOUND);
+            return false;
+        }
+
+        case -3: {
+            SET_ERROR_PARAMETER(error, TOX_ERR_FILE_STREAM_NO_CALLBACK);
+            return false;
+        }
+    }
+
+    /* can't happen */
+    LOGGER_FATAL(tox->m->log, "impossible return value: %d", ret);
+
+    return false;
+}
+
 bool tox_dht_send_nodes_request(const Tox *tox, const uint8_t *public_key, const char *ip, uint16_t port,
                                 const uint8_t *target_public_key, Tox_Err_Dht_Send_Nodes_Request *error)
 {
@@ -234,6 +308,31 @@ bool tox_group_peer_get_ip_address(const Tox *tox, uint32_t group_number, uint32
     return true;
 }
 
+uint32_t tox_group_max_relay_fanout(void)
+{
+    return TOX_GROUP_MAX_RELAY_FANOUT;
+}
+
+bool tox_group_set_relay_fanout(Tox *tox, uint32_t group_number, uint8_t fanout, Tox_Err_Group_State_Query *error)
+{
+    assert(tox != nullptr);
+
+    tox_lock(tox);
+    GC_Chat *chat = gc_get_group(tox->m->group_handler, group_number);
+
+    if (chat == nullptr) {
+        SET_ERROR_PARAMETER(error, TOX_ERR_GROUP_STATE_QUERY_GROUP_NOT_FOUND);
+        tox_unlock(tox);
+        return false;
+    }
+
+    gc_set_relay_fanout(chat, fanout);
+    tox_unlock(tox);
+
+    SET_ERROR_PARAMETER(error, TOX_ERR_GROUP_STATE_QUERY_OK);
+    return true;
+}
+
 uint64_t tox_netprof_get_packet_id_count(const Tox *tox, Tox_Netprof_Packet_Type type, uint8_t id,
         Tox_Netprof_Direction direction)
 {
@@ -429,3 +528,215 @@ uint64_t tox_netprof_get_packet_total_bytes(const Tox *tox, Tox_Netprof_Packet_T
 
     return bytes;
 }
+
+static uint64_t key_cache_counter(const Shared_Key_Cache *_Nullable cache, Tox_Key_Cache_Counter counter)
+{
+    if (cache == nullptr) {
+        return 0;
+    }
+
+    Shared_Key_Cache_Stats stats;
+    shared_key_cache_get_stats(cache, &stats);
+
+    switch (counter) {
+        case TOX_KEY_CACHE_COUNTER_HITS:
+            return stats.hits;
+
+        case TOX_KEY_CACHE_COUNTER_MISSES:
+            return stats.misses;
+
+        case TOX_KEY_CACHE_COUNTER_EVICTIONS:
+            return stats.evictions;
+    }
+
+    return 0;
+}
+
+uint64_t tox_key_cache_get_counter(const Tox *tox, Tox_Key_Cache_Type type, Tox_Key_Cache_Counter counter)
+{
+    assert(tox != nullptr);
+
+    tox_lock(tox);
+
+    uint64_t value = 0;
+
+    switch (type) {
+        case TOX_KEY_CACHE_TYPE_DHT_RECV: {
+            value = key_cache_counter(dht_get_shared_keys_recv(tox->m->dht), counter);
+            break;
+        }
+
+        case TOX_KEY_CACHE_TYPE_DHT_SENT: {
+            value = key_cache_counter(dht_get_shared_keys_sent(tox->m->dht), counter);
+            break;
+        }
+
+        case TOX_KEY_CACHE_TYPE_ONION: {
+            const Onion *onion = tox->m->onion;
+            value = key_cache_counter(onion->shared_keys_1, counter)
+                    + key_cache_counter(onion->shared_keys_2, counter)
+                    + key_cache_counter(onion->shared_keys_3, counter);
+            break;
+        }
+
+        case TOX_KEY_CACHE_TYPE_ONION_ANNOUNCE: {
+            value = key_cache_counter(onion_announce_get_shared_keys(tox->m->onion_a), counter);
+            break;
+        }
+
+        case TOX_KEY_CACHE_TYPE_ANNOUNCE: {
+            if (tox->m->announce != nullptr) {
+                value = key_cache_counter(announce_get_shared_keys(tox->m->announce), counter);
+            }
+            break;
+        }
+
+        default: {
+            LOGGER_ERROR(tox->m->log, "invalid key cache type: %u", type);
+            break;
+        }
+    }
+
+    tox_unlock(tox);
+
+    return value;
+}
+
+static bool iteration_stage_from_api(Tox_Iteration_Stage stage, Iter_Profile_Stage *_Nonnull out)
+{
+    switch (stage) {
+        case TOX_ITERATION_STAGE_ITERATE:
+            *out = ITER_STAGE_ITERATE;
+            return true;
+
+        case TOX_ITERATION_STAGE_NETWORKING_POLL:
+            *out = ITER_STAGE_NETWORKING_POLL;
+            return true;
+
+        case TOX_ITERATION_STAGE_DHT:
+            *out = ITER_STAGE_DHT;
+            return true;
+
+        case TOX_ITERATION_STAGE_TCP_SERVER:
+            *out = ITER_STAGE_TCP_SERVER;
+            return true;
+
+        case TOX_ITERATION_STAGE_NET_CRYPTO:
+            *out = ITER_STAGE_NET_CRYPTO;
+            return true;
+
+        case TOX_ITERATION_STAGE_ONION_CLIENT:
+            *out = ITER_STAGE_ONION_CLIENT;
+            return true;
+
+        case TOX_ITERATION_STAGE_FRIEND_CONNECTIONS:
+            *out = ITER_STAGE_FRIEND_CONNECTIONS;
+            return true;
+
+        case TOX_ITERATION_STAGE_FRIENDS:
+            *out = ITER_STAGE_FRIENDS;
+            return true;
+
+        case TOX_ITERATION_STAGE_GC:
+            *out = ITER_STAGE_GC;
+            return true;
+
+        case TOX_ITERATION_STAGE_GCA:
+            *out = ITER_STAGE_GCA;
+            return true;
+
+        case TOX_ITERATION_STAGE_GC_ONION_FRIENDS:
+            *out = ITER_STAGE_GC_ONION_FRIENDS;
+            return true;
+
+        case TOX_ITERATION_STAGE_GROUPCHATS:
+            *out = ITER_STAGE_GROUPCHATS;
+            return true;
+    }
+
+    return false;
+}
+
+bool tox_iteration_profile_enabled(const Tox *tox)
+{
+    assert(tox != nullptr);
+
+    tox_lock(tox);
+    const bool enabled = tox->m->iter_prof != nullptr;
+    tox_unlock(tox);
+
+    return enabled;
+}
+
+uint64_t tox_iteration_profile_get_counter(const Tox *tox, Tox_Iteration_Stage stage, Tox_Iteration_Counter counter)
+{
+    assert(tox != nullptr);
+
+    tox_lock(tox);
+
+    uint64_t value = 0;
+    Iter_Profile_Stage prof_stage;
+
+    if (!iteration_stage_from_api(stage, &prof_stage)) {
+        LOGGER_ERROR(tox->m->log, "invalid iteration stage: %u", stage);
+        tox_unlock(tox);
+        return 0;
+    }
+
+    const Iter_Profile *prof = tox->m->iter_prof;
+
+    switch (counter) {
+        case TOX_ITERATION_COUNTER_CALLS: {
+            value = iterprof_get_calls(prof, prof_stage);
+            break;
+        }
+
+        case TOX_ITERATION_COUNTER_TOTAL_NS: {
+            value = iterprof_get_total_ns(prof, prof_stage);
+            break;
+        }
+
+        case TOX_ITERATION_COUNTER_MAX_NS: {
+            value = iterprof_get_max_ns(prof, prof_stage);
+            break;
+        }
+
+        default: {
+            LOGGER_ERROR(tox->m->log, "invalid iteration counter: %u", counter);
+            break;
+        }
+    }
+
+    tox_unlock(tox);
+
+    return value;
+}
+
+uint64_t tox_iteration_profile_get_histogram(const Tox *tox, Tox_Iteration_Stage stage, uint32_t bucket)
+{
+    assert(tox != nullptr);
+
+    tox_lock(tox);
+
+    uint64_t value = 0;
+    Iter_Profile_Stage prof_stage;
+
+    if (!iteration_stage_from_api(stage, &prof_stage)) {
+        LOGGER_ERROR(tox->m->log, "invalid iteration stage: %u", stage);
+    } else {
+        value = iterprof_get_histogram(tox->m->iter_prof, prof_stage, bucket);
+    }
+
+    tox_unlock(tox);
+
+    return value;
+}
+
+void tox_iteration_profile_reset(Tox *tox)
+{
+    assert(tox != nullptr);
+
+    tox_lock(tox);
+    iterprof_reset(tox->m->iter_prof);
+    tox_unlock(tox);
+}
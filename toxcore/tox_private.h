@@ -60,6 +60,7 @@ typedef struct Tox_Iterate_Options Tox_Iterate_Options;
  *
  * Default values:
  * - fail_hard: false
+ * - wait_for_events: false
  *
  * @param error An error code. Will be set to OK on success.
  * @return A new options object or NULL on failure.
@@ -83,6 +84,28 @@ void tox_iterate_options_set_fail_hard(Tox_Iterate_Options *_Nonnull options, bo
  */
 bool tox_iterate_options_get_fail_hard(const Tox_Iterate_Options *_Nullable options);
 
+/**
+ * Set whether to wait for network activity before running the iteration.
+ *
+ * If enabled, the iteration first blocks until the UDP socket, a TCP relay
+ * connection or the TCP server has data to read, or until
+ * tox_iteration_interval() milliseconds have passed. The UDP socket is only
+ * read when it is ready. Clients can then call tox_iterate_with_options in a
+ * loop without sleeping in between.
+ *
+ * The tox instance is unlocked while waiting, so other threads can use it.
+ * Waiting iterations must not run on more than one thread at a time.
+ *
+ * This only has an effect with the operating system's network stack. With a
+ * custom network, the iteration runs immediately.
+ */
+void tox_iterate_options_set_wait_for_events(Tox_Iterate_Options *_Nonnull options, bool wait_for_events);
+
+/**
+ * Get whether to wait for network activity before running the iteration.
+ */
+bool tox_iterate_options_get_wait_for_events(const Tox_Iterate_Options *_Nullable options);
+
 /**
  * Run a single tox_iterate iteration with custom options.
  */
@@ -117,6 +140,119 @@ void tox_callback_friend_lossless_packet_per_pktid(Tox *_Nonnull tox, tox_friend
 void tox_set_av_object(Tox *_Nonnull tox, void *_Nullable object);
 void *_Nullable tox_get_av_object(const Tox *_Nonnull tox);
 
+/**
+ * Decrypt incoming UDP data packets in batches.
+ *
+ * When enabled, the data packets read in one iteration are decrypted together
+ * and then handled in the order they arrived. With `num_workers` > 0, the
+ * decryption is spread over that many extra threads, which only pays off with
+ * high packet rates on many connections. Disabled by default.
+ *
+ * @return true on success, false if the threads could not be started or the
+ *   instance runs on a host (see tox_new_hosted).
+ */
+bool tox_set_batch_decrypt(Tox *_Nonnull tox, bool enabled, uint16_t num_workers);
+
+/*******************************************************************************
+ *
+ * :: Hosted instances.
+ *
+ ******************************************************************************/
+
+/**
+ * Runs the network for many Tox instances in one process.
+ *
+ * The instances created on a host share its UDP socket, DHT, onion and
+ * announce nodes and TCP relay connections. Each keeps its own keys, friends,
+ * connections to friends, onion paths and groups. Compared to separate
+ * instances, this saves one DHT and its traffic per instance.
+ *
+ * Limitations:
+ * - All instances of a host have the same DHT key, so a remote peer can only
+ *   be connected to one of them at a time.
+ * - The network settings of the options passed to tox_new_hosted (UDP, ports,
+ *   proxy, TCP server, hole punching, DHT announcements) are ignored; those
+ *   passed to tox_host_new apply. The host runs no TCP server.
+ * - Log messages of the shared parts are dropped.
+ * - A host and its instances must be used from one thread.
+ */
+typedef struct Tox_Host Tox_Host;
+
+/**
+ * Create a host for Tox instances.
+ *
+ * @param sys The system to use, or NULL for the default one. Instances created
+ *   on the host use it too.
+ */
+Tox_Host *_Nullable tox_host_new(const Tox_Options *_Nullable options, const Tox_System *_Nullable sys, Tox_Err_New *_Nullable error);
+
+/**
+ * Free a host. All instances created on it must have been killed.
+ */
+void tox_host_kill(Tox_Host *_Nullable host);
+
+/**
+ * Create a Tox instance on a host.
+ *
+ * It is killed with tox_kill like any other instance. Batched decryption
+ * (tox_set_batch_decrypt) isn't available to hosted instances.
+ */
+Tox *_Nullable tox_new_hosted(Tox_Host *_Nonnull host, const Tox_Options *_Nullable options, Tox_Err_New *_Nullable error);
+
+/**
+ * Run the host and every instance on it.
+ *
+ * This replaces tox_iterate for hosted instances. All their callbacks get
+ * `user_data`.
+ */
+void tox_host_iterate(Tox_Host *_Nonnull host, void *_Nullable user_data);
+
+/**
+ * Return the time in milliseconds before tox_host_iterate should be called
+ * again.
+ */
+uint32_t tox_host_iteration_interval(const Tox_Host *_Nonnull host);
+
+/**
+ * Return the number of instances on the host.
+ */
+uint32_t tox_host_get_instance_count(const Tox_Host *_Nonnull host);
+
+/*******************************************************************************
+ *
+ * :: Streamed savedata.
+ *
+ ******************************************************************************/
+
+/**
+ * Receives the next part of a Tox save.
+ *
+ * @return false if the data could not be written. Saving stops then.
+ */
+typedef bool tox_savedata_write_cb(const uint8_t *_Nonnull data, size_t length, void *_Nullable user_data);
+
+/**
+ * Write the Tox save through a callback, in parts of a few KiB.
+ *
+ * Unlike tox_get_savedata, this doesn't need a buffer for the whole save. The
+ * result is the same, except that it isn't padded to tox_get_savedata_size.
+ * Use the experimental_savedata_reader option to load it the same way.
+ *
+ * With changed_only, the sections with the keys, name, status message, status
+ * and friends are only written if they changed since the last successful
+ * tox_savedata_write, or since the save was loaded. The result is a valid save
+ * of its own. To keep a complete save, replace the sections of the same type
+ * (see state.h) in the previous one. Which sections are tracked is not part of
+ * the API; any section written should be replaced.
+ *
+ * Friends' last seen times are only updated in the friends section when they
+ * go offline, not while they are online.
+ *
+ * @return true on success. On failure, what was written is incomplete and the
+ *   changes are kept for the next call.
+ */
+bool tox_savedata_write(Tox *_Nonnull tox, bool changed_only, tox_savedata_write_cb *_Nonnull callback, void *_Nullable user_data);
+
 /*******************************************************************************
  *
  * :: DHT network queries.
@@ -481,6 +617,292 @@ uint64_t tox_netprof_get_packet_total_bytes(const Tox *_Nonnull tox, Tox_Netprof
         Tox_Netprof_Direction direction);
 
 
+/*******************************************************************************
+ *
+ * :: Shared key cache statistics.
+ *
+ ******************************************************************************/
+
+/**
+ * Specifies the shared key cache for a given query.
+ */
+typedef enum Tox_Key_Cache_Type {
+    /**
+     * DHT keys for packets we receive.
+     */
+    TOX_KEY_CACHE_TYPE_DHT_RECV,
+
+    /**
+     * DHT keys for packets we send.
+     */
+    TOX_KEY_CACHE_TYPE_DHT_SENT,
+
+    /**
+     * Combined keys of the three onion layers we relay.
+     */
+    TOX_KEY_CACHE_TYPE_ONION,
+
+    /**
+     * Onion announce request keys.
+     */
+    TOX_KEY_CACHE_TYPE_ONION_ANNOUNCE,
+
+    /**
+     * DHT announcement keys.
+     */
+    TOX_KEY_CACHE_TYPE_ANNOUNCE,
+} Tox_Key_Cache_Type;
+
+const char *_Nonnull tox_key_cache_type_to_string(Tox_Key_Cache_Type value);
+
+/**
+ * Specifies the counter for a given query.
+ */
+typedef enum Tox_Key_Cache_Counter {
+    /**
+     * Lookups that found the shared key in the cache.
+     */
+    TOX_KEY_CACHE_COUNTER_HITS,
+
+    /**
+     * Lookups that had to compute the shared key.
+     */
+    TOX_KEY_CACHE_COUNTER_MISSES,
+
+    /**
+     * Cached keys that were replaced before they timed out.
+     */
+    TOX_KEY_CACHE_COUNTER_EVICTIONS,
+} Tox_Key_Cache_Counter;
+
+const char *_Nonnull tox_key_cache_counter_to_string(Tox_Key_Cache_Counter value);
+
+/**
+ * Return a lookup counter of a shared key cache.
+ *
+ * A high eviction count relative to hits means the cache is too small for the
+ * number of peers it sees.
+ *
+ * @param type The cache being queried.
+ * @param counter The counter being queried.
+ */
+uint64_t tox_key_cache_get_counter(const Tox *_Nonnull tox, Tox_Key_Cache_Type type, Tox_Key_Cache_Counter counter);
+
+
+/*******************************************************************************
+ *
+ * :: Iteration profile.
+ *
+ ******************************************************************************/
+
+/**
+ * Specifies the part of tox_iterate for a given query.
+ */
+typedef enum Tox_Iteration_Stage {
+    /**
+     * The whole of tox_iterate, not counting the time spent waiting for events.
+     */
+    TOX_ITERATION_STAGE_ITERATE,
+
+    /**
+     * Reading and handling UDP packets.
+     */
+    TOX_ITERATION_STAGE_NETWORKING_POLL,
+
+    /**
+     * DHT node pings and lookups.
+     */
+    TOX_ITERATION_STAGE_DHT,
+
+    /**
+     * The TCP relay server, if enabled.
+     */
+    TOX_ITERATION_STAGE_TCP_SERVER,
+
+    /**
+     * Encrypted connections: handshakes, resends and TCP relay connections.
+     */
+    TOX_ITERATION_STAGE_NET_CRYPTO,
+
+    /**
+     * Onion announces and friend lookups.
+     */
+    TOX_ITERATION_STAGE_ONION_CLIENT,
+
+    /**
+     * Friend connection pings, timeouts and reconnects.
+     */
+    TOX_ITERATION_STAGE_FRIEND_CONNECTIONS,
+
+    /**
+     * Per-friend messenger work: status updates, receipts and file transfers.
+     */
+    TOX_ITERATION_STAGE_FRIENDS,
+
+    /**
+     * NGC group chats.
+     */
+    TOX_ITERATION_STAGE_GC,
+
+    /**
+     * Group announces stored for other peers.
+     */
+    TOX_ITERATION_STAGE_GCA,
+
+    /**
+     * Group invites sent through the onion to friends.
+     */
+    TOX_ITERATION_STAGE_GC_ONION_FRIENDS,
+
+    /**
+     * Conferences.
+     */
+    TOX_ITERATION_STAGE_GROUPCHATS,
+} Tox_Iteration_Stage;
+
+const char *_Nonnull tox_iteration_stage_to_string(Tox_Iteration_Stage value);
+
+/**
+ * Specifies the counter for a given query.
+ */
+typedef enum Tox_Iteration_Counter {
+    /**
+     * Number of times the stage ran.
+     */
+    TOX_ITERATION_COUNTER_CALLS,
+
+    /**
+     * Total time spent in the stage, in nanoseconds.
+     */
+    TOX_ITERATION_COUNTER_TOTAL_NS,
+
+    /**
+     * Longest single run of the stage, in nanoseconds.
+     */
+    TOX_ITERATION_COUNTER_MAX_NS,
+} Tox_Iteration_Counter;
+
+const char *_Nonnull tox_iteration_counter_to_string(Tox_Iteration_Counter value);
+
+/**
+ * The number of latency histogram buckets per stage.
+ *
+ * Bucket 0 counts runs under 1 microsecond. Bucket `i` for `0 < i < 19`
+ * counts runs of at least `2^(i-1)` and under `2^i` microseconds. The last
+ * bucket counts runs of 2^18 microseconds (about 262 ms) or more.
+ */
+#define TOX_ITERATION_HISTOGRAM_SIZE     20
+
+uint32_t tox_iteration_histogram_size(void);
+
+/**
+ * Return whether this instance records an iteration profile.
+ *
+ * This is false if toxcore was built with `ITER_PROFILE=0`, in which case all
+ * counters are always 0.
+ */
+bool tox_iteration_profile_enabled(const Tox *_Nonnull tox);
+
+/**
+ * Return a timing counter of a part of tox_iterate.
+ *
+ * @param stage The part of the iteration being queried.
+ * @param counter The counter being queried.
+ */
+uint64_t tox_iteration_profile_get_counter(const Tox *_Nonnull tox, Tox_Iteration_Stage stage,
+        Tox_Iteration_Counter counter);
+
+/**
+ * Return the number of runs of a part of tox_iterate whose duration fell into
+ * a latency histogram bucket.
+ *
+ * @param stage The part of the iteration being queried.
+ * @param bucket The bucket index, less than TOX_ITERATION_HISTOGRAM_SIZE.
+ */
+uint64_t tox_iteration_profile_get_histogram(const Tox *_Nonnull tox, Tox_Iteration_Stage stage, uint32_t bucket);
+
+/**
+ * Set all iteration profile counters back to 0, e.g. to measure the maximum
+ * latency per monitoring interval.
+ */
+void tox_iteration_profile_reset(Tox *_Nonnull tox);
+
+
+/*******************************************************************************
+ *
+ * :: Streamed file sending.
+ *
+ ******************************************************************************/
+
+/**
+ * @param friend_number The friend number of the receiving friend for this file.
+ * @param file_number The file transfer identifier returned by tox_file_send.
+ * @param position The file position of the first byte to copy.
+ * @param data The buffer to copy the file data to.
+ * @param length The number of bytes to copy.
+ *
+ * @return the number of bytes copied to `data`, or -1 on error. Copying fewer
+ *   than `length` bytes ends a file of unknown size (UINT64_MAX) and is an
+ *   error for all other files.
+ */
+typedef int32_t tox_file_read_cb(Tox *_Nonnull tox, uint32_t friend_number, uint32_t file_number, uint64_t position,
+                                 uint8_t *_Nonnull data, size_t length, void *_Nullable user_data);
+
+/**
+ * Set the callback that reads the data of streamed files. Pass NULL to unset.
+ *
+ * Unlike other callbacks, this one runs while the Tox instance is locked and
+ * writes directly into the network send buffer. It must not call any tox_*
+ * functions and should return quickly, e.g. by reading from a memory-mapped
+ * file or with `pread`.
+ */
+void tox_callback_file_read(Tox *_Nonnull tox, tox_file_read_cb *_Nullable callback);
+
+typedef enum Tox_Err_File_Stream {
+    /**
+     * The function returned successfully.
+     */
+    TOX_ERR_FILE_STREAM_OK,
+
+    /**
+     * The friend_number passed did not designate a valid friend.
+     */
+    TOX_ERR_FILE_STREAM_FRIEND_NOT_FOUND,
+
+    /**
+     * No outgoing file transfer with the given file number exists.
+     */
+    TOX_ERR_FILE_STREAM_NOT_FOUND,
+
+    /**
+     * No file read callback is set.
+     */
+    TOX_ERR_FILE_STREAM_NO_CALLBACK,
+} Tox_Err_File_Stream;
+
+/**
+ * Let toxcore read an outgoing file with the file read callback.
+ *
+ * By default, file data is sent in response to `file_chunk_request` events.
+ * A streamed file skips these round trips: on every iteration, toxcore reads
+ * up to `window` chunks of the file into packets, as far as the connection's
+ * send queue allows. A final chunk request of length 0 still signals that the
+ * friend received the whole file.
+ *
+ * Chunks already requested from the client must still be sent with
+ * tox_file_send_chunk before streaming continues after them. A window of 0
+ * switches back to chunk requests.
+ *
+ * @param friend_number The friend number of the receiving friend for this file.
+ * @param file_number The file transfer identifier returned by tox_file_send.
+ * @param window The maximum number of chunks to read per iteration.
+ *
+ * @return true on success.
+ */
+bool tox_file_stream(Tox *_Nonnull tox, uint32_t friend_number, uint32_t file_number, uint16_t window,
+                     Tox_Err_File_Stream *_Nullable error);
+
+
 /*******************************************************************************
  *
  * :: DHT groupchat queries.
@@ -527,6 +949,41 @@ size_t tox_group_peer_get_ip_address_size(const Tox *_Nonnull tox, uint32_t grou
 bool tox_group_peer_get_ip_address(const Tox *_Nonnull tox, uint32_t group_number, uint32_t peer_id, uint8_t *_Nonnull ip_addr,
                                    Tox_Err_Group_Peer_Query *_Nullable error);
 
+/*******************************************************************************
+ *
+ * :: DHT groupchat relay trees.
+ *
+ ******************************************************************************/
+
+/**
+ * The largest relay fanout a group can use.
+ */
+#define TOX_GROUP_MAX_RELAY_FANOUT 16
+
+uint32_t tox_group_max_relay_fanout(void);
+
+/**
+ * Send our messages, name and status changes in a group over a relay tree.
+ *
+ * Normally, each of them is sent to every peer in the group. With a fanout
+ * above 0, they are signed and sent to only `fanout` peers, each of which
+ * passes them on to `fanout` more, until every peer has them. This spreads the
+ * cost of large groups over all peers, at the price of a few more hops.
+ * Moderation and other broadcasts that change the group state are still sent
+ * to every peer. Groups with at most `fanout` peers aren't affected.
+ *
+ * Peers whose client doesn't understand relayed broadcasts are left out of
+ * the tree and get them directly. The default is 0.
+ *
+ * @param group_number The group number of the group.
+ * @param fanout The number of peers each broadcast is passed to, up to
+ *   TOX_GROUP_MAX_RELAY_FANOUT, or 0 to send broadcasts to every peer.
+ *
+ * @return true on success.
+ */
+bool tox_group_set_relay_fanout(Tox *_Nonnull tox, uint32_t group_number, uint8_t fanout,
+                                Tox_Err_Group_State_Query *_Nullable error);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
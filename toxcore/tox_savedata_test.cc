@@ -0,0 +1,283 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ * Copyright © 2026 The TokTok team.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "../testing/support/public/simulation.hh"
+#include "state.h"
+#include "tox.h"
+#include "tox_options.h"
+#include "tox_private.h"
+
+namespace {
+
+using tox::test::FakeClock;
+using tox::test::SimulatedNode;
+using tox::test::Simulation;
+
+using Options_Ptr = std::unique_ptr<Tox_Options, decltype(&tox_options_free)>;
+
+bool append(const uint8_t *data, std::size_t length, void *user_data)
+{
+    auto *out = static_cast<std::vector<uint8_t> *>(user_data);
+    out->insert(out->end(), data, data + length);
+    return true;
+}
+
+struct Source {
+    const std::vector<uint8_t> *data;
+    std::size_t position = 0;
+};
+
+std::size_t read_source(uint8_t *data, std::size_t length, void *user_data)
+{
+    auto *source = static_cast<Source *>(user_data);
+    const std::size_t n = std::min(length, source->data->size() - source->position);
+    std::memcpy(data, source->data->data() + source->position, n);
+    source->position += n;
+    return n;
+}
+
+/** @brief Return the section types in a save, in order. */
+std::vector<uint16_t> section_types(const std::vector<uint8_t> &save)
+{
+    std::vector<uint16_t> types;
+    std::size_t pos = 8;
+
+    while (pos + 8 <= save.size()) {
+        const uint32_t length = save[pos] | save[pos + 1] << 8 | save[pos + 2] << 16
+            | static_cast<uint32_t>(save[pos + 3]) << 24;
+        const uint16_t type = save[pos + 4] | save[pos + 5] << 8;
+        types.push_back(type);
+
+        if (type == STATE_TYPE_END) {
+            break;
+        }
+
+        pos += 8 + length;
+    }
+
+    return types;
+}
+
+const std::set<uint16_t> kTrackedTypes = {STATE_TYPE_NOSPAMKEYS, STATE_TYPE_FRIENDS,
+    STATE_TYPE_NAME, STATE_TYPE_STATUSMESSAGE, STATE_TYPE_STATUS};
+
+std::set<uint16_t> tracked_sections(const std::vector<uint8_t> &save)
+{
+    std::set<uint16_t> tracked;
+
+    for (const uint16_t type : section_types(save)) {
+        if (kTrackedTypes.count(type) != 0) {
+            tracked.insert(type);
+        }
+    }
+
+    return tracked;
+}
+
+class ToxSavedataTest : public ::testing::Test {
+protected:
+    ToxSavedataTest()
+        : node_(sim_.create_node())
+    {
+        tox_options_set_ipv6_enabled(opts_.get(), false);
+        tox_options_set_local_discovery_enabled(opts_.get(), false);
+
+        system_.ns = &node_->c_network;
+        system_.rng = &node_->c_random;
+        system_.mem = &node_->c_memory;
+        system_.mono_time_callback = [](void *user_data) -> uint64_t {
+            return static_cast<FakeClock *>(user_data)->current_time_ms();
+        };
+        system_.mono_time_user_data = &sim_.clock();
+    }
+
+    SimulatedNode::ToxPtr new_tox() { return node_->create_tox(opts_.get()); }
+
+    SimulatedNode::ToxPtr load_stream(const std::vector<uint8_t> &save, Tox_Err_New *error)
+    {
+        Source source{&save};
+        Options_Ptr opts(tox_options_new(nullptr), tox_options_free);
+        tox_options_copy(opts.get(), opts_.get());
+        tox_options_set_savedata_type(opts.get(), TOX_SAVEDATA_TYPE_TOX_SAVE);
+        tox_options_set_experimental_savedata_reader(opts.get(), read_source);
+        tox_options_set_experimental_savedata_reader_user_data(opts.get(), &source);
+
+        // create_tox doesn't report the error, so go through tox_new_testing.
+        Tox_Options_Testing testing_opts;
+        testing_opts.operating_system = &system_;
+        return SimulatedNode::ToxPtr(tox_new_testing(opts.get(), error, &testing_opts, nullptr));
+    }
+
+    /** @brief Give a Tox a name, a status message and some friends. */
+    void populate(Tox *tox, uint32_t friends)
+    {
+        const uint8_t name[] = "Alice";
+        const uint8_t status_message[] = "saving";
+        ASSERT_TRUE(tox_self_set_name(tox, name, sizeof(name), nullptr));
+        ASSERT_TRUE(tox_self_set_status_message(tox, status_message, sizeof(status_message), nullptr));
+
+        for (uint32_t i = 0; i < friends; ++i) {
+            std::array<uint8_t, TOX_PUBLIC_KEY_SIZE> pk{};
+            pk[0] = static_cast<uint8_t>(i + 1);
+            pk[1] = static_cast<uint8_t>((i + 1) >> 8);
+            pk[TOX_PUBLIC_KEY_SIZE - 1] = 0x42;
+            ASSERT_NE(tox_friend_add_norequest(tox, pk.data(), nullptr), UINT32_MAX);
+        }
+    }
+
+    Simulation sim_{12345};
+    std::unique_ptr<SimulatedNode> node_;
+    Tox_System system_;
+    Options_Ptr opts_{tox_options_new(nullptr), tox_options_free};
+};
+
+TEST_F(ToxSavedataTest, StreamedSaveMatchesBufferedSave)
+{
+    auto tox = new_tox();
+    ASSERT_NE(tox, nullptr);
+    populate(tox.get(), 10);
+
+    std::vector<uint8_t> buffered(tox_get_savedata_size(tox.get()));
+    tox_get_savedata(tox.get(), buffered.data());
+
+    std::vector<uint8_t> streamed;
+    ASSERT_TRUE(tox_savedata_write(tox.get(), false, append, &streamed));
+
+    // The buffered save is the streamed one padded with zeros.
+    ASSERT_LE(streamed.size(), buffered.size());
+    EXPECT_TRUE(std::equal(streamed.begin(), streamed.end(), buffered.begin()));
+    EXPECT_TRUE(std::all_of(
+        buffered.begin() + streamed.size(), buffered.end(), [](uint8_t b) { return b == 0; }));
+    EXPECT_EQ(section_types(streamed).back(), STATE_TYPE_END);
+}
+
+TEST_F(ToxSavedataTest, StreamedLoadRestoresTheState)
+{
+    auto tox = new_tox();
+    ASSERT_NE(tox, nullptr);
+    populate(tox.get(), 10);
+
+    std::vector<uint8_t> save;
+    ASSERT_TRUE(tox_savedata_write(tox.get(), false, append, &save));
+
+    Tox_Err_New err;
+    auto loaded = load_stream(save, &err);
+    ASSERT_EQ(err, TOX_ERR_NEW_OK);
+    ASSERT_NE(loaded, nullptr);
+
+    std::array<uint8_t, TOX_ADDRESS_SIZE> address;
+    std::array<uint8_t, TOX_ADDRESS_SIZE> loaded_address;
+    tox_self_get_address(tox.get(), address.data());
+    tox_self_get_address(loaded.get(), loaded_address.data());
+    EXPECT_EQ(address, loaded_address);
+    EXPECT_EQ(tox_self_get_friend_list_size(loaded.get()), 10u);
+    EXPECT_EQ(tox_self_get_name_size(loaded.get()), tox_self_get_name_size(tox.get()));
+
+    // Saving it again gives the same save.
+    std::vector<uint8_t> resaved;
+    ASSERT_TRUE(tox_savedata_write(loaded.get(), false, append, &resaved));
+    EXPECT_EQ(section_types(resaved), section_types(save));
+}
+
+TEST_F(ToxSavedataTest, ChangedOnlyWritesChangedSections)
+{
+    auto tox = new_tox();
+    ASSERT_NE(tox, nullptr);
+
+    // Nothing was saved yet, so everything changed.
+    std::vector<uint8_t> first;
+    ASSERT_TRUE(tox_savedata_write(tox.get(), true, append, &first));
+    EXPECT_EQ(tracked_sections(first), kTrackedTypes);
+
+    std::vector<uint8_t> unchanged;
+    ASSERT_TRUE(tox_savedata_write(tox.get(), true, append, &unchanged));
+    EXPECT_TRUE(tracked_sections(unchanged).empty());
+    EXPECT_EQ(section_types(unchanged).back(), STATE_TYPE_END);
+
+    const uint8_t name[] = "Bob";
+    ASSERT_TRUE(tox_self_set_name(tox.get(), name, sizeof(name), nullptr));
+    std::vector<uint8_t> renamed;
+    ASSERT_TRUE(tox_savedata_write(tox.get(), true, append, &renamed));
+    EXPECT_EQ(tracked_sections(renamed), std::set<uint16_t>{STATE_TYPE_NAME});
+
+    populate(tox.get(), 1);
+    tox_self_set_nospam(tox.get(), 1234);
+    std::vector<uint8_t> changed;
+    ASSERT_TRUE(tox_savedata_write(tox.get(), true, append, &changed));
+    EXPECT_EQ(tracked_sections(changed),
+        (std::set<uint16_t>{STATE_TYPE_NOSPAMKEYS, STATE_TYPE_FRIENDS, STATE_TYPE_NAME,
+            STATE_TYPE_STATUSMESSAGE}));
+}
+
+TEST_F(ToxSavedataTest, LoadedStateCountsAsSaved)
+{
+    auto tox = new_tox();
+    ASSERT_NE(tox, nullptr);
+    populate(tox.get(), 3);
+
+    std::vector<uint8_t> save;
+    ASSERT_TRUE(tox_savedata_write(tox.get(), false, append, &save));
+
+    Tox_Err_New err;
+    auto loaded = load_stream(save, &err);
+    ASSERT_NE(loaded, nullptr);
+
+    std::vector<uint8_t> changed;
+    ASSERT_TRUE(tox_savedata_write(loaded.get(), true, append, &changed));
+    EXPECT_TRUE(tracked_sections(changed).empty());
+}
+
+TEST_F(ToxSavedataTest, FailedWriteKeepsTheChanges)
+{
+    auto tox = new_tox();
+    ASSERT_NE(tox, nullptr);
+
+    std::vector<uint8_t> save;
+    ASSERT_TRUE(tox_savedata_write(tox.get(), false, append, &save));
+
+    const uint8_t name[] = "Carol";
+    ASSERT_TRUE(tox_self_set_name(tox.get(), name, sizeof(name), nullptr));
+
+    EXPECT_FALSE(tox_savedata_write(
+        tox.get(), true, [](const uint8_t *, std::size_t, void *) { return false; }, nullptr));
+
+    std::vector<uint8_t> changed;
+    ASSERT_TRUE(tox_savedata_write(tox.get(), true, append, &changed));
+    EXPECT_EQ(tracked_sections(changed), std::set<uint16_t>{STATE_TYPE_NAME});
+}
+
+TEST_F(ToxSavedataTest, StreamedLoadRejectsBadSaves)
+{
+    auto tox = new_tox();
+    ASSERT_NE(tox, nullptr);
+    populate(tox.get(), 3);
+
+    std::vector<uint8_t> save;
+    ASSERT_TRUE(tox_savedata_write(tox.get(), false, append, &save));
+
+    Tox_Err_New err;
+
+    // Cut off in the middle of the friends section.
+    const std::vector<uint8_t> truncated(save.begin(), save.begin() + save.size() / 2);
+    EXPECT_EQ(load_stream(truncated, &err), nullptr);
+    EXPECT_EQ(err, TOX_ERR_NEW_LOAD_BAD_FORMAT);
+
+    std::vector<uint8_t> encrypted(save);
+    std::memcpy(encrypted.data(), "toxEsave", 8);
+    EXPECT_EQ(load_stream(encrypted, &err), nullptr);
+    EXPECT_EQ(err, TOX_ERR_NEW_LOAD_ENCRYPTED);
+}
+
+}  // namespace
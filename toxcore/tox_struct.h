@@ -8,7 +8,9 @@
 
 #include <pthread.h>
 
+#include "ev.h"
 #include "mono_time.h"
+#include "socket_watch.h"
 #include "tox.h"
 #include "tox_options.h" // tox_log_cb
 #include "tox_private.h"
@@ -17,6 +19,22 @@
 extern "C" {
 #endif
 
+/** @brief What the Messenger callbacks of a Tox get as userdata. */
+struct Tox_Userdata {
+    Tox *_Nonnull tox;
+    void *_Nullable user_data;
+};
+
+struct Tox_Host {
+    struct Logger *_Nonnull log;
+    Mono_Time *_Nonnull mono_time;
+    Tox_System sys;
+    struct Messenger_Host *_Nonnull host;
+
+    Tox *_Nonnull *_Nullable toxes;
+    uint32_t toxes_length;
+};
+
 struct Tox {
     struct Logger *_Nonnull log;
     struct Messenger *_Nonnull m;
@@ -24,6 +42,10 @@ struct Tox {
     Tox_System sys;
     pthread_mutex_t *_Nullable mutex;
 
+    /* Created on the first iteration that waits for network events. */
+    Ev *_Nullable ev;
+    Socket_Watch *_Nullable socket_watch;
+
     tox_log_cb *_Nullable log_callback;
     tox_self_connection_status_cb *_Nullable self_connection_status_callback;
     tox_friend_name_cb *_Nullable friend_name_callback;
@@ -45,6 +67,7 @@ struct Tox {
     tox_conference_peer_name_cb *_Nullable conference_peer_name_callback;
     tox_conference_peer_list_changed_cb *_Nullable conference_peer_list_changed_callback;
     tox_dht_nodes_response_cb *_Nullable dht_nodes_response_callback;
+    tox_file_read_cb *_Nullable file_read_callback;
     tox_friend_lossy_packet_cb *_Nullable friend_lossy_packet_callback_per_pktid[UINT8_MAX + 1];
     tox_friend_lossless_packet_cb *_Nullable friend_lossless_packet_callback_per_pktid[UINT8_MAX + 1];
     tox_group_peer_name_cb *_Nullable group_peer_name_callback;
@@ -67,6 +90,11 @@ struct Tox {
     tox_group_moderation_cb *_Nullable group_moderation_callback;
 
     void *_Nullable toxav_object; // workaround to store a ToxAV object (setter and getter functions are available)
+
+    /* Set for instances created with tox_new_hosted; mono_time then belongs to the host. */
+    Tox_Host *_Nullable host;
+    /* Userdata for the callbacks run by tox_host_iterate. */
+    struct Tox_Userdata host_userdata;
 };
 
 #ifdef __cplusplus
@@ -82,6 +82,26 @@ TEST(Tox, BootstrapErrorCodes)
     tox_kill(tox);
 }
 
+TEST(Tox, IterateWaitingForEvents)
+{
+    Tox *tox = tox_new(nullptr, nullptr);
+    ASSERT_NE(tox, nullptr);
+
+    Tox_Iterate_Options *options = tox_iterate_options_new(nullptr);
+    ASSERT_NE(options, nullptr);
+    EXPECT_FALSE(tox_iterate_options_get_wait_for_events(options));
+    tox_iterate_options_set_wait_for_events(options, true);
+    EXPECT_TRUE(tox_iterate_options_get_wait_for_events(options));
+
+    // Nothing is sent to us, so each iteration waits for the iteration interval.
+    for (int i = 0; i < 3; ++i) {
+        tox_iterate_with_options(tox, options, nullptr);
+    }
+
+    tox_iterate_options_free(options);
+    tox_kill(tox);
+}
+
 TEST(Tox, OneTest)
 {
     SimulatedEnvironment env{12345};